@@ -10,6 +10,10 @@ extern "C" void serial(const char *fmt, ...);
 
 static window_t* clock_win = NULL;
 static int last_sec = -1;
+static uint32_t next_check_ms = 0;
+
+/* The RTC is only read from this long after a tick until the next one */
+#define CLOCK_CHECK_MS 950
 
 /* Dimensiuni */
 #define WIN_W 200
@@ -79,6 +83,7 @@ static void get_hand_endpoint(int center_x, int center_y, int length, int step,
 static void put_pixel(surface_t* s, int x, int y, uint32_t color) {
     if (x < 0 || y < 0 || x >= (int)s->width || y >= (int)s->height) return;
     s->pixels[y * s->width + x] = color;
+    surface_damage(s, x, y, 1, 1);
 }
 
 static void draw_line(surface_t* s, int x0, int y0, int x1, int y1, uint32_t color) {
@@ -171,6 +176,7 @@ void clock_app_create(void) {
 
     clock_win = wm_create_window(s, 150, 150);
     last_sec = -1;
+    next_check_ms = 0;
     
     /* Initial Draw */
     clock_app_update();
@@ -181,11 +187,17 @@ void clock_app_create(void) {
 void clock_app_update(void) {
     if (!clock_win) return;
 
+    /* Frames come at a steady rate, so the tick is seen within a frame of
+       the RTC's; no need to read the RTC every frame until it is near */
+    uint32_t now = wm_frame_time_ms();
+    if (last_sec >= 0 && (int32_t)(now - next_check_ms) < 0) return;
+
     datetime t;
     time_get_local(&t);
 
     if (t.second != last_sec) {
         last_sec = t.second;
+        next_check_ms = now + CLOCK_CHECK_MS;
         
         surface_t* s = clock_win->surface;
         
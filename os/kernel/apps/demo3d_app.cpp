@@ -5,7 +5,10 @@
 #include "../ui/flyui/theme.h"
 
 static window_t* demo_win = NULL;
-static int angle = 0;
+static int angle = -1;
+
+/* One full turn every DEMO_TURN_MS, whatever the frame rate */
+#define DEMO_TURN_MS 3000
 
 /* Simple fixed point math or integer math for rotation */
 /* Vertices of a cube centered at 0,0,0 */
@@ -80,6 +83,7 @@ void demo3d_app_create(void) {
     fly_draw_rect_fill(s, 0, 24, 300, 1, th->color_lo_1);
 
     demo_win = wm_create_window(s, 200, 100);
+    angle = -1;
     app_register("3D Demo", demo_win);
 }
 
@@ -91,6 +95,7 @@ static void draw_line(surface_t* s, int x0, int y0, int x1, int y1, uint32_t col
     int sy = (y0 < y1) ? 1 : -1;
     int err = (dx > dy ? dx : -dy) / 2;
     int e2;
+    surface_damage(s, x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1, dx + 1, dy + 1);
     while (1) {
         if (x0 >= 0 && x0 < (int)s->width && y0 >= 0 && y0 < (int)s->height)
             s->pixels[y0 * s->width + x0] = color;
@@ -104,12 +109,15 @@ static void draw_line(surface_t* s, int x0, int y0, int x1, int y1, uint32_t col
 void demo3d_app_update(void) {
     if (!demo_win) return;
     
+    /* Advance by the frame clock, not per call */
+    int a = (int)((wm_frame_time_ms() % DEMO_TURN_MS) * 360 / DEMO_TURN_MS);
+    if (a == angle) return;
+    angle = a;
+
     surface_t* s = demo_win->surface;
     /* Clear content area */
     fly_draw_rect_fill(s, 0, 25, 300, 275, 0xFF000000);
     
-    angle = (angle + 2) % 360;
-    
     /* Center */
     int cx = 150, cy = 160;
     
@@ -5,6 +5,8 @@
 #include "../../fs/fs.h"
 #include "../../string.h"
 #include "../../drivers/serial.h"
+#include "../../image/image.h"
+#include "../../image/convert.h"
 #include <stddef.h>
 
 #define ICONS_MAGIC 0x4E4F4349  /* 'ICON' in ASCII */
@@ -27,7 +29,8 @@ static struct {
     const icons_mod_entry_t* entries;
     const uint8_t* base;
     void* file_data;
-} g_icons = {0, 0, 0, 0};
+    uint32_t generation;   /* Cache stamp: icons converted from an older module are stale */
+} g_icons = {0, 0, 0, 0, 0};
 
 bool icons_init(const char* path) {
     const void* file_data = NULL;
@@ -83,16 +86,22 @@ bool icons_init(const char* path) {
     g_icons.entries   = (const icons_mod_entry_t*)(h + 1);
     g_icons.base      = (const uint8_t*)data;
     g_icons.file_data = data;
+    g_icons.generation++;
     
     serial_printf("[ICONS] Initialized successfully: %u icons\n", g_icons.count);
     return true;
 }
 
+/* Cache key of an icon: "icons.mod#<id>" */
+static void icon_key(char* out, uint16_t id) {
+    strcpy(out, "icons.mod#");
+    itoa_dec(out + strlen(out), id);
+}
+
 const icon_image_t* icon_get(uint16_t id) {
     static icon_image_t img;
-    static uint32_t converted_pixels[256 * 256]; /* Max 256x256 for conversion buffer */
-    static uint16_t last_id = 0xFFFF;
-    static const uint8_t* cached_rgba_src = NULL;
+    /* Reference to the icon returned last; the pixels stay valid until the next call */
+    static const surface_t* held = 0;
 
     if (!g_icons.base) {
         serial_printf("[ICONS] ERROR: g_icons.base is NULL\n");
@@ -100,39 +109,31 @@ const icon_image_t* icon_get(uint16_t id) {
     }
 
     for (int i = 0; i < g_icons.count; i++) {
-        if (g_icons.entries[i].id == id) {
-            img.w = g_icons.entries[i].w;
-            img.h = g_icons.entries[i].h;
-            
-            /* Get source RGBA data */
-            const uint8_t* rgba_src = (const uint8_t*)(g_icons.base + g_icons.entries[i].offset);
-            size_t pixel_count = (size_t)(img.w * img.h);
-            
-            /* For large icons, we need to downscale in taskbar rendering, not here */
-            /* Check if we can convert (limited by buffer size) */
-            if (pixel_count > sizeof(converted_pixels) / sizeof(converted_pixels[0])) {
-                /* Don't convert large icons here - return raw RGBA pointer wrapped as 32-bit */
-                img.pixels = (const uint32_t*)rgba_src;
-                return &img;
-            }
-            
-            /* For smaller icons or if requested, convert RGBA to ARGB */
-            if (last_id != id || cached_rgba_src == NULL) {
-                for (size_t j = 0; j < pixel_count; j++) {
-                    uint8_t r = rgba_src[j * 4 + 0];
-                    uint8_t g = rgba_src[j * 4 + 1];
-                    uint8_t b = rgba_src[j * 4 + 2];
-                    uint8_t a = rgba_src[j * 4 + 3];
-                    /* Convert RGBA to ARGB */
-                    converted_pixels[j] = (a << 24) | (r << 16) | (g << 8) | b;
-                }
-                cached_rgba_src = rgba_src;
-                last_id = id;
-            }
-            
-            img.pixels = converted_pixels;
-            return &img;
+        if (g_icons.entries[i].id != id) continue;
+
+        uint16_t w = g_icons.entries[i].w;
+        uint16_t h = g_icons.entries[i].h;
+        char key[24];
+        icon_key(key, id);
+
+        /* Converted once (RGBA to premultiplied ARGB) and kept in the image cache */
+        const surface_t* s = image_cache_find(key, g_icons.generation);
+        if (!s) {
+            surface_t* conv = surface_create(w, h);
+            if (!conv) return 0;
+            const uint8_t* rgba_src = g_icons.base + g_icons.entries[i].offset;
+            convert_rgba32(conv->pixels, rgba_src, (uint32_t)w * h);
+            conv->flags |= SURFACE_ALPHA;
+            s = image_cache_add(key, g_icons.generation, conv);
         }
+
+        if (held) image_release(held);
+        held = s;
+
+        img.w = w;
+        img.h = h;
+        img.pixels = s->pixels;
+        return &img;
     }
     
     serial_printf("[ICONS] Icon ID %d not found (total: %d)\n", id, g_icons.count);
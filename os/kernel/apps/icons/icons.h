@@ -30,13 +30,14 @@ enum {
 typedef struct {
     uint16_t w;
     uint16_t h;
-    const uint32_t* pixels; /* ARGB/RGBA buffer */
+    const uint32_t* pixels; /* Premultiplied ARGB */
 } icon_image_t;
 
 /* Initialize the icon subsystem by loading the module file */
 bool icons_init(const char* path);
 
-/* Retrieve an icon by its ID. Returns NULL if not found. */
+/* Retrieve an icon by its ID. Returns NULL if not found. The pixels are
+   valid until the next call. */
 const icon_image_t* icon_get(uint16_t id);
 
 #ifdef __cplusplus
@@ -1,7 +1,7 @@
 #include "image_viewer_app.h"
 #include "../ui/wm/wm.h"
 #include "../ui/flyui/draw.h"
-#include "../ui/flyui/bmp.h"
+#include "../image/image.h"
 #include "../cmds/fat.h"
 
 static window_t* img_win = NULL;
@@ -23,12 +23,25 @@ void image_viewer_app_create(const char* path) {
 
     if (path) {
         fat_automount();
-        fly_load_bmp_to_surface(s, path);
-        /* Redraw title bar on top of image */
-        fly_draw_rect_fill(s, 0, 0, 400, 24, 0xFF404040);
+        const surface_t* img = image_get(path);
+        if (img) {
+            /* Below the title bar, shrunk to fit if needed (aspect kept) */
+            int aw = 400, ah = 300 - 24;
+            int w = (int)img->width, h = (int)img->height;
+            if (w > aw || h > ah) {
+                if (w * ah > h * aw) { h = h * aw / w; w = aw; }
+                else { w = w * ah / h; h = ah; }
+                if (w < 1) w = 1;
+                if (h < 1) h = 1;
+            }
+            image_draw_scaled(s, img, (aw - w) / 2, 24 + (ah - h) / 2, w, h);
+            image_release(img);
+        } else {
+            fly_draw_text(s, 5, 32, "Cannot open image", 0xFFFF6060);
+        }
+        /* Path replaces the title */
+        fly_draw_rect_fill(s, 0, 0, 376, 24, 0xFF404040);
         fly_draw_text(s, 5, 4, path, 0xFFFFFFFF);
-        fly_draw_rect_fill(s, 380, 4, 16, 16, 0xFFC0C0C0);
-        fly_draw_text(s, 384, 4, "X", 0xFF000000);
     }
 
     img_win = wm_create_window(s, 100, 100);
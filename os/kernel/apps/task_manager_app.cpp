@@ -6,6 +6,11 @@
 #include "../string.h"
 
 static window_t* task_win = NULL;
+static uint32_t stats_shown_ms = 0;
+
+/* Frame statistics block, above the End Task button */
+#define STATS_H 76
+#define STATS_Y(h) ((h) - 44 - STATS_H)
 
 static void fly_draw_line(surface_t* surf, int x0, int y0, int x1, int y1, uint32_t color) {
     int dx = (x1 > x0) ? (x1 - x0) : (x0 - x1);
@@ -14,6 +19,7 @@ static void fly_draw_line(surface_t* surf, int x0, int y0, int x1, int y1, uint3
     int sy = (y0 < y1) ? 1 : -1;
     int err = dx + dy;
     int e2;
+    surface_damage(surf, x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1, dx + 1, 1 - dy);
 
     for (;;) {
         if (x0 >= 0 && x0 < (int)surf->width && y0 >= 0 && y0 < (int)surf->height) {
@@ -71,21 +77,66 @@ static void draw_stats(surface_t* s) {
         
         y += 20;
         app = app->next;
-        if (y > (int)s->height - 60) break;
+        if (y > STATS_Y((int)s->height) - 20) break;
     }
     
     // "End Task" Button
     draw_classic_button(s, 150, s->height - 40, 80, 25, "End Task");
 }
 
+// Microseconds as milliseconds with one decimal: 1250 -> "1.2"
+static void fmt_ms(char* out, uint32_t us) {
+    char num[16];
+    itoa_dec(out, (int32_t)(us / 1000));
+    strcat(out, ".");
+    itoa_dec(num, (int32_t)((us % 1000) / 100));
+    strcat(out, num);
+}
+
+static void draw_frame_stats(surface_t* s) {
+    fly_theme_t* th = theme_get();
+    int y = STATS_Y((int)s->height);
+    wm_frame_stats_t st;
+    wm_frame_get_stats(&st);
+
+    fly_draw_rect_fill(s, 0, y, s->width, STATS_H, th->win_bg);
+    fly_draw_rect_fill(s, 10, y, s->width - 20, 1, th->color_lo_1);
+
+    char buf[64], num[16];
+    strcpy(buf, "Frames (target ");
+    itoa_dec(num, (int32_t)st.target_hz); strcat(buf, num);
+    strcat(buf, " Hz):");
+    fly_draw_text(s, 10, y + 4, buf, th->color_text);
+
+    // Time to produce a frame
+    strcpy(buf, "min/avg/p99 ");
+    fmt_ms(num, st.min_us); strcat(buf, num); strcat(buf, "/");
+    fmt_ms(num, st.avg_us); strcat(buf, num); strcat(buf, "/");
+    fmt_ms(num, st.p99_us); strcat(buf, num); strcat(buf, " ms");
+    fly_draw_text(s, 10, y + 22, buf, th->color_text);
+
+    strcpy(buf, "Drawn ");
+    itoa_dec(num, (int32_t)st.frames); strcat(buf, num);
+    strcat(buf, ", dropped ");
+    itoa_dec(num, (int32_t)st.dropped); strcat(buf, num);
+    fly_draw_text(s, 10, y + 40, buf, th->color_text);
+
+    strcpy(buf, "CPU busy: ");
+    itoa_dec(num, (int32_t)st.busy_pct); strcat(buf, num);
+    strcat(buf, "%");
+    fly_draw_text(s, 10, y + 58, buf, th->color_text);
+}
+
 void task_manager_app_create(void) {
     if (task_win) return;
     
-    surface_t* s = surface_create(250, 300);
+    surface_t* s = surface_create(250, 380);
     fly_theme_t* th = theme_get();
     surface_clear(s, th->win_bg);
 
     draw_stats(s);
+    draw_frame_stats(s);
+    stats_shown_ms = wm_frame_time_ms();
 
     task_win = wm_create_window(s, 200, 200);
     app_register("Task Manager", task_win);
@@ -98,6 +149,7 @@ bool task_manager_app_handle_event(input_event_t* ev) {
         int lx = ev->mouse_x - task_win->x;
         int ly = ev->mouse_y - task_win->y;
         int surf_w = task_win->surface->width;
+        int surf_h = task_win->surface->height;
 
         // Close logic
         if (lx >= surf_w - 20 && ly < 24) {
@@ -109,7 +161,7 @@ bool task_manager_app_handle_event(input_event_t* ev) {
         }
 
         // Kill logic (simplificată)
-        if (lx >= 150 && lx <= 230 && ly >= 260) {
+        if (lx >= 150 && lx <= 230 && ly >= surf_h - 40) {
              app_info_t* app = app_get_list();
              while(app) {
                  if(app->selected && app->window != task_win) {
@@ -123,6 +175,7 @@ bool task_manager_app_handle_event(input_event_t* ev) {
              // Redraw stats
              surface_clear(task_win->surface, theme_get()->win_bg);
              draw_stats(task_win->surface);
+             draw_frame_stats(task_win->surface);
              wm_mark_dirty();
              return true;
         }
@@ -131,7 +184,14 @@ bool task_manager_app_handle_event(input_event_t* ev) {
 }
 
 void task_manager_app_update(void) {
-    /* No-op for now */
+    if (!task_win) return;
+
+    /* Frame statistics, refreshed once a second */
+    uint32_t now = wm_frame_time_ms();
+    if (now - stats_shown_ms < 1000) return;
+    stats_shown_ms = now;
+    draw_frame_stats(task_win->surface);
+    wm_mark_dirty();
 }
 
 window_t* task_manager_app_get_window(void) {
@@ -5,6 +5,7 @@
 
 #include "../storage/block.h"
 #include "../storage/ata.h"
+#include "../storage/virtio_blk.h"
 #include "../terminal.h"
 #include "../string.h"
 #include "../mem/kmalloc.h"
@@ -21,8 +22,10 @@ static void init_assigns_table(void) {
 
 /* --- Helpers --- */
 
+/* Paravirtual disk first: no per-command register traps */
 static block_device_t* get_main_disk(void) {
-    block_device_t* bd = block_get("ahci0");
+    block_device_t* bd = block_get("vda");
+    if (!bd) bd = block_get("ahci0");
     if (!bd) bd = block_get("ata0");
     return bd;
 }
@@ -68,12 +71,54 @@ int disk_read_sector(uint32_t lba, uint8_t* buf) {
     return -1;
 }
 
+int disk_read_sectors(uint32_t lba, uint32_t count, uint8_t* buf) {
+    block_device_t* bd = get_main_disk();
+    if (bd) return bd->read(bd, lba, count, buf);
+    return -1;
+}
+
 int disk_write_sector(uint32_t lba, const uint8_t* buf) {
     block_device_t* bd = get_main_disk();
     if (bd) return bd->write(bd, lba, 1, buf);
     return -1;
 }
 
+int disk_write_start(uint32_t lba, uint32_t count, const uint8_t* buf) {
+    block_device_t* bd = get_main_disk();
+    if (!bd) return -1;
+    if (!bd->write_start) return bd->write(bd, lba, count, buf) == 0 ? DISK_WRITE_DONE : -1;
+    int tag = bd->write_start(bd, lba, count, buf);
+    return tag < 0 ? -1 : tag;
+}
+
+int disk_write_poll(int tag) {
+    if (tag == DISK_WRITE_DONE) return 1;
+    block_device_t* bd = get_main_disk();
+    if (!bd || !bd->write_poll) return -1;
+    int r = bd->write_poll(bd, tag);
+    return r < 0 ? -1 : r;
+}
+
+int disk_write_abort(int tag) {
+    if (tag == DISK_WRITE_DONE) return 0;
+    block_device_t* bd = get_main_disk();
+    if (!bd || !bd->write_abort) return -1;
+    return bd->write_abort(bd, tag) < 0 ? -1 : 0;
+}
+
+int disk_flush(void) {
+    block_device_t* bd = get_main_disk();
+    if (!bd) return -1;
+    if (!bd->flush) return 0;
+    return bd->flush(bd) < 0 ? -1 : 0;
+}
+
+int disk_discard(uint32_t lba, uint32_t count) {
+    block_device_t* bd = get_main_disk();
+    if (!bd || !bd->discard) return -1;
+    return bd->discard(bd, lba, count) < 0 ? -1 : 0;
+}
+
 uint32_t disk_get_capacity(void) {
     block_device_t* bd = get_main_disk();
     if (bd) return (uint32_t)bd->sector_count;
@@ -100,6 +145,17 @@ static void cmd_lsblk(void) {
         }
     }
 
+    for (int i = 0; i < VIRTIO_BLK_MAX_DISKS; i++) {
+        name[0]='v'; name[1]='d'; name[2]='a'+i; name[3]=0;
+
+        block_device_t* bd = block_get(name);
+        if (bd) {
+            terminal_printf("%s     253:%d  0  ", bd->name, i*16);
+            print_size(bd->sector_count);
+            terminal_writestring("  0 disk \n");
+        }
+    }
+
     block_device_t* ata = block_get("ata0");
     if (ata) {
         terminal_printf("%s     3:0    0  ", ata->name);
@@ -285,6 +341,10 @@ static void cmd_format(int argc, char** argv) {
     uint32_t count = g_assigns[idx].count;
     uint8_t type = g_assigns[idx].type;
 
+    /* Thin-provisioned disks get the space back */
+    if (disk_discard(start, count) == 0)
+        terminal_printf("Discarded %u sectors.\n", count);
+
     if (type == 0x0B || type == 0x0C) {
         terminal_printf("Formatting partition %c (LBA %u, Size %u) as FAT32...\n", letter, start, count);
         fat32_format(start, count, "CHRYSALIS");
@@ -305,6 +365,8 @@ static void cmd_usage(void) {
     terminal_writestring("  mklabel  Create fresh MBR with 1 partition\n");
     terminal_writestring("  format   Wipe partition data (disk format <letter>)\n");
     terminal_writestring("  read     Read sector 0 (test)\n");
+    terminal_writestring("  sync     Flush the disk write cache\n");
+    terminal_writestring("  stat     virtio-blk queue statistics\n");
 }
 
 void cmd_disk(int argc, char** argv)
@@ -323,6 +385,13 @@ void cmd_disk(int argc, char** argv)
     if (strcmp(sub, "probe") == 0)   { disk_probe_partitions(); return; }
     if (strcmp(sub, "mklabel") == 0) { cmd_mklabel(); return; }
     if (strcmp(sub, "format") == 0)  { cmd_format(argc, argv); return; }
+    if (strcmp(sub, "stat") == 0)    { virtio_blk_print_stats(); return; }
+
+    if (strcmp(sub, "sync") == 0) {
+        if (disk_flush() == 0) terminal_writestring("Disk cache flushed.\n");
+        else terminal_writestring("Flush failed.\n");
+        return;
+    }
     
     if (strcmp(sub, "read") == 0) {
         uint8_t* buf = (uint8_t*)kmalloc(512);
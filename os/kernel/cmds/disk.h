@@ -19,7 +19,23 @@ extern struct part_assign g_assigns[26];
 
 /* Unified I/O API (AHCI/ATA auto-detect) */
 int disk_read_sector(uint32_t lba, uint8_t* buf);
+/* count sectors in one command; buf must be 4-byte aligned (DMA) */
+int disk_read_sectors(uint32_t lba, uint32_t count, uint8_t* buf);
 int disk_write_sector(uint32_t lba, const uint8_t* buf);
+
+/* Write-behind: start a multi-sector write and return a tag for
+   disk_write_poll() (1 done, 0 in flight, -1 error). Devices without an
+   async path complete the write before returning DISK_WRITE_DONE.
+   buf must stay untouched and 4-byte aligned until the write is done. */
+#define DISK_WRITE_DONE 0x7FFFFFFF
+int disk_write_start(uint32_t lba, uint32_t count, const uint8_t* buf);
+int disk_write_poll(int tag);
+/* Stop a write that is still in flight so buf can be reused: 0, or -1
+   if the device cannot, in which case buf must never be reused. */
+int disk_write_abort(int tag);
+/* Write back the device cache (0 if it has none) / drop sector contents */
+int disk_flush(void);
+int disk_discard(uint32_t lba, uint32_t count);
 uint32_t disk_get_capacity(void);
 
 /* Helper pentru automount: scanează partițiile și populează g_assigns */
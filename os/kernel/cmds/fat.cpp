@@ -5,12 +5,17 @@
 #include "../terminal.h"
 #include "../string.h"
 #include "../mem/kmalloc.h"
+#include "../time/clock.h"
+#include <errno.h>
 
 extern void terminal_printf(const char* fmt, ...);
 extern "C" void serial(const char *fmt, ...);
+extern "C" uint32_t get_uptime_ms(void);
 
 static bool is_fat_initialized = false;
 static uint32_t current_lba = 0;
+/* Bumped on every change to the volume; see fat32_generation() */
+static uint32_t fat_generation = 0;
 static char current_letter = 0;
 
 /* --- FAT32 Structures & Helpers (Local Implementation) --- */
@@ -91,10 +96,28 @@ static void to_dos_name_component(const char* name, int len, char* dst) {
     }
 }
 
+/* Stamp an entry's modification (and, if new, creation) time with the local clock */
+static void stamp_entry(struct fat_dir_entry* e, bool created) {
+    struct datetime t;
+    time_get_local(&t);
+    if (t.year < 1980) return;   /* RTC not set; FAT dates cannot express it */
+    uint16_t date = (uint16_t)(((t.year - 1980) << 9) | (t.month << 5) | t.day);
+    uint16_t tm = (uint16_t)((t.hour << 11) | (t.minute << 5) | (t.second / 2));
+    e->mdate = date;
+    e->mtime = tm;
+    e->adate = date;
+    if (created) {
+        e->cdate = date;
+        e->ctime = tm;
+        e->ctime_tenth = 0;
+    }
+}
+
 /* Helper to find an entry in a directory cluster */
 static int find_in_cluster(uint32_t dir_cluster, const char* name, int name_len, 
                            uint32_t data_start, uint32_t fat_start, uint32_t spc, uint32_t bps,
-                           uint32_t* out_cluster, uint32_t* out_size, uint32_t* out_sector, uint32_t* out_offset, bool* out_is_dir) 
+                           uint32_t* out_cluster, uint32_t* out_size, uint32_t* out_sector, uint32_t* out_offset, bool* out_is_dir,
+                           uint32_t* out_mtime = NULL)
 {
     char target[11];
     to_dos_name_component(name, name_len, target);
@@ -122,6 +145,7 @@ static int find_in_cluster(uint32_t dir_cluster, const char* name, int name_len,
                     if (out_sector) *out_sector = cluster_lba + i;
                     if (out_offset) *out_offset = j;
                     if (out_is_dir) *out_is_dir = (entries[j].attr & 0x10) ? true : false;
+                    if (out_mtime) *out_mtime = ((uint32_t)entries[j].mdate << 16) | entries[j].mtime;
                     kfree(sector);
                     return 0;
                 }
@@ -334,6 +358,7 @@ extern "C" int fat32_read_file_offset(const char* path, void* buf, uint32_t size
 
 extern "C" int fat32_create_file(const char* path, const void* data, uint32_t size) {
     if (!is_fat_initialized) return -1;
+    fat_generation++;
 
     uint8_t* sector = (uint8_t*)kmalloc(512);
     if (!sector) return -1;
@@ -447,6 +472,7 @@ alloc_done:
         entry->cluster_hi = (file_cluster >> 16);
         entry->cluster_low = (file_cluster & 0xFFFF);
         entry->size = size;
+        stamp_entry(entry, !found_existing);
         disk_write_sector(entry_sector_lba, sector);
     }
 
@@ -640,6 +666,7 @@ done_reading:
 
 extern "C" int fat32_delete_file(const char* path) {
     if (!is_fat_initialized) return -1;
+    fat_generation++;
 
     uint8_t* sector = (uint8_t*)kmalloc(512);
     if (!sector) return -1;
@@ -679,9 +706,10 @@ extern "C" int fat32_delete_file(const char* path) {
     ((struct fat_dir_entry*)sector)[entry_offset].name[0] = 0xE5;
     disk_write_sector(entry_sector, sector);
 
-    /* Free cluster chain */
+    /* Free cluster chain, discarding the data of each contiguous run */
     if (file_cluster != 0) {
         uint32_t current = file_cluster;
+        uint32_t run_start = 0, run_len = 0;
         while (current < 0x0FFFFFF8 && current != 0) {
             uint32_t fat_sector = fat_start + (current * 4) / bps;
             uint32_t fat_offset = (current * 4) % bps;
@@ -692,9 +720,17 @@ extern "C" int fat32_delete_file(const char* path) {
             /* Mark free */
             *(uint32_t*)(sector + fat_offset) = 0;
             disk_write_sector(fat_sector, sector);
-            
+
+            if (run_len && current == run_start + run_len) {
+                run_len++;
+            } else {
+                if (run_len) disk_discard(data_start + (run_start - 2) * spc, run_len * spc);
+                run_start = current;
+                run_len = 1;
+            }
             current = next;
         }
+        if (run_len) disk_discard(data_start + (run_start - 2) * spc, run_len * spc);
     }
 
     kfree(sector);
@@ -815,6 +851,7 @@ extern "C" int fat32_directory_exists(const char* path) {
 }
 
 extern "C" int fat32_format(uint32_t lba, uint32_t sector_count, const char* label) {
+    fat_generation++;
     if (sector_count < 65536) {
         terminal_writestring("Error: Partition too small for FAT32 (need > 32MB approx)\n");
         return -1;
@@ -963,6 +1000,480 @@ extern "C" int32_t fat32_get_file_size(const char* path) {
     return (res == 0 && !is_dir) ? (int32_t)file_size : -1;
 }
 
+extern "C" uint32_t fat32_generation(void) {
+    return fat_generation;
+}
+
+/* --- Streaming handles --- */
+
+extern "C" int fat32_open(const char* path, fat_file_t* f) {
+    if (!is_fat_initialized || !f) return -1;
+
+    uint8_t* sector = (uint8_t*)kmalloc(512);
+    if (!sector) return -1;
+
+    if (disk_read_sector(current_lba, sector) != 0) { kfree(sector); return -1; }
+    struct fat_bpb* bpb = (struct fat_bpb*)sector;
+    if (bpb->bytes_per_sector != 512 || bpb->sectors_per_cluster == 0) { kfree(sector); return -1; }
+
+    memset(f, 0, sizeof(*f));
+    f->bps = bpb->bytes_per_sector;
+    f->spc = bpb->sectors_per_cluster;
+    f->fat_start = current_lba + bpb->reserved_sectors;
+    f->data_start = f->fat_start + (bpb->fats_count * bpb->sectors_per_fat_32);
+    f->fat_lba = 0xFFFFFFFF;
+    uint32_t root_cluster = bpb->root_cluster;
+    kfree(sector);
+
+    if (path[0] == 0 || (path[0] == '/' && path[1] == 0)) {
+        f->first_cluster = root_cluster;
+        f->is_dir = 1;
+    } else {
+        uint32_t parent_cluster;
+        const char* fname;
+        int fname_len;
+        if (resolve_parent(path, root_cluster, f->data_start, f->fat_start, f->spc, f->bps,
+                           &parent_cluster, &fname, &fname_len) != 0)
+            return -1;
+
+        bool is_dir;
+        if (find_in_cluster(parent_cluster, fname, fname_len, f->data_start, f->fat_start, f->spc, f->bps,
+                            &f->first_cluster, &f->size, NULL, NULL, &is_dir, &f->mtime) != 0)
+            return -1;
+        f->is_dir = is_dir ? 1 : 0;
+        if (f->is_dir && f->first_cluster == 0) f->first_cluster = root_cluster;
+    }
+
+    f->generation = fat_generation;
+    f->cur_cluster = f->first_cluster;
+    f->cur_index = 0;
+    return 0;
+}
+
+static int fat_next_cluster(fat_file_t* f, uint32_t cluster, uint32_t* next) {
+    uint32_t lba = f->fat_start + (cluster * 4) / f->bps;
+    if (lba != f->fat_lba) {
+        if (disk_read_sector(lba, f->fat_cache) != 0) return -1;
+        f->fat_lba = lba;
+    }
+    *next = (*(uint32_t*)(f->fat_cache + (cluster * 4) % f->bps)) & 0x0FFFFFFF;
+    return 0;
+}
+
+/* Move the cursor to chain entry idx: forward from where it is, or from
+   the first cluster when seeking backwards */
+static int fat_seek_cluster(fat_file_t* f, uint32_t idx) {
+    if (idx < f->cur_index) {
+        f->cur_cluster = f->first_cluster;
+        f->cur_index = 0;
+    }
+    while (f->cur_index < idx) {
+        uint32_t next;
+        if (fat_next_cluster(f, f->cur_cluster, &next) != 0) return -1;
+        if (next < 2 || next >= 0x0FFFFFF8) return -1;
+        f->cur_cluster = next;
+        f->cur_index++;
+    }
+    return 0;
+}
+
+extern "C" int fat32_read_at(fat_file_t* f, void* buf, uint32_t size, uint32_t offset) {
+    if (!f || f->is_dir) return -1;
+    if (offset >= f->size) return 0;
+    if (size > f->size - offset) size = f->size - offset;
+
+    uint32_t cluster_bytes = f->spc * f->bps;
+    uint8_t* out = (uint8_t*)buf;
+    uint8_t* bounce = NULL;
+    uint32_t done = 0;
+
+    while (done < size) {
+        uint32_t pos = offset + done;
+        if (fat_seek_cluster(f, pos / cluster_bytes) != 0) break;
+
+        uint32_t in_cluster = pos % cluster_bytes;
+        uint32_t lba = f->data_start + (f->cur_cluster - 2) * f->spc + in_cluster / f->bps;
+        uint32_t sec_off = in_cluster % f->bps;
+        uint32_t left = size - done;
+
+        if (sec_off == 0 && left >= f->bps && ((uintptr_t)(out + done) & 3) == 0) {
+            /* Direct: rest of this cluster, extended over following clusters
+               as long as the chain is physically contiguous */
+            uint32_t want = left / f->bps;
+            uint32_t secs = (cluster_bytes - in_cluster) / f->bps;
+            while (secs < want && secs < FAT_READ_RUN_MAX) {
+                uint32_t next;
+                if (fat_next_cluster(f, f->cur_cluster, &next) != 0) break;
+                if (next != f->cur_cluster + 1) break;
+                f->cur_cluster = next;
+                f->cur_index++;
+                secs += f->spc;
+            }
+            if (secs > want) secs = want;
+            if (secs > FAT_READ_RUN_MAX) secs = FAT_READ_RUN_MAX;
+
+            if (disk_read_sectors(lba, secs, out + done) != 0) break;
+            done += secs * f->bps;
+        } else {
+            /* Partial or unaligned sector through a bounce buffer */
+            if (!bounce) {
+                bounce = (uint8_t*)kmalloc(512);
+                if (!bounce) break;
+            }
+            if (disk_read_sector(lba, bounce) != 0) break;
+            uint32_t chunk = f->bps - sec_off;
+            if (chunk > left) chunk = left;
+            memcpy(out + done, bounce + sec_off, chunk);
+            done += chunk;
+        }
+    }
+
+    if (bounce) kfree(bounce);
+    if (done == 0 && size > 0) return -1;
+    return (int)done;
+}
+
+/* --- Streaming writer --- */
+
+#define FAT_EOC          0x0FFFFFFF
+#define FAT_WB_TIMEOUT_MS 5000
+
+static int wr_fat_flush(fat_writer_t* w) {
+    if (!w->fat_dirty) return 0;
+    uint32_t rel = w->fat_lba - w->fat_start;
+    for (uint32_t i = 0; i < w->fats; i++) {
+        if (disk_write_sector(w->fat_start + i * w->fat_sectors + rel, w->fat_cache) != 0) return -EIO;
+    }
+    w->fat_dirty = 0;
+    return 0;
+}
+
+static uint32_t* wr_fat_entry(fat_writer_t* w, uint32_t cluster) {
+    uint32_t lba = w->fat_start + (cluster * 4) / w->bps;
+    if (lba != w->fat_lba) {
+        if (wr_fat_flush(w) != 0) return NULL;
+        if (disk_read_sector(lba, w->fat_cache) != 0) {
+            w->fat_lba = 0xFFFFFFFF;
+            return NULL;
+        }
+        w->fat_lba = lba;
+    }
+    return (uint32_t*)(w->fat_cache + (cluster * 4) % w->bps);
+}
+
+static int wr_fat_set(fat_writer_t* w, uint32_t cluster, uint32_t val) {
+    uint32_t* e = wr_fat_entry(w, cluster);
+    if (!e) return -EIO;
+    *e = (*e & 0xF0000000) | (val & 0x0FFFFFFF);
+    w->fat_dirty = 1;
+    return 0;
+}
+
+/* Allocate up to want physically contiguous free clusters and chain them
+   after prev (0 starts a new chain). Run length, 0 if the volume is full,
+   or -EIO. */
+static int wr_alloc_run(fat_writer_t* w, uint32_t prev, uint32_t want, uint32_t* first) {
+    uint32_t span = w->max_cluster - 1;
+    uint32_t c = w->next_free;
+    uint32_t scanned = 0;
+    for (; scanned < span; scanned++, c++) {
+        if (c < 2 || c > w->max_cluster) c = 2;
+        uint32_t* e = wr_fat_entry(w, c);
+        if (!e) return -EIO;
+        if ((*e & 0x0FFFFFFF) == 0) break;
+    }
+    if (scanned == span) return 0;
+
+    uint32_t n = 1;
+    while (n < want && c + n <= w->max_cluster) {
+        uint32_t* e = wr_fat_entry(w, c + n);
+        if (!e) return -EIO;
+        if ((*e & 0x0FFFFFFF) != 0) break;
+        n++;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (wr_fat_set(w, c + i, i + 1 < n ? c + i + 1 : FAT_EOC) != 0) return -EIO;
+    }
+    if (prev && wr_fat_set(w, prev, c) != 0) return -EIO;
+
+    w->next_free = c + n;
+    *first = c;
+    return (int)n;
+}
+
+/* Wait for the write in flight; its bytes count as stored only once the
+   disk confirmed them. A write that times out is aborted, so the disk is
+   done with the buffer whatever the outcome. */
+static int wr_wait(fat_writer_t* w) {
+    if (w->inflight < 0) return 0;
+    uint32_t start = get_uptime_ms();
+    int r;
+    while ((r = disk_write_poll(w->inflight)) == 0) {
+        if (get_uptime_ms() - start > FAT_WB_TIMEOUT_MS) break;
+    }
+    w->stall_ms += get_uptime_ms() - start;
+    if (r == 0 && disk_write_abort(w->inflight) != 0) w->lost = 1;
+    w->inflight = -1;
+    if (r != 1) return -EIO;
+    w->stored += w->inflight_bytes;
+    w->inflight_bytes = 0;
+    return 0;
+}
+
+/* Give len bytes of buf clusters at the end of the chain and write them,
+   one command per contiguous run. All runs but the last are waited for;
+   the last is left in flight. */
+static int wr_store(fat_writer_t* w, const uint8_t* buf, uint32_t len) {
+    uint32_t cluster_bytes = w->spc * w->bps;
+    uint32_t done = 0;
+
+    while (done < len) {
+        uint32_t want = (len - done + cluster_bytes - 1) / cluster_bytes;
+        uint32_t first;
+        int n = wr_alloc_run(w, w->last_cluster, want, &first);
+        if (n < 0) return n;
+        if (n == 0) return -ENOSPC;
+        if (!w->first_cluster) w->first_cluster = first;
+        w->last_cluster = first + n - 1;
+
+        uint32_t bytes = (uint32_t)n * cluster_bytes;
+        if (bytes > len - done) bytes = len - done;
+        uint32_t secs = (bytes + w->bps - 1) / w->bps;
+        int tag = disk_write_start(w->data_start + (first - 2) * w->spc, secs, buf + done);
+        if (tag < 0) return -EIO;
+        w->inflight = tag;
+        w->inflight_bytes = bytes;
+        w->disk_cmds++;
+        done += bytes;
+
+        if (done < len) {
+            int r = wr_wait(w);
+            if (r != 0) return r;
+        }
+    }
+    return 0;
+}
+
+/* Hand the current buffer to the disk once the previous one has landed,
+   then switch to the other buffer */
+static int wr_submit(fat_writer_t* w) {
+    if (w->fill == 0) return 0;
+    int r = wr_wait(w);
+    if (r == 0) r = wr_store(w, w->buf[w->cur], w->fill);
+    w->cur ^= 1;
+    w->fill = 0;
+    return r;
+}
+
+/* Find target in the directory chain, or the first free slot, growing the
+   directory by one cluster when it is full */
+static int wr_dir_slot(fat_writer_t* w, uint8_t* sector, uint32_t dir_cluster,
+                       const char* target, uint32_t* old_cluster) {
+    uint32_t free_lba = 0, free_index = 0;
+    uint32_t cluster = dir_cluster, last = dir_cluster;
+    bool end = false;
+
+    *old_cluster = 0;
+    while (!end && cluster >= 2 && cluster < 0x0FFFFFF8) {
+        uint32_t lba = w->data_start + (cluster - 2) * w->spc;
+        for (uint32_t i = 0; i < w->spc && !end; i++) {
+            if (disk_read_sector(lba + i, sector) != 0) return -EIO;
+            struct fat_dir_entry* entries = (struct fat_dir_entry*)sector;
+            for (int j = 0; j < 512 / 32; j++) {
+                bool unused = entries[j].name[0] == 0;
+                if (unused || (uint8_t)entries[j].name[0] == 0xE5) {
+                    if (!free_lba) { free_lba = lba + i; free_index = j; }
+                    if (unused) { end = true; break; }
+                    continue;
+                }
+                if (entries[j].attr == 0x0F) continue;
+                if (memcmp(entries[j].name, target, 11) == 0) {
+                    if (entries[j].attr & 0x18) return -EISDIR;   /* Directory or label */
+                    w->dir_lba = lba + i;
+                    w->dir_index = j;
+                    *old_cluster = ((uint32_t)entries[j].cluster_hi << 16) | entries[j].cluster_low;
+                    return 0;
+                }
+            }
+        }
+        if (end) break;
+        last = cluster;
+        uint32_t* next = wr_fat_entry(w, cluster);
+        if (!next) return -EIO;
+        cluster = *next & 0x0FFFFFFF;
+    }
+
+    if (!free_lba) {
+        uint32_t c;
+        int n = wr_alloc_run(w, last, 1, &c);
+        if (n < 0) return n;
+        if (n == 0) return -ENOSPC;
+        memset(sector, 0, 512);
+        free_lba = w->data_start + (c - 2) * w->spc;
+        for (uint32_t i = 0; i < w->spc; i++) {
+            if (disk_write_sector(free_lba + i, sector) != 0) return -EIO;
+        }
+        free_index = 0;
+    }
+    w->dir_lba = free_lba;
+    w->dir_index = free_index;
+    return 0;
+}
+
+static int wr_dir_update(fat_writer_t* w, uint8_t* sector, const char* name) {
+    fat_generation++;
+    if (disk_read_sector(w->dir_lba, sector) != 0) return -EIO;
+    struct fat_dir_entry* entry = &((struct fat_dir_entry*)sector)[w->dir_index];
+    if (name) {
+        memset(entry, 0, sizeof(*entry));
+        memcpy(entry->name, name, 11);
+        entry->attr = 0x20; /* Archive */
+    }
+    stamp_entry(entry, name != NULL);
+    entry->cluster_hi = (uint16_t)(w->first_cluster >> 16);
+    entry->cluster_low = (uint16_t)(w->first_cluster & 0xFFFF);
+    entry->size = w->stored;
+    return disk_write_sector(w->dir_lba, sector) == 0 ? 0 : -EIO;
+}
+
+static int wr_open(fat_writer_t* w, uint8_t* sector, const char* path) {
+    if (disk_read_sector(current_lba, sector) != 0) return -EIO;
+    struct fat_bpb* bpb = (struct fat_bpb*)sector;
+    if (bpb->bytes_per_sector != 512 || bpb->sectors_per_cluster == 0) return -ENODEV;
+
+    w->bps = bpb->bytes_per_sector;
+    w->spc = bpb->sectors_per_cluster;
+    w->fats = bpb->fats_count;
+    w->fat_sectors = bpb->sectors_per_fat_32;
+    w->fat_start = current_lba + bpb->reserved_sectors;
+    w->data_start = w->fat_start + w->fats * w->fat_sectors;
+    uint32_t root_cluster = bpb->root_cluster;
+    uint32_t total = bpb->total_sectors_32 ? bpb->total_sectors_32 : bpb->total_sectors_16;
+    if (total <= w->data_start - current_lba) return -ENODEV;
+
+    /* Highest usable cluster: bounded by the data area and by the FAT */
+    w->max_cluster = (total - (w->data_start - current_lba)) / w->spc + 1;
+    if (w->max_cluster > w->fat_sectors * (w->bps / 4) - 1)
+        w->max_cluster = w->fat_sectors * (w->bps / 4) - 1;
+    w->next_free = 2;
+
+    uint32_t parent_cluster;
+    const char* fname;
+    int fname_len;
+    if (resolve_parent(path, root_cluster, w->data_start, w->fat_start, w->spc, w->bps,
+                       &parent_cluster, &fname, &fname_len) != 0 || fname_len == 0)
+        return -ENOENT;
+
+    char target[11];
+    to_dos_name_component(fname, fname_len, target);
+
+    uint32_t old_cluster;
+    int r = wr_dir_slot(w, sector, parent_cluster, target, &old_cluster);
+    if (r != 0) return r;
+
+    /* Truncate: release the old chain and start allocating where it was */
+    if (old_cluster >= 2) {
+        uint32_t c = old_cluster;
+        for (uint32_t n = 0; c >= 2 && c < 0x0FFFFFF8 && n < w->max_cluster; n++) {
+            uint32_t* e = wr_fat_entry(w, c);
+            if (!e) return -EIO;
+            uint32_t next = *e & 0x0FFFFFFF;
+            *e &= 0xF0000000;
+            w->fat_dirty = 1;
+            c = next;
+        }
+        w->next_free = old_cluster;
+    }
+
+    r = wr_fat_flush(w);
+    if (r == 0) r = wr_dir_update(w, sector, target);
+    return r;
+}
+
+extern "C" int fat32_writer_open(fat_writer_t* w, const char* path) {
+    if (!w || !path) return -EINVAL;
+    memset(w, 0, sizeof(*w));
+    w->inflight = -1;
+    w->fat_lba = 0xFFFFFFFF;
+    if (!is_fat_initialized) return -ENODEV;
+
+    uint8_t* sector = (uint8_t*)kmalloc(512);
+    w->buf[0] = (uint8_t*)kmalloc(FAT_WB_BUF);
+    w->buf[1] = (uint8_t*)kmalloc(FAT_WB_BUF);
+    int r = (sector && w->buf[0] && w->buf[1]) ? wr_open(w, sector, path) : -ENOMEM;
+
+    if (sector) kfree(sector);
+    if (r != 0) {
+        if (w->buf[0]) kfree(w->buf[0]);
+        if (w->buf[1]) kfree(w->buf[1]);
+        w->buf[0] = w->buf[1] = NULL;
+    }
+    return r;
+}
+
+extern "C" int fat32_writer_write(fat_writer_t* w, const void* data, uint32_t len) {
+    const uint8_t* in = (const uint8_t*)data;
+    if (w->error) return w->error;
+    if (!w->buf[0]) return -EBADF;
+
+    while (len > 0) {
+        uint32_t chunk = FAT_WB_BUF - w->fill;
+        if (chunk > len) chunk = len;
+        memcpy(w->buf[w->cur] + w->fill, in, chunk);
+        w->fill += chunk;
+        w->size += chunk;
+        in += chunk;
+        len -= chunk;
+
+        if (w->fill == FAT_WB_BUF) {
+            int r = wr_submit(w);
+            if (r != 0) {
+                w->error = r;
+                return r;
+            }
+        }
+    }
+    return 0;
+}
+
+extern "C" int fat32_writer_close(fat_writer_t* w) {
+    if (!w->buf[0]) return w->error ? w->error : -EBADF;
+    int r = w->error;
+
+    if (r == 0 && w->fill > 0) {
+        /* Zero the rest of the last sector */
+        uint32_t pad = (w->bps - w->fill % w->bps) % w->bps;
+        memset(w->buf[w->cur] + w->fill, 0, pad);
+        r = wr_submit(w);
+    }
+    int rw = wr_wait(w);
+    if (r == 0) r = rw;
+    int rf = wr_fat_flush(w);
+    if (r == 0) r = rf;
+
+    /* The entry only claims what reached the disk */
+    uint8_t* sector = (uint8_t*)kmalloc(512);
+    if (sector) {
+        int rd = wr_dir_update(w, sector, NULL);
+        if (r == 0) r = rd;
+        kfree(sector);
+    } else if (r == 0) {
+        r = -ENOMEM;
+    }
+    if (r == 0 && disk_flush() < 0) r = -EIO;
+
+    if (w->lost) {
+        /* Better a leak than DMA out of reused memory */
+        serial("[FAT] Write could not be stopped, keeping its buffers\n");
+    } else {
+        kfree(w->buf[0]);
+        kfree(w->buf[1]);
+    }
+    w->buf[0] = w->buf[1] = NULL;
+    w->error = r;
+    return r;
+}
+
 /* Încearcă să monteze automat prima partiție FAT găsită */
 void fat_automount(void) {
     if (is_fat_initialized) return;
@@ -1001,6 +1512,7 @@ void fat_automount(void) {
                 if (fat32_init(0, g_assigns[i].lba) == 0) {
                     is_fat_initialized = true;
                     current_lba = g_assigns[i].lba;
+                    fat_generation++;
                     current_letter = g_assigns[i].letter;
                     return;
                 }
@@ -1073,6 +1585,7 @@ extern "C" int cmd_fat(int argc, char **argv) {
             terminal_writestring("Mount successful.\n");
             is_fat_initialized = true;
             current_lba = lba;
+            fat_generation++;
             current_letter = letter;
         } else {
             terminal_writestring("Mount failed.\n");
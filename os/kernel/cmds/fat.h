@@ -47,6 +47,95 @@ int fat32_format(uint32_t lba, uint32_t sector_count, const char* label);
 /* Get file size (returns -1 if not found) */
 int32_t fat32_get_file_size(const char* path);
 
+/* Counter bumped by every write, format and mount. FAT times have two
+   second resolution and are not set without a clock, so anything cached
+   from file contents is only current while this has not moved. */
+uint32_t fat32_generation(void);
+
+/* Streaming handle: the path is resolved once and the cluster chain is
+   walked incrementally, so sequential reads never rescan the directory
+   or the FAT from the start. */
+#define FAT_READ_RUN_MAX 128   /* Sectors per disk command */
+
+typedef struct {
+    uint32_t first_cluster;
+    uint32_t size;
+    uint8_t  is_dir;
+    uint32_t mtime;     /* FAT date << 16 | FAT time of last write; 0 if never stamped */
+    uint32_t generation; /* fat32_generation() at open */
+
+    /* Volume geometry, captured at open */
+    uint32_t fat_start, data_start;
+    uint32_t spc, bps;
+
+    /* Chain cursor: cur_cluster is entry cur_index of the chain */
+    uint32_t cur_cluster, cur_index;
+
+    /* Last FAT sector read */
+    uint32_t fat_lba;
+    uint8_t  fat_cache[512];
+} fat_file_t;
+
+/* 0 on success, -1 if not mounted or not found. "/" opens the root. */
+int fat32_open(const char* path, fat_file_t* f);
+
+/* Read up to size bytes at offset. Whole sectors are transferred straight
+   into buf when it is 4-byte aligned, merging physically contiguous
+   clusters into a single command. Bytes read, or -1 on I/O error. */
+int fat32_read_at(fat_file_t* f, void* buf, uint32_t size, uint32_t offset);
+
+/* Streaming writer: data is gathered into one of two buffers; a full
+   buffer is given contiguous clusters and handed to the disk while the
+   caller fills the other one. The directory entry is written at open
+   (size 0) and completed at close. */
+#define FAT_WB_BUF (64 * 1024)   /* Bytes per write-behind buffer, one disk command */
+
+typedef struct {
+    /* Volume geometry, captured at open */
+    uint32_t fat_start, data_start;
+    uint32_t spc, bps;
+    uint32_t fats, fat_sectors;
+    uint32_t max_cluster;
+
+    /* Directory entry */
+    uint32_t dir_lba, dir_index;
+
+    /* Chain */
+    uint32_t first_cluster, last_cluster;
+    uint32_t next_free;                   /* Allocation hint */
+    uint32_t size;                        /* Bytes accepted */
+    uint32_t stored;                      /* Bytes written to the disk */
+
+    /* Write-behind */
+    uint8_t* buf[2];
+    uint32_t fill;                        /* Bytes in buf[cur] */
+    int cur;
+    int inflight;                         /* disk_write_poll() tag, -1 when idle */
+    uint32_t inflight_bytes;              /* File bytes in that write */
+    uint8_t  lost;                        /* A write could not be stopped: the
+                                             disk may still read the buffers */
+    int error;                            /* First error, sticky */
+
+    uint32_t disk_cmds, stall_ms;         /* Stats */
+
+    /* FAT sector cache, written to every FAT copy on flush */
+    uint32_t fat_lba;
+    uint8_t  fat_dirty;
+    uint8_t  fat_cache[512];
+} fat_writer_t;
+
+/* Create or truncate path. 0, or -ENODEV (not mounted), -ENOENT (parent
+   missing), -EISDIR, -ENOSPC, -ENOMEM, -EIO. */
+int fat32_writer_open(fat_writer_t* w, const char* path);
+
+/* Append len bytes. 0, or the first error seen (-ENOSPC, -EIO). */
+int fat32_writer_write(fat_writer_t* w, const void* data, uint32_t len);
+
+/* Flush the tail, the FAT and the directory entry and release the
+   buffers (leaked instead if the disk could not be made to let go of
+   them). 0 or -errno. */
+int fat32_writer_close(fat_writer_t* w);
+
 #ifdef __cplusplus
 }
 #endif
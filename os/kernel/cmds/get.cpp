@@ -1,323 +1,131 @@
 #include "get.h"
 #include "../terminal.h"
 #include "../string.h"
-#include "../mem/kmalloc.h"
-#include "../ethernet/net_device.h"
-#include "../ethernet/tcp.h"
-#include "../ethernet/dns.h"
+#include "../ethernet/http.h"
 #include "../ethernet/net.h"
 #include "fat.h"
-#include "../ethernet/tls.h"
-#include "../crypto/prng.h"
 
 extern "C" void serial(const char *fmt, ...);
-extern "C" uint64_t hpet_time_ms(void);
-extern "C" int atoi(const char* str);
 
-/* FAT32 API */
-extern "C" int fat32_create_file(const char* path, const void* data, uint32_t size);
-extern "C" void fat_automount(void);
+/* The body is streamed: each received segment is decoded and copied into
+   the FAT writer's current buffer; full buffers are written behind while
+   the next segments arrive. Memory use is fixed (two write buffers plus
+   one receive buffer) whatever the size of the download. */
 
-/* State Machine */
-enum {
-    STATE_CLOSED = 0,
-    STATE_SYN_SENT,
-    STATE_ESTABLISHED,
-    STATE_FIN_WAIT,
-    STATE_TLS_HANDSHAKE
-};
+#define GET_PROGRESS_MS 250    /* Progress line refresh */
 
-static volatile int tcp_state = STATE_CLOSED;
-static uint32_t my_seq = 0;
-static uint32_t server_seq = 0;
-static uint32_t server_ip_addr = 0;
-static uint16_t local_port = 0;
-static uint16_t remote_port = 0;
-static bool use_tls = false;
-static tls_context_t tls_ctx;
-static char target_hostname[128];
+typedef struct {
+    fat_writer_t writer;
+    http_decoder_t dec;
+    uint32_t start_ms;
+    uint32_t last_ms;
+} get_state_t;
 
-/* Download Buffer */
-#define DOWNLOAD_BUF_SIZE (25 * 1024 * 1024) /* 25MB limit */
-static uint8_t* dl_buffer = 0;
-static uint32_t dl_size = 0;
-static bool dl_complete = false;
+static get_state_t st;
 
-static void get_tcp_callback(uint32_t src_ip, uint16_t src_port, uint16_t dst_port, uint8_t flags, uint32_t seq, uint32_t ack, const uint8_t* data, size_t len) {
-    if (src_ip != server_ip_addr || dst_port != local_port) return;
+static int get_sink(void* ctx, const uint8_t* data, uint32_t len) {
+    return fat32_writer_write(&((get_state_t*)ctx)->writer, data, len);
+}
 
-    /* serial("[GET] TCP Packet flags=0x%x len=%d seq=%u ack=%u\n", flags, len, seq, ack); */
+static void print_rate(uint32_t bytes, uint32_t ms) {
+    if (ms == 0) ms = 1;
+    uint32_t kbs;
+    if (bytes < 4 * 1024 * 1024) kbs = bytes * 1000 / 1024 / ms;
+    else kbs = (bytes / 1024) * 1000 / ms;
+    if (kbs >= 1024) terminal_printf("%u.%u MB/s", kbs / 1024, (kbs % 1024) * 10 / 1024);
+    else terminal_printf("%u KB/s", kbs);
+}
 
-    if (tcp_state == STATE_SYN_SENT) {
-        if ((flags & TCP_FLAG_SYN) && (flags & TCP_FLAG_ACK)) {
-            server_seq = seq + 1;
-            my_seq = ack;
-            
-            if (use_tls) {
-                tcp_state = STATE_TLS_HANDSHAKE;
-                serial("[GET] TCP Established. Starting TLS Handshake...\n");
-                
-                /* Send Client Hello */
-                uint8_t* buf = (uint8_t*)kmalloc(512);
-                if (buf) {
-                    tls_init_context(&tls_ctx, server_ip_addr, remote_port);
-                    int len = tls_create_client_hello(&tls_ctx, target_hostname, buf, 512);
-                    if (len > 0) {
-                        net_device_t* dev = net_get_primary_device();
-                        tcp_send_packet(dev, server_ip_addr, local_port, remote_port, my_seq, server_seq, TCP_FLAG_ACK | TCP_FLAG_PSH, buf, len);
-                        my_seq += len;
-                    }
-                    kfree(buf);
-                }
-            } else {
-                tcp_state = STATE_ESTABLISHED;
-                serial("[GET] Connection established.\n");
-            }
-        }
-    }
-    else if (tcp_state == STATE_TLS_HANDSHAKE) {
-        if (len > 0) {
-            server_seq = seq + len;
-            /* Pass data to TLS engine */
-            tls_handle_rx(&tls_ctx, data, len);
-            /* ACK the packet */
-            net_device_t* dev = net_get_primary_device();
-            tcp_send_packet(dev, server_ip_addr, local_port, remote_port, my_seq, server_seq, TCP_FLAG_ACK, 0, 0);
-        }
-    }
-    else if (tcp_state == STATE_ESTABLISHED || tcp_state == STATE_FIN_WAIT) {
-        if (len > 0) {
-            /* Append data */
-            if (dl_size + len < DOWNLOAD_BUF_SIZE) {
-                memcpy(dl_buffer + dl_size, data, len);
-                dl_size += len;
-                /* serial("[GET] Received %d bytes (Total: %d)\n", len, dl_size); */
-            }
-            
-            /* Update sequence for ACK */
-            server_seq = seq + len;
-            
-            /* Send ACK */
-            net_device_t* dev = net_get_primary_device();
-            if (dev) {
-                tcp_send_packet(dev, server_ip_addr, local_port, remote_port, my_seq, server_seq, TCP_FLAG_ACK, 0, 0);
-            }
-        }
+static void get_progress(void* ctx, const http_decoder_t* d) {
+    get_state_t* s = (get_state_t*)ctx;
+    uint32_t now = net_time_ms();
+    if (now - s->last_ms < GET_PROGRESS_MS || d->status < 200 || d->status >= 300) return;
+    s->last_ms = now;
 
-        if (flags & TCP_FLAG_FIN) {
-            server_seq++; /* FIN consumes a sequence number */
-            /* Send ACK for FIN */
-            net_device_t* dev = net_get_primary_device();
-            if (dev) {
-                tcp_send_packet(dev, server_ip_addr, local_port, remote_port, my_seq, server_seq, TCP_FLAG_ACK, 0, 0);
-            }
-            tcp_state = STATE_CLOSED;
-            dl_complete = true;
-            serial("[GET] Connection closed by server.\n");
-        }
+    terminal_printf("\r  %u KB", d->received / 1024);
+    if (d->has_length && !d->chunked && d->content_length) {
+        terminal_printf(" / %u KB  %u%%", d->content_length / 1024,
+                        (d->received / 1024) * 100 / (d->content_length / 1024 + 1));
     }
+    terminal_writestring("  ");
+    print_rate(d->received, now - s->start_ms);
+    terminal_writestring("   ");
 }
 
-static uint32_t parse_ip_simple(const char* s) {
-    uint8_t bytes[4] = {0,0,0,0};
-    int idx = 0;
-    int val = 0;
-    while (*s) {
-        if (*s >= '0' && *s <= '9') val = val * 10 + (*s - '0');
-        else if (*s == '.') { bytes[idx++] = val; val = 0; if (idx >= 4) break; }
-        s++;
+/* Last path segment without the query, else index.html */
+static void pick_filename(const char* url, char* out, int max) {
+    const char* p = strstr(url, "://");
+    p = p ? p + 3 : url;
+    p = strchr(p, '/');
+    const char* name = NULL;
+    if (p) {
+        const char* slash = strrchr(p, '/');
+        name = slash + 1;
+    }
+    int n = 0;
+    if (name) {
+        while (name[n] && name[n] != '?' && name[n] != '#' && n < max - 1) {
+            out[n] = name[n];
+            n++;
+        }
     }
-    if (idx < 4) bytes[idx] = val;
-    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+    if (n == 0) {
+        strcpy(out, "index.html");
+        return;
+    }
+    out[n] = 0;
 }
 
 extern "C" int cmd_get(int argc, char** argv) {
     if (argc < 2) {
-        terminal_writestring("Usage: get <url>\n");
+        terminal_writestring("Usage: get <url> [file]\n");
         return -1;
     }
 
-    char* url = argv[1];
-    char hostname[128];
-    char path[256];
-    int port = 80;
-    use_tls = false;
-    
-    /* Parse URL (very basic) */
-    if (strncmp(url, "http://", 7) == 0) {
-        url += 7;
-    } else if (strncmp(url, "https://", 8) == 0) {
-        url += 8;
-        port = 443;
-        use_tls = true;
-    }
-    
-    char* slash = strchr(url, '/');
-    if (slash) {
-        int host_len = slash - url;
-        if (host_len > 127) host_len = 127;
-        strncpy(hostname, url, host_len);
-        hostname[host_len] = 0;
-        strncpy(path, slash, 255);
+    const char* url = argv[1];
+    char filename[64];
+    if (argc > 2) {
+        strncpy(filename, argv[2], sizeof(filename) - 1);
+        filename[sizeof(filename) - 1] = 0;
     } else {
-        strncpy(hostname, url, 127);
-        strcpy(path, "/");
-    }
-
-    /* Parse Port in Hostname */
-    char* colon = strchr(hostname, ':');
-    if (colon) {
-        *colon = 0;
-        port = atoi(colon + 1);
+        pick_filename(url, filename, sizeof(filename));
     }
 
-    /* Store hostname for SNI */
-    strncpy(target_hostname, hostname, 127);
-
-    terminal_printf("Host: %s\nPort: %d\nPath: %s\n", hostname, port, path);
-
-    /* Resolve DNS */
-    uint32_t ip = 0;
-    if (hostname[0] >= '0' && hostname[0] <= '9') {
-        ip = parse_ip_simple(hostname);
-    } else {
-        ip = dns_resolve(hostname);
-    }
+    /* Ensure FAT is mounted */
+    fat_automount();
 
-    if (ip == 0) {
-        terminal_writestring("Could not resolve host.\n");
+    int r = fat32_writer_open(&st.writer, filename);
+    if (r < 0) {
+        terminal_printf("get: cannot create '%s' (%d).\n", filename, r);
         return -1;
     }
 
-    terminal_printf("Connecting to %d.%d.%d.%d...\n", 
-        ip&0xFF, (ip>>8)&0xFF, (ip>>16)&0xFF, (ip>>24)&0xFF);
+    terminal_printf("Downloading %s -> '%s'\n", url, filename);
+    http_decoder_init(&st.dec, get_sink, &st);
+    st.start_ms = st.last_ms = net_time_ms();
 
-    /* Seed PRNG for TCP/TLS randomness */
-    prng_seed((uint32_t)hpet_time_ms());
+    int status = http_get(url, &st.dec, get_progress, &st);
+    uint32_t elapsed = net_time_ms() - st.start_ms;
+    int wr = fat32_writer_close(&st.writer);
+    terminal_writestring("\n");
 
-    /* Setup Buffer */
-    dl_buffer = (uint8_t*)kmalloc(DOWNLOAD_BUF_SIZE);
-    if (!dl_buffer) {
-        terminal_writestring("OOM: Cannot allocate download buffer.\n");
+    if (status < 0) {
+        terminal_printf("get: %s (%d), %u bytes kept.\n", http_strerror(status), status, st.writer.stored);
         return -1;
     }
-    dl_size = 0;
-    dl_complete = false;
-
-    /* Setup TCP */
-    server_ip_addr = ip;
-    local_port = 40000 + (prng_next() % 10000); /* Randomish port */
-    remote_port = port;
-    my_seq = prng_next();
-    server_seq = 0;
-    tcp_state = STATE_SYN_SENT;
-    
-    tcp_set_callback(get_tcp_callback);
-    
-    net_device_t* dev = net_get_primary_device();
-    if (!dev) {
-        kfree(dl_buffer);
+    if (status < 200 || status >= 300) {
+        terminal_printf("get: HTTP %d\n", status);
+        fat32_delete_file(filename);
         return -1;
     }
-
-    /* 1. Send SYN */
-    tcp_send_packet(dev, ip, local_port, remote_port, my_seq, 0, TCP_FLAG_SYN, 0, 0);
-    my_seq++;
-
-    /* Wait for connection */
-    uint64_t start = hpet_time_ms();
-    while (tcp_state == STATE_SYN_SENT && (hpet_time_ms() - start < 5000)) {
-        net_poll();
-        asm volatile("pause");
-    }
-
-    if (tcp_state != STATE_ESTABLISHED) {
-        terminal_writestring("Connection timed out.\n");
-        tcp_set_callback(NULL);
-        kfree(dl_buffer);
+    if (wr < 0) {
+        terminal_printf("get: %s (%d), %u bytes kept.\n", http_strerror(wr), wr, st.writer.stored);
         return -1;
     }
 
-    if (use_tls) {
-        terminal_writestring("TLS Handshake initiated...\n");
-        terminal_writestring("Note: Full crypto missing, connection will fail at Key Exchange.\n");
-        /* Wait loop for TLS would go here, but we stop since we can't finish it */
-        while(1) { net_poll(); asm volatile("pause"); }
-    }
-
-    /* 2. Send GET Request */
-    char req[512];
-    /* HTTP/1.0 to avoid chunked encoding complexity */
-    int req_len = 0;
-    
-    /* Simple sprintf manual construction */
-    strcpy(req, "GET ");
-    strcat(req, path);
-    strcat(req, " HTTP/1.0\r\nHost: ");
-    strcat(req, hostname);
-    strcat(req, "\r\nUser-Agent: ChrysalisOS/0.1\r\n\r\n");
-    req_len = strlen(req);
-
-    tcp_send_packet(dev, ip, local_port, remote_port, my_seq, server_seq, TCP_FLAG_ACK | TCP_FLAG_PSH, req, req_len);
-    my_seq += req_len;
-
-    terminal_writestring("Request sent. Downloading...\n");
-
-    /* 3. Wait for Data */
-    start = hpet_time_ms();
-    while (!dl_complete && (hpet_time_ms() - start < 10000)) { /* 10s timeout for data */
-        net_poll();
-        asm volatile("pause");
-        
-        /* Reset timeout if we keep receiving data */
-        /* (Simplified logic: just hard timeout for now) */
-    }
-
-    tcp_set_callback(NULL);
-
-    if (dl_size == 0) {
-        terminal_writestring("No data received.\n");
-        kfree(dl_buffer);
-        return -1;
-    }
-
-    terminal_printf("Downloaded %d bytes.\n", dl_size);
-
-    /* 4. Parse HTTP Header to find body */
-    uint8_t* body = dl_buffer;
-    uint32_t body_len = dl_size;
-    
-    for (uint32_t i = 0; i < dl_size - 4; i++) {
-        if (dl_buffer[i] == '\r' && dl_buffer[i+1] == '\n' && 
-            dl_buffer[i+2] == '\r' && dl_buffer[i+3] == '\n') {
-            body = dl_buffer + i + 4;
-            body_len = dl_size - (i + 4);
-            break;
-        }
-    }
-
-    /* 5. Save to File */
-    /* Extract filename from path */
-    char filename[32];
-    char* last_slash = strrchr(path, '/');
-    if (last_slash && *(last_slash+1)) {
-        strncpy(filename, last_slash + 1, 31);
-    } else {
-        strcpy(filename, "index.html");
-    }
-    
-    /* Ensure FAT is mounted */
-    fat_automount();
-    
-    terminal_printf("Saving to '%s' (%d bytes)...\n", filename, body_len);
-    
-    int r = fat32_create_file(filename, body, body_len);
-    if (r == 0) {
-        terminal_writestring("File saved successfully.\n");
-    } else {
-        terminal_printf("Error saving file (err=%d).\n", r);
-    }
-
-    kfree(dl_buffer);
+    terminal_printf("Saved '%s': %u bytes in %u ms (", filename, st.writer.stored, elapsed);
+    print_rate(st.writer.stored, elapsed);
+    terminal_printf("), %u disk writes, %u ms waiting on disk.\n",
+                    st.writer.disk_cmds, st.writer.stall_ms);
     return 0;
-}
\ No newline at end of file
+}
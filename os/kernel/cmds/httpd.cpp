@@ -0,0 +1,194 @@
+#include "httpd.h"
+#include "../terminal.h"
+#include "../string.h"
+#include "../mem/kmalloc.h"
+#include "../ethernet/httpd.h"
+#include "../ethernet/socket.h"
+#include "../ethernet/eth.h"
+#include "../ethernet/net.h"
+#include <errno.h>
+
+extern "C" int atoi(const char* str);
+
+/* Loopback client for "httpd bench": keep-alive, HB_PIPELINE requests in flight */
+#define HB_ADDR_LO      0x0100007F  /* 127.0.0.1 */
+#define HB_PIPELINE     8
+#define HB_RECV_CHUNK   16384
+#define HB_HEAD_MAX     1024
+#define HB_REQ_MAX      300
+
+static void usage(void) {
+    terminal_writestring("Usage: httpd start [port] [workers] [root]\n");
+    terminal_writestring("       httpd stop\n");
+    terminal_writestring("       httpd stat\n");
+    terminal_writestring("       httpd bench [path] [requests]\n");
+}
+
+/* Content-Length of a response head, or -1 */
+static int head_content_length(const char* h) {
+    for (const char* p = h; *p; p++) {
+        if ((p == h || p[-1] == '\n') && (strncmp(p, "Content-Length:", 15) == 0 ||
+                                          strncmp(p, "content-length:", 15) == 0)) {
+            p += 15;
+            while (*p == ' ') p++;
+            return atoi(p);
+        }
+    }
+    return -1;
+}
+
+static int bench(const char* path, int count) {
+    int port = httpd_running();
+    if (!port) {
+        terminal_writestring("httpd: not running\n");
+        return -1;
+    }
+    if (strlen(path) > HB_REQ_MAX - 64) {
+        terminal_writestring("httpd: path too long\n");
+        return -1;
+    }
+
+    char req[HB_REQ_MAX];
+    strcpy(req, "GET ");
+    strcat(req, path);
+    strcat(req, " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    int req_len = (int)strlen(req);
+
+    char* buf = (char*)kmalloc(HB_RECV_CHUNK);
+    char* head = (char*)kmalloc(HB_HEAD_MAX + 1);
+    int fd = sock_socket(AF_INET, SOCK_STREAM, 0);
+    if (!buf || !head || fd < 0) {
+        terminal_writestring("httpd: out of memory or sockets\n");
+        if (buf) kfree(buf);
+        if (head) kfree(head);
+        if (fd >= 0) sock_close(fd);
+        return -1;
+    }
+
+    sockaddr_in_t addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr = HB_ADDR_LO;
+    sock_set_timeout(fd, 5000);
+
+    int ret = -1;
+    int sent = 0, done = 0, errors = 0;
+    int head_len = 0, body_left = -1;   /* -1: reading a head */
+    uint32_t bytes = 0;
+    uint32_t t0 = net_time_ms();
+
+    if (sock_connect(fd, &addr) < 0) {
+        terminal_printf("httpd: cannot connect to 127.0.0.1:%d\n", port);
+        goto out;
+    }
+
+    while (done < count) {
+        while (sent < count && sent - done < HB_PIPELINE) {
+            if (sock_send(fd, req, req_len, 0) != req_len) goto out;
+            sent++;
+        }
+
+        int n = sock_recv(fd, buf, HB_RECV_CHUNK, 0);
+        if (n <= 0) {
+            terminal_printf("httpd: connection lost after %d responses\n", done);
+            goto out;
+        }
+
+        for (int i = 0; i < n; ) {
+            if (body_left < 0) {
+                /* Accumulate the head up to the blank line */
+                while (i < n && head_len < HB_HEAD_MAX) {
+                    head[head_len++] = buf[i++];
+                    if (head_len >= 4 && memcmp(head + head_len - 4, "\r\n\r\n", 4) == 0) break;
+                }
+                head[head_len] = 0;
+                if (head_len >= 4 && memcmp(head + head_len - 4, "\r\n\r\n", 4) == 0) {
+                    if (strncmp(head + 9, "200", 3) != 0) errors++;
+                    body_left = head_content_length(head);
+                    if (body_left < 0) {
+                        terminal_writestring("httpd: response without Content-Length\n");
+                        goto out;
+                    }
+                    head_len = 0;
+                } else if (head_len >= HB_HEAD_MAX) {
+                    terminal_writestring("httpd: response head too large\n");
+                    goto out;
+                } else {
+                    continue;
+                }
+            }
+
+            int take = n - i < body_left ? n - i : body_left;
+            i += take;
+            body_left -= take;
+            bytes += take;
+            if (body_left == 0) {
+                body_left = -1;
+                done++;
+            }
+        }
+    }
+    ret = 0;
+
+out: {
+        uint32_t ms = net_time_ms() - t0;
+        if (ms == 0) ms = 1;
+        uint32_t kbps = (uint32_t)((uint64_t)bytes * 1000 / 1024 / ms);
+        terminal_printf("httpd bench: %d requests (%d not 200), %u bytes in %u ms\n", done, errors, bytes, ms);
+        terminal_printf("  %u req/s, %u.%u MB/s\n", (uint32_t)((uint64_t)done * 1000 / ms),
+                        kbps / 1024, (kbps % 1024) * 10 / 1024);
+    }
+    sock_close(fd);
+    kfree(buf);
+    kfree(head);
+    return ret;
+}
+
+extern "C" int cmd_httpd(int argc, char** argv) {
+    const char* sub = argc > 1 ? argv[1] : "stat";
+
+    if (strcmp(sub, "start") == 0) {
+        int port = argc > 2 ? atoi(argv[2]) : HTTPD_PORT_DEFAULT;
+        int workers = argc > 3 ? atoi(argv[3]) : HTTPD_WORKERS_DEFAULT;
+        const char* root = argc > 4 ? argv[4] : "/";
+        if (port <= 0 || port > 65535 || workers <= 0) {
+            usage();
+            return -1;
+        }
+
+        int r = httpd_start((uint16_t)port, root, workers);
+        if (r == -EALREADY) terminal_writestring("httpd: already running\n");
+        else if (r == -ENODEV) terminal_printf("httpd: %s is not a directory on a mounted FAT volume\n", root);
+        else if (r == -EADDRINUSE) terminal_printf("httpd: port %d in use\n", port);
+        else if (r < 0) terminal_printf("httpd: start failed (%d)\n", r);
+        else terminal_printf("httpd: serving %s on port %d with %d workers\n", root, port,
+                             workers > HTTPD_MAX_WORKERS ? HTTPD_MAX_WORKERS : workers);
+        return r < 0 ? -1 : 0;
+    }
+
+    if (strcmp(sub, "stop") == 0) {
+        if (!httpd_running()) {
+            terminal_writestring("httpd: not running\n");
+            return -1;
+        }
+        httpd_stop();
+        terminal_writestring("httpd: stopped\n");
+        return 0;
+    }
+
+    if (strcmp(sub, "stat") == 0) {
+        httpd_print_stats();
+        return 0;
+    }
+
+    if (strcmp(sub, "bench") == 0) {
+        const char* path = argc > 2 ? argv[2] : "/";
+        int count = argc > 3 ? atoi(argv[3]) : 1000;
+        if (count <= 0) count = 1000;
+        return bench(path, count);
+    }
+
+    usage();
+    return -1;
+}
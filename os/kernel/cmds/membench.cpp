@@ -0,0 +1,220 @@
+#include "membench.h"
+#include "../terminal.h"
+#include "../string.h"
+#include "../mem/kmalloc.h"
+#include "../hardware/sse.h"
+#include "../ethernet/net.h"
+
+/* Throughput of each memcpy/memset variant, and of the word-at-a-time
+   string routines against their byte loops. Every size is repeated until
+   MB_BYTES_PER_SIZE bytes have moved, so small sizes include call overhead. */
+
+#define MB_MAX_SIZE        (4u * 1024 * 1024)
+#define MB_BYTES_PER_SIZE  (64u * 1024 * 1024)
+#define MB_STR_LEN         4096
+#define MB_COL             10
+
+typedef void* (*copy_fn)(void*, const void*, size_t);
+typedef void* (*set_fn)(void*, int, size_t);
+
+static const uint32_t sizes[] = { 64, 1024, 16 * 1024, 256 * 1024, MB_MAX_SIZE };
+#define MB_NUM_SIZES (int)(sizeof(sizes) / sizeof(sizes[0]))
+
+static uint32_t tsc_per_us = 0;
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static void calibrate_tsc(void) {
+    if (tsc_per_us) return;
+    uint32_t start = net_time_ms();
+    while (net_time_ms() == start) asm volatile("pause");
+    start = net_time_ms();
+    uint64_t t0 = rdtsc();
+    while (net_time_ms() - start < 100) asm volatile("pause");
+    uint64_t cycles = rdtsc() - t0;
+    tsc_per_us = (uint32_t)(cycles / 100000);
+    if (tsc_per_us == 0) tsc_per_us = 1;
+}
+
+/* Bytes per microsecond is (decimal) MB/s */
+static uint32_t mb_per_s(uint64_t bytes, uint64_t cycles) {
+    uint64_t us = cycles / tsc_per_us;
+    if (us == 0) us = 1;
+    return (uint32_t)(bytes / us);
+}
+
+static int fmt_u32(char* out, uint32_t v) {
+    char tmp[10];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    for (int i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+    out[n] = 0;
+    return n;
+}
+
+static void print_col(const char* s) {
+    int len = (int)strlen(s);
+    for (int i = len; i < MB_COL; i++) terminal_putchar(' ');
+    terminal_writestring(s);
+}
+
+static void print_col_u32(uint32_t v) {
+    char buf[12];
+    fmt_u32(buf, v);
+    print_col(buf);
+}
+
+/* Left-aligned size label, 8 columns wide */
+static void print_size(uint32_t n) {
+    char buf[12];
+    const char* unit = " B";
+    if (n >= 1024 * 1024) { n /= 1024 * 1024; unit = " MB"; }
+    else if (n >= 1024) { n /= 1024; unit = " KB"; }
+    int len = fmt_u32(buf, n);
+    terminal_writestring(buf);
+    terminal_writestring(unit);
+    for (len += (int)strlen(unit); len < 8; len++) terminal_putchar(' ');
+}
+
+static uint32_t run_copy(copy_fn fn, uint8_t* dst, const uint8_t* src, uint32_t n) {
+    uint32_t reps = MB_BYTES_PER_SIZE / n;
+    fn(dst, src, n);                         /* warm up */
+    uint64_t t0 = rdtsc();
+    for (uint32_t i = 0; i < reps; i++) fn(dst, src, n);
+    return mb_per_s((uint64_t)reps * n, rdtsc() - t0);
+}
+
+static uint32_t run_set(set_fn fn, uint8_t* dst, uint32_t n) {
+    uint32_t reps = MB_BYTES_PER_SIZE / n;
+    fn(dst, 0x5A, n);
+    uint64_t t0 = rdtsc();
+    for (uint32_t i = 0; i < reps; i++) fn(dst, (int)(i & 0xFF), n);
+    return mb_per_s((uint64_t)reps * n, rdtsc() - t0);
+}
+
+static void bench_copy(uint8_t* dst, const uint8_t* src, bool sse2) {
+    static const char* names[] = { "bytes", "movsd", "movsb", "sse2", "sse2-nt", "memcpy" };
+    copy_fn fns[] = { memcpy_bytes, memcpy_rep, memcpy_erms, memcpy_sse2, memcpy_nt, memcpy };
+
+    terminal_writestring("memcpy (MB/s):\n  size  ");
+    for (int v = 0; v < 6; v++) print_col(names[v]);
+    terminal_putchar('\n');
+
+    for (int s = 0; s < MB_NUM_SIZES; s++) {
+        terminal_writestring("  ");
+        print_size(sizes[s]);
+        for (int v = 0; v < 6; v++) {
+            if ((v == 3 || v == 4) && !sse2) print_col("-");
+            else print_col_u32(run_copy(fns[v], dst, src, sizes[s]));
+        }
+        terminal_putchar('\n');
+    }
+}
+
+static void bench_set(uint8_t* dst, bool sse2) {
+    static const char* names[] = { "bytes", "stosd", "stosb", "sse2", "sse2-nt", "memset" };
+    set_fn fns[] = { memset_bytes, memset_rep, memset_erms, memset_sse2, memset_nt, memset };
+
+    terminal_writestring("memset (MB/s):\n  size  ");
+    for (int v = 0; v < 6; v++) print_col(names[v]);
+    terminal_putchar('\n');
+
+    for (int s = 0; s < MB_NUM_SIZES; s++) {
+        terminal_writestring("  ");
+        print_size(sizes[s]);
+        for (int v = 0; v < 6; v++) {
+            if ((v == 3 || v == 4) && !sse2) print_col("-");
+            else print_col_u32(run_set(fns[v], dst, sizes[s]));
+        }
+        terminal_putchar('\n');
+    }
+}
+
+static void bench_str(uint8_t* a, uint8_t* b) {
+    const uint32_t reps = MB_BYTES_PER_SIZE / MB_STR_LEN / 4;
+    volatile uint32_t sink = 0;
+
+    memset(a, 'x', MB_STR_LEN);
+    a[MB_STR_LEN] = 0;
+    memcpy(b, a, MB_STR_LEN + 1);
+
+    terminal_writestring("strings, 4 KB (MB/s):\n");
+    terminal_writestring("          ");
+    print_col("bytes");
+    print_col("word");
+    terminal_putchar('\n');
+
+    uint64_t t0 = rdtsc();
+    for (uint32_t i = 0; i < reps; i++) sink += strlen_bytes((const char*)a);
+    uint32_t slow = mb_per_s((uint64_t)reps * MB_STR_LEN, rdtsc() - t0);
+    t0 = rdtsc();
+    for (uint32_t i = 0; i < reps; i++) sink += strlen((const char*)a);
+    uint32_t fast = mb_per_s((uint64_t)reps * MB_STR_LEN, rdtsc() - t0);
+    terminal_writestring("  strlen  ");
+    print_col_u32(slow);
+    print_col_u32(fast);
+    terminal_putchar('\n');
+
+    t0 = rdtsc();
+    for (uint32_t i = 0; i < reps; i++) sink += memcmp_bytes(a, b, MB_STR_LEN);
+    slow = mb_per_s((uint64_t)reps * MB_STR_LEN, rdtsc() - t0);
+    t0 = rdtsc();
+    for (uint32_t i = 0; i < reps; i++) sink += memcmp(a, b, MB_STR_LEN);
+    fast = mb_per_s((uint64_t)reps * MB_STR_LEN, rdtsc() - t0);
+    terminal_writestring("  memcmp  ");
+    print_col_u32(slow);
+    print_col_u32(fast);
+    terminal_putchar('\n');
+
+    t0 = rdtsc();
+    for (uint32_t i = 0; i < reps; i++) sink += strcmp((const char*)a, (const char*)b);
+    fast = mb_per_s((uint64_t)reps * MB_STR_LEN, rdtsc() - t0);
+    terminal_writestring("  strcmp  ");
+    print_col("-");
+    print_col_u32(fast);
+    terminal_putchar('\n');
+    (void)sink;
+}
+
+extern "C" int cmd_membench(int argc, char** argv) {
+    const char* which = argc > 1 ? argv[1] : "all";
+    bool all = strcmp(which, "all") == 0;
+    bool run_copy_b = all || strcmp(which, "copy") == 0;
+    bool run_set_b = all || strcmp(which, "set") == 0;
+    bool run_str_b = all || strcmp(which, "str") == 0;
+    if (!run_copy_b && !run_set_b && !run_str_b) {
+        terminal_writestring("Usage: membench [copy|set|str|all]\n");
+        return -1;
+    }
+
+    /* Page-aligned so every variant sees the same alignment */
+    uint8_t* src = (uint8_t*)kmalloc_aligned(MB_MAX_SIZE, 4096);
+    uint8_t* dst = (uint8_t*)kmalloc_aligned(MB_MAX_SIZE, 4096);
+    if (!src || !dst) {
+        terminal_writestring("membench: OOM\n");
+        if (src) kfree(src);
+        if (dst) kfree(dst);
+        return -1;
+    }
+    for (uint32_t i = 0; i < MB_MAX_SIZE; i++) src[i] = (uint8_t)i;
+
+    bool sse2 = cpu_has_sse2();
+    calibrate_tsc();
+    terminal_printf("membench: TSC %u MHz, memcpy/memset: %s%s\n", tsc_per_us,
+                    mem_impl_name(), cpu_has_erms() ? ", ERMS" : "");
+
+    if (run_copy_b) bench_copy(dst, src, sse2);
+    if (run_set_b) bench_set(dst, sse2);
+    if (run_str_b) bench_str(src, dst);
+
+    kfree(src);
+    kfree(dst);
+    return 0;
+}
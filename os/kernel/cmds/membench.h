@@ -0,0 +1,11 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int cmd_membench(int argc, char** argv);
+
+#ifdef __cplusplus
+}
+#endif
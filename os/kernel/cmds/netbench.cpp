@@ -0,0 +1,305 @@
+#include "netbench.h"
+#include "../terminal.h"
+#include "../string.h"
+#include "../mem/kmalloc.h"
+#include "../ethernet/socket.h"
+#include "../ethernet/eth.h"
+#include "../ethernet/net.h"
+#include "../ethernet/drivers/loopback.h"
+#include <errno.h>
+
+extern "C" void serial(const char *fmt, ...);
+
+/* Loopback throughput/latency harness: every run goes through the full
+   socket -> UDP/TCP -> IPv4 -> Ethernet -> lo -> RX softirq path. */
+
+#define NB_ADDR_LO       0x0100007F  /* 127.0.0.1 */
+#define NB_UDP_PORT      9000
+#define NB_TCP_PORT      9001
+#define NB_UDP_PAYLOAD   1024
+#define NB_UDP_PACKETS   20000
+#define NB_UDP_BURST     32          /* Matches SOCK_DGRAM_QUEUE */
+#define NB_TCP_BYTES     (16u * 1024 * 1024)
+#define NB_TCP_CHUNK     16384
+#define NB_RTT_SAMPLES   1000
+#define NB_RTT_PAYLOAD   64
+#define NB_STALL_MS      3000
+
+static uint32_t tsc_per_us = 0;
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static void calibrate_tsc(void) {
+    if (tsc_per_us) return;
+    uint32_t start = net_time_ms();
+    while (net_time_ms() == start) asm volatile("pause");
+    start = net_time_ms();
+    uint64_t t0 = rdtsc();
+    while (net_time_ms() - start < 100) asm volatile("pause");
+    uint64_t cycles = rdtsc() - t0;
+    tsc_per_us = (uint32_t)(cycles / 100000);
+    if (tsc_per_us == 0) tsc_per_us = 1;
+}
+
+static uint32_t cycles_to_us(uint64_t c) {
+    return (uint32_t)(c / tsc_per_us);
+}
+
+static uint32_t cycles_to_ns(uint64_t c) {
+    return (uint32_t)(c * 1000 / tsc_per_us);
+}
+
+static void sort_u32(uint32_t* a, int n) {
+    for (int gap = n / 2; gap > 0; gap /= 2) {
+        for (int i = gap; i < n; i++) {
+            uint32_t v = a[i];
+            int j = i;
+            while (j >= gap && a[j - gap] > v) {
+                a[j] = a[j - gap];
+                j -= gap;
+            }
+            a[j] = v;
+        }
+    }
+}
+
+static sockaddr_in_t lo_addr(uint16_t port) {
+    sockaddr_in_t a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr = NB_ADDR_LO;
+    return a;
+}
+
+static void report_throughput(const char* name, uint64_t cycles, uint32_t frames, uint32_t bytes) {
+    uint32_t us = cycles_to_us(cycles);
+    if (us == 0) us = 1;
+    uint32_t pps = (uint32_t)((uint64_t)frames * 1000000 / us);
+    uint32_t kbps = (uint32_t)((uint64_t)bytes * 1000000 / 1024 / us);
+    terminal_printf("  %s: %u bytes in %u ms, %u pkt/s, %u.%u MB/s\n",
+                    name, bytes, us / 1000, pps, kbps / 1024, (kbps % 1024) * 10 / 1024);
+}
+
+static void report_rtt(const char* name, uint32_t* samples, int n) {
+    if (n == 0) {
+        terminal_printf("  %s: no samples\n", name);
+        return;
+    }
+    sort_u32(samples, n);
+    uint32_t p50 = samples[n / 2];
+    uint32_t p99 = samples[(n * 99) / 100];
+    terminal_printf("  %s: %d samples, p50 %u.%u us, p99 %u.%u us, max %u.%u us\n", name, n,
+                    p50 / 1000, (p50 % 1000) / 100, p99 / 1000, (p99 % 1000) / 100,
+                    samples[n - 1] / 1000, (samples[n - 1] % 1000) / 100);
+}
+
+static int bench_udp(net_device_t* lo, uint8_t* buf, uint32_t* samples) {
+    int srv = sock_socket(AF_INET, SOCK_DGRAM, 0);
+    int cli = sock_socket(AF_INET, SOCK_DGRAM, 0);
+    if (srv < 0 || cli < 0) {
+        terminal_writestring("netbench: out of sockets\n");
+        if (srv >= 0) sock_close(srv);
+        if (cli >= 0) sock_close(cli);
+        return -1;
+    }
+
+    sockaddr_in_t addr = lo_addr(NB_UDP_PORT);
+    if (sock_bind(srv, &addr) < 0 || sock_connect(cli, &addr) < 0) {
+        terminal_writestring("netbench: UDP port busy\n");
+        sock_close(srv);
+        sock_close(cli);
+        return -1;
+    }
+
+    terminal_writestring("UDP over lo:\n");
+
+    /* Throughput: bursts sized to the receive queue, drained after every burst */
+    uint32_t sent = 0, recvd = 0;
+    uint32_t frames0 = lo->rx_packets;
+    uint64_t t0 = rdtsc();
+    uint32_t last_progress = net_time_ms();
+
+    while (recvd < NB_UDP_PACKETS) {
+        for (int i = 0; i < NB_UDP_BURST && sent < NB_UDP_PACKETS; i++) {
+            if (sock_send(cli, buf, NB_UDP_PAYLOAD, 0) < 0) break;
+            sent++;
+        }
+        net_poll();
+        int n;
+        while ((n = sock_recv(srv, buf, NB_UDP_PAYLOAD, MSG_DONTWAIT)) > 0) {
+            recvd++;
+            last_progress = net_time_ms();
+        }
+        if (sent == NB_UDP_PACKETS && net_time_ms() - last_progress > NB_STALL_MS) break;
+    }
+    uint64_t cycles = rdtsc() - t0;
+    report_throughput("throughput", cycles, lo->rx_packets - frames0, recvd * NB_UDP_PAYLOAD);
+    if (recvd != sent) terminal_printf("  lost %u of %u datagrams\n", sent - recvd, sent);
+
+    /* Latency: request/response ping-pong */
+    sock_set_timeout(srv, 1000);
+    sock_set_timeout(cli, 1000);
+    int n_samples = 0;
+    for (int i = 0; i < NB_RTT_SAMPLES; i++) {
+        sockaddr_in_t from;
+        uint64_t t = rdtsc();
+        if (sock_send(cli, buf, NB_RTT_PAYLOAD, 0) < 0) break;
+        int n = sock_recvfrom(srv, buf, NB_UDP_PAYLOAD, 0, &from);
+        if (n <= 0) break;
+        if (sock_sendto(srv, buf, n, 0, &from) < 0) break;
+        if (sock_recv(cli, buf, NB_UDP_PAYLOAD, 0) <= 0) break;
+        samples[n_samples++] = cycles_to_ns(rdtsc() - t);
+    }
+    report_rtt("rtt", samples, n_samples);
+
+    sock_close(srv);
+    sock_close(cli);
+    return 0;
+}
+
+static int bench_tcp(net_device_t* lo, uint8_t* buf, uint8_t* rbuf, uint32_t* samples) {
+    int lfd = sock_socket(AF_INET, SOCK_STREAM, 0);
+    int cfd = sock_socket(AF_INET, SOCK_STREAM, 0);
+    int sfd = -1;
+    int ret = -1;
+    if (lfd < 0 || cfd < 0) {
+        terminal_writestring("netbench: out of sockets\n");
+        goto out;
+    }
+
+    {
+        sockaddr_in_t addr = lo_addr(NB_TCP_PORT);
+        if (sock_bind(lfd, &addr) < 0 || sock_listen(lfd, 1) < 0) {
+            terminal_writestring("netbench: TCP port busy\n");
+            goto out;
+        }
+
+        sock_set_timeout(cfd, 2000);
+        sock_set_timeout(lfd, 2000);
+        uint64_t t_conn = rdtsc();
+        int r = sock_connect(cfd, &addr);
+        if (r < 0) {
+            terminal_printf("netbench: connect failed (%d)\n", r);
+            goto out;
+        }
+        sfd = sock_accept(lfd, NULL);
+        if (sfd < 0) {
+            terminal_printf("netbench: accept failed (%d)\n", sfd);
+            goto out;
+        }
+
+        terminal_writestring("TCP over lo:\n");
+        uint32_t setup = cycles_to_ns(rdtsc() - t_conn);
+        terminal_printf("  connect+accept: %u.%u us\n", setup / 1000, (setup % 1000) / 100);
+    }
+
+    {
+        /* Bulk transfer, sender and receiver interleaved on this CPU */
+        uint32_t sent = 0, recvd = 0;
+        uint32_t frames0 = lo->rx_packets;
+        uint32_t last_progress = net_time_ms();
+        uint64_t t0 = rdtsc();
+
+        while (recvd < NB_TCP_BYTES) {
+            if (sent < NB_TCP_BYTES) {
+                uint32_t want = NB_TCP_BYTES - sent;
+                if (want > NB_TCP_CHUNK) want = NB_TCP_CHUNK;
+                int n = sock_send(cfd, buf, want, MSG_DONTWAIT);
+                if (n > 0) sent += n;
+            }
+            int n = sock_recv(sfd, rbuf, NB_TCP_CHUNK, MSG_DONTWAIT);
+            if (n > 0) {
+                recvd += n;
+                last_progress = net_time_ms();
+            } else if (n != -EAGAIN) {
+                break;
+            }
+            net_poll();
+            if (net_time_ms() - last_progress > NB_STALL_MS) {
+                terminal_writestring("  transfer stalled\n");
+                break;
+            }
+        }
+        uint64_t cycles = rdtsc() - t0;
+        report_throughput("throughput", cycles, lo->rx_packets - frames0, recvd);
+    }
+
+    {
+        /* Latency: small request/response exchanges on the open connection */
+        sock_set_timeout(cfd, 1000);
+        sock_set_timeout(sfd, 1000);
+        int n_samples = 0;
+        for (int i = 0; i < NB_RTT_SAMPLES; i++) {
+            uint64_t t = rdtsc();
+            if (sock_send(cfd, buf, NB_RTT_PAYLOAD, 0) != NB_RTT_PAYLOAD) break;
+            int got = 0;
+            while (got < NB_RTT_PAYLOAD) {
+                int n = sock_recv(sfd, rbuf, NB_RTT_PAYLOAD - got, 0);
+                if (n <= 0) break;
+                got += n;
+            }
+            if (got < NB_RTT_PAYLOAD || sock_send(sfd, rbuf, got, 0) != got) break;
+            got = 0;
+            while (got < NB_RTT_PAYLOAD) {
+                int n = sock_recv(cfd, rbuf, NB_RTT_PAYLOAD - got, 0);
+                if (n <= 0) break;
+                got += n;
+            }
+            if (got < NB_RTT_PAYLOAD) break;
+            samples[n_samples++] = cycles_to_ns(rdtsc() - t);
+        }
+        report_rtt("rtt", samples, n_samples);
+    }
+    ret = 0;
+
+out:
+    if (sfd >= 0) sock_close(sfd);
+    if (cfd >= 0) sock_close(cfd);
+    if (lfd >= 0) sock_close(lfd);
+    return ret;
+}
+
+extern "C" int cmd_netbench(int argc, char** argv) {
+    const char* which = argc > 1 ? argv[1] : "all";
+    bool run_udp = strcmp(which, "all") == 0 || strcmp(which, "udp") == 0;
+    bool run_tcp = strcmp(which, "all") == 0 || strcmp(which, "tcp") == 0;
+    if (!run_udp && !run_tcp) {
+        terminal_writestring("Usage: netbench [udp|tcp|all]\n");
+        return -1;
+    }
+
+    net_device_t* lo = loopback_get_device();
+    if (!lo) {
+        terminal_writestring("netbench: loopback device not initialized\n");
+        return -1;
+    }
+
+    uint8_t* buf = (uint8_t*)kmalloc(NB_TCP_CHUNK);
+    uint8_t* rbuf = (uint8_t*)kmalloc(NB_TCP_CHUNK);
+    uint32_t* samples = (uint32_t*)kmalloc(NB_RTT_SAMPLES * sizeof(uint32_t));
+    if (!buf || !rbuf || !samples) {
+        terminal_writestring("netbench: OOM\n");
+        if (buf) kfree(buf);
+        if (rbuf) kfree(rbuf);
+        if (samples) kfree(samples);
+        return -1;
+    }
+    for (int i = 0; i < NB_TCP_CHUNK; i++) buf[i] = (uint8_t)i;
+
+    calibrate_tsc();
+    terminal_printf("netbench: TSC %u MHz\n", tsc_per_us);
+
+    int r = 0;
+    if (run_udp && bench_udp(lo, buf, samples) < 0) r = -1;
+    if (run_tcp && bench_tcp(lo, buf, rbuf, samples) < 0) r = -1;
+
+    kfree(buf);
+    kfree(rbuf);
+    kfree(samples);
+    return r;
+}
@@ -0,0 +1,90 @@
+#include "netcap.h"
+#include "../terminal.h"
+#include "../string.h"
+#include "../ethernet/netcap.h"
+#include <errno.h>
+
+extern "C" int atoi(const char* str);
+
+static void usage(void) {
+    terminal_writestring("Usage: netcap start [-w file.pcap | -serial] [-s snaplen] [-b ring_kb] [filter...]\n");
+    terminal_writestring("       netcap stop\n");
+    terminal_writestring("       netcap save <file.pcap>\n");
+    terminal_writestring("       netcap stat\n");
+    terminal_writestring("Filter: arp ip icmp tcp udp rx tx, [src|dst] port N, [src|dst] host A.B.C.D, not\n");
+}
+
+static int start(int argc, char** argv) {
+    int sink = NETCAP_SINK_RING;
+    const char* path = NULL;
+    int snap = 0, ring_kb = 0;
+    int i = 2;
+
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-serial") == 0) {
+            sink = NETCAP_SINK_SERIAL;
+        } else if (i + 1 < argc && strcmp(argv[i], "-w") == 0) {
+            sink = NETCAP_SINK_FILE;
+            path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            snap = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-b") == 0) {
+            ring_kb = atoi(argv[++i]);
+        } else {
+            usage();
+            return -1;
+        }
+    }
+    if (snap < 0 || ring_kb < 0) {
+        usage();
+        return -1;
+    }
+
+    netcap_filter_t f;
+    int bad = 0;
+    if (netcap_filter_parse(argc - i, argv + i, &f, &bad) != 0) {
+        terminal_printf("netcap: bad filter near '%s'\n", i + bad < argc ? argv[i + bad] : "");
+        return -1;
+    }
+
+    int r = netcap_start(&f, (uint32_t)snap, (uint32_t)ring_kb * 1024, sink, path);
+    if (r == -EALREADY) terminal_writestring("netcap: already capturing\n");
+    else if (r == -ENODEV) terminal_writestring(sink == NETCAP_SINK_SERIAL ? "netcap: no COM2 port\n"
+                                                                          : "netcap: no FAT volume mounted\n");
+    else if (r < 0) terminal_printf("netcap: start failed (%d)\n", r);
+    else if (sink == NETCAP_SINK_FILE) terminal_printf("netcap: capturing to %s\n", path);
+    else if (sink == NETCAP_SINK_SERIAL) terminal_writestring("netcap: streaming pcap on COM2\n");
+    else terminal_writestring("netcap: capturing to memory, 'netcap save <file>' to export\n");
+    return r < 0 ? -1 : 0;
+}
+
+extern "C" int cmd_netcap(int argc, char** argv) {
+    const char* sub = argc > 1 ? argv[1] : "stat";
+
+    if (strcmp(sub, "start") == 0) return start(argc, argv);
+
+    if (strcmp(sub, "stop") == 0) {
+        int r = netcap_stop();
+        if (r == -EALREADY) terminal_writestring("netcap: not capturing\n");
+        else if (r < 0) terminal_printf("netcap: stopped, sink error (%d)\n", r);
+        else terminal_writestring("netcap: stopped\n");
+        netcap_print_stats();
+        return r < 0 ? -1 : 0;
+    }
+
+    if (strcmp(sub, "save") == 0 && argc > 2) {
+        int r = netcap_save(argv[2]);
+        if (r == -EINVAL) terminal_writestring("netcap: no in-memory capture to save\n");
+        else if (r < 0) terminal_printf("netcap: cannot write %s (%d)\n", argv[2], r);
+        else terminal_printf("netcap: %d frames written to %s\n", r, argv[2]);
+        return r < 0 ? -1 : 0;
+    }
+
+    if (strcmp(sub, "stat") == 0) {
+        netcap_print_stats();
+        return 0;
+    }
+
+    usage();
+    return -1;
+}
@@ -44,6 +44,10 @@
 #include "net.h"
 #include "get.h"
 #include "curl.h"
+#include "netbench.h"
+#include "membench.h"
+#include "httpd.h"
+#include "netcap.h"
 #include "pkg.h"
 // Minimal freestanding helpers (no libc)
 
@@ -150,6 +154,10 @@ static int wrap_cmd_launch_exit(int argc, char **argv) { return wrap_new_int(cmd
 static int wrap_cmd_net(int argc, char **argv)       { return wrap_new_int(cmd_net, argc, argv); }        /* int cmd_net(int,char**) */
 static int wrap_cmd_get(int argc, char **argv)       { return wrap_new_int(cmd_get, argc, argv); }        /* int cmd_get(int,char**) */
 static int wrap_cmd_curl(int argc, char **argv)      { return wrap_new_int(cmd_curl, argc, argv); }       /* int cmd_curl(int,char**) */
+static int wrap_cmd_netbench(int argc, char **argv)  { return wrap_new_int(cmd_netbench, argc, argv); }   /* int cmd_netbench(int,char**) */
+static int wrap_cmd_membench(int argc, char **argv)  { return wrap_new_int(cmd_membench, argc, argv); }   /* int cmd_membench(int,char**) */
+static int wrap_cmd_httpd(int argc, char **argv)     { return wrap_new_int(cmd_httpd, argc, argv); }      /* int cmd_httpd(int,char**) */
+static int wrap_cmd_netcap(int argc, char **argv)    { return wrap_new_int(cmd_netcap, argc, argv); }     /* int cmd_netcap(int,char**) */
 static int wrap_cmd_pkg(int argc, char **argv)       { return wrap_new_int(cmd_pkg, argc, argv); }        /* int cmd_pkg(int,char**) */
 /* Wrapper for execve */
 static int wrap_cmd_exec(int argc, char **argv) {
@@ -183,6 +191,8 @@ Command command_table[] = {
     { "fortune",   wrap_cmd_fortune },
     { "help",      wrap_cmd_help },
     { "get",       wrap_cmd_get },
+    { "httpd",     wrap_cmd_httpd },
+    { "netcap",    wrap_cmd_netcap },
     { "ls",        wrap_cmd_ls },
     { "launch",    wrap_cmd_launch },
     { "launch-exit", wrap_cmd_launch_exit },
@@ -190,6 +200,8 @@ Command command_table[] = {
     { "login",     wrap_cmd_login },
     { "mem",       wrap_cmd_mem },
     { "net",       wrap_cmd_net },
+    { "netbench",  wrap_cmd_netbench },
+    { "membench",  wrap_cmd_membench },
     { "pmm",       wrap_cmd_pmm },
     { "pkg",       wrap_cmd_pkg },
     { "play",      wrap_cmd_play },
@@ -24,6 +24,9 @@
 #include "../include/stdio.h"
 #include "../mem/kmalloc.h"
 #include "../apps/icons/icons.h"
+#include "../video/blend.h"
+#include "../video/cursor.h"
+#include "../image/image.h"
 
 extern "C" void serial(const char *fmt, ...);
 
@@ -38,6 +41,7 @@ static window_t* start_menu_win = NULL;
 static flyui_context_t* start_menu_ctx = NULL;
 static bool is_gui_running = false;
 static int taskbar_last_min = -1;
+static fly_widget_t* taskbar_clock = NULL;
 
 /* Icon Button Logic */
 typedef struct {
@@ -53,6 +57,7 @@ static void fly_draw_line(surface_t* surf, int x0, int y0, int x1, int y1, uint3
     int sy = (y0 < y1) ? 1 : -1;
     int err = dx + dy;
     int e2;
+    surface_damage(surf, x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1, dx + 1, 1 - dy);
 
     for (;;) {
         if (x0 >= 0 && x0 < (int)surf->width && y0 >= 0 && y0 < (int)surf->height) {
@@ -79,10 +84,10 @@ static void taskbar_btn_draw(fly_widget_t* w, surface_t* s, int x, int y) {
     uint32_t c_tl = d->pressed ? th->color_lo_1 : th->color_hi_1;
     uint32_t c_br = d->pressed ? th->color_hi_1 : th->color_lo_1;
     
-    fly_draw_line(s, x, y, x+w->w-1, y, c_tl);
-    fly_draw_line(s, x, y, x, y+w->h-1, c_tl);
-    fly_draw_line(s, x, y+w->h-1, x+w->w-1, y+w->h-1, c_br);
-    fly_draw_line(s, x+w->w-1, y, x+w->w-1, y+w->h-1, c_br);
+    fly_draw_rect_fill(s, x, y, w->w, 1, c_tl);
+    fly_draw_rect_fill(s, x, y, 1, w->h, c_tl);
+    fly_draw_rect_fill(s, x, y+w->h-1, w->w, 1, c_br);
+    fly_draw_rect_fill(s, x+w->w-1, y, 1, w->h, c_br);
 
     const icon_image_t* ic = icon_get(d->icon_type);
     
@@ -91,6 +96,7 @@ static void taskbar_btn_draw(fly_widget_t* w, surface_t* s, int x, int y) {
         int target_size = w->h - 4;  /* Leave 2px margin */
         int ix = x + (w->w - target_size) / 2;
         int iy = y + (w->h - target_size) / 2;
+        surface_damage(s, ix, iy, target_size, target_size);
         
         /* Scale down icon using nearest neighbor sampling */
         if (ic->w > 0 && ic->h > 0) {
@@ -104,23 +110,12 @@ static void taskbar_btn_draw(fly_widget_t* w, surface_t* s, int x, int y) {
                     if (src_x >= (int)ic->w) src_x = ic->w - 1;
                     if (src_y >= (int)ic->h) src_y = ic->h - 1;
                     
-                    /* Get pixel - assuming RGBA8888 format from icons.mod */
-                    const uint8_t* pixel_ptr = (const uint8_t*)ic->pixels + (src_y * ic->w + src_x) * 4;
-                    uint8_t r = pixel_ptr[0];
-                    uint8_t g = pixel_ptr[1];
-                    uint8_t b = pixel_ptr[2];
-                    uint8_t a = pixel_ptr[3];
-                    
-                    /* Only draw if not fully transparent */
-                    if (a > 128) {
-                        int screen_x = ix + px;
-                        int screen_y = iy + py;
-                        if (screen_x >= 0 && screen_x < (int)s->width && 
-                            screen_y >= 0 && screen_y < (int)s->height) {
-                            /* Convert RGBA to ARGB for display */
-                            uint32_t color = (a << 24) | (r << 16) | (g << 8) | b;
-                            s->pixels[screen_y * s->width + screen_x] = color;
-                        }
+                    int screen_x = ix + px;
+                    int screen_y = iy + py;
+                    if (fly_draw_visible(s, screen_x, screen_y)) {
+                        /* Premultiplied ARGB, blended over the button face */
+                        uint32_t* dst = &s->pixels[screen_y * s->width + screen_x];
+                        *dst = blend_pixel(ic->pixels[src_y * ic->w + src_x], *dst);
                     }
                 }
             }
@@ -473,6 +468,7 @@ static void create_exit_popup() {
     gpu_device_t* gpu = gpu_get_primary();
     int sx = (gpu->width - w) / 2;
     int sy = (gpu->height - h) / 2;
+    surface_set_shadow(s, 6);
     popup_win = wm_create_window(s, sx, sy);
 }
 
@@ -570,6 +566,8 @@ static void create_net_popup() {
     /* Position near bottom right, above taskbar */
     int sx = gpu->width - w - 10;
     int sy = gpu->height - 40 - h - 5; 
+    surface_set_opacity(s, 230);
+    surface_set_shadow(s, 4);
     net_win = wm_create_window(s, sx, sy);
 }
 
@@ -663,7 +661,9 @@ static void create_start_menu() {
     flyui_render(start_menu_ctx);
 
     gpu_device_t* gpu = gpu_get_primary();
-    /* Position above start button */
+    /* Position above start button; slightly see-through, with a shadow */
+    surface_set_opacity(s, 230);
+    surface_set_shadow(s, 4);
     start_menu_win = wm_create_window(s, 0, gpu->height - 32 - h);
 }
 
@@ -694,9 +694,11 @@ static fly_widget_t* create_taskbar_btn(int x, int y, int w, int h, int icon, bo
         icon_btn_data_t* d = (icon_btn_data_t*)w->internal_data;
         if (e->type == FLY_EVENT_MOUSE_DOWN) {
             d->pressed = true;
+            fly_widget_invalidate(w);
             return true;
         } else if (e->type == FLY_EVENT_MOUSE_UP) {
             d->pressed = false;
+            fly_widget_invalidate(w);
             if (d->event_cb) return d->event_cb(w, e);
             return true;
         }
@@ -794,6 +796,7 @@ static void create_taskbar() {
     sys_clock->bg_color = th->win_bg;
     sys_clock->on_draw = taskbar_clock_draw;
     fly_widget_add(root, sys_clock);
+    taskbar_clock = sys_clock;
 
     /* 4. Initial Render */
     flyui_render(taskbar_ctx);
@@ -831,6 +834,7 @@ extern "C" int cmd_launch(int argc, char** argv) {
     theme_init();
     compositor_init();
     wm_init();
+    cursor_show(true);
     
     /* Load Icons */
     if (icons_init("/icons.mod")) {
@@ -839,6 +843,11 @@ extern "C" int cmd_launch(int argc, char** argv) {
         serial("[WIN] Warning: icons.mod not found or invalid.\n");
     }
 
+    /* Desktop wallpaper, if one is installed (decoded once, via the image cache) */
+    const surface_t* wallpaper = image_get("/system/wallpaper.png");
+    if (!wallpaper) wallpaper = image_get("/system/wallpaper.bmp");
+    compositor_set_wallpaper(wallpaper);
+
     app_manager_init();
     
     /* 3. Create Taskbar */
@@ -856,7 +865,17 @@ extern "C" int cmd_launch(int argc, char** argv) {
     int drag_off_x = 0;
     int drag_off_y = 0;
 
+    /* Paced frames: the network is serviced while waiting for each slot */
+    wm_frame_set_idle_hook(net_poll);
+    wm_frame_start(WM_FRAME_HZ);
+
     while (is_gui_running) {
+        /* Halt until the next frame is due */
+        wm_frame_begin();
+
+        /* Service the network RX softirq (budgeted, keeps the UI responsive) */
+        net_poll();
+
         /* Update Apps */
         clock_app_update();
         demo3d_app_update();
@@ -867,13 +886,20 @@ extern "C" int cmd_launch(int argc, char** argv) {
         time_get_local(&t);
         if (t.minute != taskbar_last_min) {
             taskbar_last_min = t.minute;
-            /* Redraw taskbar to update clock */
-            flyui_render(taskbar_ctx);
-            wm_mark_dirty();
+            /* Repaint just the clock */
+            fly_widget_invalidate(taskbar_clock);
+            if (flyui_render(taskbar_ctx)) wm_mark_dirty();
         }
 
-        /* Poll Input */
+        /* Poll Input: everything queued since the last frame */
         while (input_pop(&ev)) {
+            /* A move followed by another carries nothing the next one doesn't */
+            input_event_t next;
+            if (ev.type == INPUT_MOUSE_MOVE && input_peek(&next) &&
+                next.type == INPUT_MOUSE_MOVE && next.pressed == ev.pressed) {
+                continue;
+            }
+
             /* Handle Global Keys */
             if (ev.type == INPUT_KEYBOARD && ev.pressed) {
                 if (ev.keycode == 0x58) { /* F12 to Exit */
@@ -1024,10 +1050,7 @@ extern "C" int cmd_launch(int argc, char** argv) {
 
                     if (fev.type != FLY_EVENT_NONE) {
                         flyui_dispatch_event(popup_ctx, &fev);
-                        if (fev.type != FLY_EVENT_MOUSE_MOVE) {
-                            flyui_render(popup_ctx);
-                            wm_mark_dirty();
-                        }
+                        if (flyui_render(popup_ctx)) wm_mark_dirty();
                     }
                 }
 
@@ -1047,10 +1070,7 @@ extern "C" int cmd_launch(int argc, char** argv) {
 
                     if (fev.type != FLY_EVENT_NONE) {
                         flyui_dispatch_event(net_ctx, &fev);
-                        if (fev.type != FLY_EVENT_MOUSE_MOVE) {
-                            flyui_render(net_ctx);
-                            wm_mark_dirty();
-                        }
+                        if (flyui_render(net_ctx)) wm_mark_dirty();
                     }
                 }
 
@@ -1070,10 +1090,7 @@ extern "C" int cmd_launch(int argc, char** argv) {
 
                     if (fev.type != FLY_EVENT_NONE) {
                         flyui_dispatch_event(start_menu_ctx, &fev);
-                        if (fev.type != FLY_EVENT_MOUSE_MOVE) {
-                            flyui_render(start_menu_ctx);
-                            wm_mark_dirty();
-                        }
+                        if (flyui_render(start_menu_ctx)) wm_mark_dirty();
                     }
                 }
 
@@ -1094,12 +1111,9 @@ extern "C" int cmd_launch(int argc, char** argv) {
                     if (fev.type != FLY_EVENT_NONE) {
                         flyui_dispatch_event(taskbar_ctx, &fev);
                         
-                        /* Only redraw on interaction (clicks), NOT on mouse move.
-                           This prevents the "Rendering" spam. */
-                        if (fev.type != FLY_EVENT_MOUSE_MOVE) {
-                            flyui_render(taskbar_ctx);
-                            wm_mark_dirty();
-                        }
+                        /* Only what the event invalidated is repainted, so
+                           plain mouse moves cost nothing */
+                        if (flyui_render(taskbar_ctx)) wm_mark_dirty();
                     }
                 } else if (target == NULL) {
                     /* Clicked on background/desktop */
@@ -1110,11 +1124,12 @@ extern "C" int cmd_launch(int argc, char** argv) {
             }
         }
         
-        /* Render GUI */
-        wm_render();
-        
-        asm volatile("hlt");
+        /* Render GUI: one composition per frame, whatever happened in it */
+        wm_frame_end(wm_render());
     }
+    wm_frame_stop();
+    wm_frame_set_idle_hook(NULL);
+    cursor_show(false);
     
     /* 5. Cleanup & Return to Text Mode */
     if (taskbar_win) wm_destroy_window(taskbar_win);
@@ -1129,6 +1144,9 @@ extern "C" int cmd_launch(int argc, char** argv) {
     if (start_menu_win) wm_destroy_window(start_menu_win);
     start_menu_win = NULL;
     start_menu_ctx = NULL;
+
+    compositor_set_wallpaper(NULL);
+    image_release(wallpaper);
     
     /* Dacă terminalul a fost deschis, îl închidem curat */
     if (shell_is_window_active()) {
@@ -114,7 +114,9 @@ extern "C" int cmd_write(int argc, char** argv) {
                 wm_render();
             }
         } else {
-            /* Wait for interrupt to avoid burning CPU */
+            /* Draw the echo of the last keys, then wait for interrupt
+               to avoid burning CPU */
+            terminal_flush();
             asm volatile("hlt");
         }
     }
@@ -1,5 +1,8 @@
 #include "aes.h"
 #include "../string.h"
+#include "../hardware/sse.h"
+
+extern void serial(const char *fmt, ...);
 
 /* S-box */
 static const uint8_t sbox[256] = {
@@ -37,79 +40,203 @@ static uint32_t sub_word(uint32_t w) {
     return out;
 }
 
-void aes128_init(aes128_ctx_t* ctx, const uint8_t* key) {
+static void aes128_expand(aes128_ctx_t* ctx, const uint8_t* key) {
     int i = 0;
     while (i < 4) {
-        ctx->round_key[i] = (key[4*i] << 24) | (key[4*i+1] << 16) | (key[4*i+2] << 8) | key[4*i+3];
+        ctx->round_key[i] = ((uint32_t)key[4*i] << 24) | ((uint32_t)key[4*i+1] << 16) |
+                            ((uint32_t)key[4*i+2] << 8) | key[4*i+3];
         i++;
     }
     while (i < 44) {
         uint32_t temp = ctx->round_key[i-1];
         if (i % 4 == 0) {
-            temp = sub_word(ROT8(temp)) ^ (rcon[i/4] << 24);
+            temp = sub_word(ROT8(temp)) ^ ((uint32_t)rcon[i/4] << 24);
         }
         ctx->round_key[i] = ctx->round_key[i-4] ^ temp;
         i++;
     }
 }
 
-#define MUL2(x) ((x & 0x80) ? ((x << 1) ^ 0x1b) : (x << 1))
-#define MUL3(x) (MUL2(x) ^ x)
+/* T-tables: SubBytes, ShiftRows and MixColumns folded into one lookup per
+   byte. Te0[x] = {2s, s, s, 3s}; Te1..Te3 are byte rotations of Te0. */
+static uint32_t Te0[256], Te1[256], Te2[256], Te3[256];
+static int aes_tables_ready = 0;
+static int aes_use_ni = 0;
+
+#define ROTR8(x) (((x) >> 8) | ((x) << 24))
 
-static void mix_columns(uint8_t* s) {
-    uint8_t t[4];
-    t[0] = MUL2(s[0]) ^ MUL3(s[1]) ^ s[2] ^ s[3];
-    t[1] = s[0] ^ MUL2(s[1]) ^ MUL3(s[2]) ^ s[3];
-    t[2] = s[0] ^ s[1] ^ MUL2(s[2]) ^ MUL3(s[3]);
-    t[3] = MUL3(s[0]) ^ s[1] ^ s[2] ^ MUL2(s[3]);
-    s[0] = t[0]; s[1] = t[1]; s[2] = t[2]; s[3] = t[3];
+static void aes_build_tables(void) {
+    for (int x = 0; x < 256; x++) {
+        uint32_t s = sbox[x];
+        uint32_t s2 = (s << 1) ^ ((s & 0x80) ? 0x11b : 0);
+        uint32_t s3 = s2 ^ s;
+        uint32_t t = (s2 << 24) | (s << 16) | (s << 8) | s3;
+        Te0[x] = t;
+        Te1[x] = ROTR8(t);
+        Te2[x] = ROTR8(Te1[x]);
+        Te3[x] = ROTR8(Te2[x]);
+    }
+    aes_tables_ready = 1;
 }
 
-void aes128_encrypt_block(const aes128_ctx_t* ctx, const uint8_t* in, uint8_t* out) {
-    uint8_t state[4][4];
-    int i, j, round;
+void aes_init(void) {
+    if (aes_tables_ready) return;
+    aes_build_tables();
+    if (cpu_has_sse2() && cpu_has_aesni()) {
+        sse_enable();
+        aes_use_ni = 1;
+    }
+    serial("[CRYPTO] AES: %s\n", aes_impl_name());
+}
 
-    for (i = 0; i < 4; i++)
-        for (j = 0; j < 4; j++)
-            state[j][i] = in[i*4 + j];
+const char* aes_impl_name(void) {
+    return aes_use_ni ? "aes-ni" : "t-table";
+}
 
-    /* AddRoundKey 0 */
-    for (i = 0; i < 4; i++) {
+void aes_set_impl(int use_ni) {
+    aes_use_ni = use_ni && cpu_has_sse2() && cpu_has_aesni();
+}
+
+void aes128_init(aes128_ctx_t* ctx, const uint8_t* key) {
+    aes_init();
+    aes128_expand(ctx, key);
+
+    /* AES-NI takes the same schedule as 16-byte blocks in memory order */
+    for (int i = 0; i < 44; i++) {
         uint32_t k = ctx->round_key[i];
-        state[0][i] ^= (k >> 24) & 0xFF;
-        state[1][i] ^= (k >> 16) & 0xFF;
-        state[2][i] ^= (k >> 8) & 0xFF;
-        state[3][i] ^= k & 0xFF;
+        ctx->ni_key[i * 4 + 0] = k >> 24;
+        ctx->ni_key[i * 4 + 1] = k >> 16;
+        ctx->ni_key[i * 4 + 2] = k >> 8;
+        ctx->ni_key[i * 4 + 3] = k;
     }
+}
 
-    for (round = 1; round <= 10; round++) {
-        /* SubBytes */
-        for (i = 0; i < 4; i++)
-            for (j = 0; j < 4; j++)
-                state[j][i] = sbox[state[j][i]];
-
-        /* ShiftRows */
-        uint8_t tmp = state[1][0]; state[1][0] = state[1][1]; state[1][1] = state[1][2]; state[1][2] = state[1][3]; state[1][3] = tmp;
-        tmp = state[2][0]; state[2][0] = state[2][2]; state[2][2] = tmp;
-        tmp = state[2][1]; state[2][1] = state[2][3]; state[2][3] = tmp;
-        tmp = state[3][3]; state[3][3] = state[3][2]; state[3][2] = state[3][1]; state[3][1] = state[3][0]; state[3][0] = tmp;
-
-        /* MixColumns (not in last round) */
-        if (round < 10) {
-            for (i = 0; i < 4; i++) mix_columns(&state[0][i]);
-        }
+#define GETU32(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (p)[3])
+#define PUTU32(p, v) do { (p)[0] = (v) >> 24; (p)[1] = (v) >> 16; (p)[2] = (v) >> 8; (p)[3] = (v); } while (0)
+
+static void aes128_encrypt_table(const aes128_ctx_t* ctx, const uint8_t* in, uint8_t* out) {
+    const uint32_t* rk = ctx->round_key;
+    uint32_t s0 = GETU32(in) ^ rk[0];
+    uint32_t s1 = GETU32(in + 4) ^ rk[1];
+    uint32_t s2 = GETU32(in + 8) ^ rk[2];
+    uint32_t s3 = GETU32(in + 12) ^ rk[3];
+    uint32_t t0, t1, t2, t3;
+
+    for (int r = 1; r < 10; r++) {
+        rk += 4;
+        t0 = Te0[s0 >> 24] ^ Te1[(s1 >> 16) & 0xFF] ^ Te2[(s2 >> 8) & 0xFF] ^ Te3[s3 & 0xFF] ^ rk[0];
+        t1 = Te0[s1 >> 24] ^ Te1[(s2 >> 16) & 0xFF] ^ Te2[(s3 >> 8) & 0xFF] ^ Te3[s0 & 0xFF] ^ rk[1];
+        t2 = Te0[s2 >> 24] ^ Te1[(s3 >> 16) & 0xFF] ^ Te2[(s0 >> 8) & 0xFF] ^ Te3[s1 & 0xFF] ^ rk[2];
+        t3 = Te0[s3 >> 24] ^ Te1[(s0 >> 16) & 0xFF] ^ Te2[(s1 >> 8) & 0xFF] ^ Te3[s2 & 0xFF] ^ rk[3];
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
 
-        /* AddRoundKey */
-        for (i = 0; i < 4; i++) {
-            uint32_t k = ctx->round_key[round * 4 + i];
-            state[0][i] ^= (k >> 24) & 0xFF;
-            state[1][i] ^= (k >> 16) & 0xFF;
-            state[2][i] ^= (k >> 8) & 0xFF;
-            state[3][i] ^= k & 0xFF;
+    /* Last round: no MixColumns */
+    rk += 4;
+    t0 = ((uint32_t)sbox[s0 >> 24] << 24) ^ ((uint32_t)sbox[(s1 >> 16) & 0xFF] << 16) ^
+         ((uint32_t)sbox[(s2 >> 8) & 0xFF] << 8) ^ sbox[s3 & 0xFF] ^ rk[0];
+    t1 = ((uint32_t)sbox[s1 >> 24] << 24) ^ ((uint32_t)sbox[(s2 >> 16) & 0xFF] << 16) ^
+         ((uint32_t)sbox[(s3 >> 8) & 0xFF] << 8) ^ sbox[s0 & 0xFF] ^ rk[1];
+    t2 = ((uint32_t)sbox[s2 >> 24] << 24) ^ ((uint32_t)sbox[(s3 >> 16) & 0xFF] << 16) ^
+         ((uint32_t)sbox[(s0 >> 8) & 0xFF] << 8) ^ sbox[s1 & 0xFF] ^ rk[2];
+    t3 = ((uint32_t)sbox[s3 >> 24] << 24) ^ ((uint32_t)sbox[(s0 >> 16) & 0xFF] << 16) ^
+         ((uint32_t)sbox[(s1 >> 8) & 0xFF] << 8) ^ sbox[s2 & 0xFF] ^ rk[3];
+    PUTU32(out, t0);
+    PUTU32(out + 4, t1);
+    PUTU32(out + 8, t2);
+    PUTU32(out + 12, t3);
+}
+
+typedef long long v2di __attribute__((vector_size(16)));
+typedef char v16qi __attribute__((vector_size(16)));
+
+__attribute__((target("sse2,aes")))
+static void aes128_encrypt_ni(const aes128_ctx_t* ctx, const uint8_t* in, uint8_t* out) {
+    const uint8_t* k = ctx->ni_key;
+    v2di b = (v2di)__builtin_ia32_loaddqu((const char*)in);
+    b ^= (v2di)__builtin_ia32_loaddqu((const char*)k);
+    for (int r = 1; r < 10; r++)
+        b = __builtin_ia32_aesenc128(b, (v2di)__builtin_ia32_loaddqu((const char*)(k + r * 16)));
+    b = __builtin_ia32_aesenclast128(b, (v2di)__builtin_ia32_loaddqu((const char*)(k + 160)));
+    __builtin_ia32_storedqu((char*)out, (v16qi)b);
+}
+
+void aes128_encrypt_block(const aes128_ctx_t* ctx, const uint8_t* in, uint8_t* out) {
+    if (aes_use_ni) aes128_encrypt_ni(ctx, in, out);
+    else aes128_encrypt_table(ctx, in, out);
+}
+
+static inline void ctr32_inc(uint8_t* ctr) {
+    uint32_t c = GETU32(ctr + 12) + 1;
+    PUTU32(ctr + 12, c);
+}
+
+/* Four counter blocks per iteration keep the AES-NI pipeline full */
+__attribute__((target("sse2,aes")))
+static void aes128_ctr32_ni(const aes128_ctx_t* ctx, uint8_t* ctr, const uint8_t* in,
+                            uint8_t* out, size_t blocks) {
+    v2di rk[11];
+    for (int r = 0; r < 11; r++) rk[r] = (v2di)__builtin_ia32_loaddqu((const char*)(ctx->ni_key + r * 16));
+
+    while (blocks >= 4) {
+        v2di b0, b1, b2, b3;
+        b0 = (v2di)__builtin_ia32_loaddqu((const char*)ctr); ctr32_inc(ctr);
+        b1 = (v2di)__builtin_ia32_loaddqu((const char*)ctr); ctr32_inc(ctr);
+        b2 = (v2di)__builtin_ia32_loaddqu((const char*)ctr); ctr32_inc(ctr);
+        b3 = (v2di)__builtin_ia32_loaddqu((const char*)ctr); ctr32_inc(ctr);
+        b0 ^= rk[0]; b1 ^= rk[0]; b2 ^= rk[0]; b3 ^= rk[0];
+        for (int r = 1; r < 10; r++) {
+            b0 = __builtin_ia32_aesenc128(b0, rk[r]);
+            b1 = __builtin_ia32_aesenc128(b1, rk[r]);
+            b2 = __builtin_ia32_aesenc128(b2, rk[r]);
+            b3 = __builtin_ia32_aesenc128(b3, rk[r]);
         }
+        b0 = __builtin_ia32_aesenclast128(b0, rk[10]);
+        b1 = __builtin_ia32_aesenclast128(b1, rk[10]);
+        b2 = __builtin_ia32_aesenclast128(b2, rk[10]);
+        b3 = __builtin_ia32_aesenclast128(b3, rk[10]);
+        b0 ^= (v2di)__builtin_ia32_loaddqu((const char*)in);
+        b1 ^= (v2di)__builtin_ia32_loaddqu((const char*)(in + 16));
+        b2 ^= (v2di)__builtin_ia32_loaddqu((const char*)(in + 32));
+        b3 ^= (v2di)__builtin_ia32_loaddqu((const char*)(in + 48));
+        __builtin_ia32_storedqu((char*)out, (v16qi)b0);
+        __builtin_ia32_storedqu((char*)(out + 16), (v16qi)b1);
+        __builtin_ia32_storedqu((char*)(out + 32), (v16qi)b2);
+        __builtin_ia32_storedqu((char*)(out + 48), (v16qi)b3);
+        in += 64;
+        out += 64;
+        blocks -= 4;
+    }
+    while (blocks--) {
+        v2di b = (v2di)__builtin_ia32_loaddqu((const char*)ctr);
+        ctr32_inc(ctr);
+        b ^= rk[0];
+        for (int r = 1; r < 10; r++) b = __builtin_ia32_aesenc128(b, rk[r]);
+        b = __builtin_ia32_aesenclast128(b, rk[10]);
+        b ^= (v2di)__builtin_ia32_loaddqu((const char*)in);
+        __builtin_ia32_storedqu((char*)out, (v16qi)b);
+        in += 16;
+        out += 16;
+    }
+}
+
+void aes128_ctr32(const aes128_ctx_t* ctx, uint8_t ctr[16], const uint8_t* in, uint8_t* out, size_t len) {
+    size_t blocks = len / 16;
+    if (aes_use_ni && blocks) {
+        aes128_ctr32_ni(ctx, ctr, in, out, blocks);
+        in += blocks * 16;
+        out += blocks * 16;
+        len -= blocks * 16;
     }
 
-    for (i = 0; i < 4; i++)
-        for (j = 0; j < 4; j++)
-            out[i*4 + j] = state[j][i];
-}
\ No newline at end of file
+    uint8_t ks[16];
+    while (len) {
+        aes128_encrypt_table(ctx, ctr, ks);
+        ctr32_inc(ctr);
+        size_t n = len < 16 ? len : 16;
+        for (size_t i = 0; i < n; i++) out[i] = in[i] ^ ks[i];
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
@@ -1,18 +1,28 @@
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* AES-128 context */
+/* AES-128 context: one key schedule, usable by both implementations */
 typedef struct {
-    uint32_t round_key[44];
+    uint32_t round_key[44];              /* Big-endian words (T-table path) */
+    uint8_t  ni_key[176];                /* Same schedule in memory order (AES-NI) */
 } aes128_ctx_t;
 
+/* Build the T-tables and pick AES-NI when CPUID reports it */
+void aes_init(void);
+const char* aes_impl_name(void);
+void aes_set_impl(int use_ni);           /* Benchmarks: force the table path with 0 */
+
 void aes128_init(aes128_ctx_t* ctx, const uint8_t* key);
 void aes128_encrypt_block(const aes128_ctx_t* ctx, const uint8_t* in, uint8_t* out);
 
+/* CTR mode with a 32-bit big-endian counter in ctr[12..15] (GCM), ctr is advanced */
+void aes128_ctr32(const aes128_ctx_t* ctx, uint8_t ctr[16], const uint8_t* in, uint8_t* out, size_t len);
+
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
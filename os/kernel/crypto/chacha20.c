@@ -0,0 +1,185 @@
+#include "chacha20.h"
+#include "poly1305.h"
+#include "../string.h"
+#include "../hardware/sse.h"
+
+static int chacha_use_sse2 = -1;   /* -1: not probed yet */
+
+static void chacha_probe(void) {
+    if (chacha_use_sse2 >= 0) return;
+    chacha_use_sse2 = cpu_has_sse2();
+    if (chacha_use_sse2) sse_enable();
+}
+
+const char* chacha20_impl_name(void) {
+    chacha_probe();
+    return chacha_use_sse2 ? "sse2" : "scalar";
+}
+
+void chacha20_set_impl(int use_sse2) {
+    chacha_probe();
+    chacha_use_sse2 = use_sse2 && cpu_has_sse2();
+}
+
+static inline uint32_t get_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_le32(uint8_t* p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QR(a, b, c, d)                  \
+    a += b; d ^= a; d = ROTL32(d, 16);  \
+    c += d; b ^= c; b = ROTL32(b, 12);  \
+    a += b; d ^= a; d = ROTL32(d, 8);   \
+    c += d; b ^= c; b = ROTL32(b, 7)
+
+#define DOUBLE_ROUND(x)                          \
+    QR(x[0], x[4], x[8],  x[12]);                \
+    QR(x[1], x[5], x[9],  x[13]);                \
+    QR(x[2], x[6], x[10], x[14]);                \
+    QR(x[3], x[7], x[11], x[15]);                \
+    QR(x[0], x[5], x[10], x[15]);                \
+    QR(x[1], x[6], x[11], x[12]);                \
+    QR(x[2], x[7], x[8],  x[13]);                \
+    QR(x[3], x[4], x[9],  x[14])
+
+static void chacha20_setup(uint32_t s[16], const uint8_t key[32], const uint8_t nonce[12], uint32_t counter) {
+    s[0] = 0x61707865; s[1] = 0x3320646e; s[2] = 0x79622d32; s[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) s[4 + i] = get_le32(key + i * 4);
+    s[12] = counter;
+    s[13] = get_le32(nonce);
+    s[14] = get_le32(nonce + 4);
+    s[15] = get_le32(nonce + 8);
+}
+
+static void chacha20_block(const uint32_t s[16], uint8_t out[64]) {
+    uint32_t x[16];
+    for (int i = 0; i < 16; i++) x[i] = s[i];
+    for (int i = 0; i < 10; i++) {
+        DOUBLE_ROUND(x);
+    }
+    for (int i = 0; i < 16; i++) put_le32(out + i * 4, x[i] + s[i]);
+}
+
+typedef unsigned int v4su __attribute__((vector_size(16)));
+typedef int          v4si __attribute__((vector_size(16)));
+typedef long long    v2di __attribute__((vector_size(16)));
+typedef char         v16qi __attribute__((vector_size(16)));
+
+/* Four consecutive blocks, one block per lane: x[i] holds word i of all four */
+__attribute__((target("sse2")))
+static void chacha20_blocks4_sse2(const uint32_t s[16], const uint8_t* in, uint8_t* out) {
+    v4su x[16], orig[16];
+    for (int i = 0; i < 16; i++) {
+        v4su v = { s[i], s[i], s[i], s[i] };
+        x[i] = v;
+    }
+    v4su ctr = { 0, 1, 2, 3 };
+    x[12] += ctr;
+    for (int i = 0; i < 16; i++) orig[i] = x[i];
+
+    for (int i = 0; i < 10; i++) {
+        DOUBLE_ROUND(x);
+    }
+    for (int i = 0; i < 16; i++) x[i] += orig[i];
+
+    /* 4x4 transposes turn lanes back into blocks */
+    for (int g = 0; g < 4; g++) {
+        v4si a = (v4si)x[g * 4], b = (v4si)x[g * 4 + 1], c = (v4si)x[g * 4 + 2], d = (v4si)x[g * 4 + 3];
+        v2di t0 = (v2di)__builtin_ia32_punpckldq128(a, b);
+        v2di t1 = (v2di)__builtin_ia32_punpckldq128(c, d);
+        v2di t2 = (v2di)__builtin_ia32_punpckhdq128(a, b);
+        v2di t3 = (v2di)__builtin_ia32_punpckhdq128(c, d);
+        v2di blk[4];
+        blk[0] = __builtin_ia32_punpcklqdq128(t0, t1);
+        blk[1] = __builtin_ia32_punpckhqdq128(t0, t1);
+        blk[2] = __builtin_ia32_punpcklqdq128(t2, t3);
+        blk[3] = __builtin_ia32_punpckhqdq128(t2, t3);
+        for (int j = 0; j < 4; j++) {
+            size_t off = j * 64 + g * 16;
+            v2di m = (v2di)__builtin_ia32_loaddqu((const char*)(in + off));
+            __builtin_ia32_storedqu((char*)(out + off), (v16qi)(blk[j] ^ m));
+        }
+    }
+}
+
+void chacha20_xor(const uint8_t key[32], const uint8_t nonce[12], uint32_t counter,
+                  const uint8_t* in, uint8_t* out, size_t len) {
+    uint32_t s[16];
+    uint8_t ks[64];
+
+    chacha_probe();
+    chacha20_setup(s, key, nonce, counter);
+
+    if (chacha_use_sse2) {
+        while (len >= 256) {
+            chacha20_blocks4_sse2(s, in, out);
+            s[12] += 4;
+            in += 256;
+            out += 256;
+            len -= 256;
+        }
+    }
+    while (len) {
+        chacha20_block(s, ks);
+        s[12]++;
+        size_t n = len < 64 ? len : 64;
+        for (size_t i = 0; i < n; i++) out[i] = in[i] ^ ks[i];
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
+
+static void chacha20_poly1305_tag(const uint8_t key[32], const uint8_t nonce[12],
+                                  const uint8_t* aad, size_t aad_len,
+                                  const uint8_t* ct, size_t len, uint8_t tag[16]) {
+    static const uint8_t zero[16] = { 0 };
+    uint32_t s[16];
+    uint8_t block0[64], lens[16];
+    poly1305_ctx_t poly;
+
+    /* One-time key: first 32 bytes of block 0 */
+    chacha20_setup(s, key, nonce, 0);
+    chacha20_block(s, block0);
+    poly1305_init(&poly, block0);
+
+    poly1305_update(&poly, aad, aad_len);
+    if (aad_len & 15) poly1305_update(&poly, zero, 16 - (aad_len & 15));
+    poly1305_update(&poly, ct, len);
+    if (len & 15) poly1305_update(&poly, zero, 16 - (len & 15));
+    put_le32(lens, (uint32_t)aad_len);
+    put_le32(lens + 4, 0);
+    put_le32(lens + 8, (uint32_t)len);
+    put_le32(lens + 12, 0);
+    poly1305_update(&poly, lens, 16);
+    poly1305_final(&poly, tag);
+    memset(block0, 0, sizeof(block0));
+}
+
+void chacha20_poly1305_seal(const uint8_t key[32], const uint8_t nonce[12],
+                            const uint8_t* aad, size_t aad_len,
+                            const uint8_t* in, uint8_t* out, size_t len, uint8_t tag[16]) {
+    chacha20_xor(key, nonce, 1, in, out, len);
+    chacha20_poly1305_tag(key, nonce, aad, aad_len, out, len, tag);
+}
+
+int chacha20_poly1305_open(const uint8_t key[32], const uint8_t nonce[12],
+                           const uint8_t* aad, size_t aad_len,
+                           const uint8_t* in, uint8_t* out, size_t len, const uint8_t tag[16]) {
+    uint8_t expect[16];
+    chacha20_poly1305_tag(key, nonce, aad, aad_len, in, len, expect);
+
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; i++) diff |= expect[i] ^ tag[i];
+    if (diff) {
+        if (out != in) memset(out, 0, len);
+        return -1;
+    }
+    chacha20_xor(key, nonce, 1, in, out, len);
+    return 0;
+}
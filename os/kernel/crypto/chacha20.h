@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ChaCha20 and the ChaCha20-Poly1305 AEAD (RFC 8439).
+ * Four blocks are computed in parallel in SSE2 registers when available.
+ */
+void chacha20_xor(const uint8_t key[32], const uint8_t nonce[12], uint32_t counter,
+                  const uint8_t* in, uint8_t* out, size_t len);
+
+/* in/out may alias. open returns 0, or -1 if the tag does not match. */
+void chacha20_poly1305_seal(const uint8_t key[32], const uint8_t nonce[12],
+                            const uint8_t* aad, size_t aad_len,
+                            const uint8_t* in, uint8_t* out, size_t len, uint8_t tag[16]);
+int  chacha20_poly1305_open(const uint8_t key[32], const uint8_t nonce[12],
+                            const uint8_t* aad, size_t aad_len,
+                            const uint8_t* in, uint8_t* out, size_t len, const uint8_t tag[16]);
+
+const char* chacha20_impl_name(void);
+void chacha20_set_impl(int use_sse2);
+
+#ifdef __cplusplus
+}
+#endif
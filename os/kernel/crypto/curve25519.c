@@ -0,0 +1,474 @@
+#include "curve25519.h"
+#include "sha512.h"
+#include "../string.h"
+
+/* Field elements mod p = 2^255 - 19: ten signed limbs of alternately 26
+   and 25 bits. Every operation leaves limbs centred (|f[i]| <= 2^25), so
+   products and the 19x / 2x folds in fe_mul stay inside 32/64 bits. */
+typedef int32_t fe[10];
+
+static const int fe_width[10] = { 26, 25, 26, 25, 26, 25, 26, 25, 26, 25 };
+
+static void fe_reduce64(fe h, int64_t t[10]) {
+    for (int i = 0; i < 10; i++) {
+        int w = fe_width[i];
+        int64_t c = (t[i] + ((int64_t)1 << (w - 1))) >> w;
+        t[i] -= c * ((int64_t)1 << w);
+        if (i < 9) t[i + 1] += c;
+        else t[0] += c * 19;
+    }
+    int64_t c = (t[0] + (1 << 25)) >> 26;
+    t[0] -= c * ((int64_t)1 << 26);
+    t[1] += c;
+    for (int i = 0; i < 10; i++) h[i] = (int32_t)t[i];
+}
+
+static void fe_0(fe h) { for (int i = 0; i < 10; i++) h[i] = 0; }
+static void fe_1(fe h) { fe_0(h); h[0] = 1; }
+static void fe_copy(fe h, const fe f) { for (int i = 0; i < 10; i++) h[i] = f[i]; }
+
+static void fe_add(fe h, const fe f, const fe g) {
+    int64_t t[10];
+    for (int i = 0; i < 10; i++) t[i] = (int64_t)f[i] + g[i];
+    fe_reduce64(h, t);
+}
+
+static void fe_sub(fe h, const fe f, const fe g) {
+    int64_t t[10];
+    for (int i = 0; i < 10; i++) t[i] = (int64_t)f[i] - g[i];
+    fe_reduce64(h, t);
+}
+
+static void fe_neg(fe h, const fe f) {
+    for (int i = 0; i < 10; i++) h[i] = -f[i];
+}
+
+/* Limb i sits at bit ceil(25.5 i): two odd limbs multiply one bit too
+   high (x2), and anything past limb 9 wraps around as 2^255 = 19. */
+static void fe_mul(fe h, const fe f, const fe g) {
+    int32_t g19[10], f2[10];
+    int64_t t[10];
+
+    for (int i = 0; i < 10; i++) {
+        g19[i] = 19 * g[i];
+        f2[i] = (i & 1) ? 2 * f[i] : f[i];
+        t[i] = 0;
+    }
+    for (int i = 0; i < 10; i++) {
+        for (int j = 0; j < 10; j++) {
+            int32_t a = (i & j & 1) ? f2[i] : f[i];
+            if (i + j < 10) t[i + j] += (int64_t)a * g[j];
+            else t[i + j - 10] += (int64_t)a * g19[j];
+        }
+    }
+    fe_reduce64(h, t);
+}
+
+static void fe_sq(fe h, const fe f) {
+    fe_mul(h, f, f);
+}
+
+static void fe_sqn(fe h, const fe f, int n) {
+    fe_sq(h, f);
+    for (int i = 1; i < n; i++) fe_sq(h, h);
+}
+
+static void fe_frombytes(fe h, const uint8_t s[32]) {
+    uint64_t acc = 0;
+    int acc_bits = 0, in = 0;
+    for (int i = 0; i < 10; i++) {
+        int w = fe_width[i];
+        while (acc_bits < w && in < 32) {
+            acc |= (uint64_t)s[in++] << acc_bits;
+            acc_bits += 8;
+        }
+        h[i] = (int32_t)(acc & (((uint64_t)1 << w) - 1));
+        acc >>= w;
+        acc_bits -= w;
+    }
+    /* Bit 255 is ignored */
+}
+
+/* Floor carries: limbs end up in [0, 2^w) */
+static void fe_carry_floor(int64_t t[10], int fold) {
+    for (int i = 0; i < 10; i++) {
+        int w = fe_width[i];
+        int64_t c = t[i] >> w;
+        t[i] -= c * ((int64_t)1 << w);
+        if (i < 9) t[i + 1] += c;
+        else if (fold) t[0] += c * 19;
+        else t[9] += c * ((int64_t)1 << w);
+    }
+}
+
+static void fe_tobytes(uint8_t s[32], const fe h) {
+    int64_t t[10];
+    for (int i = 0; i < 10; i++) t[i] = h[i];
+    fe_carry_floor(t, 1);
+    fe_carry_floor(t, 1);
+    fe_carry_floor(t, 1);
+
+    /* t < 2^255 now; t >= p exactly when t + 19 carries into bit 255 */
+    int64_t u[10];
+    for (int i = 0; i < 10; i++) u[i] = t[i];
+    u[0] += 19;
+    fe_carry_floor(u, 0);
+    int64_t q = u[9] >> 25;
+
+    t[0] += 19 * q;
+    fe_carry_floor(t, 0);
+    t[9] &= (1 << 25) - 1;
+
+    uint64_t acc = 0;
+    int acc_bits = 0, out = 0;
+    for (int i = 0; i < 10; i++) {
+        acc |= (uint64_t)t[i] << acc_bits;
+        acc_bits += fe_width[i];
+        while (acc_bits >= 8) {
+            s[out++] = (uint8_t)acc;
+            acc >>= 8;
+            acc_bits -= 8;
+        }
+    }
+    s[out] = (uint8_t)acc;
+}
+
+static int fe_isnegative(const fe f) {
+    uint8_t s[32];
+    fe_tobytes(s, f);
+    return s[0] & 1;
+}
+
+static int fe_iszero(const fe f) {
+    uint8_t s[32];
+    uint8_t r = 0;
+    fe_tobytes(s, f);
+    for (int i = 0; i < 32; i++) r |= s[i];
+    return r == 0;
+}
+
+static void fe_cswap(fe f, fe g, uint32_t b) {
+    int32_t mask = -(int32_t)b;
+    for (int i = 0; i < 10; i++) {
+        int32_t x = (f[i] ^ g[i]) & mask;
+        f[i] ^= x;
+        g[i] ^= x;
+    }
+}
+
+/* z^(2^250 - 1), shared by inversion and the square root exponent */
+static void fe_pow2_250_1(fe out, fe z11, const fe z) {
+    fe z2, z9, t, z2_5_0, z2_10_0, z2_20_0, z2_50_0, z2_100_0;
+
+    fe_sq(z2, z);
+    fe_sqn(t, z2, 2);
+    fe_mul(z9, t, z);
+    fe_mul(z11, z9, z2);
+    fe_sq(t, z11);
+    fe_mul(z2_5_0, t, z9);
+    fe_sqn(t, z2_5_0, 5);
+    fe_mul(z2_10_0, t, z2_5_0);
+    fe_sqn(t, z2_10_0, 10);
+    fe_mul(z2_20_0, t, z2_10_0);
+    fe_sqn(t, z2_20_0, 20);
+    fe_mul(t, t, z2_20_0);
+    fe_sqn(t, t, 10);
+    fe_mul(z2_50_0, t, z2_10_0);
+    fe_sqn(t, z2_50_0, 50);
+    fe_mul(z2_100_0, t, z2_50_0);
+    fe_sqn(t, z2_100_0, 100);
+    fe_mul(t, t, z2_100_0);
+    fe_sqn(t, t, 50);
+    fe_mul(out, t, z2_50_0);
+}
+
+/* z^(p-2) */
+static void fe_invert(fe out, const fe z) {
+    fe t, z11;
+    fe_pow2_250_1(t, z11, z);
+    fe_sqn(t, t, 5);
+    fe_mul(out, t, z11);
+}
+
+/* z^((p-5)/8) */
+static void fe_pow22523(fe out, const fe z) {
+    fe t, z11;
+    fe_pow2_250_1(t, z11, z);
+    fe_sqn(t, t, 2);
+    fe_mul(out, t, z);
+}
+
+/* ---- X25519 ---- */
+
+void x25519(uint8_t out[32], const uint8_t scalar[32], const uint8_t point[32]) {
+    uint8_t e[32];
+    fe x1, x2, z2, x3, z3, a, aa, b, bb, ee, c, d, da, cb, a24;
+
+    memcpy(e, scalar, 32);
+    e[0] &= 248;
+    e[31] &= 127;
+    e[31] |= 64;
+
+    fe_frombytes(x1, point);
+    fe_1(x2);
+    fe_0(z2);
+    fe_copy(x3, x1);
+    fe_1(z3);
+    fe_0(a24);
+    a24[0] = 121665;
+
+    uint32_t swap = 0;
+    for (int pos = 254; pos >= 0; pos--) {
+        uint32_t bit = (e[pos >> 3] >> (pos & 7)) & 1;
+        swap ^= bit;
+        fe_cswap(x2, x3, swap);
+        fe_cswap(z2, z3, swap);
+        swap = bit;
+
+        fe_add(a, x2, z2);
+        fe_sq(aa, a);
+        fe_sub(b, x2, z2);
+        fe_sq(bb, b);
+        fe_sub(ee, aa, bb);
+        fe_add(c, x3, z3);
+        fe_sub(d, x3, z3);
+        fe_mul(da, d, a);
+        fe_mul(cb, c, b);
+        fe_add(x3, da, cb);
+        fe_sq(x3, x3);
+        fe_sub(z3, da, cb);
+        fe_sq(z3, z3);
+        fe_mul(z3, z3, x1);
+        fe_mul(x2, aa, bb);
+        fe_mul(z2, a24, ee);
+        fe_add(z2, z2, aa);
+        fe_mul(z2, z2, ee);
+    }
+    fe_cswap(x2, x3, swap);
+    fe_cswap(z2, z3, swap);
+
+    fe_invert(z2, z2);
+    fe_mul(x2, x2, z2);
+    fe_tobytes(out, x2);
+    memset(e, 0, sizeof(e));
+}
+
+void x25519_public(uint8_t pub[32], const uint8_t priv[32]) {
+    static const uint8_t base[32] = { 9 };
+    x25519(pub, priv, base);
+}
+
+/* ---- Ed25519 (verification only) ---- */
+
+typedef struct {
+    fe X, Y, Z, T;    /* Extended coordinates: x = X/Z, y = Y/Z, xy = T/Z */
+} ge_p3;
+
+static const uint8_t ed_d_bytes[32] = {
+    0xa3, 0x78, 0x59, 0x13, 0xca, 0x4d, 0xeb, 0x75, 0xab, 0xd8, 0x41, 0x41, 0x4d, 0x0a, 0x70, 0x00,
+    0x98, 0xe8, 0x79, 0x77, 0x79, 0x40, 0xc7, 0x8c, 0x73, 0xfe, 0x6f, 0x2b, 0xee, 0x6c, 0x03, 0x52
+};
+static const uint8_t ed_d2_bytes[32] = {
+    0x59, 0xf1, 0xb2, 0x26, 0x94, 0x9b, 0xd6, 0xeb, 0x56, 0xb1, 0x83, 0x82, 0x9a, 0x14, 0xe0, 0x00,
+    0x30, 0xd1, 0xf3, 0xee, 0xf2, 0x80, 0x8e, 0x19, 0xe7, 0xfc, 0xdf, 0x56, 0xdc, 0xd9, 0x06, 0x24
+};
+static const uint8_t ed_sqrtm1_bytes[32] = {
+    0xb0, 0xa0, 0x0e, 0x4a, 0x27, 0x1b, 0xee, 0xc4, 0x78, 0xe4, 0x2f, 0xad, 0x06, 0x18, 0x43, 0x2f,
+    0xa7, 0xd7, 0xfb, 0x3d, 0x99, 0x00, 0x4d, 0x2b, 0x0b, 0xdf, 0xc1, 0x4f, 0x80, 0x24, 0x83, 0x2b
+};
+static const uint8_t ed_bx_bytes[32] = {
+    0x1a, 0xd5, 0x25, 0x8f, 0x60, 0x2d, 0x56, 0xc9, 0xb2, 0xa7, 0x25, 0x95, 0x60, 0xc7, 0x2c, 0x69,
+    0x5c, 0xdc, 0xd6, 0xfd, 0x31, 0xe2, 0xa4, 0xc0, 0xfe, 0x53, 0x6e, 0xcd, 0xd3, 0x36, 0x69, 0x21
+};
+static const uint8_t ed_by_bytes[32] = {
+    0x58, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+    0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66
+};
+
+/* Group order L = 2^252 + 27742317777372353535851937790883648493, little endian */
+static const uint8_t ed_l[32] = {
+    0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+static void ge_identity(ge_p3* p) {
+    fe_0(p->X);
+    fe_1(p->Y);
+    fe_1(p->Z);
+    fe_0(p->T);
+}
+
+/* add-2008-hwcd-3 (a = -1); complete, so it also doubles */
+static void ge_add(ge_p3* r, const ge_p3* p, const ge_p3* q, const fe d2) {
+    fe a, b, c, d, e, f, g, h, t;
+
+    fe_sub(a, p->Y, p->X);
+    fe_sub(t, q->Y, q->X);
+    fe_mul(a, a, t);
+    fe_add(b, p->Y, p->X);
+    fe_add(t, q->Y, q->X);
+    fe_mul(b, b, t);
+    fe_mul(c, p->T, q->T);
+    fe_mul(c, c, d2);
+    fe_mul(d, p->Z, q->Z);
+    fe_add(d, d, d);
+    fe_sub(e, b, a);
+    fe_sub(f, d, c);
+    fe_add(g, d, c);
+    fe_add(h, b, a);
+    fe_mul(r->X, e, f);
+    fe_mul(r->Y, g, h);
+    fe_mul(r->T, e, h);
+    fe_mul(r->Z, f, g);
+}
+
+/* dbl-2008-hwcd (a = -1) */
+static void ge_dbl(ge_p3* r, const ge_p3* p) {
+    fe a, b, c, e, f, g, h;
+
+    fe_sq(a, p->X);
+    fe_sq(b, p->Y);
+    fe_sq(c, p->Z);
+    fe_add(c, c, c);
+    fe_add(h, p->X, p->Y);
+    fe_sq(e, h);
+    fe_sub(e, e, a);
+    fe_sub(e, e, b);          /* 2XY */
+    fe_sub(g, b, a);          /* -A + B */
+    fe_sub(f, g, c);
+    fe_add(h, a, b);
+    fe_neg(h, h);             /* -A - B */
+    fe_mul(r->X, e, f);
+    fe_mul(r->Y, g, h);
+    fe_mul(r->T, e, h);
+    fe_mul(r->Z, f, g);
+}
+
+static int ge_frombytes(ge_p3* p, const uint8_t s[32]) {
+    fe u, v, v3, vxx, check, d, sqrtm1;
+
+    fe_frombytes(d, ed_d_bytes);
+    fe_frombytes(sqrtm1, ed_sqrtm1_bytes);
+    fe_frombytes(p->Y, s);
+    fe_1(p->Z);
+
+    /* x^2 = (y^2 - 1) / (d y^2 + 1) */
+    fe_sq(u, p->Y);
+    fe_mul(v, u, d);
+    fe_sub(u, u, p->Z);
+    fe_add(v, v, p->Z);
+
+    /* x = u v^3 (u v^7)^((p-5)/8) */
+    fe_sq(v3, v);
+    fe_mul(v3, v3, v);
+    fe_sq(p->X, v3);
+    fe_mul(p->X, p->X, v);
+    fe_mul(p->X, p->X, u);
+    fe_pow22523(p->X, p->X);
+    fe_mul(p->X, p->X, v3);
+    fe_mul(p->X, p->X, u);
+
+    fe_sq(vxx, p->X);
+    fe_mul(vxx, vxx, v);
+    fe_sub(check, vxx, u);
+    if (!fe_iszero(check)) {
+        fe_add(check, vxx, u);
+        if (!fe_iszero(check)) return -1;
+        fe_mul(p->X, p->X, sqrtm1);
+    }
+
+    int sign = s[31] >> 7;
+    if (fe_iszero(p->X) && sign) return -1;
+    if (fe_isnegative(p->X) != sign) fe_neg(p->X, p->X);
+
+    fe_mul(p->T, p->X, p->Y);
+    return 0;
+}
+
+static void ge_tobytes(uint8_t s[32], const ge_p3* p) {
+    fe recip, x, y;
+    fe_invert(recip, p->Z);
+    fe_mul(x, p->X, recip);
+    fe_mul(y, p->Y, recip);
+    fe_tobytes(s, y);
+    s[31] ^= fe_isnegative(x) << 7;
+}
+
+/* 512-bit little-endian x mod L, radix 2^8 with signed carries */
+static void sc_reduce(uint8_t r[32], const uint8_t in[64]) {
+    int64_t x[64];
+    int64_t carry;
+    int i, j;
+
+    for (i = 0; i < 64; i++) x[i] = in[i];
+
+    for (i = 63; i >= 32; --i) {
+        carry = 0;
+        for (j = i - 32; j < i - 12; ++j) {
+            x[j] += carry - 16 * x[i] * ed_l[j - (i - 32)];
+            carry = (x[j] + 128) >> 8;
+            x[j] -= carry * 256;
+        }
+        x[j] += carry;
+        x[i] = 0;
+    }
+    carry = 0;
+    for (j = 0; j < 32; j++) {
+        x[j] += carry - (x[31] >> 4) * ed_l[j];
+        carry = x[j] >> 8;
+        x[j] &= 255;
+    }
+    for (j = 0; j < 32; j++) x[j] -= carry * ed_l[j];
+    for (i = 0; i < 32; i++) {
+        x[i + 1] += x[i] >> 8;
+        r[i] = (uint8_t)(x[i] & 255);
+    }
+}
+
+/* Scalar < L (canonical S, RFC 8032 5.1.7) */
+static int sc_is_canonical(const uint8_t s[32]) {
+    for (int i = 31; i >= 0; i--) {
+        if (s[i] < ed_l[i]) return 1;
+        if (s[i] > ed_l[i]) return 0;
+    }
+    return 0;
+}
+
+int ed25519_verify(const uint8_t sig[64], const uint8_t* msg, size_t len, const uint8_t pk[32]) {
+    ge_p3 a, b, r;
+    fe d2;
+    uint8_t h[64], k[32], check[32];
+    sha512_ctx_t sha;
+
+    if (!sc_is_canonical(sig + 32)) return -1;
+    if (ge_frombytes(&a, pk) < 0) return -1;
+
+    /* -A, so that R' = [S]B + [k](-A) */
+    fe_neg(a.X, a.X);
+    fe_neg(a.T, a.T);
+
+    fe_frombytes(d2, ed_d2_bytes);
+    fe_frombytes(b.X, ed_bx_bytes);
+    fe_frombytes(b.Y, ed_by_bytes);
+    fe_1(b.Z);
+    fe_mul(b.T, b.X, b.Y);
+
+    sha512_init(&sha);
+    sha512_update(&sha, sig, 32);
+    sha512_update(&sha, pk, 32);
+    sha512_update(&sha, msg, len);
+    sha512_final(&sha, h);
+    sc_reduce(k, h);
+
+    /* Public inputs only: plain double-and-add over both scalars at once */
+    const uint8_t* s = sig + 32;
+    ge_identity(&r);
+    for (int i = 255; i >= 0; i--) {
+        ge_dbl(&r, &r);
+        if ((s[i >> 3] >> (i & 7)) & 1) ge_add(&r, &r, &b, d2);
+        if ((k[i >> 3] >> (i & 7)) & 1) ge_add(&r, &r, &a, d2);
+    }
+
+    ge_tobytes(check, &r);
+    return memcmp(check, sig, 32) == 0 ? 0 : -1;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* X25519 key agreement (RFC 7748) and Ed25519 signature verification
+ * (RFC 8032) over a shared radix-2^25.5 field implementation.
+ */
+void x25519(uint8_t out[32], const uint8_t scalar[32], const uint8_t point[32]);
+void x25519_public(uint8_t pub[32], const uint8_t priv[32]);
+
+/* 0 if sig is a valid signature of msg under pk, -1 otherwise */
+int ed25519_verify(const uint8_t sig[64], const uint8_t* msg, size_t len, const uint8_t pk[32]);
+
+#ifdef __cplusplus
+}
+#endif
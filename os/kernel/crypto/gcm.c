@@ -0,0 +1,240 @@
+#include "gcm.h"
+#include "../string.h"
+#include "../hardware/sse.h"
+
+typedef long long v2di __attribute__((vector_size(16)));
+typedef int       v4si __attribute__((vector_size(16)));
+typedef char      v16qi __attribute__((vector_size(16)));
+
+static int gcm_use_clmul = -1;   /* -1: not probed yet */
+
+static void gcm_probe(void) {
+    if (gcm_use_clmul >= 0) return;
+    gcm_use_clmul = cpu_has_sse2() && cpu_has_ssse3() && cpu_has_pclmul();
+    if (gcm_use_clmul) sse_enable();
+}
+
+const char* gcm_impl_name(void) {
+    gcm_probe();
+    return gcm_use_clmul ? "pclmul" : "4-bit table";
+}
+
+void gcm_set_impl(int use_clmul) {
+    gcm_probe();
+    gcm_use_clmul = use_clmul && cpu_has_sse2() && cpu_has_ssse3() && cpu_has_pclmul();
+}
+
+static inline uint64_t get_be64(const uint8_t* p) {
+    return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+           ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) | ((uint64_t)p[6] << 8) | p[7];
+}
+
+static inline void put_be64(uint8_t* p, uint64_t v) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/* ---- 4-bit table GHASH ---- */
+
+static const uint64_t last4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+static void gcm_gen_table(gcm_ctx_t* ctx, const uint8_t h[16]) {
+    uint64_t vh = get_be64(h);
+    uint64_t vl = get_be64(h + 8);
+
+    ctx->hl[8] = vl;
+    ctx->hh[8] = vh;
+    ctx->hl[0] = 0;
+    ctx->hh[0] = 0;
+
+    for (int i = 4; i > 0; i >>= 1) {
+        uint32_t t = (uint32_t)(vl & 1) * 0xe1000000u;
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ ((uint64_t)t << 32);
+        ctx->hl[i] = vl;
+        ctx->hh[i] = vh;
+    }
+    for (int i = 2; i <= 8; i *= 2) {
+        for (int j = 1; j < i; j++) {
+            ctx->hh[i + j] = ctx->hh[i] ^ ctx->hh[j];
+            ctx->hl[i + j] = ctx->hl[i] ^ ctx->hl[j];
+        }
+    }
+}
+
+static void gcm_mult_table(const gcm_ctx_t* ctx, uint8_t x[16]) {
+    uint8_t lo = x[15] & 0xF;
+    uint64_t zh = ctx->hh[lo];
+    uint64_t zl = ctx->hl[lo];
+
+    for (int i = 15; i >= 0; i--) {
+        lo = x[i] & 0xF;
+        uint8_t hi = x[i] >> 4;
+        uint8_t rem;
+
+        if (i != 15) {
+            rem = zl & 0xF;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (last4[rem] << 48);
+            zh ^= ctx->hh[lo];
+            zl ^= ctx->hl[lo];
+        }
+        rem = zl & 0xF;
+        zl = (zh << 60) | (zl >> 4);
+        zh = (zh >> 4) ^ (last4[rem] << 48);
+        zh ^= ctx->hh[hi];
+        zl ^= ctx->hl[hi];
+    }
+    put_be64(x, zh);
+    put_be64(x + 8, zl);
+}
+
+static void ghash_table(const gcm_ctx_t* ctx, uint8_t y[16], const uint8_t* data, size_t len) {
+    while (len) {
+        size_t n = len < 16 ? len : 16;
+        for (size_t i = 0; i < n; i++) y[i] ^= data[i];
+        gcm_mult_table(ctx, y);
+        data += n;
+        len -= n;
+    }
+}
+
+/* ---- PCLMULQDQ GHASH (Intel carry-less multiplication white paper, Alg. 5) ---- */
+
+__attribute__((target("sse2,ssse3,pclmul")))
+static inline v2di bswap128(v2di x) {
+    const v16qi mask = { 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 };
+    return (v2di)__builtin_ia32_pshufb128((v16qi)x, mask);
+}
+
+__attribute__((target("sse2,ssse3,pclmul")))
+static inline v2di gfmul(v2di a, v2di b) {
+    v2di t3 = __builtin_ia32_pclmulqdq128(a, b, 0x00);
+    v2di t4 = __builtin_ia32_pclmulqdq128(a, b, 0x10);
+    v2di t5 = __builtin_ia32_pclmulqdq128(a, b, 0x01);
+    v2di t6 = __builtin_ia32_pclmulqdq128(a, b, 0x11);
+
+    t4 ^= t5;
+    t5 = __builtin_ia32_pslldqi128(t4, 64);
+    t4 = __builtin_ia32_psrldqi128(t4, 64);
+    t3 ^= t5;
+    t6 ^= t4;
+
+    /* Shift the 256-bit product left by one (bit-reflected operands) */
+    v2di t7 = (v2di)__builtin_ia32_psrldi128((v4si)t3, 31);
+    v2di t8 = (v2di)__builtin_ia32_psrldi128((v4si)t6, 31);
+    t3 = (v2di)__builtin_ia32_pslldi128((v4si)t3, 1);
+    t6 = (v2di)__builtin_ia32_pslldi128((v4si)t6, 1);
+    v2di t9 = __builtin_ia32_psrldqi128(t7, 96);
+    t8 = __builtin_ia32_pslldqi128(t8, 32);
+    t7 = __builtin_ia32_pslldqi128(t7, 32);
+    t3 |= t7;
+    t6 |= t8;
+    t6 |= t9;
+
+    /* Reduce modulo x^128 + x^7 + x^2 + x + 1 */
+    t7 = (v2di)__builtin_ia32_pslldi128((v4si)t3, 31);
+    t8 = (v2di)__builtin_ia32_pslldi128((v4si)t3, 30);
+    t9 = (v2di)__builtin_ia32_pslldi128((v4si)t3, 25);
+    t7 ^= t8;
+    t7 ^= t9;
+    t8 = __builtin_ia32_psrldqi128(t7, 32);
+    t7 = __builtin_ia32_pslldqi128(t7, 96);
+    t3 ^= t7;
+
+    v2di t2 = (v2di)__builtin_ia32_psrldi128((v4si)t3, 1);
+    t4 = (v2di)__builtin_ia32_psrldi128((v4si)t3, 2);
+    t5 = (v2di)__builtin_ia32_psrldi128((v4si)t3, 7);
+    t2 ^= t4;
+    t2 ^= t5;
+    t2 ^= t8;
+    t3 ^= t2;
+    return t6 ^ t3;
+}
+
+__attribute__((target("sse2,ssse3,pclmul")))
+static void ghash_clmul(const gcm_ctx_t* ctx, uint8_t y[16], const uint8_t* data, size_t len) {
+    v2di h = (v2di)__builtin_ia32_loaddqu((const char*)ctx->h);
+    v2di acc = bswap128((v2di)__builtin_ia32_loaddqu((const char*)y));
+
+    while (len >= 16) {
+        v2di x = bswap128((v2di)__builtin_ia32_loaddqu((const char*)data));
+        acc = gfmul(acc ^ x, h);
+        data += 16;
+        len -= 16;
+    }
+    if (len) {
+        uint8_t block[16];
+        memset(block, 0, sizeof(block));
+        memcpy(block, data, len);
+        v2di x = bswap128((v2di)__builtin_ia32_loaddqu((const char*)block));
+        acc = gfmul(acc ^ x, h);
+    }
+    __builtin_ia32_storedqu((char*)y, (v16qi)bswap128(acc));
+}
+
+/* Absorb data (zero padded to a block boundary) into y */
+static void ghash(const gcm_ctx_t* ctx, uint8_t y[16], const uint8_t* data, size_t len) {
+    if (gcm_use_clmul) ghash_clmul(ctx, y, data, len);
+    else ghash_table(ctx, y, data, len);
+}
+
+void gcm_init(gcm_ctx_t* ctx, const uint8_t key[16]) {
+    static const uint8_t zero[16] = { 0 };
+    uint8_t h[16];
+
+    gcm_probe();
+    aes128_init(&ctx->aes, key);
+    aes128_encrypt_block(&ctx->aes, zero, h);
+    gcm_gen_table(ctx, h);
+    for (int i = 0; i < 16; i++) ctx->h[i] = h[15 - i];
+}
+
+static void gcm_tag(const gcm_ctx_t* ctx, const uint8_t iv[12], const uint8_t* aad, size_t aad_len,
+                    const uint8_t* ct, size_t len, uint8_t tag[16]) {
+    uint8_t y[16], lens[16], j0[16];
+    memset(y, 0, sizeof(y));
+    ghash(ctx, y, aad, aad_len);
+    ghash(ctx, y, ct, len);
+    put_be64(lens, (uint64_t)aad_len * 8);
+    put_be64(lens + 8, (uint64_t)len * 8);
+    ghash(ctx, y, lens, 16);
+
+    memcpy(j0, iv, 12);
+    j0[12] = 0; j0[13] = 0; j0[14] = 0; j0[15] = 1;
+    aes128_encrypt_block(&ctx->aes, j0, j0);
+    for (int i = 0; i < 16; i++) tag[i] = y[i] ^ j0[i];
+}
+
+static void gcm_ctr(const gcm_ctx_t* ctx, const uint8_t iv[12], const uint8_t* in, uint8_t* out, size_t len) {
+    uint8_t ctr[16];
+    memcpy(ctr, iv, 12);
+    ctr[12] = 0; ctr[13] = 0; ctr[14] = 0; ctr[15] = 2;
+    aes128_ctr32(&ctx->aes, ctr, in, out, len);
+}
+
+void gcm_seal(const gcm_ctx_t* ctx, const uint8_t iv[12], const uint8_t* aad, size_t aad_len,
+              const uint8_t* in, uint8_t* out, size_t len, uint8_t tag[16]) {
+    gcm_ctr(ctx, iv, in, out, len);
+    gcm_tag(ctx, iv, aad, aad_len, out, len, tag);
+}
+
+int gcm_open(const gcm_ctx_t* ctx, const uint8_t iv[12], const uint8_t* aad, size_t aad_len,
+             const uint8_t* in, uint8_t* out, size_t len, const uint8_t tag[16]) {
+    uint8_t expect[16];
+    gcm_tag(ctx, iv, aad, aad_len, in, len, expect);
+
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; i++) diff |= expect[i] ^ tag[i];
+    if (diff) {
+        if (out != in) memset(out, 0, len);
+        return -1;
+    }
+    gcm_ctr(ctx, iv, in, out, len);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "aes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* AES-128-GCM (NIST SP 800-38D) with 96-bit IVs.
+ * GHASH uses PCLMULQDQ when available, else 4-bit tables (Shoup).
+ */
+typedef struct {
+    aes128_ctx_t aes;
+    uint8_t  h[16];          /* Hash key, byte-reflected for the CLMUL path */
+    uint64_t hl[16];         /* Multiples of H, table path */
+    uint64_t hh[16];
+} gcm_ctx_t;
+
+void gcm_init(gcm_ctx_t* ctx, const uint8_t key[16]);
+
+/* in/out may alias. open returns 0, or -1 if the tag does not match
+   (out is then scrubbed). */
+void gcm_seal(const gcm_ctx_t* ctx, const uint8_t iv[12], const uint8_t* aad, size_t aad_len,
+              const uint8_t* in, uint8_t* out, size_t len, uint8_t tag[16]);
+int  gcm_open(const gcm_ctx_t* ctx, const uint8_t iv[12], const uint8_t* aad, size_t aad_len,
+              const uint8_t* in, uint8_t* out, size_t len, const uint8_t tag[16]);
+
+const char* gcm_impl_name(void);
+void gcm_set_impl(int use_clmul);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,105 @@
+#include "hmac.h"
+#include "../string.h"
+
+void hmac_sha256_init(hmac_sha256_ctx_t* ctx, const uint8_t* key, size_t key_len) {
+    uint8_t k[64];
+    memset(k, 0, sizeof(k));
+    if (key_len > 64) {
+        sha256_ctx_t h;
+        sha256_init(&h);
+        sha256_update(&h, key, key_len);
+        sha256_final(&h, k);
+    } else {
+        memcpy(k, key, key_len);
+    }
+
+    uint8_t pad[64];
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x36;
+    sha256_init(&ctx->inner);
+    sha256_update(&ctx->inner, pad, 64);
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x5c;
+    sha256_init(&ctx->outer);
+    sha256_update(&ctx->outer, pad, 64);
+    memset(k, 0, sizeof(k));
+}
+
+void hmac_sha256_update(hmac_sha256_ctx_t* ctx, const uint8_t* data, size_t len) {
+    sha256_update(&ctx->inner, data, len);
+}
+
+void hmac_sha256_final(hmac_sha256_ctx_t* ctx, uint8_t mac[32]) {
+    uint8_t ih[32];
+    sha256_final(&ctx->inner, ih);
+    sha256_update(&ctx->outer, ih, 32);
+    sha256_final(&ctx->outer, mac);
+}
+
+void hmac_sha256(const uint8_t* key, size_t key_len, const uint8_t* data, size_t len, uint8_t mac[32]) {
+    hmac_sha256_ctx_t ctx;
+    hmac_sha256_init(&ctx, key, key_len);
+    hmac_sha256_update(&ctx, data, len);
+    hmac_sha256_final(&ctx, mac);
+}
+
+void hkdf_sha256_extract(const uint8_t* salt, size_t salt_len, const uint8_t* ikm, size_t ikm_len,
+                         uint8_t prk[32]) {
+    static const uint8_t zero[32] = { 0 };
+    if (!salt || salt_len == 0) {
+        salt = zero;
+        salt_len = 32;
+    }
+    hmac_sha256(salt, salt_len, ikm, ikm_len, prk);
+}
+
+void hkdf_sha256_expand(const uint8_t prk[32], const uint8_t* info, size_t info_len,
+                        uint8_t* out, size_t out_len) {
+    uint8_t t[32];
+    size_t t_len = 0;
+    uint8_t counter = 1;
+
+    while (out_len) {
+        hmac_sha256_ctx_t ctx;
+        hmac_sha256_init(&ctx, prk, 32);
+        hmac_sha256_update(&ctx, t, t_len);
+        hmac_sha256_update(&ctx, info, info_len);
+        hmac_sha256_update(&ctx, &counter, 1);
+        hmac_sha256_final(&ctx, t);
+        t_len = 32;
+
+        size_t n = out_len < 32 ? out_len : 32;
+        memcpy(out, t, n);
+        out += n;
+        out_len -= n;
+        counter++;
+    }
+}
+
+/* P_SHA256(secret, label || seed) */
+void tls12_prf_sha256(const uint8_t* secret, size_t secret_len, const char* label,
+                      const uint8_t* seed, size_t seed_len, uint8_t* out, size_t out_len) {
+    size_t label_len = strlen(label);
+    uint8_t a[32];
+    hmac_sha256_ctx_t ctx;
+
+    /* A(1) */
+    hmac_sha256_init(&ctx, secret, secret_len);
+    hmac_sha256_update(&ctx, (const uint8_t*)label, label_len);
+    hmac_sha256_update(&ctx, seed, seed_len);
+    hmac_sha256_final(&ctx, a);
+
+    while (out_len) {
+        uint8_t block[32];
+        hmac_sha256_init(&ctx, secret, secret_len);
+        hmac_sha256_update(&ctx, a, 32);
+        hmac_sha256_update(&ctx, (const uint8_t*)label, label_len);
+        hmac_sha256_update(&ctx, seed, seed_len);
+        hmac_sha256_final(&ctx, block);
+
+        size_t n = out_len < 32 ? out_len : 32;
+        memcpy(out, block, n);
+        out += n;
+        out_len -= n;
+
+        hmac_sha256(secret, secret_len, a, 32, a);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "sha256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* HMAC-SHA256 (RFC 2104), HKDF (RFC 5869) and the TLS 1.2 PRF (RFC 5246) */
+typedef struct {
+    sha256_ctx_t inner;
+    sha256_ctx_t outer;
+} hmac_sha256_ctx_t;
+
+void hmac_sha256_init(hmac_sha256_ctx_t* ctx, const uint8_t* key, size_t key_len);
+void hmac_sha256_update(hmac_sha256_ctx_t* ctx, const uint8_t* data, size_t len);
+void hmac_sha256_final(hmac_sha256_ctx_t* ctx, uint8_t mac[32]);
+void hmac_sha256(const uint8_t* key, size_t key_len, const uint8_t* data, size_t len, uint8_t mac[32]);
+
+void hkdf_sha256_extract(const uint8_t* salt, size_t salt_len, const uint8_t* ikm, size_t ikm_len,
+                         uint8_t prk[32]);
+void hkdf_sha256_expand(const uint8_t prk[32], const uint8_t* info, size_t info_len,
+                        uint8_t* out, size_t out_len);
+
+void tls12_prf_sha256(const uint8_t* secret, size_t secret_len, const char* label,
+                      const uint8_t* seed, size_t seed_len, uint8_t* out, size_t out_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,128 @@
+#include "poly1305.h"
+#include "../string.h"
+
+static inline uint32_t get_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_le32(uint8_t* p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+void poly1305_init(poly1305_ctx_t* ctx, const uint8_t key[32]) {
+    /* r is clamped as it is split into 26-bit limbs */
+    ctx->r[0] = get_le32(key) & 0x3ffffff;
+    ctx->r[1] = (get_le32(key + 3) >> 2) & 0x3ffff03;
+    ctx->r[2] = (get_le32(key + 6) >> 4) & 0x3ffc0ff;
+    ctx->r[3] = (get_le32(key + 9) >> 6) & 0x3f03fff;
+    ctx->r[4] = (get_le32(key + 12) >> 8) & 0x00fffff;
+
+    for (int i = 0; i < 5; i++) ctx->h[i] = 0;
+    for (int i = 0; i < 4; i++) ctx->pad[i] = get_le32(key + 16 + i * 4);
+    ctx->buf_len = 0;
+}
+
+/* h = (h + m) * r mod 2^130 - 5 for each 16-byte block; hibit is 2^128 for full blocks */
+static void poly1305_blocks(poly1305_ctx_t* ctx, const uint8_t* m, size_t len, uint32_t hibit) {
+    const uint32_t r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2], r3 = ctx->r[3], r4 = ctx->r[4];
+    const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], h3 = ctx->h[3], h4 = ctx->h[4];
+
+    while (len >= 16) {
+        h0 += get_le32(m) & 0x3ffffff;
+        h1 += (get_le32(m + 3) >> 2) & 0x3ffffff;
+        h2 += (get_le32(m + 6) >> 4) & 0x3ffffff;
+        h3 += (get_le32(m + 9) >> 6) & 0x3ffffff;
+        h4 += (get_le32(m + 12) >> 8) | hibit;
+
+        uint64_t d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 + (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+        uint64_t d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 + (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+        uint64_t d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 + (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+        uint64_t d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 + (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+        uint64_t d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 + (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+        uint32_t c;
+        c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+        d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+        d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+        d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+        d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+        h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+        h1 += c;
+
+        m += 16;
+        len -= 16;
+    }
+
+    ctx->h[0] = h0; ctx->h[1] = h1; ctx->h[2] = h2; ctx->h[3] = h3; ctx->h[4] = h4;
+}
+
+void poly1305_update(poly1305_ctx_t* ctx, const uint8_t* data, size_t len) {
+    if (ctx->buf_len) {
+        size_t want = 16 - ctx->buf_len;
+        if (want > len) want = len;
+        memcpy(ctx->buf + ctx->buf_len, data, want);
+        ctx->buf_len += want;
+        data += want;
+        len -= want;
+        if (ctx->buf_len < 16) return;
+        poly1305_blocks(ctx, ctx->buf, 16, 1u << 24);
+        ctx->buf_len = 0;
+    }
+    if (len >= 16) {
+        size_t full = len & ~(size_t)15;
+        poly1305_blocks(ctx, data, full, 1u << 24);
+        data += full;
+        len -= full;
+    }
+    if (len) {
+        memcpy(ctx->buf, data, len);
+        ctx->buf_len = len;
+    }
+}
+
+void poly1305_final(poly1305_ctx_t* ctx, uint8_t mac[16]) {
+    if (ctx->buf_len) {
+        /* Final partial block: 0x01 terminator instead of the 2^128 bit */
+        ctx->buf[ctx->buf_len] = 1;
+        for (size_t i = ctx->buf_len + 1; i < 16; i++) ctx->buf[i] = 0;
+        poly1305_blocks(ctx, ctx->buf, 16, 0);
+    }
+
+    uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], h3 = ctx->h[3], h4 = ctx->h[4];
+    uint32_t c;
+    c = h1 >> 26; h1 &= 0x3ffffff;
+    h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+    h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+    h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+    h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+    h1 += c;
+
+    /* g = h + 5 - 2^130; pick g if it did not underflow (constant time) */
+    uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+    uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+    uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+    uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+    uint32_t g4 = h4 + c - (1u << 26);
+
+    uint32_t mask = (g4 >> 31) - 1;
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+    h2 = (h2 & ~mask) | (g2 & mask);
+    h3 = (h3 & ~mask) | (g3 & mask);
+    h4 = (h4 & ~mask) | (g4 & mask);
+
+    /* h mod 2^128, then + s */
+    uint32_t w0 = h0 | (h1 << 26);
+    uint32_t w1 = (h1 >> 6) | (h2 << 20);
+    uint32_t w2 = (h2 >> 12) | (h3 << 14);
+    uint32_t w3 = (h3 >> 18) | (h4 << 8);
+
+    uint64_t f;
+    f = (uint64_t)w0 + ctx->pad[0];             put_le32(mac, (uint32_t)f);
+    f = (uint64_t)w1 + ctx->pad[1] + (f >> 32); put_le32(mac + 4, (uint32_t)f);
+    f = (uint64_t)w2 + ctx->pad[2] + (f >> 32); put_le32(mac + 8, (uint32_t)f);
+    f = (uint64_t)w3 + ctx->pad[3] + (f >> 32); put_le32(mac + 12, (uint32_t)f);
+
+    memset(ctx, 0, sizeof(*ctx));
+}
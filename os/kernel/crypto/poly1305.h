@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Poly1305 one-time authenticator (RFC 8439), 26-bit limbs */
+typedef struct {
+    uint32_t r[5];
+    uint32_t h[5];
+    uint32_t pad[4];
+    uint8_t  buf[16];
+    size_t   buf_len;
+} poly1305_ctx_t;
+
+void poly1305_init(poly1305_ctx_t* ctx, const uint8_t key[32]);
+void poly1305_update(poly1305_ctx_t* ctx, const uint8_t* data, size_t len);
+void poly1305_final(poly1305_ctx_t* ctx, uint8_t mac[16]);
+
+#ifdef __cplusplus
+}
+#endif
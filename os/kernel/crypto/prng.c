@@ -1,4 +1,7 @@
 #include "prng.h"
+#include "sha256.h"
+#include "../string.h"
+#include "../hardware/sse.h"
 
 static uint32_t state = 0xDEADBEEF;
 
@@ -14,4 +17,61 @@ uint32_t prng_next(void) {
     x ^= x << 5;
     state = x;
     return x;
-}
\ No newline at end of file
+}
+
+/* Key material: SHA-256 over a 32-byte pool, a counter, the TSC, the
+   xorshift state and RDRAND output when the CPU has it. The pool is
+   rehashed after every block so earlier outputs cannot be recomputed. */
+static uint8_t  pool[32];
+static uint64_t pool_counter;
+static int      have_rdrand = -1;
+
+static inline uint64_t prng_rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static int prng_rdrand(uint32_t* out) {
+    uint8_t ok;
+    __asm__ volatile("rdrand %0; setc %1" : "=r"(*out), "=qm"(ok) :: "cc");
+    return ok;
+}
+
+void prng_fill(void* buf, size_t len) {
+    uint8_t* out = (uint8_t*)buf;
+
+    if (have_rdrand < 0) have_rdrand = cpu_has_rdrand();
+
+    while (len) {
+        sha256_ctx_t sha;
+        uint8_t block[32];
+        uint32_t extra[4];
+
+        pool_counter++;
+        extra[0] = prng_next();
+        extra[1] = extra[2] = extra[3] = 0;
+        if (have_rdrand) {
+            for (int i = 1; i < 4; i++)
+                for (int tries = 0; tries < 10 && !prng_rdrand(&extra[i]); tries++) {}
+        }
+        uint64_t tsc = prng_rdtsc();
+
+        sha256_init(&sha);
+        sha256_update(&sha, pool, sizeof(pool));
+        sha256_update(&sha, (const uint8_t*)&pool_counter, sizeof(pool_counter));
+        sha256_update(&sha, (const uint8_t*)&tsc, sizeof(tsc));
+        sha256_update(&sha, (const uint8_t*)extra, sizeof(extra));
+        sha256_final(&sha, block);
+
+        sha256_init(&sha);
+        sha256_update(&sha, block, sizeof(block));
+        sha256_update(&sha, pool, sizeof(pool));
+        sha256_final(&sha, pool);
+
+        size_t n = len < sizeof(block) ? len : sizeof(block);
+        memcpy(out, block, n);
+        out += n;
+        len -= n;
+    }
+}
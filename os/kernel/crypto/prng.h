@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -8,6 +9,9 @@ extern "C" {
 void prng_seed(uint32_t seed);
 uint32_t prng_next(void);
 
+/* Unpredictable bytes for keys and nonces (TSC/RDRAND mixed through SHA-256) */
+void prng_fill(void* buf, size_t len);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "rsa.h"
+#include "sha256.h"
+#include "../mm/kmalloc.h"
+#include "../string.h"
+
+/* Montgomery arithmetic on little-endian 32-bit limbs */
+typedef struct {
+    const uint32_t* n;
+    int s;
+    uint32_t n0inv;              /* -n^-1 mod 2^32 */
+} mont_t;
+
+static int bn_cmp(const uint32_t* a, const uint32_t* b, int s) {
+    for (int i = s - 1; i >= 0; i--) {
+        if (a[i] != b[i]) return a[i] > b[i] ? 1 : -1;
+    }
+    return 0;
+}
+
+static uint32_t bn_sub(uint32_t* r, const uint32_t* a, const uint32_t* b, int s) {
+    uint32_t borrow = 0;
+    for (int i = 0; i < s; i++) {
+        uint64_t d = (uint64_t)a[i] - b[i] - borrow;
+        r[i] = (uint32_t)d;
+        borrow = (uint32_t)(d >> 32) & 1;
+    }
+    return borrow;
+}
+
+/* r = a * b * 2^(-32 s) mod n (CIOS); t needs s + 2 limbs */
+static void mont_mul(const mont_t* m, uint32_t* r, const uint32_t* a, const uint32_t* b, uint32_t* t) {
+    int s = m->s;
+    for (int i = 0; i < s + 2; i++) t[i] = 0;
+
+    for (int i = 0; i < s; i++) {
+        uint64_t c = 0;
+        uint32_t bi = b[i];
+        for (int j = 0; j < s; j++) {
+            c += (uint64_t)a[j] * bi + t[j];
+            t[j] = (uint32_t)c;
+            c >>= 32;
+        }
+        c += t[s];
+        t[s] = (uint32_t)c;
+        t[s + 1] = (uint32_t)(c >> 32);
+
+        uint32_t q = t[0] * m->n0inv;
+        c = (uint64_t)q * m->n[0] + t[0];
+        c >>= 32;
+        for (int j = 1; j < s; j++) {
+            c += (uint64_t)q * m->n[j] + t[j];
+            t[j - 1] = (uint32_t)c;
+            c >>= 32;
+        }
+        c += t[s];
+        t[s - 1] = (uint32_t)c;
+        t[s] = t[s + 1] + (uint32_t)(c >> 32);
+    }
+
+    if (t[s] || bn_cmp(t, m->n, s) >= 0) bn_sub(r, t, m->n, s);
+    else memcpy(r, t, s * sizeof(uint32_t));
+}
+
+int rsa_pubkey_init(rsa_pubkey_t* key, const uint8_t* n, size_t n_len, const uint8_t* e, size_t e_len) {
+    while (n_len && *n == 0) { n++; n_len--; }
+    while (e_len && *e == 0) { e++; e_len--; }
+    if (n_len < 64 || n_len > RSA_MAX_BITS / 8 || e_len == 0 || e_len > 4) return -1;
+    if (!(n[n_len - 1] & 1)) return -1;
+
+    memset(key, 0, sizeof(*key));
+    key->n_bytes = n_len;
+    key->limbs = (int)((n_len + 3) / 4);
+    for (size_t i = 0; i < n_len; i++) {
+        size_t bit = (n_len - 1 - i) * 8;
+        key->n[bit / 32] |= (uint32_t)n[i] << (bit % 32);
+    }
+    for (size_t i = 0; i < e_len; i++) key->e = (key->e << 8) | e[i];
+    if (key->e < 3 || !(key->e & 1)) return -1;
+    return 0;
+}
+
+/* out = sig^e mod n as n_bytes big-endian bytes; -1 if sig >= n */
+static int rsa_public(const rsa_pubkey_t* key, const uint8_t* sig, uint8_t* out) {
+    int s = key->limbs;
+    uint32_t* buf = (uint32_t*)kmalloc((5 * s + 2) * sizeof(uint32_t));
+    if (!buf) return -1;
+    uint32_t* x = buf;           /* Base, Montgomery form */
+    uint32_t* acc = buf + s;     /* Accumulator */
+    uint32_t* r2 = buf + 2 * s;  /* R^2 mod n */
+    uint32_t* tmp = buf + 3 * s;
+    uint32_t* t = buf + 4 * s;   /* s + 2 limbs */
+    int ret = -1;
+
+    mont_t m;
+    m.n = key->n;
+    m.s = s;
+    uint32_t inv = 1;            /* Newton: n0^-1 mod 2^32 */
+    for (int i = 0; i < 5; i++) inv *= 2 - key->n[0] * inv;
+    m.n0inv = -inv;
+
+    memset(x, 0, s * sizeof(uint32_t));
+    for (size_t i = 0; i < key->n_bytes; i++) {
+        size_t bit = (key->n_bytes - 1 - i) * 8;
+        x[bit / 32] |= (uint32_t)sig[i] << (bit % 32);
+    }
+    if (bn_cmp(x, key->n, s) >= 0) goto out;
+
+    /* R^2 mod n by doubling 1 (2 * 32 * s) times */
+    memset(r2, 0, s * sizeof(uint32_t));
+    r2[0] = 1;
+    for (int i = 0; i < 64 * s; i++) {
+        uint32_t carry = 0;
+        for (int j = 0; j < s; j++) {
+            uint32_t v = r2[j];
+            r2[j] = (v << 1) | carry;
+            carry = v >> 31;
+        }
+        if (carry || bn_cmp(r2, key->n, s) >= 0) bn_sub(r2, r2, key->n, s);
+    }
+
+    /* Left-to-right square and multiply over the (public) exponent */
+    mont_mul(&m, x, x, r2, t);
+    memcpy(acc, x, s * sizeof(uint32_t));
+    int top = 31;
+    while (!(key->e >> top)) top--;
+    for (int i = top - 1; i >= 0; i--) {
+        mont_mul(&m, tmp, acc, acc, t);
+        if ((key->e >> i) & 1) mont_mul(&m, acc, tmp, x, t);
+        else memcpy(acc, tmp, s * sizeof(uint32_t));
+    }
+
+    /* Leave Montgomery form: multiply by 1 */
+    memset(tmp, 0, s * sizeof(uint32_t));
+    tmp[0] = 1;
+    mont_mul(&m, acc, acc, tmp, t);
+
+    for (size_t i = 0; i < key->n_bytes; i++) {
+        size_t bit = (key->n_bytes - 1 - i) * 8;
+        out[i] = (uint8_t)(acc[bit / 32] >> (bit % 32));
+    }
+    ret = 0;
+out:
+    kfree(buf);
+    return ret;
+}
+
+int rsa_verify_pkcs1_sha256(const rsa_pubkey_t* key, const uint8_t hash[32], const uint8_t* sig, size_t sig_len) {
+    static const uint8_t digest_info[19] = {
+        0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01,
+        0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20
+    };
+    uint8_t em[RSA_MAX_BITS / 8];
+    size_t k = key->n_bytes;
+
+    if (sig_len != k || k < 11 + sizeof(digest_info) + 32) return -1;
+    if (rsa_public(key, sig, em) < 0) return -1;
+
+    /* 00 01 FF..FF 00 DigestInfo hash */
+    size_t ps_end = k - 32 - sizeof(digest_info) - 1;
+    if (em[0] != 0x00 || em[1] != 0x01 || em[ps_end] != 0x00) return -1;
+    for (size_t i = 2; i < ps_end; i++) {
+        if (em[i] != 0xFF) return -1;
+    }
+    if (memcmp(em + ps_end + 1, digest_info, sizeof(digest_info)) != 0) return -1;
+    return memcmp(em + k - 32, hash, 32) == 0 ? 0 : -1;
+}
+
+static void mgf1_sha256_xor(uint8_t* out, size_t len, const uint8_t* seed, size_t seed_len) {
+    uint8_t block[32];
+    uint32_t counter = 0;
+    while (len) {
+        uint8_t c[4] = { (uint8_t)(counter >> 24), (uint8_t)(counter >> 16), (uint8_t)(counter >> 8), (uint8_t)counter };
+        sha256_ctx_t h;
+        sha256_init(&h);
+        sha256_update(&h, seed, seed_len);
+        sha256_update(&h, c, 4);
+        sha256_final(&h, block);
+        size_t n = len < 32 ? len : 32;
+        for (size_t i = 0; i < n; i++) out[i] ^= block[i];
+        out += n;
+        len -= n;
+        counter++;
+    }
+}
+
+int rsa_verify_pss_sha256(const rsa_pubkey_t* key, const uint8_t hash[32], const uint8_t* sig, size_t sig_len) {
+    uint8_t m[RSA_MAX_BITS / 8];
+    size_t k = key->n_bytes;
+    if (sig_len != k || rsa_public(key, sig, m) < 0) return -1;
+
+    /* emBits = modBits - 1 */
+    int top = 31;
+    uint32_t msw = key->n[key->limbs - 1];
+    while (!(msw >> top)) top--;
+    size_t mod_bits = (size_t)(key->limbs - 1) * 32 + top + 1;
+    size_t em_bits = mod_bits - 1;
+    size_t em_len = (em_bits + 7) / 8;
+    const size_t h_len = 32, s_len = 32;
+
+    uint8_t* em = m + (k - em_len);
+    if (k > em_len && m[0] != 0) return -1;
+    if (em_len < h_len + s_len + 2 || em[em_len - 1] != 0xbc) return -1;
+
+    size_t db_len = em_len - h_len - 1;
+    uint8_t* db = em;
+    const uint8_t* h = em + db_len;
+    uint8_t top_mask = (uint8_t)(0xFF >> (8 * em_len - em_bits));
+    if (db[0] & ~top_mask) return -1;
+
+    mgf1_sha256_xor(db, db_len, h, h_len);
+    db[0] &= top_mask;
+
+    size_t ps_len = db_len - s_len - 1;
+    for (size_t i = 0; i < ps_len; i++) {
+        if (db[i] != 0) return -1;
+    }
+    if (db[ps_len] != 0x01) return -1;
+
+    /* H' = SHA256(00 * 8 || mHash || salt) */
+    static const uint8_t zeros[8] = { 0 };
+    uint8_t h2[32];
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, zeros, 8);
+    sha256_update(&ctx, hash, 32);
+    sha256_update(&ctx, db + db_len - s_len, s_len);
+    sha256_final(&ctx, h2);
+    return memcmp(h2, h, h_len) == 0 ? 0 : -1;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* RSA public-key operations (signature verification only) */
+#define RSA_MAX_BITS   4096
+#define RSA_MAX_LIMBS  (RSA_MAX_BITS / 32)
+
+typedef struct {
+    uint32_t n[RSA_MAX_LIMBS];   /* Modulus, little-endian 32-bit limbs */
+    int      limbs;
+    size_t   n_bytes;            /* Modulus length in bytes (signature size) */
+    uint32_t e;
+} rsa_pubkey_t;
+
+/* Big-endian modulus/exponent as found in DER; 0 or -1 if unsupported */
+int rsa_pubkey_init(rsa_pubkey_t* key, const uint8_t* n, size_t n_len, const uint8_t* e, size_t e_len);
+
+/* SHA-256 digest signatures: PKCS#1 v1.5 and PSS (MGF1-SHA256, 32-byte salt).
+   0 if valid, -1 otherwise. */
+int rsa_verify_pkcs1_sha256(const rsa_pubkey_t* key, const uint8_t hash[32], const uint8_t* sig, size_t sig_len);
+int rsa_verify_pss_sha256(const rsa_pubkey_t* key, const uint8_t hash[32], const uint8_t* sig, size_t sig_len);
+
+#ifdef __cplusplus
+}
+#endif
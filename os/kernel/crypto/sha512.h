@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t data[128];
+    uint32_t datalen;
+    uint64_t bitlen;
+    uint64_t state[8];
+} sha512_ctx_t;
+
+void sha512_init(sha512_ctx_t *ctx);
+void sha512_update(sha512_ctx_t *ctx, const uint8_t *data, size_t len);
+void sha512_final(sha512_ctx_t *ctx, uint8_t hash[64]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,120 @@
+#include "x509.h"
+#include "../string.h"
+
+#define ASN1_INTEGER    0x02
+#define ASN1_BITSTRING  0x03
+#define ASN1_OID        0x06
+#define ASN1_SEQUENCE   0x30
+#define ASN1_SET        0x31
+#define ASN1_CTX0       0xA0
+
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+} der_t;
+
+/* Read one TLV; body in *val. 0, or -1 if malformed. */
+static int der_next(der_t* d, uint8_t* tag, der_t* val) {
+    if (d->end - d->p < 2) return -1;
+    *tag = *d->p++;
+    size_t len = *d->p++;
+    if (len & 0x80) {
+        int n = len & 0x7F;
+        if (n == 0 || n > 3 || d->end - d->p < n) return -1;
+        len = 0;
+        while (n--) len = (len << 8) | *d->p++;
+    }
+    if ((size_t)(d->end - d->p) < len) return -1;
+    val->p = d->p;
+    val->end = d->p + len;
+    d->p += len;
+    return 0;
+}
+
+static int der_expect(der_t* d, uint8_t want, der_t* val) {
+    uint8_t tag;
+    if (der_next(d, &tag, val) < 0 || tag != want) return -1;
+    return 0;
+}
+
+/* Certificate -> TBSCertificate, positioned after the version field */
+static int x509_tbs(const uint8_t* der, size_t len, der_t* tbs) {
+    der_t d = { der, der + len }, cert;
+    if (der_expect(&d, ASN1_SEQUENCE, &cert) < 0) return -1;
+    if (der_expect(&cert, ASN1_SEQUENCE, tbs) < 0) return -1;
+    if (tbs->p < tbs->end && *tbs->p == ASN1_CTX0) {
+        der_t ver;
+        uint8_t tag;
+        if (der_next(tbs, &tag, &ver) < 0) return -1;
+    }
+    return 0;
+}
+
+int x509_parse_pubkey(const uint8_t* der, size_t len, x509_pubkey_t* out) {
+    static const uint8_t oid_rsa[9] = { 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01 };
+    static const uint8_t oid_ed25519[3] = { 0x2b, 0x65, 0x70 };
+    der_t tbs, skip, spki, alg, oid, bits;
+    uint8_t tag;
+
+    out->type = X509_KEY_NONE;
+    if (x509_tbs(der, len, &tbs) < 0) return -1;
+
+    /* serialNumber, signature, issuer, validity, subject */
+    for (int i = 0; i < 5; i++) {
+        if (der_next(&tbs, &tag, &skip) < 0) return -1;
+    }
+
+    if (der_expect(&tbs, ASN1_SEQUENCE, &spki) < 0) return -1;
+    if (der_expect(&spki, ASN1_SEQUENCE, &alg) < 0) return -1;
+    if (der_expect(&alg, ASN1_OID, &oid) < 0) return -1;
+    if (der_expect(&spki, ASN1_BITSTRING, &bits) < 0) return -1;
+    if (bits.p >= bits.end || *bits.p != 0) return -1; /* Unused-bits count */
+    bits.p++;
+
+    size_t oid_len = oid.end - oid.p;
+    if (oid_len == sizeof(oid_rsa) && memcmp(oid.p, oid_rsa, oid_len) == 0) {
+        der_t key, n, e;
+        if (der_expect(&bits, ASN1_SEQUENCE, &key) < 0) return -1;
+        if (der_expect(&key, ASN1_INTEGER, &n) < 0) return -1;
+        if (der_expect(&key, ASN1_INTEGER, &e) < 0) return -1;
+        if (rsa_pubkey_init(&out->rsa, n.p, n.end - n.p, e.p, e.end - e.p) < 0) return -1;
+        out->type = X509_KEY_RSA;
+        return 0;
+    }
+    if (oid_len == sizeof(oid_ed25519) && memcmp(oid.p, oid_ed25519, oid_len) == 0) {
+        if (bits.end - bits.p != 32) return -1;
+        memcpy(out->ed25519, bits.p, 32);
+        out->type = X509_KEY_ED25519;
+        return 0;
+    }
+    return -1;
+}
+
+int x509_subject_cn(const uint8_t* der, size_t len, char* out, size_t max) {
+    static const uint8_t oid_cn[3] = { 0x55, 0x04, 0x03 };
+    der_t tbs, skip, subject;
+    uint8_t tag;
+
+    if (max == 0 || x509_tbs(der, len, &tbs) < 0) return -1;
+    for (int i = 0; i < 4; i++) {
+        if (der_next(&tbs, &tag, &skip) < 0) return -1;
+    }
+    if (der_expect(&tbs, ASN1_SEQUENCE, &subject) < 0) return -1;
+
+    /* Name ::= SEQUENCE OF SET OF { OID, value } */
+    der_t rdn;
+    while (der_expect(&subject, ASN1_SET, &rdn) == 0) {
+        der_t atv, oid, val;
+        if (der_expect(&rdn, ASN1_SEQUENCE, &atv) < 0) continue;
+        if (der_expect(&atv, ASN1_OID, &oid) < 0) continue;
+        if (der_next(&atv, &tag, &val) < 0) continue;
+        if ((size_t)(oid.end - oid.p) == sizeof(oid_cn) && memcmp(oid.p, oid_cn, sizeof(oid_cn)) == 0) {
+            size_t n = val.end - val.p;
+            if (n >= max) n = max - 1;
+            memcpy(out, val.p, n);
+            out[n] = 0;
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "rsa.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Just enough DER/X.509 to pull the subject public key out of a certificate */
+#define X509_KEY_NONE     0
+#define X509_KEY_RSA      1
+#define X509_KEY_ED25519  2
+
+typedef struct {
+    int type;
+    rsa_pubkey_t rsa;
+    uint8_t ed25519[32];
+} x509_pubkey_t;
+
+/* 0, or -1 if the certificate is malformed or the key type unsupported */
+int x509_parse_pubkey(const uint8_t* der, size_t len, x509_pubkey_t* out);
+
+/* Subject common name (truncated to max-1), for diagnostics; 0 if found */
+int x509_subject_cn(const uint8_t* der, size_t len, char* out, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
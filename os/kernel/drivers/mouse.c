@@ -1,6 +1,6 @@
 /* kernel/drivers/mouse.c
- * Software Mouse Cursor Subsystem for Chrysalis OS
- * Implements PS/2 Mouse Driver + Software Cursor Rendering + Scroll Wheel
+ * PS/2 Mouse Driver for Chrysalis OS (with Scroll Wheel)
+ * The pointer itself is drawn by the cursor plane (video/cursor.c)
  */
 
 #include "mouse.h"
@@ -9,7 +9,7 @@
 #include "../drivers/serial.h"
 #include "../interrupts/irq.h"
 #include "../video/gpu.h"
-#include "../video/fb_console.h"
+#include "../video/cursor.h"
 #include "../input/input.h"
 
 /* Import serial logging from kernel glue */
@@ -25,39 +25,8 @@ static uint8_t mouse_cycle = 0;
 static int8_t  mouse_byte[4];
 static int32_t mouse_x = 0;
 static int32_t mouse_y = 0;
-static int32_t prev_mouse_x = 0;
-static int32_t prev_mouse_y = 0;
 static bool    mouse_has_wheel = false;
-static bool    cursor_drawn = false;
 static uint8_t prev_buttons = 0;
-static volatile bool mouse_blocked = false;
-
-/* Cursor Bitmap (16x16)
- * 0 = Transparent
- * 1 = Black (Border)
- * 2 = White (Fill)
- */
-static const uint8_t cursor_bitmap[16 * 16] = {
-    1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-    1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-    1,2,1,0,0,0,0,0,0,0,0,0,0,0,0,0,
-    1,2,2,1,0,0,0,0,0,0,0,0,0,0,0,0,
-    1,2,2,2,1,0,0,0,0,0,0,0,0,0,0,0,
-    1,2,2,2,2,1,0,0,0,0,0,0,0,0,0,0,
-    1,2,2,2,2,2,1,0,0,0,0,0,0,0,0,0,
-    1,2,2,2,2,2,2,1,0,0,0,0,0,0,0,0,
-    1,2,2,2,2,2,2,2,1,0,0,0,0,0,0,0,
-    1,2,2,2,2,2,2,2,2,1,0,0,0,0,0,0,
-    1,2,2,2,2,2,1,1,1,1,0,0,0,0,0,0,
-    1,2,2,1,2,2,1,0,0,0,0,0,0,0,0,0,
-    1,2,1,0,1,2,2,1,0,0,0,0,0,0,0,0,
-    1,1,0,0,1,2,2,1,0,0,0,0,0,0,0,0,
-    1,0,0,0,0,1,2,2,1,0,0,0,0,0,0,0,
-    0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0
-};
-
-/* Save-under buffer to restore background */
-static uint32_t cursor_save_buffer[16 * 16];
 
 /* --- PS/2 Helpers --- */
 
@@ -86,100 +55,6 @@ static uint8_t mouse_read(void) {
     return inb(MOUSE_PORT_DATA);
 }
 
-/* --- Software Cursor Rendering --- */
-
-static uint32_t get_pixel(gpu_device_t* dev, int x, int y) {
-    if (!dev || !dev->virt_addr) return 0;
-    if (x < 0 || x >= (int)dev->width || y < 0 || y >= (int)dev->height) return 0;
-
-    /* Assuming 32bpp for simplicity as per kernel setup */
-    uint32_t offset = y * (dev->pitch / 4) + x;
-    uint32_t* fb = (uint32_t*)dev->virt_addr;
-    return fb[offset];
-}
-
-static void draw_pixel(gpu_device_t* dev, int x, int y, uint32_t color) {
-    if (dev && dev->ops && dev->ops->putpixel) {
-        dev->ops->putpixel(dev, x, y, color);
-    }
-}
-
-static void restore_cursor_background(gpu_device_t* dev) {
-    if (!cursor_drawn) return;
-
-    for (int y = 0; y < 16; y++) {
-        for (int x = 0; x < 16; x++) {
-            int px = prev_mouse_x + x;
-            int py = prev_mouse_y + y;
-            draw_pixel(dev, px, py, cursor_save_buffer[y * 16 + x]);
-        }
-    }
-    cursor_drawn = false;
-}
-
-static void save_cursor_background(gpu_device_t* dev, int mx, int my) {
-    for (int y = 0; y < 16; y++) {
-        for (int x = 0; x < 16; x++) {
-            int px = mx + x;
-            int py = my + y;
-            cursor_save_buffer[y * 16 + x] = get_pixel(dev, px, py);
-        }
-    }
-}
-
-static void draw_cursor_sprite(gpu_device_t* dev, int mx, int my) {
-    for (int y = 0; y < 16; y++) {
-        for (int x = 0; x < 16; x++) {
-            uint8_t type = cursor_bitmap[y * 16 + x];
-            int px = mx + x;
-            int py = my + y;
-
-            if (type == 1) {
-                draw_pixel(dev, px, py, 0xFF000000); // Black border
-            } else if (type == 2) {
-                draw_pixel(dev, px, py, 0xFFFFFFFF); // White fill
-            }
-        }
-    }
-}
-
-static void update_cursor(void) {
-    /* If blocked by compositor, do not draw. Compositor will call end() later. */
-    if (mouse_blocked) return;
-
-    gpu_device_t* gpu = gpu_get_primary();
-    if (!gpu) return;
-
-    restore_cursor_background(gpu);
-    save_cursor_background(gpu, mouse_x, mouse_y);
-    draw_cursor_sprite(gpu, mouse_x, mouse_y);
-
-    prev_mouse_x = mouse_x;
-    prev_mouse_y = mouse_y;
-    cursor_drawn = true;
-}
-
-/* --- Compositor Sync API --- */
-
-void mouse_blit_start(void) {
-    asm volatile("cli");
-    mouse_blocked = true;
-    gpu_device_t* gpu = gpu_get_primary();
-    /* Erase cursor from VRAM so compositor can draw clean frame */
-    if (gpu && cursor_drawn) {
-        restore_cursor_background(gpu);
-    }
-    asm volatile("sti");
-}
-
-void mouse_blit_end(void) {
-    asm volatile("cli");
-    mouse_blocked = false;
-    /* Redraw cursor on top of new frame */
-    update_cursor();
-    asm volatile("sti");
-}
-
 /* --- Interrupt Handler --- */
 void mouse_handler(registers_t* regs) {
     (void)regs;
@@ -261,8 +136,8 @@ void mouse_handler(registers_t* regs) {
         }
     }
 
-    /* Update Cursor on Screen */
-    update_cursor();
+    /* Only records the position: the pointer is drawn at the next frame */
+    cursor_move(mouse_x, mouse_y);
     
     /* Push Input Events */
     if (dx != 0 || dy != 0) {
@@ -353,6 +228,6 @@ void mouse_init(void) {
     if (gpu) {
         mouse_x = gpu->width / 2;
         mouse_y = gpu->height / 2;
-        update_cursor();
+        cursor_move(mouse_x, mouse_y);
     }
 }
\ No newline at end of file
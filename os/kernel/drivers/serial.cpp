@@ -124,3 +124,34 @@ void serial_printf(const char* fmt, ...)
 
     va_end(args);
 }
+
+/* --- COM2: raw byte stream (packet captures) --- */
+
+#define COM2 0x2F8
+#define UART_FIFO_DEPTH 16
+
+int serial2_init()
+{
+    /* Scratch register round trip: nothing answers on an absent port */
+    outb(COM2 + 7, 0xA5);
+    if (inb(COM2 + 7) != 0xA5) return -1;
+
+    outb(COM2 + 1, 0x00);    // Disable interrupts
+    outb(COM2 + 3, 0x80);    // Enable DLAB
+    outb(COM2 + 0, 0x01);    // Divisor 1 → 115200
+    outb(COM2 + 1, 0x00);
+    outb(COM2 + 3, 0x03);    // 8N1
+    outb(COM2 + 2, 0xC7);    // Enable FIFO, clear, 14-byte threshold
+    outb(COM2 + 4, 0x03);    // DTR/RTS, no IRQ
+    return 0;
+}
+
+int serial2_write_nb(const void* buf, int len)
+{
+    /* THR empty means the whole transmit FIFO is free */
+    if (!(inb(COM2 + 5) & 0x20)) return 0;
+    const uint8_t* p = (const uint8_t*)buf;
+    int n = len < UART_FIFO_DEPTH ? len : UART_FIFO_DEPTH;
+    for (int i = 0; i < n; i++) outb(COM2, p[i]);
+    return n;
+}
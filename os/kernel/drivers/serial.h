@@ -16,6 +16,10 @@ void serial_write_string(const char* str);
 /* NEW */
 void serial_printf(const char* fmt, ...);
 
+/* COM2 as a raw byte stream, 115200 8N1 (e.g. pcap to a host file) */
+int  serial2_init();                              /* -1 if no UART */
+int  serial2_write_nb(const void* buf, int len);  /* Bytes taken without waiting */
+
 #ifdef __cplusplus
 }
 #endif
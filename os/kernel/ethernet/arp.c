@@ -1,6 +1,9 @@
 #include "arp.h"
+#include "net.h"
+#include "../mm/kmalloc.h"
 #include "../string.h"
 #include "../terminal.h"
+#include <errno.h>
 
 extern void serial(const char *fmt, ...);
 
@@ -8,107 +11,279 @@ extern void serial(const char *fmt, ...);
 #define ARP_OP_REPLY   2
 #define ARP_HW_ETH     1
 
-typedef struct {
-    uint32_t ip;
+/* Packet waiting for its next hop to resolve */
+typedef struct arp_pending {
+    struct arp_pending* next;
+    size_t len;
+    uint8_t data[];
+} arp_pending_t;
+
+typedef struct arp_entry {
+    struct arp_entry* hnext;
+    uint32_t ip;                  /* Network byte order */
     uint8_t mac[6];
-    int valid;
+    arp_state_t state;
+    net_device_t* dev;
+    uint32_t updated;             /* Last confirmation (ms) */
+    uint32_t used;                /* Last lookup (ms) */
+    uint32_t next_probe;          /* INCOMPLETE retransmit / STALE refresh deadline */
+    int probes;
+    arp_pending_t* queue;
+    int queue_len;
 } arp_entry_t;
 
-static arp_entry_t arp_cache[8];
-static int arp_victim_idx = 0;
+static arp_entry_t arp_pool[ARP_MAX_ENTRIES];
+static arp_entry_t* arp_hash[ARP_HASH_SIZE];
+
+static inline uint32_t arp_hash_fn(uint32_t ip) {
+    return (ip ^ (ip >> 8) ^ (ip >> 16) ^ (ip >> 24)) % ARP_HASH_SIZE;
+}
+
+static arp_entry_t* arp_find(uint32_t ip) {
+    arp_entry_t* e = arp_hash[arp_hash_fn(ip)];
+    while (e && e->ip != ip) e = e->hnext;
+    return e;
+}
+
+static void arp_flush_queue(arp_entry_t* e, int send) {
+    arp_pending_t* p = e->queue;
+    while (p) {
+        arp_pending_t* n = p->next;
+        if (send) eth_send(e->dev, e->mac, ETH_TYPE_IP, p->data, p->len);
+        kfree(p);
+        p = n;
+    }
+    e->queue = NULL;
+    e->queue_len = 0;
+}
+
+static void arp_free(arp_entry_t* e) {
+    arp_entry_t** pp = &arp_hash[arp_hash_fn(e->ip)];
+    while (*pp) {
+        if (*pp == e) { *pp = e->hnext; break; }
+        pp = &(*pp)->hnext;
+    }
+    arp_flush_queue(e, 0);
+    memset(e, 0, sizeof(*e));
+}
+
+/* Free slot, else evict the least recently used resolved entry */
+static arp_entry_t* arp_alloc(uint32_t ip, net_device_t* dev) {
+    arp_entry_t* victim = NULL;
+    for (int i = 0; i < ARP_MAX_ENTRIES; i++) {
+        arp_entry_t* e = &arp_pool[i];
+        if (e->state == ARP_FREE) { victim = e; break; }
+        if (e->state == ARP_INCOMPLETE) continue;
+        if (!victim || (int32_t)(e->used - victim->used) < 0) victim = e;
+    }
+    if (!victim) return NULL;
+    if (victim->state != ARP_FREE) arp_free(victim);
+
+    victim->ip = ip;
+    victim->dev = dev;
+    victim->used = net_time_ms();
+    uint32_t h = arp_hash_fn(ip);
+    victim->hnext = arp_hash[h];
+    arp_hash[h] = victim;
+    return victim;
+}
+
+static void arp_confirm(arp_entry_t* e, const uint8_t* mac) {
+    memcpy(e->mac, mac, 6);
+    e->state = ARP_REACHABLE;
+    e->updated = net_time_ms();
+    e->probes = 0;
+    if (e->queue) arp_flush_queue(e, 1);
+}
+
+static void arp_send(net_device_t* dev, uint16_t op, const uint8_t* eth_dst,
+                     const uint8_t* tha, uint32_t tpa) {
+    arp_packet_t pkt;
+    pkt.hw_type = htons(ARP_HW_ETH);
+    pkt.proto_type = htons(ETH_TYPE_IP);
+    pkt.hw_len = 6;
+    pkt.proto_len = 4;
+    pkt.opcode = htons(op);
+    memcpy(pkt.src_mac, dev->mac, 6);
+    pkt.src_ip = dev->ip;
+    memcpy(pkt.dst_mac, tha, 6);
+    pkt.dst_ip = tpa;
+    eth_send(dev, eth_dst, ETH_TYPE_ARP, &pkt, sizeof(pkt));
+}
 
 void arp_handle_packet(net_device_t* dev, const void* data, size_t len) {
     if (len < sizeof(arp_packet_t)) return;
-    
+
     arp_packet_t* pkt = (arp_packet_t*)data;
+    if (ntohs(pkt->hw_type) != ARP_HW_ETH || ntohs(pkt->proto_type) != ETH_TYPE_IP) return;
+
     uint16_t op = ntohs(pkt->opcode);
     uint32_t src_ip = pkt->src_ip; // Already Network Byte Order
+    int for_us = dev->ip != 0 && pkt->dst_ip == dev->ip;
 
-    /* Update Cache */
-    int slot = -1;
-    for (int i = 0; i < 8; i++) {
-        if (arp_cache[i].valid && arp_cache[i].ip == src_ip) {
-            slot = i; break;
-        }
-        if (!arp_cache[i].valid) slot = i;
-    }
-    
-    /* If cache full, evict round-robin */
-    if (slot == -1) {
-        slot = arp_victim_idx;
-        arp_victim_idx = (arp_victim_idx + 1) % 8;
-    }
+    if (src_ip == 0) return; /* Address probe (RFC 5227), nothing to learn */
 
-    if (slot != -1) {
-        arp_cache[slot].ip = src_ip;
-        memcpy(arp_cache[slot].mac, pkt->src_mac, 6);
-        arp_cache[slot].valid = 1;
+    if (dev->ip != 0 && src_ip == dev->ip && memcmp(pkt->src_mac, dev->mac, 6) != 0) {
+        serial("[ARP] Address conflict: %02x:%02x:%02x:%02x:%02x:%02x claims our IP\n",
+               pkt->src_mac[0], pkt->src_mac[1], pkt->src_mac[2],
+               pkt->src_mac[3], pkt->src_mac[4], pkt->src_mac[5]);
+        return;
     }
 
-    if (op == ARP_OP_REQUEST) {
-        /* Check if it's for us */
-        if (pkt->dst_ip == dev->ip) {
-            serial("[ARP] Request for me from %d.%d.%d.%d\n", 
-                src_ip & 0xFF, (src_ip>>8)&0xFF, (src_ip>>16)&0xFF, (src_ip>>24)&0xFF);
-            
-            arp_packet_t reply;
-            reply.hw_type = htons(ARP_HW_ETH);
-            reply.proto_type = htons(ETH_TYPE_IP);
-            reply.hw_len = 6;
-            reply.proto_len = 4;
-            reply.opcode = htons(ARP_OP_REPLY);
-            
-            memcpy(reply.src_mac, dev->mac, 6);
-            reply.src_ip = dev->ip;
-            memcpy(reply.dst_mac, pkt->src_mac, 6);
-            reply.dst_ip = pkt->src_ip;
-            
-            eth_send(dev, pkt->src_mac, ETH_TYPE_ARP, &reply, sizeof(reply));
+    /* RFC 826 merge: refresh a known sender (this covers gratuitous ARP,
+       where src_ip == dst_ip), create an entry only when we are the target */
+    arp_entry_t* e = arp_find(src_ip);
+    if (e) {
+        if (e->state != ARP_INCOMPLETE && memcmp(e->mac, pkt->src_mac, 6) != 0) {
+            serial("[ARP] %d.%d.%d.%d moved to %02x:%02x:%02x:%02x:%02x:%02x\n",
+                   src_ip & 0xFF, (src_ip>>8)&0xFF, (src_ip>>16)&0xFF, (src_ip>>24)&0xFF,
+                   pkt->src_mac[0], pkt->src_mac[1], pkt->src_mac[2],
+                   pkt->src_mac[3], pkt->src_mac[4], pkt->src_mac[5]);
         }
-    } else if (op == ARP_OP_REPLY) {
-        serial("[ARP] Reply from %d.%d.%d.%d is at %02x:%02x:%02x:%02x:%02x:%02x\n",
-               src_ip & 0xFF, (src_ip>>8)&0xFF, (src_ip>>16)&0xFF, (src_ip>>24)&0xFF,
-               pkt->src_mac[0], pkt->src_mac[1], pkt->src_mac[2],
-               pkt->src_mac[3], pkt->src_mac[4], pkt->src_mac[5]);
+        e->dev = dev;
+        arp_confirm(e, pkt->src_mac);
+    } else if (for_us) {
+        e = arp_alloc(src_ip, dev);
+        if (e) arp_confirm(e, pkt->src_mac);
+    }
+
+    if (op == ARP_OP_REQUEST && for_us) {
+        arp_send(dev, ARP_OP_REPLY, pkt->src_mac, pkt->src_mac, src_ip);
     }
 }
 
 void arp_send_request(net_device_t* dev, uint32_t ip) {
-    arp_packet_t req;
-    req.hw_type = htons(ARP_HW_ETH);
-    req.proto_type = htons(ETH_TYPE_IP);
-    req.hw_len = 6;
-    req.proto_len = 4;
-    req.opcode = htons(ARP_OP_REQUEST);
-    
-    memcpy(req.src_mac, dev->mac, 6);
-    req.src_ip = dev->ip;
-    memset(req.dst_mac, 0xFF, 6); /* Broadcast */
-    req.dst_ip = ip;
-    
-    uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-    eth_send(dev, broadcast, ETH_TYPE_ARP, &req, sizeof(req));
+    static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    static const uint8_t unknown[6] = {0, 0, 0, 0, 0, 0};
+    arp_send(dev, ARP_OP_REQUEST, broadcast, unknown, ip);
+}
+
+void arp_announce(net_device_t* dev) {
+    static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    static const uint8_t unknown[6] = {0, 0, 0, 0, 0, 0};
+    if (!dev || dev->ip == 0) return;
+    arp_send(dev, ARP_OP_REQUEST, broadcast, unknown, dev->ip);
 }
 
 int arp_lookup(uint32_t ip, uint8_t* mac_out) {
-    for (int i = 0; i < 8; i++) {
-        if (arp_cache[i].valid && arp_cache[i].ip == ip) {
-            memcpy(mac_out, arp_cache[i].mac, 6);
-            return 1;
+    arp_entry_t* e = arp_find(ip);
+    if (!e || e->state == ARP_INCOMPLETE) return 0;
+    memcpy(mac_out, e->mac, 6);
+    return 1;
+}
+
+int arp_output(net_device_t* dev, uint32_t next_hop, const void* packet, size_t len) {
+    uint32_t now = net_time_ms();
+    arp_entry_t* e = arp_find(next_hop);
+
+    if (e && e->state != ARP_INCOMPLETE) {
+        e->used = now;
+        /* STALE: keep using the old mapping, re-confirm with a unicast request */
+        if (e->state == ARP_STALE && e->probes == 0) {
+            e->probes = 1;
+            e->next_probe = now + ARP_RETRANS_MS;
+            arp_send(dev, ARP_OP_REQUEST, e->mac, e->mac, next_hop);
         }
+        eth_send(dev, e->mac, ETH_TYPE_IP, packet, len);
+        return 0;
+    }
+
+    if (!e) {
+        e = arp_alloc(next_hop, dev);
+        if (!e) return -ENOMEM;
+        e->state = ARP_INCOMPLETE;
+        e->probes = 1;
+        e->next_probe = now + ARP_RETRANS_MS;
+        arp_send_request(dev, next_hop);
     }
+
+    /* Hold the packet; oldest is dropped when the queue is full */
+    if (e->queue_len >= ARP_QUEUE_LEN) {
+        arp_pending_t* old = e->queue;
+        e->queue = old->next;
+        e->queue_len--;
+        kfree(old);
+    }
+
+    arp_pending_t* p = (arp_pending_t*)kmalloc(sizeof(arp_pending_t) + len);
+    if (!p) return -ENOMEM;
+    p->next = NULL;
+    p->len = len;
+    memcpy(p->data, packet, len);
+
+    arp_pending_t** tail = &e->queue;
+    while (*tail) tail = &(*tail)->next;
+    *tail = p;
+    e->queue_len++;
     return 0;
 }
 
+void arp_timer_poll(void) {
+    uint32_t now = net_time_ms();
+
+    for (int i = 0; i < ARP_MAX_ENTRIES; i++) {
+        arp_entry_t* e = &arp_pool[i];
+
+        switch (e->state) {
+        case ARP_INCOMPLETE:
+            if ((int32_t)(now - e->next_probe) < 0) break;
+            if (e->probes >= ARP_MAX_PROBES) {
+                uint32_t ip = e->ip;
+                serial("[ARP] %d.%d.%d.%d unreachable, dropping %d queued packets\n",
+                       ip & 0xFF, (ip>>8)&0xFF, (ip>>16)&0xFF, (ip>>24)&0xFF, e->queue_len);
+                arp_free(e);
+                break;
+            }
+            e->probes++;
+            e->next_probe = now + ARP_RETRANS_MS;
+            arp_send_request(e->dev, e->ip);
+            break;
+
+        case ARP_REACHABLE:
+            if (now - e->updated >= ARP_REACHABLE_MS) {
+                e->state = ARP_STALE;
+                e->probes = 0;
+            }
+            break;
+
+        case ARP_STALE:
+            if (now - e->used >= ARP_STALE_GC_MS) {
+                arp_free(e);
+            } else if (e->probes && (int32_t)(now - e->next_probe) >= 0) {
+                /* Unicast refresh went unanswered: fall back to broadcast */
+                if (e->probes >= ARP_MAX_PROBES) {
+                    arp_free(e);
+                    break;
+                }
+                e->probes++;
+                e->next_probe = now + ARP_RETRANS_MS;
+                arp_send_request(e->dev, e->ip);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
 void arp_print_cache(void) {
+    static const char* names[] = { "FREE", "INCOMPLETE", "REACHABLE", "STALE" };
+    uint32_t now = net_time_ms();
+
     terminal_writestring("ARP Cache:\n");
-    for (int i = 0; i < 8; i++) {
-        if (arp_cache[i].valid) {
-            uint32_t ip = arp_cache[i].ip;
-            uint8_t* m = arp_cache[i].mac;
-            terminal_printf("  %d.%d.%d.%d  ->  %02x:%02x:%02x:%02x:%02x:%02x\n",
-                ip&0xFF, (ip>>8)&0xFF, (ip>>16)&0xFF, (ip>>24)&0xFF,
-                m[0], m[1], m[2], m[3], m[4], m[5]);
-        }
+    for (int i = 0; i < ARP_MAX_ENTRIES; i++) {
+        arp_entry_t* e = &arp_pool[i];
+        if (e->state == ARP_FREE) continue;
+
+        uint32_t ip = e->ip;
+        uint8_t* m = e->mac;
+        terminal_printf("  %d.%d.%d.%d  ->  %02x:%02x:%02x:%02x:%02x:%02x  %s",
+            ip&0xFF, (ip>>8)&0xFF, (ip>>16)&0xFF, (ip>>24)&0xFF,
+            m[0], m[1], m[2], m[3], m[4], m[5], names[e->state]);
+        if (e->state == ARP_INCOMPLETE)
+            terminal_printf("  (%d queued)\n", e->queue_len);
+        else
+            terminal_printf("  (%u s)\n", (now - e->updated) / 1000);
     }
-}
\ No newline at end of file
+}
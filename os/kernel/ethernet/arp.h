@@ -17,11 +17,37 @@ typedef struct {
     uint32_t dst_ip;
 } __attribute__((packed)) arp_packet_t;
 
+/* Neighbour cache tunables */
+#define ARP_HASH_SIZE      32
+#define ARP_MAX_ENTRIES    64
+#define ARP_QUEUE_LEN      4       /* Packets held per unresolved neighbour */
+#define ARP_RETRANS_MS     1000    /* INCOMPLETE: request retransmit interval */
+#define ARP_MAX_PROBES     3
+#define ARP_REACHABLE_MS   30000   /* REACHABLE -> STALE */
+#define ARP_STALE_GC_MS    300000  /* Unused STALE entries are dropped */
+
+typedef enum {
+    ARP_FREE = 0,
+    ARP_INCOMPLETE,                /* Request sent, packets queued */
+    ARP_REACHABLE,                 /* Confirmed recently */
+    ARP_STALE                      /* Usable, re-confirmed on next use */
+} arp_state_t;
+
 void arp_send_request(net_device_t* dev, uint32_t ip);
 void arp_handle_packet(net_device_t* dev, const void* data, size_t len);
 int arp_lookup(uint32_t ip, uint8_t* mac_out);
 void arp_print_cache(void);
 
+/* Send an IPv4 packet to next_hop, queueing it while the address resolves.
+   0 = sent or queued, -ENOMEM / -EHOSTUNREACH otherwise. */
+int arp_output(net_device_t* dev, uint32_t next_hop, const void* packet, size_t len);
+
+/* Retransmits, aging and garbage collection (called from net_poll) */
+void arp_timer_poll(void);
+
+/* Gratuitous ARP: announce our (new) address to the segment */
+void arp_announce(net_device_t* dev);
+
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
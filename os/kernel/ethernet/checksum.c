@@ -0,0 +1,178 @@
+#include "checksum.h"
+#include "eth.h"
+#include "../hardware/sse.h"
+
+extern void serial(const char *fmt, ...);
+
+typedef uint32_t (*csum_fn_t)(const void* buf, size_t len, uint32_t sum);
+
+static csum_fn_t csum_large = csum_partial_scalar;
+static const char* csum_name = "scalar";
+
+static inline uint32_t fold64(uint64_t acc) {
+    acc = (acc & 0xFFFFFFFFu) + (acc >> 32);
+    acc = (acc & 0xFFFFFFFFu) + (acc >> 32);
+    return (uint32_t)acc;
+}
+
+/* Words/bytes left over after the wide loops (< 64 bytes) */
+static inline uint64_t csum_tail(const uint8_t* p, size_t len, uint64_t acc) {
+    while (len >= 4) {
+        acc += *(const uint32_t*)p;
+        p += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        acc += *(const uint16_t*)p;
+        p += 2;
+        len -= 2;
+    }
+    if (len) acc += *p; /* Little endian: trailing byte is the low half of its word */
+    return acc;
+}
+
+uint32_t csum_partial_scalar(const void* buf, size_t len, uint32_t sum) {
+    const uint8_t* p = (const uint8_t*)buf;
+    uint32_t s = sum;
+
+    /* 64 bytes per iteration, one add-with-carry chain */
+    while (len >= 64) {
+        asm("addl 0(%[p]), %[s]\n\t"
+            "adcl 4(%[p]), %[s]\n\t"
+            "adcl 8(%[p]), %[s]\n\t"
+            "adcl 12(%[p]), %[s]\n\t"
+            "adcl 16(%[p]), %[s]\n\t"
+            "adcl 20(%[p]), %[s]\n\t"
+            "adcl 24(%[p]), %[s]\n\t"
+            "adcl 28(%[p]), %[s]\n\t"
+            "adcl 32(%[p]), %[s]\n\t"
+            "adcl 36(%[p]), %[s]\n\t"
+            "adcl 40(%[p]), %[s]\n\t"
+            "adcl 44(%[p]), %[s]\n\t"
+            "adcl 48(%[p]), %[s]\n\t"
+            "adcl 52(%[p]), %[s]\n\t"
+            "adcl 56(%[p]), %[s]\n\t"
+            "adcl 60(%[p]), %[s]\n\t"
+            "adcl $0, %[s]"
+            : [s] "+r"(s)
+            : [p] "r"(p)
+            : "cc", "memory");
+        p += 64;
+        len -= 64;
+    }
+
+    return fold64(csum_tail(p, len, s));
+}
+
+typedef int   v4si __attribute__((vector_size(16)));
+typedef short v8hi __attribute__((vector_size(16)));
+
+/* 16-bit words are widened into 32-bit lanes. The 32 words of a 64-byte
+   step spread over 8 lanes (a and b), 4 words each, so a 64KB chunk adds
+   at most 4096 * 0xFFFF < 2^28 to a lane, far from overflow. */
+__attribute__((target("sse2")))
+uint32_t csum_partial_sse2(const void* buf, size_t len, uint32_t sum) {
+    const uint8_t* p = (const uint8_t*)buf;
+    const v8hi zero = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    uint64_t acc = sum;
+
+    while (len >= 64) {
+        size_t chunk = len & ~(size_t)63;
+        if (chunk > 65536) chunk = 65536;
+
+        v4si a = { 0, 0, 0, 0 };
+        v4si b = { 0, 0, 0, 0 };
+        for (size_t i = 0; i < chunk; i += 64) {
+            v8hi x0 = (v8hi)__builtin_ia32_loaddqu((const char*)(p + i));
+            v8hi x1 = (v8hi)__builtin_ia32_loaddqu((const char*)(p + i + 16));
+            v8hi x2 = (v8hi)__builtin_ia32_loaddqu((const char*)(p + i + 32));
+            v8hi x3 = (v8hi)__builtin_ia32_loaddqu((const char*)(p + i + 48));
+            a += (v4si)__builtin_ia32_punpcklwd128(x0, zero);
+            b += (v4si)__builtin_ia32_punpckhwd128(x0, zero);
+            a += (v4si)__builtin_ia32_punpcklwd128(x1, zero);
+            b += (v4si)__builtin_ia32_punpckhwd128(x1, zero);
+            a += (v4si)__builtin_ia32_punpcklwd128(x2, zero);
+            b += (v4si)__builtin_ia32_punpckhwd128(x2, zero);
+            a += (v4si)__builtin_ia32_punpcklwd128(x3, zero);
+            b += (v4si)__builtin_ia32_punpckhwd128(x3, zero);
+        }
+        acc += (uint32_t)a[0];
+        acc += (uint32_t)a[1];
+        acc += (uint32_t)a[2];
+        acc += (uint32_t)a[3];
+        acc += (uint32_t)b[0];
+        acc += (uint32_t)b[1];
+        acc += (uint32_t)b[2];
+        acc += (uint32_t)b[3];
+
+        p += chunk;
+        len -= chunk;
+    }
+
+    return fold64(csum_tail(p, len, acc));
+}
+
+uint32_t csum_partial(const void* buf, size_t len, uint32_t sum) {
+    if (len >= CSUM_SSE2_MIN_LEN) return csum_large(buf, len, sum);
+    return csum_partial_scalar(buf, len, sum);
+}
+
+/* Copy and checksum in one pass over the data */
+uint32_t csum_partial_copy(void* dst, const void* src, size_t len, uint32_t sum) {
+    const uint8_t* s = (const uint8_t*)src;
+    uint8_t* d = (uint8_t*)dst;
+    uint64_t acc = sum;
+
+    while (len >= 16) {
+        uint32_t w0 = ((const uint32_t*)s)[0];
+        uint32_t w1 = ((const uint32_t*)s)[1];
+        uint32_t w2 = ((const uint32_t*)s)[2];
+        uint32_t w3 = ((const uint32_t*)s)[3];
+        ((uint32_t*)d)[0] = w0;
+        ((uint32_t*)d)[1] = w1;
+        ((uint32_t*)d)[2] = w2;
+        ((uint32_t*)d)[3] = w3;
+        acc += w0;
+        acc += w1;
+        acc += w2;
+        acc += w3;
+        s += 16;
+        d += 16;
+        len -= 16;
+    }
+    while (len >= 2) {
+        uint16_t w = *(const uint16_t*)s;
+        *(uint16_t*)d = w;
+        acc += w;
+        s += 2;
+        d += 2;
+        len -= 2;
+    }
+    if (len) {
+        *d = *s;
+        acc += *s;
+    }
+    return fold64(acc);
+}
+
+uint32_t csum_tcpudp_nofold(uint32_t saddr, uint32_t daddr, uint16_t len, uint8_t proto, uint32_t sum) {
+    uint64_t acc = sum;
+    acc += saddr;
+    acc += daddr;
+    acc += htons(len);
+    acc += (uint32_t)proto << 8; /* Zero byte then protocol, as a little-endian word */
+    return fold64(acc);
+}
+
+void csum_init(void) {
+    if (cpu_has_sse2()) {
+        sse_enable();
+        csum_large = csum_partial_sse2;
+        csum_name = "sse2";
+    }
+    serial("[NET] Checksum: %s\n", csum_name);
+}
+
+const char* csum_impl_name(void) {
+    return csum_name;
+}
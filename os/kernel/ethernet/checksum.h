@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Internet checksum (RFC 1071).
+ * Partial sums are 32-bit, unfolded, over 16-bit words in memory order, so
+ * a folded result can be stored into a header as-is (no htons needed).
+ * Partial sums are only combinable at even offsets; use csum_block_add()
+ * when appending a block that starts at an odd offset.
+ */
+
+/* Below this size the SSE2 path loses to the unrolled scalar loop */
+#define CSUM_SSE2_MIN_LEN 256
+
+void csum_init(void);                       /* Pick the fastest implementation */
+const char* csum_impl_name(void);
+
+uint32_t csum_partial(const void* buf, size_t len, uint32_t sum);
+uint32_t csum_partial_copy(void* dst, const void* src, size_t len, uint32_t sum);
+
+/* Individual implementations (benchmarking) */
+uint32_t csum_partial_scalar(const void* buf, size_t len, uint32_t sum);
+uint32_t csum_partial_sse2(const void* buf, size_t len, uint32_t sum);
+
+/* Pseudo header for TCP/UDP (addresses network order, len/proto host order) */
+uint32_t csum_tcpudp_nofold(uint32_t saddr, uint32_t daddr, uint16_t len, uint8_t proto, uint32_t sum);
+
+static inline uint16_t csum_fold(uint32_t sum) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+static inline uint32_t csum_add(uint32_t a, uint32_t b) {
+    a += b;
+    return a + (a < b);
+}
+
+/* Append the sum of a block that starts at byte 'offset' of the packet */
+static inline uint32_t csum_block_add(uint32_t sum, uint32_t block, size_t offset) {
+    if (offset & 1) block = (block << 8) | (block >> 24);
+    return csum_add(sum, block);
+}
+
+/* Checksum of a complete buffer (e.g. IPv4 header, ICMP message) */
+static inline uint16_t ip_compute_csum(const void* buf, size_t len) {
+    return csum_fold(csum_partial(buf, len, 0));
+}
+
+/* RFC 1624 incremental update: HC' = ~(~HC + ~m + m'), fields in memory order */
+static inline void csum_replace2(uint16_t* check, uint16_t old_val, uint16_t new_val) {
+    uint32_t sum = (uint16_t)~*check;
+    sum += (uint16_t)~old_val;
+    sum += new_val;
+    *check = csum_fold(sum);
+}
+
+static inline void csum_replace4(uint16_t* check, uint32_t old_val, uint32_t new_val) {
+    csum_replace2(check, (uint16_t)old_val, (uint16_t)new_val);
+    csum_replace2(check, (uint16_t)(old_val >> 16), (uint16_t)(new_val >> 16));
+}
+
+#ifdef __cplusplus
+}
+#endif
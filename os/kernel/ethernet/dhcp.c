@@ -1,5 +1,6 @@
 #include "dhcp.h"
-#include "udp.h"
+#include "socket.h"
+#include "arp.h"
 #include "net_device.h"
 #include "net.h"
 #include "../mm/kmalloc.h"
@@ -8,7 +9,6 @@
 #include "eth.h"
 
 extern void serial(const char *fmt, ...);
-extern uint32_t timer_get_ticks(void);
 
 /* DHCP constants */
 #define DHCP_CLIENT_PORT 68
@@ -84,9 +84,9 @@ typedef struct {
 
 /* -------------------------------------------------- */
 
-static void dhcp_callback(uint32_t src_ip, uint16_t src_port, const uint8_t* data, size_t len);
+static void dhcp_process(uint32_t src_ip, uint16_t src_port, const uint8_t* data, size_t len);
 
-static void send_dhcp_packet(net_device_t* dev, int type, uint32_t req_ip) {
+static void send_dhcp_packet(net_device_t* dev, int fd, int type, uint32_t req_ip) {
     size_t len = sizeof(dhcp_packet_t) + 64; /* Increased buffer for options */
     uint8_t* buf = (uint8_t*)kmalloc(len);
     if (!buf) {
@@ -140,7 +140,12 @@ static void send_dhcp_packet(net_device_t* dev, int type, uint32_t req_ip) {
     *opt++ = OPT_END;
 
     /* Send to Broadcast (255.255.255.255) */
-    udp_send(dev, 0xFFFFFFFF, DHCP_CLIENT_PORT, DHCP_SERVER_PORT, buf, (opt - buf));
+    sockaddr_in_t to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(DHCP_SERVER_PORT);
+    to.sin_addr = 0xFFFFFFFF;
+    sock_sendto(fd, buf, (opt - buf), 0, &to);
     kfree(buf);
 }
 
@@ -156,54 +161,71 @@ int dhcp_discover(void) {
     terminal_writestring("DHCP: Starting negotiation...\n");
 
     /* Generate new XID */
-    dhcp_xid = timer_get_ticks() ^ 0xDEADBEEF;
+    dhcp_xid = net_time_ms() ^ 0xDEADBEEF;
     dhcp_state = 1; /* Start in DISCOVER state */
     offered_ip = 0;
     server_ip = 0;
 
-    udp_set_callback(dhcp_callback);
+    /* Client port 68 socket: replies are demultiplexed to us alone */
+    int fd = sock_socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+
+    sockaddr_in_t local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(DHCP_CLIENT_PORT);
+    if (sock_bind(fd, &local) < 0) {
+        terminal_writestring("DHCP: Client port busy\n");
+        sock_close(fd);
+        return -1;
+    }
+
+    uint8_t* rx = (uint8_t*)kmalloc(1500);
+    if (!rx) {
+        sock_close(fd);
+        return -1;
+    }
     
     int retries = 10; /* More retries */
     int last_state = 0;
-    int safety_counter = 0;
 
     while (retries-- > 0 && dhcp_state != 3) {
         
         /* State Machine Driver */
         if (dhcp_state == 1) {
             /* State 1: Send DISCOVER */
-            send_dhcp_packet(dev, DHCPDISCOVER, 0);
+            send_dhcp_packet(dev, fd, DHCPDISCOVER, 0);
         } 
         else if (dhcp_state == 2) {
             /* State 2: Send REQUEST (Retransmission handled here) */
-            /* Note: dhcp_callback sets state to 2 when OFFER is received */
+            /* Note: dhcp_process sets state to 2 when OFFER is received */
             if (last_state != 2) {
                 serial("[DHCP] Transitioned to State 2 (Requesting)\n");
             }
-            send_dhcp_packet(dev, DHCPREQUEST, offered_ip);
+            send_dhcp_packet(dev, fd, DHCPREQUEST, offered_ip);
         }
 
         last_state = dhcp_state;
 
-        /* Wait loop (approx 1 second) */
-        uint32_t start = timer_get_ticks();
-        safety_counter = 0;
+        /* Sleep on the socket for up to ~1 second per attempt. Milliseconds,
+           not ticks: the PIT rate changes while the GUI paces frames. */
+        uint32_t start = net_time_ms(), elapsed;
         bool state_changed = false;
-        /* terminal_writestring("DHCP: Waiting for offer...\n"); */
 
-        while ((timer_get_ticks() - start) < 100) {
-            net_poll();
-            asm volatile("pause");
+        while ((elapsed = net_time_ms() - start) < 1000) {
+            sock_set_timeout(fd, 1000 - elapsed + 1);
+
+            sockaddr_in_t from;
+            int n = sock_recvfrom(fd, rx, 1500, 0, &from);
+            if (n < 0) break; /* Timeout */
+
+            dhcp_process(from.sin_addr, ntohs(from.sin_port), rx, n);
             
             /* Fast-track: If state changed (e.g. 1->2 or 2->3), break wait immediately */
             if (dhcp_state != last_state) {
                 state_changed = true;
                 break;
             }
-
-            /* Safety break to prevent infinite loop if timer is broken */
-            safety_counter++;
-            if (safety_counter > 10000000) break;
         }
         
         if (dhcp_state == 3) break;
@@ -213,7 +235,8 @@ int dhcp_discover(void) {
         }
     }
 
-    udp_set_callback(NULL);
+    kfree(rx);
+    sock_close(fd);
 
     if (dhcp_state == 3) {
         terminal_writestring("DHCP: Configuration successful!\n");
@@ -226,8 +249,8 @@ int dhcp_discover(void) {
 
 /* -------------------------------------------------- */
 
-static void dhcp_callback(uint32_t src_ip, uint16_t src_port, const uint8_t* data, size_t len) {
-    /* FIX CRITIC: src_port este deja host-order din udp.c */
+static void dhcp_process(uint32_t src_ip, uint16_t src_port, const uint8_t* data, size_t len) {
+    /* src_port is host order (converted by the caller) */
     if (src_port != DHCP_SERVER_PORT)
         return;
 
@@ -310,6 +333,7 @@ static void dhcp_callback(uint32_t src_ip, uint16_t src_port, const uint8_t* dat
                    dev->ip, dev->subnet, dev->gateway, dev->dns_server);
         }
         dhcp_state = 3;
+        if (dev) arp_announce(dev); /* Gratuitous ARP: refresh neighbours' caches */
         terminal_writestring("DHCP: ACK received\n");
         serial("[DHCP] ACK received. IP Configured.\n");
     }
@@ -1,131 +1,638 @@
 #include "dns.h"
 #include "udp.h"
+#include "eth.h"
 #include "net_device.h"
 #include "net.h"
 #include "../mm/kmalloc.h"
 #include "../string.h"
 #include "../terminal.h"
+#include "../sched/wait.h"
+#include "../crypto/prng.h"
+#include "../cmds/fat.h"
+#include <ctype.h>
+#include <errno.h>
 
 extern void serial(const char *fmt, ...);
-extern uint64_t hpet_time_ms(void);
-
-static volatile bool dns_resolved = false;
-static uint32_t dns_result_ip = 0;
-
-static void dns_callback(uint32_t src_ip, uint16_t src_port, const uint8_t* data, size_t len) {
-    (void)src_ip; (void)src_port;
-    if (len < 12) return;
-    
-    /* Skip Header */
-    const uint8_t* p = data + 12;
-    const uint8_t* end = data + len;
-    
-    /* Skip Question Section */
-    while (p < end && *p != 0) {
-        p += (*p) + 1;
-    }
-    p++; /* Skip null byte */
-    p += 4; /* Skip QTYPE, QCLASS */
-    
-    /* Parse Answers */
-    uint16_t ancount = (data[6] << 8) | data[7];
-    
-    for (int i = 0; i < ancount; i++) {
-        if (p >= end) break;
-        
-        /* Skip Name (handle compression) */
-        if ((*p & 0xC0) == 0xC0) {
-            p += 2;
-        } else {
-            while (p < end && *p != 0) p += (*p) + 1;
-            p++;
+
+#define DNS_FALLBACK_SERVER 0x08080808  /* 8.8.8.8 */
+#define DNS_EDNS_PAYLOAD    4096    /* UDP size we advertise; IP reassembles it */
+#define DNS_OPT_RR_LEN      11
+#define DNS_TYPE_OPT        41
+#define DNS_MAX_CNAME_HOPS  8
+#define DNS_HOSTS_FILE_MAX  4096
+
+#define DNS_FLAG_QR 0x80    /* Byte 2 */
+#define DNS_FLAG_TC 0x02    /* Byte 2 */
+#define DNS_RCODE_FORMERR  1
+#define DNS_RCODE_NXDOMAIN 3
+
+enum { DNS_Q_FREE, DNS_Q_PENDING, DNS_Q_DONE };
+
+typedef struct {
+    int state;
+    char name[DNS_NAME_MAX];
+    uint16_t qtype;
+    uint16_t id;
+    uint16_t port;                /* Our source port, host order */
+    uint32_t server;
+    net_device_t* dev;
+    int tries;
+    uint8_t no_edns;              /* Server answered FORMERR to EDNS0 */
+    uint32_t next_tx;
+    int status;                   /* 0 or -errno once DONE */
+    dns_result_t result;
+    wait_queue_t wq;
+} dns_query_t;
+
+typedef struct dns_cache_entry {
+    struct dns_cache_entry* hnext;
+    int in_use;
+    int negative;                 /* NXDOMAIN / NODATA */
+    char name[DNS_NAME_MAX];
+    uint16_t qtype;
+    uint32_t expires;             /* net_time_ms() deadline */
+    uint32_t used;
+    dns_result_t result;
+} dns_cache_entry_t;
+
+typedef struct {
+    char name[DNS_NAME_MAX];
+    uint32_t ip;
+} dns_host_t;
+
+static dns_query_t dns_queries[DNS_MAX_QUERIES];
+
+static dns_cache_entry_t dns_cache[DNS_CACHE_SIZE];
+static dns_cache_entry_t* dns_cache_hash[DNS_CACHE_HASH];
+
+static dns_host_t dns_hosts[DNS_HOSTS_MAX];
+static int dns_host_count = 0;
+static int dns_hosts_loaded = 0;
+
+/* Response parsing runs in softirq context; keep the big buffers off the stack */
+static char scratch_owner[DNS_NAME_MAX];
+static char scratch_target[DNS_NAME_MAX];
+static char scratch_next[DNS_NAME_MAX];
+
+static inline uint16_t rd16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t rd32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint16_t dns_random16(void) {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return (uint16_t)(prng_next() ^ lo ^ (lo >> 16));
+}
+
+/* Lowercase, strip a trailing dot; -EINVAL if empty or too long */
+static int dns_normalize(const char* in, char* out) {
+    size_t n = strlen(in);
+    if (n && in[n - 1] == '.') n--;
+    if (n == 0 || n >= DNS_NAME_MAX) return -EINVAL;
+    for (size_t i = 0; i < n; i++) out[i] = (char)tolower((unsigned char)in[i]);
+    out[n] = 0;
+    return 0;
+}
+
+/* Dotted quad -> network byte order; 0 on success */
+static int dns_parse_ipv4(const char* s, uint32_t* out) {
+    uint32_t ip = 0;
+    for (int part = 0; part < 4; part++) {
+        if (!isdigit((unsigned char)*s)) return -1;
+        uint32_t v = 0;
+        while (isdigit((unsigned char)*s)) {
+            v = v * 10 + (*s++ - '0');
+            if (v > 255) return -1;
         }
-        
-        if (p + 10 > end) break;
-        
-        uint16_t type = (p[0] << 8) | p[1];
-        uint16_t class = (p[2] << 8) | p[3];
-        uint16_t rdlen = (p[8] << 8) | p[9];
-        p += 10;
-        
-        if (type == 1 && class == 1 && rdlen == 4) { /* Type A, Class IN */
-            if (p + 4 <= end) {
-                dns_result_ip = *(uint32_t*)p;
-                dns_resolved = true;
-                return;
-            }
+        ip |= v << (part * 8);
+        if (part < 3 && *s++ != '.') return -1;
+    }
+    if (*s) return -1;
+    *out = ip;
+    return 0;
+}
+
+/* ---- /etc/hosts ---- */
+
+static void dns_hosts_add(const char* name, uint32_t ip) {
+    char lname[DNS_NAME_MAX];
+    if (dns_host_count >= DNS_HOSTS_MAX || dns_normalize(name, lname) < 0) return;
+    strcpy(dns_hosts[dns_host_count].name, lname);
+    dns_hosts[dns_host_count].ip = ip;
+    dns_host_count++;
+}
+
+/* "address name [aliases...]" per line, '#' starts a comment. IPv4 only. */
+static void dns_hosts_parse(char* text) {
+    char* line = text;
+    while (line && *line) {
+        char* nl = strchr(line, '\n');
+        if (nl) *nl = 0;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = 0;
+
+        char* fields[8];
+        int nf = 0;
+        char* p = line;
+        while (*p && nf < 8) {
+            while (*p && isspace((unsigned char)*p)) p++;
+            if (!*p) break;
+            fields[nf++] = p;
+            while (*p && !isspace((unsigned char)*p)) p++;
+            if (*p) *p++ = 0;
         }
-        p += rdlen;
+
+        uint32_t ip;
+        if (nf >= 2 && dns_parse_ipv4(fields[0], &ip) == 0) {
+            for (int i = 1; i < nf; i++) dns_hosts_add(fields[i], ip);
+        }
+        line = nl ? nl + 1 : NULL;
     }
 }
 
-uint32_t dns_resolve(const char* domain) {
-    net_device_t* dev = net_get_primary_device();
-    if (!dev) return 0;
+int dns_hosts_reload(void) {
+    dns_host_count = 0;
+    dns_hosts_loaded = 1;
+    dns_hosts_add("localhost", 0x0100007F);
 
-    terminal_printf("Resolving %s...\n", domain);
+    char* buf = (char*)kmalloc(DNS_HOSTS_FILE_MAX);
+    if (!buf) return -ENOMEM;
 
-    size_t len = 12 + (strlen(domain) + 2) + 4;
-    uint8_t* pkt = (uint8_t*)kmalloc(len);
-    if (!pkt) return 0;
-    memset(pkt, 0, len);
-    
-    /* Header */
-    pkt[1] = 0xAB; /* ID */
+    fat_automount();
+    int n = fat32_read_file(DNS_HOSTS_PATH, buf, DNS_HOSTS_FILE_MAX - 1);
+    if (n >= 0) {
+        buf[n] = 0;
+        dns_hosts_parse(buf);
+        serial("[DNS] %d entries from %s\n", dns_host_count, DNS_HOSTS_PATH);
+    }
+    kfree(buf);
+    return dns_host_count;
+}
+
+static int dns_hosts_lookup(const char* name, uint32_t* ip) {
+    if (!dns_hosts_loaded) dns_hosts_reload();
+    for (int i = 0; i < dns_host_count; i++) {
+        if (strcmp(dns_hosts[i].name, name) == 0) {
+            *ip = dns_hosts[i].ip;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* ---- Cache ---- */
+
+static uint32_t dns_cache_hash_fn(const char* name, uint16_t qtype) {
+    uint32_t h = 2166136261u ^ qtype;
+    while (*name) h = (h ^ (uint8_t)*name++) * 16777619u;
+    return h % DNS_CACHE_HASH;
+}
+
+static void dns_cache_free(dns_cache_entry_t* e) {
+    dns_cache_entry_t** pp = &dns_cache_hash[dns_cache_hash_fn(e->name, e->qtype)];
+    while (*pp) {
+        if (*pp == e) { *pp = e->hnext; break; }
+        pp = &(*pp)->hnext;
+    }
+    memset(e, 0, sizeof(*e));
+}
+
+static dns_cache_entry_t* dns_cache_find(const char* name, uint16_t qtype) {
+    dns_cache_entry_t* e = dns_cache_hash[dns_cache_hash_fn(name, qtype)];
+    while (e && (e->qtype != qtype || strcmp(e->name, name) != 0)) e = e->hnext;
+    if (e && (int32_t)(net_time_ms() - e->expires) >= 0) {
+        dns_cache_free(e);
+        return NULL;
+    }
+    return e;
+}
+
+static void dns_cache_insert(const char* name, uint16_t qtype, int negative,
+                             const dns_result_t* r, uint32_t ttl) {
+    if (ttl == 0) return;
+
+    dns_cache_entry_t* e = dns_cache_find(name, qtype);
+    if (e) dns_cache_free(e);
+
+    /* Free slot, else evict the least recently used entry */
+    dns_cache_entry_t* victim = NULL;
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        e = &dns_cache[i];
+        if (!e->in_use) { victim = e; break; }
+        if (!victim || (int32_t)(e->used - victim->used) < 0) victim = e;
+    }
+    if (victim->in_use) dns_cache_free(victim);
+
+    uint32_t now = net_time_ms();
+    victim->in_use = 1;
+    victim->negative = negative;
+    strcpy(victim->name, name);
+    victim->qtype = qtype;
+    victim->expires = now + ttl * 1000;
+    victim->used = now;
+    victim->result = *r;
+
+    uint32_t h = dns_cache_hash_fn(name, qtype);
+    victim->hnext = dns_cache_hash[h];
+    dns_cache_hash[h] = victim;
+}
+
+void dns_cache_flush(void) {
+    memset(dns_cache, 0, sizeof(dns_cache));
+    memset(dns_cache_hash, 0, sizeof(dns_cache_hash));
+}
+
+/* ---- Wire format ---- */
+
+static int dns_build_query(uint8_t* pkt, uint16_t id, const char* name, uint16_t qtype, int edns) {
+    memset(pkt, 0, 12);
+    pkt[0] = id >> 8;
+    pkt[1] = id & 0xFF;
     pkt[2] = 0x01; /* Recursion Desired */
     pkt[5] = 1;    /* QDCOUNT = 1 */
-    
-    /* Question */
+
     uint8_t* q = pkt + 12;
-    const char* s = domain;
+    const char* s = name;
     while (*s) {
         const char* next = strchr(s, '.');
-        int label_len = next ? (next - s) : strlen(s);
-        *q++ = label_len;
+        size_t label_len = next ? (size_t)(next - s) : strlen(s);
+        if (label_len == 0 || label_len > 63) return -EINVAL;
+        *q++ = (uint8_t)label_len;
         memcpy(q, s, label_len);
         q += label_len;
-        if (next) s = next + 1;
-        else break;
+        if (!next) break;
+        s = next + 1;
     }
     *q++ = 0;
-    
-    *q++ = 0; *q++ = 1; /* QTYPE A */
+
+    *q++ = qtype >> 8; *q++ = qtype & 0xFF;
     *q++ = 0; *q++ = 1; /* QCLASS IN */
-    
-    dns_resolved = false;
-    udp_set_callback(dns_callback);
-    
-    /* Use configured DNS or fallback to Google (8.8.8.8) */
-    uint32_t dns_server = dev->dns_server;
-    if (dns_server == 0) {
-        dns_server = 0x08080808; /* 8.8.8.8 */
-        terminal_writestring("DNS: Using fallback 8.8.8.8\n");
-    }
-    
-    /* Retry loop for ARP */
-    bool sent = false;
-    uint64_t start = hpet_time_ms();
-    while (hpet_time_ms() - start < 2000) {
-        if (udp_send(dev, dns_server, 55555, 53, pkt, q - pkt) == 0) {
-            sent = true;
+    if (!edns) return q - pkt;
+
+    /* EDNS0 OPT pseudo-RR (RFC 6891): answers up to DNS_EDNS_PAYLOAD
+       instead of truncation at 512 bytes */
+    pkt[11] = 1;   /* ARCOUNT = 1 */
+    *q++ = 0;      /* Root owner */
+    *q++ = DNS_TYPE_OPT >> 8; *q++ = DNS_TYPE_OPT & 0xFF;
+    *q++ = DNS_EDNS_PAYLOAD >> 8; *q++ = DNS_EDNS_PAYLOAD & 0xFF;
+    *q++ = 0; *q++ = 0; *q++ = 0; *q++ = 0;     /* Extended RCODE, version, flags */
+    *q++ = 0; *q++ = 0;                         /* RDLENGTH */
+    return q - pkt;
+}
+
+/* Decode a possibly compressed name at off into lowercase dotted form.
+   Returns the offset just past the name at its original position, -1 if malformed. */
+static int dns_read_name(const uint8_t* msg, size_t len, size_t off, char* out) {
+    size_t pos = off;
+    int end = -1;
+    int jumps = 0;
+    size_t o = 0;
+
+    for (;;) {
+        if (pos >= len) return -1;
+        uint8_t l = msg[pos];
+        if ((l & 0xC0) == 0xC0) {
+            if (pos + 1 >= len || ++jumps > 16) return -1;
+            if (end < 0) end = pos + 2;
+            pos = ((size_t)(l & 0x3F) << 8) | msg[pos + 1];
+            continue;
+        }
+        if (l & 0xC0) return -1;
+        if (l == 0) {
+            if (end < 0) end = pos + 1;
             break;
         }
-        net_poll(); /* Process ARP */
-    }
-    kfree(pkt);
-    
-    if (!sent) {
-        terminal_writestring("DNS: Failed to send query (ARP timeout?)\n");
-        udp_set_callback(NULL);
-        return 0;
-    }
-    
-    /* Wait for response */
-    start = hpet_time_ms();
-    while (!dns_resolved && (hpet_time_ms() - start < 3000)) {
-        net_poll();
-    }
-    
-    udp_set_callback(NULL);
-    return dns_resolved ? dns_result_ip : 0;
-}
\ No newline at end of file
+        if (pos + 1 + l > len || o + l + 2 > DNS_NAME_MAX) return -1;
+        if (o) out[o++] = '.';
+        for (int i = 0; i < l; i++) out[o++] = (char)tolower(msg[pos + 1 + i]);
+        pos += 1 + l;
+    }
+    out[o] = 0;
+    return end;
+}
+
+typedef struct {
+    uint16_t type;
+    uint16_t class;
+    uint32_t ttl;
+    size_t rdoff;
+    uint16_t rdlen;
+} dns_rr_t;
+
+/* Parse one resource record at off (owner into scratch_owner); next offset or -1 */
+static int dns_read_rr(const uint8_t* msg, size_t len, size_t off, dns_rr_t* rr) {
+    int p = dns_read_name(msg, len, off, scratch_owner);
+    if (p < 0 || (size_t)p + 10 > len) return -1;
+    rr->type = rd16(msg + p);
+    rr->class = rd16(msg + p + 2);
+    rr->ttl = rd32(msg + p + 4);
+    rr->rdlen = rd16(msg + p + 8);
+    rr->rdoff = p + 10;
+    if (rr->rdoff + rr->rdlen > len) return -1;
+    return rr->rdoff + rr->rdlen;
+}
+
+static uint32_t dns_clamp_ttl(uint32_t ttl, uint32_t max) {
+    if (ttl & 0x80000000u) return 0; /* RFC 2181: treat as zero */
+    return ttl > max ? max : ttl;
+}
+
+/* Negative TTL (RFC 2308): min(SOA TTL, SOA MINIMUM) from the authority section */
+static uint32_t dns_negative_ttl(const uint8_t* msg, size_t len, size_t off, int nscount) {
+    dns_rr_t rr;
+    for (int i = 0; i < nscount; i++) {
+        int next = dns_read_rr(msg, len, off, &rr);
+        if (next < 0) break;
+        if (rr.type == DNS_TYPE_SOA) {
+            int p = dns_read_name(msg, len, rr.rdoff, scratch_next);          /* MNAME */
+            if (p >= 0) p = dns_read_name(msg, len, p, scratch_next);        /* RNAME */
+            if (p >= 0 && (size_t)p + 20 <= rr.rdoff + rr.rdlen) {
+                uint32_t minimum = rd32(msg + p + 16);
+                uint32_t ttl = rr.ttl < minimum ? rr.ttl : minimum;
+                return dns_clamp_ttl(ttl, DNS_NEG_TTL_MAX);
+            }
+        }
+        off = next;
+    }
+    return DNS_NEG_TTL_DEFAULT;
+}
+
+/* Follows the CNAME chain from the question name through the answer
+   section. 1 if a record of qtype was found, 0 if not, -1 if malformed. */
+static int dns_parse_answers(const uint8_t* msg, size_t len, size_t an_off, int ancount,
+                             uint16_t qtype, const char* qname, dns_result_t* r, size_t* end_off) {
+    dns_rr_t rr;
+    uint32_t ttl = DNS_TTL_MAX;
+
+    /* End of the answer section, needed for the authority section */
+    size_t off = an_off;
+    for (int i = 0; i < ancount; i++) {
+        int next = dns_read_rr(msg, len, off, &rr);
+        if (next < 0) return -1;
+        off = next;
+    }
+    *end_off = off;
+
+    strcpy(scratch_target, qname);
+    for (int hop = 0; hop <= DNS_MAX_CNAME_HOPS; hop++) {
+        int aliased = 0;
+        off = an_off;
+        for (int i = 0; i < ancount; i++) {
+            int next = dns_read_rr(msg, len, off, &rr);
+            off = next;
+            if (rr.class != 1 || strcmp(scratch_owner, scratch_target) != 0) continue;
+
+            if (rr.type == qtype) {
+                if (qtype == DNS_TYPE_A && rr.rdlen == 4) {
+                    memcpy(&r->ipv4, msg + rr.rdoff, 4);
+                } else if (qtype == DNS_TYPE_AAAA && rr.rdlen == 16) {
+                    memcpy(r->ipv6, msg + rr.rdoff, 16);
+                } else {
+                    continue;
+                }
+                if (rr.ttl < ttl) ttl = rr.ttl;
+                r->ttl = dns_clamp_ttl(ttl, DNS_TTL_MAX);
+                return 1;
+            }
+            if (rr.type == DNS_TYPE_CNAME && !aliased) {
+                if (dns_read_name(msg, len, rr.rdoff, scratch_next) < 0) return -1;
+                if (rr.ttl < ttl) ttl = rr.ttl;
+                aliased = 1;
+            }
+        }
+        if (!aliased) break;
+        strcpy(scratch_target, scratch_next);
+        strcpy(r->cname, scratch_next);
+    }
+    r->ttl = dns_clamp_ttl(ttl, DNS_TTL_MAX);
+    return 0;
+}
+
+/* ---- Queries ---- */
+
+static void dns_query_finish(dns_query_t* q, int status) {
+    if (q->port) udp_unbind(q->port);
+    q->port = 0;
+    q->status = status;
+    q->state = DNS_Q_DONE;
+    wait_wake(&q->wq);
+}
+
+static int dns_transmit(dns_query_t* q);
+
+static void dns_rx(void* user, uint32_t src_ip, uint16_t src_port, const uint8_t* data, size_t len) {
+    dns_query_t* q = (dns_query_t*)user;
+
+    /* Anything that does not echo our server, ID and question is dropped */
+    if (q->state != DNS_Q_PENDING || src_port != DNS_PORT || src_ip != q->server) return;
+    if (len < 12 || rd16(data) != q->id || !(data[2] & DNS_FLAG_QR)) return;
+    if (rd16(data + 4) != 1) return;
+
+    int off = dns_read_name(data, len, 12, scratch_owner);
+    if (off < 0 || (size_t)off + 4 > len) return;
+    if (strcmp(scratch_owner, q->name) != 0 || rd16(data + off) != q->qtype) return;
+    off += 4;
+
+    int rcode = data[3] & 0x0F;
+    int ancount = rd16(data + 6);
+    int nscount = rd16(data + 8);
+    dns_result_t* r = &q->result;
+
+    if (rcode == DNS_RCODE_NXDOMAIN) {
+        size_t ns_off = off;
+        for (int i = 0; i < ancount; i++) {
+            dns_rr_t rr;
+            int next = dns_read_rr(data, len, ns_off, &rr);
+            if (next < 0) break;
+            ns_off = next;
+        }
+        r->ttl = dns_negative_ttl(data, len, ns_off, nscount);
+        dns_cache_insert(q->name, q->qtype, 1, r, r->ttl);
+        dns_query_finish(q, -ENOENT);
+        return;
+    }
+    if (rcode == DNS_RCODE_FORMERR && !q->no_edns) {
+        /* Pre-EDNS server: ask again in plain RFC 1035 form */
+        q->no_edns = 1;
+        dns_transmit(q);
+        return;
+    }
+    if (rcode != 0) {
+        serial("[DNS] %s: server error %d\n", q->name, rcode);
+        dns_query_finish(q, -EAGAIN);
+        return;
+    }
+
+    size_t ns_off;
+    int found = dns_parse_answers(data, len, off, ancount, q->qtype, q->name, r, &ns_off);
+    if (found < 0) return; /* Malformed: keep waiting for a retransmit */
+
+    if (found) {
+        dns_cache_insert(q->name, q->qtype, 0, r, r->ttl);
+        dns_query_finish(q, 0);
+    } else if (data[2] & DNS_FLAG_TC) {
+        /* Truncated without a usable answer; no TCP fallback */
+        dns_query_finish(q, -EMSGSIZE);
+    } else {
+        /* NODATA: the name exists but has no record of this type */
+        r->ttl = dns_negative_ttl(data, len, ns_off, nscount);
+        dns_cache_insert(q->name, q->qtype, 1, r, r->ttl);
+        dns_query_finish(q, -ENOENT);
+    }
+}
+
+static int dns_transmit(dns_query_t* q) {
+    uint8_t pkt[12 + DNS_NAME_MAX + 1 + 4 + DNS_OPT_RR_LEN];
+    int len = dns_build_query(pkt, q->id, q->name, q->qtype, !q->no_edns);
+    if (len < 0) return len;
+
+    q->next_tx = net_time_ms() + (DNS_RETRANS_MS << q->tries);
+    q->tries++;
+    /* Held by the neighbour cache if the next hop is not resolved yet */
+    return udp_send(q->dev, q->server, q->port, DNS_PORT, pkt, len);
+}
+
+static dns_query_t* dns_handle(int handle) {
+    if (handle < 0 || handle >= DNS_MAX_QUERIES) return NULL;
+    dns_query_t* q = &dns_queries[handle];
+    return q->state == DNS_Q_FREE ? NULL : q;
+}
+
+int dns_query_start(const char* name, uint16_t qtype) {
+    if (!name || (qtype != DNS_TYPE_A && qtype != DNS_TYPE_AAAA)) return -EINVAL;
+
+    int handle = -1;
+    for (int i = 0; i < DNS_MAX_QUERIES; i++) {
+        if (dns_queries[i].state == DNS_Q_FREE) { handle = i; break; }
+    }
+    if (handle < 0) return -EAGAIN;
+
+    dns_query_t* q = &dns_queries[handle];
+    memset(q, 0, sizeof(*q));
+    int err = dns_normalize(name, q->name);
+    if (err < 0) return err;
+    q->qtype = qtype;
+    q->state = DNS_Q_PENDING;
+    q->result.qtype = qtype;
+    wait_queue_init(&q->wq);
+
+    /* Literal addresses and static hosts never touch the network */
+    if (qtype == DNS_TYPE_A &&
+        (dns_parse_ipv4(q->name, &q->result.ipv4) == 0 || dns_hosts_lookup(q->name, &q->result.ipv4))) {
+        dns_query_finish(q, 0);
+        return handle;
+    }
+
+    dns_cache_entry_t* e = dns_cache_find(q->name, qtype);
+    if (e) {
+        e->used = net_time_ms();
+        q->result = e->result;
+        q->result.ttl = (e->expires - e->used) / 1000;
+        dns_query_finish(q, e->negative ? -ENOENT : 0);
+        return handle;
+    }
+
+    net_device_t* dev = net_get_primary_device();
+    if (!dev) {
+        dns_query_finish(q, -ENETUNREACH);
+        return handle;
+    }
+    q->server = dev->dns_server;
+    if (q->server == 0) {
+        q->server = DNS_FALLBACK_SERVER;
+        serial("[DNS] No server configured, using 8.8.8.8\n");
+    }
+    q->dev = net_route_device(q->server);
+
+    q->port = udp_alloc_port();
+    if (!q->port || udp_bind(q->port, dns_rx, q) < 0) {
+        q->port = 0;
+        dns_query_finish(q, -EAGAIN);
+        return handle;
+    }
+    q->id = dns_random16();
+
+    err = dns_transmit(q);
+    if (err < 0) dns_query_finish(q, err);
+    return handle;
+}
+
+int dns_query_result(int handle, dns_result_t* out) {
+    dns_query_t* q = dns_handle(handle);
+    if (!q) return -EBADF;
+    if (q->state == DNS_Q_PENDING) return -EINPROGRESS;
+
+    if (out) *out = q->result;
+    int status = q->status;
+    q->state = DNS_Q_FREE;
+    return status;
+}
+
+void dns_query_cancel(int handle) {
+    dns_query_t* q = dns_handle(handle);
+    if (!q) return;
+    if (q->port) udp_unbind(q->port);
+    q->port = 0;
+    q->state = DNS_Q_FREE;
+}
+
+void dns_timer_poll(void) {
+    uint32_t now = net_time_ms();
+    for (int i = 0; i < DNS_MAX_QUERIES; i++) {
+        dns_query_t* q = &dns_queries[i];
+        if (q->state != DNS_Q_PENDING || (int32_t)(now - q->next_tx) < 0) continue;
+
+        if (q->tries >= DNS_MAX_TRIES) {
+            serial("[DNS] %s: no response after %d tries\n", q->name, q->tries);
+            dns_query_finish(q, -ETIMEDOUT);
+            continue;
+        }
+        int err = dns_transmit(q);
+        if (err < 0) dns_query_finish(q, err);
+    }
+}
+
+int dns_lookup(const char* name, uint16_t qtype, dns_result_t* out) {
+    int handle = dns_query_start(name, qtype);
+    if (handle < 0) return handle;
+
+    dns_query_t* q = &dns_queries[handle];
+    if (q->state == DNS_Q_PENDING) terminal_printf("Resolving %s...\n", q->name);
+    while (q->state == DNS_Q_PENDING) wait_sleep(&q->wq, DNS_RETRANS_MS);
+    return dns_query_result(handle, out);
+}
+
+uint32_t dns_resolve(const char* domain) {
+    dns_result_t r;
+    if (dns_lookup(domain, DNS_TYPE_A, &r) < 0) return 0;
+    return r.ipv4;
+}
+
+void dns_print_cache(void) {
+    uint32_t now = net_time_ms();
+
+    terminal_printf("Hosts (%s): %d entries\n", DNS_HOSTS_PATH, dns_host_count);
+    terminal_writestring("DNS Cache:\n");
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        dns_cache_entry_t* e = &dns_cache[i];
+        if (!e->in_use || (int32_t)(now - e->expires) >= 0) continue;
+
+        terminal_printf("  %s %s  ", e->name, e->qtype == DNS_TYPE_AAAA ? "AAAA" : "A");
+        if (e->negative) {
+            terminal_writestring("(negative)");
+        } else if (e->qtype == DNS_TYPE_A) {
+            uint32_t ip = e->result.ipv4;
+            terminal_printf("%d.%d.%d.%d", ip & 0xFF, (ip>>8)&0xFF, (ip>>16)&0xFF, (ip>>24)&0xFF);
+        } else {
+            const uint8_t* a = e->result.ipv6;
+            for (int w = 0; w < 8; w++)
+                terminal_printf(w ? ":%x" : "%x", (a[w * 2] << 8) | a[w * 2 + 1]);
+        }
+        if (e->result.cname[0]) terminal_printf("  via %s", e->result.cname);
+        terminal_printf("  (%u s)\n", (e->expires - now) / 1000);
+    }
+}
@@ -5,8 +5,58 @@
 extern "C" {
 #endif
 
+/* Stub resolver: /etc/hosts, then a TTL cache (with negative entries),
+ * then the network. Every query gets a random ID and its own ephemeral
+ * port, so several lookups can be in flight at once.
+ */
+
+#define DNS_PORT            53
+#define DNS_NAME_MAX        128     /* Dotted name incl. NUL */
+#define DNS_MAX_QUERIES     8       /* Lookups in flight */
+#define DNS_CACHE_SIZE      64
+#define DNS_CACHE_HASH      32
+#define DNS_HOSTS_MAX       32
+#define DNS_HOSTS_PATH      "/etc/hosts"
+
+#define DNS_RETRANS_MS      1000    /* Doubled on every retry */
+#define DNS_MAX_TRIES       3
+#define DNS_TTL_MAX         86400   /* Seconds, caps what servers hand out */
+#define DNS_NEG_TTL_DEFAULT 60      /* Negative answer without an SOA */
+#define DNS_NEG_TTL_MAX     300
+
+#define DNS_TYPE_A          1
+#define DNS_TYPE_CNAME      5
+#define DNS_TYPE_SOA        6
+#define DNS_TYPE_AAAA       28
+
+typedef struct {
+    uint16_t qtype;
+    uint32_t ipv4;                  /* A, network byte order */
+    uint8_t  ipv6[16];              /* AAAA */
+    char     cname[DNS_NAME_MAX];   /* Canonical name when aliased, else empty */
+    uint32_t ttl;                   /* Seconds left */
+} dns_result_t;
+
+/* Blocking A lookup, 0 on failure */
 uint32_t dns_resolve(const char* domain);
 
+/* Blocking lookup: 0, -ENOENT (NXDOMAIN / no such record), -ETIMEDOUT, ... */
+int dns_lookup(const char* name, uint16_t qtype, dns_result_t* out);
+
+/* Non-blocking: start returns a handle (answered immediately from hosts or
+   cache when possible); result returns -EINPROGRESS until the query is
+   done, then its status, and releases the handle. */
+int  dns_query_start(const char* name, uint16_t qtype);
+int  dns_query_result(int handle, dns_result_t* out);
+void dns_query_cancel(int handle);
+
+/* Retransmits and timeouts, run from net_poll() */
+void dns_timer_poll(void);
+
+int  dns_hosts_reload(void);        /* Entries loaded, or -errno */
+void dns_cache_flush(void);
+void dns_print_cache(void);
+
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
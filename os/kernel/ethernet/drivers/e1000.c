@@ -1,6 +1,7 @@
 #include "e1000.h"
 #include "../net_device.h"
 #include "../eth.h"
+#include "../net.h"
 #include "../../mm/kmalloc.h"
 #include "../../string.h"
 #include "../../mm/vmm.h"
@@ -19,9 +20,6 @@ static uint32_t pci_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset
 
 extern void serial(const char *fmt, ...);
 
-#define E1000_NUM_RX_DESC 32
-#define E1000_NUM_TX_DESC 8
-
 typedef struct {
     uint64_t addr;
     uint16_t length;
@@ -93,27 +91,39 @@ static int e1000_send(net_device_t* dev, const void* data, size_t len) {
     return 0;
 }
 
-static int e1000_poll(net_device_t* dev) {
+static int e1000_rx_poll(net_device_t* dev, int budget) {
     int received = 0;
-    while ((rx_descs[rx_cur].status & 1)) {
+    int last = -1;
+
+    while (received < budget && (rx_descs[rx_cur].status & 1)) {
         uint8_t* buf = rx_buffers[rx_cur];
         uint16_t len = rx_descs[rx_cur].length;
 
         eth_handle_packet(dev, buf, len);
 
         rx_descs[rx_cur].status = 0;
-        e1000_write(E1000_RDT, rx_cur);
+        last = rx_cur;
         rx_cur = (rx_cur + 1) % E1000_NUM_RX_DESC;
         received++;
     }
+
+    /* Return the whole batch to the NIC with a single tail write */
+    if (last >= 0) e1000_write(E1000_RDT, last);
     return received;
 }
 
+static void e1000_rx_irq_enable(net_device_t* dev) {
+    (void)dev;
+    e1000_write(E1000_IMS, E1000_ICR_RX_MASK);
+}
+
 static void e1000_irq_handler(registers_t* r) {
     (void)r;
-    uint32_t status = e1000_read(E1000_ICR);
-    if (status & 0x80) { /* RXDMT0 */
-        e1000_poll(&e1000_dev);
+    uint32_t status = e1000_read(E1000_ICR); /* Read clears the causes */
+    if (status & E1000_ICR_RX_MASK) {
+        /* Mask RX until the softirq has drained the ring */
+        e1000_write(E1000_IMC, E1000_ICR_RX_MASK);
+        net_rx_schedule(&e1000_dev);
     }
 }
 
@@ -157,7 +167,7 @@ pci_found:
     /* Map MMIO */
     vmm_identity_map(mmio_phys, 128 * 1024);
     mmio_base = (uint8_t*)mmio_phys;
-    serial("[E1000] MMIO mapped at %x, IRQ %d\n", mmio_phys, irq);
+    serial("[E1000] MMIO mapped at %x, IRQ %d, RX ring %d\n", mmio_phys, irq, E1000_NUM_RX_DESC);
 
     /* Read MAC */
     uint16_t mac16[3];
@@ -175,7 +185,9 @@ pci_found:
     /* Setup Device Struct */
     strcpy(e1000_dev.name, "e1000");
     e1000_dev.send = e1000_send;
-    e1000_dev.poll = e1000_poll;
+    e1000_dev.poll = NULL;
+    e1000_dev.rx_poll = e1000_rx_poll;
+    e1000_dev.rx_irq_enable = e1000_rx_irq_enable;
     e1000_dev.ip      = 0; /* 0.0.0.0 (Wait for DHCP) */
     e1000_dev.gateway = 0;
     e1000_dev.subnet  = 0;
@@ -210,6 +222,7 @@ pci_found:
 
     /* Enable Interrupts */
     irq_install_handler(irq, e1000_irq_handler);
+    e1000_write(E1000_ITR, E1000_ITR_INTERVAL);
     e1000_write(E1000_IMS, 0x1F6DC);
     e1000_read(E1000_ICR);
 
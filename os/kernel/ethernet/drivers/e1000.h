@@ -5,7 +5,9 @@
 #define E1000_STATUS   0x0008
 #define E1000_EEPROM   0x0014
 #define E1000_ICR      0x00C0
+#define E1000_ITR      0x00C4
 #define E1000_IMS      0x00D0
+#define E1000_IMC      0x00D8
 #define E1000_RCTL     0x0100
 #define E1000_TCTL     0x0400
 #define E1000_RDBAL    0x2800
@@ -20,6 +22,13 @@
 #define E1000_TDT      0x3818
 #define E1000_MTA      0x5200
 
+/* Interrupt cause bits (ICR/IMS/IMC) */
+#define E1000_ICR_LSC    (1 << 2)
+#define E1000_ICR_RXDMT0 (1 << 4)
+#define E1000_ICR_RXO    (1 << 6)
+#define E1000_ICR_RXT0   (1 << 7)
+#define E1000_ICR_RX_MASK (E1000_ICR_RXDMT0 | E1000_ICR_RXO | E1000_ICR_RXT0)
+
 #define RCTL_EN        (1 << 1)
 #define RCTL_SBP       (1 << 2)
 #define RCTL_UPE       (1 << 3)
@@ -30,4 +39,22 @@
 #define TCTL_EN        (1 << 1)
 #define TCTL_PSP       (1 << 3)
 
+/* Ring sizes (override with -DE1000_NUM_RX_DESC=... in CFLAGS).
+   RDLEN/TDLEN must be 128-byte aligned -> multiples of 8 descriptors. */
+#ifndef E1000_NUM_RX_DESC
+#define E1000_NUM_RX_DESC 128
+#endif
+#ifndef E1000_NUM_TX_DESC
+#define E1000_NUM_TX_DESC 8
+#endif
+
+#if (E1000_NUM_RX_DESC % 8) != 0 || (E1000_NUM_TX_DESC % 8) != 0
+#error "E1000 ring sizes must be multiples of 8"
+#endif
+
+/* Interrupt throttling in 256ns units (~8000 IRQ/s), 0 disables */
+#ifndef E1000_ITR_INTERVAL
+#define E1000_ITR_INTERVAL 488
+#endif
+
 int e1000_init(void);
\ No newline at end of file
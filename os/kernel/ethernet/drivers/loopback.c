@@ -0,0 +1,67 @@
+#include "loopback.h"
+#include "../net.h"
+#include "../eth.h"
+#include "../../mm/kmalloc.h"
+#include "../../string.h"
+
+extern void serial(const char *fmt, ...);
+
+typedef struct {
+    void* data;
+    size_t len;
+} lo_frame_t;
+
+static net_device_t lo_dev;
+static lo_frame_t lo_queue[LOOPBACK_QUEUE_LEN];
+static uint32_t lo_head, lo_count;
+
+/* Frames are not handed up from here: that would recurse into the stack
+   (TCP answering itself from inside tcp_xmit). They are queued and the RX
+   softirq delivers them, exactly like a NIC interrupt would. */
+static int lo_send(net_device_t* dev, const void* data, size_t len) {
+    if (lo_count >= LOOPBACK_QUEUE_LEN) return -1;
+
+    void* copy = kmalloc(len);
+    if (!copy) return -1;
+    memcpy(copy, data, len);
+
+    lo_frame_t* f = &lo_queue[(lo_head + lo_count) % LOOPBACK_QUEUE_LEN];
+    f->data = copy;
+    f->len = len;
+    lo_count++;
+
+    net_rx_schedule(dev);
+    return 0;
+}
+
+static int lo_rx_poll(net_device_t* dev, int budget) {
+    int done = 0;
+    while (done < budget && lo_count > 0) {
+        lo_frame_t f = lo_queue[lo_head];
+        lo_head = (lo_head + 1) % LOOPBACK_QUEUE_LEN;
+        lo_count--;
+
+        eth_handle_packet(dev, f.data, f.len);
+        kfree(f.data);
+        done++;
+    }
+    return done;
+}
+
+int loopback_init(void) {
+    memset(&lo_dev, 0, sizeof(lo_dev));
+    strcpy(lo_dev.name, "lo");
+    lo_dev.flags = NETDEV_LOOPBACK;
+    lo_dev.ip = 0x0100007F;      /* 127.0.0.1 */
+    lo_dev.subnet = 0x000000FF;  /* 255.0.0.0 */
+    lo_dev.mtu = LOOPBACK_MTU;
+    lo_dev.send = lo_send;
+    lo_dev.rx_poll = lo_rx_poll;
+
+    net_register_device(&lo_dev);
+    return 0;
+}
+
+net_device_t* loopback_get_device(void) {
+    return lo_dev.send ? &lo_dev : NULL;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "../net_device.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frames buffered between send() and the RX softirq */
+#ifndef LOOPBACK_QUEUE_LEN
+#define LOOPBACK_QUEUE_LEN 256
+#endif
+
+/* No wire to fit: big datagrams keep loopback TCP to few segments */
+#define LOOPBACK_MTU 16384
+
+int loopback_init(void);
+net_device_t* loopback_get_device(void);
+
+#ifdef __cplusplus
+}
+#endif
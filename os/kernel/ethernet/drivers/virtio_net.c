@@ -0,0 +1,379 @@
+#include "virtio_net.h"
+#include "../net_device.h"
+#include "../eth.h"
+#include "../ipv4.h"
+#include "../net.h"
+#include "../checksum.h"
+#include "../../hardware/virtio.h"
+#include "../../mm/kmalloc.h"
+#include "../../mm/vmm.h"
+#include "../../string.h"
+#include "../../terminal.h"
+#include "../../smp/smp.h"
+#include <errno.h>
+
+extern void serial(const char *fmt, ...);
+
+/* One RX/TX queue pair. The stack only ever runs on the boot CPU, so
+   every pair is serviced from the same softirq; 'cpu' records where the
+   pair's interrupt and softirq belong once the APs take work. */
+typedef struct {
+    virtq_t rx;
+    virtq_t tx;
+    uint8_t cpu;
+    uint8_t* tx_free[VIRTIO_NET_TX_BUFS];
+    int tx_nfree;
+    uint32_t rx_frames;
+    uint32_t tx_frames;
+    uint32_t tx_busy;
+} vnet_pair_t;
+
+static virtio_dev_t vdev;
+static net_device_t vnet_dev;
+static vnet_pair_t pairs[VIRTIO_NET_MAX_PAIRS];
+static int npairs;
+static int rx_next;                 /* Pair the next rx_poll() starts at */
+static virtq_t ctrlq;
+static int has_ctrl;
+static uint8_t* ctrl_buf;
+static uint32_t hdr_len;            /* 10 or 12 bytes */
+static int mrg_rxbuf;
+static uint8_t* rx_frame;           /* Linearized multi-buffer frames */
+
+/* Stats */
+static uint32_t rx_merged;
+static uint32_t rx_csum_done;
+static uint32_t rx_errors;
+
+static int rx_post(virtq_t* q, uint8_t* buf) {
+    virtq_sg_t sg = { vmm_virt_to_phys(buf), VIRTIO_NET_BUF_SIZE, 1 };
+    return virtq_add(q, &sg, 1, buf);
+}
+
+/* Finish a checksum the host left partial (VIRTIO_NET_HDR_F_NEEDS_CSUM):
+   the field holds the pseudo header sum, the rest is summed from csum_start
+   to the end of the datagram. Short frames arrive padded to the Ethernet
+   minimum and the padding is not part of the segment. */
+static void rx_complete_csum(const virtio_net_hdr_t* h, uint8_t* frame, uint32_t len) {
+    const eth_header_t* eth = (const eth_header_t*)frame;
+    if (len >= sizeof(eth_header_t) + sizeof(ipv4_header_t) && ntohs(eth->type) == ETH_TYPE_IP) {
+        const ipv4_header_t* ip = (const ipv4_header_t*)(frame + sizeof(eth_header_t));
+        uint32_t end = sizeof(eth_header_t) + ntohs(ip->len);
+        if (end < len) len = end;
+    }
+
+    uint32_t start = h->csum_start, off = h->csum_offset;
+    if (start + off + 2 > len) {
+        rx_errors++;
+        return;
+    }
+    uint16_t* field = (uint16_t*)(frame + start + off);
+    *field = csum_fold(csum_partial(frame + start, len - start, 0));
+    rx_csum_done++;
+}
+
+/* First buffer of a frame: the header, then num_buffers - 1 more buffers
+   that the device has already marked used */
+static void rx_frame_in(vnet_pair_t* p, uint8_t* buf, uint32_t len) {
+    virtio_net_hdr_t h;
+    memcpy(&h, buf, sizeof(h));
+    uint16_t nbufs = mrg_rxbuf ? h.num_buffers : 1;
+
+    if (len < hdr_len || nbufs == 0) {
+        rx_errors++;
+        rx_post(&p->rx, buf);
+        return;
+    }
+
+    uint8_t* frame = buf + hdr_len;
+    uint32_t flen = len - hdr_len;
+    int ok = 1;
+
+    if (nbufs > 1) {
+        memcpy(rx_frame, frame, flen);
+        for (uint16_t i = 1; i < nbufs; i++) {
+            uint32_t l;
+            uint8_t* b = (uint8_t*)virtq_get(&p->rx, &l);
+            if (!b) {
+                ok = 0;
+                break;
+            }
+            if (flen + l <= VIRTIO_NET_FRAME_MAX) memcpy(rx_frame + flen, b, l);
+            else ok = 0;
+            flen += l;
+            rx_post(&p->rx, b);
+        }
+        frame = rx_frame;
+        rx_merged++;
+    }
+
+    if (ok) {
+        if (h.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) rx_complete_csum(&h, frame, flen);
+        p->rx_frames++;
+        eth_handle_packet(&vnet_dev, frame, flen);
+    } else {
+        rx_errors++;
+    }
+    rx_post(&p->rx, buf);
+}
+
+static int vnet_rx_poll(net_device_t* dev, int budget) {
+    (void)dev;
+    int done = 0;
+
+    /* Round robin so one busy queue cannot starve the others */
+    for (int n = 0; n < npairs && done < budget; n++) {
+        vnet_pair_t* p = &pairs[(rx_next + n) % npairs];
+        int got = 0;
+        uint32_t len;
+        uint8_t* buf;
+        while (done < budget && (buf = (uint8_t*)virtq_get(&p->rx, &len))) {
+            rx_frame_in(p, buf, len);
+            done++;
+            got++;
+        }
+        /* Return the whole batch with one notification */
+        if (got) virtq_kick(&p->rx);
+    }
+    rx_next = (rx_next + 1) % npairs;
+    return done;
+}
+
+static void vnet_rx_irq_enable(net_device_t* dev) {
+    int more = 0;
+    for (int i = 0; i < npairs; i++) more |= virtq_enable_irq(&pairs[i].rx);
+
+    /* Frames that slipped in before the re-arm would not raise an IRQ */
+    if (more) {
+        for (int i = 0; i < npairs; i++) virtq_disable_irq(&pairs[i].rx);
+        dev->rx_scheduled = 1;
+    }
+}
+
+static void vnet_irq(virtio_dev_t* d, uint8_t isr) {
+    (void)d;
+    if (isr & VIRTIO_ISR_QUEUE) {
+        /* Mask RX until the softirq has drained the rings */
+        for (int i = 0; i < npairs; i++) virtq_disable_irq(&pairs[i].rx);
+        net_rx_schedule(&vnet_dev);
+    }
+}
+
+/* Keep a flow on one queue: IPv4 addresses and TCP/UDP ports */
+static int tx_pick(const uint8_t* f, size_t len) {
+    if (npairs == 1 || len < 34 || f[12] != 0x08 || f[13] != 0x00) return 0;
+    const uint8_t* ip = f + 14;
+    uint32_t h = ((uint32_t)ip[12] << 24 | ip[13] << 16 | ip[14] << 8 | ip[15]) ^
+                 ((uint32_t)ip[16] << 24 | ip[17] << 16 | ip[18] << 8 | ip[19]);
+    uint32_t ihl = (ip[0] & 0x0F) * 4;
+    if ((ip[9] == 6 || ip[9] == 17) && 14 + ihl + 4 <= len) {
+        const uint8_t* l4 = ip + ihl;
+        h ^= (uint32_t)l4[0] << 24 | l4[1] << 16 | l4[2] << 8 | l4[3];
+    }
+    h ^= h >> 16;
+    h ^= h >> 8;
+    return h % npairs;
+}
+
+static void tx_reclaim(vnet_pair_t* p) {
+    uint8_t* buf;
+    while ((buf = (uint8_t*)virtq_get(&p->tx, 0))) p->tx_free[p->tx_nfree++] = buf;
+}
+
+/* The frame is copied behind the header, so the caller may free it as soon
+   as we return; completions are reclaimed by later sends */
+static int vnet_send(net_device_t* dev, const void* data, size_t len) {
+    (void)dev;
+    if (len > VIRTIO_NET_BUF_SIZE - hdr_len) return -1;
+
+    vnet_pair_t* p = &pairs[tx_pick((const uint8_t*)data, len)];
+    tx_reclaim(p);
+    if (p->tx_nfree == 0) {
+        p->tx_busy++;
+        return -1;
+    }
+
+    uint8_t* buf = p->tx_free[--p->tx_nfree];
+    memset(buf, 0, hdr_len);
+    memcpy(buf + hdr_len, data, len);
+
+    uint32_t phys = vmm_virt_to_phys(buf);
+    virtq_sg_t sg[2];
+    int n;
+    if (virtio_has(&vdev, VIRTIO_F_ANY_LAYOUT) || virtio_has(&vdev, VIRTIO_F_VERSION_1)) {
+        sg[0] = (virtq_sg_t){ phys, hdr_len + len, 0 };
+        n = 1;
+    } else {
+        sg[0] = (virtq_sg_t){ phys, hdr_len, 0 };
+        sg[1] = (virtq_sg_t){ phys + hdr_len, len, 0 };
+        n = 2;
+    }
+    if (virtq_add(&p->tx, sg, n, buf) < 0) {
+        p->tx_free[p->tx_nfree++] = buf;
+        p->tx_busy++;
+        return -1;
+    }
+    virtq_kick(&p->tx);
+    p->tx_frames++;
+    return 0;
+}
+
+/* Synchronous control command, before the stack is up */
+static int vnet_ctrl(uint8_t cls, uint8_t cmd, const void* data, uint32_t len) {
+    if (!has_ctrl || len > 60) return -ENODEV;
+
+    ctrl_buf[0] = cls;
+    ctrl_buf[1] = cmd;
+    memcpy(ctrl_buf + 2, data, len);
+    ctrl_buf[63] = 0xFF;
+
+    uint32_t phys = vmm_virt_to_phys(ctrl_buf);
+    virtq_sg_t sg[3] = {
+        { phys, 2, 0 },
+        { phys + 2, len, 0 },
+        { phys + 63, 1, 1 },
+    };
+    if (virtq_add(&ctrlq, sg, 3, ctrl_buf) < 0) return -EIO;
+    virtq_kick(&ctrlq);
+
+    int spin = 10000000;
+    while (!virtq_get(&ctrlq, 0)) {
+        if (--spin == 0) return -ETIMEDOUT;
+        asm volatile("pause");
+    }
+    return ctrl_buf[63] == VIRTIO_NET_OK ? 0 : -EIO;
+}
+
+static int setup_pair(int i) {
+    vnet_pair_t* p = &pairs[i];
+    int r = virtq_init(&vdev, &p->rx, 2 * i, VIRTQ_SIZE_MAX, 0);
+    if (r == 0) r = virtq_init(&vdev, &p->tx, 2 * i + 1, VIRTQ_SIZE_MAX, 0);
+    if (r < 0) return r;
+
+    for (int k = 0; k < VIRTIO_NET_RX_BUFS && p->rx.num_free; k++) {
+        uint8_t* buf = (uint8_t*)kmalloc(VIRTIO_NET_BUF_SIZE);
+        if (!buf) return -ENOMEM;
+        rx_post(&p->rx, buf);
+    }
+    for (int k = 0; k < VIRTIO_NET_TX_BUFS; k++) {
+        p->tx_free[k] = (uint8_t*)kmalloc(VIRTIO_NET_BUF_SIZE);
+        if (!p->tx_free[k]) return -ENOMEM;
+        p->tx_nfree++;
+    }
+
+    /* TX completions are reaped on the next send, never by interrupt */
+    virtq_disable_irq(&p->tx);
+    p->cpu = cpu_count > 0 ? i % cpu_count : 0;
+    return 0;
+}
+
+int virtio_net_init(void) {
+    if (virtio_pci_find(VIRTIO_ID_NET_LEGACY, VIRTIO_ID_NET_MODERN, 0, &vdev) < 0) return -1;
+
+    /* The stack always emits complete checksums and MSS-sized segments,
+       so the TX offloads (CSUM, HOST_TSO4) would only add header work.
+       Receive offloads are taken: partial checksums are finished here and
+       TSO super-frames arrive through merged buffers. */
+    uint64_t offered = virtio_begin(&vdev);
+    uint64_t want = VIRTIO_FEATURE(VIRTIO_NET_F_MAC) |
+                    VIRTIO_FEATURE(VIRTIO_NET_F_STATUS) |
+                    VIRTIO_FEATURE(VIRTIO_NET_F_MRG_RXBUF) |
+                    VIRTIO_FEATURE(VIRTIO_NET_F_GUEST_CSUM) |
+                    VIRTIO_FEATURE(VIRTIO_NET_F_CTRL_VQ) |
+                    VIRTIO_FEATURE(VIRTIO_NET_F_MQ) |
+                    VIRTIO_FEATURE(VIRTIO_F_ANY_LAYOUT) |
+                    VIRTIO_FEATURE(VIRTIO_F_EVENT_IDX);
+    if ((offered & VIRTIO_FEATURE(VIRTIO_NET_F_MRG_RXBUF)) &&
+        (offered & VIRTIO_FEATURE(VIRTIO_NET_F_GUEST_CSUM)))
+        want |= VIRTIO_FEATURE(VIRTIO_NET_F_GUEST_TSO4);
+    if (!(offered & VIRTIO_FEATURE(VIRTIO_NET_F_CTRL_VQ)))
+        want &= ~VIRTIO_FEATURE(VIRTIO_NET_F_MQ);
+
+    if (virtio_negotiate(&vdev, want) < 0) {
+        serial("[VIRTIO-NET] Feature negotiation failed.\n");
+        return -1;
+    }
+
+    mrg_rxbuf = virtio_has(&vdev, VIRTIO_NET_F_MRG_RXBUF);
+    hdr_len = (mrg_rxbuf || virtio_has(&vdev, VIRTIO_F_VERSION_1))
+            ? sizeof(virtio_net_hdr_t) : VIRTIO_NET_HDR_LEN_LEGACY;
+    has_ctrl = virtio_has(&vdev, VIRTIO_NET_F_CTRL_VQ);
+
+    /* The control queue follows the device's maximum number of pairs */
+    uint16_t max_pairs = 1;
+    if (virtio_has(&vdev, VIRTIO_NET_F_MQ)) {
+        max_pairs = virtio_cfg16(&vdev, VIRTIO_NET_CFG_MAX_PAIRS);
+        if (max_pairs == 0) max_pairs = 1;
+    }
+    npairs = max_pairs < VIRTIO_NET_MAX_PAIRS ? max_pairs : VIRTIO_NET_MAX_PAIRS;
+
+    rx_frame = (uint8_t*)kmalloc(VIRTIO_NET_FRAME_MAX);
+    ctrl_buf = (uint8_t*)kmalloc(64);
+    if (!rx_frame || !ctrl_buf) {
+        virtio_fail(&vdev);
+        return -1;
+    }
+
+    for (int i = 0; i < npairs; i++) {
+        if (setup_pair(i) < 0) {
+            serial("[VIRTIO-NET] Queue pair %d setup failed.\n", i);
+            virtio_fail(&vdev);
+            return -1;
+        }
+    }
+    if (has_ctrl && virtq_init(&vdev, &ctrlq, 2 * max_pairs, 64, 0) < 0) has_ctrl = 0;
+
+    /* MAC */
+    if (virtio_has(&vdev, VIRTIO_NET_F_MAC)) {
+        for (int i = 0; i < 6; i++) vnet_dev.mac[i] = virtio_cfg8(&vdev, VIRTIO_NET_CFG_MAC + i);
+    } else {
+        static const uint8_t fallback[6] = { 0x52, 0x54, 0x00, 0x12, 0x34, 0x57 };
+        memcpy(vnet_dev.mac, fallback, 6);
+    }
+
+    /* Setup Device Struct */
+    strcpy(vnet_dev.name, "virtio-net");
+    vnet_dev.send = vnet_send;
+    vnet_dev.poll = NULL;
+    vnet_dev.rx_poll = vnet_rx_poll;
+    vnet_dev.rx_irq_enable = vnet_rx_irq_enable;
+    vnet_dev.ip      = 0; /* 0.0.0.0 (Wait for DHCP) */
+    vnet_dev.gateway = 0;
+    vnet_dev.subnet  = 0;
+
+    virtio_irq_attach(&vdev, vnet_irq);
+    virtio_driver_ok(&vdev);
+    for (int i = 0; i < npairs; i++) virtq_kick(&pairs[i].rx);
+
+    /* The device starts on one pair; ask for the rest */
+    if (npairs > 1) {
+        uint16_t n = npairs;
+        if (vnet_ctrl(VIRTIO_NET_CTRL_MQ, VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET, &n, 2) < 0) {
+            serial("[VIRTIO-NET] MQ_VQ_PAIRS_SET refused, using one pair.\n");
+            npairs = 1;
+        }
+    }
+
+    net_register_device(&vnet_dev);
+
+    serial("[VIRTIO-NET] %s, %d queue pair(s), features %x:%x, header %d bytes\n",
+           vdev.modern ? "modern" : "legacy", npairs,
+           (uint32_t)(vdev.features >> 32), (uint32_t)vdev.features, hdr_len);
+    return 0;
+}
+
+void virtio_net_print_stats(void) {
+    terminal_printf("virtio-net: %s, %d queue pair(s)%s%s%s\n",
+                    vdev.modern ? "modern" : "legacy", npairs,
+                    mrg_rxbuf ? ", mergeable RX" : "",
+                    virtio_has(&vdev, VIRTIO_NET_F_GUEST_TSO4) ? ", TSO4 in" : "",
+                    virtio_has(&vdev, VIRTIO_F_EVENT_IDX) ? ", event idx" : "");
+    for (int i = 0; i < npairs; i++) {
+        vnet_pair_t* p = &pairs[i];
+        terminal_printf("  pair %d (cpu %d): rx %u, tx %u, tx busy %u, kicks %u (%u suppressed)\n",
+                        i, p->cpu, p->rx_frames, p->tx_frames, p->tx_busy,
+                        p->rx.kicks + p->tx.kicks,
+                        p->rx.kicks_suppressed + p->tx.kicks_suppressed);
+    }
+    terminal_printf("  merged %u, csum completed %u, errors %u\n", rx_merged, rx_csum_done, rx_errors);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Device feature bits */
+#define VIRTIO_NET_F_CSUM        0
+#define VIRTIO_NET_F_GUEST_CSUM  1
+#define VIRTIO_NET_F_MAC         5
+#define VIRTIO_NET_F_GUEST_TSO4  7
+#define VIRTIO_NET_F_HOST_TSO4   11
+#define VIRTIO_NET_F_MRG_RXBUF   15
+#define VIRTIO_NET_F_STATUS      16
+#define VIRTIO_NET_F_CTRL_VQ     17
+#define VIRTIO_NET_F_MQ          22
+
+/* Device configuration */
+#define VIRTIO_NET_CFG_MAC       0
+#define VIRTIO_NET_CFG_STATUS    6
+#define VIRTIO_NET_CFG_MAX_PAIRS 8
+
+/* Per-packet header */
+typedef struct {
+    uint8_t  flags;
+    uint8_t  gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+    uint16_t num_buffers;   /* MRG_RXBUF or VERSION_1 only */
+} __attribute__((packed)) virtio_net_hdr_t;
+
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM 1
+#define VIRTIO_NET_HDR_LEN_LEGACY   10
+
+/* Control queue */
+#define VIRTIO_NET_CTRL_MQ              4
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET 0
+#define VIRTIO_NET_OK                   0
+
+/* Queue pairs used (override with -DVIRTIO_NET_MAX_PAIRS=... in CFLAGS) */
+#ifndef VIRTIO_NET_MAX_PAIRS
+#define VIRTIO_NET_MAX_PAIRS 4
+#endif
+
+/* Buffers per queue. With MRG_RXBUF a large frame spans several RX
+   buffers; without it a buffer must hold a whole frame. */
+#ifndef VIRTIO_NET_RX_BUFS
+#define VIRTIO_NET_RX_BUFS 128
+#endif
+#ifndef VIRTIO_NET_TX_BUFS
+#define VIRTIO_NET_TX_BUFS 32
+#endif
+#define VIRTIO_NET_BUF_SIZE   2048
+#define VIRTIO_NET_FRAME_MAX  (65536 + 14)   /* GUEST_TSO4 super-frame */
+
+int  virtio_net_init(void);
+void virtio_net_print_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
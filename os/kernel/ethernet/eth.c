@@ -1,6 +1,7 @@
 #include "eth.h"
 #include "arp.h"
 #include "ipv4.h"
+#include "netcap.h"
 #include "../mm/kmalloc.h"
 #include "../string.h"
 
@@ -24,12 +25,14 @@ void eth_send(net_device_t* dev, const uint8_t* dst, uint16_t type, const void*
 
     memcpy(frame + sizeof(eth_header_t), data, len);
 
+    netcap_tap(dev, frame, total_len, NETCAP_TX);
     dev->send(dev, frame, total_len);
     kfree(frame);
 }
 
 void eth_handle_packet(net_device_t* dev, const void* data, size_t len) {
     if (len < sizeof(eth_header_t)) return;
+    netcap_tap(dev, data, len, NETCAP_RX);
 
     eth_header_t* hdr = (eth_header_t*)data;
     uint16_t type = ntohs(hdr->type);
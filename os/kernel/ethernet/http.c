@@ -0,0 +1,423 @@
+#include "http.h"
+#include "socket.h"
+#include "dns.h"
+#include "tls.h"
+#include "net.h"
+#include "eth.h"
+#include "../mm/kmalloc.h"
+#include "../string.h"
+#include <ctype.h>
+#include <errno.h>
+
+extern void serial(const char *fmt, ...);
+
+/* Decoder states */
+#define HTTP_D_STATUS       0   /* Status line */
+#define HTTP_D_HEADER       1   /* Header lines */
+#define HTTP_D_BODY         2   /* Content-Length body, or until close */
+#define HTTP_D_CHUNK_SIZE   3   /* Chunk size line */
+#define HTTP_D_CHUNK_DATA   4
+#define HTTP_D_CHUNK_END    5   /* CRLF after chunk data */
+#define HTTP_D_TRAILER      6   /* Trailer lines after the last chunk */
+#define HTTP_D_DONE         7
+
+#define HTTP_UNTIL_CLOSE    0xFFFFFFFFu
+
+/* -------------------------------------------------- */
+/* Helpers */
+
+/* Case-insensitive "name:" match; returns the value with leading blanks
+   skipped, or NULL */
+static const char* header_value(const char* line, const char* name) {
+    while (*name) {
+        if (tolower((unsigned char)*line) != tolower((unsigned char)*name)) return NULL;
+        line++;
+        name++;
+    }
+    if (*line != ':') return NULL;
+    line++;
+    while (*line == ' ' || *line == '\t') line++;
+    return line;
+}
+
+static int has_token(const char* v, const char* token) {
+    uint32_t n = strlen(token);
+    while (*v) {
+        uint32_t i = 0;
+        while (i < n && v[i] && tolower((unsigned char)v[i]) == token[i]) i++;
+        if (i == n && (v[i] == 0 || v[i] == ',' || v[i] == ' ' || v[i] == ';')) return 1;
+        v++;
+    }
+    return 0;
+}
+
+static int parse_u32(const char* s, uint32_t* out) {
+    uint32_t v = 0;
+    if (!isdigit((unsigned char)*s)) return -1;
+    while (isdigit((unsigned char)*s)) {
+        uint32_t d = (uint32_t)(*s - '0');
+        if (v > (0xFFFFFFFFu - d) / 10) return -1;
+        v = v * 10 + d;
+        s++;
+    }
+    *out = v;
+    return 0;
+}
+
+static int hex_val(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = (char)tolower((unsigned char)c);
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/* Dotted quad to network byte order; 0 if s is not one */
+static uint32_t parse_ipv4(const char* s) {
+    uint32_t ip = 0;
+    for (int i = 0; i < 4; i++) {
+        uint32_t v;
+        if (parse_u32(s, &v) != 0 || v > 255) return 0;
+        while (isdigit((unsigned char)*s)) s++;
+        if (*s != (i < 3 ? '.' : 0)) return 0;
+        s++;
+        ip |= v << (i * 8);
+    }
+    return ip;
+}
+
+static void put_u32(char* out, uint32_t v) {
+    char tmp[11];
+    int n = 0;
+    do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+    while (n) *out++ = tmp[--n];
+    *out = 0;
+}
+
+/* -------------------------------------------------- */
+/* Response decoder */
+
+void http_decoder_init(http_decoder_t* d, http_sink_t sink, void* ctx) {
+    memset(d, 0, sizeof(*d));
+    d->sink = sink;
+    d->ctx = ctx;
+}
+
+static int is_success(const http_decoder_t* d) {
+    return d->status >= 200 && d->status < 300;
+}
+
+static int parse_status(http_decoder_t* d) {
+    const char* p = d->line;
+    if (strncmp(p, "HTTP/1.", 7) != 0 || !isdigit((unsigned char)p[7]) || p[8] != ' ') return -EPROTO;
+    p += 9;
+    if (!isdigit((unsigned char)p[0]) || !isdigit((unsigned char)p[1]) || !isdigit((unsigned char)p[2]))
+        return -EPROTO;
+    d->status = (uint16_t)((p[0] - '0') * 100 + (p[1] - '0') * 10 + (p[2] - '0'));
+    d->chunked = 0;
+    d->has_length = 0;
+    d->location[0] = 0;
+    d->state = HTTP_D_HEADER;
+    return 0;
+}
+
+static int parse_header(http_decoder_t* d) {
+    const char* v;
+    if ((v = header_value(d->line, "content-length")) != NULL) {
+        if (parse_u32(v, &d->content_length) != 0) return -EPROTO;
+        d->has_length = 1;
+    } else if ((v = header_value(d->line, "transfer-encoding")) != NULL) {
+        if (has_token(v, "chunked")) d->chunked = 1;
+    } else if ((v = header_value(d->line, "location")) != NULL) {
+        strncpy(d->location, v, HTTP_PATH_MAX - 1);
+        d->location[HTTP_PATH_MAX - 1] = 0;
+    }
+    return 0;
+}
+
+/* Blank line after the headers: pick the body framing */
+static int end_of_headers(http_decoder_t* d) {
+    if (d->status < 200) {                      /* 100 Continue and friends */
+        d->state = HTTP_D_STATUS;
+        return 0;
+    }
+    if (d->status == 204 || d->status == 304) {
+        d->state = HTTP_D_DONE;
+    } else if (d->chunked) {                    /* Takes precedence over Content-Length */
+        d->state = HTTP_D_CHUNK_SIZE;
+    } else if (d->has_length) {
+        d->remaining = d->content_length;
+        d->state = d->remaining ? HTTP_D_BODY : HTTP_D_DONE;
+    } else {
+        d->remaining = HTTP_UNTIL_CLOSE;
+        d->state = HTTP_D_BODY;
+    }
+    return d->state == HTTP_D_DONE ? 1 : 0;
+}
+
+static int parse_chunk_size(http_decoder_t* d) {
+    const char* p = d->line;
+    uint32_t v = 0;
+    if (hex_val(*p) < 0) return -EPROTO;
+    for (int h; (h = hex_val(*p)) >= 0; p++) {
+        if (v > 0x0FFFFFFF) return -EPROTO;
+        v = (v << 4) | (uint32_t)h;
+    }
+    if (*p && *p != ';' && *p != ' ' && *p != '\t') return -EPROTO;   /* Extensions ignored */
+    d->remaining = v;
+    d->state = v ? HTTP_D_CHUNK_DATA : HTTP_D_TRAILER;
+    return 0;
+}
+
+/* A complete line (CRLF stripped) in d->line */
+static int decode_line(http_decoder_t* d) {
+    switch (d->state) {
+        case HTTP_D_STATUS:
+            if (d->line_len == 0) return 0;     /* Tolerate stray CRLF before the status line */
+            return parse_status(d);
+        case HTTP_D_HEADER:
+            return d->line_len ? parse_header(d) : end_of_headers(d);
+        case HTTP_D_CHUNK_SIZE:
+            return parse_chunk_size(d);
+        case HTTP_D_CHUNK_END:
+            if (d->line_len) return -EPROTO;
+            d->state = HTTP_D_CHUNK_SIZE;
+            return 0;
+        case HTTP_D_TRAILER:
+            if (d->line_len) return 0;
+            d->state = HTTP_D_DONE;
+            return 1;
+    }
+    return -EPROTO;
+}
+
+static int deliver(http_decoder_t* d, const uint8_t* data, uint32_t n) {
+    d->received += n;
+    if (!is_success(d) || !d->sink) return 0;
+    return d->sink(d->ctx, data, n);
+}
+
+int http_decoder_feed(http_decoder_t* d, const uint8_t* data, uint32_t len) {
+    uint32_t i = 0;
+    d->wire += len;
+
+    while (i < len) {
+        if (d->state == HTTP_D_DONE) return 1;
+
+        if (d->state == HTTP_D_BODY || d->state == HTTP_D_CHUNK_DATA) {
+            /* Body bytes go straight from the receive buffer to the sink */
+            uint32_t n = len - i;
+            if (n > d->remaining) n = d->remaining;
+            int r = deliver(d, data + i, n);
+            if (r < 0) return r;
+            i += n;
+            if (d->remaining != HTTP_UNTIL_CLOSE) d->remaining -= n;
+            if (d->remaining == 0) {
+                if (d->state == HTTP_D_BODY) {
+                    d->state = HTTP_D_DONE;
+                } else {
+                    d->state = HTTP_D_CHUNK_END;
+                }
+            }
+            continue;
+        }
+
+        char c = (char)data[i++];
+        if (c == '\n') {
+            if (d->line_len && d->line[d->line_len - 1] == '\r') d->line_len--;
+            d->line[d->line_len] = 0;
+            int r = decode_line(d);
+            d->line_len = 0;
+            if (r < 0) return r;
+            continue;
+        }
+        if (d->line_len >= HTTP_LINE_MAX - 1) return -EMSGSIZE;
+        d->line[d->line_len++] = c;
+    }
+    return d->state == HTTP_D_DONE ? 1 : 0;
+}
+
+int http_decoder_finish(http_decoder_t* d) {
+    if (d->state == HTTP_D_DONE) return 1;
+    if (d->state == HTTP_D_BODY && d->remaining == HTTP_UNTIL_CLOSE) {
+        d->state = HTTP_D_DONE;
+        return 1;
+    }
+    return -EPROTO;
+}
+
+/* -------------------------------------------------- */
+/* Client */
+
+int http_parse_url(const char* url, http_url_t* out) {
+    memset(out, 0, sizeof(*out));
+    out->port = 80;
+    if (strncmp(url, "http://", 7) == 0) {
+        url += 7;
+    } else if (strncmp(url, "https://", 8) == 0) {
+        url += 8;
+        out->port = 443;
+        out->tls = 1;
+    }
+
+    const char* end = url;
+    while (*end && *end != '/' && *end != ':') end++;
+    uint32_t host_len = (uint32_t)(end - url);
+    if (host_len == 0 || host_len >= HTTP_HOST_MAX) return -EINVAL;
+    memcpy(out->host, url, host_len);
+    out->host[host_len] = 0;
+
+    if (*end == ':') {
+        uint32_t port;
+        if (parse_u32(end + 1, &port) != 0 || port == 0 || port > 65535) return -EINVAL;
+        out->port = (uint16_t)port;
+        end++;
+        while (isdigit((unsigned char)*end)) end++;
+    }
+
+    if (*end == 0) {
+        strcpy(out->path, "/");
+    } else {
+        if (*end != '/' || strlen(end) >= HTTP_PATH_MAX) return -EINVAL;
+        strcpy(out->path, end);
+    }
+    return 0;
+}
+
+/* Resolve a Location header against the URL it came from */
+static int follow_location(http_url_t* u, const char* loc) {
+    if (strncmp(loc, "http://", 7) == 0 || strncmp(loc, "https://", 8) == 0)
+        return http_parse_url(loc, u);
+
+    if (loc[0] == '/') {
+        if (strlen(loc) >= HTTP_PATH_MAX) return -EINVAL;
+        strcpy(u->path, loc);
+        return 0;
+    }
+
+    /* Relative to the current directory */
+    char* slash = strrchr(u->path, '/');
+    uint32_t base = slash ? (uint32_t)(slash - u->path) + 1 : 0;
+    if (base + strlen(loc) >= HTTP_PATH_MAX) return -EINVAL;
+    strcpy(u->path + base, loc);
+    return 0;
+}
+
+static int xfer_send(int fd, tls_conn_t* tls, const void* buf, size_t len) {
+    return tls ? tls_send(tls, buf, len) : sock_send(fd, buf, len, 0);
+}
+
+static int xfer_recv(int fd, tls_conn_t* tls, void* buf, size_t len) {
+    return tls ? tls_recv(tls, buf, len) : sock_recv(fd, buf, len, 0);
+}
+
+static int build_request(const http_url_t* u, char* req, uint32_t max) {
+    char port[8];
+    uint32_t need = strlen(u->path) + strlen(u->host) + 96;
+    if (need > max) return -EMSGSIZE;
+
+    strcpy(req, "GET ");
+    strcat(req, u->path);
+    strcat(req, " HTTP/1.1\r\nHost: ");
+    strcat(req, u->host);
+    if (u->port != (u->tls ? 443 : 80)) {
+        put_u32(port, u->port);
+        strcat(req, ":");
+        strcat(req, port);
+    }
+    strcat(req, "\r\nUser-Agent: ChrysalisOS/0.1\r\nAccept: */*\r\nConnection: close\r\n\r\n");
+    return (int)strlen(req);
+}
+
+/* One request/response on a fresh connection */
+static int http_fetch(const http_url_t* u, http_decoder_t* d, uint8_t* buf,
+                      http_progress_t progress, void* ctx) {
+    uint32_t ip = parse_ipv4(u->host);
+    if (ip == 0) {
+        dns_result_t res;
+        int r = dns_lookup(u->host, DNS_TYPE_A, &res);
+        if (r < 0) return r;
+        ip = res.ipv4;
+    }
+
+    int fd = sock_socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return fd;
+
+    sockaddr_in_t addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(u->port);
+    addr.sin_addr = ip;
+
+    tls_conn_t* tls = NULL;
+    sock_set_timeout(fd, HTTP_CONNECT_MS);
+    int r = sock_connect(fd, &addr);
+    if (r == 0) {
+        sock_set_timeout(fd, HTTP_IDLE_MS);
+        if (u->tls) {
+            r = tls_connect(&tls, fd, u->host);
+            if (r == 0) serial("[HTTP] %s: %s\n", u->host, tls_conn_info(tls));
+        }
+    }
+
+    if (r == 0) {
+        int n = build_request(u, (char*)buf, HTTP_RECV_CHUNK);
+        r = n < 0 ? n : xfer_send(fd, tls, buf, (size_t)n);
+    }
+
+    while (r >= 0) {
+        int n = xfer_recv(fd, tls, buf, HTTP_RECV_CHUNK);
+        if (n < 0) { r = n; break; }
+        if (n == 0) { r = http_decoder_finish(d); break; }
+        r = http_decoder_feed(d, buf, (uint32_t)n);
+        if (progress) progress(ctx, d);
+        if (r == 1) break;
+    }
+
+    tls_close(tls);
+    sock_close(fd);
+    return r < 0 ? r : (int)d->status;
+}
+
+int http_get(const char* url, http_decoder_t* d, http_progress_t progress, void* ctx) {
+    http_url_t u;
+    int r = http_parse_url(url, &u);
+    if (r < 0) return r;
+
+    uint8_t* buf = (uint8_t*)kmalloc(HTTP_RECV_CHUNK);
+    if (!buf) return -ENOMEM;
+
+    http_sink_t sink = d->sink;
+    void* sink_ctx = d->ctx;
+    for (int hop = 0; ; hop++) {
+        http_decoder_init(d, sink, sink_ctx);
+        r = http_fetch(&u, d, buf, progress, ctx);
+        if (r < 0) break;
+
+        int redirect = (r == 301 || r == 302 || r == 303 || r == 307 || r == 308) && d->location[0];
+        if (!redirect || hop == HTTP_MAX_REDIRECTS) break;
+        serial("[HTTP] %d -> %s\n", r, d->location);
+        r = follow_location(&u, d->location);
+        if (r < 0) break;
+    }
+
+    kfree(buf);
+    return r;
+}
+
+const char* http_strerror(int err) {
+    switch (err) {
+        case -ENOENT:       return "Could not resolve host";
+        case -ECONNREFUSED: return "Connection refused";
+        case -ETIMEDOUT:    return "Timed out";
+        case -ECONNRESET:   return "Connection reset";
+        case -ENETUNREACH:
+        case -EHOSTUNREACH: return "Network unreachable";
+        case -EPROTO:       return "Malformed or truncated response";
+        case -EMSGSIZE:     return "Response header too long";
+        case -EINVAL:       return "Bad URL";
+        case -ENOMEM:       return "Out of memory";
+        case -ENOSPC:       return "Disk full";
+        case -EIO:          return "Disk I/O error";
+    }
+    return "Transfer failed";
+}
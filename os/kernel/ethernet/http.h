@@ -0,0 +1,77 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* HTTP/1.1 client.
+ *
+ * The response decoder is fed whatever the transport returns and hands
+ * body bytes to a sink as they arrive (Content-Length, chunked or
+ * read-until-close), so a download never has to fit in memory. Only
+ * 2xx bodies reach the sink.
+ */
+
+#define HTTP_LINE_MAX       1024   /* Status line or one header line */
+#define HTTP_HOST_MAX       128
+#define HTTP_PATH_MAX       256
+#define HTTP_RECV_CHUNK     (16 * 1024)
+#define HTTP_MAX_REDIRECTS  5
+#define HTTP_CONNECT_MS     5000
+#define HTTP_IDLE_MS        10000  /* TLS handshake and receive timeout */
+
+/* Body sink: 0 to continue, -errno to abort the transfer */
+typedef int (*http_sink_t)(void* ctx, const uint8_t* data, uint32_t len);
+
+typedef struct {
+    uint8_t  state;
+    uint8_t  chunked;
+    uint8_t  has_length;
+    uint16_t status;
+    uint32_t content_length;
+    uint32_t remaining;            /* Bytes left in the body or current chunk */
+    uint32_t received;             /* Body bytes decoded */
+    uint32_t wire;                 /* Bytes fed, headers and framing included */
+    char     location[HTTP_PATH_MAX];
+
+    char     line[HTTP_LINE_MAX];
+    uint32_t line_len;
+
+    http_sink_t sink;
+    void*    ctx;
+} http_decoder_t;
+
+typedef struct {
+    char     host[HTTP_HOST_MAX];
+    char     path[HTTP_PATH_MAX];
+    uint16_t port;
+    uint8_t  tls;
+} http_url_t;
+
+void http_decoder_init(http_decoder_t* d, http_sink_t sink, void* ctx);
+
+/* 0 needs more input, 1 response complete, -EPROTO on malformed framing,
+   -EMSGSIZE for an oversized line, or the sink's error */
+int  http_decoder_feed(http_decoder_t* d, const uint8_t* data, uint32_t len);
+
+/* Connection closed: 1 if the response is complete, else -EPROTO */
+int  http_decoder_finish(http_decoder_t* d);
+
+/* [http://|https://]host[:port][/path]; 0 or -EINVAL */
+int  http_parse_url(const char* url, http_url_t* out);
+
+/* Called after every receive with the decoder state */
+typedef void (*http_progress_t)(void* ctx, const http_decoder_t* d);
+
+/* Blocking GET following up to HTTP_MAX_REDIRECTS redirects. The decoder
+   must be initialised with the sink; it is reset for every hop. Final
+   status code, or -errno (resolve, connect, TLS, transfer). */
+int  http_get(const char* url, http_decoder_t* d, http_progress_t progress, void* ctx);
+
+/* Short description of an http_get() or sink error */
+const char* http_strerror(int err);
+
+#ifdef __cplusplus
+}
+#endif
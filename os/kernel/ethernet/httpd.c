@@ -0,0 +1,765 @@
+#include "httpd.h"
+#include "tcp.h"
+#include "net.h"
+#include "net_device.h"
+#include "../mm/kmalloc.h"
+#include "../string.h"
+#include "../terminal.h"
+#include "../cmds/fat.h"
+#include <ctype.h>
+#include <errno.h>
+
+extern void serial(const char *fmt, ...);
+
+/* Worker states */
+#define HTTPD_W_IDLE  0   /* No connection */
+#define HTTPD_W_READ  1   /* Collecting the next request head */
+#define HTTPD_W_HEAD  2   /* Queuing the response header */
+#define HTTPD_W_BODY  3   /* Queuing file data */
+
+typedef struct {
+    tcp_tcb_t* tcb;
+    uint8_t  state;
+    uint8_t  keep_alive;
+    uint8_t  hdr_built;
+    uint32_t last_active;
+    uint32_t requests;
+
+    /* Input: may hold several pipelined requests */
+    char     req[HTTPD_REQ_MAX + 1];
+    uint32_t req_len;
+    uint32_t head_end;            /* Length of the complete head, 0 = oversized */
+    uint32_t discard;             /* Request body bytes still to skip */
+
+    /* Current response */
+    uint16_t status;
+    uint8_t  head_only;
+    uint8_t  ranged;
+    const char* ctype;
+    char     path[HTTPD_PATH_MAX];    /* FAT path, or Location for 301 */
+    fat_file_t file;
+    uint32_t body_pos, body_end;      /* File byte range still to send */
+
+    char     hdr[HTTPD_HDR_MAX];
+    uint32_t hdr_len, hdr_off;
+} httpd_worker_t;
+
+typedef struct {
+    uint8_t  used;
+    uint32_t last_use;
+    char     path[HTTPD_PATH_MAX];
+    fat_file_t file;
+} httpd_fcache_t;
+
+static struct {
+    uint32_t connections, requests, keepalive_reuse;
+    uint32_t ok, partial, redirects, not_found, client_errors, server_errors;
+    uint32_t timeouts, aborts, fcache_hits, fcache_misses;
+    uint64_t body_bytes;
+} stats;
+
+static tcp_tcb_t* listener = NULL;
+static httpd_worker_t* workers = NULL;
+static int n_workers = 0;
+static uint16_t listen_port = 0;
+static char root_dir[HTTPD_PATH_MAX];
+static httpd_fcache_t fcache[HTTPD_FCACHE];
+static int in_poll = 0;
+
+/* -------------------------------------------------- */
+/* Helpers */
+
+static int str_ieq(const char* a, const char* b) {
+    while (*a && *b) {
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) return 0;
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static int parse_u32(const char* s, const char** end, uint32_t* out) {
+    uint32_t v = 0;
+    const char* p = s;
+    if (!isdigit((unsigned char)*p)) return -1;
+    while (isdigit((unsigned char)*p)) {
+        uint32_t d = (uint32_t)(*p - '0');
+        if (v > (0xFFFFFFFFu - d) / 10) return -1;
+        v = v * 10 + d;
+        p++;
+    }
+    *out = v;
+    if (end) *end = p;
+    return 0;
+}
+
+static int hex_val(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = (char)tolower((unsigned char)c);
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/* Path characters a URL may carry unescaped (RFC 3986 unreserved, and '/') */
+static int path_char_plain(char c) {
+    return isalnum((unsigned char)c) || c == '/' || c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+static uint32_t path_escaped_len(const char* s) {
+    uint32_t n = 0;
+    for (; *s; s++) n += path_char_plain(*s) ? 1 : 3;
+    return n;
+}
+
+static const char* status_text(uint16_t status) {
+    switch (status) {
+        case 200: return "OK";
+        case 206: return "Partial Content";
+        case 301: return "Moved Permanently";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 416: return "Range Not Satisfiable";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 505: return "HTTP Version Not Supported";
+        default:  return "Unknown";
+    }
+}
+
+static const char* content_type(const char* path) {
+    const char* dot = strrchr(path, '.');
+    if (!dot || strchr(dot, '/')) return "application/octet-stream";
+    dot++;
+    if (str_ieq(dot, "htm") || str_ieq(dot, "html")) return "text/html";
+    if (str_ieq(dot, "txt")) return "text/plain";
+    if (str_ieq(dot, "css")) return "text/css";
+    if (str_ieq(dot, "js"))  return "application/javascript";
+    if (str_ieq(dot, "jso") || str_ieq(dot, "json")) return "application/json";
+    if (str_ieq(dot, "png")) return "image/png";
+    if (str_ieq(dot, "jpg") || str_ieq(dot, "jpeg")) return "image/jpeg";
+    if (str_ieq(dot, "gif")) return "image/gif";
+    if (str_ieq(dot, "bmp")) return "image/bmp";
+    if (str_ieq(dot, "ico")) return "image/x-icon";
+    if (str_ieq(dot, "svg")) return "image/svg+xml";
+    return "application/octet-stream";
+}
+
+/* -------------------------------------------------- */
+/* Open-file cache: saves the directory walk on every request. An entry
+   holds only while the volume is unchanged (fat32_generation()), since a
+   rewrite or delete frees the cluster chain it points at. */
+
+static int file_open(const char* path, fat_file_t* f) {
+    uint32_t now = net_time_ms();
+    uint32_t gen = fat32_generation();
+    httpd_fcache_t* victim = &fcache[0];
+
+    for (int i = 0; i < HTTPD_FCACHE; i++) {
+        httpd_fcache_t* e = &fcache[i];
+        if (e->used && e->file.generation != gen) e->used = 0;
+        if (e->used && strcmp(e->path, path) == 0) {
+            memcpy(f, &e->file, sizeof(*f));
+            e->last_use = now;
+            stats.fcache_hits++;
+            return 0;
+        }
+        if (!e->used) victim = e;
+        else if (victim->used && (int32_t)(e->last_use - victim->last_use) < 0) victim = e;
+    }
+
+    stats.fcache_misses++;
+    if (fat32_open(path, f) != 0) return -1;
+
+    victim->used = 1;
+    victim->last_use = now;
+    strncpy(victim->path, path, HTTPD_PATH_MAX - 1);
+    victim->path[HTTPD_PATH_MAX - 1] = 0;
+    memcpy(&victim->file, f, sizeof(*f));
+    return 0;
+}
+
+/* -------------------------------------------------- */
+/* Request parsing */
+
+/* Origin-form (or absolute-form) target to a decoded path. Rejects
+   anything that could climb out of the served root. */
+static int decode_target(const char* t, char* out, uint32_t max) {
+    if (strncmp(t, "http://", 7) == 0) {
+        t = strchr(t + 7, '/');
+        if (!t) t = "/";
+    }
+    if (*t != '/') return -1;
+
+    uint32_t n = 0;
+    while (*t && *t != '?' && *t != '#') {
+        char c = *t++;
+        if (c == '%') {
+            int hi = hex_val(t[0]);
+            int lo = hi < 0 ? -1 : hex_val(t[1]);
+            if (lo < 0) return -1;
+            c = (char)((hi << 4) | lo);
+            t += 2;
+        }
+        if (c == 0 || c == '\\') return -1;
+        if (n + 1 >= max) return -1;
+        out[n++] = c;
+    }
+    out[n] = 0;
+
+    for (const char* p = out; (p = strstr(p, "/..")) != NULL; p += 3) {
+        if (p[3] == 0 || p[3] == '/') return -1;
+    }
+    return 0;
+}
+
+/* "bytes=a-b", "bytes=a-" or "bytes=-n". 1 if a range was selected,
+   0 to serve the whole file, -1 when unsatisfiable. */
+static int parse_range(const char* v, uint32_t size, uint32_t* first, uint32_t* last) {
+    if (strncmp(v, "bytes=", 6) != 0 || strchr(v, ',')) return 0;  /* Multi-range: full body */
+    v += 6;
+
+    uint32_t a, b;
+    const char* p;
+    if (*v == '-') {
+        if (parse_u32(v + 1, &p, &b) != 0 || *p) return 0;
+        if (b == 0 || size == 0) return -1;
+        if (b > size) b = size;
+        *first = size - b;
+        *last = size - 1;
+        return 1;
+    }
+
+    if (parse_u32(v, &p, &a) != 0 || *p != '-') return 0;
+    p++;
+    if (*p == 0) {
+        b = size ? size - 1 : 0;
+    } else {
+        if (parse_u32(p, &p, &b) != 0 || *p || b < a) return 0;
+        if (b >= size) b = size ? size - 1 : 0;
+    }
+    if (a >= size) return -1;
+    *first = a;
+    *last = b;
+    return 1;
+}
+
+static char* find_crlf(char* p, char* lim) {
+    for (; p + 1 < lim; p++) {
+        if (p[0] == '\r' && p[1] == '\n') return p;
+    }
+    return NULL;
+}
+
+static void respond_status(httpd_worker_t* w, uint16_t status) {
+    w->status = status;
+    w->body_pos = w->body_end = 0;
+    if (status == 404) stats.not_found++;
+    else if (status >= 500) stats.server_errors++;
+    else if (status >= 400) stats.client_errors++;
+}
+
+/* Map the decoded URL path to a file and pick the response */
+static void resolve(httpd_worker_t* w, const char* url, const char* range) {
+    uint32_t rlen = strcmp(root_dir, "/") == 0 ? 0 : (uint32_t)strlen(root_dir);
+    uint32_t ulen = (uint32_t)strlen(url);
+    if (rlen + ulen + 10 >= HTTPD_PATH_MAX) {
+        respond_status(w, 404);
+        return;
+    }
+    memcpy(w->path, root_dir, rlen);
+    memcpy(w->path + rlen, url, ulen + 1);
+
+    /* Directory URLs serve their index page */
+    if (url[ulen - 1] == '/') strcat(w->path, "index.htm");
+
+    if (file_open(w->path, &w->file) != 0) {
+        respond_status(w, 404);
+        return;
+    }
+
+    if (w->file.is_dir) {
+        /* Relative links inside need the trailing slash. The Location
+           header carries it escaped, which has to fit the header. */
+        if (path_escaped_len(url) + 1 >= HTTPD_PATH_MAX) {
+            respond_status(w, 404);
+            return;
+        }
+        memcpy(w->path, url, ulen);
+        w->path[ulen] = '/';
+        w->path[ulen + 1] = 0;
+        w->status = 301;
+        w->body_pos = w->body_end = 0;
+        stats.redirects++;
+        return;
+    }
+
+    w->ctype = content_type(w->path);
+    w->status = 200;
+    w->body_pos = 0;
+    w->body_end = w->file.size;
+
+    if (range) {
+        uint32_t first, last;
+        int r = parse_range(range, w->file.size, &first, &last);
+        if (r < 0) {
+            respond_status(w, 416);
+            return;
+        }
+        if (r > 0) {
+            w->status = 206;
+            w->ranged = 1;
+            w->body_pos = first;
+            w->body_end = last + 1;
+        }
+    }
+    if (w->status == 206) stats.partial++;
+    else stats.ok++;
+}
+
+/* Parse the request at the front of req[] and set up the response */
+static void worker_parse(httpd_worker_t* w) {
+    uint32_t end = w->head_end;
+
+    w->status = 0;
+    w->head_only = 0;
+    w->ranged = 0;
+    w->ctype = "text/plain";
+    w->hdr_built = 0;
+    w->hdr_len = w->hdr_off = 0;
+    w->body_pos = w->body_end = 0;
+    w->requests++;
+    stats.requests++;
+    if (w->requests > 1) stats.keepalive_reuse++;
+
+    if (!end) {
+        w->req_len = 0;
+        w->keep_alive = 0;
+        respond_status(w, 431);
+        w->state = HTTPD_W_HEAD;
+        return;
+    }
+
+    char* lim = w->req + end;
+    char* eol = find_crlf(w->req, lim);
+    *eol = 0;
+
+    char* method = w->req;
+    char* target = strchr(method, ' ');
+    char* version = target ? strchr(target + 1, ' ') : NULL;
+    const char* range = NULL;
+    int bad = 0;
+
+    w->keep_alive = 0;
+    if (!target || !version) {
+        bad = 400;
+    } else {
+        *target++ = 0;
+        *version++ = 0;
+        if (strcmp(version, "HTTP/1.1") == 0) w->keep_alive = 1;
+        else if (strcmp(version, "HTTP/1.0") != 0) bad = strncmp(version, "HTTP/", 5) == 0 ? 505 : 400;
+    }
+
+    /* Headers */
+    int ka_seen = 0;
+    for (char* line = eol + 2; !bad && line < lim - 2; ) {
+        char* le = find_crlf(line, lim);
+        if (!le) break;
+        *le = 0;
+
+        char* colon = strchr(line, ':');
+        if (colon) {
+            *colon = 0;
+            char* v = colon + 1;
+            while (*v == ' ' || *v == '\t') v++;
+            char* ve = le;
+            while (ve > v && (ve[-1] == ' ' || ve[-1] == '\t')) *--ve = 0;
+
+            if (str_ieq(line, "Connection")) {
+                if (str_ieq(v, "close")) { w->keep_alive = 0; ka_seen = 1; }
+                else if (str_ieq(v, "keep-alive") && !ka_seen) w->keep_alive = 1;
+            } else if (str_ieq(line, "Range")) {
+                range = v;
+            } else if (str_ieq(line, "Content-Length")) {
+                if (parse_u32(v, NULL, &w->discard) != 0) bad = 400;
+            } else if (str_ieq(line, "Transfer-Encoding")) {
+                /* Can't find the next request after a chunked body */
+                w->keep_alive = 0;
+            }
+        }
+        line = le + 2;
+    }
+
+    if (bad) {
+        w->keep_alive = 0;
+        respond_status(w, (uint16_t)bad);
+    } else if (strcmp(method, "GET") != 0 && strcmp(method, "HEAD") != 0) {
+        w->keep_alive = 0;
+        respond_status(w, 501);
+    } else {
+        char url[HTTPD_PATH_MAX];
+        w->head_only = method[0] == 'H';
+        if (decode_target(target, url, sizeof(url)) != 0) respond_status(w, 400);
+        else resolve(w, url, range);
+    }
+
+    /* Drop the head; pipelined requests behind it move to the front */
+    w->req_len -= end;
+    memmove(w->req, w->req + end, w->req_len);
+    w->state = HTTPD_W_HEAD;
+}
+
+/* -------------------------------------------------- */
+/* Response */
+
+static void hdr_puts(httpd_worker_t* w, const char* s) {
+    while (*s && w->hdr_len < HTTPD_HDR_MAX) w->hdr[w->hdr_len++] = *s++;
+}
+
+static void hdr_putu(httpd_worker_t* w, uint32_t v) {
+    char b[11];
+    int i = 10;
+    b[i] = 0;
+    do {
+        b[--i] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    hdr_puts(w, b + i);
+}
+
+/* A decoded path, escaped again for a header */
+static void hdr_put_path(httpd_worker_t* w, const char* s) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (; *s; s++) {
+        char b[4];
+        if (path_char_plain(*s)) {
+            b[0] = *s;
+            b[1] = 0;
+        } else {
+            b[0] = '%';
+            b[1] = hex[(uint8_t)*s >> 4];
+            b[2] = hex[(uint8_t)*s & 15];
+            b[3] = 0;
+        }
+        hdr_puts(w, b);
+    }
+}
+
+/* tail: where the header will start in the send ring. File bodies are
+   read from disk straight into the ring, and whole sectors can only be
+   DMA'd to 4-byte aligned addresses, so the header is padded (trailing
+   whitespace on the last field, which parsers strip) until sector
+   boundaries of the file land on aligned ring addresses. */
+static void build_header(httpd_worker_t* w, uintptr_t tail) {
+    int has_file = w->status == 200 || w->status == 206;
+    const char* text = status_text(w->status);
+
+    w->hdr_len = 0;
+    hdr_puts(w, "HTTP/1.1 ");
+    hdr_putu(w, w->status);
+    hdr_puts(w, " ");
+    hdr_puts(w, text);
+    hdr_puts(w, "\r\nServer: Chrysalis-httpd\r\n");
+
+    if (has_file) {
+        hdr_puts(w, "Content-Type: ");
+        hdr_puts(w, w->ctype);
+        hdr_puts(w, "\r\nAccept-Ranges: bytes\r\nContent-Length: ");
+        hdr_putu(w, w->body_end - w->body_pos);
+        if (w->ranged) {
+            hdr_puts(w, "\r\nContent-Range: bytes ");
+            hdr_putu(w, w->body_pos);
+            hdr_puts(w, "-");
+            hdr_putu(w, w->body_end - 1);
+            hdr_puts(w, "/");
+            hdr_putu(w, w->file.size);
+        }
+    } else {
+        /* Short text body: "404 Not Found\n" */
+        uint32_t blen = 3 + 1 + (uint32_t)strlen(text) + 1;
+        if (w->status == 301) {
+            hdr_puts(w, "Location: ");
+            hdr_put_path(w, w->path);
+            hdr_puts(w, "\r\n");
+        }
+        if (w->status == 416) {
+            hdr_puts(w, "Content-Range: bytes */");
+            hdr_putu(w, w->file.size);
+            hdr_puts(w, "\r\n");
+        }
+        hdr_puts(w, "Content-Type: text/plain\r\nContent-Length: ");
+        hdr_putu(w, blen);
+    }
+
+    hdr_puts(w, w->keep_alive ? "\r\nConnection: keep-alive" : "\r\nConnection: close");
+
+    if (has_file && !w->head_only) {
+        uint32_t pad = (uint32_t)(w->body_pos - tail - (w->hdr_len + 4)) & 3;
+        while (pad--) hdr_puts(w, " ");
+    }
+    hdr_puts(w, "\r\n\r\n");
+
+    if (!has_file && !w->head_only) {
+        hdr_putu(w, w->status);
+        hdr_puts(w, " ");
+        hdr_puts(w, text);
+        hdr_puts(w, "\n");
+    }
+
+    if (!has_file || w->head_only) w->body_pos = w->body_end;
+    w->hdr_off = 0;
+    w->hdr_built = 1;
+}
+
+/* 1 when the header is queued, 0 while the send ring is full, -1 on error */
+static int worker_send_head(httpd_worker_t* w) {
+    if (!w->hdr_built) {
+        uint8_t* tail;
+        int n = tcp_write_reserve(w->tcb, &tail);
+        if (n == -EAGAIN) return 0;
+        if (n < 0) return -1;
+        build_header(w, (uintptr_t)tail);
+    }
+
+    while (w->hdr_off < w->hdr_len) {
+        int n = tcp_write(w->tcb, w->hdr + w->hdr_off, w->hdr_len - w->hdr_off);
+        if (n == -EAGAIN) return 0;
+        if (n < 0) return -1;
+        w->hdr_off += (uint32_t)n;
+    }
+    w->state = HTTPD_W_BODY;
+    return 1;
+}
+
+/* sendfile: disk -> TCP send ring, no intermediate buffer.
+   1 when the body is queued, 0 to continue next pass, -1 on error. */
+static int worker_send_body(httpd_worker_t* w) {
+    uint32_t budget = HTTPD_POLL_BUDGET;
+
+    while (w->body_pos < w->body_end) {
+        if (budget == 0) return 0;
+
+        uint8_t* dst;
+        int room = tcp_write_reserve(w->tcb, &dst);
+        if (room == -EAGAIN) return 0;
+        if (room < 0) return -1;
+
+        uint32_t n = w->body_end - w->body_pos;
+        if (n > (uint32_t)room) n = (uint32_t)room;
+        if (n > budget) n = budget;
+
+        int r = fat32_read_at(&w->file, dst, n, w->body_pos);
+        if (r <= 0) {
+            serial("[HTTPD] read error at %u in %s\n", w->body_pos, w->path);
+            return -1;
+        }
+        tcp_write_commit(w->tcb, (size_t)r);
+        w->body_pos += (uint32_t)r;
+        stats.body_bytes += (uint32_t)r;
+        budget -= (uint32_t)r;
+    }
+    return 1;
+}
+
+/* -------------------------------------------------- */
+/* Workers */
+
+static void worker_release(httpd_worker_t* w, int abort) {
+    if (abort) {
+        stats.aborts++;
+        tcp_abort(w->tcb);
+    } else {
+        tcp_close(w->tcb);
+    }
+    w->tcb = NULL;
+    w->state = HTTPD_W_IDLE;
+}
+
+static void worker_attach(httpd_worker_t* w, tcp_tcb_t* c) {
+    w->tcb = c;
+    w->state = HTTPD_W_READ;
+    w->keep_alive = 0;
+    w->requests = 0;
+    w->req_len = 0;
+    w->discard = 0;
+    w->last_active = net_time_ms();
+    stats.connections++;
+}
+
+/* 1 once a complete request head is buffered (head_end set), 0 while
+   waiting for more input, -1 if the peer closed or the connection failed */
+static int worker_read(httpd_worker_t* w) {
+    for (;;) {
+        /* Skip the body of the previous request */
+        if (w->discard && w->req_len) {
+            uint32_t n = w->discard < w->req_len ? w->discard : w->req_len;
+            w->req_len -= n;
+            memmove(w->req, w->req + n, w->req_len);
+            w->discard -= n;
+        }
+
+        if (!w->discard && w->req_len >= 4) {
+            w->req[w->req_len] = 0;
+            char* e = strstr(w->req, "\r\n\r\n");
+            if (e) {
+                w->head_end = (uint32_t)(e - w->req) + 4;
+                return 1;
+            }
+        }
+        if (w->req_len >= HTTPD_REQ_MAX) {
+            w->head_end = 0;
+            return 1;
+        }
+
+        int n = tcp_read(w->tcb, w->req + w->req_len, HTTPD_REQ_MAX - w->req_len);
+        if (n == -EAGAIN) return 0;
+        if (n <= 0) return -1;
+        w->req_len += (uint32_t)n;
+        w->last_active = net_time_ms();
+    }
+}
+
+static void worker_poll(httpd_worker_t* w, uint32_t now) {
+    tcp_tcb_t* t = w->tcb;
+    if (t->error || t->state == TCP_CLOSED) {
+        worker_release(w, 0);
+        return;
+    }
+
+    for (int round = 0; round < HTTPD_PIPELINE_BURST; round++) {
+        if (w->state == HTTPD_W_READ) {
+            int r = worker_read(w);
+            if (r < 0) {
+                worker_release(w, 0);
+                return;
+            }
+            if (r == 0) {
+                if (now - w->last_active > HTTPD_KEEPALIVE_MS) {
+                    stats.timeouts++;
+                    worker_release(w, 0);
+                }
+                return;
+            }
+            worker_parse(w);
+        }
+
+        if (w->state == HTTPD_W_HEAD) {
+            int r = worker_send_head(w);
+            if (r < 0) { worker_release(w, 1); return; }
+            if (r == 0) return;
+        }
+
+        if (w->state == HTTPD_W_BODY) {
+            int r = worker_send_body(w);
+            if (r < 0) { worker_release(w, 1); return; }
+            if (r == 0) return;
+        }
+
+        /* Response fully queued; TCP drains it in order behind the next one */
+        w->last_active = now;
+        if (!w->keep_alive) {
+            worker_release(w, 0);
+            return;
+        }
+        w->state = HTTPD_W_READ;
+    }
+}
+
+/* -------------------------------------------------- */
+/* Service */
+
+int httpd_start(uint16_t port, const char* root, int workers_wanted) {
+    if (listener) return -EALREADY;
+
+    fat_automount();
+    if (!root || !*root) root = "/";
+    fat_file_t probe;
+    if (fat32_open(root, &probe) != 0 || !probe.is_dir) return -ENODEV;
+
+    if (port == 0) port = HTTPD_PORT_DEFAULT;
+    if (workers_wanted <= 0) workers_wanted = HTTPD_WORKERS_DEFAULT;
+    if (workers_wanted > HTTPD_MAX_WORKERS) workers_wanted = HTTPD_MAX_WORKERS;
+
+    /* Listeners accept on every interface; the device only seeds local_ip */
+    net_device_t* dev = net_get_primary_device();
+    if (!dev) dev = net_route_device(0x0100007F);
+    if (!dev) return -ENETUNREACH;
+
+    workers = (httpd_worker_t*)kmalloc(sizeof(httpd_worker_t) * workers_wanted);
+    if (!workers) return -ENOMEM;
+    memset(workers, 0, sizeof(httpd_worker_t) * workers_wanted);
+
+    listener = tcp_listen(dev, port, HTTPD_BACKLOG);
+    if (!listener) {
+        kfree(workers);
+        workers = NULL;
+        return -EADDRINUSE;
+    }
+
+    n_workers = workers_wanted;
+    listen_port = port;
+    strncpy(root_dir, root, HTTPD_PATH_MAX - 1);
+    root_dir[HTTPD_PATH_MAX - 1] = 0;
+    uint32_t rl = (uint32_t)strlen(root_dir);
+    if (rl > 1 && root_dir[rl - 1] == '/') root_dir[rl - 1] = 0;
+
+    memset(fcache, 0, sizeof(fcache));
+    memset(&stats, 0, sizeof(stats));
+    serial("[HTTPD] Listening on port %d, root %s, %d workers\n", port, root_dir, n_workers);
+    return 0;
+}
+
+void httpd_stop(void) {
+    if (!listener) return;
+    for (int i = 0; i < n_workers; i++) {
+        if (workers[i].tcb) worker_release(&workers[i], 0);
+    }
+    tcp_close(listener);
+    listener = NULL;
+    kfree(workers);
+    workers = NULL;
+    n_workers = 0;
+    serial("[HTTPD] Stopped\n");
+}
+
+int httpd_running(void) {
+    return listener ? listen_port : 0;
+}
+
+void httpd_poll(void) {
+    if (!listener || in_poll) return;
+    in_poll = 1;
+
+    uint32_t now = net_time_ms();
+    for (int i = 0; i < n_workers; i++) {
+        httpd_worker_t* w = &workers[i];
+        if (!w->tcb) {
+            tcp_tcb_t* c = tcp_accept(listener);
+            if (!c) continue;
+            worker_attach(w, c);
+        }
+        worker_poll(w, now);
+    }
+
+    in_poll = 0;
+}
+
+void httpd_print_stats(void) {
+    if (!listener) {
+        terminal_writestring("httpd: not running\n");
+        return;
+    }
+
+    int busy = 0;
+    for (int i = 0; i < n_workers; i++) if (workers[i].tcb) busy++;
+
+    terminal_printf("httpd: port %d, root %s, %d/%d workers busy\n", listen_port, root_dir, busy, n_workers);
+    terminal_printf("  connections %u, requests %u (%u on kept-alive connections)\n",
+                    stats.connections, stats.requests, stats.keepalive_reuse);
+    terminal_printf("  200: %u  206: %u  301: %u  404: %u  other 4xx: %u  5xx: %u\n",
+                    stats.ok, stats.partial, stats.redirects, stats.not_found,
+                    stats.client_errors, stats.server_errors);
+    terminal_printf("  body %u KB, idle timeouts %u, aborts %u, file cache %u hit / %u miss\n",
+                    (uint32_t)(stats.body_bytes / 1024), stats.timeouts, stats.aborts,
+                    stats.fcache_hits, stats.fcache_misses);
+}
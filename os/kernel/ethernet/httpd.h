@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* In-kernel HTTP/1.1 static file server for the mounted FAT32 volume.
+ *
+ * Runs from net_poll() like the protocol timers: a fixed set of workers,
+ * each owning one connection, is serviced round-robin on every pass.
+ * Connections beyond the worker count wait in the listen backlog.
+ * GET and HEAD only; keep-alive, pipelining and single byte ranges.
+ * File data is read from disk straight into the TCP send ring.
+ */
+
+#define HTTPD_PORT_DEFAULT     80
+#define HTTPD_WORKERS_DEFAULT  4
+#define HTTPD_MAX_WORKERS      16
+#define HTTPD_BACKLOG          32
+#define HTTPD_REQ_MAX          2048    /* Request line + headers */
+#define HTTPD_HDR_MAX          512     /* Response header (+ error body) */
+#define HTTPD_PATH_MAX         256
+#define HTTPD_KEEPALIVE_MS     15000   /* Idle connection timeout */
+#define HTTPD_POLL_BUDGET      (32 * 1024)  /* Body bytes per worker per pass */
+#define HTTPD_PIPELINE_BURST   8       /* Pipelined responses per worker per pass */
+#define HTTPD_FCACHE           16      /* Open-file cache entries */
+
+/* root is the FAT directory served as "/" (NULL or "/" for the volume
+   root). 0, or -errno: -EALREADY if running, -ENODEV without a FAT
+   volume, -EADDRINUSE if the port is taken. */
+int  httpd_start(uint16_t port, const char* root, int workers);
+void httpd_stop(void);
+int  httpd_running(void);                 /* Listening port, 0 when stopped */
+
+/* Accept and service connections (called from net_poll) */
+void httpd_poll(void);
+
+void httpd_print_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
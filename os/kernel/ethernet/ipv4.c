@@ -2,106 +2,402 @@
 #include "arp.h"
 #include "udp.h"
 #include "tcp.h"
+#include "net.h"
+#include "checksum.h"
 #include "../mm/kmalloc.h"
 #include "../string.h"
+#include "../terminal.h"
+#include "../crypto/prng.h"
+#include <errno.h>
 
 extern void serial(const char *fmt, ...);
 
+#define ICMP_DEST_UNREACH   3
+#define ICMP_FRAG_NEEDED    4   /* Code under ICMP_DEST_UNREACH */
+
 static icmp_callback_t icmp_cb = 0;
 
+/* Path MTU cache: only destinations whose path is below the device MTU */
+typedef struct {
+    uint32_t dst;
+    uint32_t mtu;
+    uint32_t expires;
+} pmtu_entry_t;
+
+static pmtu_entry_t pmtu_cache[IP_PMTU_CACHE];
+
+/* Reassembly queue, one entry per (src, dst, id, proto) */
+typedef struct {
+    int      used;
+    uint32_t src, dst;
+    uint16_t id;
+    uint8_t  proto;
+    uint8_t* buf;           /* Payload being rebuilt */
+    uint32_t cap;
+    uint32_t total;         /* Payload length once the last fragment is in, else 0 */
+    uint32_t received;
+    uint32_t deadline;
+    uint8_t  have[(IP_MAX_DATAGRAM + 1) / 8 / 8];   /* One bit per 8-byte block */
+} ip_reasm_t;
+
+static ip_reasm_t reasm[IP_REASM_MAX];
+static uint32_t reasm_mem;
+
+static uint16_t ip_ids[IP_ID_BUCKETS];
+static int ip_ids_seeded;
+
+static struct {
+    uint32_t frags_out, frag_fails;
+    uint32_t frags_in, reasm_ok, reasm_fails, reasm_timeouts;
+    uint32_t pmtu_updates;
+} ip_stats;
+
 void ipv4_set_icmp_callback(icmp_callback_t callback) {
     icmp_cb = callback;
 }
 
-static uint16_t ip_checksum(void* vdata, size_t length) {
-    char* data = (char*)vdata;
-    uint32_t acc = 0;
-    for (size_t i = 0; i + 1 < length; i += 2) {
-        uint16_t word;
-        memcpy(&word, data + i, 2);
-        acc += ntohs(word);
+/* -------------------------------------------------- */
+/* Path MTU */
+
+uint32_t ipv4_path_mtu(net_device_t* dev, uint32_t dst_ip) {
+    uint32_t mtu = dev && dev->mtu ? dev->mtu : NETDEV_MTU_DEFAULT;
+    uint32_t now = net_time_ms();
+    for (int i = 0; i < IP_PMTU_CACHE; i++) {
+        pmtu_entry_t* e = &pmtu_cache[i];
+        if (!e->mtu || e->dst != dst_ip) continue;
+        if ((int32_t)(now - e->expires) >= 0) {
+            e->mtu = 0;
+            break;
+        }
+        if (e->mtu < mtu) mtu = e->mtu;
+        break;
+    }
+    return mtu;
+}
+
+static void pmtu_update(uint32_t dst_ip, uint32_t mtu) {
+    uint32_t now = net_time_ms();
+    pmtu_entry_t* slot = NULL;
+    for (int i = 0; i < IP_PMTU_CACHE; i++) {
+        pmtu_entry_t* e = &pmtu_cache[i];
+        if (e->mtu && e->dst == dst_ip) { slot = e; break; }
+        if (!slot || (slot->mtu && (!e->mtu || (int32_t)(e->expires - slot->expires) < 0))) slot = e;
+    }
+    if (slot->mtu && slot->dst == dst_ip && slot->mtu <= mtu) return;
+
+    slot->dst = dst_ip;
+    slot->mtu = mtu;
+    slot->expires = now + IP_PMTU_EXPIRE_MS;
+    ip_stats.pmtu_updates++;
+    serial("[IP] PMTU to %d.%d.%d.%d is now %u\n",
+           dst_ip & 0xFF, (dst_ip>>8)&0xFF, (dst_ip>>16)&0xFF, (dst_ip>>24)&0xFF, mtu);
+
+    tcp_pmtu_changed(dst_ip, mtu);
+}
+
+/* RFC 1191 plateaus, for routers that report a next-hop MTU of 0 */
+static uint32_t pmtu_plateau(uint32_t len) {
+    static const uint16_t plateaus[] = { 32000, 17914, 8166, 4352, 2002, 1492, 1006, 508, 296, 68 };
+    for (unsigned i = 0; i < sizeof(plateaus) / sizeof(plateaus[0]); i++)
+        if (plateaus[i] < len) return plateaus[i];
+    return 68;
+}
+
+static void icmp_frag_needed(net_device_t* dev, const uint8_t* icmp, size_t len) {
+    if (len < 8 + sizeof(ipv4_header_t)) return;
+    const ipv4_header_t* inner = (const ipv4_header_t*)(icmp + 8);
+    if (inner->version != 4 || inner->src != dev->ip) return;
+    if (!(ntohs(inner->frag_offset) & IP_FLAG_DF)) return;   /* Not ours to act on */
+
+    uint32_t mtu = ((uint32_t)icmp[6] << 8) | icmp[7];
+    uint32_t sent = ntohs(inner->len);
+    if (mtu == 0 || mtu >= sent) mtu = pmtu_plateau(sent);
+    if (mtu < IP_MIN_PMTU) mtu = IP_MIN_PMTU;
+    pmtu_update(inner->dst, mtu);
+}
+
+/* -------------------------------------------------- */
+/* Input */
+
+static void ipv4_deliver(net_device_t* dev, uint32_t src, uint32_t dst, uint8_t proto,
+                         const uint8_t* payload, size_t payload_len) {
+    if (proto == IP_PROTO_UDP) {
+        udp_handle_packet(dev, src, dst, payload, payload_len);
+    } else if (proto == IP_PROTO_TCP) {
+        tcp_handle_packet(dev, src, payload, payload_len);
+    } else if (proto == IP_PROTO_ICMP) {
+        if (payload_len >= 8 && payload[0] == ICMP_DEST_UNREACH && payload[1] == ICMP_FRAG_NEEDED)
+            icmp_frag_needed(dev, payload, payload_len);
+
+        if (icmp_cb) {
+            icmp_cb(src, payload, payload_len);
+        }
+
+        /* TODO: Handle Echo Request here if we want to reply to pings */
+    }
+}
+
+static void reasm_free(ip_reasm_t* r) {
+    if (r->buf) kfree(r->buf);
+    reasm_mem -= r->cap;
+    memset(r, 0, sizeof(*r));
+}
+
+static void reasm_drop(ip_reasm_t* r) {
+    ip_stats.reasm_fails++;
+    reasm_free(r);
+}
+
+static ip_reasm_t* reasm_oldest(const ip_reasm_t* except) {
+    ip_reasm_t* old = NULL;
+    for (int i = 0; i < IP_REASM_MAX; i++) {
+        ip_reasm_t* r = &reasm[i];
+        if (!r->used || r == except) continue;
+        if (!old || (int32_t)(r->deadline - old->deadline) < 0) old = r;
     }
-    if (length & 1) {
-        uint16_t word = 0;
-        memcpy(&word, data + length - 1, 1);
-        acc += ntohs(word);
+    return old;
+}
+
+static ip_reasm_t* reasm_find(const ipv4_header_t* hdr) {
+    ip_reasm_t* free_slot = NULL;
+    for (int i = 0; i < IP_REASM_MAX; i++) {
+        ip_reasm_t* r = &reasm[i];
+        if (!r->used) {
+            if (!free_slot) free_slot = r;
+            continue;
+        }
+        if (r->src == hdr->src && r->dst == hdr->dst && r->id == hdr->id && r->proto == hdr->proto)
+            return r;
+    }
+
+    if (!free_slot) {
+        free_slot = reasm_oldest(NULL);
+        reasm_drop(free_slot);
+    }
+    free_slot->used = 1;
+    free_slot->src = hdr->src;
+    free_slot->dst = hdr->dst;
+    free_slot->id = hdr->id;
+    free_slot->proto = hdr->proto;
+    free_slot->deadline = net_time_ms() + IP_REASM_TIMEOUT_MS;
+    return free_slot;
+}
+
+/* Grow r->buf to hold need bytes, evicting older datagrams past the memory cap */
+static int reasm_reserve(ip_reasm_t* r, uint32_t need) {
+    if (need <= r->cap) return 0;
+    uint32_t cap = r->total ? r->total : (need + 2047) & ~2047u;
+    if (!r->total && cap < r->cap * 2) cap = r->cap * 2;     /* Fragments usually arrive in order */
+    if (cap > IP_MAX_DATAGRAM) cap = IP_MAX_DATAGRAM;
+
+    while (reasm_mem - r->cap + cap > IP_REASM_MEM_MAX) {
+        ip_reasm_t* old = reasm_oldest(r);
+        if (!old) return -ENOMEM;
+        reasm_drop(old);
+    }
+
+    uint8_t* nb = (uint8_t*)kmalloc(cap);
+    if (!nb) return -ENOMEM;
+    if (r->buf) {
+        memcpy(nb, r->buf, r->cap);
+        kfree(r->buf);
+    }
+    reasm_mem += cap - r->cap;
+    r->buf = nb;
+    r->cap = cap;
+    return 0;
+}
+
+/* Fragment [off, off+len) of hdr's datagram. Overlaps are treated as an
+   attack and drop the whole datagram; exact duplicates are ignored. */
+static void ipv4_reassemble(net_device_t* dev, const ipv4_header_t* hdr,
+                            const uint8_t* payload, uint32_t len, uint32_t off, int more) {
+    ip_stats.frags_in++;
+    if ((more && (len & 7)) || len == 0 || off + len > IP_MAX_DATAGRAM - sizeof(ipv4_header_t)) {
+        ip_stats.reasm_fails++;
+        return;
+    }
+
+    ip_reasm_t* r = reasm_find(hdr);
+    uint32_t end = off + len;
+
+    if (r->total ? (end > r->total || (!more && end != r->total)) : (!more && end < r->received)) {
+        reasm_drop(r);
+        return;
+    }
+
+    uint32_t first = off / 8, last = (end + 7) / 8;
+    uint32_t seen = 0;
+    for (uint32_t b = first; b < last; b++)
+        if (r->have[b >> 3] & (1 << (b & 7))) seen++;
+    if (seen == last - first) return;       /* Duplicate */
+    if (seen) {
+        reasm_drop(r);
+        return;
+    }
+
+    if (!more) {
+        r->total = end;
+        for (uint32_t b = last; b < sizeof(r->have) * 8; b++) {
+            if (r->have[b >> 3] & (1 << (b & 7))) {
+                reasm_drop(r);              /* Data past the end */
+                return;
+            }
+        }
+    }
+
+    if (reasm_reserve(r, end) != 0) {
+        reasm_drop(r);
+        return;
+    }
+    memcpy(r->buf + off, payload, len);
+    for (uint32_t b = first; b < last; b++) r->have[b >> 3] |= 1 << (b & 7);
+    r->received += len;
+
+    if (r->total && r->received == r->total) {
+        ip_stats.reasm_ok++;
+        ipv4_deliver(dev, r->src, r->dst, r->proto, r->buf, r->total);
+        reasm_free(r);
     }
-    while (acc >> 16) acc = (acc & 0xFFFF) + (acc >> 16);
-    return htons(~acc);
 }
 
 void ipv4_handle_packet(net_device_t* dev, const void* data, size_t len) {
     if (len < sizeof(ipv4_header_t)) return;
-    
+
     ipv4_header_t* hdr = (ipv4_header_t*)data;
     if (hdr->version != 4) return;
-    
+
     uint32_t src = hdr->src;
-    /* serial("[IP] Packet from %d.%d.%d.%d proto=%d\n", 
+    /* serial("[IP] Packet from %d.%d.%d.%d proto=%d\n",
            src & 0xFF, (src>>8)&0xFF, (src>>16)&0xFF, (src>>24)&0xFF, hdr->proto); */
 
     size_t header_len = hdr->ihl * 4;
-    void* payload = (uint8_t*)data + header_len;
-    size_t payload_len = ntohs(hdr->len) - header_len;
+    size_t total_len = ntohs(hdr->len);
+    if (header_len < sizeof(ipv4_header_t) || total_len < header_len || total_len > len) return;
 
-    if (hdr->proto == IP_PROTO_UDP) {
-        udp_handle_packet(dev, src, payload, payload_len);
-    } else if (hdr->proto == IP_PROTO_TCP) {
-        tcp_handle_packet(dev, src, payload, payload_len);
-    } else if (hdr->proto == IP_PROTO_ICMP) {
-        if (icmp_cb) {
-            icmp_cb(src, (const uint8_t*)payload, payload_len);
+    /* Summing a valid header including its checksum field yields zero */
+    if (ip_compute_csum(hdr, header_len) != 0) return;
+
+    uint8_t* payload = (uint8_t*)data + header_len;
+    size_t payload_len = total_len - header_len;
+
+    uint16_t frag = ntohs(hdr->frag_offset);
+    if (frag & (IP_FLAG_MF | IP_OFFSET_MASK)) {
+        ipv4_reassemble(dev, hdr, payload, payload_len, (frag & IP_OFFSET_MASK) * 8, (frag & IP_FLAG_MF) != 0);
+        return;
+    }
+
+    ipv4_deliver(dev, src, hdr->dst, hdr->proto, payload, payload_len);
+}
+
+void ipv4_timer_poll(void) {
+    uint32_t now = net_time_ms();
+    for (int i = 0; i < IP_REASM_MAX; i++) {
+        ip_reasm_t* r = &reasm[i];
+        if (r->used && (int32_t)(now - r->deadline) >= 0) {
+            ip_stats.reasm_timeouts++;
+            reasm_free(r);
         }
+    }
+}
 
-        /* Log ICMP packets (e.g. Ping Reply) */
-        serial("[IP] ICMP Packet from %d.%d.%d.%d len=%d\n",
-               src & 0xFF, (src>>8)&0xFF, (src>>16)&0xFF, (src>>24)&0xFF, payload_len);
-        /* TODO: Handle Echo Request here if we want to reply to pings */
+/* -------------------------------------------------- */
+/* Output */
+
+/* Per-flow IDs: a counter per (src, dst, proto) hash bucket, randomly
+   seeded, so IDs are neither global nor predictable across flows */
+static uint16_t ipv4_next_id(uint32_t src, uint32_t dst, uint8_t proto) {
+    if (!ip_ids_seeded) {
+        for (int i = 0; i < IP_ID_BUCKETS; i++) ip_ids[i] = (uint16_t)prng_next();
+        ip_ids_seeded = 1;
+    }
+    uint32_t h = (dst * 0x9E3779B1u) ^ (src * 0x85EBCA6Bu) ^ proto;
+    h ^= h >> 16;
+    return ip_ids[h % IP_ID_BUCKETS]++;
+}
+
+static int ipv4_output(net_device_t* dev, uint32_t dst_ip, uint32_t next_hop, const uint8_t* packet, size_t len) {
+    if (dev->flags & NETDEV_LOOPBACK) {
+        eth_send(dev, dev->mac, ETH_TYPE_IP, packet, len);
+    } else if (dst_ip == 0xFFFFFFFF || dst_ip == 0) {
+        /* Handle Broadcast */
+        static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+        eth_send(dev, broadcast, ETH_TYPE_IP, packet, len);
+    } else {
+        /* Held in the neighbour cache until the next hop resolves */
+        return arp_output(dev, next_hop, packet, len);
     }
+    return 0;
 }
 
 int ipv4_send(net_device_t* dev, uint32_t dst_ip, uint8_t proto, const void* data, size_t len) {
-    uint8_t dst_mac[6];
-    
     uint32_t next_hop = dst_ip;
-    
+
     /* Check if destination is in local subnet */
     if ((dst_ip & dev->subnet) != (dev->ip & dev->subnet)) {
         next_hop = dev->gateway;
     }
 
-    /* Handle Broadcast */
-    if (dst_ip == 0xFFFFFFFF || dst_ip == 0) {
-        memset(dst_mac, 0xFF, 6);
-    } else {
-        if (!arp_lookup(next_hop, dst_mac)) {
-            serial("[IP] ARP miss for %x (next hop), sending request...\n", next_hop);
-            arp_send_request(dev, next_hop);
-            return -1; /* Packet dropped, retry later */
-        }
-    }
+    if (len > IP_MAX_DATAGRAM - sizeof(ipv4_header_t)) return -EMSGSIZE;
 
+    uint32_t mtu = ipv4_path_mtu(dev, dst_ip);
+    int df = proto == IP_PROTO_TCP;
     size_t total_len = sizeof(ipv4_header_t) + len;
-    uint8_t* packet = (uint8_t*)kmalloc(total_len);
+    if (df && total_len > mtu) {
+        ip_stats.frag_fails++;
+        return -EMSGSIZE;
+    }
+
+    /* Fragment payloads are multiples of 8 bytes except the last */
+    size_t frag_max = total_len <= mtu ? len : ((mtu - sizeof(ipv4_header_t)) & ~7u);
+    uint8_t* packet = (uint8_t*)kmalloc(sizeof(ipv4_header_t) + frag_max);
     if (!packet) return -1;
 
     ipv4_header_t* hdr = (ipv4_header_t*)packet;
     hdr->version = 4;
     hdr->ihl = 5;
     hdr->tos = 0;
-    hdr->len = htons(total_len);
-    hdr->id = htons(0x1234);
-    hdr->frag_offset = 0;
+    hdr->id = htons(ipv4_next_id(dev->ip, dst_ip, proto));
     hdr->ttl = 64;
     hdr->proto = proto;
     hdr->src = dev->ip;
     hdr->dst = dst_ip;
-    hdr->checksum = 0;
-    hdr->checksum = ip_checksum(hdr, sizeof(ipv4_header_t));
 
-    memcpy(packet + sizeof(ipv4_header_t), data, len);
+    int ret = 0;
+    size_t off = 0;
+    do {
+        size_t n = len - off < frag_max ? len - off : frag_max;
+        uint16_t frag = (uint16_t)(off / 8);
+        if (df) frag |= IP_FLAG_DF;
+        if (off + n < len) frag |= IP_FLAG_MF;
+
+        hdr->len = htons(sizeof(ipv4_header_t) + n);
+        hdr->frag_offset = htons(frag);
+        hdr->checksum = 0;
+        hdr->checksum = ip_compute_csum(hdr, sizeof(ipv4_header_t));
+        memcpy(packet + sizeof(ipv4_header_t), (const uint8_t*)data + off, n);
+
+        ret = ipv4_output(dev, dst_ip, next_hop, packet, sizeof(ipv4_header_t) + n);
+        if (frag_max < len) ip_stats.frags_out++;
+        off += n;
+    } while (ret >= 0 && off < len);
 
-    eth_send(dev, dst_mac, ETH_TYPE_IP, packet, total_len);
     kfree(packet);
-    return 0;
-}
\ No newline at end of file
+    return ret;
+}
+
+void ipv4_print_stats(void) {
+    terminal_printf("Fragments: %u sent, %u received, %u too big for DF\n",
+                    ip_stats.frags_out, ip_stats.frags_in, ip_stats.frag_fails);
+    terminal_printf("Reassembly: %u done, %u dropped, %u timed out, %u bytes queued\n",
+                    ip_stats.reasm_ok, ip_stats.reasm_fails, ip_stats.reasm_timeouts, reasm_mem);
+    terminal_printf("PMTU cache (%u updates):\n", ip_stats.pmtu_updates);
+    uint32_t now = net_time_ms();
+    for (int i = 0; i < IP_PMTU_CACHE; i++) {
+        pmtu_entry_t* e = &pmtu_cache[i];
+        if (!e->mtu || (int32_t)(now - e->expires) >= 0) continue;
+        uint32_t ip = e->dst;
+        terminal_printf("  %d.%d.%d.%d  mtu %u  %us left\n", ip & 0xFF, (ip>>8)&0xFF, (ip>>16)&0xFF, (ip>>24)&0xFF,
+                        e->mtu, (e->expires - now) / 1000);
+    }
+}
@@ -9,6 +9,20 @@ extern "C" {
 #define IP_PROTO_TCP  6
 #define IP_PROTO_UDP 17
 
+/* frag_offset field (host order) */
+#define IP_FLAG_DF      0x4000
+#define IP_FLAG_MF      0x2000
+#define IP_OFFSET_MASK  0x1FFF
+
+#define IP_MAX_DATAGRAM     65535
+#define IP_MIN_PMTU         576     /* Floor for "fragmentation needed" updates */
+#define IP_PMTU_CACHE       32
+#define IP_PMTU_EXPIRE_MS   (10 * 60 * 1000)    /* RFC 1191: probe upwards again after 10 min */
+#define IP_ID_BUCKETS       256     /* Per-flow IP ID counters */
+#define IP_REASM_MAX        16      /* Datagrams being reassembled at once */
+#define IP_REASM_TIMEOUT_MS 30000
+#define IP_REASM_MEM_MAX    (256 * 1024)
+
 typedef struct {
     uint8_t  ihl : 4;
     uint8_t  version : 4;
@@ -24,8 +38,18 @@ typedef struct {
 } __attribute__((packed)) ipv4_header_t;
 
 void ipv4_handle_packet(net_device_t* dev, const void* data, size_t len);
+
+/* Fragments datagrams larger than the path MTU. TCP goes out with DF set
+   (path MTU discovery) and gets -EMSGSIZE instead of fragmentation. */
 int ipv4_send(net_device_t* dev, uint32_t dst_ip, uint8_t proto, const void* data, size_t len);
 
+/* Device MTU, lowered by ICMP "fragmentation needed" for that destination */
+uint32_t ipv4_path_mtu(net_device_t* dev, uint32_t dst_ip);
+
+/* Reassembly timeouts (called from net_poll) */
+void ipv4_timer_poll(void);
+void ipv4_print_stats(void);
+
 typedef void (*icmp_callback_t)(uint32_t src_ip, const uint8_t* data, size_t len);
 void ipv4_set_icmp_callback(icmp_callback_t callback);
 
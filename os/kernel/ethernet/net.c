@@ -1,15 +1,50 @@
 #include "net.h"
 #include "net_device.h"
+#include "drivers/virtio_net.h"
 #include "drivers/e1000.h"
 #include "drivers/rtl8139.h"
+#include "drivers/loopback.h"
 #include "dhcp.h"
+#include "tcp.h"
+#include "arp.h"
+#include "dns.h"
+#include "httpd.h"
+#include "netcap.h"
+#include "checksum.h"
+#include "../hardware/hpet.h"
+#include "../crypto/prng.h"
+#include "../time/timer.h"
+#include "../sched/wait.h"
 
 extern void serial(const char *fmt, ...);
 
+uint32_t net_time_ms(void) {
+    if (hpet_is_active()) return (uint32_t)hpet_time_ms();
+    return timer_uptime_ms();
+}
+
 void net_init(void) {
     serial("[NET] Initializing network subsystem...\n");
 
-    /* Probe Drivers */
+    /* Blocking socket calls run the stack while they sleep */
+    wait_set_idle_hook(net_poll);
+    csum_init();
+
+    /* ISNs, DNS and IP IDs come from the xorshift; seed it once, unguessably */
+    uint32_t seed;
+    prng_fill(&seed, sizeof(seed));
+    prng_seed(seed);
+
+    /* Always present, so the stack works (and can be benchmarked) without a NIC */
+    loopback_init();
+
+    /* Probe Drivers (paravirtual first) */
+    if (virtio_net_init() == 0) {
+        serial("[NET] virtio-net driver loaded.\n");
+        dhcp_discover(); /* Auto-configure */
+        return;
+    }
+
     if (e1000_init() == 0) {
         serial("[NET] E1000 driver loaded.\n");
         dhcp_discover(); /* Auto-configure */
@@ -25,7 +60,49 @@ void net_init(void) {
     serial("[NET] No network device found.\n");
 }
 
+/* IRQ context: just flag the device, the real work runs in net_rx_action() */
+void net_rx_schedule(net_device_t* dev) {
+    if (!dev) return;
+    dev->rx_irqs++;
+    dev->rx_scheduled = 1;
+}
+
+int net_rx_action(void) {
+    int total = 0;
+
+    for (net_device_t* dev = net_get_device_list(); dev; dev = dev->next) {
+        if (!dev->rx_poll) {
+            /* Legacy polled-only driver */
+            if (dev->poll) total += dev->poll(dev);
+            continue;
+        }
+
+        if (!dev->rx_scheduled) {
+            if (++dev->rx_idle_passes < NET_RX_FALLBACK_PASSES) continue;
+        }
+        dev->rx_idle_passes = 0;
+
+        int done = dev->rx_poll(dev, NET_RX_BUDGET);
+        dev->rx_packets += done;
+        total += done;
+
+        /* Budget not exhausted -> ring is empty, hand control back to the IRQ.
+           Otherwise stay scheduled and continue on the next pass. */
+        if (done < NET_RX_BUDGET) {
+            dev->rx_scheduled = 0;
+            if (dev->rx_irq_enable) dev->rx_irq_enable(dev);
+        }
+    }
+
+    return total;
+}
+
 void net_poll(void) {
-    net_device_t* dev = net_get_primary_device();
-    if (dev && dev->poll) dev->poll(dev);
-}
\ No newline at end of file
+    net_rx_action();
+    arp_timer_poll();
+    ipv4_timer_poll();
+    tcp_timer_poll();
+    dns_timer_poll();
+    httpd_poll();
+    netcap_poll();
+}
@@ -1,12 +1,34 @@
 #pragma once
+#include "net_device.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Max frames drained from one device per RX softirq pass.
+   Keeps a flood of traffic from starving the shell/GUI loop. */
+#ifndef NET_RX_BUDGET
+#define NET_RX_BUDGET 64
+#endif
+
+/* Softirq passes without an RX IRQ before a device is polled anyway
+   (safety net for lost or unrouted interrupts). */
+#ifndef NET_RX_FALLBACK_PASSES
+#define NET_RX_FALLBACK_PASSES 256
+#endif
+
 void net_init(void);
 void net_poll(void);
 
+/* Monotonic milliseconds for protocol timers (HPET, PIT fallback) */
+uint32_t net_time_ms(void);
+
+/* Called from driver IRQ handlers (RX IRQ already masked by the driver) */
+void net_rx_schedule(net_device_t* dev);
+
+/* RX softirq: services scheduled devices, returns frames processed */
+int net_rx_action(void);
+
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
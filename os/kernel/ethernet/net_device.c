@@ -5,16 +5,22 @@
 extern void serial(const char *fmt, ...);
 
 static net_device_t* primary_dev = NULL;
+static net_device_t* dev_list = NULL;
 
 void net_register_device(net_device_t* dev) {
     if (!dev) return;
-    
+
     serial("[NET] Registered device: %s MAC: %02x:%02x:%02x:%02x:%02x:%02x\n",
            dev->name,
            dev->mac[0], dev->mac[1], dev->mac[2],
            dev->mac[3], dev->mac[4], dev->mac[5]);
 
-    if (!primary_dev) {
+    if (!dev->mtu) dev->mtu = NETDEV_MTU_DEFAULT;
+
+    dev->next = dev_list;
+    dev_list = dev;
+
+    if (!primary_dev && !(dev->flags & NETDEV_LOOPBACK)) {
         primary_dev = dev;
         serial("[NET] Set as primary device.\n");
     }
@@ -22,4 +28,17 @@ void net_register_device(net_device_t* dev) {
 
 net_device_t* net_get_primary_device(void) {
     return primary_dev;
-}
\ No newline at end of file
+}
+
+net_device_t* net_get_device_list(void) {
+    return dev_list;
+}
+
+net_device_t* net_route_device(uint32_t dst_ip) {
+    if ((dst_ip & 0xFF) == 127) { /* 127.0.0.0/8 (network byte order) */
+        for (net_device_t* d = dev_list; d; d = d->next) {
+            if (d->flags & NETDEV_LOOPBACK) return d;
+        }
+    }
+    return primary_dev;
+}
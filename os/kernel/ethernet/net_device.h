@@ -6,23 +6,47 @@
 extern "C" {
 #endif
 
+#define NETDEV_LOOPBACK 0x01   /* Never primary, no ARP */
+#define NETDEV_MTU_DEFAULT 1500 /* Ethernet payload */
+
 typedef struct net_device {
     char name[16];
+    uint32_t flags;
     uint8_t mac[6];
     uint32_t ip;     /* IPv4 Address (Network Byte Order) */
     uint32_t gateway;
     uint32_t subnet;
     uint32_t dns_server;
+    uint32_t mtu;    /* Largest IP datagram per frame (0: NETDEV_MTU_DEFAULT) */
 
     int (*send)(struct net_device* dev, const void* data, size_t len);
-    int (*poll)(struct net_device* dev);
-    
+    int (*poll)(struct net_device* dev);  /* Polled-only drivers (no RX IRQ) */
+
+    /* NAPI-style receive (optional).
+       The RX IRQ masks itself and calls net_rx_schedule(); the RX softirq
+       then calls rx_poll() with a packet budget and re-arms the IRQ with
+       rx_irq_enable() once the ring is drained. */
+    int  (*rx_poll)(struct net_device* dev, int budget);
+    void (*rx_irq_enable)(struct net_device* dev);
+    volatile int rx_scheduled;
+    uint32_t rx_idle_passes;
+
+    /* Statistics */
+    uint32_t rx_packets;
+    uint32_t rx_irqs;
+
+    struct net_device* next; /* Registered device list */
     void* priv; /* Driver private data */
 } net_device_t;
 
 void net_register_device(net_device_t* dev);
 net_device_t* net_get_primary_device(void);
+net_device_t* net_get_device_list(void);
+
+/* Output device for a destination: loopback for 127/8, otherwise the
+   primary NIC (NULL if none) */
+net_device_t* net_route_device(uint32_t dst_ip);
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
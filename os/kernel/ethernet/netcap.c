@@ -0,0 +1,495 @@
+#include "netcap.h"
+#include "eth.h"
+#include "ipv4.h"
+#include "net.h"
+#include "../mm/kmalloc.h"
+#include "../string.h"
+#include "../terminal.h"
+#include "../cmds/fat.h"
+#include "../drivers/serial.h"
+#include "../hardware/hpet.h"
+#include <ctype.h>
+#include <errno.h>
+
+extern void serial(const char *fmt, ...);
+
+/* Ring record. Records are 8-byte aligned; one that would straddle the
+   end of the ring is preceded by a NETCAP_PAD record filling the tail
+   (only len and dir are written, so a pad can be as small as 8 bytes). */
+#define NETCAP_PAD 0xFF
+
+typedef struct {
+    uint32_t len;           /* Whole record, header included */
+    uint8_t  dir;
+    uint8_t  reserved;
+    uint16_t caplen;
+    uint32_t origlen;
+    uint32_t sec, usec;
+} netcap_rec_t;
+
+/* pcap file format, little endian, microsecond timestamps */
+#define PCAP_MAGIC          0xA1B2C3D4
+#define PCAP_LINKTYPE_ETH   1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version_major, version_minor;
+    int32_t  thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t network;
+} __attribute__((packed)) pcap_file_hdr_t;
+
+typedef struct {
+    uint32_t ts_sec, ts_usec;
+    uint32_t incl_len, orig_len;
+} __attribute__((packed)) pcap_rec_hdr_t;
+
+volatile int netcap_active = 0;
+
+static uint8_t* ring = NULL;
+static uint32_t ring_size, ring_mask;
+static volatile uint32_t ring_head;     /* Producer: the stack */
+static volatile uint32_t ring_tail;     /* Consumer: the sink */
+
+static netcap_filter_t filter;
+static uint32_t snaplen;
+static int sink = NETCAP_SINK_RING;
+static fat_writer_t* file = NULL;
+static char file_path[64];
+static int in_poll = 0;
+
+/* Serial sink: progress through the record at the tail */
+static uint8_t ser_hdr[sizeof(pcap_rec_hdr_t)];
+static uint32_t ser_off;
+
+static struct {
+    uint32_t seen, captured, filtered, dropped;
+    uint32_t records_out, bytes_out;
+    int error;
+} st;
+
+/* -------------------------------------------------- */
+/* Filters */
+
+typedef struct {
+    uint16_t ethertype;
+    uint8_t  is_ip, proto, has_ports;
+    uint32_t src, dst;
+    uint16_t sport, dport;
+} netcap_pkt_t;
+
+static void dissect(const uint8_t* f, uint32_t len, netcap_pkt_t* p) {
+    memset(p, 0, sizeof(*p));
+    if (len < sizeof(eth_header_t)) return;
+    p->ethertype = (uint16_t)((f[12] << 8) | f[13]);
+    if (p->ethertype != ETH_TYPE_IP || len < sizeof(eth_header_t) + 20) return;
+
+    const uint8_t* ip = f + sizeof(eth_header_t);
+    uint32_t ihl = (uint32_t)(ip[0] & 0x0F) * 4;
+    if ((ip[0] >> 4) != 4 || ihl < 20) return;
+    p->is_ip = 1;
+    p->proto = ip[9];
+    memcpy(&p->src, ip + 12, 4);
+    memcpy(&p->dst, ip + 16, 4);
+
+    /* Ports only in the first fragment */
+    uint16_t frag = (uint16_t)(((ip[6] << 8) | ip[7]) & 0x1FFF);
+    if (frag == 0 && (p->proto == IP_PROTO_TCP || p->proto == IP_PROTO_UDP) &&
+        len >= sizeof(eth_header_t) + ihl + 4) {
+        const uint8_t* l4 = ip + ihl;
+        p->sport = (uint16_t)((l4[0] << 8) | l4[1]);
+        p->dport = (uint16_t)((l4[2] << 8) | l4[3]);
+        p->has_ports = 1;
+    }
+}
+
+static int term_match(const netcap_term_t* t, const netcap_pkt_t* p, int dir) {
+    switch (t->kind) {
+        case NETCAP_F_ARP:      return p->ethertype == ETH_TYPE_ARP;
+        case NETCAP_F_IP:       return p->is_ip;
+        case NETCAP_F_ICMP:     return p->is_ip && p->proto == IP_PROTO_ICMP;
+        case NETCAP_F_TCP:      return p->is_ip && p->proto == IP_PROTO_TCP;
+        case NETCAP_F_UDP:      return p->is_ip && p->proto == IP_PROTO_UDP;
+        case NETCAP_F_RX:       return dir == NETCAP_RX;
+        case NETCAP_F_TX:       return dir == NETCAP_TX;
+        case NETCAP_F_PORT:     return p->has_ports && (p->sport == t->value || p->dport == t->value);
+        case NETCAP_F_SRC_PORT: return p->has_ports && p->sport == t->value;
+        case NETCAP_F_DST_PORT: return p->has_ports && p->dport == t->value;
+        case NETCAP_F_HOST:     return p->is_ip && (p->src == t->value || p->dst == t->value);
+        case NETCAP_F_SRC_HOST: return p->is_ip && p->src == t->value;
+        case NETCAP_F_DST_HOST: return p->is_ip && p->dst == t->value;
+    }
+    return 0;
+}
+
+int netcap_filter_match(const netcap_filter_t* f, const uint8_t* frame, uint32_t len, int dir) {
+    netcap_pkt_t p;
+    dissect(frame, len, &p);
+    for (int i = 0; i < f->count; i++) {
+        if (term_match(&f->t[i], &p, dir) == f->t[i].negate) return 0;
+    }
+    return 1;
+}
+
+static int parse_num(const char* s, uint32_t max, uint32_t* out) {
+    uint32_t v = 0;
+    if (!isdigit((unsigned char)*s)) return -1;
+    while (isdigit((unsigned char)*s)) {
+        v = v * 10 + (uint32_t)(*s++ - '0');
+        if (v > max) return -1;
+    }
+    if (*s) return -1;
+    *out = v;
+    return 0;
+}
+
+static int parse_ip(const char* s, uint32_t* out) {
+    uint32_t ip = 0;
+    for (int i = 0; i < 4; i++) {
+        uint32_t v = 0;
+        int digits = 0;
+        while (isdigit((unsigned char)*s) && digits < 3) {
+            v = v * 10 + (uint32_t)(*s++ - '0');
+            digits++;
+        }
+        if (!digits || v > 255 || *s != (i < 3 ? '.' : 0)) return -1;
+        s++;
+        ip |= v << (i * 8);
+    }
+    *out = ip;
+    return 0;
+}
+
+int netcap_filter_parse(int argc, char** argv, netcap_filter_t* f, int* bad) {
+    static const struct { const char* word; uint8_t kind; } simple[] = {
+        { "arp", NETCAP_F_ARP }, { "ip", NETCAP_F_IP }, { "icmp", NETCAP_F_ICMP },
+        { "tcp", NETCAP_F_TCP }, { "udp", NETCAP_F_UDP }, { "rx", NETCAP_F_RX },
+        { "tx", NETCAP_F_TX },
+    };
+
+    memset(f, 0, sizeof(*f));
+    int negate = 0;
+    for (int i = 0; i < argc; i++) {
+        const char* w = argv[i];
+        *bad = i;
+        if (strcmp(w, "and") == 0 || strcmp(w, "&&") == 0) continue;
+        if (strcmp(w, "not") == 0 || strcmp(w, "!") == 0) {
+            negate ^= 1;
+            continue;
+        }
+        if (f->count == NETCAP_FILTER_MAX) return -EINVAL;
+        netcap_term_t* t = &f->t[f->count];
+        t->negate = (uint8_t)negate;
+
+        uint8_t kind = 0;
+        for (uint32_t k = 0; k < sizeof(simple) / sizeof(simple[0]); k++) {
+            if (strcmp(w, simple[k].word) == 0) kind = simple[k].kind;
+        }
+        if (!kind) {
+            /* [src|dst] port N / [src|dst] host A.B.C.D */
+            int qual = 0;
+            if (strcmp(w, "src") == 0 || strcmp(w, "dst") == 0) {
+                qual = w[0] == 's' ? 1 : 2;
+                if (++i >= argc) return -EINVAL;
+                w = argv[i];
+            }
+            if (i + 1 >= argc) return -EINVAL;
+            if (strcmp(w, "port") == 0) {
+                if (parse_num(argv[i + 1], 65535, &t->value) != 0) { *bad = i + 1; return -EINVAL; }
+                kind = (uint8_t)(NETCAP_F_PORT + qual);
+            } else if (strcmp(w, "host") == 0) {
+                if (parse_ip(argv[i + 1], &t->value) != 0) { *bad = i + 1; return -EINVAL; }
+                kind = (uint8_t)(NETCAP_F_HOST + qual);
+            } else {
+                return -EINVAL;
+            }
+            i++;
+        }
+        t->kind = kind;
+        f->count++;
+        negate = 0;
+    }
+    return negate ? -EINVAL : 0;
+}
+
+/* -------------------------------------------------- */
+/* Capture (producer) */
+
+static void timestamp(uint32_t* sec, uint32_t* usec) {
+    if (hpet_is_active()) {
+        /* 1000000 = 64 * 15625: 32-bit division, good for ~76 hours */
+        uint64_t us = hpet_time_us();
+        *sec = (uint32_t)(us >> 6) / 15625;
+        *usec = (uint32_t)(us - (uint64_t)*sec * 1000000);
+    } else {
+        uint32_t ms = net_time_ms();
+        *sec = ms / 1000;
+        *usec = (ms % 1000) * 1000;
+    }
+}
+
+void netcap_capture(net_device_t* dev, const void* frame, uint32_t len, int dir) {
+    (void)dev;
+    st.seen++;
+    if (filter.count && !netcap_filter_match(&filter, (const uint8_t*)frame, len, dir)) {
+        st.filtered++;
+        return;
+    }
+
+    uint32_t cap = len < snaplen ? len : snaplen;
+    uint32_t need = (sizeof(netcap_rec_t) + cap + 7) & ~7u;
+    uint32_t head = ring_head;
+    uint32_t pos = head & ring_mask;
+    uint32_t skip = ring_size - pos < need ? ring_size - pos : 0;
+
+    if (ring_size - (head - ring_tail) < skip + need) {
+        st.dropped++;
+        return;
+    }
+    if (skip) {
+        netcap_rec_t* pad = (netcap_rec_t*)(ring + pos);
+        pad->len = skip;
+        pad->dir = NETCAP_PAD;
+        head += skip;
+        pos = 0;
+    }
+
+    netcap_rec_t* r = (netcap_rec_t*)(ring + pos);
+    r->len = need;
+    r->dir = (uint8_t)dir;
+    r->caplen = (uint16_t)cap;
+    r->origlen = len;
+    timestamp(&r->sec, &r->usec);
+    memcpy(r + 1, frame, cap);
+
+    /* Record contents before the index that publishes them */
+    __sync_synchronize();
+    ring_head = head + need;
+    st.captured++;
+}
+
+/* -------------------------------------------------- */
+/* Sinks (consumer) */
+
+static void file_header(pcap_file_hdr_t* h) {
+    h->magic = PCAP_MAGIC;
+    h->version_major = 2;
+    h->version_minor = 4;
+    h->thiszone = 0;
+    h->sigfigs = 0;
+    h->snaplen = snaplen;
+    h->network = PCAP_LINKTYPE_ETH;
+}
+
+static void rec_header(const netcap_rec_t* r, pcap_rec_hdr_t* h) {
+    h->ts_sec = r->sec;
+    h->ts_usec = r->usec;
+    h->incl_len = r->caplen;
+    h->orig_len = r->origlen;
+}
+
+/* Oldest record, skipping pads; NULL when the ring is empty */
+static const netcap_rec_t* ring_peek(void) {
+    while (ring_tail != ring_head) {
+        __sync_synchronize();
+        const netcap_rec_t* r = (const netcap_rec_t*)(ring + (ring_tail & ring_mask));
+        if (r->dir != NETCAP_PAD) return r;
+        ring_tail += r->len;
+    }
+    return NULL;
+}
+
+static void ring_pop(const netcap_rec_t* r) {
+    __sync_synchronize();
+    ring_tail += r->len;
+}
+
+static int drain_to_file(fat_writer_t* w) {
+    const netcap_rec_t* r;
+    int n = 0;
+    while ((r = ring_peek()) != NULL) {
+        pcap_rec_hdr_t h;
+        rec_header(r, &h);
+        int e = fat32_writer_write(w, &h, sizeof(h));
+        if (e == 0) e = fat32_writer_write(w, r + 1, r->caplen);
+        if (e < 0) return e;
+        st.records_out++;
+        st.bytes_out += sizeof(h) + r->caplen;
+        ring_pop(r);
+        n++;
+    }
+    return n;
+}
+
+/* Feed COM2 without waiting on it: whatever the FIFO takes, up to budget */
+static void drain_to_serial(uint32_t budget) {
+    const netcap_rec_t* r;
+    while (budget > 0 && (r = ring_peek()) != NULL) {
+        if (ser_off == 0) rec_header(r, (pcap_rec_hdr_t*)ser_hdr);
+        uint32_t total = sizeof(ser_hdr) + r->caplen;
+        const uint8_t* src = ser_off < sizeof(ser_hdr) ? ser_hdr + ser_off
+                                                        : (const uint8_t*)(r + 1) + (ser_off - sizeof(ser_hdr));
+        uint32_t chunk = ser_off < sizeof(ser_hdr) ? sizeof(ser_hdr) - ser_off : total - ser_off;
+        if (chunk > budget) chunk = budget;
+
+        int sent = serial2_write_nb(src, (int)chunk);
+        if (sent <= 0) return;
+        ser_off += (uint32_t)sent;
+        budget -= (uint32_t)sent;
+        st.bytes_out += (uint32_t)sent;
+        if (ser_off == total) {
+            ser_off = 0;
+            st.records_out++;
+            ring_pop(r);
+        }
+    }
+}
+
+static void serial_put_all(const void* buf, uint32_t len) {
+    const uint8_t* p = (const uint8_t*)buf;
+    while (len > 0) {
+        int n = serial2_write_nb(p, (int)len);
+        p += n;
+        len -= (uint32_t)n;
+    }
+}
+
+void netcap_poll(void) {
+    if (!ring || in_poll || st.error) return;
+    in_poll = 1;
+    if (sink == NETCAP_SINK_FILE && file) {
+        int r = drain_to_file(file);
+        if (r < 0) {
+            /* Keep capturing into the ring; the file is closed at stop */
+            st.error = r;
+            serial("[NETCAP] %s: write failed (%d)\n", file_path, r);
+        }
+    } else if (sink == NETCAP_SINK_SERIAL) {
+        drain_to_serial(NETCAP_SERIAL_BUDGET);
+    }
+    in_poll = 0;
+}
+
+/* -------------------------------------------------- */
+/* Control */
+
+static uint32_t ring_bytes_pow2(uint32_t want) {
+    if (want == 0) want = NETCAP_RING_DEFAULT;
+    if (want < NETCAP_RING_MIN) want = NETCAP_RING_MIN;
+    if (want > NETCAP_RING_MAX) want = NETCAP_RING_MAX;
+    uint32_t size = NETCAP_RING_MIN;
+    while (size * 2 <= want) size *= 2;
+    return size;
+}
+
+static int open_pcap(fat_writer_t* w, const char* path) {
+    fat_automount();
+    int r = fat32_writer_open(w, path);
+    if (r < 0) return r;
+
+    pcap_file_hdr_t h;
+    file_header(&h);
+    r = fat32_writer_write(w, &h, sizeof(h));
+    if (r < 0) fat32_writer_close(w);
+    return r;
+}
+
+int netcap_start(const netcap_filter_t* f, uint32_t snap, uint32_t ring_bytes,
+                 int how, const char* path) {
+    if (netcap_active) return -EALREADY;
+    if (how == NETCAP_SINK_FILE && (!path || !path[0] || strlen(path) >= sizeof(file_path))) return -EINVAL;
+    if (how == NETCAP_SINK_SERIAL && serial2_init() != 0) return -ENODEV;
+
+    if (ring) {
+        kfree(ring);
+        ring = NULL;
+    }
+    ring_size = ring_bytes_pow2(ring_bytes);
+    ring_mask = ring_size - 1;
+    ring = (uint8_t*)kmalloc(ring_size);
+    if (!ring) return -ENOMEM;
+    ring_head = ring_tail = 0;
+
+    snaplen = (snap == 0 || snap > NETCAP_SNAPLEN_MAX) ? NETCAP_SNAPLEN_MAX : snap;
+    if (f) filter = *f;
+    else memset(&filter, 0, sizeof(filter));
+    memset(&st, 0, sizeof(st));
+    sink = how;
+    ser_off = 0;
+
+    if (how == NETCAP_SINK_FILE) {
+        file = (fat_writer_t*)kmalloc(sizeof(fat_writer_t));
+        int r = file ? open_pcap(file, path) : -ENOMEM;
+        if (r < 0) {
+            if (file) kfree(file);
+            file = NULL;
+            kfree(ring);
+            ring = NULL;
+            return r;
+        }
+        strcpy(file_path, path);
+    } else if (how == NETCAP_SINK_SERIAL) {
+        pcap_file_hdr_t h;
+        file_header(&h);
+        serial_put_all(&h, sizeof(h));
+    }
+
+    __sync_synchronize();
+    netcap_active = 1;
+    return 0;
+}
+
+int netcap_stop(void) {
+    if (!netcap_active) return -EALREADY;
+    netcap_active = 0;
+    __sync_synchronize();
+    int r = 0;
+
+    if (sink == NETCAP_SINK_FILE && file) {
+        if (!st.error) {
+            int d = drain_to_file(file);
+            if (d < 0) st.error = d;
+        }
+        int c = fat32_writer_close(file);
+        r = st.error ? st.error : c;
+        kfree(file);
+        file = NULL;
+    } else if (sink == NETCAP_SINK_SERIAL) {
+        /* Finish the stream, whole records only */
+        while (ring_peek() != NULL) drain_to_serial(NETCAP_SERIAL_BUDGET);
+    }
+
+    if (sink != NETCAP_SINK_RING) {
+        kfree(ring);
+        ring = NULL;
+    }
+    return r;
+}
+
+int netcap_save(const char* path) {
+    if (!ring || sink != NETCAP_SINK_RING) return -EINVAL;
+
+    fat_writer_t* w = (fat_writer_t*)kmalloc(sizeof(fat_writer_t));
+    if (!w) return -ENOMEM;
+    int r = open_pcap(w, path);
+    if (r == 0) r = drain_to_file(w);
+    int c = fat32_writer_close(w);
+    kfree(w);
+    if (r >= 0 && c < 0) r = c;
+    return r;
+}
+
+void netcap_print_stats(void) {
+    static const char* sinks[] = { "ring", "file", "serial" };
+    terminal_printf("netcap: %s, sink %s", netcap_active ? "capturing" : "stopped", sinks[sink]);
+    if (sink == NETCAP_SINK_FILE && file) terminal_printf(" (%s)", file_path);
+    terminal_printf(", %d filter terms, snaplen %u\n", filter.count, snaplen);
+    terminal_printf("  frames seen %u  captured %u  filtered %u  dropped (ring full) %u\n",
+                    st.seen, st.captured, st.filtered, st.dropped);
+    if (ring) {
+        terminal_printf("  ring %u KB, %u bytes pending\n", ring_size / 1024, ring_head - ring_tail);
+    }
+    terminal_printf("  written %u records, %u bytes\n", st.records_out, st.bytes_out);
+    if (st.error) terminal_printf("  sink error %d\n", st.error);
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <stdint.h>
+#include "net_device.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Packet capture.
+ *
+ * eth_send() and eth_handle_packet() copy every frame that passes the
+ * filter into a single-producer/single-consumer byte ring; nothing on the
+ * capture path blocks or logs, and a full ring drops (and counts) the
+ * frame. The ring is drained from net_poll() into a pcap file on the FAT
+ * volume or a pcap stream on COM2, or kept in memory for "netcap save".
+ */
+
+#define NETCAP_RING_DEFAULT   (256 * 1024)
+#define NETCAP_RING_MIN       (16 * 1024)
+#define NETCAP_RING_MAX       (8 * 1024 * 1024)
+#define NETCAP_SNAPLEN_MAX    65535
+#define NETCAP_FILTER_MAX     8
+#define NETCAP_SERIAL_BUDGET  4096    /* Bytes pushed to COM2 per poll */
+
+/* Direction */
+#define NETCAP_RX 0
+#define NETCAP_TX 1
+
+/* Sinks */
+#define NETCAP_SINK_RING    0   /* Keep in memory until "netcap save" */
+#define NETCAP_SINK_FILE    1
+#define NETCAP_SINK_SERIAL  2
+
+/* Filter terms, all of which must match (each may be negated) */
+#define NETCAP_F_ARP        1
+#define NETCAP_F_IP         2
+#define NETCAP_F_ICMP       3
+#define NETCAP_F_TCP        4
+#define NETCAP_F_UDP        5
+#define NETCAP_F_RX         6
+#define NETCAP_F_TX         7
+#define NETCAP_F_PORT       8
+#define NETCAP_F_SRC_PORT   9
+#define NETCAP_F_DST_PORT   10
+#define NETCAP_F_HOST       11    /* value: IPv4, network byte order */
+#define NETCAP_F_SRC_HOST   12
+#define NETCAP_F_DST_HOST   13
+
+typedef struct {
+    uint8_t  kind;
+    uint8_t  negate;
+    uint32_t value;
+} netcap_term_t;
+
+typedef struct {
+    int count;
+    netcap_term_t t[NETCAP_FILTER_MAX];
+} netcap_filter_t;
+
+/* tcpdump-like words: arp ip icmp tcp udp rx tx, [src|dst] port N,
+   [src|dst] host A.B.C.D, "not" before a term; "and" is accepted and
+   ignored. 0, or -EINVAL with *bad set to the offending word index. */
+int netcap_filter_parse(int argc, char** argv, netcap_filter_t* f, int* bad);
+int netcap_filter_match(const netcap_filter_t* f, const uint8_t* frame, uint32_t len, int dir);
+
+/* Capture hook, a single flag test while idle */
+extern volatile int netcap_active;
+void netcap_capture(net_device_t* dev, const void* frame, uint32_t len, int dir);
+
+static inline void netcap_tap(net_device_t* dev, const void* frame, uint32_t len, int dir) {
+    if (netcap_active) netcap_capture(dev, frame, len, dir);
+}
+
+/* path is the pcap file for NETCAP_SINK_FILE. snaplen 0 and ring_bytes 0
+   pick the defaults. 0, or -EALREADY, -EINVAL, -ENOMEM, -ENODEV (no FAT
+   volume or no COM2), or a FAT writer error. */
+int  netcap_start(const netcap_filter_t* f, uint32_t snaplen, uint32_t ring_bytes,
+                  int sink, const char* path);
+
+/* Stop capturing and flush the sink. A ring-only capture stays in memory
+   for netcap_save() until the next start. */
+int  netcap_stop(void);
+
+/* Drain the ring into a new pcap file. Records written, or -errno. */
+int  netcap_save(const char* path);
+
+/* Drain to the file or serial sink (called from net_poll) */
+void netcap_poll(void);
+
+void netcap_print_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
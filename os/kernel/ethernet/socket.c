@@ -0,0 +1,508 @@
+#include "socket.h"
+#include "net.h"
+#include "net_device.h"
+#include "udp.h"
+#include "tcp.h"
+#include "eth.h"
+#include "../sched/wait.h"
+#include "../mm/kmalloc.h"
+#include "../string.h"
+#include "../terminal.h"
+#include <errno.h>
+
+extern void serial(const char *fmt, ...);
+
+/* Queued UDP datagram */
+typedef struct sock_dgram {
+    struct sock_dgram* next;
+    uint32_t src_ip;
+    uint16_t src_port;
+    uint16_t len;
+    uint8_t data[];
+} sock_dgram_t;
+
+typedef struct {
+    uint8_t used;
+    uint8_t type;                 /* SOCK_STREAM / SOCK_DGRAM */
+    uint8_t nonblock;
+    uint8_t connected;            /* UDP: default destination set */
+    uint32_t timeout_ms;          /* 0 = block forever */
+
+    uint32_t local_ip, remote_ip; /* Network byte order */
+    uint16_t local_port, remote_port;
+
+    wait_queue_t wq;
+
+    /* SOCK_STREAM */
+    tcp_tcb_t* tcb;
+
+    /* SOCK_DGRAM receive queue */
+    sock_dgram_t* rxq_head;
+    sock_dgram_t* rxq_tail;
+    int rxq_count;
+    uint32_t rx_drops;
+} socket_t;
+
+/* Single address space, so one descriptor table serves every caller */
+static socket_t sock_table[SOCK_MAX];
+
+static socket_t* sock_get(int fd) {
+    if (fd < 0 || fd >= SOCK_MAX || !sock_table[fd].used) return NULL;
+    return &sock_table[fd];
+}
+
+static int sock_alloc(int type) {
+    for (int i = 0; i < SOCK_MAX; i++) {
+        if (!sock_table[i].used) {
+            memset(&sock_table[i], 0, sizeof(socket_t));
+            sock_table[i].used = 1;
+            sock_table[i].type = type;
+            wait_queue_init(&sock_table[i].wq);
+            return i;
+        }
+    }
+    return -EMFILE;
+}
+
+/* Block until the socket's queue is woken.
+   0 = woken (retry the operation), -EAGAIN = non-blocking, -ETIMEDOUT */
+static int sock_wait(socket_t* s, int flags, uint32_t start) {
+    if (s->nonblock || (flags & MSG_DONTWAIT)) return -EAGAIN;
+
+    uint32_t left = WAIT_FOREVER;
+    if (s->timeout_ms) {
+        uint32_t elapsed = net_time_ms() - start;
+        if (elapsed >= s->timeout_ms) return -ETIMEDOUT;
+        left = s->timeout_ms - elapsed;
+    }
+    wait_sleep(&s->wq, left);
+    return 0;
+}
+
+static void sock_tcp_notify(tcp_tcb_t* tcb, void* user) {
+    (void)tcb;
+    wait_wake(&((socket_t*)user)->wq);
+}
+
+static void sock_udp_rx(void* user, uint32_t src_ip, uint16_t src_port, const uint8_t* data, size_t len) {
+    socket_t* s = (socket_t*)user;
+
+    if (s->connected && (src_ip != s->remote_ip || src_port != s->remote_port)) return;
+    if (s->rxq_count >= SOCK_DGRAM_QUEUE) {
+        s->rx_drops++;
+        return;
+    }
+
+    sock_dgram_t* d = (sock_dgram_t*)kmalloc(sizeof(sock_dgram_t) + len);
+    if (!d) {
+        s->rx_drops++;
+        return;
+    }
+    d->next = NULL;
+    d->src_ip = src_ip;
+    d->src_port = src_port;
+    d->len = len;
+    memcpy(d->data, data, len);
+
+    if (s->rxq_tail) s->rxq_tail->next = d;
+    else s->rxq_head = d;
+    s->rxq_tail = d;
+    s->rxq_count++;
+
+    wait_wake(&s->wq);
+}
+
+static int sock_udp_autobind(socket_t* s) {
+    if (s->local_port) return 0;
+    uint16_t port = udp_alloc_port();
+    if (!port) return -EADDRINUSE;
+    int r = udp_bind(port, sock_udp_rx, s);
+    if (r < 0) return r;
+    s->local_port = port;
+    return 0;
+}
+
+/* Bound stream sockets hold their port before they listen or connect */
+static int sock_tcp_port_taken(uint16_t port) {
+    if (tcp_port_in_use(port)) return 1;
+    for (int i = 0; i < SOCK_MAX; i++) {
+        socket_t* o = &sock_table[i];
+        if (o->used && o->type == SOCK_STREAM && o->local_port == port) return 1;
+    }
+    return 0;
+}
+
+/* -------------------------------------------------- */
+
+int sock_socket(int domain, int type, int protocol) {
+    (void)protocol;
+    if (domain != AF_INET) return -EINVAL;
+    if (type != SOCK_STREAM && type != SOCK_DGRAM) return -EINVAL;
+    return sock_alloc(type);
+}
+
+int sock_bind(int fd, const sockaddr_in_t* addr) {
+    socket_t* s = sock_get(fd);
+    if (!s) return -EBADF;
+    if (!addr || addr->sin_family != AF_INET) return -EINVAL;
+    if (s->local_port || s->tcb) return -EINVAL;
+
+    uint16_t port = ntohs(addr->sin_port);
+
+    if (s->type == SOCK_DGRAM) {
+        if (port == 0) port = udp_alloc_port();
+        if (port == 0) return -EADDRINUSE;
+        int r = udp_bind(port, sock_udp_rx, s);
+        if (r < 0) return r;
+    } else {
+        /* Ephemeral ports are only free of connections; skip bound ones */
+        for (int tries = 0; port == 0 && tries <= SOCK_MAX; tries++) {
+            uint16_t p = tcp_alloc_port();
+            if (!p) break;
+            if (!sock_tcp_port_taken(p)) port = p;
+        }
+        if (port == 0 || sock_tcp_port_taken(port)) return -EADDRINUSE;
+    }
+
+    s->local_ip = addr->sin_addr;
+    s->local_port = port;
+    return 0;
+}
+
+int sock_connect(int fd, const sockaddr_in_t* addr) {
+    socket_t* s = sock_get(fd);
+    if (!s) return -EBADF;
+    if (!addr || addr->sin_family != AF_INET) return -EINVAL;
+
+    if (s->type == SOCK_DGRAM) {
+        int r = sock_udp_autobind(s);
+        if (r < 0) return r;
+        s->remote_ip = addr->sin_addr;
+        s->remote_port = ntohs(addr->sin_port);
+        s->connected = 1;
+        return 0;
+    }
+
+    if (s->tcb) {
+        tcp_tcb_t* t = s->tcb;
+        if (t->state == TCP_LISTEN) return -EINVAL;
+        if (t->state == TCP_SYN_SENT) return -EINPROGRESS;
+        if (t->state != TCP_CLOSED) return -EISCONN;
+        /* A nonblocking connect that failed: report why, then start over */
+        int err = t->error ? t->error : -ECONNREFUSED;
+        tcp_abort(t);
+        s->tcb = NULL;
+        return err;
+    }
+
+    net_device_t* dev = net_route_device(addr->sin_addr);
+    if (!dev) return -ENETUNREACH;
+
+    tcp_tcb_t* tcb = tcp_connect(dev, addr->sin_addr, ntohs(addr->sin_port), s->local_port);
+    if (!tcb) return -EADDRINUSE;
+
+    tcp_set_notify(tcb, sock_tcp_notify, s);
+    s->tcb = tcb;
+    s->local_ip = tcb->local_ip;
+    s->local_port = tcb->local_port;
+    s->remote_ip = tcb->remote_ip;
+    s->remote_port = tcb->remote_port;
+
+    uint32_t start = net_time_ms();
+    while (tcb->state == TCP_SYN_SENT) {
+        int w = sock_wait(s, 0, start);
+        if (w == -EAGAIN) return -EINPROGRESS;
+        if (w < 0) {
+            tcp_abort(tcb);
+            s->tcb = NULL;
+            return w;
+        }
+    }
+
+    if (tcp_is_connected(tcb)) return 0;
+
+    int err = tcb->error ? tcb->error : -ECONNREFUSED;
+    tcp_abort(tcb);
+    s->tcb = NULL;
+    return err;
+}
+
+int sock_listen(int fd, int backlog) {
+    socket_t* s = sock_get(fd);
+    if (!s) return -EBADF;
+    if (s->type != SOCK_STREAM || !s->local_port || s->tcb) return -EINVAL;
+
+    /* Listeners accept on every interface; the device only seeds local_ip */
+    net_device_t* dev = s->local_ip ? net_route_device(s->local_ip) : net_get_primary_device();
+    if (!dev) dev = net_route_device(0x0100007F); /* No NIC: loopback only */
+    if (!dev) return -ENETUNREACH;
+
+    tcp_tcb_t* l = tcp_listen(dev, s->local_port, backlog);
+    if (!l) return -EADDRINUSE;
+
+    tcp_set_notify(l, sock_tcp_notify, s);
+    s->tcb = l;
+    return 0;
+}
+
+int sock_accept(int fd, sockaddr_in_t* addr) {
+    socket_t* s = sock_get(fd);
+    if (!s) return -EBADF;
+    if (!s->tcb || s->tcb->state != TCP_LISTEN) return -EINVAL;
+
+    uint32_t start = net_time_ms();
+    for (;;) {
+        tcp_tcb_t* c = tcp_accept(s->tcb);
+        if (c) {
+            int nfd = sock_alloc(SOCK_STREAM);
+            if (nfd < 0) {
+                tcp_abort(c);
+                return nfd;
+            }
+            socket_t* ns = &sock_table[nfd];
+            ns->tcb = c;
+            ns->local_ip = c->local_ip;
+            ns->local_port = c->local_port;
+            ns->remote_ip = c->remote_ip;
+            ns->remote_port = c->remote_port;
+            tcp_set_notify(c, sock_tcp_notify, ns);
+
+            if (addr) {
+                memset(addr, 0, sizeof(*addr));
+                addr->sin_family = AF_INET;
+                addr->sin_port = htons(c->remote_port);
+                addr->sin_addr = c->remote_ip;
+            }
+            return nfd;
+        }
+
+        int w = sock_wait(s, 0, start);
+        if (w < 0) return w;
+    }
+}
+
+int sock_sendto(int fd, const void* buf, size_t len, int flags, const sockaddr_in_t* to) {
+    socket_t* s = sock_get(fd);
+    if (!s) return -EBADF;
+
+    if (s->type == SOCK_STREAM) {
+        if (!s->tcb) return -ENOTCONN;
+
+        const uint8_t* p = (const uint8_t*)buf;
+        size_t done = 0;
+        uint32_t start = net_time_ms();
+        while (done < len) {
+            int n = tcp_write(s->tcb, p + done, len - done);
+            if (n > 0) {
+                done += n;
+                continue;
+            }
+            if (n != -EAGAIN) return done ? (int)done : n;
+
+            int w = sock_wait(s, flags, start);
+            if (w < 0) return done ? (int)done : w;
+        }
+        return (int)done;
+    }
+
+    uint32_t dst_ip;
+    uint16_t dst_port;
+    if (to) {
+        dst_ip = to->sin_addr;
+        dst_port = ntohs(to->sin_port);
+    } else if (s->connected) {
+        dst_ip = s->remote_ip;
+        dst_port = s->remote_port;
+    } else {
+        return -ENOTCONN;
+    }
+
+    if (len > 65507) return -EMSGSIZE;
+
+    net_device_t* dev = net_route_device(dst_ip);
+    if (!dev) return -ENETUNREACH;
+
+    int r = sock_udp_autobind(s);
+    if (r < 0) return r;
+
+    /* Non-zero means the next hop is not resolved yet (ARP in flight) */
+    if (udp_send(dev, dst_ip, s->local_port, dst_port, buf, len) != 0) return -EAGAIN;
+    return (int)len;
+}
+
+int sock_send(int fd, const void* buf, size_t len, int flags) {
+    return sock_sendto(fd, buf, len, flags, NULL);
+}
+
+int sock_recvfrom(int fd, void* buf, size_t len, int flags, sockaddr_in_t* from) {
+    socket_t* s = sock_get(fd);
+    if (!s) return -EBADF;
+
+    uint32_t start = net_time_ms();
+
+    if (s->type == SOCK_STREAM) {
+        if (!s->tcb) return -ENOTCONN;
+        for (;;) {
+            int n = tcp_read(s->tcb, buf, len);
+            if (n != -EAGAIN) {
+                if (n >= 0 && from) {
+                    memset(from, 0, sizeof(*from));
+                    from->sin_family = AF_INET;
+                    from->sin_port = htons(s->remote_port);
+                    from->sin_addr = s->remote_ip;
+                }
+                return n;
+            }
+            int w = sock_wait(s, flags, start);
+            if (w < 0) return w;
+        }
+    }
+
+    while (!s->rxq_head) {
+        if (!s->local_port) return -ENOTCONN;
+        int w = sock_wait(s, flags, start);
+        if (w < 0) return w;
+    }
+
+    sock_dgram_t* d = s->rxq_head;
+    s->rxq_head = d->next;
+    if (!s->rxq_head) s->rxq_tail = NULL;
+    s->rxq_count--;
+
+    size_t n = d->len < len ? d->len : len; /* Excess is discarded, as with BSD */
+    memcpy(buf, d->data, n);
+    if (from) {
+        memset(from, 0, sizeof(*from));
+        from->sin_family = AF_INET;
+        from->sin_port = htons(d->src_port);
+        from->sin_addr = d->src_ip;
+    }
+    kfree(d);
+    return (int)n;
+}
+
+int sock_recv(int fd, void* buf, size_t len, int flags) {
+    return sock_recvfrom(fd, buf, len, flags, NULL);
+}
+
+static short sock_revents(socket_t* s) {
+    short ev = 0;
+
+    if (s->type == SOCK_DGRAM) {
+        if (s->rxq_head) ev |= POLLIN;
+        ev |= POLLOUT;
+        return ev;
+    }
+
+    tcp_tcb_t* t = s->tcb;
+    if (!t) return POLLHUP;
+
+    if (t->state == TCP_LISTEN) {
+        for (tcp_tcb_t* c = t->accept_queue; c; c = c->accept_next)
+            if (c->state != TCP_SYN_RECEIVED) { ev |= POLLIN; break; }
+        return ev;
+    }
+
+    if (t->rcv_len || t->fin_received || t->state == TCP_CLOSED) ev |= POLLIN;
+    if (tcp_is_connected(t) && tcp_send_space(t) > 0) ev |= POLLOUT;
+    if (t->error) ev |= POLLERR;
+    if (t->state == TCP_CLOSED || t->fin_received) ev |= POLLHUP;
+    return ev;
+}
+
+int sock_poll(sock_pollfd_t* fds, int nfds, uint32_t timeout_ms) {
+    wait_queue_t* wqs[SOCK_MAX];
+    uint32_t start = net_time_ms();
+
+    for (;;) {
+        int ready = 0, nwq = 0;
+
+        for (int i = 0; i < nfds; i++) {
+            socket_t* s = sock_get(fds[i].fd);
+            if (!s) {
+                fds[i].revents = POLLERR;
+                ready++;
+                continue;
+            }
+            /* Errors and hangups are always reported */
+            fds[i].revents = sock_revents(s) & (fds[i].events | POLLERR | POLLHUP);
+            if (fds[i].revents) ready++;
+            if (nwq < SOCK_MAX) wqs[nwq++] = &s->wq;
+        }
+
+        if (ready || timeout_ms == 0) return ready;
+
+        uint32_t left = WAIT_FOREVER;
+        if (timeout_ms != WAIT_FOREVER) {
+            uint32_t elapsed = net_time_ms() - start;
+            if (elapsed >= timeout_ms) return 0;
+            left = timeout_ms - elapsed;
+        }
+        wait_sleep_any(wqs, nwq, left);
+    }
+}
+
+int sock_shutdown(int fd) {
+    socket_t* s = sock_get(fd);
+    if (!s) return -EBADF;
+    if (s->type != SOCK_STREAM || !s->tcb) return -ENOTCONN;
+    tcp_shutdown(s->tcb);
+    return 0;
+}
+
+int sock_close(int fd) {
+    socket_t* s = sock_get(fd);
+    if (!s) return -EBADF;
+
+    if (s->type == SOCK_STREAM) {
+        /* Graceful: the engine keeps the TCB until FIN/TIME_WAIT completes */
+        if (s->tcb) tcp_close(s->tcb);
+    } else {
+        if (s->local_port) udp_unbind(s->local_port);
+        sock_dgram_t* d = s->rxq_head;
+        while (d) {
+            sock_dgram_t* n = d->next;
+            kfree(d);
+            d = n;
+        }
+    }
+
+    wait_wake(&s->wq);
+    memset(s, 0, sizeof(socket_t));
+    return 0;
+}
+
+int sock_set_timeout(int fd, uint32_t ms) {
+    socket_t* s = sock_get(fd);
+    if (!s) return -EBADF;
+    s->timeout_ms = ms;
+    return 0;
+}
+
+int sock_set_nonblock(int fd, int on) {
+    socket_t* s = sock_get(fd);
+    if (!s) return -EBADF;
+    s->nonblock = on ? 1 : 0;
+    return 0;
+}
+
+void sock_print_table(void) {
+    terminal_writestring("Sockets:\n");
+    for (int i = 0; i < SOCK_MAX; i++) {
+        socket_t* s = &sock_table[i];
+        if (!s->used) continue;
+
+        uint32_t ip = s->remote_ip;
+        if (s->type == SOCK_DGRAM) {
+            terminal_printf("  %d  UDP  :%d -> %d.%d.%d.%d:%d  queued %d dropped %u\n",
+                i, s->local_port,
+                ip & 0xFF, (ip >> 8) & 0xFF, (ip >> 16) & 0xFF, (ip >> 24) & 0xFF,
+                s->remote_port, s->rxq_count, s->rx_drops);
+        } else {
+            terminal_printf("  %d  TCP  :%d -> %d.%d.%d.%d:%d  %s\n",
+                i, s->local_port,
+                ip & 0xFF, (ip >> 8) & 0xFF, (ip >> 16) & 0xFF, (ip >> 24) & 0xFF,
+                s->remote_port, s->tcb ? tcp_state_name(s->tcb->state) : "UNCONNECTED");
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* BSD-style sockets on top of the UDP/TCP stack.
+ * Calls block by sleeping on the socket's wait queue (see sched/wait.h);
+ * errors are returned as negative errno values.
+ */
+
+#define AF_INET      2
+#define SOCK_STREAM  1
+#define SOCK_DGRAM   2
+#define INADDR_ANY   0
+
+#define SOCK_MAX            32     /* Descriptor table size */
+#define SOCK_DGRAM_QUEUE    32     /* Datagrams buffered per UDP socket */
+
+/* sock_send/sock_recv flags */
+#define MSG_DONTWAIT 0x40
+
+/* sock_poll events */
+#define POLLIN   0x0001
+#define POLLOUT  0x0004
+#define POLLERR  0x0008
+#define POLLHUP  0x0010
+
+typedef struct {
+    uint16_t sin_family;
+    uint16_t sin_port;   /* Network byte order */
+    uint32_t sin_addr;   /* Network byte order */
+    uint8_t  sin_zero[8];
+} sockaddr_in_t;
+
+typedef struct {
+    int fd;
+    short events;
+    short revents;
+} sock_pollfd_t;
+
+int sock_socket(int domain, int type, int protocol);
+int sock_bind(int fd, const sockaddr_in_t* addr);
+int sock_connect(int fd, const sockaddr_in_t* addr);
+int sock_listen(int fd, int backlog);
+int sock_accept(int fd, sockaddr_in_t* addr);
+int sock_send(int fd, const void* buf, size_t len, int flags);
+int sock_recv(int fd, void* buf, size_t len, int flags);
+int sock_sendto(int fd, const void* buf, size_t len, int flags, const sockaddr_in_t* to);
+int sock_recvfrom(int fd, void* buf, size_t len, int flags, sockaddr_in_t* from);
+int sock_poll(sock_pollfd_t* fds, int nfds, uint32_t timeout_ms);
+int sock_shutdown(int fd);
+int sock_close(int fd);
+
+/* Options: blocking timeout for every call (0 = wait forever), O_NONBLOCK */
+int sock_set_timeout(int fd, uint32_t ms);
+int sock_set_nonblock(int fd, int on);
+
+void sock_print_table(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,17 +1,16 @@
 #include "tcp.h"
 #include "ipv4.h"
+#include "net.h"
 #include "../mm/kmalloc.h"
 #include "../string.h"
+#include "../terminal.h"
+#include "../crypto/prng.h"
 #include "eth.h"
+#include "checksum.h"
+#include <errno.h>
 
 extern void serial(const char *fmt, ...);
 
-static tcp_callback_t tcp_cb = 0;
-
-void tcp_set_callback(tcp_callback_t callback) {
-    tcp_cb = callback;
-}
-
 typedef struct {
     uint16_t src_port;
     uint16_t dst_port;
@@ -24,82 +23,1145 @@ typedef struct {
     uint16_t urgent_ptr;
 } __attribute__((packed)) tcp_header_t;
 
+/* Option kinds */
+#define TCP_OPT_END    0
+#define TCP_OPT_NOP    1
+#define TCP_OPT_MSS    2
+#define TCP_OPT_WSCALE 3
+
+/* Modular sequence number comparison */
+#define SEQ_LT(a, b)  ((int32_t)((a) - (b)) < 0)
+#define SEQ_LEQ(a, b) ((int32_t)((a) - (b)) <= 0)
+#define SEQ_GT(a, b)  ((int32_t)((a) - (b)) > 0)
+#define SEQ_GEQ(a, b) ((int32_t)((a) - (b)) >= 0)
+
+/* Deadline reached? (0 means "timer stopped") */
+#define TIMER_DUE(deadline, now) ((deadline) != 0 && (int32_t)((now) - (deadline)) >= 0)
+
+static tcp_tcb_t* tcb_hash[TCP_HASH_SIZE];
+static tcp_tcb_t* listeners = NULL;
+static uint16_t next_ephemeral = 49152;
+
 static uint16_t tcp_checksum(const void* data, size_t len, uint32_t src_ip, uint32_t dst_ip) {
-    uint32_t sum = 0;
-    const uint16_t* ptr = (const uint16_t*)data;
-    
-    /* Pseudo Header - Treat IPs as 16-bit words to match data summation */
-    const uint16_t* src = (const uint16_t*)&src_ip;
-    const uint16_t* dst = (const uint16_t*)&dst_ip;
-    
-    sum += src[0]; sum += src[1];
-    sum += dst[0]; sum += dst[1];
-    
-    sum += htons(IP_PROTO_TCP);
-    sum += htons(len);
-    
-    /* TCP Header + Data */
-    for (size_t i = 0; i < len / 2; i++) {
-        sum += ptr[i];
-    }
-    
-    if (len & 1) {
-        uint16_t word = 0;
-        memcpy(&word, (const uint8_t*)data + len - 1, 1);
-        sum += word;
-    }
-    
-    while (sum >> 16) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    }
-    
-    return ~sum;
+    return csum_fold(csum_partial(data, len, csum_tcpudp_nofold(src_ip, dst_ip, len, IP_PROTO_TCP, 0)));
 }
 
-void tcp_handle_packet(net_device_t* dev, uint32_t src_ip, const void* data, size_t len) {
-    (void)dev;
-    if (len < sizeof(tcp_header_t)) return;
-    
-    const tcp_header_t* hdr = (const tcp_header_t*)data;
-    
-    if (tcp_cb) {
-        size_t header_len = ((hdr->offset_reserved >> 4) * 4);
-        if (len < header_len) return;
-        
-        tcp_cb(src_ip, ntohs(hdr->src_port), ntohs(hdr->dst_port), hdr->flags, 
-               ntohl(hdr->seq), ntohl(hdr->ack), 
-               (const uint8_t*)data + header_len, len - header_len);
+/* -------------------------------------------------- */
+/* TCB table */
+
+static uint32_t tcb_hash_fn(uint32_t lip, uint16_t lport, uint32_t rip, uint16_t rport) {
+    uint32_t h = lip ^ rip ^ ((uint32_t)lport << 16 | rport);
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return h & (TCP_HASH_SIZE - 1);
+}
+
+static tcp_tcb_t* tcb_lookup(uint32_t lip, uint16_t lport, uint32_t rip, uint16_t rport) {
+    tcp_tcb_t* t = tcb_hash[tcb_hash_fn(lip, lport, rip, rport)];
+    for (; t; t = t->hnext) {
+        if (t->local_port == lport && t->remote_port == rport &&
+            t->remote_ip == rip && t->local_ip == lip)
+            return t;
+    }
+    return NULL;
+}
+
+static void tcb_hash_insert(tcp_tcb_t* t) {
+    uint32_t h = tcb_hash_fn(t->local_ip, t->local_port, t->remote_ip, t->remote_port);
+    t->hnext = tcb_hash[h];
+    tcb_hash[h] = t;
+}
+
+static void tcb_hash_remove(tcp_tcb_t* t) {
+    uint32_t h = tcb_hash_fn(t->local_ip, t->local_port, t->remote_ip, t->remote_port);
+    tcp_tcb_t** pp = &tcb_hash[h];
+    while (*pp) {
+        if (*pp == t) { *pp = t->hnext; return; }
+        pp = &(*pp)->hnext;
+    }
+}
+
+static tcp_tcb_t* listener_lookup(uint16_t port) {
+    for (tcp_tcb_t* l = listeners; l; l = l->hnext)
+        if (l->local_port == port) return l;
+    return NULL;
+}
+
+int tcp_port_in_use(uint16_t port) {
+    if (listener_lookup(port)) return 1;
+    for (int i = 0; i < TCP_HASH_SIZE; i++)
+        for (tcp_tcb_t* t = tcb_hash[i]; t; t = t->hnext)
+            if (t->local_port == port) return 1;
+    return 0;
+}
+
+uint16_t tcp_alloc_port(void) {
+    for (int tries = 0; tries < 16384; tries++) {
+        uint16_t p = next_ephemeral++;
+        if (next_ephemeral == 0 || next_ephemeral < 49152) next_ephemeral = 49152;
+        if (!tcp_port_in_use(p)) return p;
+    }
+    return 0;
+}
+
+static tcp_tcb_t* tcb_alloc(net_device_t* dev) {
+    tcp_tcb_t* t = (tcp_tcb_t*)kmalloc(sizeof(tcp_tcb_t));
+    if (!t) return NULL;
+    memset(t, 0, sizeof(tcp_tcb_t));
+
+    t->sndbuf = (uint8_t*)kmalloc(TCP_SNDBUF_SIZE);
+    t->rcvbuf = (uint8_t*)kmalloc(TCP_RCVBUF_SIZE);
+    if (!t->sndbuf || !t->rcvbuf) {
+        if (t->sndbuf) kfree(t->sndbuf);
+        if (t->rcvbuf) kfree(t->rcvbuf);
+        kfree(t);
+        return NULL;
+    }
+
+    t->dev = dev;
+    t->local_ip = dev->ip;
+    t->mss = TCP_DEFAULT_MSS;
+    t->rto = TCP_RTO_INIT_MS;
+    t->ssthresh = 0xFFFFFFFF;
+    t->rcv_wscale = TCP_RCV_WSCALE;
+    t->iss = prng_next() ^ (net_time_ms() * 250);
+    t->snd_una = t->snd_nxt = t->snd_max = t->iss;
+    return t;
+}
+
+static void tcb_free(tcp_tcb_t* t) {
+    tcp_ooo_seg_t* s = t->ooo;
+    while (s) {
+        tcp_ooo_seg_t* n = s->next;
+        kfree(s);
+        s = n;
     }
+    if (t->sndbuf) kfree(t->sndbuf);
+    if (t->rcvbuf) kfree(t->rcvbuf);
+    kfree(t);
 }
 
-int tcp_send_packet(net_device_t* dev, uint32_t dst_ip, uint16_t src_port, uint16_t dst_port, 
-                    uint32_t seq, uint32_t ack, uint8_t flags, 
-                    const void* data, size_t len) {
-    size_t total_len = sizeof(tcp_header_t) + len;
+static void tcb_notify(tcp_tcb_t* t) {
+    if (t->notify) t->notify(t, t->user);
+}
+
+/* Enter CLOSED: unhash, wake the owner, free if nobody holds it any more */
+static void tcb_closed(tcp_tcb_t* t, int error) {
+    if (t->state == TCP_LISTEN) {
+        tcp_tcb_t** pp = &listeners;
+        while (*pp) {
+            if (*pp == t) { *pp = t->hnext; break; }
+            pp = &(*pp)->hnext;
+        }
+    } else {
+        tcb_hash_remove(t);
+    }
+
+    t->state = TCP_CLOSED;
+    if (error) t->error = error;
+    t->rto_deadline = 0;
+    t->ack_pending = 0;
+
+    /* Embryonic child never handed to the user */
+    if (t->parent) {
+        tcp_tcb_t* p = t->parent;
+        tcp_tcb_t** pp = &p->accept_queue;
+        while (*pp) {
+            if (*pp == t) { *pp = t->accept_next; p->accept_count--; break; }
+            pp = &(*pp)->accept_next;
+        }
+        t->parent = NULL;
+        t->user_released = 1;
+    }
+
+    tcb_notify(t);
+    if (t->user_released) tcb_free(t);
+}
+
+/* -------------------------------------------------- */
+/* Ring buffers */
+
+static void ring_write(uint8_t* ring, uint32_t size, uint32_t pos, const uint8_t* src, uint32_t len) {
+    pos %= size;
+    uint32_t first = size - pos;
+    if (first > len) first = len;
+    memcpy(ring + pos, src, first);
+    if (len > first) memcpy(ring, src + first, len - first);
+}
+
+static void ring_read(const uint8_t* ring, uint32_t size, uint32_t pos, uint8_t* dst, uint32_t len) {
+    pos %= size;
+    uint32_t first = size - pos;
+    if (first > len) first = len;
+    memcpy(dst, ring + pos, first);
+    if (len > first) memcpy(dst + first, ring, len - first);
+}
+
+/* ring_read() that also returns the checksum of the copied bytes */
+static uint32_t ring_read_csum(const uint8_t* ring, uint32_t size, uint32_t pos, uint8_t* dst, uint32_t len) {
+    pos %= size;
+    uint32_t first = size - pos;
+    if (first > len) first = len;
+    uint32_t sum = csum_partial_copy(dst, ring + pos, first, 0);
+    if (len > first)
+        sum = csum_block_add(sum, csum_partial_copy(dst + first, ring, len - first, 0), first);
+    return sum;
+}
+
+/* -------------------------------------------------- */
+/* Output */
+
+static uint32_t rcv_space(const tcp_tcb_t* t) {
+    return TCP_RCVBUF_SIZE - t->rcv_len;
+}
+
+static uint16_t advertised_window(tcp_tcb_t* t, int syn) {
+    uint32_t win = rcv_space(t);
+    /* Window in SYN segments is never scaled (RFC 7323) */
+    if (!syn && t->wscale_ok) win >>= t->rcv_wscale;
+    if (win > 0xFFFF) win = 0xFFFF;
+    return (uint16_t)win;
+}
+
+/* MSS we advertise: what the interface can receive */
+static uint16_t tcp_local_mss(const tcp_tcb_t* t) {
+    uint32_t mtu = t->dev->mtu ? t->dev->mtu : NETDEV_MTU_DEFAULT;
+    return (uint16_t)(mtu > 65535 ? 65535 - TCP_HDR_OVERHEAD : mtu - TCP_HDR_OVERHEAD);
+}
+
+/* Ceiling for the send MSS: the path MTU, which DF segments must not exceed */
+static uint16_t tcp_path_mss(const tcp_tcb_t* t) {
+    uint32_t mtu = ipv4_path_mtu(t->dev, t->remote_ip);
+    return (uint16_t)(mtu > 65535 ? 65535 - TCP_HDR_OVERHEAD : mtu - TCP_HDR_OVERHEAD);
+}
+
+/* Build and transmit one segment. Data is gathered from the send ring. */
+static int tcp_xmit(tcp_tcb_t* t, uint32_t seq, uint8_t flags, uint32_t data_off, uint32_t len) {
+    uint8_t opts[8];
+    size_t opt_len = 0;
+
+    if (flags & TCP_FLAG_SYN) {
+        uint16_t mss = tcp_local_mss(t);
+        opts[0] = TCP_OPT_MSS; opts[1] = 4;
+        opts[2] = mss >> 8; opts[3] = mss & 0xFF;
+        opt_len = 4;
+        /* SYN-ACK carries window scale only if the peer offered it */
+        if (!(flags & TCP_FLAG_ACK) || t->wscale_ok) {
+            opts[4] = TCP_OPT_NOP;
+            opts[5] = TCP_OPT_WSCALE; opts[6] = 3; opts[7] = t->rcv_wscale;
+            opt_len = 8;
+        }
+    }
+
+    size_t hdr_len = sizeof(tcp_header_t) + opt_len;
+    size_t total_len = hdr_len + len;
     uint8_t* packet = (uint8_t*)kmalloc(total_len);
-    if (!packet) return -1;
-    
-    memset(packet, 0, total_len);
+    if (!packet) return -ENOMEM;
+
     tcp_header_t* hdr = (tcp_header_t*)packet;
-    
-    hdr->src_port = htons(src_port);
-    hdr->dst_port = htons(dst_port);
+    hdr->src_port = htons(t->local_port);
+    hdr->dst_port = htons(t->remote_port);
     hdr->seq = htonl(seq);
-    hdr->ack = htonl(ack);
-    hdr->offset_reserved = (sizeof(tcp_header_t) / 4) << 4;
+    hdr->ack = (flags & TCP_FLAG_ACK) ? htonl(t->rcv_nxt) : 0;
+    hdr->offset_reserved = (hdr_len / 4) << 4;
     hdr->flags = flags;
-    hdr->window = htons(8192);
+    uint16_t win = advertised_window(t, flags & TCP_FLAG_SYN);
+    hdr->window = htons(win);
     hdr->checksum = 0;
     hdr->urgent_ptr = 0;
-    
-    if (data && len > 0) {
-        memcpy(packet + sizeof(tcp_header_t), data, len);
-    }
-    
-    /* Checksum calculation */
-    hdr->checksum = tcp_checksum(packet, total_len, dev->ip, dst_ip);
-    
-    int ret = ipv4_send(dev, dst_ip, IP_PROTO_TCP, packet, total_len);
+
+    if (opt_len) memcpy(packet + sizeof(tcp_header_t), opts, opt_len);
+    /* Payload is checksummed while it is gathered from the send ring */
+    uint32_t sum = csum_tcpudp_nofold(t->local_ip, t->remote_ip, total_len, IP_PROTO_TCP, 0);
+    if (len) {
+        uint32_t data_sum = ring_read_csum(t->sndbuf, TCP_SNDBUF_SIZE, t->snd_head + data_off, packet + hdr_len, len);
+        sum = csum_block_add(sum, data_sum, hdr_len);
+    }
+    sum = csum_partial(packet, hdr_len, sum);
+    hdr->checksum = csum_fold(sum);
+
+    if (flags & TCP_FLAG_ACK) {
+        /* Any ACK-bearing segment satisfies a pending delayed ACK */
+        t->ack_pending = 0;
+        t->segs_unacked = 0;
+        uint32_t shift = (!(flags & TCP_FLAG_SYN) && t->wscale_ok) ? t->rcv_wscale : 0;
+        uint32_t adv = t->rcv_nxt + ((uint32_t)win << shift);
+        if (SEQ_GT(adv, t->rcv_adv)) t->rcv_adv = adv;
+    }
+
+    int ret = ipv4_send(t->dev, t->remote_ip, IP_PROTO_TCP, packet, total_len);
     kfree(packet);
+    t->bytes_out += len;
     return ret;
-}
\ No newline at end of file
+}
+
+static void tcp_send_ack(tcp_tcb_t* t) {
+    tcp_xmit(t, t->snd_nxt, TCP_FLAG_ACK, 0, 0);
+}
+
+/* RST for a segment that matches no connection (RFC 793 "reset generation") */
+static void tcp_send_reset(net_device_t* dev, uint32_t dst_ip, const tcp_header_t* in, size_t seg_len) {
+    tcp_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.src_port = in->dst_port;
+    hdr.dst_port = in->src_port;
+    hdr.offset_reserved = (sizeof(tcp_header_t) / 4) << 4;
+
+    if (in->flags & TCP_FLAG_ACK) {
+        hdr.seq = in->ack;
+        hdr.flags = TCP_FLAG_RST;
+    } else {
+        uint32_t ack = ntohl(in->seq) + seg_len;
+        if (in->flags & TCP_FLAG_SYN) ack++;
+        if (in->flags & TCP_FLAG_FIN) ack++;
+        hdr.ack = htonl(ack);
+        hdr.flags = TCP_FLAG_RST | TCP_FLAG_ACK;
+    }
+
+    hdr.checksum = tcp_checksum(&hdr, sizeof(hdr), dev->ip, dst_ip);
+    ipv4_send(dev, dst_ip, IP_PROTO_TCP, &hdr, sizeof(hdr));
+}
+
+static void rto_arm(tcp_tcb_t* t) {
+    t->rto_deadline = net_time_ms() + t->rto;
+    if (t->rto_deadline == 0) t->rto_deadline = 1;
+}
+
+/* Send as much queued data as the send and congestion windows allow */
+static void tcp_output(tcp_tcb_t* t) {
+    if (t->state != TCP_ESTABLISHED && t->state != TCP_CLOSE_WAIT &&
+        t->state != TCP_FIN_WAIT_1 && t->state != TCP_CLOSING &&
+        t->state != TCP_LAST_ACK)
+        return;
+
+    for (;;) {
+        uint32_t off = t->snd_nxt - t->snd_una;
+        if (t->fin_sent && SEQ_GT(t->snd_nxt, t->fin_seq)) break;
+        if (off >= t->snd_len) break;
+
+        uint32_t unsent = t->snd_len - off;
+        uint32_t win = t->snd_wnd < t->cwnd ? t->snd_wnd : t->cwnd;
+        uint32_t inflight = t->snd_nxt - t->snd_una;
+        if (inflight >= win) break;
+
+        uint32_t n = unsent;
+        if (n > t->mss) n = t->mss;
+        if (n > win - inflight) n = win - inflight;
+
+        /* Sender-side silly window avoidance: don't emit tiny segments
+           while earlier data is still in flight. */
+        if (n < t->mss && n < unsent && inflight > 0) break;
+
+        uint8_t flags = TCP_FLAG_ACK;
+        if (n == unsent) flags |= TCP_FLAG_PSH;
+
+        if (!t->rtt_timing) {
+            t->rtt_timing = 1;
+            t->rtt_seq = t->snd_nxt + n;
+            t->rtt_start = net_time_ms();
+        }
+
+        tcp_xmit(t, t->snd_nxt, flags, off, n);
+        t->snd_nxt += n;
+        if (SEQ_GT(t->snd_nxt, t->snd_max)) t->snd_max = t->snd_nxt;
+        if (!t->rto_deadline) rto_arm(t);
+    }
+
+    /* FIN goes out once every queued byte has been sent */
+    if (t->fin_pending && !t->fin_sent && (t->snd_nxt - t->snd_una) == t->snd_len) {
+        t->fin_seq = t->snd_nxt;
+        t->fin_sent = 1;
+        tcp_xmit(t, t->snd_nxt, TCP_FLAG_FIN | TCP_FLAG_ACK, 0, 0);
+        t->snd_nxt++;
+        if (SEQ_GT(t->snd_nxt, t->snd_max)) t->snd_max = t->snd_nxt;
+        if (!t->rto_deadline) rto_arm(t);
+
+        if (t->state == TCP_ESTABLISHED) t->state = TCP_FIN_WAIT_1;
+        else if (t->state == TCP_CLOSE_WAIT) t->state = TCP_LAST_ACK;
+    }
+
+    /* Peer closed its window: keep the timer running as a persist timer */
+    if (t->snd_wnd == 0 && t->snd_len > 0 && t->snd_nxt == t->snd_una && !t->rto_deadline)
+        rto_arm(t);
+}
+
+/* Resend the segment at snd_una (fast retransmit / partial ACK) */
+static void tcp_retransmit_head(tcp_tcb_t* t) {
+    uint32_t n = t->snd_len;
+    if (n > t->mss) n = t->mss;
+    if (n > 0) {
+        tcp_xmit(t, t->snd_una, TCP_FLAG_ACK, 0, n);
+    } else if (t->fin_sent) {
+        tcp_xmit(t, t->fin_seq, TCP_FLAG_FIN | TCP_FLAG_ACK, 0, 0);
+    }
+    t->retransmits++;
+    t->rtt_timing = 0; /* Karn: never time retransmitted data */
+}
+
+/* -------------------------------------------------- */
+/* Input helpers */
+
+static void parse_options(tcp_tcb_t* t, const uint8_t* opt, size_t len, int syn) {
+    int got_ws = 0;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t kind = opt[i];
+        if (kind == TCP_OPT_END) break;
+        if (kind == TCP_OPT_NOP) { i++; continue; }
+        if (i + 1 >= len) break;
+        uint8_t olen = opt[i + 1];
+        if (olen < 2 || i + olen > len) break;
+
+        if (syn && kind == TCP_OPT_MSS && olen == 4) {
+            uint16_t mss = (opt[i + 2] << 8) | opt[i + 3];
+            if (mss > tcp_path_mss(t)) mss = tcp_path_mss(t);
+            if (mss >= 64) t->mss = mss;
+        } else if (syn && kind == TCP_OPT_WSCALE && olen == 3) {
+            t->snd_wscale = opt[i + 2] > 14 ? 14 : opt[i + 2];
+            got_ws = 1;
+        }
+        i += olen;
+    }
+
+    if (syn) {
+        t->wscale_ok = got_ws;
+        if (!got_ws) { t->snd_wscale = 0; t->rcv_wscale = 0; }
+    }
+}
+
+static void rtt_sample(tcp_tcb_t* t, uint32_t r) {
+    if (r == 0) r = 1;
+    if (t->srtt == 0) {
+        t->srtt = r;
+        t->rttvar = r / 2;
+    } else {
+        uint32_t diff = t->srtt > r ? t->srtt - r : r - t->srtt;
+        t->rttvar = (3 * t->rttvar + diff) / 4;
+        t->srtt = (7 * t->srtt + r) / 8;
+    }
+    uint32_t rto = t->srtt + (4 * t->rttvar > 10 ? 4 * t->rttvar : 10);
+    if (rto < TCP_RTO_MIN_MS) rto = TCP_RTO_MIN_MS;
+    if (rto > TCP_RTO_MAX_MS) rto = TCP_RTO_MAX_MS;
+    t->rto = rto;
+}
+
+static void enter_established(tcp_tcb_t* t) {
+    t->state = TCP_ESTABLISHED;
+    t->cwnd = TCP_INIT_CWND * t->mss;
+    t->retries = 0;
+    t->rto_deadline = 0;
+}
+
+/* Process an acceptable ACK.
+   Returns 1 to continue, -1 to drop the segment, 0 if the TCB was freed. */
+static int tcp_process_ack(tcp_tcb_t* t, uint32_t seq, uint32_t ack, uint32_t wnd, size_t plen) {
+    if (SEQ_GT(ack, t->snd_max)) {
+        /* ACK for something we never sent */
+        tcp_send_ack(t);
+        return -1;
+    }
+
+    /* Window update (RFC 793 SND.WL1/WL2 rule) */
+    uint32_t scaled = wnd << t->snd_wscale;
+    int win_changed = scaled != t->snd_wnd;
+    if (SEQ_LT(t->snd_wl1, seq) || (t->snd_wl1 == seq && SEQ_LEQ(t->snd_wl2, ack))) {
+        t->snd_wnd = scaled;
+        t->snd_wl1 = seq;
+        t->snd_wl2 = ack;
+    }
+
+    if (SEQ_LEQ(ack, t->snd_una)) {
+        /* Duplicate ACK: same ack, no data, no window change, data outstanding */
+        if (ack == t->snd_una && plen == 0 && !win_changed && t->snd_max != t->snd_una) {
+            t->dupacks++;
+            if (t->dupacks == 3 && !t->in_recovery) {
+                uint32_t flight = t->snd_max - t->snd_una;
+                t->ssthresh = flight / 2 > 2u * t->mss ? flight / 2 : 2u * t->mss;
+                t->recover = t->snd_max;
+                t->cwnd = t->ssthresh + 3 * t->mss;
+                t->in_recovery = 1;
+                tcp_retransmit_head(t);
+            } else if (t->dupacks > 3 && t->in_recovery) {
+                t->cwnd += t->mss; /* Inflate for each segment that left the network */
+                tcp_output(t);
+            }
+        }
+        return 1;
+    }
+
+    /* New data acknowledged */
+    uint32_t acked = ack - t->snd_una;
+    int fin_acked = t->fin_sent && SEQ_GT(ack, t->fin_seq);
+    uint32_t data_acked = fin_acked ? acked - 1 : acked;
+    if (data_acked > t->snd_len) data_acked = t->snd_len;
+
+    t->snd_head = (t->snd_head + data_acked) % TCP_SNDBUF_SIZE;
+    t->snd_len -= data_acked;
+    t->snd_una = ack;
+    if (SEQ_LT(t->snd_nxt, ack)) t->snd_nxt = ack;
+
+    if (t->rtt_timing && SEQ_GEQ(ack, t->rtt_seq)) {
+        t->rtt_timing = 0;
+        rtt_sample(t, net_time_ms() - t->rtt_start);
+    }
+
+    /* Congestion control */
+    if (t->in_recovery) {
+        if (SEQ_GEQ(ack, t->recover)) {
+            t->cwnd = t->ssthresh;   /* Full ACK: leave fast recovery */
+            t->in_recovery = 0;
+        } else {
+            /* Partial ACK: retransmit next hole, deflate by amount acked */
+            tcp_retransmit_head(t);
+            t->cwnd = t->cwnd > acked ? t->cwnd - acked : 0;
+            t->cwnd += t->mss;
+        }
+    } else if (t->cwnd < t->ssthresh) {
+        t->cwnd += acked < t->mss ? acked : t->mss;                 /* Slow start */
+    } else {
+        uint32_t inc = (uint32_t)t->mss * t->mss / (t->cwnd ? t->cwnd : 1);
+        t->cwnd += inc ? inc : 1;                                   /* Congestion avoidance */
+    }
+    t->dupacks = 0;
+    t->retries = 0;
+
+    if (t->snd_una == t->snd_max) t->rto_deadline = 0;
+    else rto_arm(t);
+
+    if (fin_acked) {
+        if (t->state == TCP_FIN_WAIT_1) {
+            t->state = TCP_FIN_WAIT_2;
+            t->timewait_deadline = net_time_ms() + TCP_FIN_TIMEOUT_MS;
+        } else if (t->state == TCP_CLOSING) {
+            t->state = TCP_TIME_WAIT;
+            t->timewait_deadline = net_time_ms() + TCP_TIMEWAIT_MS;
+        } else if (t->state == TCP_LAST_ACK) {
+            tcb_closed(t, 0);
+            return 0;
+        }
+    }
+
+    if (data_acked) tcb_notify(t); /* Send space opened up */
+    return 1;
+}
+
+/* Move out-of-order segments that now line up into the receive buffer */
+static void ooo_drain(tcp_tcb_t* t) {
+    while (t->ooo && SEQ_LEQ(t->ooo->seq, t->rcv_nxt)) {
+        tcp_ooo_seg_t* s = t->ooo;
+        t->ooo = s->next;
+        t->ooo_count--;
+
+        uint32_t end = s->seq + s->len;
+        if (SEQ_GT(end, t->rcv_nxt)) {
+            uint32_t skip = t->rcv_nxt - s->seq;
+            uint32_t n = s->len - skip;
+            if (n > rcv_space(t)) n = rcv_space(t);
+            ring_write(t->rcvbuf, TCP_RCVBUF_SIZE, t->rcv_head + t->rcv_len, s->data + skip, n);
+            t->rcv_len += n;
+            t->rcv_nxt += n;
+            t->bytes_in += n;
+        }
+        if (s->fin && t->rcv_nxt == end) t->fin_received = 1;
+        kfree(s);
+    }
+}
+
+static void ooo_insert(tcp_tcb_t* t, uint32_t seq, const uint8_t* data, uint32_t len, int fin) {
+    /* Only hold data that fits in the window we advertised */
+    if (SEQ_GT(seq + len, t->rcv_nxt + rcv_space(t))) return;
+
+    tcp_ooo_seg_t** pp = &t->ooo;
+    while (*pp && SEQ_LT((*pp)->seq, seq)) pp = &(*pp)->next;
+    if (*pp && (*pp)->seq == seq && (*pp)->len >= len) return; /* Duplicate */
+    if (t->ooo_count >= TCP_MAX_OOO) return;
+
+    tcp_ooo_seg_t* s = (tcp_ooo_seg_t*)kmalloc(sizeof(tcp_ooo_seg_t) + len);
+    if (!s) return;
+    s->seq = seq;
+    s->len = len;
+    s->fin = fin;
+    memcpy(s->data, data, len);
+    s->next = *pp;
+    *pp = s;
+    t->ooo_count++;
+}
+
+/* Deliver segment payload. Returns 1 if an immediate ACK is required. */
+static int tcp_receive_data(tcp_tcb_t* t, uint32_t seq, const uint8_t* data, uint32_t len, int fin) {
+    /* Trim the part we already have */
+    if (SEQ_LT(seq, t->rcv_nxt)) {
+        uint32_t dup = t->rcv_nxt - seq;
+        if (dup >= len) {
+            /* Entirely old (retransmission): re-ACK so the peer moves on */
+            if (!(fin && dup == len)) return 1;
+            data += len; len = 0; seq = t->rcv_nxt;
+        } else {
+            data += dup; len -= dup; seq = t->rcv_nxt;
+        }
+    }
+
+    if (seq != t->rcv_nxt) {
+        /* Hole before this segment: queue it and send a duplicate ACK */
+        ooo_insert(t, seq, data, len, fin);
+        return 1;
+    }
+
+    uint32_t n = len;
+    if (n > rcv_space(t)) n = rcv_space(t);
+    if (n) {
+        ring_write(t->rcvbuf, TCP_RCVBUF_SIZE, t->rcv_head + t->rcv_len, data, n);
+        t->rcv_len += n;
+        t->rcv_nxt += n;
+        t->bytes_in += n;
+    }
+    if (fin && n == len) t->fin_received = 1;
+
+    int had_ooo = t->ooo != NULL;
+    ooo_drain(t);
+
+    /* ACK immediately when filling a hole, otherwise every 2nd segment */
+    if (had_ooo || n < len) return 1;
+    if (++t->segs_unacked >= 2) return 1;
+    if (!t->ack_pending) {
+        t->ack_pending = 1;
+        t->ack_deadline = net_time_ms() + TCP_DELACK_MS;
+    }
+    return 0;
+}
+
+static void tcp_handle_fin(tcp_tcb_t* t) {
+    t->rcv_nxt++;
+    switch (t->state) {
+        case TCP_SYN_RECEIVED:
+        case TCP_ESTABLISHED:
+            t->state = TCP_CLOSE_WAIT;
+            break;
+        case TCP_FIN_WAIT_1:
+            /* Our FIN not yet acked: simultaneous close */
+            t->state = TCP_CLOSING;
+            break;
+        case TCP_FIN_WAIT_2:
+            t->state = TCP_TIME_WAIT;
+            t->timewait_deadline = net_time_ms() + TCP_TIMEWAIT_MS;
+            break;
+        default:
+            break;
+    }
+    tcp_send_ack(t);
+}
+
+/* -------------------------------------------------- */
+/* Input */
+
+static void tcp_input_listen(tcp_tcb_t* l, net_device_t* dev, uint32_t src_ip, const tcp_header_t* hdr,
+                             const uint8_t* opts, size_t opt_len) {
+    if (l->accept_count >= l->backlog) return; /* Drop; peer retries SYN */
+
+    tcp_tcb_t* t = tcb_alloc(dev);
+    if (!t) return;
+
+    t->local_port = l->local_port;
+    t->remote_ip = src_ip;
+    t->remote_port = ntohs(hdr->src_port);
+    t->irs = ntohl(hdr->seq);
+    t->rcv_nxt = t->irs + 1;
+    t->rcv_adv = t->rcv_nxt;
+    t->snd_wnd = ntohs(hdr->window);
+    t->snd_wl1 = t->irs;
+    parse_options(t, opts, opt_len, 1);
+
+    t->state = TCP_SYN_RECEIVED;
+    t->parent = l;
+    t->accept_next = l->accept_queue;
+    l->accept_queue = t;
+    l->accept_count++;
+    tcb_hash_insert(t);
+
+    tcp_xmit(t, t->iss, TCP_FLAG_SYN | TCP_FLAG_ACK, 0, 0);
+    t->snd_nxt = t->snd_max = t->iss + 1;
+    rto_arm(t);
+}
+
+void tcp_handle_packet(net_device_t* dev, uint32_t src_ip, const void* data, size_t len) {
+    if (len < sizeof(tcp_header_t)) return;
+
+    const tcp_header_t* hdr = (const tcp_header_t*)data;
+    size_t header_len = ((hdr->offset_reserved >> 4) * 4);
+    if (header_len < sizeof(tcp_header_t) || len < header_len) return;
+    if (tcp_checksum(data, len, src_ip, dev->ip) != 0) return;
+
+    uint16_t sport = ntohs(hdr->src_port);
+    uint16_t dport = ntohs(hdr->dst_port);
+    uint32_t seq = ntohl(hdr->seq);
+    uint32_t ack = ntohl(hdr->ack);
+    uint8_t flags = hdr->flags;
+    const uint8_t* opts = (const uint8_t*)data + sizeof(tcp_header_t);
+    size_t opt_len = header_len - sizeof(tcp_header_t);
+    const uint8_t* payload = (const uint8_t*)data + header_len;
+    size_t plen = len - header_len;
+
+    tcp_tcb_t* t = tcb_lookup(dev->ip, dport, src_ip, sport);
+    if (!t) {
+        if ((flags & TCP_FLAG_SYN) && !(flags & TCP_FLAG_ACK)) {
+            tcp_tcb_t* l = listener_lookup(dport);
+            if (l) {
+                tcp_input_listen(l, dev, src_ip, hdr, opts, opt_len);
+                return;
+            }
+        }
+        if (!(flags & TCP_FLAG_RST)) tcp_send_reset(dev, src_ip, hdr, plen);
+        return;
+    }
+
+    if (t->state == TCP_SYN_SENT) {
+        if ((flags & TCP_FLAG_ACK) && ack != t->snd_nxt) {
+            if (!(flags & TCP_FLAG_RST)) tcp_send_reset(dev, src_ip, hdr, plen);
+            return;
+        }
+        if (flags & TCP_FLAG_RST) {
+            if (flags & TCP_FLAG_ACK) tcb_closed(t, -ECONNREFUSED);
+            return;
+        }
+        if (!(flags & TCP_FLAG_SYN)) return;
+
+        t->irs = seq;
+        t->rcv_nxt = seq + 1;
+        t->rcv_adv = t->rcv_nxt;
+        parse_options(t, opts, opt_len, 1);
+        t->snd_wnd = ntohs(hdr->window); /* Never scaled in SYN */
+        t->snd_wl1 = seq;
+        t->snd_wl2 = ack;
+
+        if (flags & TCP_FLAG_ACK) {
+            t->snd_una = ack;
+            if (t->rtt_timing) {
+                t->rtt_timing = 0;
+                rtt_sample(t, net_time_ms() - t->rtt_start);
+            }
+            enter_established(t);
+            tcp_send_ack(t);
+            tcb_notify(t);
+        } else {
+            /* Simultaneous open */
+            t->state = TCP_SYN_RECEIVED;
+            tcp_xmit(t, t->iss, TCP_FLAG_SYN | TCP_FLAG_ACK, 0, 0);
+        }
+        return;
+    }
+
+    /* Synchronized states: acceptability check (RFC 793 p.69, simplified) */
+    uint32_t wnd = rcv_space(t);
+    int acceptable;
+    if (plen == 0) {
+        acceptable = wnd == 0 ? seq == t->rcv_nxt
+                              : SEQ_GEQ(seq, t->rcv_nxt) && SEQ_LT(seq, t->rcv_nxt + wnd);
+        if (!acceptable && SEQ_LT(seq, t->rcv_nxt)) acceptable = 1; /* Pure (dup) ACK */
+    } else {
+        acceptable = SEQ_LT(seq, t->rcv_nxt + (wnd ? wnd : 1)) &&
+                     SEQ_GT(seq + plen, t->rcv_nxt);
+        if (!acceptable && SEQ_LEQ(seq + plen, t->rcv_nxt)) {
+            /* Old retransmission: ACK it, nothing else */
+            tcp_send_ack(t);
+            return;
+        }
+    }
+
+    if (flags & TCP_FLAG_RST) {
+        if (seq == t->rcv_nxt || (acceptable && wnd)) {
+            if (t->state == TCP_SYN_RECEIVED && t->parent) tcb_closed(t, 0);
+            else tcb_closed(t, -ECONNRESET);
+        }
+        return;
+    }
+
+    if (!acceptable) {
+        tcp_send_ack(t);
+        return;
+    }
+
+    if (flags & TCP_FLAG_SYN) {
+        /* SYN in a synchronized state: challenge ACK (RFC 5961) */
+        tcp_send_ack(t);
+        return;
+    }
+
+    if (!(flags & TCP_FLAG_ACK)) return;
+
+    if (t->state == TCP_SYN_RECEIVED) {
+        if (SEQ_LEQ(ack, t->snd_una) || SEQ_GT(ack, t->snd_max)) {
+            tcp_send_reset(dev, src_ip, hdr, plen);
+            return;
+        }
+        t->snd_una = ack;
+        t->snd_wnd = (uint32_t)ntohs(hdr->window) << t->snd_wscale;
+        t->snd_wl1 = seq;
+        t->snd_wl2 = ack;
+        enter_established(t);
+        if (t->parent) tcb_notify(t->parent); /* Ready for accept() */
+        else tcb_notify(t);
+    } else if (t->state == TCP_TIME_WAIT) {
+        /* Retransmitted FIN: re-ACK and restart 2MSL */
+        if (flags & TCP_FLAG_FIN) {
+            tcp_send_ack(t);
+            t->timewait_deadline = net_time_ms() + TCP_TIMEWAIT_MS;
+        }
+        return;
+    } else {
+        if (tcp_process_ack(t, seq, ack, ntohs(hdr->window), plen) <= 0) return;
+    }
+
+    /* Segment text and FIN */
+    int fin = (flags & TCP_FLAG_FIN) != 0;
+    if ((plen > 0 || fin) &&
+        (t->state == TCP_ESTABLISHED || t->state == TCP_FIN_WAIT_1 || t->state == TCP_FIN_WAIT_2)) {
+        int was_fin = t->fin_received;
+        uint32_t before = t->rcv_len;
+        int ack_now = tcp_receive_data(t, seq, payload, plen, fin);
+
+        if (t->fin_received && !was_fin) {
+            tcp_handle_fin(t);
+            ack_now = 0;
+        }
+        if (ack_now) tcp_send_ack(t);
+        if (t->rcv_len != before || t->fin_received != was_fin) tcb_notify(t);
+    } else if (fin) {
+        /* Retransmitted FIN after we already moved on: our ACK was lost */
+        tcp_send_ack(t);
+    }
+
+    tcp_output(t);
+}
+
+/* -------------------------------------------------- */
+/* Timers */
+
+static void tcp_timer_one(tcp_tcb_t* t, uint32_t now) {
+    if (t->state == TCP_TIME_WAIT) {
+        if (TIMER_DUE(t->timewait_deadline, now)) tcb_closed(t, 0);
+        return;
+    }
+
+    /* Nobody reads an orphan, and a peer that never sends its FIN would
+       keep it (and its buffers) forever */
+    if (t->state == TCP_FIN_WAIT_2 && t->user_released && TIMER_DUE(t->timewait_deadline, now)) {
+        tcp_xmit(t, t->snd_nxt, TCP_FLAG_RST | TCP_FLAG_ACK, 0, 0);
+        tcb_closed(t, 0);
+        return;
+    }
+
+    if (t->ack_pending && TIMER_DUE(t->ack_deadline, now)) tcp_send_ack(t);
+
+    if (!TIMER_DUE(t->rto_deadline, now)) return;
+
+    if (t->snd_wnd == 0 && t->snd_len > 0 && t->snd_nxt == t->snd_una &&
+        (t->state == TCP_ESTABLISHED || t->state == TCP_CLOSE_WAIT)) {
+        /* Zero window probe: one byte past the closed window, not counted
+           as a retry since the peer is alive and ACKing */
+        tcp_xmit(t, t->snd_nxt, TCP_FLAG_ACK, 0, 1);
+        if (SEQ_LT(t->snd_max, t->snd_una + 1)) t->snd_max = t->snd_una + 1;
+        t->rto = t->rto * 2 > TCP_RTO_MAX_MS ? TCP_RTO_MAX_MS : t->rto * 2;
+        rto_arm(t);
+        return;
+    }
+
+    if (++t->retries > TCP_MAX_RETRIES) {
+        serial("[TCP] Connection %d -> %d timed out\n", t->local_port, t->remote_port);
+        tcp_xmit(t, t->snd_nxt, TCP_FLAG_RST | TCP_FLAG_ACK, 0, 0);
+        tcb_closed(t, -ETIMEDOUT);
+        return;
+    }
+
+    /* Exponential backoff */
+    t->rto *= 2;
+    if (t->rto > TCP_RTO_MAX_MS) t->rto = TCP_RTO_MAX_MS;
+    t->rtt_timing = 0;
+    t->retransmits++;
+
+    if (t->state == TCP_SYN_SENT) {
+        tcp_xmit(t, t->iss, TCP_FLAG_SYN, 0, 0);
+        rto_arm(t);
+        return;
+    }
+    if (t->state == TCP_SYN_RECEIVED) {
+        tcp_xmit(t, t->iss, TCP_FLAG_SYN | TCP_FLAG_ACK, 0, 0);
+        rto_arm(t);
+        return;
+    }
+
+    /* RTO loss: collapse cwnd and go back to snd_una */
+    uint32_t flight = t->snd_max - t->snd_una;
+    t->ssthresh = flight / 2 > 2u * t->mss ? flight / 2 : 2u * t->mss;
+    t->cwnd = t->mss;
+    t->in_recovery = 0;
+    t->dupacks = 0;
+    t->snd_nxt = t->snd_una;
+    if (t->fin_sent && SEQ_LEQ(t->snd_nxt, t->fin_seq)) t->fin_sent = 0;
+    t->rto_deadline = 0;
+    tcp_output(t);
+    if (!t->rto_deadline) rto_arm(t);
+}
+
+void tcp_pmtu_changed(uint32_t dst_ip, uint32_t mtu) {
+    uint16_t mss = (uint16_t)(mtu - TCP_HDR_OVERHEAD);
+    for (int i = 0; i < TCP_HASH_SIZE; i++) {
+        for (tcp_tcb_t* t = tcb_hash[i]; t; t = t->hnext) {
+            if (t->remote_ip != dst_ip || t->mss <= mss) continue;
+            t->mss = mss;
+            if (t->state < TCP_ESTABLISHED || t->snd_nxt == t->snd_una) continue;
+
+            /* Everything in flight was too big and dropped by the router:
+               resend at the new size. Not congestion, so cwnd is kept. */
+            t->snd_nxt = t->snd_una;
+            if (t->fin_sent && SEQ_LEQ(t->snd_nxt, t->fin_seq)) t->fin_sent = 0;
+            t->rtt_timing = 0;
+            tcp_output(t);
+        }
+    }
+}
+
+void tcp_timer_poll(void) {
+    uint32_t now = net_time_ms();
+    for (int i = 0; i < TCP_HASH_SIZE; i++) {
+        tcp_tcb_t* t = tcb_hash[i];
+        while (t) {
+            tcp_tcb_t* next = t->hnext; /* t may be freed */
+            tcp_timer_one(t, now);
+            t = next;
+        }
+    }
+}
+
+/* -------------------------------------------------- */
+/* User API */
+
+tcp_tcb_t* tcp_connect(net_device_t* dev, uint32_t dst_ip, uint16_t dst_port, uint16_t src_port) {
+    if (!dev) return NULL;
+    if (src_port == 0) src_port = tcp_alloc_port();
+    if (src_port == 0) return NULL;
+
+    tcp_tcb_t* t = tcb_alloc(dev);
+    if (!t) return NULL;
+
+    t->local_port = src_port;
+    t->remote_ip = dst_ip;
+    t->remote_port = dst_port;
+    t->state = TCP_SYN_SENT;
+    tcb_hash_insert(t);
+
+    t->rtt_timing = 1;
+    t->rtt_seq = t->iss + 1;
+    t->rtt_start = net_time_ms();
+    tcp_xmit(t, t->iss, TCP_FLAG_SYN, 0, 0);
+    t->snd_nxt = t->snd_max = t->iss + 1;
+    rto_arm(t);
+    return t;
+}
+
+tcp_tcb_t* tcp_listen(net_device_t* dev, uint16_t port, int backlog) {
+    if (!dev || port == 0 || listener_lookup(port)) return NULL;
+
+    tcp_tcb_t* t = (tcp_tcb_t*)kmalloc(sizeof(tcp_tcb_t));
+    if (!t) return NULL;
+    memset(t, 0, sizeof(tcp_tcb_t));
+
+    t->dev = dev;
+    t->local_ip = dev->ip;
+    t->local_port = port;
+    t->state = TCP_LISTEN;
+    t->backlog = backlog > 0 ? backlog : 8;
+    t->hnext = listeners;
+    listeners = t;
+    return t;
+}
+
+tcp_tcb_t* tcp_accept(tcp_tcb_t* l) {
+    if (!l || l->state != TCP_LISTEN) return NULL;
+
+    /* Oldest established child first (queue is LIFO on insert) */
+    tcp_tcb_t** found = NULL;
+    for (tcp_tcb_t** pp = &l->accept_queue; *pp; pp = &(*pp)->accept_next) {
+        if ((*pp)->state != TCP_SYN_RECEIVED) found = pp;
+    }
+    if (!found) return NULL;
+
+    tcp_tcb_t* c = *found;
+    *found = c->accept_next;
+    l->accept_count--;
+    c->accept_next = NULL;
+    c->parent = NULL;
+    return c;
+}
+
+static int tcp_write_check(const tcp_tcb_t* t) {
+    if (!t) return -EBADF;
+    if (t->error) return t->error;
+    if (t->fin_pending) return -EPIPE;
+    if (t->state == TCP_SYN_SENT || t->state == TCP_SYN_RECEIVED) return -EAGAIN;
+    if (t->state != TCP_ESTABLISHED && t->state != TCP_CLOSE_WAIT) return -ENOTCONN;
+    return 0;
+}
+
+int tcp_write(tcp_tcb_t* t, const void* data, size_t len) {
+    int err = tcp_write_check(t);
+    if (err) return err;
+
+    uint32_t space = TCP_SNDBUF_SIZE - t->snd_len;
+    if (space == 0) return -EAGAIN;
+    if (len > space) len = space;
+
+    ring_write(t->sndbuf, TCP_SNDBUF_SIZE, t->snd_head + t->snd_len, (const uint8_t*)data, len);
+    t->snd_len += len;
+    tcp_output(t);
+    return (int)len;
+}
+
+int tcp_write_reserve(tcp_tcb_t* t, uint8_t** out) {
+    int err = tcp_write_check(t);
+    if (err) return err;
+
+    uint32_t space = TCP_SNDBUF_SIZE - t->snd_len;
+    if (space == 0) return -EAGAIN;
+
+    /* Free run from the tail up to the end of the ring */
+    uint32_t tail = (t->snd_head + t->snd_len) % TCP_SNDBUF_SIZE;
+    uint32_t run = TCP_SNDBUF_SIZE - tail;
+    if (run > space) run = space;
+    *out = t->sndbuf + tail;
+    return (int)run;
+}
+
+int tcp_write_commit(tcp_tcb_t* t, size_t len) {
+    int err = tcp_write_check(t);
+    if (err) return err;
+    if (len > TCP_SNDBUF_SIZE - t->snd_len) return -EINVAL;
+
+    t->snd_len += len;
+    tcp_output(t);
+    return (int)len;
+}
+
+int tcp_read(tcp_tcb_t* t, void* buf, size_t len) {
+    if (!t) return -EBADF;
+    if (t->rcv_len == 0) {
+        if (t->fin_received) return 0;
+        if (t->error) return t->error;
+        if (t->state == TCP_CLOSED) return 0;
+        return -EAGAIN;
+    }
+
+    uint32_t n = len < t->rcv_len ? len : t->rcv_len;
+    ring_read(t->rcvbuf, TCP_RCVBUF_SIZE, t->rcv_head, (uint8_t*)buf, n);
+    t->rcv_head = (t->rcv_head + n) % TCP_RCVBUF_SIZE;
+    t->rcv_len -= n;
+
+    /* Window update once the usable window grew noticeably (RFC 1122 SWS avoidance) */
+    if (t->state == TCP_ESTABLISHED || t->state == TCP_FIN_WAIT_1 || t->state == TCP_FIN_WAIT_2) {
+        uint32_t right = t->rcv_nxt + rcv_space(t);
+        uint32_t grow = right - t->rcv_adv;
+        if (SEQ_GT(right, t->rcv_adv) && (grow >= 2u * t->mss || grow >= TCP_RCVBUF_SIZE / 2))
+            tcp_send_ack(t);
+    }
+    return (int)n;
+}
+
+void tcp_shutdown(tcp_tcb_t* t) {
+    if (!t || t->fin_pending) return;
+    if (t->state == TCP_SYN_SENT || t->state == TCP_LISTEN) {
+        tcb_closed(t, 0);
+        return;
+    }
+    t->fin_pending = 1;
+    tcp_output(t);
+}
+
+void tcp_close(tcp_tcb_t* t) {
+    if (!t) return;
+    t->notify = NULL;
+    t->user = NULL;
+
+    if (t->state == TCP_LISTEN) {
+        /* Reset every connection still waiting in the accept queue */
+        while (t->accept_queue) {
+            tcp_tcb_t* c = t->accept_queue;
+            t->accept_queue = c->accept_next;
+            c->parent = NULL;
+            c->user_released = 1;
+            tcp_xmit(c, c->snd_nxt, TCP_FLAG_RST | TCP_FLAG_ACK, 0, 0);
+            tcb_closed(c, 0);
+        }
+        t->user_released = 1;
+        tcb_closed(t, 0);
+        return;
+    }
+
+    t->user_released = 1;
+    if (t->state == TCP_CLOSED) {
+        tcb_free(t);
+        return;
+    }
+    if (t->state == TCP_SYN_SENT) {
+        tcb_closed(t, 0);
+        return;
+    }
+    /* Half closed earlier: the orphan timeout runs from now */
+    if (t->state == TCP_FIN_WAIT_2) t->timewait_deadline = net_time_ms() + TCP_FIN_TIMEOUT_MS;
+    tcp_shutdown(t);
+}
+
+void tcp_abort(tcp_tcb_t* t) {
+    if (!t) return;
+    t->notify = NULL;
+    t->user_released = 1;
+    if (t->state == TCP_CLOSED) {
+        tcb_free(t);
+        return;
+    }
+    if (t->state != TCP_SYN_SENT && t->state != TCP_LISTEN)
+        tcp_xmit(t, t->snd_nxt, TCP_FLAG_RST | TCP_FLAG_ACK, 0, 0);
+    tcb_closed(t, 0);
+}
+
+void tcp_set_notify(tcp_tcb_t* t, tcp_notify_t fn, void* user) {
+    if (!t) return;
+    t->notify = fn;
+    t->user = user;
+}
+
+int tcp_is_connected(const tcp_tcb_t* t) {
+    return t && (t->state == TCP_ESTABLISHED || t->state == TCP_CLOSE_WAIT);
+}
+
+int tcp_send_space(const tcp_tcb_t* t) {
+    return t ? (int)(TCP_SNDBUF_SIZE - t->snd_len) : 0;
+}
+
+int tcp_recv_avail(const tcp_tcb_t* t) {
+    return t ? (int)t->rcv_len : 0;
+}
+
+const char* tcp_state_name(tcp_state_t s) {
+    static const char* names[] = {
+        "CLOSED", "LISTEN", "SYN_SENT", "SYN_RECEIVED", "ESTABLISHED",
+        "FIN_WAIT_1", "FIN_WAIT_2", "CLOSE_WAIT", "CLOSING", "LAST_ACK", "TIME_WAIT"
+    };
+    return (unsigned)s < sizeof(names) / sizeof(names[0]) ? names[s] : "?";
+}
+
+void tcp_print_connections(void) {
+    terminal_writestring("TCP Connections:\n");
+    for (tcp_tcb_t* l = listeners; l; l = l->hnext)
+        terminal_printf("  *:%d  LISTEN  backlog %d/%d\n", l->local_port, l->accept_count, l->backlog);
+
+    for (int i = 0; i < TCP_HASH_SIZE; i++) {
+        for (tcp_tcb_t* t = tcb_hash[i]; t; t = t->hnext) {
+            uint32_t ip = t->remote_ip;
+            terminal_printf("  :%d -> %d.%d.%d.%d:%d  %s  cwnd %u rto %u ms  in %u out %u retx %u\n",
+                t->local_port,
+                ip & 0xFF, (ip >> 8) & 0xFF, (ip >> 16) & 0xFF, (ip >> 24) & 0xFF,
+                t->remote_port, tcp_state_name(t->state),
+                t->cwnd, t->rto, t->bytes_in, t->bytes_out, t->retransmits);
+        }
+    }
+}
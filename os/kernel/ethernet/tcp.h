@@ -13,14 +13,158 @@ extern "C" {
 #define TCP_FLAG_ACK 0x10
 #define TCP_FLAG_URG 0x20
 
+/* Tunables */
+#ifndef TCP_SNDBUF_SIZE
+#define TCP_SNDBUF_SIZE (64 * 1024)
+#endif
+#ifndef TCP_RCVBUF_SIZE
+#define TCP_RCVBUF_SIZE (128 * 1024)
+#endif
+#define TCP_RCV_WSCALE   2      /* 65535 << 2 covers TCP_RCVBUF_SIZE */
+#define TCP_DEFAULT_MSS  536    /* RFC 1122 default when peer sends no MSS */
+#define TCP_HDR_OVERHEAD 40     /* IPv4 + TCP headers: MSS = MTU - 40 */
+#define TCP_INIT_CWND    10     /* Segments (RFC 6928) */
+#define TCP_RTO_INIT_MS  1000
+#define TCP_RTO_MIN_MS   200
+#define TCP_RTO_MAX_MS   60000
+#define TCP_DELACK_MS    40
+#define TCP_TIMEWAIT_MS  4000
+#define TCP_FIN_TIMEOUT_MS 60000 /* Released FIN_WAIT_2: wait this long for the peer's FIN */
+#define TCP_MAX_RETRIES  8
+#define TCP_MAX_OOO      32     /* Out-of-order segments held per connection */
+#define TCP_HASH_SIZE    64
+
+typedef enum {
+    TCP_CLOSED = 0,
+    TCP_LISTEN,
+    TCP_SYN_SENT,
+    TCP_SYN_RECEIVED,
+    TCP_ESTABLISHED,
+    TCP_FIN_WAIT_1,
+    TCP_FIN_WAIT_2,
+    TCP_CLOSE_WAIT,
+    TCP_CLOSING,
+    TCP_LAST_ACK,
+    TCP_TIME_WAIT
+} tcp_state_t;
+
+/* Out-of-order segment waiting for the hole before it to be filled */
+typedef struct tcp_ooo_seg {
+    struct tcp_ooo_seg* next;
+    uint32_t seq;
+    uint32_t len;
+    uint8_t fin;
+    uint8_t data[];
+} tcp_ooo_seg_t;
+
+struct tcp_tcb;
+/* Called whenever the connection becomes readable/writable or changes state.
+   Runs from the RX/timer path: it may wake waiters but must not close the TCB. */
+typedef void (*tcp_notify_t)(struct tcp_tcb* tcb, void* user);
+
+/* Transmission Control Block (one per connection, hashed by 4-tuple) */
+typedef struct tcp_tcb {
+    struct tcp_tcb* hnext;
+    net_device_t* dev;
+    uint32_t local_ip, remote_ip;     /* Network byte order */
+    uint16_t local_port, remote_port; /* Host byte order */
+    tcp_state_t state;
+    int error;                        /* -ECONNRESET, -ETIMEDOUT, ... */
+
+    /* Send sequence space */
+    uint32_t iss, snd_una, snd_nxt, snd_max;
+    uint32_t snd_wnd, snd_wl1, snd_wl2;
+    uint8_t  snd_wscale;
+    uint16_t mss;                     /* Effective send MSS */
+
+    /* Send buffer: ring of bytes starting at snd_una */
+    uint8_t* sndbuf;
+    uint32_t snd_head, snd_len;
+
+    /* Receive sequence space */
+    uint32_t irs, rcv_nxt, rcv_adv;
+    uint8_t  rcv_wscale;
+    uint8_t  wscale_ok;
+
+    /* Receive buffer: in-order bytes not yet read by the user */
+    uint8_t* rcvbuf;
+    uint32_t rcv_head, rcv_len;
+    tcp_ooo_seg_t* ooo;
+    int ooo_count;
+    uint8_t  fin_received;
+
+    /* FIN handling */
+    uint8_t  fin_pending;             /* User closed, FIN queued after data */
+    uint8_t  fin_sent;
+    uint32_t fin_seq;
+
+    /* RTT estimation (RFC 6298), all in ms */
+    uint32_t srtt, rttvar, rto;
+    uint8_t  rtt_timing;
+    uint32_t rtt_seq, rtt_start;
+    uint32_t rto_deadline;            /* 0 = timer stopped */
+    int retries;
+
+    /* Delayed ACK */
+    uint8_t  ack_pending;
+    uint8_t  segs_unacked;
+    uint32_t ack_deadline;
+
+    /* NewReno congestion control (RFC 6582) */
+    uint32_t cwnd, ssthresh, recover;
+    int dupacks;
+    uint8_t in_recovery;
+
+    uint32_t timewait_deadline;       /* TIME_WAIT end; FIN_WAIT_2 give-up once released */
+
+    /* Listening sockets: queue of established children awaiting accept */
+    struct tcp_tcb* parent;
+    struct tcp_tcb* accept_next;
+    struct tcp_tcb* accept_queue;
+    int backlog, accept_count;
+
+    uint8_t user_released;            /* Owner called tcp_close(), free when done */
+    tcp_notify_t notify;
+    void* user;
+
+    /* Statistics */
+    uint32_t bytes_in, bytes_out, retransmits;
+} tcp_tcb_t;
+
+/* Input from IPv4 */
 void tcp_handle_packet(net_device_t* dev, uint32_t src_ip, const void* data, size_t len);
-int tcp_send_packet(net_device_t* dev, uint32_t dst_ip, uint16_t src_port, uint16_t dst_port, 
-                    uint32_t seq, uint32_t ack, uint8_t flags, 
-                    const void* data, size_t len);
 
-typedef void (*tcp_callback_t)(uint32_t src_ip, uint16_t src_port, uint16_t dst_port, uint8_t flags, uint32_t seq, uint32_t ack, const uint8_t* data, size_t len);
-void tcp_set_callback(tcp_callback_t callback);
+/* Path MTU to dst dropped (ICMP fragmentation needed): shrink the MSS of
+   every connection to it and resend what was lost */
+void tcp_pmtu_changed(uint32_t dst_ip, uint32_t mtu);
+
+/* Timers: retransmission, delayed ACK, TIME_WAIT (called from net_poll) */
+void tcp_timer_poll(void);
+
+/* Connection API (non-blocking; negative errno on failure) */
+tcp_tcb_t* tcp_connect(net_device_t* dev, uint32_t dst_ip, uint16_t dst_port, uint16_t src_port);
+tcp_tcb_t* tcp_listen(net_device_t* dev, uint16_t port, int backlog);
+tcp_tcb_t* tcp_accept(tcp_tcb_t* listener);
+int  tcp_write(tcp_tcb_t* tcb, const void* data, size_t len);   /* Bytes queued, -EAGAIN if full */
+int  tcp_read(tcp_tcb_t* tcb, void* buf, size_t len);           /* Bytes read, 0 on EOF, -EAGAIN */
+/* Zero-copy send: *out points at the contiguous free space at the tail of
+   the send ring. Fill it directly (e.g. DMA from disk), then commit. */
+int  tcp_write_reserve(tcp_tcb_t* tcb, uint8_t** out);          /* Bytes available, -EAGAIN if full */
+int  tcp_write_commit(tcp_tcb_t* tcb, size_t len);              /* Queue len reserved bytes */
+void tcp_shutdown(tcp_tcb_t* tcb);                              /* Send FIN after queued data */
+void tcp_close(tcp_tcb_t* tcb);                                 /* Shutdown + release */
+void tcp_abort(tcp_tcb_t* tcb);                                 /* Send RST + release */
+void tcp_set_notify(tcp_tcb_t* tcb, tcp_notify_t fn, void* user);
+
+int  tcp_is_connected(const tcp_tcb_t* tcb);
+int  tcp_send_space(const tcp_tcb_t* tcb);
+int  tcp_recv_avail(const tcp_tcb_t* tcb);
+uint16_t tcp_alloc_port(void);
+int  tcp_port_in_use(uint16_t port);                            /* Listener or connection on it */
+
+const char* tcp_state_name(tcp_state_t s);
+void tcp_print_connections(void);
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
@@ -1,163 +1,1462 @@
 #include "tls.h"
+#include "socket.h"
+#include "net.h"
 #include "../mm/kmalloc.h"
 #include "../string.h"
+#include "../terminal.h"
+#include "../hardware/sse.h"
 #include "../crypto/prng.h"
+#include "../crypto/sha256.h"
+#include "../crypto/hmac.h"
+#include "../crypto/gcm.h"
+#include "../crypto/chacha20.h"
+#include "../crypto/curve25519.h"
+#include "../crypto/rsa.h"
+#include "../crypto/x509.h"
+#include <errno.h>
 
-/* TLS Constants */
+extern void serial(const char *fmt, ...);
+
+/* Record types */
 #define TLS_RT_CHANGE_CIPHER_SPEC 20
 #define TLS_RT_ALERT              21
 #define TLS_RT_HANDSHAKE          22
 #define TLS_RT_APPLICATION_DATA   23
 
-/* Handshake Types */
-#define TLS_HT_HELLO_REQUEST       0
-#define TLS_HT_CLIENT_HELLO        1
-#define TLS_HT_SERVER_HELLO        2
-#define TLS_HT_CERTIFICATE         11
-#define TLS_HT_SERVER_KEY_EXCHANGE 12
-#define TLS_HT_CERTIFICATE_REQUEST 13
-#define TLS_HT_SERVER_HELLO_DONE   14
-#define TLS_HT_CERTIFICATE_VERIFY  15
-#define TLS_HT_CLIENT_KEY_EXCHANGE 16
-#define TLS_HT_FINISHED            20
+/* Handshake types */
+#define TLS_HT_HELLO_REQUEST        0
+#define TLS_HT_CLIENT_HELLO         1
+#define TLS_HT_SERVER_HELLO         2
+#define TLS_HT_NEW_SESSION_TICKET   4
+#define TLS_HT_ENCRYPTED_EXTENSIONS 8
+#define TLS_HT_CERTIFICATE          11
+#define TLS_HT_SERVER_KEY_EXCHANGE  12
+#define TLS_HT_CERTIFICATE_REQUEST  13
+#define TLS_HT_SERVER_HELLO_DONE    14
+#define TLS_HT_CERTIFICATE_VERIFY   15
+#define TLS_HT_CLIENT_KEY_EXCHANGE  16
+#define TLS_HT_FINISHED             20
+#define TLS_HT_KEY_UPDATE           24
+#define TLS_HT_CCS                  0x100   /* Pseudo type: TLS 1.2 ChangeCipherSpec */
 
-extern void serial(const char *fmt, ...);
-extern uint64_t hpet_time_ms(void);
-
-void tls_init_context(tls_context_t* ctx, uint32_t ip, uint16_t port) {
-    memset(ctx, 0, sizeof(tls_context_t));
-    ctx->state = TLS_STATE_HANDSHAKE;
-    ctx->ip = ip;
-    ctx->port = port;
-}
-
-int tls_create_client_hello(tls_context_t* ctx, const char* hostname, uint8_t* buf, size_t max_len) {
-    (void)ctx;
-    if (max_len < 128) return -1;
-
-    uint8_t* p = buf;
-    
-    /* 1. Record Layer Header */
-    *p++ = TLS_RT_HANDSHAKE;
-    *p++ = 0x03; *p++ = 0x01; /* TLS 1.0 for compatibility in record layer */
-    uint8_t* len_ptr = p;
-    p += 2; /* Length placeholder */
-
-    /* 2. Handshake Header */
-    uint8_t* hs_start = p;
-    *p++ = TLS_HT_CLIENT_HELLO;
-    uint8_t* hs_len_ptr = p;
-    p += 3; /* Length placeholder */
-
-    /* 3. Client Hello Body */
-    *p++ = 0x03; *p++ = 0x03; /* TLS 1.2 */
-    
-    /* Random (32 bytes) */
-    uint32_t time = (uint32_t)hpet_time_ms();
-    memcpy(p, &time, 4); p += 4;
-    
-    /* Use PRNG for the rest of the random bytes */
-    for (int i = 0; i < 7; i++) {
-        *(uint32_t*)p = prng_next(); p += 4;
-    }
-
-    /* Session ID (0) */
-    *p++ = 0;
+/* Extensions */
+#define TLS_EXT_SERVER_NAME         0
+#define TLS_EXT_SUPPORTED_GROUPS    10
+#define TLS_EXT_EC_POINT_FORMATS    11
+#define TLS_EXT_SIG_ALGS            13
+#define TLS_EXT_EXTENDED_MS         23
+#define TLS_EXT_SESSION_TICKET      35
+#define TLS_EXT_PRE_SHARED_KEY      41
+#define TLS_EXT_SUPPORTED_VERSIONS  43
+#define TLS_EXT_PSK_MODES           45
+#define TLS_EXT_KEY_SHARE           51
+
+/* Alerts */
+#define TLS_ALERT_CLOSE_NOTIFY      0
+#define TLS_ALERT_UNEXPECTED        10
+#define TLS_ALERT_BAD_RECORD_MAC    20
+#define TLS_ALERT_HANDSHAKE_FAILURE 40
+#define TLS_ALERT_DECRYPT_ERROR     51
+
+#define TLS12 0x0303
+#define TLS13 0x0304
+
+#define TLS_AES_128_GCM_SHA256                        0x1301
+#define TLS_CHACHA20_POLY1305_SHA256                  0x1303
+#define TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256       0xC02B
+#define TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256         0xC02F
+#define TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256   0xCCA8
+#define TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256 0xCCA9
+#define TLS_EMPTY_RENEGOTIATION_INFO_SCSV             0x00FF
+
+#define TLS_GROUP_X25519            0x001D
+#define TLS_SIG_RSA_PKCS1_SHA256    0x0401
+#define TLS_SIG_RSA_PSS_SHA256      0x0804
+#define TLS_SIG_ED25519             0x0807
+
+/* 2^14 plaintext plus the largest TLS 1.2 expansion */
+#define TLS_RECORD_MAX  (5 + TLS_MAX_PLAINTEXT + 2048)
+#define TLS_WRITE_MAX   (5 + 8 + TLS_MAX_PLAINTEXT + 1 + 16)
+
+typedef struct {
+    int      active;
+    int      chacha;
+    uint8_t  key[32];
+    uint8_t  iv[12];        /* TLS 1.2 GCM uses only the 4-byte salt */
+    uint8_t  secret[32];    /* TLS 1.3 traffic secret, for KeyUpdate */
+    uint64_t seq;
+    gcm_ctx_t gcm;
+} tls_cipher_t;
+
+typedef struct {
+    int      valid;
+    char     host[TLS_HOST_MAX];
+    uint16_t version;
+    uint16_t suite;
+    uint32_t issued;        /* net_time_ms() */
+    uint32_t lifetime;      /* Seconds */
+    uint32_t age_add;       /* TLS 1.3 */
+    uint32_t last_used;
+    uint8_t  secret[48];    /* TLS 1.2 master secret / TLS 1.3 PSK */
+    uint8_t  session_id[32];
+    uint8_t  session_id_len;
+    uint8_t  ems;
+    uint16_t ticket_len;
+    uint8_t* ticket;
+} tls_session_t;
+
+struct tls_conn {
+    int      fd;
+    uint16_t version;
+    uint16_t suite;
+    int      chacha;
+    int      resumed;
+    int      ems;
+    int      closed;
+    char     host[TLS_HOST_MAX];
+    char     info[64];
+
+    sha256_ctx_t transcript;
+    uint8_t  client_random[32];
+    uint8_t  server_random[32];
+    uint8_t  session_id[32];
+    uint8_t  session_id_len;
+    uint8_t  x25519_priv[32];
+    uint8_t  x25519_pub[32];
+    uint8_t  master[48];        /* TLS 1.2 master secret */
+    uint8_t  early[32];         /* TLS 1.3 early secret (PSK or zeros) */
+    uint8_t  res_master[32];    /* TLS 1.3 resumption master secret */
+
+    tls_session_t offer;        /* Session offered in the ClientHello */
+    int      offered;
+    int      ticket_acked;      /* TLS 1.2 server will send NewSessionTicket */
+    uint8_t* new_ticket;        /* TLS 1.2 NewSessionTicket */
+    uint16_t new_ticket_len;
+    uint32_t new_ticket_lifetime;
+
+    x509_pubkey_t peer_key;
+    int      cert_requested;
+
+    tls_cipher_t tx, rx;
+
+    uint8_t* rbuf;              /* Raw records from the socket */
+    size_t   rlen, rdrop;
+    uint8_t* app;               /* Decrypted application data not handed out yet */
+    size_t   app_len;
+    uint8_t* hs;                /* Handshake reassembly */
+    size_t   hs_len, hs_cap, hs_drop;
+    uint8_t* wbuf;
+};
+
+static tls_session_t tls_sessions[TLS_SESSION_CACHE];
+static uint32_t tls_session_clock;
+
+/* ----------------------------------------------------------------------- */
+/* Bounds-checked reader                                                   */
+/* ----------------------------------------------------------------------- */
 
-    /* Cipher Suites */
-    /* Advertise TLS_RSA_WITH_AES_128_CBC_SHA (0x002F) and others */
-    uint16_t ciphers[] = { 0x002F, 0x0035, 0xC013 }; 
-    uint16_t cipher_len = sizeof(ciphers);
-    
-    *p++ = (cipher_len >> 8) & 0xFF;
-    *p++ = cipher_len & 0xFF;
-    for (size_t i=0; i<sizeof(ciphers)/2; i++) {
-        *p++ = (ciphers[i] >> 8) & 0xFF;
-        *p++ = ciphers[i] & 0xFF;
+typedef struct {
+    const uint8_t* p;
+    size_t n;
+    int err;
+} tls_rd_t;
+
+static void rd_init(tls_rd_t* r, const uint8_t* p, size_t n) { r->p = p; r->n = n; r->err = 0; }
+
+static const uint8_t* rd_bytes(tls_rd_t* r, size_t len) {
+    if (r->err || len > r->n) { r->err = 1; return NULL; }
+    const uint8_t* p = r->p;
+    r->p += len;
+    r->n -= len;
+    return p;
+}
+
+static uint32_t rd_uint(tls_rd_t* r, int bytes) {
+    const uint8_t* p = rd_bytes(r, bytes);
+    uint32_t v = 0;
+    if (!p) return 0;
+    for (int i = 0; i < bytes; i++) v = (v << 8) | p[i];
+    return v;
+}
+
+#define rd_u8(r)  rd_uint(r, 1)
+#define rd_u16(r) rd_uint(r, 2)
+#define rd_u24(r) rd_uint(r, 3)
+#define rd_u32(r) rd_uint(r, 4)
+
+static uint8_t* put16(uint8_t* p, uint32_t v) { p[0] = v >> 8; p[1] = v; return p + 2; }
+static uint8_t* put24(uint8_t* p, uint32_t v) { p[0] = v >> 16; p[1] = v >> 8; p[2] = v; return p + 3; }
+
+static int tls_memeq(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint8_t d = 0;
+    for (size_t i = 0; i < n; i++) d |= a[i] ^ b[i];
+    return d == 0;
+}
+
+static int tls13_suite(uint16_t s) {
+    return s == TLS_AES_128_GCM_SHA256 || s == TLS_CHACHA20_POLY1305_SHA256;
+}
+
+static int tls12_suite(uint16_t s) {
+    return s == TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256 || s == TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256 ||
+           s == TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256 || s == TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256;
+}
+
+static int tls_suite_chacha(uint16_t s) {
+    return s == TLS_CHACHA20_POLY1305_SHA256 || s == TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256 ||
+           s == TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256;
+}
+
+static const char* tls_suite_name(uint16_t s) {
+    switch (s) {
+    case TLS_AES_128_GCM_SHA256:                        return "TLS_AES_128_GCM_SHA256";
+    case TLS_CHACHA20_POLY1305_SHA256:                  return "TLS_CHACHA20_POLY1305_SHA256";
+    case TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256:         return "ECDHE-RSA-AES128-GCM-SHA256";
+    case TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256:   return "ECDHE-RSA-CHACHA20-POLY1305";
+    case TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256:       return "ECDHE-ECDSA-AES128-GCM-SHA256";
+    case TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256: return "ECDHE-ECDSA-CHACHA20-POLY1305";
     }
+    return "?";
+}
 
-    /* Compression Methods (0 = null) */
-    *p++ = 1;
-    *p++ = 0;
+/* ----------------------------------------------------------------------- */
+/* Session cache                                                           */
+/* ----------------------------------------------------------------------- */
 
-    /* Extensions Length Placeholder */
-    uint8_t* ext_len_ptr = p;
-    p += 2;
-    uint8_t* ext_start = p;
-
-    /* Extension: Server Name (SNI) */
-    if (hostname && *hostname) {
-        size_t host_len = strlen(hostname);
-        
-        *p++ = 0x00; *p++ = 0x00; /* Type: server_name */
-        
-        /* Extension Length */
-        size_t sni_ext_len = 2 + 1 + 2 + host_len; /* ListLen(2) + Type(1) + NameLen(2) + Name */
-        *p++ = (sni_ext_len >> 8) & 0xFF;
-        *p++ = sni_ext_len & 0xFF;
-        
-        /* Server Name List Length */
-        size_t sni_list_len = 1 + 2 + host_len;
-        *p++ = (sni_list_len >> 8) & 0xFF;
-        *p++ = sni_list_len & 0xFF;
-        
-        *p++ = 0x00; /* Name Type: host_name */
-        *p++ = (host_len >> 8) & 0xFF;
-        *p++ = host_len & 0xFF;
-        memcpy(p, hostname, host_len);
-        p += host_len;
-    }
-
-    /* Fill Extensions Length */
-    size_t ext_total_len = p - ext_start;
-    ext_len_ptr[0] = (ext_total_len >> 8) & 0xFF;
-    ext_len_ptr[1] = ext_total_len & 0xFF;
-
-    /* Fill Lengths */
-    size_t hs_len = p - hs_start - 4; /* Exclude Type(1) + Len(3) */
-    hs_len_ptr[0] = (hs_len >> 16) & 0xFF;
-    hs_len_ptr[1] = (hs_len >> 8) & 0xFF;
-    hs_len_ptr[2] = hs_len & 0xFF;
-
-    size_t rec_len = p - buf - 5; /* Exclude Type(1) + Ver(2) + Len(2) */
-    len_ptr[0] = (rec_len >> 8) & 0xFF;
-    len_ptr[1] = rec_len & 0xFF;
-
-    return (p - buf);
-}
-
-int tls_handle_rx(tls_context_t* ctx, const uint8_t* data, size_t len) {
-    const uint8_t* p = data;
-    const uint8_t* end = data + len;
-
-    while (p + 5 <= end) {
-        uint8_t type = p[0];
-        uint16_t length = (p[3] << 8) | p[4];
-        
-        p += 5;
-        if (p + length > end) return 0; /* Fragmented packet? */
+static void tls_session_clear(tls_session_t* s) {
+    if (s->ticket) kfree(s->ticket);
+    memset(s, 0, sizeof(*s));
+}
+
+static int tls_session_expired(const tls_session_t* s) {
+    return (net_time_ms() - s->issued) / 1000 >= s->lifetime;
+}
+
+/* Takes the cached session for host out of the cache (TLS 1.3 tickets are
+   single use; TLS 1.2 sessions are put back once the handshake is done). */
+static int tls_session_take(const char* host, tls_session_t* out) {
+    for (int i = 0; i < TLS_SESSION_CACHE; i++) {
+        tls_session_t* s = &tls_sessions[i];
+        if (!s->valid || strcmp(s->host, host) != 0) continue;
+        if (tls_session_expired(s)) {
+            tls_session_clear(s);
+            continue;
+        }
+        *out = *s;
+        memset(s, 0, sizeof(*s));
+        return 1;
+    }
+    return 0;
+}
+
+/* Stores a copy of s (the ticket buffer is adopted), replacing the entry
+   for the same host or the least recently used one. */
+static void tls_session_put(tls_session_t* s) {
+    tls_session_t* slot = NULL;
+    for (int i = 0; i < TLS_SESSION_CACHE; i++) {
+        tls_session_t* e = &tls_sessions[i];
+        if (e->valid && strcmp(e->host, s->host) == 0) { slot = e; break; }
+        if (!slot || (slot->valid && (!e->valid || e->last_used < slot->last_used))) slot = e;
+    }
+    tls_session_clear(slot);
+    *slot = *s;
+    slot->valid = 1;
+    slot->last_used = ++tls_session_clock;
+    s->ticket = NULL;
+}
+
+void tls_session_flush(void) {
+    for (int i = 0; i < TLS_SESSION_CACHE; i++) tls_session_clear(&tls_sessions[i]);
+}
+
+void tls_print_sessions(void) {
+    terminal_writestring("TLS Sessions:\n");
+    for (int i = 0; i < TLS_SESSION_CACHE; i++) {
+        tls_session_t* s = &tls_sessions[i];
+        if (!s->valid || tls_session_expired(s)) continue;
+        uint32_t left = s->lifetime - (net_time_ms() - s->issued) / 1000;
+        terminal_printf("  %s  %s %s  %s  %us left\n", s->host,
+                        s->version == TLS13 ? "TLSv1.3" : "TLSv1.2", tls_suite_name(s->suite),
+                        s->ticket ? "ticket" : "session-id", left);
+    }
+}
+
+/* ----------------------------------------------------------------------- */
+/* Record layer                                                            */
+/* ----------------------------------------------------------------------- */
+
+static void tls_nonce(const tls_cipher_t* cs, uint8_t nonce[12]) {
+    memcpy(nonce, cs->iv, 12);
+    for (int i = 0; i < 8; i++) nonce[11 - i] ^= (uint8_t)(cs->seq >> (8 * i));
+}
+
+static void tls_seal(tls_cipher_t* cs, const uint8_t nonce[12], const uint8_t* aad, size_t aad_len,
+                     uint8_t* buf, size_t len, uint8_t tag[16]) {
+    if (cs->chacha) chacha20_poly1305_seal(cs->key, nonce, aad, aad_len, buf, buf, len, tag);
+    else gcm_seal(&cs->gcm, nonce, aad, aad_len, buf, buf, len, tag);
+}
+
+static int tls_open(tls_cipher_t* cs, const uint8_t nonce[12], const uint8_t* aad, size_t aad_len,
+                    uint8_t* buf, size_t len, const uint8_t tag[16]) {
+    if (cs->chacha) return chacha20_poly1305_open(cs->key, nonce, aad, aad_len, buf, buf, len, tag);
+    return gcm_open(&cs->gcm, nonce, aad, aad_len, buf, buf, len, tag);
+}
+
+/* TLS 1.2 AEAD additional data: seq_num || type || version || length */
+static void tls12_aad(uint8_t aad[13], uint64_t seq, int type, size_t len) {
+    for (int i = 0; i < 8; i++) aad[i] = (uint8_t)(seq >> (56 - 8 * i));
+    aad[8] = type;
+    aad[9] = 3;
+    aad[10] = 3;
+    aad[11] = len >> 8;
+    aad[12] = len;
+}
+
+static int tls_write_record(tls_conn_t* c, int type, const uint8_t* data, size_t len) {
+    uint8_t* w = c->wbuf;
+    uint8_t* body = w + 5;
+    size_t n = len;
+    tls_cipher_t* cs = &c->tx;
+
+    w[0] = type;
+    w[1] = 3;
+    w[2] = c->version ? 3 : 1;      /* ClientHello goes out as 0x0301 */
+
+    if (!cs->active || type == TLS_RT_CHANGE_CIPHER_SPEC) {
+        memcpy(body, data, len);
+    } else if (c->version == TLS13) {
+        uint8_t nonce[12];
+        memcpy(body, data, len);
+        body[len] = type;
+        n = len + 1 + 16;
+        w[0] = TLS_RT_APPLICATION_DATA;
+        w[3] = n >> 8;
+        w[4] = n;
+        tls_nonce(cs, nonce);
+        tls_seal(cs, nonce, w, 5, body, len + 1, body + len + 1);
+        cs->seq++;
+    } else {
+        uint8_t nonce[12], aad[13];
+        tls12_aad(aad, cs->seq, type, len);
+        if (cs->chacha) {
+            tls_nonce(cs, nonce);
+        } else {
+            memcpy(nonce, cs->iv, 4);
+            for (int i = 0; i < 8; i++) nonce[4 + i] = (uint8_t)(cs->seq >> (56 - 8 * i));
+            memcpy(body, nonce + 4, 8);     /* Explicit nonce = sequence number */
+            body += 8;
+        }
+        memcpy(body, data, len);
+        tls_seal(cs, nonce, aad, 13, body, len, body + len);
+        n = (size_t)(body - (w + 5)) + len + 16;
+        cs->seq++;
+    }
+
+    w[3] = n >> 8;
+    w[4] = n;
+    int r = sock_send(c->fd, w, 5 + n, 0);
+    if (r < 0) return r;
+    return r == (int)(5 + n) ? 0 : -ECONNRESET;
+}
+
+static void tls_send_alert(tls_conn_t* c, int level, int desc) {
+    uint8_t a[2] = { (uint8_t)level, (uint8_t)desc };
+    tls_write_record(c, TLS_RT_ALERT, a, 2);
+}
+
+/* Makes sure rbuf holds need bytes. 1 on EOF before the first byte of a
+   record, -ECONNRESET on EOF inside one. */
+static int tls_fill(tls_conn_t* c, size_t need) {
+    while (c->rlen < need) {
+        int n = sock_recv(c->fd, c->rbuf + c->rlen, TLS_RECORD_MAX - c->rlen, 0);
+        if (n < 0) return n;
+        if (n == 0) return c->rlen == 0 ? 1 : -ECONNRESET;
+        c->rlen += n;
+    }
+    return 0;
+}
+
+static int tls_open_record(tls_conn_t* c, uint8_t* hdr, uint8_t** data, size_t* len, int* type) {
+    tls_cipher_t* cs = &c->rx;
+    uint8_t* p = *data;
+    size_t n = *len;
+    uint8_t nonce[12];
+
+    if (c->version == TLS13) {
+        if (*type != TLS_RT_APPLICATION_DATA || n < 17) return -EPROTO;
+        tls_nonce(cs, nonce);
+        if (tls_open(cs, nonce, hdr, 5, p, n - 16, p + n - 16) != 0) return -EBADMSG;
+        n -= 16;
+        while (n > 0 && p[n - 1] == 0) n--;     /* Padding */
+        if (n == 0) return -EPROTO;
+        *type = p[--n];
+    } else {
+        uint8_t aad[13];
+        if (cs->chacha) {
+            if (n < 16) return -EPROTO;
+            tls_nonce(cs, nonce);
+        } else {
+            if (n < 24) return -EPROTO;
+            memcpy(nonce, cs->iv, 4);
+            memcpy(nonce + 4, p, 8);
+            p += 8;
+            n -= 8;
+        }
+        n -= 16;
+        tls12_aad(aad, cs->seq, *type, n);
+        if (tls_open(cs, nonce, aad, 13, p, n, p + n) != 0) return -EBADMSG;
+    }
+
+    cs->seq++;
+    *data = p;
+    *len = n;
+    return 0;
+}
+
+/* Next record, decrypted in place. The plaintext stays valid until the
+   next call. 1 on a clean EOF. */
+static int tls_read_record(tls_conn_t* c, int* type, uint8_t** data, size_t* len) {
+    if (c->rdrop) {
+        memmove(c->rbuf, c->rbuf + c->rdrop, c->rlen - c->rdrop);
+        c->rlen -= c->rdrop;
+        c->rdrop = 0;
+    }
+
+    int r = tls_fill(c, 5);
+    if (r) return r;
+    uint8_t* h = c->rbuf;
+    size_t n = ((size_t)h[3] << 8) | h[4];
+    if (h[1] != 3 || n > TLS_RECORD_MAX - 5) return -EPROTO;
+    r = tls_fill(c, 5 + n);
+    if (r) return r < 0 ? r : -ECONNRESET;
+    c->rdrop = 5 + n;
+
+    *type = h[0];
+    *data = h + 5;
+    *len = n;
+    if (c->rx.active && *type != TLS_RT_CHANGE_CIPHER_SPEC) {
+        r = tls_open_record(c, h, data, len, type);
+        if (r) return r;
+    }
+    if (*len > TLS_MAX_PLAINTEXT) return -EPROTO;
+    return 0;
+}
+
+/* 0 to carry on (ignorable warning), 1 on close_notify, else -ECONNRESET */
+static int tls_alert(tls_conn_t* c, const uint8_t* d, size_t n) {
+    if (n != 2) return -EPROTO;
+    if (d[1] == TLS_ALERT_CLOSE_NOTIFY) {
+        c->closed = 1;
+        return 1;
+    }
+    if (d[0] == 1 && c->version == TLS12) return 0;
+    serial("[TLS] %s: alert %d (level %d)\n", c->host, d[1], d[0]);
+    return -ECONNRESET;
+}
+
+static int tls_hs_append(tls_conn_t* c, const uint8_t* data, size_t n) {
+    if (c->hs_drop) {
+        memmove(c->hs, c->hs + c->hs_drop, c->hs_len - c->hs_drop);
+        c->hs_len -= c->hs_drop;
+        c->hs_drop = 0;
+    }
+    if (c->hs_len + n > c->hs_cap) {
+        size_t cap = c->hs_cap * 2;
+        if (cap < c->hs_len + n) cap = c->hs_len + n;
+        if (cap > TLS_HANDSHAKE_MAX + 4) return -EPROTO;
+        uint8_t* nb = (uint8_t*)kmalloc(cap);
+        if (!nb) return -ENOMEM;
+        memcpy(nb, c->hs, c->hs_len);
+        kfree(c->hs);
+        c->hs = nb;
+        c->hs_cap = cap;
+    }
+    memcpy(c->hs + c->hs_len, data, n);
+    c->hs_len += n;
+    return 0;
+}
+
+/* 1 and the next complete handshake message (header included), or 0 */
+static int tls_hs_pop(tls_conn_t* c, int* ht, uint8_t** msg, size_t* len) {
+    size_t avail = c->hs_len - c->hs_drop;
+    uint8_t* m = c->hs + c->hs_drop;
+    if (avail < 4) return 0;
+    size_t body = ((size_t)m[1] << 16) | ((size_t)m[2] << 8) | m[3];
+    if (avail < 4 + body) return 0;
+    *ht = m[0];
+    *msg = m;
+    *len = 4 + body;
+    c->hs_drop += 4 + body;
+    if (c->hs_drop == c->hs_len) c->hs_len = c->hs_drop = 0;
+    return 1;
+}
+
+/* Next handshake message, reading records as needed. A TLS 1.2
+   ChangeCipherSpec comes back as TLS_HT_CCS; TLS 1.3 ones are dropped. */
+static int tls_next_handshake(tls_conn_t* c, int* ht, uint8_t** msg, size_t* len) {
+    for (;;) {
+        if (tls_hs_pop(c, ht, msg, len)) {
+            if (*len - 4 > TLS_HANDSHAKE_MAX) return -EPROTO;
+            return 0;
+        }
+
+        int type;
+        uint8_t* data;
+        size_t n;
+        int r = tls_read_record(c, &type, &data, &n);
+        if (r) return r > 0 ? -ECONNRESET : r;
 
         if (type == TLS_RT_HANDSHAKE) {
-            uint8_t hs_type = p[0];
-            serial("[TLS] Handshake msg type: %d len: %d\n", hs_type, length);
-            
-            if (hs_type == TLS_HT_SERVER_HELLO) {
-                serial("[TLS] Server Hello received.\n");
-            } else if (hs_type == TLS_HT_CERTIFICATE) {
-                serial("[TLS] Certificate received.\n");
-            } else if (hs_type == TLS_HT_SERVER_HELLO_DONE) {
-                serial("[TLS] Server Hello Done.\n");
-                serial("[TLS] ERROR: Crypto stack (RSA/ECC) missing to proceed with Key Exchange.\n");
-                ctx->state = TLS_STATE_ERROR;
-                return -1;
+            if (n == 0) return -EPROTO;
+            r = tls_hs_append(c, data, n);
+            if (r) return r;
+        } else if (type == TLS_RT_CHANGE_CIPHER_SPEC) {
+            if (n != 1 || data[0] != 1) return -EPROTO;
+            if (c->version == TLS12) {
+                if (c->hs_len != c->hs_drop) return -EPROTO;
+                *ht = TLS_HT_CCS;
+                *msg = data;
+                *len = n;
+                return 0;
             }
         } else if (type == TLS_RT_ALERT) {
-            serial("[TLS] Alert: Level=%d Desc=%d\n", p[0], p[1]);
-            ctx->state = TLS_STATE_ERROR;
-            return -1;
+            r = tls_alert(c, data, n);
+            if (r) return r > 0 ? -ECONNRESET : r;
+        } else {
+            return -EPROTO;
         }
+    }
+}
+
+/* Like tls_next_handshake, but insists on one type */
+static int tls_expect(tls_conn_t* c, int want, uint8_t** msg, size_t* len) {
+    int ht;
+    int r = tls_next_handshake(c, &ht, msg, len);
+    if (r) return r;
+    return ht == want ? 0 : -EPROTO;
+}
+
+static void tls_transcript_add(tls_conn_t* c, const uint8_t* msg, size_t len) {
+    sha256_update(&c->transcript, msg, len);
+}
+
+static void tls_transcript_hash(const tls_conn_t* c, uint8_t out[32]) {
+    sha256_ctx_t t = c->transcript;
+    sha256_final(&t, out);
+}
+
+static int tls_send_handshake(tls_conn_t* c, const uint8_t* msg, size_t len) {
+    tls_transcript_add(c, msg, len);
+    return tls_write_record(c, TLS_RT_HANDSHAKE, msg, len);
+}
 
-        p += length;
+/* ----------------------------------------------------------------------- */
+/* Key schedules                                                           */
+/* ----------------------------------------------------------------------- */
+
+static void tls13_expand_label(const uint8_t secret[32], const char* label,
+                               const uint8_t* ctx, size_t ctx_len, uint8_t* out, size_t out_len) {
+    uint8_t info[2 + 1 + 32 + 1 + 255];
+    size_t ll = strlen(label);
+    uint8_t* p = put16(info, out_len);
+    *p++ = 6 + ll;
+    memcpy(p, "tls13 ", 6);
+    memcpy(p + 6, label, ll);
+    p += 6 + ll;
+    *p++ = ctx_len;
+    if (ctx_len) memcpy(p, ctx, ctx_len);
+    p += ctx_len;
+    hkdf_sha256_expand(secret, info, p - info, out, out_len);
+}
+
+static void tls13_derive(const uint8_t secret[32], const char* label, const uint8_t hash[32], uint8_t out[32]) {
+    tls13_expand_label(secret, label, hash, 32, out, 32);
+}
+
+static void tls13_empty_hash(uint8_t out[32]) {
+    sha256_ctx_t t;
+    sha256_init(&t);
+    sha256_final(&t, out);
+}
+
+/* HMAC(finished_key(base), hash): Finished verify_data and PSK binders */
+static void tls13_finished(const uint8_t base[32], const uint8_t hash[32], uint8_t out[32]) {
+    uint8_t fk[32];
+    tls13_expand_label(base, "finished", NULL, 0, fk, 32);
+    hmac_sha256(fk, 32, hash, 32, out);
+}
+
+static void tls13_set_keys(tls_conn_t* c, tls_cipher_t* cs, const uint8_t secret[32]) {
+    size_t klen = c->chacha ? 32 : 16;
+    memcpy(cs->secret, secret, 32);
+    tls13_expand_label(secret, "key", NULL, 0, cs->key, klen);
+    tls13_expand_label(secret, "iv", NULL, 0, cs->iv, 12);
+    cs->chacha = c->chacha;
+    if (!cs->chacha) gcm_init(&cs->gcm, cs->key);
+    cs->seq = 0;
+    cs->active = 1;
+}
+
+/* key_block = client key | server key | client IV | server IV (AEAD: no MAC keys) */
+static void tls12_set_keys(tls_conn_t* c) {
+    uint8_t seed[64], kb[2 * 32 + 2 * 12];
+    size_t klen = c->chacha ? 32 : 16;
+    size_t ivlen = c->chacha ? 12 : 4;
+
+    memcpy(seed, c->server_random, 32);
+    memcpy(seed + 32, c->client_random, 32);
+    tls12_prf_sha256(c->master, 48, "key expansion", seed, 64, kb, 2 * klen + 2 * ivlen);
+
+    tls_cipher_t* cs[2] = { &c->tx, &c->rx };
+    for (int i = 0; i < 2; i++) {
+        memcpy(cs[i]->key, kb + i * klen, klen);
+        memset(cs[i]->iv, 0, 12);
+        memcpy(cs[i]->iv, kb + 2 * klen + i * ivlen, ivlen);
+        cs[i]->chacha = c->chacha;
+        if (!c->chacha) gcm_init(&cs[i]->gcm, cs[i]->key);
+        cs[i]->seq = 0;
+        cs[i]->active = 0;
+    }
+    memset(kb, 0, sizeof(kb));
+}
+
+static void tls12_finished(tls_conn_t* c, const char* label, uint8_t out[12]) {
+    uint8_t hash[32];
+    tls_transcript_hash(c, hash);
+    tls12_prf_sha256(c->master, 48, label, hash, 32, out, 12);
+}
+
+/* ----------------------------------------------------------------------- */
+/* Certificates and signatures                                             */
+/* ----------------------------------------------------------------------- */
+
+static int tls_take_leaf(tls_conn_t* c, const uint8_t* cert, size_t len) {
+    if (x509_parse_pubkey(cert, len, &c->peer_key) != 0) {
+        serial("[TLS] %s: unsupported certificate key\n", c->host);
+        return -EPROTO;
     }
+    char cn[64];
+    if (x509_subject_cn(cert, len, cn, sizeof(cn)) == 0)
+        serial("[TLS] %s: server certificate CN=%s\n", c->host, cn);
     return 0;
-}
\ No newline at end of file
+}
+
+static int tls_verify(tls_conn_t* c, uint16_t alg, const uint8_t* msg, size_t msg_len,
+                      const uint8_t* sig, size_t sig_len) {
+    const x509_pubkey_t* k = &c->peer_key;
+    uint8_t hash[32];
+    int ok;
+
+    if (alg == TLS_SIG_ED25519) {
+        if (k->type != X509_KEY_ED25519 || sig_len != 64) return -EPROTO;
+        ok = ed25519_verify(sig, msg, msg_len, k->ed25519) == 0;
+    } else if (alg == TLS_SIG_RSA_PSS_SHA256 || (alg == TLS_SIG_RSA_PKCS1_SHA256 && c->version == TLS12)) {
+        if (k->type != X509_KEY_RSA) return -EPROTO;
+        sha256_ctx_t t;
+        sha256_init(&t);
+        sha256_update(&t, msg, msg_len);
+        sha256_final(&t, hash);
+        ok = (alg == TLS_SIG_RSA_PSS_SHA256 ? rsa_verify_pss_sha256(&k->rsa, hash, sig, sig_len)
+                                            : rsa_verify_pkcs1_sha256(&k->rsa, hash, sig, sig_len)) == 0;
+    } else {
+        return -EPROTO;
+    }
+
+    if (!ok) serial("[TLS] %s: bad handshake signature\n", c->host);
+    return ok ? 0 : -EBADMSG;
+}
+
+/* ----------------------------------------------------------------------- */
+/* ClientHello / ServerHello                                               */
+/* ----------------------------------------------------------------------- */
+
+static int tls_is_ip_literal(const char* h) {
+    for (; *h; h++)
+        if ((*h < '0' || *h > '9') && *h != '.') return 0;
+    return 1;
+}
+
+static int tls_client_hello(tls_conn_t* c) {
+    tls_session_t* s = c->offered ? &c->offer : NULL;
+    int psk = s && s->version == TLS13;
+    size_t cap = 512 + strlen(c->host) + (s ? s->ticket_len : 0);
+    uint8_t* m = (uint8_t*)kmalloc(cap);
+    if (!m) return -ENOMEM;
+
+    uint8_t* p = m + 4;
+    p = put16(p, TLS12);
+    memcpy(p, c->client_random, 32);
+    p += 32;
+
+    /* Cached TLS 1.2 session ID, else a random one (TLS 1.3 middlebox
+       compatibility, and the echo that marks a ticket resumption) */
+    if (s && s->version == TLS12 && !s->ticket && s->session_id_len) {
+        c->session_id_len = s->session_id_len;
+        memcpy(c->session_id, s->session_id, s->session_id_len);
+    } else {
+        c->session_id_len = 32;
+        prng_fill(c->session_id, 32);
+    }
+    *p++ = c->session_id_len;
+    memcpy(p, c->session_id, c->session_id_len);
+    p += c->session_id_len;
+
+    /* Without AES-NI ChaCha20 is the faster cipher, so ask for it first */
+    static const uint16_t suites_ni[] = {
+        TLS_AES_128_GCM_SHA256, TLS_CHACHA20_POLY1305_SHA256,
+        TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256, TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256,
+        TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256, TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256,
+        TLS_EMPTY_RENEGOTIATION_INFO_SCSV
+    };
+    static const uint16_t suites_sw[] = {
+        TLS_CHACHA20_POLY1305_SHA256, TLS_AES_128_GCM_SHA256,
+        TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256, TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+        TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256, TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+        TLS_EMPTY_RENEGOTIATION_INFO_SCSV
+    };
+    const uint16_t* suites = (cpu_has_aesni() && cpu_has_pclmul()) ? suites_ni : suites_sw;
+    int nsuites = sizeof(suites_ni) / sizeof(suites_ni[0]);
+    p = put16(p, nsuites * 2);
+    for (int i = 0; i < nsuites; i++) p = put16(p, suites[i]);
+
+    *p++ = 1;       /* Compression: null only */
+    *p++ = 0;
+
+    uint8_t* ext_len = p;
+    p += 2;
+
+    if (!tls_is_ip_literal(c->host)) {
+        size_t hl = strlen(c->host);
+        p = put16(p, TLS_EXT_SERVER_NAME);
+        p = put16(p, hl + 5);
+        p = put16(p, hl + 3);
+        *p++ = 0;   /* host_name */
+        p = put16(p, hl);
+        memcpy(p, c->host, hl);
+        p += hl;
+    }
+
+    p = put16(p, TLS_EXT_SUPPORTED_GROUPS);
+    p = put16(p, 4);
+    p = put16(p, 2);
+    p = put16(p, TLS_GROUP_X25519);
+
+    p = put16(p, TLS_EXT_EC_POINT_FORMATS);
+    p = put16(p, 2);
+    *p++ = 1;
+    *p++ = 0;       /* uncompressed */
+
+    p = put16(p, TLS_EXT_SIG_ALGS);
+    p = put16(p, 8);
+    p = put16(p, 6);
+    p = put16(p, TLS_SIG_ED25519);
+    p = put16(p, TLS_SIG_RSA_PSS_SHA256);
+    p = put16(p, TLS_SIG_RSA_PKCS1_SHA256);
+
+    p = put16(p, TLS_EXT_EXTENDED_MS);
+    p = put16(p, 0);
+
+    p = put16(p, TLS_EXT_SESSION_TICKET);
+    if (s && s->version == TLS12 && s->ticket) {
+        p = put16(p, s->ticket_len);
+        memcpy(p, s->ticket, s->ticket_len);
+        p += s->ticket_len;
+    } else {
+        p = put16(p, 0);
+    }
+
+    p = put16(p, TLS_EXT_SUPPORTED_VERSIONS);
+    p = put16(p, 5);
+    *p++ = 4;
+    p = put16(p, TLS13);
+    p = put16(p, TLS12);
+
+    p = put16(p, TLS_EXT_PSK_MODES);
+    p = put16(p, 2);
+    *p++ = 1;
+    *p++ = 1;       /* psk_dhe_ke */
+
+    p = put16(p, TLS_EXT_KEY_SHARE);
+    p = put16(p, 2 + 2 + 2 + 32);
+    p = put16(p, 2 + 2 + 32);
+    p = put16(p, TLS_GROUP_X25519);
+    p = put16(p, 32);
+    memcpy(p, c->x25519_pub, 32);
+    p += 32;
+
+    /* pre_shared_key must be last: the binder covers everything before it */
+    uint8_t* binder = NULL;
+    if (psk) {
+        uint32_t age = net_time_ms() - s->issued + s->age_add;
+        p = put16(p, TLS_EXT_PRE_SHARED_KEY);
+        p = put16(p, 2 + 2 + s->ticket_len + 4 + 2 + 1 + 32);
+        p = put16(p, 2 + s->ticket_len + 4);
+        p = put16(p, s->ticket_len);
+        memcpy(p, s->ticket, s->ticket_len);
+        p += s->ticket_len;
+        p = put16(p, age >> 16);
+        p = put16(p, age & 0xFFFF);
+        p = put16(p, 1 + 32);
+        *p++ = 32;
+        binder = p;
+        p += 32;
+    }
+
+    put16(ext_len, p - ext_len - 2);
+    m[0] = TLS_HT_CLIENT_HELLO;
+    put24(m + 1, p - m - 4);
+
+    uint8_t zeros[32];
+    memset(zeros, 0, 32);
+    hkdf_sha256_extract(zeros, 32, psk ? s->secret : zeros, 32, c->early);
+
+    if (binder) {
+        uint8_t empty[32], bkey[32], hash[32];
+        sha256_ctx_t t;
+        sha256_init(&t);
+        sha256_update(&t, m, binder - 3 - m);   /* Up to the binders list */
+        sha256_final(&t, hash);
+        tls13_empty_hash(empty);
+        tls13_derive(c->early, "res binder", empty, bkey);
+        tls13_finished(bkey, hash, binder);
+    }
+
+    int r = tls_send_handshake(c, m, p - m);
+    kfree(m);
+    return r;
+}
+
+static const uint8_t tls_hrr_random[32] = {
+    0xCF, 0x21, 0xAD, 0x74, 0xE5, 0x9A, 0x61, 0x11, 0xBE, 0x1D, 0x8C, 0x02, 0x1E, 0x65, 0xB8, 0x91,
+    0xC2, 0xA2, 0x11, 0x16, 0x7A, 0xBB, 0x8C, 0x5E, 0x07, 0x9E, 0x09, 0xE2, 0xC8, 0xA8, 0x33, 0x9C
+};
+
+/* Parses ServerHello into c (version, suite, resumption) and share */
+static int tls_server_hello(tls_conn_t* c, const uint8_t* body, size_t len, uint8_t share[32], int* psk_ok) {
+    tls_rd_t r, e;
+    int have_share = 0, sel_version = 0;
+
+    *psk_ok = 0;
+    rd_init(&r, body, len);
+    uint16_t legacy = rd_u16(&r);
+    const uint8_t* random = rd_bytes(&r, 32);
+    uint8_t sid_len = rd_u8(&r);
+    const uint8_t* sid = rd_bytes(&r, sid_len);
+    c->suite = rd_u16(&r);
+    uint8_t comp = rd_u8(&r);
+    size_t ext_len = r.n ? rd_u16(&r) : 0;
+    const uint8_t* ext = rd_bytes(&r, ext_len);
+    if (r.err || sid_len > 32 || comp != 0) return -EPROTO;
+
+    if (memcmp(random, tls_hrr_random, 32) == 0) {
+        serial("[TLS] %s: HelloRetryRequest (no common group)\n", c->host);
+        return -EPROTO;
+    }
+    memcpy(c->server_random, random, 32);
+
+    rd_init(&e, ext, ext_len);
+    while (e.n && !e.err) {
+        uint16_t type = rd_u16(&e);
+        uint16_t elen = rd_u16(&e);
+        tls_rd_t x;
+        rd_init(&x, rd_bytes(&e, elen), elen);
+        if (e.err) break;
+        switch (type) {
+        case TLS_EXT_SUPPORTED_VERSIONS:
+            sel_version = rd_u16(&x);
+            break;
+        case TLS_EXT_KEY_SHARE: {
+            uint16_t group = rd_u16(&x);
+            uint16_t klen = rd_u16(&x);
+            const uint8_t* k = rd_bytes(&x, klen);
+            if (x.err || group != TLS_GROUP_X25519 || klen != 32) return -EPROTO;
+            memcpy(share, k, 32);
+            have_share = 1;
+            break;
+        }
+        case TLS_EXT_PRE_SHARED_KEY:
+            if (rd_u16(&x) != 0) return -EPROTO;    /* We offer one identity */
+            *psk_ok = 1;
+            break;
+        case TLS_EXT_EXTENDED_MS:
+            c->ems = 1;
+            break;
+        case TLS_EXT_SESSION_TICKET:
+            c->ticket_acked = 1;
+            break;
+        }
+        if (x.err) return -EPROTO;
+    }
+    if (e.err) return -EPROTO;
+
+    c->version = sel_version ? sel_version : legacy;
+    c->chacha = tls_suite_chacha(c->suite);
+
+    if (c->version == TLS13) {
+        if (!tls13_suite(c->suite) || !have_share) return -EPROTO;
+        if (sid_len != c->session_id_len || memcmp(sid, c->session_id, sid_len) != 0) return -EPROTO;
+        if (*psk_ok && !(c->offered && c->offer.version == TLS13)) return -EPROTO;
+        c->resumed = *psk_ok;
+        return 0;
+    }
+
+    if (c->version != TLS12 || !tls12_suite(c->suite)) {
+        serial("[TLS] %s: unsupported version %x / suite %x\n", c->host, c->version, c->suite);
+        return -EPROTO;
+    }
+    /* RFC 8446 4.1.3: a TLS 1.3 server must not be talked down to 1.2 */
+    if (memcmp(c->server_random + 24, "DOWNGRD\x01", 8) == 0) return -EPROTO;
+
+    if (sid_len && sid_len == c->session_id_len && memcmp(sid, c->session_id, sid_len) == 0) {
+        if (!c->offered || c->offer.version != TLS12) return -EPROTO;
+        if (c->offer.suite != c->suite || c->offer.ems != c->ems) return -EPROTO;
+        c->resumed = 1;
+    }
+    c->session_id_len = sid_len;
+    memcpy(c->session_id, sid, sid_len);
+    return 0;
+}
+
+/* ----------------------------------------------------------------------- */
+/* TLS 1.3                                                                 */
+/* ----------------------------------------------------------------------- */
+
+static int tls13_certificate(tls_conn_t* c, const uint8_t* body, size_t len) {
+    tls_rd_t r;
+    rd_init(&r, body, len);
+    rd_bytes(&r, rd_u8(&r));            /* certificate_request_context */
+    size_t list = rd_u24(&r);
+    if (r.err || list != r.n || list == 0) return -EPROTO;
+    size_t cl = rd_u24(&r);
+    const uint8_t* cert = rd_bytes(&r, cl);
+    if (r.err) return -EPROTO;
+    return tls_take_leaf(c, cert, cl);
+}
+
+static int tls13_certificate_verify(tls_conn_t* c, const uint8_t* body, size_t len) {
+    static const char ctx[] = "TLS 1.3, server CertificateVerify";
+    uint8_t content[64 + sizeof(ctx) + 32];
+    tls_rd_t r;
+
+    rd_init(&r, body, len);
+    uint16_t alg = rd_u16(&r);
+    size_t sl = rd_u16(&r);
+    const uint8_t* sig = rd_bytes(&r, sl);
+    if (r.err) return -EPROTO;
+
+    memset(content, 0x20, 64);
+    memcpy(content + 64, ctx, sizeof(ctx));     /* Includes the 0 separator */
+    tls_transcript_hash(c, content + 64 + sizeof(ctx));
+    return tls_verify(c, alg, content, sizeof(content), sig, sl);
+}
+
+static int tls13_handshake(tls_conn_t* c, const uint8_t share[32]) {
+    uint8_t ecdhe[32], empty[32], derived[32], hs[32], master[32], hash[32];
+    uint8_t c_hs[32], s_hs[32], c_ap[32], s_ap[32], verify[32], zeros[32];
+    uint8_t* msg;
+    size_t len;
+    int r;
+
+    x25519(ecdhe, c->x25519_priv, share);
+    uint8_t acc = 0;
+    for (int i = 0; i < 32; i++) acc |= ecdhe[i];
+    if (!acc) return -EPROTO;
+
+    memset(zeros, 0, 32);
+    if (!c->resumed) hkdf_sha256_extract(zeros, 32, zeros, 32, c->early);   /* PSK declined */
+    tls13_empty_hash(empty);
+    tls13_derive(c->early, "derived", empty, derived);
+    hkdf_sha256_extract(derived, 32, ecdhe, 32, hs);
+    tls_transcript_hash(c, hash);
+    tls13_derive(hs, "c hs traffic", hash, c_hs);
+    tls13_derive(hs, "s hs traffic", hash, s_hs);
+    tls13_derive(hs, "derived", empty, derived);
+    hkdf_sha256_extract(derived, 32, zeros, 32, master);
+    tls13_set_keys(c, &c->rx, s_hs);
+
+    r = tls_expect(c, TLS_HT_ENCRYPTED_EXTENSIONS, &msg, &len);
+    if (r) return r;
+    tls_transcript_add(c, msg, len);
+
+    uint8_t req_ctx[256];
+    size_t req_ctx_len = 0;
+    if (!c->resumed) {
+        int ht;
+        r = tls_next_handshake(c, &ht, &msg, &len);
+        if (r) return r;
+        if (ht == TLS_HT_CERTIFICATE_REQUEST) {
+            if (len < 5 || msg[4] > len - 5) return -EPROTO;
+            c->cert_requested = 1;
+            req_ctx_len = msg[4];
+            memcpy(req_ctx, msg + 5, req_ctx_len);
+            tls_transcript_add(c, msg, len);
+            r = tls_next_handshake(c, &ht, &msg, &len);
+            if (r) return r;
+        }
+        if (ht != TLS_HT_CERTIFICATE) return -EPROTO;
+        r = tls13_certificate(c, msg + 4, len - 4);
+        if (r) return r;
+        tls_transcript_add(c, msg, len);
+
+        r = tls_expect(c, TLS_HT_CERTIFICATE_VERIFY, &msg, &len);
+        if (r) return r;
+        r = tls13_certificate_verify(c, msg + 4, len - 4);
+        if (r) return r;
+        tls_transcript_add(c, msg, len);
+    }
+
+    r = tls_expect(c, TLS_HT_FINISHED, &msg, &len);
+    if (r) return r;
+    tls_transcript_hash(c, hash);
+    tls13_finished(s_hs, hash, verify);
+    if (len != 4 + 32 || !tls_memeq(msg + 4, verify, 32)) return -EBADMSG;
+    tls_transcript_add(c, msg, len);
+
+    tls_transcript_hash(c, hash);
+    tls13_derive(master, "c ap traffic", hash, c_ap);
+    tls13_derive(master, "s ap traffic", hash, s_ap);
+
+    static const uint8_t ccs = 1;
+    r = tls_write_record(c, TLS_RT_CHANGE_CIPHER_SPEC, &ccs, 1);
+    if (r) return r;
+    tls13_set_keys(c, &c->tx, c_hs);
+
+    if (c->cert_requested) {
+        /* No client certificate: empty list */
+        uint8_t m[4 + 1 + 255 + 3];
+        m[0] = TLS_HT_CERTIFICATE;
+        m[4] = req_ctx_len;
+        memcpy(m + 5, req_ctx, req_ctx_len);
+        put24(m + 5 + req_ctx_len, 0);
+        put24(m + 1, 1 + req_ctx_len + 3);
+        r = tls_send_handshake(c, m, 4 + 1 + req_ctx_len + 3);
+        if (r) return r;
+    }
+
+    uint8_t fin[4 + 32];
+    fin[0] = TLS_HT_FINISHED;
+    put24(fin + 1, 32);
+    tls_transcript_hash(c, hash);
+    tls13_finished(c_hs, hash, fin + 4);
+    r = tls_send_handshake(c, fin, sizeof(fin));
+    if (r) return r;
+
+    tls_transcript_hash(c, hash);
+    tls13_derive(master, "res master", hash, c->res_master);
+    tls13_set_keys(c, &c->tx, c_ap);
+    tls13_set_keys(c, &c->rx, s_ap);
+
+    memset(hs, 0, 32);
+    memset(master, 0, 32);
+    memset(ecdhe, 0, 32);
+    return 0;
+}
+
+static void tls13_new_ticket(tls_conn_t* c, const uint8_t* body, size_t len) {
+    tls_rd_t r;
+    tls_session_t s;
+
+    rd_init(&r, body, len);
+    uint32_t lifetime = rd_u32(&r);
+    uint32_t age_add = rd_u32(&r);
+    uint8_t nonce_len = rd_u8(&r);
+    const uint8_t* nonce = rd_bytes(&r, nonce_len);
+    uint16_t tlen = rd_u16(&r);
+    const uint8_t* ticket = rd_bytes(&r, tlen);
+    if (r.err || tlen == 0 || tlen > TLS_TICKET_MAX || lifetime == 0) return;
+
+    memset(&s, 0, sizeof(s));
+    strcpy(s.host, c->host);
+    s.version = TLS13;
+    s.suite = c->suite;
+    s.issued = net_time_ms();
+    s.lifetime = lifetime > TLS_TICKET_LIFETIME ? TLS_TICKET_LIFETIME : lifetime;
+    s.age_add = age_add;
+    tls13_expand_label(c->res_master, "resumption", nonce, nonce_len, s.secret, 32);
+    s.ticket = (uint8_t*)kmalloc(tlen);
+    if (!s.ticket) return;
+    memcpy(s.ticket, ticket, tlen);
+    s.ticket_len = tlen;
+    tls_session_put(&s);
+}
+
+static int tls13_key_update(tls_conn_t* c, const uint8_t* body, size_t len) {
+    uint8_t next[32];
+    if (len != 1 || body[0] > 1) return -EPROTO;
+
+    tls13_expand_label(c->rx.secret, "traffic upd", NULL, 0, next, 32);
+    tls13_set_keys(c, &c->rx, next);
+
+    if (body[0] == 1) {
+        uint8_t m[5] = { TLS_HT_KEY_UPDATE, 0, 0, 1, 0 };
+        int r = tls_write_record(c, TLS_RT_HANDSHAKE, m, sizeof(m));
+        if (r) return r;
+        tls13_expand_label(c->tx.secret, "traffic upd", NULL, 0, next, 32);
+        tls13_set_keys(c, &c->tx, next);
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------------------- */
+/* TLS 1.2                                                                 */
+/* ----------------------------------------------------------------------- */
+
+static int tls12_server_key_exchange(tls_conn_t* c, const uint8_t* body, size_t len, uint8_t share[32]) {
+    tls_rd_t r;
+    rd_init(&r, body, len);
+    uint8_t curve_type = rd_u8(&r);
+    uint16_t group = rd_u16(&r);
+    uint8_t klen = rd_u8(&r);
+    const uint8_t* key = rd_bytes(&r, klen);
+    size_t params_len = len - r.n;
+    uint16_t alg = rd_u16(&r);
+    size_t sl = rd_u16(&r);
+    const uint8_t* sig = rd_bytes(&r, sl);
+    if (r.err || r.n || curve_type != 3 || group != TLS_GROUP_X25519 || klen != 32) return -EPROTO;
+
+    /* ECDHE_ECDSA suites are only usable with Ed25519 certificates (RFC 8422) */
+    int ecdsa = c->suite == TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256 ||
+                c->suite == TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256;
+    if (ecdsa != (c->peer_key.type == X509_KEY_ED25519)) return -EPROTO;
+
+    uint8_t* signed_data = (uint8_t*)kmalloc(64 + params_len);
+    if (!signed_data) return -ENOMEM;
+    memcpy(signed_data, c->client_random, 32);
+    memcpy(signed_data + 32, c->server_random, 32);
+    memcpy(signed_data + 64, body, params_len);
+    int v = tls_verify(c, alg, signed_data, 64 + params_len, sig, sl);
+    kfree(signed_data);
+    if (v) return v;
+
+    memcpy(share, key, 32);
+    return 0;
+}
+
+static int tls12_new_ticket(tls_conn_t* c, const uint8_t* body, size_t len) {
+    tls_rd_t r;
+    rd_init(&r, body, len);
+    uint32_t lifetime = rd_u32(&r);
+    uint16_t tlen = rd_u16(&r);
+    const uint8_t* ticket = rd_bytes(&r, tlen);
+    if (r.err) return -EPROTO;
+    if (tlen == 0 || tlen > TLS_TICKET_MAX) return 0;   /* Server declined */
+
+    if (c->new_ticket) kfree(c->new_ticket);
+    c->new_ticket = (uint8_t*)kmalloc(tlen);
+    if (!c->new_ticket) return -ENOMEM;
+    memcpy(c->new_ticket, ticket, tlen);
+    c->new_ticket_len = tlen;
+    c->new_ticket_lifetime = lifetime;
+    return 0;
+}
+
+/* Server's [NewSessionTicket] ChangeCipherSpec Finished */
+static int tls12_server_finished(tls_conn_t* c) {
+    uint8_t* msg;
+    size_t len;
+    uint8_t verify[12];
+    int ht;
+    int r = tls_next_handshake(c, &ht, &msg, &len);
+    if (r) return r;
+
+    if (ht == TLS_HT_NEW_SESSION_TICKET) {
+        if (!c->ticket_acked) return -EPROTO;
+        r = tls12_new_ticket(c, msg + 4, len - 4);
+        if (r) return r;
+        tls_transcript_add(c, msg, len);
+        r = tls_next_handshake(c, &ht, &msg, &len);
+        if (r) return r;
+    }
+    if (ht != TLS_HT_CCS) return -EPROTO;
+    c->rx.active = 1;
+
+    r = tls_expect(c, TLS_HT_FINISHED, &msg, &len);
+    if (r) return r;
+    tls12_finished(c, "server finished", verify);
+    if (len != 4 + 12 || !tls_memeq(msg + 4, verify, 12)) return -EBADMSG;
+    tls_transcript_add(c, msg, len);
+    return 0;
+}
+
+static int tls12_client_finished(tls_conn_t* c) {
+    static const uint8_t ccs = 1;
+    uint8_t fin[4 + 12];
+    int r = tls_write_record(c, TLS_RT_CHANGE_CIPHER_SPEC, &ccs, 1);
+    if (r) return r;
+    c->tx.active = 1;
+
+    fin[0] = TLS_HT_FINISHED;
+    put24(fin + 1, 12);
+    tls12_finished(c, "client finished", fin + 4);
+    return tls_send_handshake(c, fin, sizeof(fin));
+}
+
+static int tls12_handshake(tls_conn_t* c) {
+    uint8_t* msg;
+    size_t len;
+    uint8_t share[32], pms[32];
+    int ht, r;
+
+    if (c->resumed) {
+        memcpy(c->master, c->offer.secret, 48);
+        tls12_set_keys(c);
+        r = tls12_server_finished(c);
+        if (r) return r;
+        return tls12_client_finished(c);
+    }
+
+    r = tls_expect(c, TLS_HT_CERTIFICATE, &msg, &len);
+    if (r) return r;
+    {
+        tls_rd_t rd;
+        rd_init(&rd, msg + 4, len - 4);
+        size_t list = rd_u24(&rd);
+        size_t cl = rd_u24(&rd);
+        const uint8_t* cert = rd_bytes(&rd, cl);
+        if (rd.err || list != len - 7) return -EPROTO;
+        r = tls_take_leaf(c, cert, cl);
+        if (r) return r;
+    }
+    tls_transcript_add(c, msg, len);
+
+    r = tls_expect(c, TLS_HT_SERVER_KEY_EXCHANGE, &msg, &len);
+    if (r) return r;
+    r = tls12_server_key_exchange(c, msg + 4, len - 4, share);
+    if (r) return r;
+    tls_transcript_add(c, msg, len);
+
+    r = tls_next_handshake(c, &ht, &msg, &len);
+    if (r) return r;
+    if (ht == TLS_HT_CERTIFICATE_REQUEST) {
+        c->cert_requested = 1;
+        tls_transcript_add(c, msg, len);
+        r = tls_next_handshake(c, &ht, &msg, &len);
+        if (r) return r;
+    }
+    if (ht != TLS_HT_SERVER_HELLO_DONE || len != 4) return -EPROTO;
+    tls_transcript_add(c, msg, len);
+
+    if (c->cert_requested) {
+        static const uint8_t empty_cert[7] = { TLS_HT_CERTIFICATE, 0, 0, 3, 0, 0, 0 };
+        r = tls_send_handshake(c, empty_cert, sizeof(empty_cert));
+        if (r) return r;
+    }
+
+    uint8_t cke[4 + 1 + 32];
+    cke[0] = TLS_HT_CLIENT_KEY_EXCHANGE;
+    put24(cke + 1, 33);
+    cke[4] = 32;
+    memcpy(cke + 5, c->x25519_pub, 32);
+    r = tls_send_handshake(c, cke, sizeof(cke));
+    if (r) return r;
+
+    x25519(pms, c->x25519_priv, share);
+    uint8_t acc = 0;
+    for (int i = 0; i < 32; i++) acc |= pms[i];
+    if (!acc) return -EPROTO;
+
+    if (c->ems) {
+        uint8_t hash[32];
+        tls_transcript_hash(c, hash);
+        tls12_prf_sha256(pms, 32, "extended master secret", hash, 32, c->master, 48);
+    } else {
+        uint8_t seed[64];
+        memcpy(seed, c->client_random, 32);
+        memcpy(seed + 32, c->server_random, 32);
+        tls12_prf_sha256(pms, 32, "master secret", seed, 64, c->master, 48);
+    }
+    memset(pms, 0, 32);
+    tls12_set_keys(c);
+
+    r = tls12_client_finished(c);
+    if (r) return r;
+    return tls12_server_finished(c);
+}
+
+static void tls12_save_session(tls_conn_t* c) {
+    tls_session_t s;
+
+    if (!c->new_ticket && !c->session_id_len) return;
+    if (c->resumed && !c->new_ticket) {
+        tls_session_put(&c->offer);     /* Same session again */
+        return;
+    }
+
+    memset(&s, 0, sizeof(s));
+    strcpy(s.host, c->host);
+    s.version = TLS12;
+    s.suite = c->suite;
+    s.ems = c->ems;
+    s.issued = net_time_ms();
+    s.lifetime = TLS_TICKET_LIFETIME;
+    memcpy(s.secret, c->master, 48);
+    if (c->new_ticket) {
+        if (c->new_ticket_lifetime && c->new_ticket_lifetime < s.lifetime) s.lifetime = c->new_ticket_lifetime;
+        s.ticket = c->new_ticket;
+        s.ticket_len = c->new_ticket_len;
+        c->new_ticket = NULL;
+    } else {
+        s.session_id_len = c->session_id_len;
+        memcpy(s.session_id, c->session_id, c->session_id_len);
+    }
+    tls_session_put(&s);
+}
+
+/* ----------------------------------------------------------------------- */
+/* Public API                                                              */
+/* ----------------------------------------------------------------------- */
+
+static void tls_free(tls_conn_t* c) {
+    if (c->rbuf) kfree(c->rbuf);
+    if (c->wbuf) kfree(c->wbuf);
+    if (c->hs) kfree(c->hs);
+    if (c->new_ticket) kfree(c->new_ticket);
+    if (c->offer.ticket) kfree(c->offer.ticket);
+    memset(c, 0, sizeof(*c));
+    kfree(c);
+}
+
+int tls_connect(tls_conn_t** out, int fd, const char* hostname) {
+    tls_conn_t* c = (tls_conn_t*)kmalloc(sizeof(tls_conn_t));
+    if (!c) return -ENOMEM;
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+    strncpy(c->host, hostname, TLS_HOST_MAX - 1);
+    c->rbuf = (uint8_t*)kmalloc(TLS_RECORD_MAX);
+    c->wbuf = (uint8_t*)kmalloc(TLS_WRITE_MAX);
+    c->hs_cap = 8192;
+    c->hs = (uint8_t*)kmalloc(c->hs_cap);
+    if (!c->rbuf || !c->wbuf || !c->hs) {
+        tls_free(c);
+        return -ENOMEM;
+    }
+
+    aes_init();
+    sha256_init(&c->transcript);
+    prng_fill(c->client_random, 32);
+    prng_fill(c->x25519_priv, 32);
+    x25519_public(c->x25519_pub, c->x25519_priv);
+    c->offered = tls_session_take(c->host, &c->offer);
+
+    uint8_t share[32];
+    uint8_t* msg;
+    size_t len;
+    int psk_ok;
+    int r = tls_client_hello(c);
+    if (!r) r = tls_expect(c, TLS_HT_SERVER_HELLO, &msg, &len);
+    if (!r) r = tls_server_hello(c, msg + 4, len - 4, share, &psk_ok);
+    if (!r) {
+        tls_transcript_add(c, msg, len);
+        r = c->version == TLS13 ? tls13_handshake(c, share) : tls12_handshake(c);
+    }
+
+    if (r) {
+        serial("[TLS] %s: handshake failed (%d)\n", c->host, r);
+        if (r == -EPROTO) tls_send_alert(c, 2, TLS_ALERT_HANDSHAKE_FAILURE);
+        else if (r == -EBADMSG) tls_send_alert(c, 2, c->rx.active ? TLS_ALERT_BAD_RECORD_MAC : TLS_ALERT_DECRYPT_ERROR);
+        tls_free(c);                    /* Drops the offered session too */
+        return r;
+    }
+
+    if (c->version == TLS12) tls12_save_session(c);
+    memset(c->x25519_priv, 0, 32);
+    if (c->hs_len == c->hs_drop) c->hs_len = c->hs_drop = 0;
+
+    strcpy(c->info, c->version == TLS13 ? "TLSv1.3 " : "TLSv1.2 ");
+    strcat(c->info, tls_suite_name(c->suite));
+    if (c->resumed) strcat(c->info, " (resumed)");
+    serial("[TLS] %s: %s\n", c->host, c->info);
+
+    *out = c;
+    return 0;
+}
+
+const char* tls_conn_info(const tls_conn_t* c) {
+    return c->info;
+}
+
+int tls_send(tls_conn_t* c, const void* buf, size_t len) {
+    const uint8_t* p = (const uint8_t*)buf;
+    size_t done = 0;
+    while (done < len) {
+        size_t n = len - done;
+        if (n > TLS_MAX_PLAINTEXT) n = TLS_MAX_PLAINTEXT;
+        int r = tls_write_record(c, TLS_RT_APPLICATION_DATA, p + done, n);
+        if (r) return done ? (int)done : r;
+        done += n;
+    }
+    return (int)done;
+}
+
+/* Post-handshake messages: tickets, key updates (1.3); renegotiation is refused */
+static int tls_post_handshake(tls_conn_t* c) {
+    int ht;
+    uint8_t* msg;
+    size_t len;
+    while (tls_hs_pop(c, &ht, &msg, &len)) {
+        if (c->version == TLS13 && ht == TLS_HT_NEW_SESSION_TICKET) {
+            tls13_new_ticket(c, msg + 4, len - 4);
+        } else if (c->version == TLS13 && ht == TLS_HT_KEY_UPDATE) {
+            int r = tls13_key_update(c, msg + 4, len - 4);
+            if (r) return r;
+        } else if (c->version == TLS12 && ht == TLS_HT_HELLO_REQUEST) {
+            tls_send_alert(c, 1, 100);      /* no_renegotiation */
+        } else {
+            return -EPROTO;
+        }
+    }
+    return 0;
+}
+
+int tls_recv(tls_conn_t* c, void* buf, size_t len) {
+    for (;;) {
+        if (c->app_len) {
+            size_t n = len < c->app_len ? len : c->app_len;
+            memcpy(buf, c->app, n);
+            c->app += n;
+            c->app_len -= n;
+            return (int)n;
+        }
+        if (c->closed) return 0;
+
+        int type;
+        uint8_t* data;
+        size_t n;
+        int r = tls_read_record(c, &type, &data, &n);
+        if (r > 0) {
+            c->closed = 1;      /* EOF without close_notify: treated as the end */
+            return 0;
+        }
+        if (r < 0) {
+            if (r == -EBADMSG) tls_send_alert(c, 2, TLS_ALERT_BAD_RECORD_MAC);
+            return r;
+        }
+
+        switch (type) {
+        case TLS_RT_APPLICATION_DATA:
+            c->app = data;
+            c->app_len = n;
+            break;
+        case TLS_RT_HANDSHAKE:
+            if (n == 0) return -EPROTO;
+            r = tls_hs_append(c, data, n);
+            if (!r) r = tls_post_handshake(c);
+            if (r) return r;
+            break;
+        case TLS_RT_ALERT:
+            r = tls_alert(c, data, n);
+            if (r > 0) return 0;
+            if (r < 0) return r;
+            break;
+        default:
+            tls_send_alert(c, 2, TLS_ALERT_UNEXPECTED);
+            return -EPROTO;
+        }
+    }
+}
+
+void tls_close(tls_conn_t* c) {
+    if (!c) return;
+    if (!c->closed) tls_send_alert(c, 1, TLS_ALERT_CLOSE_NOTIFY);
+    tls_free(c);
+}
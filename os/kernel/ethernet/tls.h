@@ -6,29 +6,46 @@
 extern "C" {
 #endif
 
-typedef enum {
-    TLS_STATE_CLOSED,
-    TLS_STATE_HANDSHAKE,
-    TLS_STATE_CONNECTED,
-    TLS_STATE_ERROR
-} tls_state_t;
+/* TLS 1.3 / 1.2 client over a connected stream socket.
+ *
+ * Key exchange is X25519 only; server signatures may be Ed25519,
+ * RSA-PSS or RSA PKCS#1 v1.5 (SHA-256). Records are protected with
+ * AES-128-GCM or ChaCha20-Poly1305, whichever this CPU runs faster.
+ * Sessions are cached per host name: TLS 1.3 tickets (PSK with DHE),
+ * TLS 1.2 session IDs and session tickets.
+ *
+ * The handshake signature is checked against the leaf certificate, but
+ * there is no trust store, so the chain itself is not validated.
+ */
 
-typedef struct {
-    tls_state_t state;
-    uint32_t ip;
-    uint16_t port;
-} tls_context_t;
+#define TLS_MAX_PLAINTEXT   16384
+#define TLS_HOST_MAX        128
+#define TLS_SESSION_CACHE   8
+#define TLS_TICKET_MAX      2048
+#define TLS_TICKET_LIFETIME (7 * 24 * 3600)  /* Seconds, RFC 8446 cap */
+#define TLS_HANDSHAKE_MAX   65536            /* Largest handshake message (cert chains) */
 
-/* Initialize a TLS context */
-void tls_init_context(tls_context_t* ctx, uint32_t ip, uint16_t port);
+typedef struct tls_conn tls_conn_t;
 
-/* Create Client Hello packet (returns length) */
-int tls_create_client_hello(tls_context_t* ctx, const char* hostname, uint8_t* buf, size_t max_len);
+/* Run the handshake on fd (already connected). hostname goes into SNI
+   and keys the session cache. 0 and *out set, or -errno: -EPROTO for
+   protocol failures, -EBADMSG for bad MACs/signatures, -ECONNRESET when
+   the server sent an alert. The socket is left open either way. */
+int  tls_connect(tls_conn_t** out, int fd, const char* hostname);
 
-/* Handle received TCP data for TLS */
-/* Returns 0 on success, -1 on error */
-int tls_handle_rx(tls_context_t* ctx, const uint8_t* data, size_t len);
+/* Bytes written / read, or -errno. recv returns 0 on close_notify or EOF. */
+int  tls_send(tls_conn_t* c, const void* buf, size_t len);
+int  tls_recv(tls_conn_t* c, void* buf, size_t len);
+
+/* Sends close_notify and frees the connection; the caller closes fd */
+void tls_close(tls_conn_t* c);
+
+/* "TLSv1.3 TLS_AES_128_GCM_SHA256", with " (resumed)" when applicable */
+const char* tls_conn_info(const tls_conn_t* c);
+
+void tls_session_flush(void);
+void tls_print_sessions(void);
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
@@ -1,30 +1,83 @@
 #include "udp.h"
+#include "checksum.h"
+#include "net_device.h"
 #include "../mm/kmalloc.h"
 #include "../string.h"
+#include <errno.h>
 
 extern void serial(const char *fmt, ...);
 
-static udp_callback_t udp_cb = 0;
+typedef struct udp_binding {
+    struct udp_binding* next;
+    uint16_t port;
+    udp_rx_t handler;
+    void* user;
+} udp_binding_t;
 
-void udp_set_callback(udp_callback_t callback) {
-    udp_cb = callback;
+static udp_binding_t* udp_ports[UDP_HASH_SIZE];
+static uint16_t next_ephemeral = 49152;
+
+static udp_binding_t* udp_lookup(uint16_t port) {
+    udp_binding_t* b = udp_ports[port % UDP_HASH_SIZE];
+    while (b && b->port != port) b = b->next;
+    return b;
+}
+
+int udp_bind(uint16_t port, udp_rx_t handler, void* user) {
+    if (port == 0 || !handler) return -EINVAL;
+    if (udp_lookup(port)) return -EADDRINUSE;
+
+    udp_binding_t* b = (udp_binding_t*)kmalloc(sizeof(udp_binding_t));
+    if (!b) return -ENOMEM;
+    b->port = port;
+    b->handler = handler;
+    b->user = user;
+    b->next = udp_ports[port % UDP_HASH_SIZE];
+    udp_ports[port % UDP_HASH_SIZE] = b;
+    return 0;
+}
+
+void udp_unbind(uint16_t port) {
+    udp_binding_t** pp = &udp_ports[port % UDP_HASH_SIZE];
+    while (*pp) {
+        if ((*pp)->port == port) {
+            udp_binding_t* b = *pp;
+            *pp = b->next;
+            kfree(b);
+            return;
+        }
+        pp = &(*pp)->next;
+    }
 }
 
-void udp_handle_packet(net_device_t* dev, uint32_t src_ip, const void* data, size_t len) {
+uint16_t udp_alloc_port(void) {
+    for (int i = 0; i < 16384; i++) {
+        uint16_t p = next_ephemeral++;
+        if (next_ephemeral == 0) next_ephemeral = 49152;
+        if (!udp_lookup(p)) return p;
+    }
+    return 0;
+}
+
+void udp_handle_packet(net_device_t* dev, uint32_t src_ip, uint32_t dst_ip, const void* data, size_t len) {
     (void)dev;
     if (len < sizeof(udp_header_t)) return;
     
     udp_header_t* hdr = (udp_header_t*)data;
     uint16_t src_port = ntohs(hdr->src_port);
     uint16_t dst_port = ntohs(hdr->dst_port);
-    uint16_t data_len = ntohs(hdr->len) - sizeof(udp_header_t);
-    
-    serial("[UDP] Recv from %d.%d.%d.%d:%d to port %d len %d\n",
-           src_ip & 0xFF, (src_ip>>8)&0xFF, (src_ip>>16)&0xFF, (src_ip>>24)&0xFF,
-           src_port, dst_port, data_len);
+    uint16_t ulen = ntohs(hdr->len);
+    if (ulen < sizeof(udp_header_t) || ulen > len) return;
 
-    if (udp_cb) {
-        udp_cb(src_ip, src_port, (const uint8_t*)data + sizeof(udp_header_t), data_len);
+    /* Zero means the sender did not compute one (allowed over IPv4) */
+    if (hdr->checksum != 0 &&
+        csum_fold(csum_partial(data, ulen, csum_tcpudp_nofold(src_ip, dst_ip, ulen, IP_PROTO_UDP, 0))) != 0)
+        return;
+    uint16_t data_len = ulen - sizeof(udp_header_t);
+    
+    udp_binding_t* b = udp_lookup(dst_port);
+    if (b) {
+        b->handler(b->user, src_ip, src_port, (const uint8_t*)data + sizeof(udp_header_t), data_len);
     }
 }
 
@@ -37,13 +90,14 @@ int udp_send(net_device_t* dev, uint32_t dst_ip, uint16_t src_port, uint16_t dst
     hdr->src_port = htons(src_port);
     hdr->dst_port = htons(dst_port);
     hdr->len = htons(total_len);
-    hdr->checksum = 0; /* Optional in IPv4 */
+    hdr->checksum = 0;
 
-    memcpy(packet + sizeof(udp_header_t), data, len);
+    uint32_t sum = csum_tcpudp_nofold(dev->ip, dst_ip, total_len, IP_PROTO_UDP, 0);
+    sum = csum_add(sum, csum_partial_copy(packet + sizeof(udp_header_t), data, len, 0));
+    uint16_t check = csum_fold(csum_partial(hdr, sizeof(udp_header_t), sum));
+    hdr->checksum = check ? check : 0xFFFF; /* 0 is reserved for "no checksum" */
 
     int ret = ipv4_send(dev, dst_ip, IP_PROTO_UDP, packet, total_len);
     kfree(packet);
-    
-    if (ret == 0) serial("[UDP] Sent %d bytes to %x:%d\n", len, dst_ip, dst_port);
     return ret;
-}
\ No newline at end of file
+}
@@ -12,11 +12,17 @@ typedef struct {
     uint16_t checksum;
 } __attribute__((packed)) udp_header_t;
 
-void udp_handle_packet(net_device_t* dev, uint32_t src_ip, const void* data, size_t len);
+void udp_handle_packet(net_device_t* dev, uint32_t src_ip, uint32_t dst_ip, const void* data, size_t len);
 int udp_send(net_device_t* dev, uint32_t dst_ip, uint16_t src_port, uint16_t dst_port, const void* data, size_t len);
 
-typedef void (*udp_callback_t)(uint32_t src_ip, uint16_t src_port, const uint8_t* data, size_t len);
-void udp_set_callback(udp_callback_t callback);
+/* Port demultiplexing: datagrams for a bound port go to its handler only */
+#define UDP_HASH_SIZE 32
+
+typedef void (*udp_rx_t)(void* user, uint32_t src_ip, uint16_t src_port, const uint8_t* data, size_t len);
+
+int  udp_bind(uint16_t port, udp_rx_t handler, void* user);   /* 0 or -EADDRINUSE/-ENOMEM */
+void udp_unbind(uint16_t port);
+uint16_t udp_alloc_port(void);                                 /* Free ephemeral port, 0 if none */
 
 #ifdef __cplusplus
 }
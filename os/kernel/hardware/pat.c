@@ -0,0 +1,51 @@
+#include "pat.h"
+#include "msr.h"
+#include "../mm/paging.h"
+
+extern void serial(const char *fmt, ...);
+
+/* PA0..PA7: WB, WC, UC-, UC, WB, WC, UC-, UC */
+#define PAT_LO  0x00070106u
+#define PAT_HI  0x00070106u
+
+static bool pat_ok = false;
+
+static bool cpu_has_pat(void) {
+    uint32_t a, d;
+    asm volatile("cpuid" : "=a"(a), "=d"(d) : "a"(1) : "ebx", "ecx");
+    return (d & (1u << 16)) != 0;
+}
+
+bool pat_init(void) {
+    if (!cpu_has_pat()) {
+        serial("[PAT] Not supported, framebuffer stays uncached\n");
+        return false;
+    }
+
+    /* SDM 11.12.4: change the PAT with caches disabled and flushed so no
+       line is left cached under the old memory type. */
+    uint32_t flags, cr0;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    asm volatile("mov %0, %%cr0" : : "r"((cr0 | 0x40000000u) & ~0x20000000u) : "memory");
+    asm volatile("wbinvd" : : : "memory");
+
+    wrmsr(MSR_IA32_PAT, PAT_LO, PAT_HI);
+
+    asm volatile("wbinvd" : : : "memory");
+    asm volatile("mov %%cr3, %%eax; mov %%eax, %%cr3" : : : "eax", "memory");
+    asm volatile("mov %0, %%cr0" : : "r"(cr0) : "memory");
+    if (flags & 0x200) asm volatile("sti");
+
+    if (!pat_ok) serial("[PAT] PA1 set to write-combining\n");
+    pat_ok = true;
+    return true;
+}
+
+bool pat_enabled(void) {
+    return pat_ok;
+}
+
+uint32_t pat_wc_flags(void) {
+    return pat_ok ? PAGE_PWT : (PAGE_PCD | PAGE_PWT);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Page Attribute Table.
+ *
+ * pat_init() reprograms PA1 (PTE with only PWT set) from write-through to
+ * write-combining; PCD and PCD|PWT keep their power-on meaning (UC-, UC).
+ * Every CPU must run it before touching WC mappings: the BSP before the
+ * framebuffer is mapped, each AP from ap_main.
+ */
+#define MSR_IA32_PAT    0x277
+
+bool pat_init(void);
+bool pat_enabled(void);
+
+/* Page flags for a write-combining mapping, or uncached without PAT */
+uint32_t pat_wc_flags(void);
+
+#ifdef __cplusplus
+}
+#endif
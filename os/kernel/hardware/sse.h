@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline int cpu_has_sse2(void) {
+    uint32_t a, d;
+    asm volatile("cpuid" : "=a"(a), "=d"(d) : "a"(1) : "ebx", "ecx");
+    return (d & (1 << 26)) != 0;
+}
+
+static inline uint32_t cpuid1_ecx(void) {
+    uint32_t a, c;
+    asm volatile("cpuid" : "=a"(a), "=c"(c) : "a"(1) : "ebx", "edx");
+    return c;
+}
+
+/* Enhanced REP MOVSB/STOSB (leaf 7, EBX bit 9) */
+static inline int cpu_has_erms(void) {
+    uint32_t a, b, c, d;
+    asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(0));
+    if (a < 7) return 0;
+    asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(7), "c"(0));
+    return (b & (1 << 9)) != 0;
+}
+
+static inline int cpu_has_ssse3(void)  { return (cpuid1_ecx() & (1 << 9)) != 0; }
+static inline int cpu_has_pclmul(void) { return (cpuid1_ecx() & (1 << 1)) != 0; }
+static inline int cpu_has_aesni(void)  { return (cpuid1_ecx() & (1 << 25)) != 0; }
+static inline int cpu_has_rdrand(void) { return (cpuid1_ecx() & (1 << 30)) != 0; }
+
+/* Allow SSE instructions in ring 0: CR0.EM=0, CR0.MP=1, CR4.OSFXSR|OSXMMEXCPT.
+   The kernel itself is built without -msse, so only code that opts in with
+   __attribute__((target("sse2"))) touches XMM state. */
+static inline void sse_enable(void) {
+    uint32_t cr0, cr4;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~(1u << 2);
+    cr0 |= (1u << 1);
+    asm volatile("mov %0, %%cr0" :: "r"(cr0));
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= (1u << 9) | (1u << 10);
+    asm volatile("mov %0, %%cr4" :: "r"(cr4));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,516 @@
+#include "virtio.h"
+#include <errno.h>
+#include "../mm/kmalloc.h"
+#include "../mm/vmm.h"
+#include "../string.h"
+#include "../arch/i386/io.h"
+#include "../interrupts/irq.h"
+
+extern void serial(const char *fmt, ...);
+
+/* Minimal PCI Config Access */
+#define PCI_CONFIG_ADDR 0xCF8
+#define PCI_CONFIG_DATA 0xCFC
+
+static uint32_t pci_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    uint32_t addr = (1u << 31) | (bus << 16) | (slot << 11) | (func << 8) | (offset & 0xFC);
+    outl(PCI_CONFIG_ADDR, addr);
+    return inl(PCI_CONFIG_DATA);
+}
+
+static void pci_write(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t val) {
+    uint32_t addr = (1u << 31) | (bus << 16) | (slot << 11) | (func << 8) | (offset & 0xFC);
+    outl(PCI_CONFIG_ADDR, addr);
+    outl(PCI_CONFIG_DATA, val);
+}
+
+static uint8_t pci_read8(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return (pci_read(bus, slot, func, offset) >> ((offset & 3) * 8)) & 0xFF;
+}
+
+/* Legacy I/O registers */
+#define VIRTIO_LEG_HOST_FEATURES  0x00
+#define VIRTIO_LEG_GUEST_FEATURES 0x04
+#define VIRTIO_LEG_QUEUE_PFN      0x08
+#define VIRTIO_LEG_QUEUE_SIZE     0x0C
+#define VIRTIO_LEG_QUEUE_SEL      0x0E
+#define VIRTIO_LEG_QUEUE_NOTIFY   0x10
+#define VIRTIO_LEG_STATUS         0x12
+#define VIRTIO_LEG_ISR            0x13
+#define VIRTIO_LEG_CONFIG         0x14    /* Without MSI-X */
+#define VIRTIO_LEG_ALIGN          4096
+
+/* Modern common configuration */
+#define VIRTIO_COM_DFSELECT       0x00
+#define VIRTIO_COM_DF             0x04
+#define VIRTIO_COM_GFSELECT       0x08
+#define VIRTIO_COM_GF             0x0C
+#define VIRTIO_COM_NUM_QUEUES     0x12
+#define VIRTIO_COM_STATUS         0x14
+#define VIRTIO_COM_GENERATION     0x15
+#define VIRTIO_COM_Q_SELECT       0x16
+#define VIRTIO_COM_Q_SIZE         0x18
+#define VIRTIO_COM_Q_ENABLE       0x1C
+#define VIRTIO_COM_Q_NOFF         0x1E
+#define VIRTIO_COM_Q_DESC         0x20
+#define VIRTIO_COM_Q_AVAIL        0x28
+#define VIRTIO_COM_Q_USED         0x30
+
+/* Vendor capability types */
+#define VIRTIO_CAP_COMMON         1
+#define VIRTIO_CAP_NOTIFY         2
+#define VIRTIO_CAP_ISR            3
+#define VIRTIO_CAP_DEVICE         4
+
+#define MMIO8(base, off)  (*(volatile uint8_t*)((base) + (off)))
+#define MMIO16(base, off) (*(volatile uint16_t*)((base) + (off)))
+#define MMIO32(base, off) (*(volatile uint32_t*)((base) + (off)))
+
+#define VQ_READ16(p)      (*(volatile uint16_t*)&(p))
+#define VQ_WRITE16(p, v)  (*(volatile uint16_t*)&(p) = (v))
+
+/* ------------------------------------------------------------------ */
+/* Discovery                                                           */
+/* ------------------------------------------------------------------ */
+
+/* Map the window a vendor capability points at, NULL if unusable */
+static volatile uint8_t* map_cap(uint8_t bus, uint8_t slot, uint8_t func, uint8_t cap) {
+    uint8_t bar = pci_read8(bus, slot, func, cap + 4);
+    uint32_t off = pci_read(bus, slot, func, cap + 8);
+    uint32_t len = pci_read(bus, slot, func, cap + 12);
+    if (bar > 5) return 0;
+
+    uint32_t val = pci_read(bus, slot, func, 0x10 + bar * 4);
+    if (val & 1) return 0;                              /* I/O BAR */
+    if (((val >> 1) & 3) == 2 && bar < 5 &&
+        pci_read(bus, slot, func, 0x14 + bar * 4) != 0) return 0;  /* Above 4 GB */
+
+    uint32_t phys = (val & 0xFFFFFFF0) + off;
+    if (phys == 0) return 0;
+    vmm_identity_map(phys & 0xFFFFF000, len + (phys & 0xFFF));
+    return (volatile uint8_t*)phys;
+}
+
+static int probe_modern(virtio_dev_t* d) {
+    if (!(pci_read(d->bus, d->slot, d->func, 0x04) & (1 << 20))) return 0;  /* No cap list */
+
+    uint8_t cap = pci_read8(d->bus, d->slot, d->func, 0x34) & 0xFC;
+    int guard = 48;
+    while (cap && guard--) {
+        uint8_t id = pci_read8(d->bus, d->slot, d->func, cap);
+        if (id == 0x09) {
+            uint8_t type = pci_read8(d->bus, d->slot, d->func, cap + 3);
+            volatile uint8_t** slot_ptr = 0;
+            if (type == VIRTIO_CAP_COMMON) slot_ptr = &d->common;
+            else if (type == VIRTIO_CAP_NOTIFY) slot_ptr = &d->notify_base;
+            else if (type == VIRTIO_CAP_ISR) slot_ptr = &d->isr;
+            else if (type == VIRTIO_CAP_DEVICE) slot_ptr = &d->cfg;
+
+            /* First usable capability of each type wins */
+            if (slot_ptr && !*slot_ptr) {
+                *slot_ptr = map_cap(d->bus, d->slot, d->func, cap);
+                if (type == VIRTIO_CAP_NOTIFY && *slot_ptr)
+                    d->notify_mult = pci_read(d->bus, d->slot, d->func, cap + 16);
+            }
+        }
+        cap = pci_read8(d->bus, d->slot, d->func, cap + 1) & 0xFC;
+    }
+    return d->common && d->notify_base && d->isr;
+}
+
+int virtio_pci_find(uint16_t legacy_id, uint16_t modern_id, int index, virtio_dev_t* d) {
+    for (int bus = 0; bus < 256; bus++) {
+        for (int slot = 0; slot < 32; slot++) {
+            for (int func = 0; func < 8; func++) {
+                uint32_t id = pci_read(bus, slot, func, 0);
+                if ((id & 0xFFFF) == 0xFFFF) {
+                    if (func == 0) break;
+                    continue;
+                }
+                uint16_t dev = id >> 16;
+                if ((id & 0xFFFF) == VIRTIO_PCI_VENDOR &&
+                    (dev == legacy_id || dev == modern_id) && index-- == 0) {
+                    memset(d, 0, sizeof(*d));
+                    d->bus = bus;
+                    d->slot = slot;
+                    d->func = func;
+                    d->irq = pci_read(bus, slot, func, 0x3C) & 0xFF;
+
+                    /* I/O, memory and bus mastering */
+                    uint32_t cmd = pci_read(bus, slot, func, 0x04);
+                    pci_write(bus, slot, func, 0x04, (cmd & 0xFFFF) | 0x7);
+
+                    if (probe_modern(d)) {
+                        d->modern = 1;
+                    } else {
+                        uint32_t bar0 = pci_read(bus, slot, func, 0x10);
+                        if (dev != legacy_id || !(bar0 & 1)) return -ENODEV;
+                        d->io = bar0 & 0xFFFC;
+                    }
+                    serial("[VIRTIO] %04x at %d:%d.%d, %s, IRQ %d\n", dev, bus, slot, func,
+                           d->modern ? "modern" : "legacy", d->irq);
+                    return 0;
+                }
+                /* Single-function device */
+                if (func == 0 && !(pci_read8(bus, slot, 0, 0x0E) & 0x80)) break;
+            }
+        }
+    }
+    return -ENODEV;
+}
+
+/* ------------------------------------------------------------------ */
+/* Status and features                                                 */
+/* ------------------------------------------------------------------ */
+
+static uint8_t get_status(virtio_dev_t* d) {
+    return d->modern ? MMIO8(d->common, VIRTIO_COM_STATUS) : inb(d->io + VIRTIO_LEG_STATUS);
+}
+
+static void set_status(virtio_dev_t* d, uint8_t s) {
+    if (d->modern) MMIO8(d->common, VIRTIO_COM_STATUS) = s;
+    else outb(d->io + VIRTIO_LEG_STATUS, s);
+}
+
+uint64_t virtio_begin(virtio_dev_t* d) {
+    set_status(d, 0);
+    if (d->modern) {
+        int spin = 1000000;
+        while (get_status(d) != 0 && --spin) asm volatile("pause");
+    }
+    set_status(d, VIRTIO_STATUS_ACK);
+    set_status(d, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER);
+
+    uint64_t offered;
+    if (d->modern) {
+        MMIO32(d->common, VIRTIO_COM_DFSELECT) = 0;
+        offered = MMIO32(d->common, VIRTIO_COM_DF);
+        MMIO32(d->common, VIRTIO_COM_DFSELECT) = 1;
+        offered |= (uint64_t)MMIO32(d->common, VIRTIO_COM_DF) << 32;
+    } else {
+        offered = inl(d->io + VIRTIO_LEG_HOST_FEATURES);
+    }
+    d->features = offered;
+    return offered;
+}
+
+int virtio_negotiate(virtio_dev_t* d, uint64_t wanted) {
+    uint64_t f = wanted & d->features;
+
+    if (d->modern) {
+        if (!(d->features & VIRTIO_FEATURE(VIRTIO_F_VERSION_1))) {
+            virtio_fail(d);
+            return -EIO;
+        }
+        f |= VIRTIO_FEATURE(VIRTIO_F_VERSION_1);
+        MMIO32(d->common, VIRTIO_COM_GFSELECT) = 0;
+        MMIO32(d->common, VIRTIO_COM_GF) = (uint32_t)f;
+        MMIO32(d->common, VIRTIO_COM_GFSELECT) = 1;
+        MMIO32(d->common, VIRTIO_COM_GF) = (uint32_t)(f >> 32);
+
+        uint8_t s = get_status(d) | VIRTIO_STATUS_FEATURES_OK;
+        set_status(d, s);
+        if (!(get_status(d) & VIRTIO_STATUS_FEATURES_OK)) {
+            virtio_fail(d);
+            return -EIO;
+        }
+    } else {
+        f &= 0xFFFFFFFFULL;
+        outl(d->io + VIRTIO_LEG_GUEST_FEATURES, (uint32_t)f);
+    }
+    d->features = f;
+    return 0;
+}
+
+int virtio_has(const virtio_dev_t* d, int bit) {
+    return (d->features & VIRTIO_FEATURE(bit)) != 0;
+}
+
+void virtio_driver_ok(virtio_dev_t* d) {
+    set_status(d, get_status(d) | VIRTIO_STATUS_DRIVER_OK);
+}
+
+void virtio_fail(virtio_dev_t* d) {
+    set_status(d, get_status(d) | VIRTIO_STATUS_FAILED);
+}
+
+uint16_t virtio_num_queues(virtio_dev_t* d) {
+    if (d->modern) return MMIO16(d->common, VIRTIO_COM_NUM_QUEUES);
+    uint16_t n = 0;
+    while (n < 64) {
+        outw(d->io + VIRTIO_LEG_QUEUE_SEL, n);
+        if (inw(d->io + VIRTIO_LEG_QUEUE_SIZE) == 0) break;
+        n++;
+    }
+    return n;
+}
+
+/* ------------------------------------------------------------------ */
+/* Device configuration                                                */
+/* ------------------------------------------------------------------ */
+
+uint8_t virtio_cfg8(virtio_dev_t* d, uint32_t off) {
+    if (d->modern) return d->cfg ? MMIO8(d->cfg, off) : 0;
+    return inb(d->io + VIRTIO_LEG_CONFIG + off);
+}
+
+uint16_t virtio_cfg16(virtio_dev_t* d, uint32_t off) {
+    if (d->modern) return d->cfg ? MMIO16(d->cfg, off) : 0;
+    return inw(d->io + VIRTIO_LEG_CONFIG + off);
+}
+
+uint32_t virtio_cfg32(virtio_dev_t* d, uint32_t off) {
+    if (d->modern) return d->cfg ? MMIO32(d->cfg, off) : 0;
+    return inl(d->io + VIRTIO_LEG_CONFIG + off);
+}
+
+/* Two reads; the modern generation counter catches a torn value */
+uint64_t virtio_cfg64(virtio_dev_t* d, uint32_t off) {
+    uint32_t lo, hi;
+    if (!d->modern) {
+        lo = virtio_cfg32(d, off);
+        hi = virtio_cfg32(d, off + 4);
+        return ((uint64_t)hi << 32) | lo;
+    }
+    uint8_t gen;
+    do {
+        gen = MMIO8(d->common, VIRTIO_COM_GENERATION);
+        lo = virtio_cfg32(d, off);
+        hi = virtio_cfg32(d, off + 4);
+    } while (gen != MMIO8(d->common, VIRTIO_COM_GENERATION));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* ------------------------------------------------------------------ */
+/* Interrupts                                                          */
+/* ------------------------------------------------------------------ */
+
+#define VIRTIO_MAX_DEVS 8
+
+static virtio_dev_t* irq_devs[VIRTIO_MAX_DEVS];
+static int irq_ndevs;
+
+/* Every virtio device is asked; the ISR read clears and is 0 if the
+   interrupt was not ours */
+static void virtio_irq(registers_t* r) {
+    (void)r;
+    for (int i = 0; i < irq_ndevs; i++) {
+        virtio_dev_t* d = irq_devs[i];
+        uint8_t isr = d->modern ? MMIO8(d->isr, 0) : inb(d->io + VIRTIO_LEG_ISR);
+        if (isr && d->irq_handler) d->irq_handler(d, isr);
+    }
+}
+
+int virtio_irq_attach(virtio_dev_t* d, void (*handler)(virtio_dev_t*, uint8_t)) {
+    if (irq_ndevs >= VIRTIO_MAX_DEVS || d->irq == 0 || d->irq > 15) return -EINVAL;
+    d->irq_handler = handler;
+
+    int shared = 0;
+    for (int i = 0; i < irq_ndevs; i++)
+        if (irq_devs[i]->irq == d->irq) shared = 1;
+    irq_devs[irq_ndevs++] = d;
+    if (!shared) irq_install_handler(d->irq, virtio_irq);
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Split virtqueues                                                    */
+/* ------------------------------------------------------------------ */
+
+/* Event index fields behind the rings (VIRTIO_F_EVENT_IDX) */
+static inline uint16_t* used_event(virtq_t* q) {
+    return (uint16_t*)((uint8_t*)q->avail + 4 + 2u * q->size);
+}
+
+static inline uint16_t* avail_event(virtq_t* q) {
+    return (uint16_t*)((uint8_t*)q->used + 4 + 8u * q->size);
+}
+
+int virtq_init(virtio_dev_t* d, virtq_t* q, uint16_t index, uint16_t max_size, int indirect) {
+    uint16_t size;
+    if (d->modern) {
+        MMIO16(d->common, VIRTIO_COM_Q_SELECT) = index;
+        size = MMIO16(d->common, VIRTIO_COM_Q_SIZE);
+    } else {
+        outw(d->io + VIRTIO_LEG_QUEUE_SEL, index);
+        size = inw(d->io + VIRTIO_LEG_QUEUE_SIZE);
+    }
+    if (size == 0) return -ENODEV;
+
+    /* Modern devices take any smaller power of two, legacy ones dictate */
+    if (d->modern) {
+        uint16_t want = 1;
+        while ((uint32_t)want * 2 <= size && (uint32_t)want * 2 <= max_size) want *= 2;
+        size = want;
+    }
+
+    /* Legacy layout: used ring on its own page, also valid for modern */
+    uint32_t avail_off = 16u * size;
+    uint32_t used_off = (avail_off + 6 + 2u * size + VIRTIO_LEG_ALIGN - 1) & ~(VIRTIO_LEG_ALIGN - 1);
+    uint32_t total = used_off + ((6 + 8u * size + VIRTIO_LEG_ALIGN - 1) & ~(VIRTIO_LEG_ALIGN - 1));
+
+    uint8_t* mem = (uint8_t*)kmalloc_aligned(total, VIRTIO_LEG_ALIGN);
+    void** cookie = (void**)kmalloc(size * sizeof(void*));
+    if (!mem || !cookie) {
+        if (mem) kfree(mem);
+        if (cookie) kfree(cookie);
+        return -ENOMEM;
+    }
+    memset(mem, 0, total);
+    memset(cookie, 0, size * sizeof(void*));
+
+    memset(q, 0, sizeof(*q));
+    q->dev = d;
+    q->index = index;
+    q->size = size;
+    q->desc = (virtq_desc_t*)mem;
+    q->avail = (virtq_avail_t*)(mem + avail_off);
+    q->used = (virtq_used_t*)(mem + used_off);
+    q->cookie = cookie;
+    q->event_idx = virtio_has(d, VIRTIO_F_EVENT_IDX);
+
+    for (uint16_t i = 0; i < size; i++) q->desc[i].next = i + 1;
+    q->num_free = size;
+
+    if (indirect && virtio_has(d, VIRTIO_F_INDIRECT_DESC)) {
+        q->indirect = (virtq_desc_t*)kmalloc_aligned(
+            (uint32_t)size * VIRTQ_INDIRECT_MAX * sizeof(virtq_desc_t), 16);
+    }
+
+    uint32_t phys = vmm_virt_to_phys(mem);
+    if (d->modern) {
+        MMIO16(d->common, VIRTIO_COM_Q_SIZE) = size;
+        MMIO32(d->common, VIRTIO_COM_Q_DESC) = phys;
+        MMIO32(d->common, VIRTIO_COM_Q_DESC + 4) = 0;
+        MMIO32(d->common, VIRTIO_COM_Q_AVAIL) = phys + avail_off;
+        MMIO32(d->common, VIRTIO_COM_Q_AVAIL + 4) = 0;
+        MMIO32(d->common, VIRTIO_COM_Q_USED) = phys + used_off;
+        MMIO32(d->common, VIRTIO_COM_Q_USED + 4) = 0;
+        uint16_t noff = MMIO16(d->common, VIRTIO_COM_Q_NOFF);
+        q->notify = (volatile uint16_t*)(d->notify_base + (uint32_t)noff * d->notify_mult);
+        MMIO16(d->common, VIRTIO_COM_Q_ENABLE) = 1;
+    } else {
+        outl(d->io + VIRTIO_LEG_QUEUE_PFN, phys / VIRTIO_LEG_ALIGN);
+    }
+    return 0;
+}
+
+void virtq_free(virtq_t* q) {
+    if (q->desc) kfree(q->desc);
+    if (q->cookie) kfree(q->cookie);
+    if (q->indirect) kfree(q->indirect);
+    memset(q, 0, sizeof(*q));
+}
+
+int virtq_add(virtq_t* q, const virtq_sg_t* sg, int n, void* cookie) {
+    if (n <= 0) return -EINVAL;
+
+    int direct = !(q->indirect && n > 1 && n <= VIRTQ_INDIRECT_MAX);
+    if (q->num_free < (direct ? n : 1)) return -ENOSPC;
+
+    uint16_t head = q->free_head;
+    if (direct) {
+        uint16_t i = head, last = head;
+        for (int k = 0; k < n; k++) {
+            q->desc[i].addr = sg[k].addr;
+            q->desc[i].len = sg[k].len;
+            q->desc[i].flags = (sg[k].write ? VIRTQ_DESC_F_WRITE : 0) |
+                               (k < n - 1 ? VIRTQ_DESC_F_NEXT : 0);
+            last = i;
+            i = q->desc[i].next;
+        }
+        q->free_head = q->desc[last].next;
+        q->num_free -= n;
+    } else {
+        virtq_desc_t* t = q->indirect + (uint32_t)head * VIRTQ_INDIRECT_MAX;
+        for (int k = 0; k < n; k++) {
+            t[k].addr = sg[k].addr;
+            t[k].len = sg[k].len;
+            t[k].flags = (sg[k].write ? VIRTQ_DESC_F_WRITE : 0) |
+                         (k < n - 1 ? VIRTQ_DESC_F_NEXT : 0);
+            t[k].next = k + 1;
+        }
+        q->desc[head].addr = vmm_virt_to_phys(t);
+        q->desc[head].len = n * sizeof(virtq_desc_t);
+        q->desc[head].flags = VIRTQ_DESC_F_INDIRECT;
+        q->free_head = q->desc[head].next;
+        q->num_free--;
+    }
+    q->cookie[head] = cookie;
+
+    /* Descriptors before the ring entry, ring entry before the index */
+    uint16_t idx = VQ_READ16(q->avail->idx);
+    q->avail->ring[idx & (q->size - 1)] = head;
+    __sync_synchronize();
+    VQ_WRITE16(q->avail->idx, idx + 1);
+    return head;
+}
+
+int virtq_kick(virtq_t* q) {
+    __sync_synchronize();
+    uint16_t now = VQ_READ16(q->avail->idx);
+    uint16_t old = q->kicked;
+    q->kicked = now;
+    if (now == old) return 0;
+
+    int need;
+    if (q->event_idx) {
+        uint16_t ev = VQ_READ16(*avail_event(q));
+        need = (uint16_t)(now - ev - 1) < (uint16_t)(now - old);
+    } else {
+        need = !(VQ_READ16(q->used->flags) & VIRTQ_USED_F_NO_NOTIFY);
+    }
+    if (!need) {
+        q->kicks_suppressed++;
+        return 0;
+    }
+
+    if (q->notify) *q->notify = q->index;
+    else outw(q->dev->io + VIRTIO_LEG_QUEUE_NOTIFY, q->index);
+    q->kicks++;
+    return 1;
+}
+
+int virtq_pending(const virtq_t* q) {
+    return VQ_READ16(q->used->idx) != q->last_used;
+}
+
+void* virtq_get(virtq_t* q, uint32_t* len) {
+    if (!virtq_pending(q)) return 0;
+    __sync_synchronize();
+
+    virtq_used_elem_t* e = &q->used->ring[q->last_used & (q->size - 1)];
+    uint16_t head = (uint16_t)e->id;
+    if (len) *len = e->len;
+    void* cookie = q->cookie[head];
+    q->cookie[head] = 0;
+
+    /* Return the chain to the free list */
+    uint16_t i = head, n = 1;
+    while (q->desc[i].flags & VIRTQ_DESC_F_NEXT) {
+        i = q->desc[i].next;
+        n++;
+    }
+    q->desc[i].next = q->free_head;
+    q->free_head = head;
+    q->num_free += n;
+    q->last_used++;
+
+    /* Keep the event index just behind us while interrupts are off */
+    if (q->irq_off && q->event_idx) VQ_WRITE16(*used_event(q), q->last_used - 1);
+    return cookie;
+}
+
+void virtq_disable_irq(virtq_t* q) {
+    q->irq_off = 1;
+    if (q->event_idx) VQ_WRITE16(*used_event(q), q->last_used - 1);
+    else VQ_WRITE16(q->avail->flags, VIRTQ_AVAIL_F_NO_INTERRUPT);
+}
+
+int virtq_enable_irq(virtq_t* q) {
+    q->irq_off = 0;
+    if (q->event_idx) VQ_WRITE16(*used_event(q), q->last_used);
+    else VQ_WRITE16(q->avail->flags, 0);
+    __sync_synchronize();
+    return virtq_pending(q);
+}
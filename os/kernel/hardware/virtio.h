@@ -0,0 +1,178 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* virtio over PCI (virtio 1.x "modern" and 0.9.5 "legacy" transports)
+ * with split virtqueues. Shared by virtio-net and virtio-blk.
+ *
+ * The modern transport is used when the device exposes the vendor
+ * capabilities in memory BARs below 4 GB, otherwise a transitional device
+ * is driven through its legacy I/O BAR. Interrupts are INTx only: every
+ * virtio device on a line is asked in turn, reading the ISR acknowledges.
+ */
+
+#define VIRTIO_PCI_VENDOR       0x1AF4
+#define VIRTIO_ID_NET_LEGACY    0x1000
+#define VIRTIO_ID_BLK_LEGACY    0x1001
+#define VIRTIO_ID_NET_MODERN    0x1041
+#define VIRTIO_ID_BLK_MODERN    0x1042
+
+/* Device status */
+#define VIRTIO_STATUS_ACK         0x01
+#define VIRTIO_STATUS_DRIVER      0x02
+#define VIRTIO_STATUS_DRIVER_OK   0x04
+#define VIRTIO_STATUS_FEATURES_OK 0x08
+#define VIRTIO_STATUS_FAILED      0x80
+
+/* Transport feature bits */
+#define VIRTIO_F_ANY_LAYOUT     27
+#define VIRTIO_F_INDIRECT_DESC  28
+#define VIRTIO_F_EVENT_IDX      29
+#define VIRTIO_F_VERSION_1      32
+
+#define VIRTIO_FEATURE(bit)     (1ULL << (bit))
+
+/* ISR bits */
+#define VIRTIO_ISR_QUEUE        0x01
+#define VIRTIO_ISR_CONFIG       0x02
+
+/* Split virtqueue layout */
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+#define VIRTQ_DESC_F_NEXT       1
+#define VIRTQ_DESC_F_WRITE      2
+#define VIRTQ_DESC_F_INDIRECT   4
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];        /* followed by used_event */
+} __attribute__((packed)) virtq_avail_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed)) virtq_used_elem_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    virtq_used_elem_t ring[];   /* followed by avail_event */
+} __attribute__((packed)) virtq_used_t;
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT  1
+#define VIRTQ_USED_F_NO_NOTIFY      1
+
+#define VIRTQ_SIZE_MAX          256
+#define VIRTQ_INDIRECT_MAX      32     /* Descriptors per indirect table */
+
+typedef struct virtio_dev virtio_dev_t;
+
+typedef struct {
+    virtio_dev_t* dev;
+    uint16_t index;
+    uint16_t size;
+    virtq_desc_t* desc;
+    virtq_avail_t* avail;
+    virtq_used_t* used;
+    volatile uint16_t* notify;  /* Modern notify register, NULL for legacy */
+    uint16_t free_head;
+    uint16_t num_free;
+    uint16_t last_used;
+    uint16_t kicked;            /* avail->idx at the last notify decision */
+    uint8_t  event_idx;
+    uint8_t  irq_off;
+    void**   cookie;
+    virtq_desc_t* indirect;     /* One table per head, NULL if unused */
+    /* Stats */
+    uint32_t kicks;
+    uint32_t kicks_suppressed;
+} virtq_t;
+
+/* Scatter-gather element, physical address */
+typedef struct {
+    uint32_t addr;
+    uint32_t len;
+    uint8_t  write;             /* Device writes this buffer */
+} virtq_sg_t;
+
+struct virtio_dev {
+    uint8_t  bus, slot, func;
+    uint8_t  irq;
+    uint8_t  modern;
+    uint16_t io;                        /* Legacy I/O base */
+    volatile uint8_t* common;           /* Modern capabilities */
+    volatile uint8_t* isr;
+    volatile uint8_t* cfg;
+    volatile uint8_t* notify_base;
+    uint32_t notify_mult;
+    uint64_t features;                  /* Negotiated */
+    void (*irq_handler)(virtio_dev_t* d, uint8_t isr);
+    void* priv;
+};
+
+/* Find the index'th device with either ID. 0, or -ENODEV. */
+int  virtio_pci_find(uint16_t legacy_id, uint16_t modern_id, int index, virtio_dev_t* d);
+
+/* Reset the device and return what it offers */
+uint64_t virtio_begin(virtio_dev_t* d);
+
+/* Accept 'wanted' & offered (VERSION_1 is added for modern devices).
+   0, or -EIO if the device refused the set. */
+int  virtio_negotiate(virtio_dev_t* d, uint64_t wanted);
+int  virtio_has(const virtio_dev_t* d, int bit);
+
+/* Number of queues the device provides (legacy: probed by size) */
+uint16_t virtio_num_queues(virtio_dev_t* d);
+
+/* Set up queue 'index' with at most max_size entries; indirect tables are
+   allocated when 'indirect' is set and the feature was negotiated.
+   0, or -ENODEV (queue absent), -ENOMEM. */
+int  virtq_init(virtio_dev_t* d, virtq_t* q, uint16_t index, uint16_t max_size, int indirect);
+
+/* Release a queue's memory. Only once the device was reset or never
+   saw the queue. */
+void virtq_free(virtq_t* q);
+
+void virtio_driver_ok(virtio_dev_t* d);
+void virtio_fail(virtio_dev_t* d);
+
+/* Device specific configuration space */
+uint8_t  virtio_cfg8(virtio_dev_t* d, uint32_t off);
+uint16_t virtio_cfg16(virtio_dev_t* d, uint32_t off);
+uint32_t virtio_cfg32(virtio_dev_t* d, uint32_t off);
+uint64_t virtio_cfg64(virtio_dev_t* d, uint32_t off);
+
+/* Route the PCI interrupt line to handler (shared between virtio devices) */
+int  virtio_irq_attach(virtio_dev_t* d, void (*handler)(virtio_dev_t*, uint8_t));
+
+/* Post a chain (device-readable elements first). Chains longer than one
+   descriptor go through an indirect table when the queue has them.
+   The head index, or -ENOSPC. The device may pick the chain up at once
+   but is only notified by virtq_kick(). */
+int   virtq_add(virtq_t* q, const virtq_sg_t* sg, int n, void* cookie);
+
+/* Notify the device of chains added since the last kick, unless it asked
+   not to be. 1 if notified. */
+int   virtq_kick(virtq_t* q);
+
+/* Next completed chain: its cookie and the bytes written, or NULL */
+void* virtq_get(virtq_t* q, uint32_t* len);
+int   virtq_pending(const virtq_t* q);
+
+/* Completion interrupt suppression. virtq_enable_irq() returns 1 if
+   completions arrived meanwhile, so the caller should poll again. */
+void  virtq_disable_irq(virtq_t* q);
+int   virtq_enable_irq(virtq_t* q);
+
+#ifdef __cplusplus
+}
+#endif
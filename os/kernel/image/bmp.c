@@ -0,0 +1,95 @@
+/* kernel/image/bmp.c */
+#include "image.h"
+#include "convert.h"
+
+extern void serial(const char *fmt, ...);
+
+#pragma pack(push, 1)
+typedef struct {
+    uint16_t bfType;      /* 'BM' */
+    uint32_t bfSize;
+    uint16_t bfReserved1;
+    uint16_t bfReserved2;
+    uint32_t bfOffBits;   /* Offset to the pixel data */
+} bmp_file_header_t;
+
+typedef struct {
+    uint32_t biSize;
+    int32_t  biWidth;
+    int32_t  biHeight;
+    uint16_t biPlanes;
+    uint16_t biBitCount;
+    uint32_t biCompression;
+    uint32_t biSizeImage;
+    int32_t  biXPelsPerMeter;
+    int32_t  biYPelsPerMeter;
+    uint32_t biClrUsed;
+    uint32_t biClrImportant;
+    /* V3+ headers (biSize >= 56), or masks after a plain header with BI_BITFIELDS */
+    uint32_t biRedMask;
+    uint32_t biGreenMask;
+    uint32_t biBlueMask;
+    uint32_t biAlphaMask;
+} bmp_info_header_t;
+#pragma pack(pop)
+
+#define BI_RGB       0
+#define BI_BITFIELDS 3
+
+surface_t* image_decode_bmp(const uint8_t* data, uint32_t size) {
+    if (size < sizeof(bmp_file_header_t) + 40) return 0;
+
+    const bmp_file_header_t* fh = (const bmp_file_header_t*)data;
+    const bmp_info_header_t* ih = (const bmp_info_header_t*)(data + sizeof(*fh));
+    if (fh->bfType != 0x4D42) return 0;
+
+    int32_t width = ih->biWidth;
+    int32_t height = ih->biHeight;
+    int32_t abs_h = height > 0 ? height : -height;
+    uint16_t bpp = ih->biBitCount;
+    bool masks = size >= sizeof(*fh) + sizeof(*ih);
+
+    if (bpp != 24 && bpp != 32) {
+        serial("[BMP] Error: Only 24 and 32 bpp BMPs are supported (got %d).\n", bpp);
+        return 0;
+    }
+    if (ih->biCompression != BI_RGB && !(bpp == 32 && ih->biCompression == BI_BITFIELDS)) {
+        serial("[BMP] Error: Compressed BMPs are not supported.\n");
+        return 0;
+    }
+    /* Bitfields must be the usual BGRA layout */
+    if (ih->biCompression == BI_BITFIELDS &&
+        (!masks || ih->biRedMask != 0x00FF0000 || ih->biGreenMask != 0x0000FF00 || ih->biBlueMask != 0x000000FF)) {
+        serial("[BMP] Error: Unsupported channel masks.\n");
+        return 0;
+    }
+    if (width <= 0 || abs_h == 0 || width > IMAGE_MAX_DIM || abs_h > IMAGE_MAX_DIM) return 0;
+
+    /* Plain 32 bpp BMPs leave the 4th byte unused (often 0); only a header
+       with an alpha mask means it is real alpha */
+    bool has_alpha = bpp == 32 && masks && ih->biSize >= 56 && ih->biAlphaMask == 0xFF000000;
+
+    /* Rows are padded to 4 bytes */
+    uint32_t row_size = (((uint32_t)width * bpp + 31) / 32) * 4;
+    uint32_t offset = fh->bfOffBits;
+    if (offset > size || (uint64_t)row_size * abs_h > size - offset) {
+        serial("[BMP] Error: Truncated pixel data.\n");
+        return 0;
+    }
+
+    surface_t* img = surface_create((uint32_t)width, (uint32_t)abs_h);
+    if (!img) return 0;
+
+    /* Bottom-up unless the height is negative */
+    for (int32_t i = 0; i < abs_h; i++) {
+        const uint8_t* row = data + offset + (uint32_t)i * row_size;
+        int32_t y = height > 0 ? abs_h - 1 - i : i;
+        uint32_t* out = img->pixels + (uint32_t)y * img->width;
+        if (bpp == 24) convert_bgr24(out, row, (uint32_t)width);
+        else if (has_alpha) convert_bgra32(out, row, (uint32_t)width);
+        else convert_bgrx32(out, row, (uint32_t)width);
+    }
+
+    if (has_alpha) surface_set_alpha(img, true);
+    return img;
+}
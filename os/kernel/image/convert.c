@@ -0,0 +1,178 @@
+/* kernel/image/convert.c */
+#include "convert.h"
+#include "../hardware/sse.h"
+
+static int conv_level = -1;   /* -1: not probed, 0: scalar, 1: SSE2, 2: SSE2 + SSSE3 */
+
+static void conv_probe(void) {
+    if (conv_level >= 0) return;
+    conv_level = 0;
+    if (cpu_has_sse2()) {
+        sse_enable();
+        conv_level = cpu_has_ssse3() ? 2 : 1;
+    }
+}
+
+const char* convert_impl_name(void) {
+    conv_probe();
+    return conv_level == 2 ? "ssse3" : conv_level == 1 ? "sse2" : "scalar";
+}
+
+/* round(x * a / 255) for 8-bit x and a */
+static inline uint32_t mul255(uint32_t x, uint32_t a) {
+    uint32_t t = x * a + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline uint32_t premul(uint32_t a, uint32_t r, uint32_t g, uint32_t b) {
+    if (a != 0xFF) {
+        r = mul255(r, a);
+        g = mul255(g, a);
+        b = mul255(b, a);
+    }
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+/* --- Scalar --- */
+
+static void bgr24_scalar(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++, src += 3) {
+        dst[i] = 0xFF000000 | ((uint32_t)src[2] << 16) | (src[1] << 8) | src[0];
+    }
+}
+
+static void rgb24_scalar(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++, src += 3) {
+        dst[i] = 0xFF000000 | ((uint32_t)src[0] << 16) | (src[1] << 8) | src[2];
+    }
+}
+
+static void bgra32_scalar(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++, src += 4) {
+        dst[i] = premul(src[3], src[2], src[1], src[0]);
+    }
+}
+
+static void rgba32_scalar(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++, src += 4) {
+        dst[i] = premul(src[3], src[0], src[1], src[2]);
+    }
+}
+
+static void bgrx32_scalar(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++, src += 4) {
+        dst[i] = 0xFF000000 | ((uint32_t)src[2] << 16) | (src[1] << 8) | src[0];
+    }
+}
+
+/* --- SIMD: four pixels per iteration --- */
+
+typedef unsigned short v8hu __attribute__((vector_size(16)));
+typedef short          v8hi __attribute__((vector_size(16)));
+typedef unsigned int   v4su __attribute__((vector_size(16)));
+typedef char           v16qi __attribute__((vector_size(16)));
+
+#define SPLAT4(x) { (x), (x), (x), (x) }
+
+/* Twelve packed bytes to four pixels in one shuffle. Each step loads 16
+   bytes, so the loop stops while at least 4 bytes of input remain past
+   the 12 it converts. */
+__attribute__((target("sse2,ssse3")))
+static void shuffle24_ssse3(uint32_t* dst, const uint8_t* src, uint32_t n, int rgb) {
+    const v16qi bgr_mask = { 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 };
+    const v16qi rgb_mask = { 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1 };
+    const v16qi mask = rgb ? rgb_mask : bgr_mask;
+    const v4su alpha = SPLAT4(0xFF000000u);
+    for (; n >= 6; n -= 4, src += 12, dst += 4) {
+        v16qi v = __builtin_ia32_loaddqu((const char*)src);
+        v4su p = (v4su)__builtin_ia32_pshufb128(v, mask) | alpha;
+        __builtin_ia32_storedqu((char*)dst, (v16qi)p);
+    }
+    if (rgb) rgb24_scalar(dst, src, n);
+    else bgr24_scalar(dst, src, n);
+}
+
+/* Colour channels times alpha, alpha kept; same rounding as mul255() */
+__attribute__((target("sse2")))
+static inline v4su premul4_sse2(v4su p) {
+    const v16qi zero = { 0 };
+    const v8hu k128 = { 128, 128, 128, 128, 128, 128, 128, 128 };
+    const v4su amask = SPLAT4(0xFF000000u);
+
+    v8hu lo = (v8hu)__builtin_ia32_punpcklbw128((v16qi)p, zero);
+    v8hu hi = (v8hu)__builtin_ia32_punpckhbw128((v16qi)p, zero);
+    v8hu alo = (v8hu)__builtin_ia32_pshufhw(__builtin_ia32_pshuflw((v8hi)lo, 0xFF), 0xFF);
+    v8hu ahi = (v8hu)__builtin_ia32_pshufhw(__builtin_ia32_pshuflw((v8hi)hi, 0xFF), 0xFF);
+
+    lo = lo * alo + k128;
+    hi = hi * ahi + k128;
+    lo = (lo + (lo >> 8)) >> 8;
+    hi = (hi + (hi >> 8)) >> 8;
+
+    v4su out = (v4su)__builtin_ia32_packuswb128((v8hi)lo, (v8hi)hi);
+    return (out & ~amask) | (p & amask);
+}
+
+__attribute__((target("sse2")))
+static void bgra32_sse2(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    for (; n >= 4; n -= 4, src += 16, dst += 4) {
+        v4su p = (v4su)__builtin_ia32_loaddqu((const char*)src);
+        __builtin_ia32_storedqu((char*)dst, (v16qi)premul4_sse2(p));
+    }
+    bgra32_scalar(dst, src, n);
+}
+
+__attribute__((target("sse2")))
+static void rgba32_sse2(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    const v4su ga = SPLAT4(0xFF00FF00u);
+    const v4su lo8 = SPLAT4(0x000000FFu);
+    for (; n >= 4; n -= 4, src += 16, dst += 4) {
+        v4su p = (v4su)__builtin_ia32_loaddqu((const char*)src);
+        /* Swap the R and B bytes */
+        p = (p & ga) | ((p >> 16) & lo8) | ((p & lo8) << 16);
+        __builtin_ia32_storedqu((char*)dst, (v16qi)premul4_sse2(p));
+    }
+    rgba32_scalar(dst, src, n);
+}
+
+__attribute__((target("sse2")))
+static void bgrx32_sse2(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    const v4su alpha = SPLAT4(0xFF000000u);
+    for (; n >= 4; n -= 4, src += 16, dst += 4) {
+        v4su p = (v4su)__builtin_ia32_loaddqu((const char*)src) | alpha;
+        __builtin_ia32_storedqu((char*)dst, (v16qi)p);
+    }
+    bgrx32_scalar(dst, src, n);
+}
+
+/* --- Dispatch --- */
+
+void convert_bgr24(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    conv_probe();
+    if (conv_level == 2) shuffle24_ssse3(dst, src, n, 0);
+    else bgr24_scalar(dst, src, n);
+}
+
+void convert_rgb24(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    conv_probe();
+    if (conv_level == 2) shuffle24_ssse3(dst, src, n, 1);
+    else rgb24_scalar(dst, src, n);
+}
+
+void convert_bgra32(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    conv_probe();
+    if (conv_level) bgra32_sse2(dst, src, n);
+    else bgra32_scalar(dst, src, n);
+}
+
+void convert_rgba32(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    conv_probe();
+    if (conv_level) rgba32_sse2(dst, src, n);
+    else rgba32_scalar(dst, src, n);
+}
+
+void convert_bgrx32(uint32_t* dst, const uint8_t* src, uint32_t n) {
+    conv_probe();
+    if (conv_level) bgrx32_sse2(dst, src, n);
+    else bgrx32_scalar(dst, src, n);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pixel row conversion to the surface format (ARGB32, premultiplied when
+   it has alpha). SSSE3 byte shuffles where the CPU has them, SSE2 or
+   scalar otherwise; all paths give identical results. */
+
+/* 3 bytes per pixel, opaque. BGR: BMP byte order, RGB: PNG. */
+void convert_bgr24(uint32_t* dst, const uint8_t* src, uint32_t n);
+void convert_rgb24(uint32_t* dst, const uint8_t* src, uint32_t n);
+
+/* 4 bytes per pixel, straight alpha, premultiplied on the way */
+void convert_bgra32(uint32_t* dst, const uint8_t* src, uint32_t n);
+void convert_rgba32(uint32_t* dst, const uint8_t* src, uint32_t n);
+
+/* 4 bytes per pixel, fourth byte ignored (opaque) */
+void convert_bgrx32(uint32_t* dst, const uint8_t* src, uint32_t n);
+
+const char* convert_impl_name(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,264 @@
+/* kernel/image/image.c */
+#include "image.h"
+#include "convert.h"
+#include "../cmds/fat.h"
+#include "../fs/fs.h"
+#include "../mem/kmalloc.h"
+#include "../string.h"
+#include "../video/blend.h"
+
+extern void serial(const char *fmt, ...);
+
+surface_t* image_decode(const uint8_t* data, uint32_t size) {
+    if (!data || size < 8) return 0;
+    if (data[0] == 0x89 && data[1] == 'P' && data[2] == 'N' && data[3] == 'G') return image_decode_png(data, size);
+    if (data[0] == 'B' && data[1] == 'M') return image_decode_bmp(data, size);
+    return 0;
+}
+
+/* --- Loading: the whole file in one sequential read --- */
+
+#define SRC_FAT  1
+#define SRC_RAMFS 2
+
+/* Stamp, volume generation and size of path, without reading it.
+   Where it was found (SRC_*), or 0. */
+static int image_stat(const char* path, fat_file_t* f, uint32_t* stamp, uint32_t* gen, uint32_t* size) {
+    if (fat32_open(path, f) == 0 && !f->is_dir && f->size > 0) {
+        *stamp = f->mtime;
+        *gen = f->generation;
+        *size = f->size;
+        return SRC_FAT;
+    }
+    size_t rsize = 0;
+    if (ramfs_read_file(path, &rsize) && rsize > 0) {
+        /* Modules do not change while we run */
+        *stamp = 0;
+        *gen = 0;
+        *size = (uint32_t)rsize;
+        return SRC_RAMFS;
+    }
+    return 0;
+}
+
+static surface_t* image_load_from(const char* path, int src, fat_file_t* f) {
+    if (src == SRC_RAMFS) {
+        size_t rsize = 0;
+        const uint8_t* mod = (const uint8_t*)ramfs_read_file(path, &rsize);
+        return mod ? image_decode(mod, (uint32_t)rsize) : 0;
+    }
+
+    uint8_t* buf = (uint8_t*)kmalloc(f->size);
+    if (!buf) {
+        serial("[IMAGE] Out of memory reading %s (%u bytes)\n", path, f->size);
+        return 0;
+    }
+    /* One call: the chain is walked once and contiguous clusters merged */
+    surface_t* img = 0;
+    if (fat32_read_at(f, buf, f->size, 0) == (int)f->size) {
+        img = image_decode(buf, f->size);
+    } else {
+        serial("[IMAGE] Read error on %s\n", path);
+    }
+    kfree(buf);
+    return img;
+}
+
+surface_t* image_load(const char* path) {
+    if (!path) return 0;
+    static fat_file_t f;   /* Carries a sector of FAT cache; keep it off the stack */
+    uint32_t stamp, gen, size;
+    int src = image_stat(path, &f, &stamp, &gen, &size);
+    return src ? image_load_from(path, src, &f) : 0;
+}
+
+/* --- Cache --- */
+
+typedef struct {
+    char key[IMAGE_KEY_MAX];   /* "" when free or stale */
+    uint32_t stamp;
+    uint32_t gen;              /* FAT generation when read (0 otherwise) */
+    uint32_t size;             /* Source file size (0 for image_cache_add) */
+    surface_t* img;            /* NULL when the slot is free */
+    uint32_t refs;
+    uint32_t last_use;
+} image_entry_t;
+
+static image_entry_t cache[IMAGE_CACHE_ENTRIES];
+static uint32_t cache_clock = 0;
+
+static uint32_t entry_bytes(const image_entry_t* e) {
+    return e->img->width * e->img->height * 4;
+}
+
+static void entry_free(image_entry_t* e) {
+    surface_destroy(e->img);
+    e->img = 0;
+    e->key[0] = 0;
+    e->refs = 0;
+}
+
+static image_entry_t* entry_of(const surface_t* img) {
+    for (int i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+        if (cache[i].img && cache[i].img == img) return &cache[i];
+    }
+    return 0;
+}
+
+/* Entry for key. A different stamp, generation or size means the source
+   may have changed: the old image is dropped (or, while still in use, left
+   to its holders). */
+static image_entry_t* lookup(const char* key, uint32_t stamp, uint32_t gen, uint32_t size) {
+    for (int i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+        image_entry_t* e = &cache[i];
+        if (!e->img || strcmp(e->key, key) != 0) continue;
+        if (e->stamp == stamp && e->gen == gen && e->size == size) return e;
+        if (e->refs) e->key[0] = 0;
+        else entry_free(e);
+        return 0;
+    }
+    return 0;
+}
+
+static const surface_t* take(image_entry_t* e) {
+    e->refs++;
+    e->last_use = ++cache_clock;
+    return e->img;
+}
+
+/* Make room for bytes more pixels: unused entries go, least recently
+   used first. Returns a free slot, or NULL if every slot is in use. */
+static image_entry_t* make_room(uint32_t bytes) {
+    for (;;) {
+        uint32_t held = 0;
+        image_entry_t* free_slot = 0;
+        image_entry_t* victim = 0;
+        for (int i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+            image_entry_t* e = &cache[i];
+            if (!e->img) {
+                if (!free_slot) free_slot = e;
+                continue;
+            }
+            held += entry_bytes(e);
+            if (!e->refs && (!victim || e->last_use < victim->last_use)) victim = e;
+        }
+        if (free_slot && held + bytes <= IMAGE_CACHE_BYTES) return free_slot;
+        if (!victim) return free_slot;   /* Over budget, but all of it is in use */
+        entry_free(victim);
+    }
+}
+
+static const surface_t* insert(const char* key, uint32_t stamp, uint32_t gen, uint32_t size, surface_t* img) {
+    image_entry_t* e = strlen(key) < IMAGE_KEY_MAX ? make_room(img->width * img->height * 4) : 0;
+    if (!e) {
+        /* Not kept: image_release() destroys it */
+        return img;
+    }
+    strcpy(e->key, key);
+    e->stamp = stamp;
+    e->gen = gen;
+    e->size = size;
+    e->img = img;
+    e->refs = 0;
+    return take(e);
+}
+
+const surface_t* image_get(const char* path) {
+    if (!path) return 0;
+
+    static fat_file_t f;
+    uint32_t stamp, gen, size;
+    int src = image_stat(path, &f, &stamp, &gen, &size);
+    if (!src) return 0;
+
+    image_entry_t* e = lookup(path, stamp, gen, size);
+    if (e) return take(e);
+
+    surface_t* img = image_load_from(path, src, &f);
+    if (!img) {
+        serial("[IMAGE] Could not decode %s\n", path);
+        return 0;
+    }
+    serial("[IMAGE] Decoded %s: %ux%u%s (%s)\n", path, img->width, img->height,
+           (img->flags & SURFACE_ALPHA) ? ", alpha" : "", convert_impl_name());
+    return insert(path, stamp, gen, size, img);
+}
+
+void image_release(const surface_t* img) {
+    if (!img) return;
+    image_entry_t* e = entry_of(img);
+    if (!e) {
+        surface_destroy((surface_t*)img);
+        return;
+    }
+    if (e->refs) e->refs--;
+    /* Stale entries are only kept for their last holders */
+    if (!e->refs && !e->key[0]) entry_free(e);
+}
+
+const surface_t* image_cache_find(const char* key, uint32_t stamp) {
+    if (!key) return 0;
+    image_entry_t* e = lookup(key, stamp, 0, 0);
+    return e ? take(e) : 0;
+}
+
+const surface_t* image_cache_add(const char* key, uint32_t stamp, surface_t* img) {
+    if (!key || !img) return img;
+    lookup(key, stamp, 0, 0);   /* Drops an older image under the same key */
+    return insert(key, stamp, 0, 0, img);
+}
+
+void image_cache_trim(void) {
+    for (int i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+        if (cache[i].img && !cache[i].refs) entry_free(&cache[i]);
+    }
+}
+
+/* --- Drawing --- */
+
+void image_draw(surface_t* dst, const surface_t* img, int x, int y) {
+    if (!dst || !img) return;
+    int x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+    int x1 = x + (int)img->width, y1 = y + (int)img->height;
+    if (x1 > (int)dst->width) x1 = (int)dst->width;
+    if (y1 > (int)dst->height) y1 = (int)dst->height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    bool alpha = (img->flags & SURFACE_ALPHA) != 0;
+    for (int row = y0; row < y1; row++) {
+        const uint32_t* src = img->pixels + (row - y) * img->width + (x0 - x);
+        blend_span(dst->pixels + row * dst->width + x0, src, x1 - x0, 255, alpha);
+    }
+    surface_damage(dst, x0, y0, x1 - x0, y1 - y0);
+}
+
+void image_draw_scaled(surface_t* dst, const surface_t* img, int x, int y, int w, int h) {
+    if (!dst || !img || w <= 0 || h <= 0) return;
+    if (w == (int)img->width && h == (int)img->height) {
+        image_draw(dst, img, x, y);
+        return;
+    }
+
+    int x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+    int x1 = x + w, y1 = y + h;
+    if (x1 > (int)dst->width) x1 = (int)dst->width;
+    if (y1 > (int)dst->height) y1 = (int)dst->height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    /* 16.16 source steps, sampling at pixel centres */
+    uint32_t sx = (img->width << 16) / (uint32_t)w;
+    uint32_t sy = (img->height << 16) / (uint32_t)h;
+    bool alpha = (img->flags & SURFACE_ALPHA) != 0;
+
+    for (int row = y0; row < y1; row++) {
+        uint32_t v = ((uint32_t)(row - y) * sy + sy / 2) >> 16;
+        const uint32_t* src = img->pixels + v * img->width;
+        uint32_t* out = dst->pixels + row * dst->width;
+        uint32_t u = (uint32_t)(x0 - x) * sx + sx / 2;
+        for (int col = x0; col < x1; col++, u += sx) {
+            uint32_t p = src[u >> 16];
+            out[col] = alpha ? blend_pixel(p, out[col]) : p;
+        }
+    }
+    surface_damage(dst, x0, y0, x1 - x0, y1 - y0);
+}
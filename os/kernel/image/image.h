@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include "../video/surface.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Image decoding and the decoded-image cache.
+ *
+ * Images decode to surfaces: ARGB32, premultiplied with SURFACE_ALPHA set
+ * when the image has transparency, opaque otherwise. Files are read once,
+ * sequentially, into memory and decoded from there. BMP (24/32 bpp,
+ * uncompressed or bitfields) and PNG (8-bit, all colour types, no
+ * interlace) are understood.
+ *
+ * image_get() keeps what it decodes, keyed by path and by the file's
+ * modification stamp and size, so the same file is decoded once however
+ * many places show it. Any write to the FAT volume invalidates the files
+ * decoded from it, since the stamp alone cannot tell a quick rewrite. Surfaces from the cache are shared: draw from them,
+ * never modify them, and give each one back with image_release().
+ */
+
+#define IMAGE_KEY_MAX       96                  /* Longest cacheable path, NUL included */
+#define IMAGE_CACHE_ENTRIES 32
+#define IMAGE_CACHE_BYTES   (8 * 1024 * 1024)   /* Decoded pixels kept when unused */
+#define IMAGE_MAX_DIM       4096
+
+/* Decode an image held in memory (format from its signature). New surface, or NULL. */
+surface_t* image_decode(const uint8_t* data, uint32_t size);
+surface_t* image_decode_bmp(const uint8_t* data, uint32_t size);
+surface_t* image_decode_png(const uint8_t* data, uint32_t size);
+
+/* Read and decode a file (FAT32 first, then the RAM filesystem), uncached */
+surface_t* image_load(const char* path);
+
+/* Cached load; NULL if missing or undecodable. Pair with image_release(). */
+const surface_t* image_get(const char* path);
+void image_release(const surface_t* img);
+
+/* For images that do not come from a file (e.g. icons out of a module):
+   look up or hand over a surface under a caller-chosen key and stamp.
+   Both return a reference to release like image_get()'s. */
+const surface_t* image_cache_find(const char* key, uint32_t stamp);
+const surface_t* image_cache_add(const char* key, uint32_t stamp, surface_t* img);
+
+/* Drop every unreferenced entry */
+void image_cache_trim(void);
+
+/* Draw img with its top-left corner at (x, y), clipped; images with alpha
+   are blended over what dst shows. The scaled variant fits it into w x h
+   (nearest neighbour). Both damage what they touch. */
+void image_draw(surface_t* dst, const surface_t* img, int x, int y);
+void image_draw_scaled(surface_t* dst, const surface_t* img, int x, int y, int w, int h);
+
+#ifdef __cplusplus
+}
+#endif
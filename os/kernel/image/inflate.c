@@ -0,0 +1,345 @@
+/* kernel/image/inflate.c */
+#include "inflate.h"
+#include "../string.h"
+
+#define MAXBITS   15
+#define FASTBITS  9
+#define MAXLCODES 288
+#define MAXDCODES 30
+
+typedef struct {
+    uint16_t count[MAXBITS + 1];   /* Codes of each length */
+    uint16_t symbol[MAXLCODES];    /* Symbols in canonical order */
+    uint16_t fast[1 << FASTBITS];  /* len << 9 | symbol for codes up to FASTBITS, 0 if longer */
+} huff_t;
+
+typedef struct {
+    const uint8_t* src;
+    uint32_t len;
+    uint32_t pos;      /* Next byte to load; runs past len while padding with zeros */
+    uint32_t bitbuf;
+    uint32_t bitcnt;
+    uint8_t* dst;
+    uint32_t cap;
+    uint32_t out;
+} inflate_state_t;
+
+static const uint16_t len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* --- Bit input (LSB first) --- */
+
+static inline void refill(inflate_state_t* s) {
+    while (s->bitcnt <= 24) {
+        uint32_t b = s->pos < s->len ? s->src[s->pos] : 0;
+        s->pos++;
+        s->bitbuf |= b << s->bitcnt;
+        s->bitcnt += 8;
+    }
+}
+
+/* Consumed more than the input holds (the zero padding was used) */
+static inline int overrun(const inflate_state_t* s) {
+    return s->pos - s->bitcnt / 8 > s->len;
+}
+
+static inline uint32_t getbits(inflate_state_t* s, uint32_t n) {
+    if (n == 0) return 0;
+    refill(s);
+    uint32_t v = s->bitbuf & ((1u << n) - 1);
+    s->bitbuf >>= n;
+    s->bitcnt -= n;
+    return v;
+}
+
+/* --- Huffman tables --- */
+
+static inline uint32_t reverse_bits(uint32_t code, uint32_t len) {
+    uint32_t r = 0;
+    while (len--) {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+/* Build from code lengths. 0 if complete or a permitted incomplete code,
+   -1 if over-subscribed. */
+static int huff_build(huff_t* h, const uint8_t* lengths, uint32_t n) {
+    uint16_t offs[MAXBITS + 1];
+
+    memset(h->count, 0, sizeof(h->count));
+    for (uint32_t i = 0; i < n; i++) h->count[lengths[i]]++;
+    if (h->count[0] == n) {
+        memset(h->fast, 0, sizeof(h->fast));
+        return 0;
+    }
+
+    int left = 1;
+    for (int len = 1; len <= MAXBITS; len++) {
+        left <<= 1;
+        left -= h->count[len];
+        if (left < 0) return -1;
+    }
+
+    offs[1] = 0;
+    for (int len = 1; len < MAXBITS; len++) offs[len + 1] = offs[len] + h->count[len];
+    for (uint32_t i = 0; i < n; i++) {
+        if (lengths[i]) h->symbol[offs[lengths[i]]++] = (uint16_t)i;
+    }
+
+    /* Short codes straight from the next FASTBITS input bits */
+    memset(h->fast, 0, sizeof(h->fast));
+    uint32_t code = 0, index = 0;
+    for (uint32_t len = 1; len <= FASTBITS; len++) {
+        for (uint32_t k = 0; k < h->count[len]; k++, code++, index++) {
+            uint16_t e = (uint16_t)((len << 9) | h->symbol[index]);
+            for (uint32_t r = reverse_bits(code, len); r < (1u << FASTBITS); r += 1u << len) {
+                h->fast[r] = e;
+            }
+        }
+        code <<= 1;
+    }
+    return 0;
+}
+
+static int huff_decode(inflate_state_t* s, const huff_t* h) {
+    refill(s);
+    uint16_t e = h->fast[s->bitbuf & ((1u << FASTBITS) - 1)];
+    if (e) {
+        uint32_t len = e >> 9;
+        s->bitbuf >>= len;
+        s->bitcnt -= len;
+        return e & 0x1FF;
+    }
+
+    /* Longer code: canonical walk, one bit per length */
+    int code = 0, first = 0, index = 0;
+    for (uint32_t len = 1; len <= MAXBITS; len++) {
+        code |= (s->bitbuf >> (len - 1)) & 1;
+        int count = h->count[len];
+        if (code - count < first) {
+            s->bitbuf >>= len;
+            s->bitcnt -= len;
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+/* --- Blocks --- */
+
+static int inflate_stored(inflate_state_t* s) {
+    /* Back to a byte boundary, returning whole buffered bytes to the input */
+    s->bitbuf = 0;
+    s->pos -= s->bitcnt / 8;
+    s->bitcnt = 0;
+
+    if (s->pos + 4 > s->len) return INFLATE_ERR_DATA;
+    uint32_t len = s->src[s->pos] | (s->src[s->pos + 1] << 8);
+    uint32_t nlen = s->src[s->pos + 2] | (s->src[s->pos + 3] << 8);
+    s->pos += 4;
+    if (len != (~nlen & 0xFFFF)) return INFLATE_ERR_DATA;
+    if (s->pos + len > s->len) return INFLATE_ERR_DATA;
+    if (s->out + len > s->cap) return INFLATE_ERR_SPACE;
+
+    memcpy(s->dst + s->out, s->src + s->pos, len);
+    s->out += len;
+    s->pos += len;
+    return INFLATE_OK;
+}
+
+static int inflate_codes(inflate_state_t* s, const huff_t* lit, const huff_t* dist) {
+    uint8_t* dst = s->dst;
+    for (;;) {
+        int sym = huff_decode(s, lit);
+        if (sym < 0) return INFLATE_ERR_DATA;
+
+        if (sym < 256) {
+            if (s->out >= s->cap) return INFLATE_ERR_SPACE;
+            dst[s->out++] = (uint8_t)sym;
+            continue;
+        }
+        if (sym == 256) return overrun(s) ? INFLATE_ERR_DATA : INFLATE_OK;
+
+        sym -= 257;
+        if (sym >= 29) return INFLATE_ERR_DATA;
+        uint32_t len = len_base[sym] + getbits(s, len_extra[sym]);
+
+        int dsym = huff_decode(s, dist);
+        if (dsym < 0 || dsym >= 30) return INFLATE_ERR_DATA;
+        uint32_t d = dist_base[dsym] + getbits(s, dist_extra[dsym]);
+
+        if (d > s->out) return INFLATE_ERR_DATA;
+        if (s->out + len > s->cap) return INFLATE_ERR_SPACE;
+        if (overrun(s)) return INFLATE_ERR_DATA;
+
+        /* Overlapping copies (d < len) repeat the last d bytes, so go bytewise */
+        uint8_t* o = dst + s->out;
+        const uint8_t* from = o - d;
+        if (d >= len) {
+            memcpy(o, from, len);
+        } else {
+            for (uint32_t i = 0; i < len; i++) o[i] = from[i];
+        }
+        s->out += len;
+    }
+}
+
+static huff_t fixed_lit, fixed_dist;
+static int fixed_ready = 0;
+
+static void build_fixed(void) {
+    uint8_t lengths[MAXLCODES];
+    int i = 0;
+    for (; i < 144; i++) lengths[i] = 8;
+    for (; i < 256; i++) lengths[i] = 9;
+    for (; i < 280; i++) lengths[i] = 7;
+    for (; i < 288; i++) lengths[i] = 8;
+    huff_build(&fixed_lit, lengths, 288);
+    for (i = 0; i < MAXDCODES; i++) lengths[i] = 5;
+    huff_build(&fixed_dist, lengths, MAXDCODES);
+    fixed_ready = 1;
+}
+
+static int inflate_dynamic(inflate_state_t* s) {
+    static const uint8_t order[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+    /* Static: the tables are ~3 KB together, too much for a kernel stack frame */
+    static huff_t lit, dist;
+    uint8_t lengths[MAXLCODES + MAXDCODES];
+
+    uint32_t nlen = getbits(s, 5) + 257;
+    uint32_t ndist = getbits(s, 5) + 1;
+    uint32_t ncode = getbits(s, 4) + 4;
+    if (nlen > MAXLCODES || ndist > MAXDCODES) return INFLATE_ERR_DATA;
+
+    uint32_t i = 0;
+    for (; i < ncode; i++) lengths[order[i]] = (uint8_t)getbits(s, 3);
+    for (; i < 19; i++) lengths[order[i]] = 0;
+    if (huff_build(&lit, lengths, 19) != 0) return INFLATE_ERR_DATA;
+
+    for (i = 0; i < nlen + ndist; ) {
+        int sym = huff_decode(s, &lit);
+        if (sym < 0) return INFLATE_ERR_DATA;
+        if (sym < 16) {
+            lengths[i++] = (uint8_t)sym;
+            continue;
+        }
+        uint8_t val = 0;
+        uint32_t rep;
+        if (sym == 16) {
+            if (i == 0) return INFLATE_ERR_DATA;
+            val = lengths[i - 1];
+            rep = 3 + getbits(s, 2);
+        } else if (sym == 17) {
+            rep = 3 + getbits(s, 3);
+        } else {
+            rep = 11 + getbits(s, 7);
+        }
+        if (i + rep > nlen + ndist) return INFLATE_ERR_DATA;
+        while (rep--) lengths[i++] = val;
+    }
+    if (overrun(s) || lengths[256] == 0) return INFLATE_ERR_DATA;
+
+    if (huff_build(&lit, lengths, nlen) != 0) return INFLATE_ERR_DATA;
+    if (huff_build(&dist, lengths + nlen, ndist) != 0) return INFLATE_ERR_DATA;
+    return inflate_codes(s, &lit, &dist);
+}
+
+static int inflate_run(inflate_state_t* s) {
+    int r, last;
+    do {
+        last = (int)getbits(s, 1);
+        uint32_t type = getbits(s, 2);
+        if (type == 0) {
+            r = inflate_stored(s);
+        } else if (type == 1) {
+            if (!fixed_ready) build_fixed();
+            r = inflate_codes(s, &fixed_lit, &fixed_dist);
+        } else if (type == 2) {
+            r = inflate_dynamic(s);
+        } else {
+            r = INFLATE_ERR_DATA;
+        }
+    } while (r == INFLATE_OK && !last);
+    return r;
+}
+
+static void state_init(inflate_state_t* s, const uint8_t* src, uint32_t src_len,
+                       uint8_t* dst, uint32_t dst_cap) {
+    memset(s, 0, sizeof(*s));
+    s->src = src;
+    s->len = src_len;
+    s->dst = dst;
+    s->cap = dst_cap;
+}
+
+int inflate_raw(const uint8_t* src, uint32_t src_len,
+                uint8_t* dst, uint32_t dst_cap, uint32_t* out_len) {
+    inflate_state_t s;
+    state_init(&s, src, src_len, dst, dst_cap);
+    int r = inflate_run(&s);
+    if (out_len) *out_len = s.out;
+    return r;
+}
+
+static uint32_t adler32(const uint8_t* p, uint32_t n) {
+    uint32_t a = 1, b = 0;
+    while (n) {
+        /* Largest run before b can overflow 32 bits */
+        uint32_t k = n < 5552 ? n : 5552;
+        n -= k;
+        while (k--) {
+            a += *p++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+int inflate_zlib(const uint8_t* src, uint32_t src_len,
+                 uint8_t* dst, uint32_t dst_cap, uint32_t* out_len) {
+    if (out_len) *out_len = 0;
+    if (src_len < 6) return INFLATE_ERR_DATA;
+
+    uint8_t cmf = src[0], flg = src[1];
+    if ((cmf & 0x0F) != 8 || (cmf >> 4) > 7) return INFLATE_ERR_DATA;
+    if (((cmf << 8) | flg) % 31 != 0) return INFLATE_ERR_DATA;
+    if (flg & 0x20) return INFLATE_ERR_DATA;   /* Preset dictionary */
+
+    inflate_state_t s;
+    state_init(&s, src + 2, src_len - 2, dst, dst_cap);
+    int r = inflate_run(&s);
+    if (out_len) *out_len = s.out;
+    if (r != INFLATE_OK) return r;
+
+    /* Adler-32 of the output follows the last block, byte aligned */
+    uint32_t end = 2 + s.pos - s.bitcnt / 8;
+    if (end + 4 > src_len) return INFLATE_ERR_DATA;
+    const uint8_t* t = src + end;
+    uint32_t want = ((uint32_t)t[0] << 24) | (t[1] << 16) | (t[2] << 8) | t[3];
+    return adler32(dst, s.out) == want ? INFLATE_OK : INFLATE_ERR_DATA;
+}
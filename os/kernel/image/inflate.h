@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* DEFLATE (RFC 1951) decompression into a caller-sized buffer.
+ *
+ * The whole output is one flat buffer, so back references are plain
+ * copies within it and no sliding window is kept. Huffman codes are
+ * decoded through a 9-bit lookup table with a canonical walk for the
+ * longer codes.
+ */
+
+#define INFLATE_OK        0
+#define INFLATE_ERR_DATA  -1   /* Corrupt or truncated stream */
+#define INFLATE_ERR_SPACE -2   /* Output does not fit in dst */
+
+/* Raw deflate stream. *out_len receives the bytes produced. */
+int inflate_raw(const uint8_t* src, uint32_t src_len,
+                uint8_t* dst, uint32_t dst_cap, uint32_t* out_len);
+
+/* zlib (RFC 1950) wrapper: header, deflate stream, Adler-32 check */
+int inflate_zlib(const uint8_t* src, uint32_t src_len,
+                 uint8_t* dst, uint32_t dst_cap, uint32_t* out_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,316 @@
+/* kernel/image/png.c */
+#include "image.h"
+#include "convert.h"
+#include "inflate.h"
+#include "../mem/kmalloc.h"
+#include "../string.h"
+
+extern void serial(const char *fmt, ...);
+
+#define PNG_GREY       0
+#define PNG_RGB        2
+#define PNG_PALETTE    3
+#define PNG_GREY_ALPHA 4
+#define PNG_RGBA       6
+
+typedef struct {
+    uint32_t width, height;
+    uint8_t depth, type;
+    uint32_t channels;
+    uint32_t stride;         /* Bytes per row, filter byte excluded */
+    uint32_t bpp;            /* Bytes per pixel for filtering (at least 1) */
+
+    uint8_t palette[256][4]; /* RGBA; alpha from tRNS */
+    uint32_t palette_len;
+    bool trns;               /* tRNS seen */
+    uint16_t key[3];         /* Transparent colour of grey/RGB images */
+} png_info_t;
+
+static inline uint32_t be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = (int)a + b - c;
+    int pa = p > a ? p - a : a - p;
+    int pb = p > b ? p - b : b - p;
+    int pc = p > c ? p - c : c - p;
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+/* Undo the per-row filters in place. raw holds height rows of 1 + stride bytes. */
+static int unfilter(uint8_t* raw, const png_info_t* pi) {
+    uint32_t stride = pi->stride, bpp = pi->bpp;
+    const uint8_t* prev = 0;
+
+    for (uint32_t y = 0; y < pi->height; y++) {
+        uint8_t* row = raw + y * (stride + 1);
+        uint8_t f = row[0];
+        uint8_t* cur = row + 1;
+        uint32_t i;
+
+        switch (f) {
+        case 0:
+            break;
+        case 1:   /* Sub */
+            for (i = bpp; i < stride; i++) cur[i] += cur[i - bpp];
+            break;
+        case 2:   /* Up */
+            if (prev) for (i = 0; i < stride; i++) cur[i] += prev[i];
+            break;
+        case 3:   /* Average */
+            for (i = 0; i < stride; i++) {
+                uint32_t a = i >= bpp ? cur[i - bpp] : 0;
+                uint32_t b = prev ? prev[i] : 0;
+                cur[i] += (uint8_t)((a + b) >> 1);
+            }
+            break;
+        case 4:   /* Paeth */
+            for (i = 0; i < stride; i++) {
+                uint8_t a = i >= bpp ? cur[i - bpp] : 0;
+                uint8_t b = prev ? prev[i] : 0;
+                uint8_t c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+                cur[i] += paeth(a, b, c);
+            }
+            break;
+        default:
+            return -1;
+        }
+        prev = cur;
+    }
+    return 0;
+}
+
+/* Sample x of a row with depth below 8 */
+static inline uint32_t sample_bits(const uint8_t* row, uint32_t x, uint32_t depth) {
+    uint32_t bit = x * depth;
+    return (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1u << depth) - 1);
+}
+
+/* Any row format to straight RGBA8, for the layouts without a direct converter */
+static void expand_row(uint8_t* out, const uint8_t* row, const png_info_t* pi) {
+    uint32_t w = pi->width;
+    uint32_t step = pi->depth == 16 ? 2 : 1;   /* 16-bit samples: keep the high byte */
+
+    for (uint32_t x = 0; x < w; x++, out += 4) {
+        uint32_t r, g, b, a = 255;
+        if (pi->type == PNG_PALETTE) {
+            uint32_t i = pi->depth == 8 ? row[x] : sample_bits(row, x, pi->depth);
+            const uint8_t* c = i < pi->palette_len ? pi->palette[i] : pi->palette[0];
+            r = c[0]; g = c[1]; b = c[2]; a = c[3];
+        } else if (pi->type == PNG_GREY) {
+            uint32_t v;
+            if (pi->depth < 8) {
+                v = sample_bits(row, x, pi->depth);
+                if (pi->trns && v == pi->key[0]) a = 0;
+                v = v * 255 / ((1u << pi->depth) - 1);
+            } else {
+                const uint8_t* p = row + x * step;
+                v = p[0];
+                uint32_t full = pi->depth == 16 ? (uint32_t)(p[0] << 8) | p[1] : v;
+                if (pi->trns && full == pi->key[0]) a = 0;
+            }
+            r = g = b = v;
+        } else if (pi->type == PNG_GREY_ALPHA) {
+            const uint8_t* p = row + x * 2 * step;
+            r = g = b = p[0];
+            a = p[step];
+        } else if (pi->type == PNG_RGB) {
+            const uint8_t* p = row + x * 3 * step;
+            r = p[0]; g = p[step]; b = p[2 * step];
+            if (pi->trns) {
+                uint32_t kr = step == 2 ? (uint32_t)(p[0] << 8) | p[1] : r;
+                uint32_t kg = step == 2 ? (uint32_t)(p[2] << 8) | p[3] : g;
+                uint32_t kb = step == 2 ? (uint32_t)(p[4] << 8) | p[5] : b;
+                if (kr == pi->key[0] && kg == pi->key[1] && kb == pi->key[2]) a = 0;
+            }
+        } else {   /* RGBA */
+            const uint8_t* p = row + x * 4 * step;
+            r = p[0]; g = p[step]; b = p[2 * step]; a = p[3 * step];
+        }
+        out[0] = (uint8_t)r;
+        out[1] = (uint8_t)g;
+        out[2] = (uint8_t)b;
+        out[3] = (uint8_t)a;
+    }
+}
+
+static int parse_ihdr(png_info_t* pi, const uint8_t* d, uint32_t len) {
+    if (len != 13) return -1;
+    pi->width = be32(d);
+    pi->height = be32(d + 4);
+    pi->depth = d[8];
+    pi->type = d[9];
+    if (d[10] != 0 || d[11] != 0) return -1;   /* Compression, filter method */
+    if (d[12] != 0) {
+        serial("[PNG] Error: Interlaced PNGs are not supported.\n");
+        return -1;
+    }
+    if (pi->width == 0 || pi->height == 0 || pi->width > IMAGE_MAX_DIM || pi->height > IMAGE_MAX_DIM) return -1;
+
+    switch (pi->type) {
+    case PNG_GREY:       pi->channels = 1; break;
+    case PNG_RGB:        pi->channels = 3; break;
+    case PNG_PALETTE:    pi->channels = 1; break;
+    case PNG_GREY_ALPHA: pi->channels = 2; break;
+    case PNG_RGBA:       pi->channels = 4; break;
+    default: return -1;
+    }
+
+    uint8_t dp = pi->depth;
+    bool ok;
+    if (pi->type == PNG_GREY) ok = dp == 1 || dp == 2 || dp == 4 || dp == 8 || dp == 16;
+    else if (pi->type == PNG_PALETTE) ok = dp == 1 || dp == 2 || dp == 4 || dp == 8;
+    else ok = dp == 8 || dp == 16;
+    if (!ok) {
+        serial("[PNG] Error: Bit depth %d not valid for colour type %d.\n", dp, pi->type);
+        return -1;
+    }
+
+    uint32_t bits = pi->width * pi->channels * dp;
+    pi->stride = (bits + 7) / 8;
+    pi->bpp = (pi->channels * dp + 7) / 8;
+    return 0;
+}
+
+surface_t* image_decode_png(const uint8_t* data, uint32_t size) {
+    static const uint8_t sig[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    if (size < 8 || memcmp(data, sig, 8) != 0) return 0;
+
+    /* Static: the palette makes this too big for the stack */
+    static png_info_t pi;
+    memset(&pi, 0, sizeof(pi));
+
+    /* Pass 1: header, palette, transparency, and the total IDAT size.
+       Chunk CRCs are not checked; the zlib stream carries its own checksum. */
+    uint32_t idat_total = 0, idat_chunks = 0;
+    const uint8_t* idat_first = 0;
+    bool have_ihdr = false;
+    uint32_t pos = 8;
+    while (pos + 12 <= size) {
+        uint32_t len = be32(data + pos);
+        const uint8_t* type = data + pos + 4;
+        const uint8_t* d = data + pos + 8;
+        if (len > size - pos - 12) return 0;
+
+        if (memcmp(type, "IHDR", 4) == 0) {
+            if (parse_ihdr(&pi, d, len) != 0) return 0;
+            have_ihdr = true;
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            if (len % 3 || len / 3 > 256) return 0;
+            pi.palette_len = len / 3;
+            for (uint32_t i = 0; i < pi.palette_len; i++) {
+                pi.palette[i][0] = d[i * 3];
+                pi.palette[i][1] = d[i * 3 + 1];
+                pi.palette[i][2] = d[i * 3 + 2];
+                pi.palette[i][3] = 255;
+            }
+        } else if (memcmp(type, "tRNS", 4) == 0) {
+            pi.trns = true;
+            if (pi.type == PNG_PALETTE) {
+                for (uint32_t i = 0; i < len && i < 256; i++) pi.palette[i][3] = d[i];
+            } else if (pi.type == PNG_GREY && len >= 2) {
+                pi.key[0] = (uint16_t)((d[0] << 8) | d[1]);
+            } else if (pi.type == PNG_RGB && len >= 6) {
+                pi.key[0] = (uint16_t)((d[0] << 8) | d[1]);
+                pi.key[1] = (uint16_t)((d[2] << 8) | d[3]);
+                pi.key[2] = (uint16_t)((d[4] << 8) | d[5]);
+            } else {
+                pi.trns = false;
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            if (!idat_first) idat_first = d;
+            idat_total += len;
+            idat_chunks++;
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        } else if (!(type[0] & 0x20)) {
+            serial("[PNG] Error: Unknown critical chunk %c%c%c%c.\n", type[0], type[1], type[2], type[3]);
+            return 0;
+        }
+        pos += len + 12;
+    }
+    if (!have_ihdr || !idat_total) return 0;
+    if (pi.type == PNG_PALETTE && !pi.palette_len) return 0;
+
+    /* Pass 2: the zlib stream, gathered only when split over several IDATs */
+    const uint8_t* z = idat_first;
+    uint8_t* joined = 0;
+    if (idat_chunks > 1) {
+        joined = (uint8_t*)kmalloc(idat_total);
+        if (!joined) return 0;
+        uint32_t at = 0;
+        for (pos = 8; pos + 12 <= size; ) {
+            uint32_t len = be32(data + pos);
+            if (memcmp(data + pos + 4, "IDAT", 4) == 0) {
+                memcpy(joined + at, data + pos + 8, len);
+                at += len;
+            } else if (memcmp(data + pos + 4, "IEND", 4) == 0) {
+                break;
+            }
+            pos += len + 12;
+        }
+        z = joined;
+    }
+
+    uint32_t raw_size = pi.height * (pi.stride + 1);
+    uint8_t* raw = (uint8_t*)kmalloc(raw_size);
+    surface_t* img = 0;
+    uint8_t* rgba = 0;
+    uint32_t got = 0;
+
+    if (!raw) goto out;
+    int r = inflate_zlib(z, idat_total, raw, raw_size, &got);
+    if (r != INFLATE_OK || got != raw_size) {
+        serial("[PNG] Error: Bad image data (inflate %d, %u of %u bytes).\n", r, got, raw_size);
+        goto out;
+    }
+    if (unfilter(raw, &pi) != 0) {
+        serial("[PNG] Error: Bad row filter.\n");
+        goto out;
+    }
+
+    img = surface_create(pi.width, pi.height);
+    if (!img) goto out;
+
+    bool direct = pi.depth == 8 && (pi.type == PNG_RGBA || (pi.type == PNG_RGB && !pi.trns));
+    if (!direct) {
+        rgba = (uint8_t*)kmalloc(pi.width * 4);
+        if (!rgba) {
+            surface_destroy(img);
+            img = 0;
+            goto out;
+        }
+    }
+
+    for (uint32_t y = 0; y < pi.height; y++) {
+        const uint8_t* row = raw + y * (pi.stride + 1) + 1;
+        uint32_t* o = img->pixels + y * pi.width;
+        if (!direct) {
+            expand_row(rgba, row, &pi);
+            convert_rgba32(o, rgba, pi.width);
+        } else if (pi.type == PNG_RGBA) {
+            convert_rgba32(o, row, pi.width);
+        } else {
+            convert_rgb24(o, row, pi.width);
+        }
+    }
+
+    /* Only flag alpha when some pixel actually needs it */
+    if (pi.type == PNG_RGBA || pi.type == PNG_GREY_ALPHA || pi.trns) {
+        uint32_t n = pi.width * pi.height;
+        for (uint32_t i = 0; i < n; i++) {
+            if ((img->pixels[i] >> 24) != 0xFF) {
+                surface_set_alpha(img, true);
+                break;
+            }
+        }
+    }
+
+out:
+    if (rgba) kfree(rgba);
+    if (raw) kfree(raw);
+    if (joined) kfree(joined);
+    return img;
+}
@@ -41,6 +41,15 @@ bool input_pop(input_event_t *out_event) {
     return true;
 }
 
+bool input_peek(input_event_t *out_event) {
+    if (head == tail) {
+        return false;
+    }
+    
+    *out_event = queue[tail];
+    return true;
+}
+
 void input_push_key(uint32_t keycode, bool pressed) {
     input_event_t ev;
     ev.type = INPUT_KEYBOARD;
@@ -24,6 +24,8 @@ typedef struct {
 void input_init(void);
 void input_push(input_event_t event);
 bool input_pop(input_event_t *out_event);
+/* Copy of the next event without removing it */
+bool input_peek(input_event_t *out_event);
 void input_push_key(uint32_t keycode, bool pressed);
 
 /* Synchronization for shell start */
@@ -69,6 +69,7 @@
 #include "storage/partition.h"
 #include "fs/fat/fat.h"
 #include "storage/io_sched.h"
+#include "storage/virtio_blk.h"
 #include "input/input.h"
 #include "storage/block.h"
 #include "fs/chrysfs/chrysfs.h"
@@ -78,6 +79,7 @@
 #include "video/fb_console.h"
 #include "video/gpu.h"
 #include "video/gpu_bochs.h"
+#include "hardware/pat.h"
 #include "smp/multiboot.h"
 #include "vt/vt.h"
 #include "colors/cl.h"
@@ -453,6 +455,10 @@ extern "C" void kernel_main(uint32_t magic, uint32_t addr) {
     serial_init();
     serial_write_string("=== Chrysalis OS serial online ===\r\n");
 
+    /* Pick memcpy/memset implementations from CPUID */
+    mem_init();
+    serial("[MEM] memcpy/memset: %s\n", mem_impl_name());
+
     // 13) Event queue for event-driven design
     event_queue_init();
     
@@ -501,6 +507,9 @@ extern "C" void kernel_main(uint32_t magic, uint32_t addr) {
 
     terminal_printf("Paging OK\n");
 
+    /* Write-combining PAT entry, needed before the framebuffer is mapped */
+    pat_init();
+
     // Initialize GPU Core Subsystem (Moved after paging init to ensure mappings persist)
     gpu_init();
     
@@ -568,9 +577,14 @@ extern "C" void kernel_main(uint32_t magic, uint32_t addr) {
         /* Visual test: Draw a blue rectangle to confirm video works */
         // Use generic GPU ops instead of hardcoded VESA calls
         gpu_device_t* gpu = gpu_get_primary();
+
+        /* Draw into cached RAM from here on; VRAM only sees gpu_present */
+        gpu_shadow_enable(gpu);
+
         if (gpu && gpu->ops && gpu->ops->fillrect) {
              gpu->ops->fillrect(gpu, 100, 100, 200, 150, 0x0000FF);
              gpu->ops->fillrect(gpu, 350, 100, 200, 150, 0x00FF0000);
+             gpu->ops->flush(gpu);
         }
         
         /* Initialize Colors */
@@ -605,6 +619,10 @@ extern "C" void kernel_main(uint32_t magic, uint32_t addr) {
     int ahci_ports = ahci_init();
     io_sched_init(); /* Init Async IO Scheduler */
 
+    /* virtio-blk disks (vda...) are preferred by the disk layer */
+    int virtio_disks = virtio_blk_init();
+    if (virtio_disks > 0) serial("[KERNEL] virtio-blk: %d disk(s).\n", virtio_disks);
+
     /* Robust Disk Initialization Logic */
     bool disk_found = (ahci_ports > 0); /* Assume if ports found, devices might be there */
     
@@ -618,7 +636,7 @@ extern "C" void kernel_main(uint32_t magic, uint32_t addr) {
     }
     
     /* Auto-mount: Scan partitions and try to mount FAT32 */
-    if (ahci_ports > 0) {
+    if (ahci_ports > 0 || virtio_disks > 0) {
         serial("[KERNEL] Probing partitions...\n");
         disk_probe_partitions();
         fat_automount();
@@ -757,6 +775,8 @@ pci_init();
                 else if (ev.keycode == 5) fb_cons_scroll(3);  /* Scroll Down */
             }
         }
+
+        terminal_flush();     // Draw console output left over from this pass
         
         asm volatile("hlt"); // reduce power until next interrupt
     }
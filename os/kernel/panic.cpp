@@ -183,6 +183,12 @@ extern "C" void panic_render_pretty(const char* msg) {
     draw_string(indent, line++, "Chrysalis OS - https://chrysalisos.netlify.app");
     draw_string(indent, line++, "ChrysOS Version: 0.3");
 
+    // Shadow buffer -> ecran
+    if (use_fb) {
+        gpu_device_t* gpu = gpu_get_primary();
+        if (gpu && gpu->ops->flush) gpu->ops->flush(gpu);
+    }
+
     // Protecție contra depășire (șterge jos dacă e cazul)
     if (!use_fb) {
         for (int y = line; y < VGA_HEIGHT; y++) {
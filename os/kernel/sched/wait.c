@@ -0,0 +1,81 @@
+/* kernel/sched/wait.c */
+#include "wait.h"
+#include "../hardware/hpet.h"
+#include "../time/timer.h"
+#include "../terminal.h"
+#include <errno.h>
+
+#define WAIT_MAX_QUEUES 32
+
+static void (*idle_hook)(void) = 0;
+
+static uint32_t wait_now_ms(void) {
+    if (hpet_is_active()) return (uint32_t)hpet_time_ms();
+    return timer_uptime_ms();
+}
+
+/* hlt with IF clear would never return */
+static int irqs_enabled(void) {
+    uint32_t flags;
+    asm volatile("pushf; pop %0" : "=r"(flags));
+    return (flags & 0x200) != 0;
+}
+
+static void idle_once(void) {
+    if (irqs_enabled()) asm volatile("hlt");
+    else asm volatile("pause");
+}
+
+void wait_set_idle_hook(void (*hook)(void)) {
+    idle_hook = hook;
+}
+
+void wait_queue_init(wait_queue_t* wq) {
+    wq->wake_seq = 0;
+    wq->sleepers = 0;
+}
+
+void wait_wake(wait_queue_t* wq) {
+    if (wq) wq->wake_seq++;
+}
+
+int wait_sleep_any(wait_queue_t** wqs, int n, uint32_t timeout_ms) {
+    uint32_t snap[WAIT_MAX_QUEUES];
+    if (n > WAIT_MAX_QUEUES) n = WAIT_MAX_QUEUES;
+
+    for (int i = 0; i < n; i++) {
+        snap[i] = wqs[i]->wake_seq;
+        wqs[i]->sleepers++;
+    }
+
+    uint32_t start = wait_now_ms();
+    int woken = -ETIMEDOUT;
+
+    for (;;) {
+        if (idle_hook) idle_hook();
+
+        for (int i = 0; i < n; i++) {
+            if (wqs[i]->wake_seq != snap[i]) { woken = i; break; }
+        }
+        if (woken >= 0) break;
+        if (timeout_ms != WAIT_FOREVER && wait_now_ms() - start >= timeout_ms) break;
+
+        /* Console output coalesced before the sleep shows up during it */
+        terminal_flush();
+        idle_once();
+    }
+
+    for (int i = 0; i < n; i++) wqs[i]->sleepers--;
+    return woken;
+}
+
+int wait_sleep(wait_queue_t* wq, uint32_t timeout_ms) {
+    int r = wait_sleep_any(&wq, 1, timeout_ms);
+    return r < 0 ? r : 0;
+}
+
+void wait_ms(uint32_t ms) {
+    wait_queue_t wq;
+    wait_queue_init(&wq);
+    wait_sleep(&wq, ms);
+}
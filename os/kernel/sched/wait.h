@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Wait queues.
+ * Sleepers halt the CPU until wait_wake() is called on their queue or the
+ * timeout expires. There is no running scheduler to switch to, so a sleep
+ * is "run the idle hook, then hlt until the next interrupt". The idle hook
+ * services deferred work (network RX softirq, protocol timers) which is
+ * where wakeups come from, so nothing is lost between check and sleep.
+ */
+typedef struct {
+    volatile uint32_t wake_seq;   /* Bumped by every wait_wake() */
+    volatile int sleepers;
+} wait_queue_t;
+
+#define WAIT_FOREVER 0xFFFFFFFFu
+
+void wait_queue_init(wait_queue_t* wq);
+void wait_wake(wait_queue_t* wq);
+
+/* Sleep until woken (0) or timeout (-ETIMEDOUT) */
+int  wait_sleep(wait_queue_t* wq, uint32_t timeout_ms);
+
+/* Sleep until any of the queues is woken (index) or timeout (-ETIMEDOUT) */
+int  wait_sleep_any(wait_queue_t** wqs, int n, uint32_t timeout_ms);
+
+/* Idle for a while, still running the idle hook */
+void wait_ms(uint32_t ms);
+
+/* Deferred work run by sleepers before every halt */
+void wait_set_idle_hook(void (*hook)(void));
+
+#ifdef __cplusplus
+}
+#endif
@@ -371,6 +371,7 @@ static void fly_draw_line(surface_t* surf, int x0, int y0, int x1, int y1, uint3
     int sy = (y0 < y1) ? 1 : -1;
     int err = dx + dy;
     int e2;
+    surface_damage(surf, x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1, dx + 1, 1 - dy);
 
     for (;;) {
         if (x0 >= 0 && x0 < (int)surf->width && y0 >= 0 && y0 < (int)surf->height) {
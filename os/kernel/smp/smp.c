@@ -2,6 +2,7 @@
 #include "../hardware/acpi.h"
 #include "../hardware/lapic.h"
 #include "../hardware/apic.h"
+#include "../hardware/pat.h"
 #include "../drivers/serial.h"
 #include "../drivers/pit.h"
 #include "../arch/i386/gdt.h"
@@ -38,6 +39,9 @@ void ap_main(void) {
     // For now, we assume trampoline set up a basic GDT.
     // Ideally: load_gdt(gdt_ptr); load_idt(idt_ptr);
 
+    // The PAT must match the BSP's before this core touches WC mappings
+    pat_init();
+
     // Enable APIC on this core
     // The base address is the same for all cores.
     struct MADT* madt = (struct MADT*)acpi_get_madt();
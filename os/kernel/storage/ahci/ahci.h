@@ -194,6 +194,23 @@ int ahci_write_lba(
     const void *buf
 );
 
+/* Asynchronous write: issue the command and return its slot. The buffer
+   must stay untouched until ahci_cmd_poll() reports completion.
+   Synchronous commands on the port wait for it first. */
+int ahci_write_lba_start(
+    int port_id,
+    uint64_t lba,
+    uint32_t count,
+    const void *buf
+);
+
+/* 1 = slot finished, 0 = still running, <0 = device error */
+int ahci_cmd_poll(int port_id, int slot);
+
+/* Take back a command that did not finish by restarting the command
+   engine. 0 once the HBA has let go of it, <0 if the engine hung. */
+int ahci_cmd_abort(int port_id, int slot);
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,6 +37,14 @@ static int wait_for_cmd_complete(hba_port_t *port, int slot, uint32_t timeout_ms
     return 0;
 }
 
+/* Non-queued commands must not overlap: let an asynchronous write that is
+   still in flight drain before issuing another command */
+static int wait_port_idle(hba_port_t *port, uint32_t timeout_ms) {
+    uint32_t start = get_uptime_ms();
+    while (port->ci && (get_uptime_ms() - start < timeout_ms)) { /* spin */ }
+    return port->ci ? -1 : 0;
+}
+
 /* Build a PRDT entry list for single buffer (handles up to 4G by splitting) */
 static int build_prdt_for_buffer(void *ct, const void *buf, uint32_t byte_count) {
     /* ct assumed zeroed; PRDT starts after 0x80 in cmd table per spec; we'll place first at offset 0x80 */
@@ -99,8 +107,8 @@ int ahci_read_lba(int port_no, uint64_t lba, uint32_t count, void *buf) {
         serial("[AHCI] read: port %d not initialized\n", port_no);
         return -1;
     }
-    serial("[AHCI] read: port=%d lba=%llu count=%u\n", port_no, (unsigned long long)lba, count);
 
+    if (wait_port_idle(port, 5000) != 0) return -2;
     int slot = find_cmdslot(port);
     if (slot < 0) return -2;
     void *clb = port_states[port_no].clb;
@@ -127,19 +135,12 @@ int ahci_read_lba(int port_no, uint64_t lba, uint32_t count, void *buf) {
         serial("[AHCI] read: port %d cmd failed (%d) tfd=0x%08x\n", port_no, r, port->tfd);
         return -3;
     }
-    serial("[AHCI] read: done port=%d lba=%llu count=%u\n", port_no, (unsigned long long)lba, count);
     return 0;
 }
 
-/* write implementation mirrors read but uses ATA_CMD_WRITE_DMA */
-int ahci_write_lba(int port_no, uint64_t lba, uint32_t count, const void *buf) {
-    hba_port_t *port = port_states[port_no].port;
-    if (!port) {
-        serial("[AHCI] write: port %d not initialized\n", port_no);
-        return -1;
-    }
-    serial("[AHCI] write: port=%d lba=%llu count=%u\n", port_no, (unsigned long long)lba, count);
-
+/* Build and issue a WRITE DMA; returns the slot without waiting */
+static int ahci_issue_write(int port_no, hba_port_t *port, uint64_t lba, uint32_t count, const void *buf) {
+    if (wait_port_idle(port, 5000) != 0) return -2;
     int slot = find_cmdslot(port);
     if (slot < 0) return -2;
     void *clb = port_states[port_no].clb;
@@ -161,12 +162,63 @@ int ahci_write_lba(int port_no, uint64_t lba, uint32_t count, const void *buf) {
     fis->countl = (uint8_t)(count & 0xFF);
 
     port->ci = (1U << slot);
+    return slot;
+}
+
+/* write implementation mirrors read but uses ATA_CMD_WRITE_DMA */
+int ahci_write_lba(int port_no, uint64_t lba, uint32_t count, const void *buf) {
+    hba_port_t *port = port_states[port_no].port;
+    if (!port) {
+        serial("[AHCI] write: port %d not initialized\n", port_no);
+        return -1;
+    }
+
+    int slot = ahci_issue_write(port_no, port, lba, count, buf);
+    if (slot < 0) return slot;
 
     int r = wait_for_cmd_complete(port, slot, 5000);
     if (r != 0) {
         serial("[AHCI] write: port %d cmd failed (%d) tfd=0x%08x\n", port_no, r, port->tfd);
         return -3;
     }
-    serial("[AHCI] write: done port=%d lba=%llu count=%u\n", port_no, (unsigned long long)lba, count);
+    return 0;
+}
+
+int ahci_write_lba_start(int port_no, uint64_t lba, uint32_t count, const void *buf) {
+    hba_port_t *port = port_states[port_no].port;
+    if (!port) return -1;
+    return ahci_issue_write(port_no, port, lba, count, buf);
+}
+
+int ahci_cmd_poll(int port_no, int slot) {
+    hba_port_t *port = port_states[port_no].port;
+    if (!port || slot < 0) return -1;
+    if (port->ci & (1U << slot)) return 0;
+    if (port->tfd & 0x01) { /* STS.ERR */
+        serial("[AHCI] async write: port %d slot %d failed tfd=0x%08x\n", port_no, slot, port->tfd);
+        return -3;
+    }
+    return 1;
+}
+
+int ahci_cmd_abort(int port_no, int slot) {
+    hba_port_t *port = port_states[port_no].port;
+    if (!port || slot < 0) return -1;
+    if (!(port->ci & (1U << slot))) return 0;
+
+    /* Clearing ST clears PxCI; the command is dropped once CR goes low */
+    port->cmd &= ~(1 << 0);
+    uint32_t start = get_uptime_ms();
+    while ((port->cmd & (1 << 15)) && get_uptime_ms() - start < 500) {
+        asm volatile("pause");
+    }
+    if (port->cmd & (1 << 15)) {
+        serial("[AHCI] port %d: engine did not stop, slot %d abandoned\n", port_no, slot);
+        return -1;
+    }
+    serial("[AHCI] port %d: slot %d aborted, tfd=0x%08x\n", port_no, slot, port->tfd);
+    port->serr = 0xFFFFFFFF;
+    port->is = 0xFFFFFFFF;
+    port->cmd |= (1 << 0);
     return 0;
 }
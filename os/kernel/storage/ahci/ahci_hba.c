@@ -17,6 +17,21 @@ static int ahci_block_write(block_device_t *dev, uint64_t lba, uint32_t count, c
     return ahci_write_lba(port, lba, count, buf);
 }
 
+static int ahci_block_write_start(block_device_t *dev, uint64_t lba, uint32_t count, const void *buf) {
+    int port = (int)(uintptr_t)dev->priv;
+    return ahci_write_lba_start(port, lba, count, buf);
+}
+
+static int ahci_block_write_poll(block_device_t *dev, int tag) {
+    int port = (int)(uintptr_t)dev->priv;
+    return ahci_cmd_poll(port, tag);
+}
+
+static int ahci_block_write_abort(block_device_t *dev, int tag) {
+    int port = (int)(uintptr_t)dev->priv;
+    return ahci_cmd_abort(port, tag);
+}
+
 int ahci_init(void) {
     serial("[AHCI] init start\n");
 
@@ -63,6 +78,9 @@ int ahci_init(void) {
                 bd->sector_size = 512;
                 bd->read = ahci_block_read;
                 bd->write = ahci_block_write;
+                bd->write_start = ahci_block_write_start;
+                bd->write_poll = ahci_block_write_poll;
+                bd->write_abort = ahci_block_write_abort;
                 bd->priv = (void*)(uintptr_t)i;
                 block_register(bd);
                 } else {
@@ -11,6 +11,16 @@ typedef struct block_device {
     uint32_t sector_size;
     int (*read)(struct block_device *dev, uint64_t lba, uint32_t count, void *buf);
     int (*write)(struct block_device *dev, uint64_t lba, uint32_t count, const void *buf);
+    /* Optional write-behind: start returns a tag (>= 0) without waiting,
+       poll returns 1 when it finished, 0 while busy, <0 on error */
+    int (*write_start)(struct block_device *dev, uint64_t lba, uint32_t count, const void *buf);
+    int (*write_poll)(struct block_device *dev, int tag);
+    /* Give up on a write that is still running: once this returns 0 the
+       device no longer reads the buffer. <0 if it could not be stopped. */
+    int (*write_abort)(struct block_device *dev, int tag);
+    /* Optional: make completed writes durable / drop unused sectors */
+    int (*flush)(struct block_device *dev);
+    int (*discard)(struct block_device *dev, uint64_t lba, uint32_t count);
     void *priv; // Driver private data
 } block_device_t;
 
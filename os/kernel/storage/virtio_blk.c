@@ -0,0 +1,443 @@
+#include "virtio_blk.h"
+#include "block.h"
+#include "../hardware/virtio.h"
+#include "../mm/kmalloc.h"
+#include "../mm/vmm.h"
+#include "../string.h"
+#include "../terminal.h"
+#include <errno.h>
+
+extern void serial(const char *fmt, ...);
+extern uint32_t get_uptime_ms(void);
+
+/* Request slot states */
+#define REQ_FREE  0
+#define REQ_BUSY  1
+#define REQ_DONE  2
+
+typedef struct {
+    virtio_blk_req_hdr_t hdr;           /* Device-readable */
+    virtio_blk_discard_t discard;
+    volatile uint8_t status;            /* Device-writable */
+    uint8_t state;
+    int group;                          /* Tag of the call that owns it */
+} vblk_req_t;
+
+typedef struct {
+    virtio_dev_t vdev;
+    virtq_t q;
+    block_device_t bd;
+    vblk_req_t* reqs;
+    uint32_t max_sectors;               /* Per request */
+    uint32_t seg_max;                   /* Data segments per request */
+    uint32_t size_max;                  /* Bytes per segment */
+    uint32_t discard_max;               /* Sectors per discard request */
+    int inflight;
+    int failed;                         /* Reset after a timeout did not work */
+    /* Stats */
+    uint32_t requests;
+    uint32_t sectors;
+    uint32_t irqs;
+    uint32_t sleeps;
+    uint32_t resets;
+    int max_inflight;
+} vblk_t;
+
+static vblk_t* disks[VIRTIO_BLK_MAX_DISKS];
+static int ndisks;
+
+/* hlt with IF clear would never return */
+static int irqs_enabled(void) {
+    uint32_t flags;
+    asm volatile("pushf; pop %0" : "=r"(flags));
+    return (flags & 0x200) != 0;
+}
+
+static void vblk_irq(virtio_dev_t* d, uint8_t isr) {
+    /* The ISR read acknowledged it; the waiter wakes from hlt and reaps */
+    if (isr & VIRTIO_ISR_QUEUE) ((vblk_t*)d->priv)->irqs++;
+}
+
+static void vblk_reap(vblk_t* b) {
+    if (b->failed) return;
+    vblk_req_t* r;
+    while ((r = (vblk_req_t*)virtq_get(&b->q, 0))) {
+        b->inflight--;
+        r->state = REQ_DONE;
+    }
+}
+
+/* A request timed out. The device still owns the buffers of everything in
+   flight and may write them at any time, so stop it with a reset before
+   the callers get their memory back. Busy requests complete with an I/O
+   error, then the queue is set up again. */
+static void vblk_reset(vblk_t* b) {
+    uint64_t features = b->vdev.features;
+    virtio_begin(&b->vdev);
+
+    for (int i = 0; i < VIRTIO_BLK_MAX_REQS; i++) {
+        vblk_req_t* r = &b->reqs[i];
+        if (r->state != REQ_BUSY) continue;
+        r->status = VIRTIO_BLK_S_IOERR;
+        r->state = REQ_DONE;
+    }
+    b->inflight = 0;
+    b->resets++;
+
+    virtq_free(&b->q);
+    if (virtio_negotiate(&b->vdev, features) < 0 ||
+        virtq_init(&b->vdev, &b->q, 0, VIRTQ_SIZE_MAX, 1) < 0) {
+        serial("[VIRTIO-BLK] %s: reset failed, disk offline.\n", b->bd.name);
+        virtio_fail(&b->vdev);
+        b->failed = 1;
+        return;
+    }
+    virtq_disable_irq(&b->q);
+    virtio_driver_ok(&b->vdev);
+    serial("[VIRTIO-BLK] %s: request timed out, device reset.\n", b->bd.name);
+}
+
+/* Sleep until the device completes something. The queue interrupt is
+   armed only here, with event idx that is one interrupt per wakeup. */
+static int vblk_sleep(vblk_t* b, uint32_t start) {
+    if (get_uptime_ms() - start > VIRTIO_BLK_TIMEOUT_MS) {
+        vblk_reset(b);
+        return -ETIMEDOUT;
+    }
+    if (!b->vdev.irq_handler || !irqs_enabled()) {
+        asm volatile("pause");
+        return 0;
+    }
+    if (!virtq_enable_irq(&b->q)) {
+        asm volatile("cli");
+        if (!virtq_pending(&b->q)) asm volatile("sti; hlt");
+        else asm volatile("sti");
+        b->sleeps++;
+    }
+    virtq_disable_irq(&b->q);
+    return 0;
+}
+
+static int vblk_alloc(vblk_t* b, uint32_t start) {
+    for (;;) {
+        for (int i = 0; i < VIRTIO_BLK_MAX_REQS; i++)
+            if (b->reqs[i].state == REQ_FREE) return i;
+        vblk_reap(b);
+        for (int i = 0; i < VIRTIO_BLK_MAX_REQS; i++)
+            if (b->reqs[i].state == REQ_FREE) return i;
+        int r = vblk_sleep(b, start);
+        if (r < 0) return r;
+    }
+}
+
+/* Physical segments of a buffer, merged where pages are contiguous */
+static int vblk_map(vblk_t* b, uint8_t* p, uint32_t bytes, virtq_sg_t* sg, int write) {
+    int n = 0;
+    while (bytes) {
+        uint32_t chunk = 4096 - ((uintptr_t)p & 0xFFF);
+        if (chunk > bytes) chunk = bytes;
+        if (chunk > b->size_max) chunk = b->size_max;
+        uint32_t phys = vmm_virt_to_phys(p);
+        if (n && sg[n - 1].addr + sg[n - 1].len == phys && sg[n - 1].len + chunk <= b->size_max) {
+            sg[n - 1].len += chunk;
+        } else {
+            if ((uint32_t)n == b->seg_max) return -EINVAL;
+            sg[n].addr = phys;
+            sg[n].len = chunk;
+            sg[n].write = write;
+            n++;
+        }
+        p += chunk;
+        bytes -= chunk;
+    }
+    return n;
+}
+
+/* Queue one request (not yet kicked). group < 0 starts a new group. */
+static int vblk_submit(vblk_t* b, uint32_t type, uint64_t lba, uint32_t count,
+                       void* buf, int group, uint32_t start) {
+    if (b->failed) return -EIO;
+    int idx = vblk_alloc(b, start);
+    if (idx < 0) return idx;
+
+    vblk_req_t* r = &b->reqs[idx];
+    r->hdr.type = type;
+    r->hdr.reserved = 0;
+    r->hdr.sector = type == VIRTIO_BLK_T_DISCARD ? 0 : lba;
+    r->status = 0xFF;
+    r->group = group < 0 ? idx : group;
+
+    virtq_sg_t sg[VIRTQ_INDIRECT_MAX];
+    int n = 0;
+    sg[n].addr = vmm_virt_to_phys(&r->hdr);
+    sg[n].len = sizeof(r->hdr);
+    sg[n].write = 0;
+    n++;
+
+    if (type == VIRTIO_BLK_T_IN || type == VIRTIO_BLK_T_OUT) {
+        int m = vblk_map(b, (uint8_t*)buf, count * 512, sg + n, type == VIRTIO_BLK_T_IN);
+        if (m < 0) return m;
+        n += m;
+    } else if (type == VIRTIO_BLK_T_DISCARD) {
+        r->discard.sector = lba;
+        r->discard.num_sectors = count;
+        r->discard.flags = 0;
+        sg[n].addr = vmm_virt_to_phys(&r->discard);
+        sg[n].len = sizeof(r->discard);
+        sg[n].write = 0;
+        n++;
+    }
+
+    sg[n].addr = vmm_virt_to_phys((void*)&r->status);
+    sg[n].len = 1;
+    sg[n].write = 1;
+    n++;
+
+    /* Ring full: let the device catch up */
+    while (virtq_add(&b->q, sg, n, r) < 0) {
+        virtq_kick(&b->q);
+        vblk_reap(b);
+        int e = vblk_sleep(b, start);
+        if (e < 0) return e;
+    }
+
+    r->state = REQ_BUSY;
+    b->requests++;
+    b->sectors += type == VIRTIO_BLK_T_DISCARD ? 0 : count;
+    if (++b->inflight > b->max_inflight) b->max_inflight = b->inflight;
+    return idx;
+}
+
+/* 1 when every request of the group finished (slots released), 0 while
+   busy, -EIO / -EOPNOTSUPP on a failed request */
+static int vblk_group_poll(vblk_t* b, int tag) {
+    vblk_reap(b);
+
+    int found = 0, err = 0;
+    for (int i = 0; i < VIRTIO_BLK_MAX_REQS; i++) {
+        vblk_req_t* r = &b->reqs[i];
+        if (r->state == REQ_FREE || r->group != tag) continue;
+        if (r->state == REQ_BUSY) return 0;
+        found = 1;
+        if (r->status == VIRTIO_BLK_S_UNSUPP) err = -EOPNOTSUPP;
+        else if (r->status != VIRTIO_BLK_S_OK && !err) err = -EIO;
+    }
+    if (!found) return -EINVAL;
+
+    for (int i = 0; i < VIRTIO_BLK_MAX_REQS; i++) {
+        vblk_req_t* r = &b->reqs[i];
+        if (r->state == REQ_DONE && r->group == tag) r->state = REQ_FREE;
+    }
+    return err ? err : 1;
+}
+
+static int vblk_group_wait(vblk_t* b, int tag, uint32_t start) {
+    for (;;) {
+        int r = vblk_group_poll(b, tag);
+        if (r != 0) return r < 0 ? r : 0;
+        r = vblk_sleep(b, start);
+        if (r < 0) {
+            /* The reset failed the group's requests; release the slots */
+            vblk_group_poll(b, tag);
+            return r;
+        }
+    }
+}
+
+/* Start up to VIRTIO_BLK_BATCH requests for one transfer. The tag. */
+static int vblk_start(vblk_t* b, uint32_t type, uint64_t lba, uint32_t count, uint8_t* buf) {
+    uint32_t start = get_uptime_ms();
+    uint32_t per = type == VIRTIO_BLK_T_DISCARD ? b->discard_max : b->max_sectors;
+    int tag = -1;
+
+    do {
+        uint32_t n = count < per ? count : per;
+        int r = vblk_submit(b, type, lba, n, buf, tag, start);
+        if (r < 0) {
+            if (tag >= 0) {
+                virtq_kick(&b->q);
+                vblk_group_wait(b, tag, start);
+            }
+            return r;
+        }
+        if (tag < 0) tag = r;
+        lba += n;
+        count -= n;
+        if (buf) buf += n * 512;
+    } while (count);
+
+    virtq_kick(&b->q);
+    return tag;
+}
+
+static int vblk_sync(vblk_t* b, uint32_t type, uint64_t lba, uint32_t count, uint8_t* buf) {
+    uint32_t per = type == VIRTIO_BLK_T_DISCARD ? b->discard_max : b->max_sectors;
+    do {
+        uint32_t n = count;
+        if (n > per * VIRTIO_BLK_BATCH) n = per * VIRTIO_BLK_BATCH;
+        int tag = vblk_start(b, type, lba, n, buf);
+        if (tag < 0) return tag;
+        int r = vblk_group_wait(b, tag, get_uptime_ms());
+        if (r < 0) return r;
+        lba += n;
+        count -= n;
+        if (buf) buf += n * 512;
+    } while (count);
+    return 0;
+}
+
+/* block_device_t glue */
+
+static int vblk_read(block_device_t* dev, uint64_t lba, uint32_t count, void* buf) {
+    if (count == 0) return 0;
+    return vblk_sync((vblk_t*)dev->priv, VIRTIO_BLK_T_IN, lba, count, (uint8_t*)buf);
+}
+
+static int vblk_write(block_device_t* dev, uint64_t lba, uint32_t count, const void* buf) {
+    if (count == 0) return 0;
+    return vblk_sync((vblk_t*)dev->priv, VIRTIO_BLK_T_OUT, lba, count, (uint8_t*)buf);
+}
+
+static int vblk_write_start(block_device_t* dev, uint64_t lba, uint32_t count, const void* buf) {
+    vblk_t* b = (vblk_t*)dev->priv;
+    if (count == 0 || count > b->max_sectors * VIRTIO_BLK_BATCH) return -EINVAL;
+    return vblk_start(b, VIRTIO_BLK_T_OUT, lba, count, (uint8_t*)buf);
+}
+
+static int vblk_write_poll(block_device_t* dev, int tag) {
+    return vblk_group_poll((vblk_t*)dev->priv, tag);
+}
+
+/* Only a reset makes the device drop a request it was given */
+static int vblk_write_abort(block_device_t* dev, int tag) {
+    vblk_t* b = (vblk_t*)dev->priv;
+    if (vblk_group_poll(b, tag) != 0) return 0;
+    vblk_reset(b);
+    vblk_group_poll(b, tag);
+    return 0;
+}
+
+static int vblk_flush(block_device_t* dev) {
+    vblk_t* b = (vblk_t*)dev->priv;
+    if (!virtio_has(&b->vdev, VIRTIO_BLK_F_FLUSH)) return 0;   /* Write-through */
+    return vblk_sync(b, VIRTIO_BLK_T_FLUSH, 0, 0, NULL);
+}
+
+static int vblk_discard(block_device_t* dev, uint64_t lba, uint32_t count) {
+    vblk_t* b = (vblk_t*)dev->priv;
+    if (!virtio_has(&b->vdev, VIRTIO_BLK_F_DISCARD)) return -EOPNOTSUPP;
+    if (count == 0) return 0;
+    return vblk_sync(b, VIRTIO_BLK_T_DISCARD, lba, count, NULL);
+}
+
+static int vblk_probe(int index) {
+    vblk_t* b = (vblk_t*)kmalloc(sizeof(vblk_t));
+    if (!b) return -ENOMEM;
+    memset(b, 0, sizeof(*b));
+
+    int r = virtio_pci_find(VIRTIO_ID_BLK_LEGACY, VIRTIO_ID_BLK_MODERN, index, &b->vdev);
+    if (r < 0) {
+        kfree(b);
+        return r;
+    }
+    b->vdev.priv = b;
+
+    virtio_begin(&b->vdev);
+    uint64_t want = VIRTIO_FEATURE(VIRTIO_BLK_F_SIZE_MAX) |
+                    VIRTIO_FEATURE(VIRTIO_BLK_F_SEG_MAX) |
+                    VIRTIO_FEATURE(VIRTIO_BLK_F_FLUSH) |
+                    VIRTIO_FEATURE(VIRTIO_BLK_F_DISCARD) |
+                    VIRTIO_FEATURE(VIRTIO_F_INDIRECT_DESC) |
+                    VIRTIO_FEATURE(VIRTIO_F_EVENT_IDX);
+    if (virtio_negotiate(&b->vdev, want) < 0) {
+        serial("[VIRTIO-BLK] Feature negotiation failed.\n");
+        kfree(b);
+        return -EIO;
+    }
+
+    r = virtq_init(&b->vdev, &b->q, 0, VIRTQ_SIZE_MAX, 1);
+    b->reqs = (vblk_req_t*)kmalloc(VIRTIO_BLK_MAX_REQS * sizeof(vblk_req_t));
+    if (r < 0 || !b->reqs) {
+        virtio_fail(&b->vdev);
+        if (r == 0) virtq_free(&b->q);
+        if (b->reqs) kfree(b->reqs);
+        kfree(b);
+        return r < 0 ? r : -ENOMEM;
+    }
+    memset(b->reqs, 0, VIRTIO_BLK_MAX_REQS * sizeof(vblk_req_t));
+
+    /* Request geometry: header and status take two descriptors */
+    uint32_t limit = b->q.size < VIRTQ_INDIRECT_MAX ? b->q.size : VIRTQ_INDIRECT_MAX;
+    b->seg_max = limit - 2;
+    if (virtio_has(&b->vdev, VIRTIO_BLK_F_SEG_MAX)) {
+        uint32_t s = virtio_cfg32(&b->vdev, VIRTIO_BLK_CFG_SEG_MAX);
+        if (s && s < b->seg_max) b->seg_max = s;
+    }
+    b->size_max = 4096;
+    if (virtio_has(&b->vdev, VIRTIO_BLK_F_SIZE_MAX)) {
+        uint32_t s = virtio_cfg32(&b->vdev, VIRTIO_BLK_CFG_SIZE_MAX);
+        if (s >= 512) b->size_max = s;
+    }
+    /* Worst case every page is its own segment (plus a partial one) */
+    uint32_t seg_bytes = b->size_max < 4096 ? b->size_max : 4096;
+    b->max_sectors = (b->seg_max - 1) * seg_bytes / 512;
+    if (b->max_sectors > VIRTIO_BLK_REQ_SECTORS) b->max_sectors = VIRTIO_BLK_REQ_SECTORS;
+    if (b->max_sectors == 0) b->max_sectors = 1;
+
+    b->discard_max = 0x400000;   /* 2 GB */
+    if (virtio_has(&b->vdev, VIRTIO_BLK_F_DISCARD)) {
+        uint32_t s = virtio_cfg32(&b->vdev, VIRTIO_BLK_CFG_MAX_DISCARD_SECT);
+        if (s && s < b->discard_max) b->discard_max = s;
+    }
+
+    virtq_disable_irq(&b->q);
+    virtio_irq_attach(&b->vdev, vblk_irq);
+    virtio_driver_ok(&b->vdev);
+
+    /* Register as Block Device */
+    b->bd.name[0] = 'v';
+    b->bd.name[1] = 'd';
+    b->bd.name[2] = 'a' + ndisks;
+    b->bd.name[3] = 0;
+    b->bd.sector_count = virtio_cfg64(&b->vdev, VIRTIO_BLK_CFG_CAPACITY);
+    b->bd.sector_size = 512;
+    b->bd.read = vblk_read;
+    b->bd.write = vblk_write;
+    b->bd.write_start = vblk_write_start;
+    b->bd.write_poll = vblk_write_poll;
+    b->bd.write_abort = vblk_write_abort;
+    b->bd.flush = vblk_flush;
+    b->bd.discard = vblk_discard;
+    b->bd.priv = b;
+    block_register(&b->bd);
+
+    serial("[VIRTIO-BLK] %s: %s, queue %d%s, %d sectors/request, features %x\n",
+           b->bd.name, b->vdev.modern ? "modern" : "legacy", b->q.size,
+           b->q.indirect ? " (indirect)" : "", b->max_sectors, (uint32_t)b->vdev.features);
+    disks[ndisks++] = b;
+    return 0;
+}
+
+int virtio_blk_init(void) {
+    for (int i = 0; ndisks < VIRTIO_BLK_MAX_DISKS; i++) {
+        if (vblk_probe(i) == -ENODEV) break;
+    }
+    return ndisks;
+}
+
+void virtio_blk_print_stats(void) {
+    for (int i = 0; i < ndisks; i++) {
+        vblk_t* b = disks[i];
+        terminal_printf("%s: %s%s%s%s, %u sectors/request\n", b->bd.name,
+                        b->vdev.modern ? "modern" : "legacy",
+                        b->q.indirect ? ", indirect" : "",
+                        virtio_has(&b->vdev, VIRTIO_BLK_F_FLUSH) ? ", flush" : "",
+                        virtio_has(&b->vdev, VIRTIO_BLK_F_DISCARD) ? ", discard" : "",
+                        b->max_sectors);
+        terminal_printf("  %u requests, %u sectors, peak %d in flight, %u IRQs, %u sleeps, "
+                        "kicks %u (%u suppressed), %u resets%s\n",
+                        b->requests, b->sectors, b->max_inflight, b->irqs, b->sleeps,
+                        b->q.kicks, b->q.kicks_suppressed, b->resets,
+                        b->failed ? ", offline" : "");
+    }
+}
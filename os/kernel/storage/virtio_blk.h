@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* virtio-blk, registered as vda, vdb, ...
+ *
+ * Every request is header + data segments + status byte, posted through
+ * one indirect descriptor when the device supports it. Transfers are
+ * split into requests of at most max_sectors that are all in flight at
+ * once; the queue interrupt is only armed while somebody waits.
+ */
+
+/* Device feature bits */
+#define VIRTIO_BLK_F_SIZE_MAX   1
+#define VIRTIO_BLK_F_SEG_MAX    2
+#define VIRTIO_BLK_F_RO         5
+#define VIRTIO_BLK_F_FLUSH      9
+#define VIRTIO_BLK_F_DISCARD    13
+
+/* Device configuration */
+#define VIRTIO_BLK_CFG_CAPACITY         0    /* 512-byte sectors */
+#define VIRTIO_BLK_CFG_SIZE_MAX         8
+#define VIRTIO_BLK_CFG_SEG_MAX          12
+#define VIRTIO_BLK_CFG_MAX_DISCARD_SECT 36
+
+/* Request types and status */
+#define VIRTIO_BLK_T_IN         0
+#define VIRTIO_BLK_T_OUT        1
+#define VIRTIO_BLK_T_FLUSH      4
+#define VIRTIO_BLK_T_DISCARD    11
+
+#define VIRTIO_BLK_S_OK         0
+#define VIRTIO_BLK_S_IOERR      1
+#define VIRTIO_BLK_S_UNSUPP     2
+
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) virtio_blk_req_hdr_t;
+
+typedef struct {
+    uint64_t sector;
+    uint32_t num_sectors;
+    uint32_t flags;
+} __attribute__((packed)) virtio_blk_discard_t;
+
+#define VIRTIO_BLK_MAX_DISKS    4
+#define VIRTIO_BLK_MAX_REQS     32      /* Request slots per disk */
+#define VIRTIO_BLK_REQ_SECTORS  128     /* Largest single request (64 KB) */
+#define VIRTIO_BLK_BATCH        8       /* Requests one call keeps in flight */
+#define VIRTIO_BLK_TIMEOUT_MS   5000
+
+/* Probe and register every virtio-blk device. Disks registered. */
+int  virtio_blk_init(void);
+
+void virtio_blk_print_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
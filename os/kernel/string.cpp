@@ -1,24 +1,56 @@
 /* kernel/string.cpp
-   Simple, small implementations of common string/memory routines
-   suitable for a freestanding kernel.
+   Common string/memory routines for a freestanding kernel. The memory
+   routines are picked at boot from CPUID (see mem_init()).
 */
 
 #include "string.h"
 #include <stddef.h>
 #include <stdint.h>
 #include "mem/kmalloc.h"
+#include "hardware/sse.h"
 
 /* ---------- string ops ---------- */
 
+/* Word-at-a-time scans read whole aligned words, which never cross a
+   page boundary, so looking past the terminator is harmless */
+typedef uint32_t __attribute__((may_alias)) word_t;
+#define HAS_ZERO(w) (((w) - 0x01010101u) & ~(w) & 0x80808080u)
+
+size_t strlen_bytes(const char* s)
+{
+    const char* p = s;
+    while (*p) ++p;
+    return (size_t)(p - s);
+}
+
 size_t strlen(const char* s)
 {
     const char* p = s;
+    while ((uintptr_t)p & 3) {
+        if (!*p) return (size_t)(p - s);
+        ++p;
+    }
+    const word_t* w = (const word_t*)p;
+    while (!HAS_ZERO(*w)) ++w;
+    p = (const char*)w;
     while (*p) ++p;
     return (size_t)(p - s);
 }
 
 int strcmp(const char* a, const char* b)
 {
+    /* Equal misalignment: compare words until one differs or ends */
+    if ((((uintptr_t)a ^ (uintptr_t)b) & 3) == 0) {
+        while ((uintptr_t)a & 3) {
+            if (*a != *b || !*a) return (unsigned char)*a - (unsigned char)*b;
+            a++; b++;
+        }
+        const word_t* wa = (const word_t*)a;
+        const word_t* wb = (const word_t*)b;
+        while (*wa == *wb && !HAS_ZERO(*wa)) { wa++; wb++; }
+        a = (const char*)wa;
+        b = (const char*)wb;
+    }
     while (*a && (*a == *b)) { a++; b++; }
     return (unsigned char)*a - (unsigned char)*b;
 }
@@ -91,7 +123,13 @@ char* strstr(const char* haystack, const char* needle)
 
 /* ---------- memory ops ---------- */
 
-void* memcpy(void* dest, const void* src, size_t n)
+/* The SSE2 paths save and restore the XMM registers they touch: nothing
+   saves FPU state on interrupts, and IRQ handlers copy too. */
+
+/* The reference loops must not be turned back into memcpy/memset calls */
+#define NO_LIBCALL __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+NO_LIBCALL void* memcpy_bytes(void* dest, const void* src, size_t n)
 {
     unsigned char* d = (unsigned char*)dest;
     const unsigned char* s = (const unsigned char*)src;
@@ -99,19 +137,98 @@ void* memcpy(void* dest, const void* src, size_t n)
     return dest;
 }
 
-void* memmove(void* dest, const void* src, size_t n)
+void* memcpy_rep(void* dest, const void* src, size_t n)
 {
-    unsigned char* d = (unsigned char*)dest;
-    const unsigned char* s = (const unsigned char*)src;
-    if (d < s) {
-        for (size_t i = 0; i < n; ++i) d[i] = s[i];
-    } else if (d > s) {
-        for (size_t i = n; i > 0; --i) d[i-1] = s[i-1];
+    void* d = dest;
+    size_t words = n >> 2, tail = n & 3;
+    asm volatile("rep movsl" : "+D"(d), "+S"(src), "+c"(words) : : "memory");
+    asm volatile("rep movsb" : "+D"(d), "+S"(src), "+c"(tail) : : "memory");
+    return dest;
+}
+
+void* memcpy_erms(void* dest, const void* src, size_t n)
+{
+    void* d = dest;
+    asm volatile("rep movsb" : "+D"(d), "+S"(src), "+c"(n) : : "memory");
+    return dest;
+}
+
+/* 64-byte blocks into a 16-byte aligned destination */
+static void sse2_copy_blocks(uint8_t* d, const uint8_t* s, size_t blocks, int nt)
+{
+    uint8_t save[64];
+    asm volatile("movdqu %%xmm0, 0(%0)\n\t"
+                 "movdqu %%xmm1, 16(%0)\n\t"
+                 "movdqu %%xmm2, 32(%0)\n\t"
+                 "movdqu %%xmm3, 48(%0)" : : "r"(save) : "memory");
+    if (nt) {
+        asm volatile("1:\n\t"
+                     "movdqu 0(%1), %%xmm0\n\t"
+                     "movdqu 16(%1), %%xmm1\n\t"
+                     "movdqu 32(%1), %%xmm2\n\t"
+                     "movdqu 48(%1), %%xmm3\n\t"
+                     "movntdq %%xmm0, 0(%0)\n\t"
+                     "movntdq %%xmm1, 16(%0)\n\t"
+                     "movntdq %%xmm2, 32(%0)\n\t"
+                     "movntdq %%xmm3, 48(%0)\n\t"
+                     "add $64, %1\n\t"
+                     "add $64, %0\n\t"
+                     "dec %2\n\t"
+                     "jnz 1b\n\t"
+                     "sfence"
+                     : "+r"(d), "+r"(s), "+r"(blocks) : : "memory");
+    } else {
+        asm volatile("1:\n\t"
+                     "movdqu 0(%1), %%xmm0\n\t"
+                     "movdqu 16(%1), %%xmm1\n\t"
+                     "movdqu 32(%1), %%xmm2\n\t"
+                     "movdqu 48(%1), %%xmm3\n\t"
+                     "movdqa %%xmm0, 0(%0)\n\t"
+                     "movdqa %%xmm1, 16(%0)\n\t"
+                     "movdqa %%xmm2, 32(%0)\n\t"
+                     "movdqa %%xmm3, 48(%0)\n\t"
+                     "add $64, %1\n\t"
+                     "add $64, %0\n\t"
+                     "dec %2\n\t"
+                     "jnz 1b"
+                     : "+r"(d), "+r"(s), "+r"(blocks) : : "memory");
+    }
+    asm volatile("movdqu 0(%0), %%xmm0\n\t"
+                 "movdqu 16(%0), %%xmm1\n\t"
+                 "movdqu 32(%0), %%xmm2\n\t"
+                 "movdqu 48(%0), %%xmm3" : : "r"(save) : "memory");
+}
+
+/* Forward only, so it also serves memmove with dest below src */
+static void* memcpy_sse2_common(void* dest, const void* src, size_t n, int nt)
+{
+    if (n < MEM_SSE2_MIN_LEN) return memcpy_rep(dest, src, n);
+
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    if (head) {
+        memcpy_rep(d, s, head);
+        d += head; s += head; n -= head;
     }
+    size_t blocks = n >> 6;
+    sse2_copy_blocks(d, s, blocks, nt);
+    d += blocks << 6; s += blocks << 6;
+    memcpy_rep(d, s, n & 63);
     return dest;
 }
 
-void* memset(void* s, int c, size_t n)
+void* memcpy_sse2(void* dest, const void* src, size_t n)
+{
+    return memcpy_sse2_common(dest, src, n, 0);
+}
+
+void* memcpy_nt(void* dest, const void* src, size_t n)
+{
+    return memcpy_sse2_common(dest, src, n, 1);
+}
+
+NO_LIBCALL void* memset_bytes(void* s, int c, size_t n)
 {
     unsigned char* p = (unsigned char*)s;
     unsigned char uc = (unsigned char)c;
@@ -119,7 +236,160 @@ void* memset(void* s, int c, size_t n)
     return s;
 }
 
-int memcmp(const void* s1, const void* s2, size_t n)
+void* memset_rep(void* s, int c, size_t n)
+{
+    void* d = s;
+    uint32_t v = (uint8_t)c * 0x01010101u;
+    size_t words = n >> 2, tail = n & 3;
+    asm volatile("rep stosl" : "+D"(d), "+c"(words) : "a"(v) : "memory");
+    asm volatile("rep stosb" : "+D"(d), "+c"(tail) : "a"(v) : "memory");
+    return s;
+}
+
+void* memset_erms(void* s, int c, size_t n)
+{
+    void* d = s;
+    asm volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(c) : "memory");
+    return s;
+}
+
+/* 64-byte blocks of a 32-bit pattern into a 16-byte aligned destination */
+static void sse2_fill_blocks(uint8_t* p, uint32_t v, size_t blocks, int nt)
+{
+    if (!blocks) return;
+    uint8_t save[16];
+    asm volatile("movdqu %%xmm0, (%0)" : : "r"(save) : "memory");
+    asm volatile("movd %0, %%xmm0\n\t"
+                 "pshufd $0, %%xmm0, %%xmm0" : : "r"(v));
+    if (nt) {
+        asm volatile("1:\n\t"
+                     "movntdq %%xmm0, 0(%0)\n\t"
+                     "movntdq %%xmm0, 16(%0)\n\t"
+                     "movntdq %%xmm0, 32(%0)\n\t"
+                     "movntdq %%xmm0, 48(%0)\n\t"
+                     "add $64, %0\n\t"
+                     "dec %1\n\t"
+                     "jnz 1b\n\t"
+                     "sfence"
+                     : "+r"(p), "+r"(blocks) : : "memory");
+    } else {
+        asm volatile("1:\n\t"
+                     "movdqa %%xmm0, 0(%0)\n\t"
+                     "movdqa %%xmm0, 16(%0)\n\t"
+                     "movdqa %%xmm0, 32(%0)\n\t"
+                     "movdqa %%xmm0, 48(%0)\n\t"
+                     "add $64, %0\n\t"
+                     "dec %1\n\t"
+                     "jnz 1b"
+                     : "+r"(p), "+r"(blocks) : : "memory");
+    }
+    asm volatile("movdqu (%0), %%xmm0" : : "r"(save) : "memory");
+}
+
+static void* memset_sse2_common(void* s, int c, size_t n, int nt)
+{
+    if (n < MEM_SSE2_MIN_LEN) return memset_rep(s, c, n);
+
+    uint8_t* d = (uint8_t*)s;
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    if (head) {
+        memset_rep(d, c, head);
+        d += head; n -= head;
+    }
+
+    size_t blocks = n >> 6;
+    sse2_fill_blocks(d, (uint8_t)c * 0x01010101u, blocks, nt);
+    d += blocks << 6;
+    memset_rep(d, c, n & 63);
+    return s;
+}
+
+void* memset_sse2(void* s, int c, size_t n)
+{
+    return memset_sse2_common(s, c, n, 0);
+}
+
+void* memset_nt(void* s, int c, size_t n)
+{
+    return memset_sse2_common(s, c, n, 1);
+}
+
+/* rep movsd/stosd need nothing from the CPU, so they serve early boot */
+static void* (*memcpy_impl)(void*, const void*, size_t) = memcpy_rep;
+static void* (*memset_impl)(void*, int, size_t) = memset_rep;
+static int mem_has_sse2 = 0;      /* Also enables the NT paths */
+static const char* mem_name = "rep movsd";
+
+void mem_init(void)
+{
+    if (cpu_has_sse2()) {
+        sse_enable();
+        mem_has_sse2 = 1;
+    }
+    if (cpu_has_erms()) {
+        memcpy_impl = memcpy_erms;
+        memset_impl = memset_erms;
+        mem_name = "rep movsb (erms)";
+    } else if (mem_has_sse2) {
+        memcpy_impl = memcpy_sse2;
+        memset_impl = memset_sse2;
+        mem_name = "sse2";
+    }
+}
+
+const char* mem_impl_name(void)
+{
+    return mem_name;
+}
+
+void* memcpy(void* dest, const void* src, size_t n)
+{
+    if (n >= MEM_NT_THRESHOLD && mem_has_sse2) return memcpy_nt(dest, src, n);
+    return memcpy_impl(dest, src, n);
+}
+
+uint32_t* memset32(uint32_t* dst, uint32_t v, size_t count)
+{
+    uint32_t* d = dst;
+    if (mem_has_sse2 && count >= MEM_SSE2_MIN_LEN / 4) {
+        while (((uintptr_t)d & 15) && count) {
+            *d++ = v;
+            count--;
+        }
+        size_t blocks = count >> 4;
+        sse2_fill_blocks((uint8_t*)d, v, blocks, count * 4 >= MEM_NT_THRESHOLD);
+        d += blocks << 4;
+        count &= 15;
+    }
+    asm volatile("rep stosl" : "+D"(d), "+c"(count) : "a"(v) : "memory");
+    return dst;
+}
+
+/* Overlap with dest above src copies downwards a word at a time */
+NO_LIBCALL void* memmove(void* dest, const void* src, size_t n)
+{
+    unsigned char* d = (unsigned char*)dest;
+    const unsigned char* s = (const unsigned char*)src;
+    if (d <= s || d >= s + n) return memcpy(dest, src, n);
+
+    while (n & 3) {
+        --n;
+        d[n] = s[n];
+    }
+    while (n) {
+        n -= 4;
+        *(word_t*)(d + n) = *(const word_t*)(s + n);
+    }
+    return dest;
+}
+
+void* memset(void* s, int c, size_t n)
+{
+    if (n >= MEM_NT_THRESHOLD && mem_has_sse2) return memset_nt(s, c, n);
+    return memset_impl(s, c, n);
+}
+
+int memcmp_bytes(const void* s1, const void* s2, size_t n)
 {
     const unsigned char* a = (const unsigned char*)s1;
     const unsigned char* b = (const unsigned char*)s2;
@@ -129,6 +399,20 @@ int memcmp(const void* s1, const void* s2, size_t n)
     return 0;
 }
 
+/* Skip equal words, then find the differing byte */
+int memcmp(const void* s1, const void* s2, size_t n)
+{
+    const unsigned char* a = (const unsigned char*)s1;
+    const unsigned char* b = (const unsigned char*)s2;
+    while (n >= 4 && *(const word_t*)a == *(const word_t*)b) {
+        a += 4; b += 4; n -= 4;
+    }
+    for (; n; --n, ++a, ++b) {
+        if (*a != *b) return *a - *b;
+    }
+    return 0;
+}
+
 /* ---------- small integer->string helpers (useful for debug) ---------- */
 
 char* itoa_dec(char* out, int32_t v)
@@ -20,12 +20,38 @@ char* strrchr(const char* s, int c);
 char* strstr(const char* haystack, const char* needle);
 char* strdup(const char* s);
 
-/* Memory helpers (byte-oriented) */
+/* Memory helpers. memcpy/memmove/memset go through the implementation
+   mem_init() picks from CPUID; before that rep movsd/stosd is used.
+   Blocks of MEM_NT_THRESHOLD bytes or more (framebuffers) are written
+   with non-temporal stores when SSE2 is present. */
 void* memcpy(void* dest, const void* src, size_t n);
 void* memmove(void* dest, const void* src, size_t n);
 void* memset(void* s, int c, size_t n);
 int memcmp(const void* s1, const void* s2, size_t n);
 
+#define MEM_SSE2_MIN_LEN   256              /* Below this rep movs wins */
+#define MEM_NT_THRESHOLD   (256 * 1024)     /* Larger than the caches care for */
+
+void mem_init(void);
+const char* mem_impl_name(void);
+
+/* Fill count 32-bit words (pixels) with v; dst must be 4-byte aligned */
+uint32_t* memset32(uint32_t* dst, uint32_t v, size_t count);
+
+/* Individual implementations (benchmarking) */
+void* memcpy_bytes(void* dest, const void* src, size_t n);
+void* memcpy_rep(void* dest, const void* src, size_t n);     /* rep movsd */
+void* memcpy_erms(void* dest, const void* src, size_t n);    /* rep movsb */
+void* memcpy_sse2(void* dest, const void* src, size_t n);
+void* memcpy_nt(void* dest, const void* src, size_t n);      /* SSE2, movntdq */
+void* memset_bytes(void* s, int c, size_t n);
+void* memset_rep(void* s, int c, size_t n);
+void* memset_erms(void* s, int c, size_t n);
+void* memset_sse2(void* s, int c, size_t n);
+void* memset_nt(void* s, int c, size_t n);
+size_t strlen_bytes(const char* s);
+int memcmp_bytes(const void* s1, const void* s2, size_t n);
+
 /* Small convenience conversions */
 char* itoa_dec(char* out, int32_t v); /* decimal, returns out */
 char* utoa_hex(char* out, uint32_t v); /* hex (lowercase), returns out */
@@ -7,7 +7,8 @@
 #include "drivers/serial.h"
 #include "video/surface.h"
 #include "string.h"
-#include "video/font8x16.h"
+#include "video/glyph.h"
+#include "video/text_damage.h"
 
 extern "C" void serial(const char *fmt, ...);
 
@@ -47,56 +48,81 @@ static void scroll() {
     row = 24;
 }
 
-/* Window Mode Helpers */
+/* Window Mode Helpers
+ *
+ * The window keeps its text in a cell grid. putchar only changes cells
+ * and marks them; term_window_flush draws the marked cells into the
+ * surface once per frame, moving the pixels once for all the scrolls
+ * in between. */
+#define TERM_MAX_COLS 160
+#define TERM_MAX_ROWS 64
+
+static char term_cells[TERM_MAX_ROWS * TERM_MAX_COLS];
+static text_damage_t term_damage;
+
+static int term_cols() {
+    int c = term_w / 8;
+    return c > TERM_MAX_COLS ? TERM_MAX_COLS : c;
+}
+
+static int term_rows() {
+    int r = term_h / 16;
+    return r > TERM_MAX_ROWS ? TERM_MAX_ROWS : r;
+}
+
+static void term_window_reset() {
+    memset(term_cells, ' ', sizeof(term_cells));
+    text_damage_clear(&term_damage);
+}
+
+static void term_window_set(char c, int x, int y) {
+    if (x >= term_cols() || y >= term_rows()) return;
+    term_cells[y * TERM_MAX_COLS + x] = c;
+    text_damage_add(&term_damage, y, x, x + 1);
+}
+
 static void term_window_scroll() {
-    if (!term_surface) return;
-    /* Move pixels up by 16 rows */
+    int total_rows = term_rows();
+    if (total_rows <= 0) return;
+
+    memmove(term_cells, term_cells + TERM_MAX_COLS, (total_rows - 1) * TERM_MAX_COLS);
+    memset(term_cells + (total_rows - 1) * TERM_MAX_COLS, ' ', TERM_MAX_COLS);
+    text_damage_scroll(&term_damage, total_rows, term_cols());
+
+    row = total_rows - 1;
+}
+
+static void term_window_flush() {
+    if (!term_surface || !text_damage_any(&term_damage)) return;
     uint32_t pitch = term_surface->width; // 32bpp assumed
     uint32_t* pixels = term_surface->pixels;
-    int total_rows = term_h / 16;
-    
-    /* Scroll only the rect area */
-    for (int y = 1; y < total_rows; y++) {
-        int dst_y = term_y + (y - 1) * 16;
-        int src_y = term_y + y * 16;
-        
-        /* Move 16 scanlines */
-        for (int i = 0; i < 16; i++) {
-            uint32_t* dst_row = pixels + (dst_y + i) * pitch + term_x;
-            uint32_t* src_row = pixels + (src_y + i) * pitch + term_x;
+    int total_rows = term_rows();
+
+    /* Move pixels up by all pending scrolls at once (if the whole text
+       scrolled away, every row is marked instead) */
+    int n = (int)term_damage.scrolled;
+    if (n > 0 && n < total_rows) {
+        for (int i = 0; i < (total_rows - n) * 16; i++) {
+            uint32_t* dst_row = pixels + (term_y + i) * pitch + term_x;
+            uint32_t* src_row = pixels + (term_y + i + n * 16) * pitch + term_x;
             memmove(dst_row, src_row, term_w * 4);
         }
+        surface_damage(term_surface, term_x, term_y, term_w, (total_rows - n) * 16);
     }
 
-    /* Clear bottom line */
-    int bottom_y = term_y + (total_rows - 1) * 16;
-    for (int i = 0; i < 16; i++) {
-        uint32_t* row_ptr = pixels + (bottom_y + i) * pitch + term_x;
-        for (int x = 0; x < term_w; x++) row_ptr[x] = 0xFFFFFFFF; /* White */
-    }
-    
-    row = total_rows - 1;
-}
-
-static void term_window_putpixel(int x, int y, uint32_t color) {
-    if (!term_surface) return;
-    int px = term_x + x;
-    int py = term_y + y;
-    if (px < 0 || py < 0 || px >= (int)term_surface->width || py >= (int)term_surface->height) return;
-    if (x >= term_w || y >= term_h) return;
-    
-    term_surface->pixels[py * term_surface->width + px] = color;
-}
-
-static void term_window_draw_char(char c, int x, int y) {
-    const uint8_t* glyph = &font8x16[(uint8_t)c * 16];
-    for (int i = 0; i < 16; i++) {
-        for (int j = 0; j < 8; j++) {
-            /* Windows 1.0 Console: Black text (0xFF000000) on White background (0xFFFFFFFF) */
-            uint32_t color = (glyph[i] & (1 << (7-j))) ? 0xFF000000 : 0xFFFFFFFF;
-            term_window_putpixel(x + j, y + i, color);
+    /* Windows 1.0 Console: Black text (0xFF000000) on White background (0xFFFFFFFF) */
+    const glyph_lut_t* lut = glyph_lut(0xFF000000, 0xFFFFFFFF);
+    uint32_t* origin = pixels + term_y * pitch + term_x;
+    uint32_t x0, x1;
+    for (int y = text_damage_next(&term_damage, 0, &x0, &x1); y >= 0 && y < total_rows;
+         y = text_damage_next(&term_damage, y + 1, &x0, &x1)) {
+        for (uint32_t x = x0; x < x1; x++) {
+            glyph_draw(origin, pitch, term_w, term_h, x * 8, y * 16,
+                       (uint8_t)term_cells[y * TERM_MAX_COLS + x], lut);
         }
+        surface_damage(term_surface, term_x + x0 * 8, term_y + y * 16, (x1 - x0) * 8, 16);
     }
+    text_damage_clear(&term_damage);
 }
 
 extern "C" void terminal_set_backend_fb(bool active) {
@@ -126,6 +152,8 @@ extern "C" void terminal_clear() {
             uint32_t* row_ptr = pixels + (term_y + y) * pitch + term_x;
             for (int x = 0; x < term_w; x++) row_ptr[x] = 0xFFFFFFFF;
         }
+        surface_damage(term_surface, term_x, term_y, term_w, term_h);
+        term_window_reset();
         row = 0; col = 0;
         term_dirty = true;
         return;
@@ -155,8 +183,8 @@ extern "C" void terminal_putchar(char c) {
     }
 
     if (term_mode == TERMINAL_MODE_WINDOW && term_surface) {
-        int max_cols = term_w / 8;
-        int max_rows = term_h / 16;
+        int max_cols = term_cols();
+        int max_rows = term_rows();
 
         if (c == '\n') {
             row++; col = 0;
@@ -168,13 +196,13 @@ extern "C" void terminal_putchar(char c) {
         if (c == '\b') {
             if (col > 0) {
                 col--;
-                term_window_draw_char(' ', col * 8, row * 16);
+                term_window_set(' ', col, row);
             }
             term_dirty = true;
             return;
         }
 
-        term_window_draw_char(c, col * 8, row * 16);
+        term_window_set(c, col, row);
         col++;
         if (col >= max_cols) {
             col = 0; row++;
@@ -231,6 +259,14 @@ extern "C" void terminal_writestring(const char* s) {
         terminal_putchar(*s++);
 }
 
+extern "C" void terminal_flush(void) {
+    if (term_mode == TERMINAL_MODE_WINDOW) {
+        term_window_flush();
+        return;
+    }
+    if (use_fb_console) fb_cons_flush();
+}
+
 extern "C" void terminal_init() {
     terminal_clear();
 }
@@ -243,6 +279,7 @@ extern "C" void terminal_set_surface(surface_t* s) {
         term_y = 0;
         term_w = s->width;
         term_h = s->height;
+        term_window_reset();
         row = 0;
         col = 0;
         term_dirty = true;
@@ -262,6 +299,7 @@ extern "C" void terminal_set_rect(int x, int y, int w, int h) {
     term_y = y;
     term_w = w;
     term_h = h;
+    term_window_reset();
     row = 0;
     col = 0;
     term_dirty = true;
@@ -425,6 +463,9 @@ extern "C" void terminal_vprintf(const char* fmt, void* va_ptr)
     }
 
     va_end(args);
+
+    /* One draw per printf; the window is drawn by the WM frame */
+    if (term_mode == TERMINAL_MODE_FB) fb_cons_flush();
 }
 
 /* wrapper expected by callers */
@@ -14,6 +14,11 @@ void terminal_writestring(const char* s);
 void terminal_clear();
 void terminal_init();
 
+/* Draw pending output. Text is drawn lazily: the frame loop (or the idle
+   loop in text mode) flushes, as do sleepers before they halt and the end
+   of each writestring/printf. Loops that halt on their own call it first. */
+void terminal_flush(void);
+
 /* Switch backend to Framebuffer Console */
 void terminal_set_backend_fb(bool active);
 
@@ -10,6 +10,10 @@
 static volatile uint64_t ticks = 0;
 static uint32_t tick_hz = 100;
 
+/* Uptime carried over from before the last rate change */
+static uint64_t base_ticks = 0;
+static uint32_t base_ms = 0;
+
 /* IRQ0 handler */
 static void timer_irq_handler(registers_t* regs)
 {
@@ -17,23 +21,44 @@ static void timer_irq_handler(registers_t* regs)
     ticks++;
 }
 
+static void pit_program(uint32_t frequency)
+{
+    // Configurare Hardware PIT (Programmable Interval Timer)
+    // Frecvența de bază: 1193180 Hz. Divizor = 1193180 / Hz dorit.
+    uint32_t divisor = 1193180 / frequency;
+    outb(0x43, 0x36); // 0x36 = Channel 0, Access lo/hi byte, Mode 3 (Square Wave)
+    outb(0x40, (uint8_t)(divisor & 0xFF));        // Low byte
+    outb(0x40, (uint8_t)((divisor >> 8) & 0xFF)); // High byte
+}
+
 void timer_init(uint32_t frequency)
 {
     if (frequency == 0) return;
 
     tick_hz = frequency;
     ticks = 0;
+    base_ticks = 0;
+    base_ms = 0;
 
     irq_install_handler(0, timer_irq_handler);
+    pit_program(frequency);
+}
 
-    // Configurare Hardware PIT (Programmable Interval Timer)
-    // Frecvența de bază: 1193180 Hz. Divizor = 1193180 / Hz dorit.
-    uint32_t divisor = 1193180 / frequency;
-    outb(0x43, 0x36); // 0x36 = Channel 0, Access lo/hi byte, Mode 3 (Square Wave)
-    outb(0x40, (uint8_t)(divisor & 0xFF));        // Low byte
-    outb(0x40, (uint8_t)((divisor >> 8) & 0xFF)); // High byte
+void timer_set_frequency(uint32_t frequency)
+{
+    if (frequency == 0 || frequency == tick_hz) return;
+
+    /* Uptime so far is fixed at the old rate; counting resumes at the new one */
+    base_ms = timer_uptime_ms();
+    base_ticks = timer_ticks();
+    tick_hz = frequency;
+    pit_program(frequency);
 }
 
+uint32_t timer_frequency(void)
+{
+    return tick_hz;
+}
 
 uint64_t timer_ticks(void)
 {
@@ -46,14 +71,15 @@ uint64_t timer_ticks(void)
 
 uint32_t timer_uptime_seconds(void)
 {
-    if (tick_hz == 0) return 0;
-    return (uint32_t)ticks / tick_hz;
+    return timer_uptime_ms() / 1000;
 }
 
 uint32_t timer_uptime_ms(void)
 {
     if (tick_hz == 0) return 0;
-    return ((uint32_t)ticks * 1000) / tick_hz;
+    uint32_t since = (uint32_t)(ticks - base_ticks);
+    /* Whole seconds first so the product cannot overflow */
+    return base_ms + (since / tick_hz) * 1000 + ((since % tick_hz) * 1000) / tick_hz;
 }
 void sleep(uint32_t ms)
 {
@@ -7,6 +7,10 @@ extern "C" {
 
 void timer_init(uint32_t frequency);
 
+/* Reprogram the tick rate at runtime; uptime stays continuous */
+void timer_set_frequency(uint32_t frequency);
+uint32_t timer_frequency(void);
+
 /* raw tick counter */
 uint64_t timer_ticks(void);
 
@@ -5,8 +5,8 @@
 extern "C" {
 #endif
 
-/* Încarcă un fișier BMP de la calea specificată și îl desenează pe suprafață.
-   Returnează 0 la succes, -1 la eroare. */
+/* Încarcă un fișier BMP (sau PNG) de la calea specificată și îl desenează pe suprafață.
+   Trece prin cache-ul din image/image.h. Returnează 0 la succes, -1 la eroare. */
 int fly_load_bmp_to_surface(surface_t* surf, const char* path);
 
 #ifdef __cplusplus
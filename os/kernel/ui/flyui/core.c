@@ -1,5 +1,7 @@
 #include "flyui.h"
+#include "draw.h"
 #include "../../mem/kmalloc.h"
+#include "../../string.h"
 #include <stddef.h>
 
 extern void serial(const char *fmt, ...);
@@ -9,6 +11,7 @@ flyui_context_t* flyui_init(surface_t* surface) {
     flyui_context_t* ctx = (flyui_context_t*)kmalloc(sizeof(flyui_context_t));
     if (!ctx) return NULL;
     
+    memset(ctx, 0, sizeof(*ctx));
     ctx->surface = surface;
     ctx->root = NULL;
     
@@ -17,73 +20,160 @@ flyui_context_t* flyui_init(surface_t* surface) {
 }
 
 void flyui_set_root(flyui_context_t* ctx, fly_widget_t* root) {
-    if (ctx) ctx->root = root;
+    if (!ctx) return;
+    ctx->root = root;
+    fly_widget_invalidate(root);
 }
 
-static void render_widget_recursive(fly_widget_t* w, surface_t* surf, int x_off, int y_off) {
-    if (!w) return;
-    
-    /* Calculate absolute position */
-    int abs_x = x_off + w->x;
-    int abs_y = y_off + w->y;
-    
-    /* Draw self */
-    if (w->on_draw) {
-        w->on_draw(w, surf, abs_x, abs_y);
+/* --- Layout: absolute bounds, visible rects and paint order --- */
+
+/* Widgets only carry positions relative to their parent and code moves
+   them by assigning x/y directly, so every pass re-derives the absolute
+   rects (one cheap walk) and compares them with what was last painted. */
+
+static bool order_reserve(flyui_context_t* ctx, int n) {
+    if (n < ctx->cap) return true;
+    int cap = ctx->cap ? ctx->cap * 2 : 32;
+    fly_widget_t** order = (fly_widget_t**)kmalloc(cap * sizeof(fly_widget_t*));
+    if (!order) return false;
+    if (ctx->order) {
+        memcpy(order, ctx->order, ctx->cap * sizeof(fly_widget_t*));
+        kfree(ctx->order);
     }
-    
-    /* Draw children (reverse order if prepended? No, just iterate) */
-    /* Note: If we prepend children, first_child is top-most logically but drawn first? 
-       We'll assume standard iteration for now. */
-    fly_widget_t* c = w->first_child;
-    while (c) {
-        render_widget_recursive(c, surf, abs_x, abs_y);
-        c = c->next_sibling;
+    ctx->order = order;
+    ctx->cap = cap;
+    return true;
+}
+
+static void sync_widget(flyui_context_t* ctx, fly_widget_t* w, const rect_t* parent_bounds,
+                        const rect_t* parent_vis, int* n, bool* changed) {
+    if (!order_reserve(ctx, *n)) return;
+
+    rect_t bounds = { parent_bounds->x + w->x, parent_bounds->y + w->y, w->w, w->h };
+    rect_t vis;
+    if (!rect_intersect(&bounds, parent_vis, &vis)) vis.w = vis.h = 0;
+
+    if (!rect_equal(&bounds, &w->bounds) || !rect_equal(&vis, &w->vis)) {
+        /* Uncover where it was, paint where it is */
+        if (!rect_empty(&w->vis)) region_add_rect(&ctx->pending, &w->vis);
+        if (!rect_empty(&vis)) region_add_rect(&ctx->pending, &vis);
+        w->bounds = bounds;
+        w->vis = vis;
+        *changed = true;
+    }
+    if (*n >= ctx->count || ctx->order[*n] != w) {
+        ctx->order[*n] = w;
+        *changed = true;
+    }
+    (*n)++;
+
+    for (fly_widget_t* c = w->first_child; c; c = c->next_sibling) {
+        sync_widget(ctx, c, &w->bounds, &w->vis, n, changed);
     }
 }
 
-void flyui_render(flyui_context_t* ctx) {
-    if (!ctx || !ctx->surface) return;
-    
+static void grid_build(flyui_context_t* ctx) {
+    surface_t* s = ctx->surface;
+    ctx->cell_w = ((int)s->width + FLY_GRID - 1) / FLY_GRID;
+    ctx->cell_h = ((int)s->height + FLY_GRID - 1) / FLY_GRID;
+    if (ctx->cell_w < 1) ctx->cell_w = 1;
+    if (ctx->cell_h < 1) ctx->cell_h = 1;
+    memset(ctx->cells, 0, sizeof(ctx->cells));
+
+    int n = ctx->count < FLY_GRID_BITS ? ctx->count : FLY_GRID_BITS;
+    for (int i = 0; i < n; i++) {
+        const rect_t* v = &ctx->order[i]->vis;
+        if (rect_empty(v)) continue;
+        int cx0 = v->x / ctx->cell_w, cx1 = (v->x + v->w - 1) / ctx->cell_w;
+        int cy0 = v->y / ctx->cell_h, cy1 = (v->y + v->h - 1) / ctx->cell_h;
+        for (int cy = cy0; cy <= cy1; cy++) {
+            for (int cx = cx0; cx <= cx1; cx++) {
+                ctx->cells[cy * FLY_GRID + cx] |= 1ULL << i;
+            }
+        }
+    }
+}
+
+static void sync_layout(flyui_context_t* ctx) {
+    int n = 0;
+    bool changed = false;
     if (ctx->root) {
-        render_widget_recursive(ctx->root, ctx->surface, 0, 0);
+        rect_t origin = { 0, 0, 0, 0 };
+        rect_t screen = { 0, 0, (int32_t)ctx->surface->width, (int32_t)ctx->surface->height };
+        sync_widget(ctx, ctx->root, &origin, &screen, &n, &changed);
     }
+    if (n != ctx->count) changed = true;
+    ctx->count = n;
+    if (changed) grid_build(ctx);
 }
 
-/* Hit test recursive */
-static fly_widget_t* hit_test(fly_widget_t* w, int mx, int my, int x_off, int y_off) {
-    if (!w) return NULL;
+/* --- Rendering --- */
 
-    int abs_x = x_off + w->x;
-    int abs_y = y_off + w->y;
+bool flyui_render(flyui_context_t* ctx) {
+    if (!ctx || !ctx->surface) return false;
     
-    /* Check if point is inside this widget */
-    if (mx >= abs_x && mx < abs_x + w->w &&
-        my >= abs_y && my < abs_y + w->h) {
-        
-        /* Check children first (top-most in Z-order) */
-        fly_widget_t* hit = NULL;
-        fly_widget_t* c = w->first_child;
-        while (c) {
-            fly_widget_t* res = hit_test(c, mx, my, abs_x, abs_y);
-            /* Later children are drawn on top, so they take precedence */
-            if (res) hit = res; 
-            c = c->next_sibling;
+    sync_layout(ctx);
+
+    /* Invalidated widgets join the layout damage; every flag is consumed */
+    region_t damage = ctx->pending;
+    region_clear(&ctx->pending);
+    for (int i = 0; i < ctx->count; i++) {
+        fly_widget_t* w = ctx->order[i];
+        if ((w->flags & FLY_DIRTY) && !rect_empty(&w->vis)) region_add_rect(&damage, &w->vis);
+        w->flags = 0;
+    }
+    if (damage.count == 0) return false;
+
+    /* Paint order is parents first, so each damaged rect is rebuilt bottom
+       up by whatever widgets overlap it, each confined to the overlap */
+    for (int r = 0; r < damage.count; r++) {
+        const rect_t* d = &damage.rects[r];
+        for (int i = 0; i < ctx->count; i++) {
+            fly_widget_t* w = ctx->order[i];
+            rect_t clip;
+            if (!w->on_draw || !rect_intersect(&w->vis, d, &clip)) continue;
+            fly_draw_set_clip(&clip);
+            w->on_draw(w, ctx->surface, w->bounds.x, w->bounds.y);
         }
-        
-        if (hit) return hit;
-        return w; /* No child hit, so it's us */
+        surface_damage(ctx->surface, d->x, d->y, d->w, d->h);
+    }
+    fly_draw_set_clip(NULL);
+    return true;
+}
+
+/* --- Hit testing --- */
+
+static bool vis_contains(const fly_widget_t* w, int x, int y) {
+    const rect_t* v = &w->vis;
+    return x >= v->x && x < v->x + v->w && y >= v->y && y < v->y + v->h;
+}
+
+/* Top-most widget under (mx, my): the last one in paint order whose
+   visible rect holds the point, i.e. the deepest, latest-added child */
+static fly_widget_t* hit_test(flyui_context_t* ctx, int mx, int my) {
+    if (mx < 0 || my < 0 || mx >= (int)ctx->surface->width || my >= (int)ctx->surface->height) return NULL;
+
+    /* Widgets past the grid's reach are above every indexed one */
+    for (int i = ctx->count - 1; i >= FLY_GRID_BITS; i--) {
+        if (vis_contains(ctx->order[i], mx, my)) return ctx->order[i];
+    }
+
+    uint64_t bits = ctx->cells[(my / ctx->cell_h) * FLY_GRID + (mx / ctx->cell_w)];
+    while (bits) {
+        int i = 63 - __builtin_clzll(bits);
+        if (vis_contains(ctx->order[i], mx, my)) return ctx->order[i];
+        bits &= ~(1ULL << i);
     }
-    
     return NULL;
 }
 
 void flyui_dispatch_event(flyui_context_t* ctx, fly_event_t* event) {
-    if (!ctx || !ctx->root) return;
+    if (!ctx || !ctx->root || !ctx->surface) return;
     
-    /* Simple dispatch: hit test for mouse events */
-    /* For now, we just dispatch to the target found by hit test */
-    fly_widget_t* target = hit_test(ctx->root, event->mx, event->my, 0, 0);
+    /* The index must reflect any layout changes since the last render */
+    sync_layout(ctx);
+
+    fly_widget_t* target = hit_test(ctx, event->mx, event->my);
     if (target && target->on_event) {
         target->on_event(target, event);
     }
@@ -1,28 +1,45 @@
 #include "draw.h"
 #include "../../video/surface.h"
-#include "../../video/font8x16.h"
+#include "../../video/glyph.h"
+#include "../../string.h"
 
-static void put_pixel(surface_t* surf, int x, int y, uint32_t color) {
-    if (x < 0 || y < 0 || x >= (int)surf->width || y >= (int)surf->height) return;
-    surf->pixels[y * surf->width + x] = color;
+static rect_t draw_clip;
+static bool draw_clipped = false;
+
+void fly_draw_set_clip(const rect_t* clip) {
+    draw_clipped = clip != 0;
+    if (clip) draw_clip = *clip;
+}
+
+/* Drawable area of surf: the whole surface, cut down to the clip if set */
+static bool draw_bounds(const surface_t* surf, rect_t* out) {
+    rect_t all = { 0, 0, (int32_t)surf->width, (int32_t)surf->height };
+    if (!draw_clipped) {
+        *out = all;
+        return !rect_empty(out);
+    }
+    return rect_intersect(&all, &draw_clip, out);
+}
+
+bool fly_draw_visible(const surface_t* surf, int x, int y) {
+    rect_t b;
+    if (!surf || !draw_bounds(surf, &b)) return false;
+    return x >= b.x && x < b.x + b.w && y >= b.y && y < b.y + b.h;
 }
 
 void fly_draw_rect_fill(surface_t* surf, int x, int y, int w, int h, uint32_t color) {
     if (!surf) return;
     
     /* Clip */
-    if (x < 0) { w += x; x = 0; }
-    if (y < 0) { h += y; y = 0; }
-    if (x + w > (int)surf->width) w = (int)surf->width - x;
-    if (y + h > (int)surf->height) h = (int)surf->height - y;
-    
-    if (w <= 0 || h <= 0) return;
+    rect_t b, r = { x, y, w, h };
+    if (!draw_bounds(surf, &b) || !rect_intersect(&r, &b, &r)) return;
+    x = r.x; y = r.y; w = r.w; h = r.h;
 
-    for (int j = 0; j < h; j++) {
-        for (int i = 0; i < w; i++) {
-            surf->pixels[(y + j) * surf->width + (x + i)] = color;
-        }
+    uint32_t* row = surf->pixels + y * surf->width + x;
+    for (int j = 0; j < h; j++, row += surf->width) {
+        memset32(row, color, w);
     }
+    surface_damage(surf, x, y, w, h);
 }
 
 void fly_draw_rect_outline(surface_t* surf, int x, int y, int w, int h, uint32_t color) {
@@ -34,23 +51,20 @@ void fly_draw_rect_outline(surface_t* surf, int x, int y, int w, int h, uint32_t
     fly_draw_rect_fill(surf, x + w - 1, y, 1, h, color);
 }
 
-static void draw_char(surface_t* surf, int x, int y, char c, uint32_t color) {
-    const uint8_t* glyph = &font8x16[(uint8_t)c * 16];
-    for (int i = 0; i < 16; i++) {
-        for (int j = 0; j < 8; j++) {
-            if (glyph[i] & (1 << (7-j))) {
-                put_pixel(surf, x + j, y + i, color);
-            }
-        }
-    }
-}
-
 void fly_draw_text(surface_t* surf, int x, int y, const char* text, uint32_t color) {
-    if (!text) return;
+    if (!surf || !text) return;
+    rect_t b;
+    if (!draw_bounds(surf, &b)) return;
+
+    /* Glyphs clip to the buffer they are given: hand them the drawable area */
+    uint32_t* buf = surf->pixels + b.y * surf->width + b.x;
     int cx = x;
     while (*text) {
-        draw_char(surf, cx, y, *text, color);
+        glyph_draw_mask(buf, surf->width, b.w, b.h, cx - b.x, y - b.y, (uint8_t)*text, color);
         cx += 8;
         text++;
     }
+
+    rect_t r = { x, y, cx - x, 16 };
+    if (rect_intersect(&r, &b, &r)) surface_damage(surf, r.x, r.y, r.w, r.h);
 }
\ No newline at end of file
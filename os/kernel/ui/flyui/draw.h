@@ -9,6 +9,13 @@ void fly_draw_rect_fill(surface_t* surf, int x, int y, int w, int h, uint32_t co
 void fly_draw_rect_outline(surface_t* surf, int x, int y, int w, int h, uint32_t color);
 void fly_draw_text(surface_t* surf, int x, int y, const char* text, uint32_t color);
 
+/* Restrict the primitives above to a rect (surface coordinates), or lift
+   the restriction with NULL. flyui_render sets it around each widget's
+   on_draw so a repaint stays inside the invalidated area; widgets that
+   write pixels themselves should test fly_draw_visible(). */
+void fly_draw_set_clip(const rect_t* clip);
+bool fly_draw_visible(const surface_t* surf, int x, int y);
+
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
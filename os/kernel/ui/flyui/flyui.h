@@ -31,9 +31,13 @@ struct fly_widget;
 typedef void (*fly_draw_func_t)(struct fly_widget* w, surface_t* surf, int x, int y);
 typedef bool (*fly_event_func_t)(struct fly_widget* w, fly_event_t* e);
 
+/* Widget flags */
+#define FLY_DIRTY       0x01   /* Own area needs repainting */
+#define FLY_CHILD_DIRTY 0x02   /* Some descendant is dirty */
+
 /* Widget Structure */
 typedef struct fly_widget {
-    int x, y, w, h;
+    int x, y, w, h;    /* Relative to the parent */
     uint32_t bg_color;
     uint32_t fg_color;
     
@@ -45,22 +49,48 @@ typedef struct fly_widget {
     
     fly_draw_func_t on_draw;
     fly_event_func_t on_event;
+
+    /* Retained state, kept by flyui_render */
+    uint8_t flags;     /* FLY_* */
+    rect_t bounds;     /* On the surface */
+    rect_t vis;        /* bounds clipped by the ancestors: what is drawn and hit */
 } fly_widget_t;
 
+/* Hit-test grid: the surface is split into FLY_GRID x FLY_GRID cells, each
+   with a bit per widget (paint order) whose visible rect overlaps it */
+#define FLY_GRID      8
+#define FLY_GRID_BITS 64
+
 /* Context Structure */
 typedef struct {
     surface_t* surface;
     fly_widget_t* root;
+
+    fly_widget_t** order;   /* Every widget, in paint order (parents first) */
+    int count, cap;
+    uint64_t cells[FLY_GRID * FLY_GRID];
+    int cell_w, cell_h;
+    region_t pending;       /* Layout damage not yet repainted */
 } flyui_context_t;
 
 /* Core API */
 flyui_context_t* flyui_init(surface_t* surface);
 void flyui_set_root(flyui_context_t* ctx, fly_widget_t* root);
-void flyui_render(flyui_context_t* ctx);
+
+/* Repaint what changed since the last call: invalidated widgets and the
+   old and new areas of widgets that moved, resized or were added. Each
+   widget's on_draw is clipped (see fly_draw_set_clip) to the damage it
+   overlaps; everything repainted is reported with surface_damage. Returns
+   true if anything was painted, i.e. the WM has a frame to compose. */
+bool flyui_render(flyui_context_t* ctx);
 void flyui_dispatch_event(flyui_context_t* ctx, fly_event_t* event);
 fly_widget_t* fly_widget_create(void);
 void fly_widget_add(fly_widget_t* parent, fly_widget_t* child);
 
+/* Mark w for repainting (state or colours changed). Geometry changes are
+   picked up by flyui_render without this. */
+void fly_widget_invalidate(fly_widget_t* w);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
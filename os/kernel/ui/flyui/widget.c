@@ -16,6 +16,9 @@ fly_widget_t* fly_widget_create(void) {
     w->internal_data = NULL;
     w->on_draw = NULL;
     w->on_event = NULL;
+    w->flags = 0;
+    w->bounds.x = w->bounds.y = w->bounds.w = w->bounds.h = 0;
+    w->vis = w->bounds;
     
     return w;
 }
@@ -36,6 +39,16 @@ void fly_widget_add(fly_widget_t* parent, fly_widget_t* child) {
         }
         c->next_sibling = child;
     }
+    fly_widget_invalidate(child);
+}
+
+void fly_widget_invalidate(fly_widget_t* w) {
+    if (!w) return;
+    w->flags |= FLY_DIRTY;
+    /* Stop at the first ancestor already flagged: the rest of the path is too */
+    for (fly_widget_t* p = w->parent; p && !(p->flags & FLY_CHILD_DIRTY); p = p->parent) {
+        p->flags |= FLY_CHILD_DIRTY;
+    }
 }
 
 /* Note: Destruction would require recursive free, omitted for minimal implementation */
\ No newline at end of file
@@ -11,25 +11,6 @@ typedef struct {
     bool pressed;
 } button_data_t;
 
-static void fly_draw_line(surface_t* surf, int x0, int y0, int x1, int y1, uint32_t color) {
-    int dx = (x1 > x0) ? (x1 - x0) : (x0 - x1);
-    int sx = (x0 < x1) ? 1 : -1;
-    int dy = (y1 > y0) ? -(y1 - y0) : -(y0 - y1);
-    int sy = (y0 < y1) ? 1 : -1;
-    int err = dx + dy;
-    int e2;
-
-    for (;;) {
-        if (x0 >= 0 && x0 < (int)surf->width && y0 >= 0 && y0 < (int)surf->height) {
-            surf->pixels[y0 * surf->width + x0] = color;
-        }
-        if (x0 == x1 && y0 == y1) break;
-        e2 = 2 * err;
-        if (e2 >= dy) { err += dy; x0 += sx; }
-        if (e2 <= dx) { err += dx; y0 += sy; }
-    }
-}
-
 static void button_draw(fly_widget_t* w, surface_t* surf, int x, int y) {
     button_data_t* d = (button_data_t*)w->internal_data;
     uint32_t bg = w->bg_color;
@@ -57,17 +38,17 @@ static void button_draw(fly_widget_t* w, surface_t* surf, int x, int y) {
     
     /* Bevels */
     /* Top & Left (Highlight) */
-    fly_draw_line(surf, x+1, y+1, x+w->w-2, y+1, c_tl);
-    fly_draw_line(surf, x+1, y+1, x+1, y+w->h-2, c_tl);
+    fly_draw_rect_fill(surf, x+1, y+1, w->w-2, 1, c_tl);
+    fly_draw_rect_fill(surf, x+1, y+1, 1, w->h-2, c_tl);
     
     /* Bottom & Right (Shadow) */
-    fly_draw_line(surf, x+1, y+w->h-2, x+w->w-2, y+w->h-2, c_br);
-    fly_draw_line(surf, x+w->w-2, y+1, x+w->w-2, y+w->h-2, c_br);
+    fly_draw_rect_fill(surf, x+1, y+w->h-2, w->w-2, 1, c_br);
+    fly_draw_rect_fill(surf, x+w->w-2, y+1, 1, w->h-2, c_br);
     
     /* Inner Shadow (Bottom/Right only for classic feel) */
     if (!d || !d->pressed) {
-        fly_draw_line(surf, x+2, y+w->h-3, x+w->w-3, y+w->h-3, c_br_inner);
-        fly_draw_line(surf, x+w->w-3, y+2, x+w->w-3, y+w->h-3, c_br_inner);
+        fly_draw_rect_fill(surf, x+2, y+w->h-3, w->w-4, 1, c_br_inner);
+        fly_draw_rect_fill(surf, x+w->w-3, y+2, 1, w->h-4, c_br_inner);
     }
     
     /* Draw text centered */
@@ -85,10 +66,12 @@ static bool button_event(fly_widget_t* w, fly_event_t* e) {
 
     if (e->type == FLY_EVENT_MOUSE_DOWN) {
         d->pressed = true;
+        fly_widget_invalidate(w);
         serial("[FLYUI] button clicked: %s\n", d ? d->text : "???");
         return true;
     } else if (e->type == FLY_EVENT_MOUSE_UP) {
         d->pressed = false;
+        fly_widget_invalidate(w);
         return true;
     }
     return false;
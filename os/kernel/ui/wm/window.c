@@ -14,6 +14,10 @@ window_t* window_create(surface_t* surface, int x, int y) {
     win->z = 0;
     win->flags = 0;
     win->userdata = 0;
+    win->drawn.x = 0;
+    win->drawn.y = 0;
+    win->drawn.w = 0;
+    win->drawn.h = 0;
     win->next = 0;
     
     return win;
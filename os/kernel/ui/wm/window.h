@@ -16,6 +16,8 @@ typedef struct window {
 
     uint32_t flags;
     void* userdata;
+
+    rect_t drawn;   /* Screen area this window covered in the last frame */
     
     struct window* next;
 } window_t;
@@ -1,5 +1,7 @@
 #include "wm.h"
 #include "../../video/compositor.h"
+#include "../../video/framebuffer.h"
+#include "../../video/cursor.h"
 #include "../../mem/kmalloc.h"
 #include <stddef.h>
 #include "../../terminal.h"
@@ -14,6 +16,7 @@ static window_t* focused_window = NULL;
 static wm_layout_t* current_layout = &wm_layout_floating;
 static uint32_t next_win_id = 1;
 static bool wm_dirty = true;
+static region_t wm_damage;
 
 /* Array for layout processing */
 static window_t* win_array[MAX_WINDOWS];
@@ -24,7 +27,7 @@ void wm_init(void) {
     focused_window = NULL;
     current_layout = &wm_layout_floating;
     win_count = 0;
-    wm_dirty = true;
+    wm_damage_all();
     serial("[WM] Initialized\n");
 }
 
@@ -32,6 +35,18 @@ void wm_mark_dirty(void) {
     wm_dirty = true;
 }
 
+void wm_damage_rect(int x, int y, int w, int h) {
+    region_add(&wm_damage, x, y, w, h);
+    wm_dirty = true;
+}
+
+void wm_damage_all(void) {
+    uint32_t fb_w = 0, fb_h = 0;
+    fb_get_info(&fb_w, &fb_h, 0, 0, 0);
+    region_clear(&wm_damage);
+    wm_damage_rect(0, 0, (int)fb_w, (int)fb_h);
+}
+
 bool wm_is_dirty(void) {
     return wm_dirty;
 }
@@ -103,6 +118,7 @@ void wm_destroy_window(window_t* win) {
     }
 
     serial("[WM] Window destroyed id=%u\n", win->id);
+    region_add_rect(&wm_damage, &win->drawn);
     window_destroy(win);
     wm_dirty = true;
 }
@@ -131,7 +147,7 @@ void wm_set_layout(wm_layout_t* layout) {
         current_layout = layout;
         serial("[WM] Layout set to %s\n", layout->name);
     }
-    wm_dirty = true;
+    wm_damage_all();
 }
 
 window_t* wm_find_window_at(int x, int y) {
@@ -148,15 +164,42 @@ window_t* wm_find_window_at(int x, int y) {
     return NULL;
 }
 
-void wm_render(void) {
-    if (!wm_dirty && !terminal_is_dirty()) return;
+/* Fold a window's changes into the frame damage: its old and new area
+   (shadow included) when it moved, resized or changed visibility or
+   shadow, else its surface damage. */
+static void collect_damage(window_t* w) {
+    surface_t* s = w->surface;
+    rect_t now;
+    surface_footprint(s, w->x, w->y, &now);
+    if (!s->visible) now.w = now.h = 0;
+
+    if (!rect_equal(&now, &w->drawn)) {
+        region_add_rect(&wm_damage, &w->drawn);
+        region_add_rect(&wm_damage, &now);
+        w->drawn = now;
+    } else if (!rect_empty(&s->damage)) {
+        region_add(&wm_damage, w->x + s->damage.x, w->y + s->damage.y,
+                   s->damage.w, s->damage.h);
+    }
+    s->damage.w = s->damage.h = 0;
+}
+
+bool wm_render(void) {
+    if (!wm_dirty && !terminal_is_dirty() && !cursor_pending()) return false;
 
     /* 1. Apply Layout */
     if (current_layout && current_layout->apply) {
         current_layout->apply(win_array, win_count);
     }
 
-    /* 2. Prepare Surface List for Compositor (Bottom to Top) */
+    /* 2. Hooks (may draw into surfaces, so before damage is collected) */
+    wm_hooks_t* hooks = wm_get_hooks();
+    if (hooks && hooks->on_frame) {
+        hooks->on_frame();
+    }
+    terminal_flush();
+
+    /* 3. Prepare Surface List for Compositor (Bottom to Top) */
     surface_t* render_list[MAX_WINDOWS];
     int render_count = 0;
 
@@ -166,20 +209,22 @@ void wm_render(void) {
         if (w->surface) {
             w->surface->x = w->x;
             w->surface->y = w->y;
+            collect_damage(w);
             render_list[render_count++] = w->surface;
         }
     }
 
-    /* 3. Hooks */
-    wm_hooks_t* hooks = wm_get_hooks();
-    if (hooks && hooks->on_frame) {
-        hooks->on_frame();
+    /* Pointer: its old and new areas, nothing more */
+    cursor_collect_damage(&wm_damage);
+
+    /* 4. Render only what changed */
+    bool drawn = wm_damage.count != 0;
+    if (drawn) {
+        compositor_render_damage(render_list, render_count, &wm_damage);
+        region_clear(&wm_damage);
     }
 
-    /* 4. Render */
-    serial("[WM] Rendering\n");
-    compositor_render_surfaces(render_list, render_count);
-    
     wm_dirty = false;
     terminal_clear_dirty();
-}
\ No newline at end of file
+    return drawn;
+}
@@ -2,6 +2,7 @@
 #include "window.h"
 #include "wm_layout.h"
 #include "wm_hooks.h"
+#include "wm_frame.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,15 +15,24 @@ void wm_destroy_window(window_t* win);
 void wm_focus_window(window_t* win);
 window_t* wm_get_focused(void);
 
-void wm_render(void);
+/* Compose the frame if anything changed; true if something was drawn */
+bool wm_render(void);
 void wm_set_layout(wm_layout_t* layout);
 
 /* Hit test: Find window at global coordinates */
 window_t* wm_find_window_at(int x, int y);
 
+/* Request a frame. Only damaged areas are recomposed: surface damage
+   (see surface_damage), windows that moved/appeared/disappeared, the
+   software cursor's old and new areas, and anything passed to
+   wm_damage_rect/wm_damage_all. */
 void wm_mark_dirty(void);
 bool wm_is_dirty(void);
 
+/* Force a screen area (or the whole screen) to be recomposed */
+void wm_damage_rect(int x, int y, int w, int h);
+void wm_damage_all(void);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
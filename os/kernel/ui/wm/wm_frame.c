@@ -0,0 +1,131 @@
+#include "wm_frame.h"
+#include "../../hardware/hpet.h"
+#include "../../time/timer.h"
+#include "../../string.h"
+
+extern void serial(const char *fmt, ...);
+
+static bool pacing = false;
+static uint32_t target_hz = WM_FRAME_HZ;
+static uint32_t period_us = 1000000 / WM_FRAME_HZ;
+static uint32_t saved_timer_hz = 0;
+static void (*idle_hook)(void) = 0;
+
+static uint32_t next_due;      /* Start of the next slot */
+static uint32_t frame_start;   /* Start of the current frame (us) */
+static uint32_t frame_ms = 0;  /* Frame clock, kept free of the us wrap */
+static uint32_t frame_rem_us = 0;
+
+static uint32_t history[WM_FRAME_HISTORY];
+static uint32_t frames = 0;
+static uint32_t dropped = 0;
+
+/* Busy share, measured over one-second windows */
+static uint32_t window_start;
+static uint32_t window_idle;
+static uint32_t busy_pct = 0;
+
+/* Microseconds, wrapping at 32 bits: only differences are used */
+static uint32_t now_us(void) {
+    if (hpet_is_active()) return (uint32_t)hpet_time_us();
+    return timer_uptime_ms() * 1000;
+}
+
+void wm_frame_start(uint32_t hz) {
+    if (hz == 0) hz = WM_FRAME_HZ;
+    target_hz = hz;
+    period_us = 1000000 / hz;
+
+    if (!pacing) {
+        saved_timer_hz = timer_frequency();
+        if (saved_timer_hz < WM_FRAME_TIMER_HZ) timer_set_frequency(WM_FRAME_TIMER_HZ);
+        pacing = true;
+    }
+
+    frames = 0;
+    dropped = 0;
+    busy_pct = 0;
+    next_due = frame_start = window_start = now_us();
+    window_idle = 0;
+    serial("[WM] Frame pacing at %u Hz (%s clock)\n", hz, hpet_is_active() ? "HPET" : "PIT");
+}
+
+void wm_frame_stop(void) {
+    if (!pacing) return;
+    timer_set_frequency(saved_timer_hz);
+    pacing = false;
+    serial("[WM] Frame pacing off: %u frames, %u dropped\n", frames, dropped);
+}
+
+void wm_frame_set_idle_hook(void (*hook)(void)) {
+    idle_hook = hook;
+}
+
+uint32_t wm_frame_begin(void) {
+    uint32_t now = now_us();
+    uint32_t late = now - next_due;
+    if ((int32_t)late >= (int32_t)period_us) {
+        /* The last frame overran: the slots it covered are gone, and the
+           cadence restarts from here rather than rushing to catch up */
+        dropped += late / period_us;
+        next_due = now;
+    }
+
+    while ((int32_t)(now - next_due) < 0) {
+        if (idle_hook) idle_hook();
+        uint32_t t0 = now_us();
+        if ((int32_t)(t0 - next_due) >= 0) break;
+        asm volatile("hlt");
+        now = now_us();
+        window_idle += now - t0;
+    }
+
+    frame_rem_us += now - frame_start;
+    frame_ms += frame_rem_us / 1000;
+    frame_rem_us %= 1000;
+    frame_start = now;
+    next_due += period_us;
+
+    uint32_t span = now - window_start;
+    if (span >= 1000000) {
+        busy_pct = window_idle >= span ? 0 : 100 - (window_idle / (span / 100));
+        window_start = now;
+        window_idle = 0;
+    }
+    return frame_ms;
+}
+
+void wm_frame_end(bool presented) {
+    if (!presented) return;
+    history[frames % WM_FRAME_HISTORY] = now_us() - frame_start;
+    frames++;
+}
+
+uint32_t wm_frame_time_ms(void) {
+    return frame_ms;
+}
+
+void wm_frame_get_stats(wm_frame_stats_t* out) {
+    memset(out, 0, sizeof(*out));
+    out->target_hz = target_hz;
+    out->frames = frames;
+    out->dropped = dropped;
+    out->busy_pct = busy_pct;
+
+    uint32_t n = frames < WM_FRAME_HISTORY ? frames : WM_FRAME_HISTORY;
+    if (n == 0) return;
+
+    /* Sorted copy: min and p99 fall out of it (small, and only read on demand) */
+    uint32_t sorted[WM_FRAME_HISTORY];
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t v = history[i];
+        sum += v;
+        uint32_t j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+    out->min_us = sorted[0];
+    out->avg_us = sum / n;
+    out->p99_us = sorted[(n * 99) / 100];
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frame pacing for the GUI loop.
+ *
+ * The loop runs once per frame slot at a fixed target rate: wait for the
+ * slot (halting the CPU until it is due), take every input event queued
+ * since the last frame, update, compose once. The slots come from the
+ * high-resolution clock (HPET, else the PIT); the PIT is sped up while
+ * pacing is on so the halt wakes close to each deadline. There is no
+ * vblank interrupt to lock to, so this is timer-paced rather than true
+ * vsync.
+ */
+
+#define WM_FRAME_HZ        60     /* Default target rate */
+#define WM_FRAME_TIMER_HZ  1000   /* PIT rate while pacing */
+#define WM_FRAME_HISTORY   128    /* Frames kept for the statistics */
+
+typedef struct {
+    uint32_t target_hz;
+    uint32_t frames;     /* Frames that composed something */
+    uint32_t dropped;    /* Slots lost to frames that overran */
+    /* Time to produce a frame (update + compose), over the last
+       WM_FRAME_HISTORY composed frames, in microseconds */
+    uint32_t min_us, avg_us, p99_us;
+    uint32_t busy_pct;   /* Share of the last second not spent halted */
+} wm_frame_stats_t;
+
+void wm_frame_start(uint32_t hz);
+void wm_frame_stop(void);
+
+/* Called while waiting for a slot (e.g. to service the network) */
+void wm_frame_set_idle_hook(void (*hook)(void));
+
+/* Halt until the next frame is due. Returns its timestamp in ms. */
+uint32_t wm_frame_begin(void);
+/* Close the frame; presented tells whether anything was composed */
+void wm_frame_end(bool presented);
+
+/* Timestamp of the current frame in ms: the same for everything updated
+   in one frame, so animations advance by real time, not by call count */
+uint32_t wm_frame_time_ms(void);
+
+void wm_frame_get_stats(wm_frame_stats_t* out);
+
+#ifdef __cplusplus
+}
+#endif
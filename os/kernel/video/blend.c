@@ -0,0 +1,155 @@
+/* kernel/video/blend.c */
+#include "blend.h"
+#include "../string.h"
+#include "../hardware/sse.h"
+
+static int blend_use_sse2 = -1;   /* -1: not probed yet */
+
+static void blend_probe(void) {
+    if (blend_use_sse2 >= 0) return;
+    blend_use_sse2 = cpu_has_sse2();
+    if (blend_use_sse2) sse_enable();
+}
+
+const char* blend_impl_name(void) {
+    blend_probe();
+    return blend_use_sse2 ? "sse2" : "scalar";
+}
+
+/* x * k / 255 for k in 0..255, as (x * k16) >> 8 */
+static inline uint32_t k16(uint32_t k) {
+    return k + (k >> 7);
+}
+
+/* --- Scalar (also the tail of the SSE2 kernels) --- */
+
+static void blend_span_scalar(uint32_t* dst, const uint32_t* src, uint32_t n,
+                              uint32_t op, uint32_t or_alpha) {
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t s = src[i] | or_alpha, d = dst[i];
+        uint32_t sa = ((s >> 24) * op) >> 8;
+        uint32_t k = k16(255 - sa);
+        uint32_t out = 0;
+        for (int sh = 0; sh < 32; sh += 8) {
+            uint32_t c = ((((s >> sh) & 0xFF) * op) >> 8) + ((((d >> sh) & 0xFF) * k) >> 8);
+            out |= (c > 255 ? 255 : c) << sh;
+        }
+        dst[i] = out;
+    }
+}
+
+static void blend_dim_scalar(uint32_t* dst, uint32_t n, uint32_t k) {
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t d = dst[i];
+        uint32_t rb = ((d & 0x00FF00FF) * k >> 8) & 0x00FF00FF;
+        uint32_t ag = ((d >> 8) & 0x00FF00FF) * k & 0xFF00FF00;
+        dst[i] = rb | ag;
+    }
+}
+
+/* --- SSE2: four pixels per iteration, channels widened to 16 bits --- */
+
+typedef unsigned short v8hu __attribute__((vector_size(16)));
+typedef short          v8hi __attribute__((vector_size(16)));
+typedef int            v4si __attribute__((vector_size(16)));
+typedef char           v16qi __attribute__((vector_size(16)));
+
+/* Each pixel's alpha word copied to its four channel words */
+__attribute__((target("sse2")))
+static inline v8hu alpha_words(v8hu v) {
+    return (v8hu)__builtin_ia32_pshufhw(__builtin_ia32_pshuflw((v8hi)v, 0xFF), 0xFF);
+}
+
+__attribute__((target("sse2")))
+static void blend_span_sse2(uint32_t* dst, const uint32_t* src, uint32_t n,
+                            uint32_t op, uint32_t or_alpha) {
+    const v16qi zero = { 0 };
+    const v4si amask = { (int)0xFF000000, (int)0xFF000000, (int)0xFF000000, (int)0xFF000000 };
+    const v4si or_a = { (int)or_alpha, (int)or_alpha, (int)or_alpha, (int)or_alpha };
+    const v8hu vop = { op, op, op, op, op, op, op, op };
+    const v8hu v255 = { 255, 255, 255, 255, 255, 255, 255, 255 };
+
+    for (; n >= 4; n -= 4, src += 4, dst += 4) {
+        v4si s = (v4si)__builtin_ia32_loaddqu((const char*)src) | or_a;
+
+        if (op == 256) {
+            /* Opaque fast path: all four opaque is a copy, all four clear is a no-op */
+            int opaque = __builtin_ia32_pmovmskb128((v16qi)__builtin_ia32_pcmpeqd128(s & amask, amask));
+            if (opaque == 0xFFFF) {
+                __builtin_ia32_storedqu((char*)dst, (v16qi)s);
+                continue;
+            }
+            int clear = __builtin_ia32_pmovmskb128((v16qi)__builtin_ia32_pcmpeqd128(s & amask, (v4si)zero));
+            if (clear == 0xFFFF) continue;
+        }
+
+        v16qi d = __builtin_ia32_loaddqu((const char*)dst);
+        v8hu slo = (v8hu)__builtin_ia32_punpcklbw128((v16qi)s, zero);
+        v8hu shi = (v8hu)__builtin_ia32_punpckhbw128((v16qi)s, zero);
+        v8hu dlo = (v8hu)__builtin_ia32_punpcklbw128(d, zero);
+        v8hu dhi = (v8hu)__builtin_ia32_punpckhbw128(d, zero);
+
+        slo = (slo * vop) >> 8;
+        shi = (shi * vop) >> 8;
+
+        v8hu klo = v255 - alpha_words(slo);
+        v8hu khi = v255 - alpha_words(shi);
+        klo += klo >> 7;
+        khi += khi >> 7;
+
+        dlo = slo + ((dlo * klo) >> 8);
+        dhi = shi + ((dhi * khi) >> 8);
+        __builtin_ia32_storedqu((char*)dst, __builtin_ia32_packuswb128((v8hi)dlo, (v8hi)dhi));
+    }
+    blend_span_scalar(dst, src, n, op, or_alpha);
+}
+
+__attribute__((target("sse2")))
+static void blend_dim_sse2(uint32_t* dst, uint32_t n, uint32_t k) {
+    const v16qi zero = { 0 };
+    const v8hu vk = { k, k, k, k, k, k, k, k };
+
+    for (; n >= 4; n -= 4, dst += 4) {
+        v16qi d = __builtin_ia32_loaddqu((const char*)dst);
+        v8hu lo = (v8hu)__builtin_ia32_punpcklbw128(d, zero);
+        v8hu hi = (v8hu)__builtin_ia32_punpckhbw128(d, zero);
+        lo = (lo * vk) >> 8;
+        hi = (hi * vk) >> 8;
+        __builtin_ia32_storedqu((char*)dst, __builtin_ia32_packuswb128((v8hi)lo, (v8hi)hi));
+    }
+    blend_dim_scalar(dst, n, k);
+}
+
+void blend_span(uint32_t* dst, const uint32_t* src, uint32_t n, uint8_t opacity, bool src_alpha) {
+    if (!n || opacity == 0) return;
+    if (opacity == 255 && !src_alpha) {
+        memcpy(dst, src, (size_t)n * 4);
+        return;
+    }
+
+    blend_probe();
+    uint32_t op = k16(opacity);
+    uint32_t or_alpha = src_alpha ? 0 : 0xFF000000;
+    if (blend_use_sse2) blend_span_sse2(dst, src, n, op, or_alpha);
+    else blend_span_scalar(dst, src, n, op, or_alpha);
+}
+
+void blend_dim(uint32_t* dst, uint32_t n, uint8_t a) {
+    if (!n || a == 0) return;
+
+    blend_probe();
+    uint32_t k = k16(255 - a);
+    if (blend_use_sse2) blend_dim_sse2(dst, n, k);
+    else blend_dim_scalar(dst, n, k);
+}
+
+void blend_premultiply(uint32_t* px, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t p = px[i], a = p >> 24;
+        if (a == 0xFF) continue;
+        uint32_t r = (((p >> 16) & 0xFF) * a + 127) / 255;
+        uint32_t g = (((p >> 8) & 0xFF) * a + 127) / 255;
+        uint32_t b = ((p & 0xFF) * a + 127) / 255;
+        px[i] = (a << 24) | (r << 16) | (g << 8) | b;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Alpha blending of ARGB32 spans.
+ *
+ * Pixels with alpha are premultiplied (each colour channel already scaled
+ * by alpha), so "src over dst" is src + dst * (1 - src.a) on every
+ * channel, alpha included. Division by 255 is approximated as
+ * (x * (k + (k >> 7))) >> 8, identically in the scalar and SSE2 kernels.
+ */
+
+/* Premultiplied src over dst */
+static inline uint32_t blend_pixel(uint32_t s, uint32_t d) {
+    uint32_t a = s >> 24;
+    if (a == 0xFF) return s;
+    if (a == 0) return d;
+    uint32_t k = 255 - a;
+    k += k >> 7;    /* 0..256 */
+    uint32_t rb = ((d & 0x00FF00FF) * k >> 8) & 0x00FF00FF;
+    uint32_t ag = ((d >> 8) & 0x00FF00FF) * k & 0xFF00FF00;
+    return s + (rb | ag);
+}
+
+/* dst = src scaled by opacity, over dst. Without src_alpha the source is
+   taken as opaque whatever its alpha byte says (plain surfaces), and at
+   full opacity that is a plain copy. */
+void blend_span(uint32_t* dst, const uint32_t* src, uint32_t n, uint8_t opacity, bool src_alpha);
+
+/* Darken dst as if covered by black at alpha a (shadows) */
+void blend_dim(uint32_t* dst, uint32_t n, uint8_t a);
+
+/* Straight alpha to premultiplied, in place */
+void blend_premultiply(uint32_t* px, uint32_t n);
+
+const char* blend_impl_name(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,87 +3,181 @@
 #include "../mem/kmalloc.h"
 #include "../string.h"
 #include "gpu.h"
-#include "../drivers/mouse.h"
+#include "blend.h"
+#include "cursor.h"
 
 /* Import serial logging */
 extern void serial(const char *fmt, ...);
 
 void compositor_init(void) {
-    serial("[COMPOSITOR] Initialized.\n");
+    serial("[COMPOSITOR] Initialized (blend: %s).\n", blend_impl_name());
 }
 
-void compositor_render_surfaces(surface_t** surfaces, int count) {
-    uint32_t fb_w = 0, fb_h = 0, fb_pitch = 0;
-    fb_get_info(&fb_w, &fb_h, &fb_pitch, 0, 0);
+/* Background color: Windows 1.0 Teal */
+#define COMPOSITOR_BG 0xFF008080
+#define COMPOSITOR_MAX_SURFACES 32
 
-    if (fb_w == 0 || fb_h == 0) {
-        return;
+/* Span buffer, reused across frames */
+static uint32_t* span_buf = 0;
+static uint32_t span_cap = 0;
+
+static const surface_t* wallpaper = 0;
+static int32_t wallpaper_x = 0, wallpaper_y = 0;   /* Screen position (centred) */
+
+void compositor_set_wallpaper(const surface_t* img) {
+    wallpaper = img;
+    if (img) {
+        uint32_t fb_w = 0, fb_h = 0;
+        fb_get_info(&fb_w, &fb_h, 0, 0, 0);
+        wallpaper_x = ((int32_t)fb_w - (int32_t)img->width) / 2;
+        wallpaper_y = ((int32_t)fb_h - (int32_t)img->height) / 2;
     }
+}
 
-    /* Allocate one scanline buffer (32bpp) */
-    uint32_t* scanline = (uint32_t*)kmalloc(fb_w * 4);
-    if (!scanline) return;
+/* Background of row y, columns [x, x + w), into buf */
+static void fill_background(uint32_t* buf, int32_t x, int32_t y, int32_t w) {
+    memset32(buf, COMPOSITOR_BG, w);
+    const surface_t* wp = wallpaper;
+    if (!wp || y < wallpaper_y || y >= wallpaper_y + (int32_t)wp->height) return;
 
-    /* Background color: Windows 1.0 Teal */
-    uint32_t bg_color = 0xFF008080;
-    
-    gpu_device_t* gpu = gpu_get_primary();
-    uint8_t* fb_base = (gpu && gpu->virt_addr) ? (uint8_t*)gpu->virt_addr : 0;
-
-    /* Lock mouse cursor to prevent flickering/corruption */
-    mouse_blit_start();
-
-    for (uint32_t y = 0; y < fb_h; y++) {
-        /* 1. Clear scanline to background */
-        for (uint32_t x = 0; x < fb_w; x++) scanline[x] = bg_color;
-
-        /* 2. Compose surfaces on this line */
-        for (int i = 0; i < count; i++) {
-            surface_t* s = surfaces[i];
-            if (!s || !s->visible) continue;
-
-            /* Check if surface intersects this line */
-            int s_y = s->y;
-            int s_h = s->height;
-            if ((int)y >= s_y && (int)y < s_y + s_h) {
-                /* Calculate source row */
-                int src_y = (int)y - s_y;
-                
-                /* Calculate horizontal intersection */
-                int s_x = s->x;
-                int s_w = s->width;
-                
-                /* Determine intersection with screen width */
-                int draw_start_x = (s_x < 0) ? 0 : s_x;
-                int draw_end_x = (s_x + s_w > (int)fb_w) ? (int)fb_w : (s_x + s_w);
-                
-                if (draw_start_x < draw_end_x) {
-                    /* Copy pixels */
-                    uint32_t* src_row = s->pixels + (src_y * s->width);
-                    int src_start_off = draw_start_x - s_x;
-                    
-                    for (int x = draw_start_x; x < draw_end_x; x++) {
-                        /* Simple opaque copy */
-                        scanline[x] = src_row[src_start_off + (x - draw_start_x)];
-                    }
-                }
+    int32_t x0 = x > wallpaper_x ? x : wallpaper_x;
+    int32_t x1 = x + w;
+    if (x1 > wallpaper_x + (int32_t)wp->width) x1 = wallpaper_x + (int32_t)wp->width;
+    if (x0 >= x1) return;
+
+    const uint32_t* src = wp->pixels + (y - wallpaper_y) * wp->width + (x0 - wallpaper_x);
+    blend_span(buf + (x0 - x), src, x1 - x0, 255, (wp->flags & SURFACE_ALPHA) != 0);
+}
+
+static void surface_rect(const surface_t* s, rect_t* r) {
+    r->x = s->x;
+    r->y = s->y;
+    r->w = (int32_t)s->width;
+    r->h = (int32_t)s->height;
+}
+
+/* One surface's part of a damage rect */
+typedef struct {
+    surface_t* s;
+    rect_t area;     /* Whole surface on screen */
+    rect_t body;     /* Surface pixels inside the rect (empty: none) */
+    rect_t shadow;   /* Drop shadow inside the rect (empty: none) */
+} layer_t;
+
+static void compose_rect(surface_t** surfaces, int count, const rect_t* r,
+                         gpu_device_t* gpu) {
+    /* Occlusion: the topmost opaque surface covering the whole rect hides
+       every surface (and the background) below it. */
+    int first = 0;
+    bool covered = false;
+    for (int i = count - 1; i >= 0; i--) {
+        surface_t* s = surfaces[i];
+        if (!s || !s->visible || !surface_is_opaque(s)) continue;
+        rect_t sr;
+        surface_rect(s, &sr);
+        if (rect_contains(&sr, r)) {
+            first = i;
+            covered = true;
+            break;
+        }
+    }
+
+    /* Surfaces (or their shadows) that actually intersect the rect */
+    layer_t layers[COMPOSITOR_MAX_SURFACES];
+    int n = 0;
+    for (int i = first; i < count && n < COMPOSITOR_MAX_SURFACES; i++) {
+        surface_t* s = surfaces[i];
+        if (!s || !s->visible) continue;
+        layer_t* l = &layers[n];
+        l->s = s;
+        surface_rect(s, &l->area);
+        if (!rect_intersect(&l->area, r, &l->body)) l->body.w = 0;
+
+        l->shadow.w = 0;
+        if (s->shadow && !(covered && i == first)) {
+            rect_t sh = l->area;
+            sh.x += s->shadow;
+            sh.y += s->shadow;
+            if (!rect_intersect(&sh, r, &l->shadow)) l->shadow.w = 0;
+        }
+        if (l->body.w || l->shadow.w) n++;
+    }
+
+    for (int32_t y = r->y; y < r->y + r->h; y++) {
+        if (!covered) fill_background(span_buf, r->x, y, r->w);
+
+        for (int i = 0; i < n; i++) {
+            const layer_t* l = &layers[i];
+            surface_t* s = l->s;
+            bool in_area = y >= l->area.y && y < l->area.y + l->area.h;
+
+            /* Shadow, except where the surface itself sits */
+            const rect_t* c = &l->shadow;
+            if (c->w && y >= c->y && y < c->y + c->h) {
+                int32_t x0 = c->x, x1 = c->x + c->w;
+                if (in_area && x0 < l->area.x + l->area.w) x0 = l->area.x + l->area.w;
+                if (x0 < x1) blend_dim(span_buf + (x0 - r->x), x1 - x0, SURFACE_SHADOW_ALPHA);
+            }
+
+            c = &l->body;
+            if (c->w && y >= c->y && y < c->y + c->h) {
+                const uint32_t* src = s->pixels + (y - s->y) * s->width + (c->x - s->x);
+                /* Opaque surfaces are a plain copy */
+                blend_span(span_buf + (c->x - r->x), src, c->w, s->opacity,
+                           (s->flags & SURFACE_ALPHA) != 0);
             }
         }
 
-        /* 3. Blit scanline to Framebuffer */
-        if (fb_base) {
-            /* Fast path: direct memory copy */
-            memcpy(fb_base + (y * gpu->pitch), scanline, fb_w * 4);
+        /* Pointer plane on top of everything */
+        cursor_compose_span(span_buf, r->x, y, r->w);
+
+        if (gpu && gpu->ops->blit) {
+            /* Converts to the screen format and marks the span dirty */
+            gpu->ops->blit(gpu, r->x, y, span_buf, r->w, r->w, 1);
         } else {
-            /* Slow path: putpixel */
-            for (uint32_t x = 0; x < fb_w; x++) {
-                fb_putpixel(x, y, scanline[x]);
+            for (int32_t x = 0; x < r->w; x++) {
+                fb_putpixel(r->x + x, y, span_buf[x]);
             }
         }
     }
-    
-    kfree(scanline);
+}
+
+void compositor_render_damage(surface_t** surfaces, int count, const region_t* damage) {
+    uint32_t fb_w = 0, fb_h = 0;
+    fb_get_info(&fb_w, &fb_h, 0, 0, 0);
+
+    if (fb_w == 0 || fb_h == 0 || !damage || damage->count == 0) {
+        return;
+    }
+
+    if (span_cap < fb_w) {
+        if (span_buf) kfree(span_buf);
+        span_buf = (uint32_t*)kmalloc(fb_w * 4);
+        span_cap = span_buf ? fb_w : 0;
+        if (!span_buf) return;
+    }
 
-    /* Unlock and redraw cursor on top of new frame */
-    mouse_blit_end();
-}
\ No newline at end of file
+    region_t clipped = *damage;
+    rect_t screen = { 0, 0, (int32_t)fb_w, (int32_t)fb_h };
+    region_clip(&clipped, &screen);
+
+    gpu_device_t* gpu = gpu_get_primary();
+
+    /* The cursor is blended into each span as it is composed, so frame
+       and cursor reach the screen together */
+    for (int i = 0; i < clipped.count; i++) {
+        compose_rect(surfaces, count, &clipped.rects[i], gpu);
+    }
+
+    if (gpu && gpu->ops && gpu->ops->flush) gpu->ops->flush(gpu);
+}
+
+void compositor_render_surfaces(surface_t** surfaces, int count) {
+    uint32_t fb_w = 0, fb_h = 0;
+    fb_get_info(&fb_w, &fb_h, 0, 0, 0);
+
+    region_t all;
+    region_clear(&all);
+    region_add(&all, 0, 0, (int32_t)fb_w, (int32_t)fb_h);
+    compositor_render_damage(surfaces, count, &all);
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "surface.h"
+#include "region.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -8,7 +9,17 @@ extern "C" {
 void compositor_init(void);
 /* Render a specific list of surfaces (allows WM to control Z-order) */
 void compositor_render_surfaces(surface_t** surfaces, int count);
+/* Same, but only recompose and flush the damaged screen areas.
+   surfaces[] is bottom to top. Surfaces with SURFACE_ALPHA or less than
+   full opacity are blended over what is below them, drop shadows darken
+   it; only opaque surfaces hide what they cover. The software cursor
+   plane (see cursor.h) goes on top. */
+void compositor_render_damage(surface_t** surfaces, int count, const region_t* damage);
+
+/* Image shown (centred, over the background colour) below every surface,
+   or NULL for none. Not copied: it must stay valid until replaced. */
+void compositor_set_wallpaper(const surface_t* img);
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
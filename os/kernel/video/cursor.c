@@ -0,0 +1,118 @@
+#include "cursor.h"
+#include "gpu.h"
+#include "blend.h"
+
+extern void serial(const char *fmt, ...);
+
+/* Cursor Bitmap (16x16)
+ * 0 = Transparent
+ * 1 = Black (Border)
+ * 2 = White (Fill)
+ */
+static const uint8_t cursor_bitmap[CURSOR_W * CURSOR_H] = {
+    1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    1,2,1,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    1,2,2,1,0,0,0,0,0,0,0,0,0,0,0,0,
+    1,2,2,2,1,0,0,0,0,0,0,0,0,0,0,0,
+    1,2,2,2,2,1,0,0,0,0,0,0,0,0,0,0,
+    1,2,2,2,2,2,1,0,0,0,0,0,0,0,0,0,
+    1,2,2,2,2,2,2,1,0,0,0,0,0,0,0,0,
+    1,2,2,2,2,2,2,2,1,0,0,0,0,0,0,0,
+    1,2,2,2,2,2,2,2,2,1,0,0,0,0,0,0,
+    1,2,2,2,2,2,1,1,1,1,0,0,0,0,0,0,
+    1,2,2,1,2,2,1,0,0,0,0,0,0,0,0,0,
+    1,2,1,0,1,2,2,1,0,0,0,0,0,0,0,0,
+    1,1,0,0,1,2,2,1,0,0,0,0,0,0,0,0,
+    1,0,0,0,0,1,2,2,1,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0
+};
+
+/* The bitmap as premultiplied ARGB (transparent pixels are 0) */
+static uint32_t cursor_image[CURSOR_W * CURSOR_H];
+static bool image_ready = false;
+
+static volatile int32_t pos_x = 0, pos_y = 0;   /* Written from the mouse IRQ */
+static volatile bool moved = false;
+
+static bool shown = false;
+static bool hardware = false;
+static rect_t drawn = { 0, 0, 0, 0 };   /* Where the software plane is this frame */
+
+static void build_image(void) {
+    if (image_ready) return;
+    for (int i = 0; i < CURSOR_W * CURSOR_H; i++) {
+        uint8_t t = cursor_bitmap[i];
+        cursor_image[i] = t == 1 ? 0xFF000000 : t == 2 ? 0xFFFFFFFF : 0;
+    }
+    image_ready = true;
+}
+
+void cursor_show(bool on) {
+    if (on == shown) return;
+    gpu_device_t* gpu = gpu_get_primary();
+    build_image();
+
+    if (on) {
+        hardware = gpu && gpu->ops && gpu->ops->cursor_set && gpu->ops->cursor_move &&
+                   gpu->ops->cursor_set(gpu, cursor_image, CURSOR_W, CURSOR_H, 0, 0) == 0;
+        if (hardware) gpu->ops->cursor_move(gpu, pos_x, pos_y);
+        serial("[CURSOR] %s cursor\n", hardware ? "Hardware" : "Software (composited)");
+    } else if (hardware) {
+        gpu->ops->cursor_set(gpu, 0, 0, 0, 0, 0);
+        hardware = false;
+    }
+    shown = on;
+    /* The software plane appears (or goes) with the next frame */
+    moved = true;
+}
+
+bool cursor_is_hardware(void) {
+    return hardware;
+}
+
+void cursor_move(int32_t x, int32_t y) {
+    pos_x = x;
+    pos_y = y;
+    if (hardware) {
+        gpu_device_t* gpu = gpu_get_primary();
+        gpu->ops->cursor_move(gpu, x, y);
+        return;
+    }
+    moved = true;
+}
+
+bool cursor_pending(void) {
+    return moved && !hardware;
+}
+
+void cursor_collect_damage(region_t* damage) {
+    if (!cursor_pending()) return;
+
+    /* Position and flag together, so a move landing now is not lost */
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    int32_t x = pos_x, y = pos_y;
+    moved = false;
+    if (flags & 0x200) asm volatile("sti" : : : "memory");
+
+    rect_t now = { x, y, CURSOR_W, CURSOR_H };
+    if (!shown) now.w = now.h = 0;
+    if (rect_equal(&now, &drawn)) return;
+
+    if (!rect_empty(&drawn)) region_add_rect(damage, &drawn);
+    if (!rect_empty(&now)) region_add_rect(damage, &now);
+    drawn = now;
+}
+
+void cursor_compose_span(uint32_t* span, int32_t x, int32_t y, int32_t w) {
+    if (rect_empty(&drawn) || y < drawn.y || y >= drawn.y + drawn.h) return;
+
+    int32_t x0 = x > drawn.x ? x : drawn.x;
+    int32_t x1 = x + w;
+    if (x1 > drawn.x + drawn.w) x1 = drawn.x + drawn.w;
+    if (x0 >= x1) return;
+
+    const uint32_t* src = cursor_image + (y - drawn.y) * CURSOR_W + (x0 - drawn.x);
+    blend_span(span + (x0 - x), src, x1 - x0, 255, true);
+}
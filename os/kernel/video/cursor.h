@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "region.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The mouse pointer as a plane of its own.
+ *
+ * Where the GPU backend has a hardware cursor (gpu_ops_t cursor_set /
+ * cursor_move) the pointer lives there and moving it costs a register
+ * write. Otherwise it is blended over each composed frame by the
+ * compositor: a move only records the new position, and the next frame
+ * recomposes the cursor's old and new areas. Either way nothing in the
+ * interrupt path touches the framebuffer.
+ */
+
+#define CURSOR_W 16
+#define CURSOR_H 16
+
+/* Shown while the compositor owns the screen (the GUI), hidden otherwise */
+void cursor_show(bool on);
+bool cursor_is_hardware(void);
+
+/* New pointer position (hotspot). Safe from interrupt handlers. */
+void cursor_move(int32_t x, int32_t y);
+
+/* Software plane, once per frame: true if the pointer moved or appeared
+   since the last frame; cursor_collect_damage then fixes the position for
+   the frame and adds the old and new cursor areas to damage. */
+bool cursor_pending(void);
+void cursor_collect_damage(region_t* damage);
+
+/* Blend the cursor's part of screen row y, columns [x, x + w), over span */
+void cursor_compose_span(uint32_t* span, int32_t x, int32_t y, int32_t w);
+
+#ifdef __cplusplus
+}
+#endif
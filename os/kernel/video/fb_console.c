@@ -1,11 +1,13 @@
 #include "fb_console.h"
 #include "framebuffer.h"
 #include "gpu.h"
-#include "font8x16.h"
+#include "glyph.h"
+#include "text_damage.h"
 #include "../drivers/serial.h"
 #include "../colors/cl.h"
 #include "../string.h"
 #include "../mem/kmalloc.h"
+#include "../time/timer.h"
 
 /* Import serial logging from kernel glue */
 extern void serial(const char *fmt, ...);
@@ -33,73 +35,105 @@ static uint32_t* active_cursor_x = &cursor_x;
 static uint32_t* active_cursor_y = &cursor_y;
 
 
-#define FONT_W 8
-#define FONT_H 16
+#define FONT_W GLYPH_W
+#define FONT_H GLYPH_H
 
 static cl_color_t current_attr = 0;
 
+/* Rendering is deferred: writes only mark cells, fb_cons_flush draws
+   them. Single characters are flushed at most once per frame. */
+#define FRAME_MS 16
+static text_damage_t damage;
+static uint32_t last_flush_ms = 0;
+static int cursor_vis_x = -1;  /* Where the cursor block is on screen */
+static int cursor_vis_y = -1;
+
+/* Line buffer for one text row (FONT_H scanlines of the full width) */
+static uint32_t* row_pixels = 0;
+
+/* Put w x h pixels on screen in one span blit (per pixel if the format has no span ops) */
+static void put_block(gpu_device_t* gpu, uint32_t x, uint32_t y, const uint32_t* px,
+                      uint32_t pitch, uint32_t w, uint32_t h) {
+    if (gpu->ops->blit) {
+        gpu->ops->blit(gpu, x, y, px, pitch, w, h);
+        return;
+    }
+    for (uint32_t j = 0; j < h; j++)
+        for (uint32_t i = 0; i < w; i++)
+            gpu->ops->putpixel(gpu, x + i, y + j, px[j * pitch + i]);
+}
+
+static const glyph_lut_t* attr_lut(cl_color_t attr) {
+    return glyph_lut(cl_rgb(cl_fg(attr)), cl_rgb(cl_bg(attr)));
+}
+
 /* Helper to draw a character using GPU ops */
-static void draw_char_at(uint32_t cx, uint32_t cy, char c, uint32_t fg, uint32_t bg) {
+static void draw_char_at(uint32_t cx, uint32_t cy, char c, cl_color_t attr) {
     gpu_device_t* gpu = gpu_get_primary();
     if (!gpu) return;
 
-    const uint8_t* glyph = &font8x16[(uint8_t)c * 16];
     uint32_t start_y = cy * FONT_H;
     uint32_t start_x = cx * FONT_W;
 
     /* Bounds check */
     if (start_x + FONT_W > gpu->width || start_y + FONT_H > gpu->height) return;
 
-    for (int y = 0; y < FONT_H; y++) {
-        uint8_t row = glyph[y];
-        for (int x = 0; x < FONT_W; x++) {
-            uint32_t color = (row & (1 << (7 - x))) ? fg : bg;
-            gpu->ops->putpixel(gpu, start_x + x, start_y + y, color);
-        }
-    }
+    uint32_t cell[FONT_W * FONT_H];
+    glyph_draw(cell, FONT_W, FONT_W, FONT_H, 0, 0, (uint8_t)c, attr_lut(attr));
+    put_block(gpu, start_x, start_y, cell, FONT_W, FONT_W, FONT_H);
 }
 
-/* Redraw the entire screen from the text buffer */
-void fb_cons_redraw(void) {
-    if (!active_text_buffer) return;
-    
-    /* If viewing history, we need to compose the view */
-    if (view_offset > 0) {
-        for (uint32_t y = 0; y < max_rows; y++) {
-            int logical_line = (int)y - view_offset;
-            
-            console_cell_t* src_row = 0;
-            
-            if (logical_line >= 0) {
-                /* Line is in active text buffer */
-                src_row = &active_text_buffer[logical_line * max_cols];
-            } else {
-                /* Line is in history */
-                int hist_depth = -logical_line; // 1-based depth
-                if (hist_depth <= history_count) {
-                    int hist_idx = (history_head - hist_depth + HISTORY_ROWS) % HISTORY_ROWS;
-                    src_row = &history_buffer[hist_idx * max_cols];
-                }
-            }
+/* Draw cells [x0, x1) of a text row from src (NULL: blank) at visual row y */
+static void draw_cells(uint32_t y, const console_cell_t* src, uint32_t x0, uint32_t x1) {
+    gpu_device_t* gpu = gpu_get_primary();
+    if (!gpu) return;
+    if (x1 > max_cols) x1 = max_cols;
+    if (x0 >= x1) return;
 
-            for (uint32_t x = 0; x < max_cols; x++) {
-                console_cell_t cell = src_row ? src_row[x] : (console_cell_t){' ', current_attr};
-                uint32_t fg = cl_rgb(cl_fg(cell.attr));
-                uint32_t bg = cl_rgb(cl_bg(cell.attr));
-                draw_char_at(x, y, cell.c, fg, bg);
-            }
-        }
+    if (!row_pixels) {
+        for (uint32_t x = x0; x < x1; x++)
+            draw_char_at(x, y, src ? src[x].c : ' ', src ? src[x].attr : current_attr);
         return;
     }
-    
-    for (uint32_t y = 0; y < max_rows; y++) {
-        for (uint32_t x = 0; x < max_cols; x++) {
-            console_cell_t* cell = &active_text_buffer[y * max_cols + x];
-            uint32_t fg = cl_rgb(cl_fg(cell->attr));
-            uint32_t bg = cl_rgb(cl_bg(cell->attr));
-            draw_char_at(x, y, cell->c, fg, bg);
-        }
+
+    uint32_t w = max_cols * FONT_W;
+    for (uint32_t x = x0; x < x1; x++) {
+        char c = src ? src[x].c : ' ';
+        cl_color_t attr = src ? src[x].attr : current_attr;
+        glyph_draw(row_pixels, w, w, FONT_H, x * FONT_W, 0, (uint8_t)c, attr_lut(attr));
     }
+    put_block(gpu, x0 * FONT_W, y * FONT_H, row_pixels + x0 * FONT_W, w,
+              (x1 - x0) * FONT_W, FONT_H);
+}
+
+/* Make everything drawn so far visible (copies dirty shadow spans) */
+static void present(void) {
+    gpu_device_t* gpu = gpu_get_primary();
+    if (gpu && gpu->ops->flush) gpu->ops->flush(gpu);
+}
+
+/* Text shown at visual row y (NULL: blank) */
+static const console_cell_t* row_source(uint32_t y) {
+    /* If viewing history, lines above the live screen come from there */
+    int logical_line = (int)y - view_offset;
+
+    if (logical_line >= 0) {
+        /* Line is in active text buffer */
+        return &active_text_buffer[logical_line * max_cols];
+    }
+
+    /* Line is in history */
+    int hist_depth = -logical_line; // 1-based depth
+    if (hist_depth <= history_count) {
+        int hist_idx = (history_head - hist_depth + HISTORY_ROWS) % HISTORY_ROWS;
+        return &history_buffer[hist_idx * max_cols];
+    }
+    return 0;
+}
+
+/* Redraw the entire screen from the text buffer (at the next flush) */
+static void redraw(void) {
+    text_damage_all(&damage, max_rows, max_cols);
 }
 
 /* Scroll the screen up by one line using the text buffer */
@@ -114,8 +148,6 @@ static void scroll(void) {
         if (history_count < HISTORY_ROWS) {
             history_count++;
         }
-        
-        serial("[FB_CONS] Scroll: pushed line to history (count=%d)\n", history_count);
     }
 
     /* Move text buffer up in RAM (Fast) */
@@ -129,12 +161,17 @@ static void scroll(void) {
         last_row[i].attr = current_attr;
     }
 
-    /* Redraw screen from buffer (Faster and cleaner than VRAM read/write) */
-    fb_cons_redraw();
+    /* The flush moves the pixels up by all pending scrolls in one copy and
+       draws only the new lines; the whole screen is redrawn while viewing history */
+    if (view_offset == 0) {
+        text_damage_scroll(&damage, max_rows, max_cols);
+    } else {
+        redraw();
+    }
 }
 
 /* Draw cursor (block) */
-static void draw_cursor(int on) {
+static void draw_cursor(void) {
     gpu_device_t* gpu = gpu_get_primary();
     if (!gpu) return;
     
@@ -150,23 +187,15 @@ static void draw_cursor(int on) {
     /* Bounds check */
     if (start_x + FONT_W > gpu->width || start_y + FONT_H > gpu->height) return;
 
-    /* If turning off, restore character from buffer */
-    if (!on) {
-        if (active_text_buffer) {
-            console_cell_t* cell = &active_text_buffer[(*active_cursor_y) * max_cols + (*active_cursor_x)];
-            uint32_t fg = cl_rgb(cl_fg(cell->attr));
-            uint32_t bg = cl_rgb(cl_bg(cell->attr));
-            draw_char_at((*active_cursor_x), visual_y, cell->c, fg, bg);
-        } else {
-             uint32_t fg = cl_rgb(cl_fg(current_attr));
-             uint32_t bg = cl_rgb(cl_bg(current_attr));
-             draw_char_at((*active_cursor_x), visual_y, ' ', fg, bg);
-        }
-        return;
-    }
+    cursor_vis_x = (int)(*active_cursor_x);
+    cursor_vis_y = visual_y;
 
     /* Draw cursor block */
     uint32_t color = 0x00AAAAAA; // Grey block
+    if (gpu->ops->fillrect) {
+        gpu->ops->fillrect(gpu, start_x, start_y + FONT_H - 2, FONT_W, 2, color);
+        return;
+    }
     for (int y = FONT_H - 2; y < FONT_H; y++) {
         for (int x = 0; x < FONT_W; x++) {
              gpu->ops->putpixel(gpu, start_x + x, start_y + y, color);
@@ -174,6 +203,47 @@ static void draw_cursor(int on) {
     }
 }
 
+void fb_cons_flush(void) {
+    gpu_device_t* gpu = gpu_get_primary();
+    if (!gpu || !active_text_buffer) return;
+
+    int cursor_moved = cursor_vis_x != (int)(*active_cursor_x) ||
+                       cursor_vis_y != (int)(*active_cursor_y) + view_offset;
+    if (!text_damage_any(&damage) && !cursor_moved) return;
+
+    /* The old cursor block moves with the scrolled pixels; its cell gets the text back */
+    if (cursor_vis_y >= 0) {
+        int y = cursor_vis_y - (int)damage.scrolled;
+        if (y >= 0) text_damage_add(&damage, y, cursor_vis_x, cursor_vis_x + 1);
+        cursor_vis_x = cursor_vis_y = -1;
+    }
+
+    if (damage.scrolled) {
+        uint32_t n = damage.scrolled;
+        if (n < max_rows && gpu->ops->copyrect) {
+            gpu->ops->copyrect(gpu, 0, 0, 0, n * FONT_H, max_cols * FONT_W, (max_rows - n) * FONT_H);
+        } else {
+            redraw();
+        }
+    }
+
+    uint32_t x0, x1;
+    for (int y = text_damage_next(&damage, 0, &x0, &x1); y >= 0 && y < (int)max_rows;
+         y = text_damage_next(&damage, y + 1, &x0, &x1)) {
+        draw_cells(y, row_source(y), x0, x1);
+    }
+    text_damage_clear(&damage);
+
+    draw_cursor();
+    present();
+    last_flush_ms = timer_uptime_ms();
+}
+
+void fb_cons_redraw(void) {
+    redraw();
+    fb_cons_flush();
+}
+
 void fb_cons_init(void) {
     serial("[FB_CONS] Initializing...\n");
     gpu_device_t* gpu = gpu_get_primary();
@@ -189,6 +259,7 @@ void fb_cons_init(void) {
 
     max_cols = cons_width / FONT_W;
     max_rows = cons_height / FONT_H;
+    if (max_rows > TEXT_DAMAGE_MAX_ROWS) max_rows = TEXT_DAMAGE_MAX_ROWS;
     cursor_x = 0;
     cursor_y = 0;
     current_attr = cl_default();
@@ -199,6 +270,10 @@ void fb_cons_init(void) {
     
     if (history_buffer) kfree(history_buffer);
     history_buffer = (console_cell_t*)kmalloc(max_cols * HISTORY_ROWS * sizeof(console_cell_t));
+
+    /* Optional: without it rows are drawn cell by cell */
+    if (row_pixels) kfree(row_pixels);
+    row_pixels = (uint32_t*)kmalloc(max_cols * FONT_W * FONT_H * sizeof(uint32_t));
     
     if (!boot_buf || !history_buffer) {
         serial("[FB_CONS] Error: Failed to allocate buffers!\n");
@@ -220,7 +295,9 @@ void fb_cons_init(void) {
     gpu->ops->clear(gpu, cl_rgb(cl_bg(current_attr)));
     serial("[FB_CONS] Screen cleared.\n");
     
-    draw_cursor(1);
+    text_damage_clear(&damage);
+    draw_cursor();
+    present();
 }
 
 /* Internal putc without cursor handling (for bulk updates) */
@@ -260,9 +337,7 @@ static void fb_cons_putc_internal(char c) {
             console_cell_t* cell = &active_text_buffer[(*active_cursor_y) * max_cols + (*active_cursor_x)];
             cell->c = ' ';
             cell->attr = current_attr;
-            uint32_t fg = cl_rgb(cl_fg(current_attr));
-            uint32_t bg = cl_rgb(cl_bg(current_attr));
-            draw_char_at(*active_cursor_x, *active_cursor_y, ' ', fg, bg);
+            text_damage_add(&damage, *active_cursor_y, *active_cursor_x, *active_cursor_x + 1);
             (*active_cursor_x)++;
         }
     } else if (c >= ' ') {
@@ -280,9 +355,7 @@ static void fb_cons_putc_internal(char c) {
             console_cell_t* cell = &active_text_buffer[(*active_cursor_y) * max_cols + (*active_cursor_x)];
             cell->c = c;
             cell->attr = current_attr;
-            uint32_t fg = cl_rgb(cl_fg(current_attr));
-            uint32_t bg = cl_rgb(cl_bg(current_attr));
-            draw_char_at(*active_cursor_x, *active_cursor_y, c, fg, bg);
+            text_damage_add(&damage, *active_cursor_y, *active_cursor_x, *active_cursor_x + 1);
         }
         (*active_cursor_x)++;
     }
@@ -294,14 +367,15 @@ void fb_cons_putc(char c) {
     /* Auto-follow: Reset scrollback on input */
     if (view_offset > 0) {
         view_offset = 0;
-        fb_cons_redraw();
+        redraw();
         serial("[FB_CONS] Auto-follow: snapped to bottom\n");
     }
 
-    /* Hide cursor, draw char, show cursor */
-    draw_cursor(0);
     fb_cons_putc_internal(c);
-    draw_cursor(1);
+
+    /* Coalesce: show single characters at most once per frame; the idle
+       loop flushes whatever is left */
+    if (timer_uptime_ms() - last_flush_ms >= FRAME_MS) fb_cons_flush();
 }
 
 void fb_cons_puts(const char* s) {
@@ -309,16 +383,15 @@ void fb_cons_puts(const char* s) {
 
     if (view_offset > 0) {
         view_offset = 0;
-        fb_cons_redraw();
+        redraw();
         serial("[FB_CONS] Auto-follow: snapped to bottom\n");
     }
 
-    /* Optimization: Hide cursor ONCE for the whole string */
-    draw_cursor(0);
+    /* The whole string is drawn in one flush */
     while (*s) {
         fb_cons_putc_internal(*s++);
     }
-    draw_cursor(1);
+    fb_cons_flush();
 }
 
 void fb_cons_clear(void) {
@@ -341,7 +414,10 @@ void fb_cons_clear(void) {
     
     /* Clear screen and redraw cursor */
     gpu->ops->clear(gpu, cl_rgb(cl_bg(current_attr)));
-    draw_cursor(1);
+    text_damage_clear(&damage);
+    draw_cursor();
+    present();
+    last_flush_ms = timer_uptime_ms();
     serial("[FB_CONS] Clear done.\n");
 }
 
@@ -359,9 +435,8 @@ void fb_cons_scroll(int lines) {
     
     if (view_offset != old_offset) {
         serial("[FB_CONS] Scroll offset: %d\n", view_offset);
-        draw_cursor(0); // Hide cursor at old position
-        fb_cons_redraw();
-        draw_cursor(1); // Show cursor at new position (if visible)
+        redraw();
+        fb_cons_flush();
     }
 }
 
@@ -18,6 +18,10 @@ void fb_cons_puts(const char* s);
 void fb_cons_clear(void);
 void fb_cons_scroll(int lines);
 
+/* Draw everything written since the last flush. putc only marks cells
+   (and flushes once a frame); puts flushes when done. */
+void fb_cons_flush(void);
+
 /* Set current text attribute (color) */
 void fb_cons_set_attr(cl_color_t attr);
 
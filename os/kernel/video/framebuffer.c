@@ -4,6 +4,7 @@
 #include "../memory/pmm.h"
 #include "../mm/paging.h" /* for KERNEL_BASE */
 #include "gpu.h"
+#include "../hardware/pat.h"
 
 /* Import serial logging from kernel glue */
 extern void serial(const char *fmt, ...);
@@ -32,38 +33,14 @@ static void vesa_putpixel(gpu_device_t* dev, uint32_t x, uint32_t y, uint32_t co
         pixel[0] = (color) & 0xFF;
         pixel[1] = (color >> 8) & 0xFF;
         pixel[2] = (color >> 16) & 0xFF;
+    } else if (dev->bpp == 16) {
+        *(uint16_t*)pixel = ((color >> 8) & 0xF800) | ((color >> 5) & 0x07E0) | ((color >> 3) & 0x001F);
     }
-}
-
-static void vesa_fillrect(gpu_device_t* dev, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color) {
-    if (!dev->virt_addr) return;
-    
-    /* Clipping */
-    if (x >= dev->width || y >= dev->height) return;
-    if (x + w > dev->width) w = dev->width - x;
-    if (y + h > dev->height) h = dev->height - y;
-
-    for (uint32_t j = 0; j < h; j++) {
-        for (uint32_t i = 0; i < w; i++) {
-            vesa_putpixel(dev, x + i, y + j, color);
-        }
-    }
+    gpu_mark_dirty(dev, x, y, 1, 1);
 }
 
 static void vesa_clear(gpu_device_t* dev, uint32_t color) {
-    if (!dev->virt_addr) return;
-
-    /* Optimized clear for 32bpp */
-    if (dev->bpp == 32) {
-        uint32_t* buf = (uint32_t*)dev->virt_addr;
-        uint32_t count = dev->width * dev->height;
-        /* Note: This assumes pitch == width * 4, which is usually true for VESA 32bpp 
-           but strictly we should respect pitch. For full correctness line-by-line is safer,
-           but for a clear operation on linear LFB, this is usually fine. */
-        for (uint32_t i = 0; i < count; ++i) buf[i] = color;
-    } else {
-        vesa_fillrect(dev, 0, 0, dev->width, dev->height, color);
-    }
+    gpu_span_fillrect(dev, 0, 0, dev->width, dev->height, color);
 }
 
 static int vesa_set_mode(gpu_device_t* dev, uint32_t width, uint32_t height, uint32_t bpp) {
@@ -74,15 +51,14 @@ static int vesa_set_mode(gpu_device_t* dev, uint32_t width, uint32_t height, uin
 }
 
 static void vesa_flush(gpu_device_t* dev) {
-    (void)dev;
-    /* Linear Framebuffer is usually uncached (WC) or direct, no explicit flush needed */
-    asm volatile("sfence" ::: "memory");
+    /* Copy dirty shadow spans out; drains the WC buffers either way */
+    gpu_present(dev);
 }
 
+/* fillrect, blit, blit_alpha and copyrect: gpu_span_* from registration */
 static gpu_ops_t vesa_ops = {
     .set_mode = vesa_set_mode,
     .putpixel = vesa_putpixel,
-    .fillrect = vesa_fillrect,
     .clear    = vesa_clear,
     .flush    = vesa_flush
 };
@@ -135,13 +111,14 @@ void fb_init(uint64_t addr, uint32_t width, uint32_t height, uint32_t pitch, uin
 
     /* 5. Map Framebuffer Memory */
     /* Map physical framebuffer to virtual memory at FB_VIRT_BASE.
-     * We use PAGE_PCD | PAGE_PWT to disable caching for video memory (avoids artifacts/crashes).
+     * Write-combining through the PAT (uncached if the CPU has none): only
+     * ever written, in long runs, by gpu_present.
      */
     vmm_map_region(active_pd, 
                    FB_VIRT_BASE, 
                    (uint32_t)phys_addr, 
                    fb_size, 
-                   PAGE_PRESENT | PAGE_RW | PAGE_PCD | PAGE_PWT);
+                   PAGE_PRESENT | PAGE_RW | pat_wc_flags());
 
     /* Force TLB flush to ensure mappings are visible immediately */
     asm volatile("mov %%cr3, %%eax; mov %%eax, %%cr3" ::: "eax", "memory");
@@ -177,7 +154,7 @@ void fb_clear(uint32_t color) {
 }
 
 void fb_draw_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color) {
-    vesa_fillrect(&vesa_device, x, y, w, h, color);
+    gpu_span_fillrect(&vesa_device, x, y, w, h, color);
 }
 
 void fb_get_info(uint32_t* width, uint32_t* height, uint32_t* pitch, uint8_t* bpp, uint8_t** buffer) {
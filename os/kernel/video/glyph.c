@@ -0,0 +1,92 @@
+/* kernel/video/glyph.c */
+#include "glyph.h"
+#include "font8x16.h"
+
+static glyph_lut_t lut_cache[GLYPH_LUT_CACHE];
+static int lut_used = 0;
+static int lut_next = 0;
+static int lut_last = 0;
+
+const glyph_lut_t* glyph_lut(uint32_t fg, uint32_t bg) {
+    /* Text is usually drawn in long runs of one colour pair */
+    glyph_lut_t* l = &lut_cache[lut_last];
+    if (lut_used && l->fg == fg && l->bg == bg) return l;
+
+    for (int i = 0; i < lut_used; i++) {
+        if (lut_cache[i].fg == fg && lut_cache[i].bg == bg) {
+            lut_last = i;
+            return &lut_cache[i];
+        }
+    }
+
+    /* Miss: build a table in the next slot (round robin) */
+    l = &lut_cache[lut_next];
+    l->fg = fg;
+    l->bg = bg;
+    for (int n = 0; n < 16; n++) {
+        for (int b = 0; b < 4; b++) {
+            l->nib[n][b] = (n & (8 >> b)) ? fg : bg;
+        }
+    }
+    lut_last = lut_next;
+    lut_next = (lut_next + 1) % GLYPH_LUT_CACHE;
+    if (lut_used < GLYPH_LUT_CACHE) lut_used++;
+    return l;
+}
+
+/* Visible part of a cell at (x, y): columns [*c0, *c1) and rows [*r0, *r1) */
+static int clip_cell(uint32_t w, uint32_t h, int x, int y, int* c0, int* c1, int* r0, int* r1) {
+    if (x >= (int)w || y >= (int)h || x <= -GLYPH_W || y <= -GLYPH_H) return 0;
+    *c0 = x < 0 ? -x : 0;
+    *r0 = y < 0 ? -y : 0;
+    *c1 = (int)w - x < GLYPH_W ? (int)w - x : GLYPH_W;
+    *r1 = (int)h - y < GLYPH_H ? (int)h - y : GLYPH_H;
+    return 1;
+}
+
+void glyph_draw(uint32_t* buf, uint32_t pitch, uint32_t w, uint32_t h,
+                int x, int y, uint8_t c, const glyph_lut_t* lut) {
+    int c0, c1, r0, r1;
+    if (!buf || !lut || !clip_cell(w, h, x, y, &c0, &c1, &r0, &r1)) return;
+
+    const uint8_t* glyph = &font8x16[c * GLYPH_H];
+    uint32_t* row = buf + (y + r0) * (int)pitch + x;
+
+    if (c0 == 0 && c1 == GLYPH_W) {
+        for (int r = r0; r < r1; r++, row += pitch) {
+            const uint32_t* hi = lut->nib[glyph[r] >> 4];
+            const uint32_t* lo = lut->nib[glyph[r] & 0x0F];
+            row[0] = hi[0]; row[1] = hi[1]; row[2] = hi[2]; row[3] = hi[3];
+            row[4] = lo[0]; row[5] = lo[1]; row[6] = lo[2]; row[7] = lo[3];
+        }
+        return;
+    }
+
+    /* Cell straddles an edge */
+    for (int r = r0; r < r1; r++, row += pitch) {
+        uint8_t bits = glyph[r];
+        for (int i = c0; i < c1; i++) {
+            row[i] = lut->nib[(bits >> (4 - (i & 4))) & 0x0F][i & 3];
+        }
+    }
+}
+
+void glyph_draw_mask(uint32_t* buf, uint32_t pitch, uint32_t w, uint32_t h,
+                     int x, int y, uint8_t c, uint32_t fg) {
+    int c0, c1, r0, r1;
+    if (!buf || !clip_cell(w, h, x, y, &c0, &c1, &r0, &r1)) return;
+
+    const uint8_t* glyph = &font8x16[c * GLYPH_H];
+    uint8_t cols = (uint8_t)((0xFF >> c0) & (0xFF << (GLYPH_W - c1)));
+    uint32_t* row = buf + (y + r0) * (int)pitch + x;
+
+    /* Visit set bits only; most glyph rows are blank or sparse */
+    for (int r = r0; r < r1; r++, row += pitch) {
+        uint32_t bits = glyph[r] & cols;
+        while (bits) {
+            int i = __builtin_clz(bits) - 24;
+            row[i] = fg;
+            bits &= ~(0x80u >> i);
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 8x16 text rendering into 32 bpp buffers.
+ *
+ * Glyph rows are 1 bpp; each half-row (4 bits) indexes a table of four
+ * ready-made pixels for one (fg, bg) pair, so a glyph row is two 16-byte
+ * copies instead of eight tests and calls. Tables for recently used
+ * colour pairs are cached.
+ */
+
+#define GLYPH_W 8
+#define GLYPH_H 16
+
+typedef struct {
+    uint32_t fg;
+    uint32_t bg;
+    uint32_t nib[16][4];   /* Pixels for every 4-bit pattern, MSB first */
+} glyph_lut_t;
+
+#define GLYPH_LUT_CACHE 8
+
+/* Expansion table for fg on bg (cached; valid until GLYPH_LUT_CACHE other pairs are used) */
+const glyph_lut_t* glyph_lut(uint32_t fg, uint32_t bg);
+
+/* Draw character c with its top-left corner at (x, y) in a w x h buffer
+   of pitch pixels per row, clipped to the buffer. glyph_draw writes every
+   pixel of the cell; glyph_draw_mask only the foreground pixels. */
+void glyph_draw(uint32_t* buf, uint32_t pitch, uint32_t w, uint32_t h,
+                int x, int y, uint8_t c, const glyph_lut_t* lut);
+void glyph_draw_mask(uint32_t* buf, uint32_t pitch, uint32_t w, uint32_t h,
+                     int x, int y, uint8_t c, uint32_t fg);
+
+#ifdef __cplusplus
+}
+#endif
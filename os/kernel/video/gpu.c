@@ -1,5 +1,8 @@
 /* kernel/video/gpu.c */
 #include "gpu.h"
+#include "../mem/kmalloc.h"
+#include "../string.h"
+#include "../hardware/sse.h"
 #include <stddef.h>
 
 /* Import serial logging */
@@ -23,6 +26,17 @@ void gpu_register_device(gpu_device_t* dev) {
     dev->device_id = next_device_id++;
     dev->next = NULL;
 
+    /* Pick the row kernels once; the span ops dispatch through them */
+    dev->span = gpu_span_select(dev->bpp);
+    if (dev->span && dev->ops) {
+        if (!dev->ops->fillrect)   dev->ops->fillrect = gpu_span_fillrect;
+        if (!dev->ops->blit)       dev->ops->blit = gpu_span_blit;
+        if (!dev->ops->blit_alpha) dev->ops->blit_alpha = gpu_span_blit_alpha;
+        if (!dev->ops->copyrect)   dev->ops->copyrect = gpu_span_copyrect;
+    } else if (!dev->span) {
+        serial("[GPU]   No span kernels for %u bpp\n", dev->bpp);
+    }
+
     serial("[GPU] Registering device ID %d (Type: %d)\n", dev->device_id, dev->type);
     serial("[GPU]   Resolution: %dx%dx%d\n", dev->width, dev->height, dev->bpp);
     serial("[GPU]   Address: Phys=0x%x Virt=0x%x\n", dev->phys_addr, dev->virt_addr);
@@ -47,4 +61,106 @@ void gpu_register_device(gpu_device_t* dev) {
 
 gpu_device_t* gpu_get_primary(void) {
     return gpu_primary;
-}
\ No newline at end of file
+}
+/* Both called from the mouse IRQ as well as normal context */
+static inline uint32_t gpu_irq_save(void) {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void gpu_irq_restore(uint32_t flags) {
+    if (flags & 0x200) asm volatile("sti" : : : "memory");
+}
+
+int gpu_shadow_enable(gpu_device_t* dev) {
+    if (!dev || !dev->virt_addr || dev->bpp < 8) return -1;
+
+    uint32_t size = dev->pitch * dev->height;
+    uint8_t* shadow = (uint8_t*)kmalloc_aligned(size, 64);
+    uint16_t* x0 = (uint16_t*)kmalloc(dev->height * sizeof(uint16_t));
+    uint16_t* x1 = (uint16_t*)kmalloc(dev->height * sizeof(uint16_t));
+    if (!shadow || !x0 || !x1) {
+        if (shadow) kfree(shadow);
+        if (x0) kfree(x0);
+        if (x1) kfree(x1);
+        serial("[GPU] No memory for a %u byte shadow buffer\n", size);
+        return -1;
+    }
+
+    uint32_t flags = gpu_irq_save();
+    if (dev->vram) {
+        /* Mode change: replace the old shadow */
+        kfree(dev->virt_addr);
+        kfree(dev->dirty_x0);
+        kfree(dev->dirty_x1);
+    } else {
+        dev->vram = dev->virt_addr;
+    }
+    dev->virt_addr = shadow;
+    dev->dirty_x0 = x0;
+    dev->dirty_x1 = x1;
+    dev->dirty_y0 = dev->height;
+    dev->dirty_y1 = 0;
+    for (uint32_t y = 0; y < dev->height; y++) {
+        x0[y] = 0xFFFF;
+        x1[y] = 0;
+    }
+
+    /* Start black and push it all once, rather than reading VRAM back */
+    memset(shadow, 0, size);
+    gpu_irq_restore(flags);
+    gpu_mark_dirty(dev, 0, 0, dev->width, dev->height);
+
+    serial("[GPU] Shadow buffer: %u bytes at 0x%x\n", size, shadow);
+    return 0;
+}
+
+void gpu_mark_dirty(gpu_device_t* dev, uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    if (!dev || !dev->vram) return;
+    if (x >= dev->width || y >= dev->height || w == 0 || h == 0) return;
+    if (w > dev->width - x) w = dev->width - x;
+    if (h > dev->height - y) h = dev->height - y;
+
+    uint32_t flags = gpu_irq_save();
+    for (uint32_t row = y; row < y + h; row++) {
+        if (x < dev->dirty_x0[row]) dev->dirty_x0[row] = (uint16_t)x;
+        if (x + w > dev->dirty_x1[row]) dev->dirty_x1[row] = (uint16_t)(x + w);
+    }
+    if (y < dev->dirty_y0) dev->dirty_y0 = y;
+    if (y + h > dev->dirty_y1) dev->dirty_y1 = y + h;
+    gpu_irq_restore(flags);
+}
+
+void gpu_present(gpu_device_t* dev) {
+    if (!dev || !dev->vram) {
+        asm volatile("sfence" ::: "memory");
+        return;
+    }
+
+    uint32_t bytes_pp = dev->bpp / 8;
+    /* Non-temporal stores keep the copy out of the cache; the shadow
+       is what gets read again, not VRAM. */
+    void* (*copy)(void*, const void*, size_t) = cpu_has_sse2() ? memcpy_nt : memcpy;
+
+    uint32_t flags = gpu_irq_save();
+    uint32_t y0 = dev->dirty_y0, y1 = dev->dirty_y1;
+    dev->dirty_y0 = dev->height;
+    dev->dirty_y1 = 0;
+    gpu_irq_restore(flags);
+
+    /* Interrupts stay on while copying; a span dirtied meanwhile is
+       either copied here or left marked for the next present. */
+    for (uint32_t y = y0; y < y1; y++) {
+        flags = gpu_irq_save();
+        uint32_t x0 = dev->dirty_x0[y], x1 = dev->dirty_x1[y];
+        dev->dirty_x0[y] = 0xFFFF;
+        dev->dirty_x1[y] = 0;
+        gpu_irq_restore(flags);
+        if (x0 >= x1) continue;
+
+        uint32_t off = y * dev->pitch + x0 * bytes_pp;
+        copy((uint8_t*)dev->vram + off, (uint8_t*)dev->virt_addr + off, (x1 - x0) * bytes_pp);
+    }
+    asm volatile("sfence" ::: "memory");
+}
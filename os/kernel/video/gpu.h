@@ -28,8 +28,35 @@ typedef struct {
     
     /* Memory barrier / flush for buffered GPUs */
     void (*flush)(struct gpu_device* dev);
+
+    /* Copy ARGB32 pixels (src_pitch in pixels) to the screen, clipped */
+    void (*blit)(struct gpu_device* dev, int32_t x, int32_t y, const uint32_t* src,
+                 uint32_t src_pitch, uint32_t w, uint32_t h);
+    /* Same, blending each (premultiplied) source pixel over the screen by its alpha */
+    void (*blit_alpha)(struct gpu_device* dev, int32_t x, int32_t y, const uint32_t* src,
+                       uint32_t src_pitch, uint32_t w, uint32_t h);
+    /* Move a screen rectangle; source and destination may overlap */
+    void (*copyrect)(struct gpu_device* dev, uint32_t dst_x, uint32_t dst_y,
+                     uint32_t src_x, uint32_t src_y, uint32_t w, uint32_t h);
+
+    /* Hardware cursor (optional). cursor_set loads a premultiplied ARGB32
+       image with its hotspot, or hides the cursor when image is NULL; it
+       returns 0 if the device took it. cursor_move places the hotspot and
+       may be called from interrupt context. */
+    int  (*cursor_set)(struct gpu_device* dev, const uint32_t* image, uint32_t w, uint32_t h,
+                       uint32_t hot_x, uint32_t hot_y);
+    void (*cursor_move)(struct gpu_device* dev, int32_t x, int32_t y);
 } gpu_ops_t;
 
+/* Row kernels for one pixel format. Colors are always ARGB32; the
+   kernels convert to the device format. */
+typedef struct {
+    uint32_t bytes_pp;
+    void (*fill)(uint8_t* dst, uint32_t color, uint32_t n);
+    void (*copy)(uint8_t* dst, const uint32_t* src, uint32_t n);
+    void (*blend)(uint8_t* dst, const uint32_t* src, uint32_t n);
+} gpu_span_ops_t;
+
 /* GPU Device Structure */
 typedef struct gpu_device {
     uint32_t device_id;
@@ -43,10 +70,19 @@ typedef struct gpu_device {
     
     /* Memory Info */
     uintptr_t phys_addr;
-    void* virt_addr;
+    void* virt_addr;        /* Drawing target: the shadow buffer once enabled */
+
+    /* Shadow buffer: vram is the real (write-combining) mapping and
+       gpu_present streams the dirty span of each row across. */
+    void* vram;
+    uint16_t* dirty_x0;     /* Per row, dirty pixels are [x0, x1) */
+    uint16_t* dirty_x1;
+    uint32_t dirty_y0;      /* Rows that may hold a span */
+    uint32_t dirty_y1;
     
     /* Driver Ops */
     gpu_ops_t* ops;
+    const gpu_span_ops_t* span;     /* Picked from bpp at registration */
     
     /* Linked List */
     struct gpu_device* next;
@@ -57,6 +93,25 @@ void gpu_init(void);
 void gpu_register_device(gpu_device_t* dev);
 gpu_device_t* gpu_get_primary(void);
 
+/* Span-based ops for drivers with a linear framebuffer at virt_addr.
+   gpu_register_device selects dev->span to match dev->bpp (32, 24 or
+   16) and fills any of fillrect/blit/blit_alpha/copyrect left NULL. */
+const gpu_span_ops_t* gpu_span_select(uint32_t bpp);
+void gpu_span_fillrect(gpu_device_t* dev, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color);
+void gpu_span_blit(gpu_device_t* dev, int32_t x, int32_t y, const uint32_t* src,
+                   uint32_t src_pitch, uint32_t w, uint32_t h);
+void gpu_span_blit_alpha(gpu_device_t* dev, int32_t x, int32_t y, const uint32_t* src,
+                         uint32_t src_pitch, uint32_t w, uint32_t h);
+void gpu_span_copyrect(gpu_device_t* dev, uint32_t dst_x, uint32_t dst_y,
+                       uint32_t src_x, uint32_t src_y, uint32_t w, uint32_t h);
+
+/* Move drawing to a cached RAM copy of the framebuffer. Anything writing
+   virt_addr directly must report it with gpu_mark_dirty; the ops do so
+   themselves. ops->flush (gpu_present) makes the changes visible. */
+int  gpu_shadow_enable(gpu_device_t* dev);
+void gpu_mark_dirty(gpu_device_t* dev, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+void gpu_present(gpu_device_t* dev);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "../memory/pmm.h"
 #include "../mm/paging.h"
 #include "../arch/i386/io.h"
+#include "../hardware/pat.h"
 
 /* Bochs VBE Extensions (BGA) Definitions */
 #define VBE_DISPI_IOPORT_INDEX      0x01CE
@@ -71,42 +72,15 @@ static void bochs_putpixel(gpu_device_t* dev, uint32_t x, uint32_t y, uint32_t c
     /* Assuming 32 BPP for now as enforced by set_mode */
     uint32_t* buffer = (uint32_t*)dev->virt_addr;
     buffer[y * (dev->pitch / 4) + x] = color;
-}
-
-static void bochs_fillrect(gpu_device_t* dev, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color) {
-    if (!dev->virt_addr) return;
-
-    /* Clipping */
-    if (x >= dev->width || y >= dev->height) return;
-    if (x + w > dev->width) w = dev->width - x;
-    if (y + h > dev->height) h = dev->height - y;
-
-    uint32_t* buffer = (uint32_t*)dev->virt_addr;
-    uint32_t pitch32 = dev->pitch / 4;
-
-    for (uint32_t j = 0; j < h; j++) {
-        uint32_t offset = (y + j) * pitch32 + x;
-        for (uint32_t i = 0; i < w; i++) {
-            buffer[offset + i] = color;
-        }
-    }
+    gpu_mark_dirty(dev, x, y, 1, 1);
 }
 
 static void bochs_clear(gpu_device_t* dev, uint32_t color) {
-    if (!dev->virt_addr) return;
-
-    uint32_t* buffer = (uint32_t*)dev->virt_addr;
-    uint32_t count = (dev->pitch / 4) * dev->height;
-    
-    for (uint32_t i = 0; i < count; i++) {
-        buffer[i] = color;
-    }
+    gpu_span_fillrect(dev, 0, 0, dev->width, dev->height, color);
 }
 
 static void bochs_flush(gpu_device_t* dev) {
-    (void)dev;
-    /* Memory barrier */
-    asm volatile("sfence" ::: "memory");
+    gpu_present(dev);
 }
 
 static int bochs_set_mode(gpu_device_t* dev, uint32_t width, uint32_t height, uint32_t bpp) {
@@ -133,6 +107,7 @@ static int bochs_set_mode(gpu_device_t* dev, uint32_t width, uint32_t height, ui
     dev->height = height;
     dev->bpp = bpp;
     dev->pitch = width * (bpp / 8); /* Bochs usually packs lines tightly */
+    dev->span = gpu_span_select(bpp);
 
     /* Verify if settings stuck */
     uint16_t new_x = bochs_read(VBE_DISPI_INDEX_XRES);
@@ -143,16 +118,20 @@ static int bochs_set_mode(gpu_device_t* dev, uint32_t width, uint32_t height, ui
         return -1;
     }
 
+    /* Resize the shadow buffer, if any, to the new mode */
+    if (dev->vram) gpu_shadow_enable(dev);
+
     /* Clear screen after mode switch */
     bochs_clear(dev, 0x000000);
+    bochs_flush(dev);
 
     return 0;
 }
 
+/* fillrect, blit, blit_alpha and copyrect: gpu_span_* from registration */
 static gpu_ops_t bochs_ops = {
     .set_mode = bochs_set_mode,
     .putpixel = bochs_putpixel,
-    .fillrect = bochs_fillrect,
     .clear    = bochs_clear,
     .flush    = bochs_flush
 };
@@ -231,7 +210,7 @@ device_found:
 
     /* Map to Virtual Memory */
     uint32_t* active_pd = vmm_get_current_pd();
-    vmm_map_region(active_pd, BOCHS_LFB_VIRT_BASE, bar0, fb_size, PAGE_PRESENT | PAGE_RW | PAGE_PCD | PAGE_PWT);
+    vmm_map_region(active_pd, BOCHS_LFB_VIRT_BASE, bar0, fb_size, PAGE_PRESENT | PAGE_RW | pat_wc_flags());
     
     /* Force TLB flush */
     asm volatile("mov %%cr3, %%eax; mov %%eax, %%cr3" ::: "eax", "memory");
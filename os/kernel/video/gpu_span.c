@@ -0,0 +1,211 @@
+/* kernel/video/gpu_span.c */
+#include "gpu.h"
+#include "blend.h"
+#include "../string.h"
+#include <stdbool.h>
+
+/* --- Pixel format helpers --- */
+
+static inline uint32_t to_565(uint32_t c) {
+    return ((c >> 8) & 0xF800) | ((c >> 5) & 0x07E0) | ((c >> 3) & 0x001F);
+}
+
+static inline uint32_t from_565(uint16_t p) {
+    uint32_t r = (p >> 11) & 0x1F, g = (p >> 5) & 0x3F, b = p & 0x1F;
+    return 0xFF000000 | ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+}
+
+/* --- 32 bpp --- */
+
+static void fill32(uint8_t* dst, uint32_t color, uint32_t n) {
+    memset32((uint32_t*)dst, color, n);
+}
+
+static void copy32(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    memcpy(dst, src, n * 4);
+}
+
+static void blend32(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    blend_span((uint32_t*)dst, src, n, 255, true);
+}
+
+/* --- 24 bpp (B, G, R in memory) --- */
+
+/* x86 stores unaligned words fine; tell the compiler so */
+typedef uint32_t __attribute__((aligned(1), may_alias)) u32_unaligned;
+
+static void fill24(uint8_t* dst, uint32_t color, uint32_t n) {
+    uint8_t b = color & 0xFF, g = (color >> 8) & 0xFF, r = (color >> 16) & 0xFF;
+    /* Four pixels are exactly three words */
+    uint32_t w0 = b | (g << 8) | (r << 16) | ((uint32_t)b << 24);
+    uint32_t w1 = g | (r << 8) | (b << 16) | ((uint32_t)g << 24);
+    uint32_t w2 = r | (b << 8) | (g << 16) | ((uint32_t)r << 24);
+    for (; n >= 4; n -= 4, dst += 12) {
+        ((u32_unaligned*)dst)[0] = w0;
+        ((u32_unaligned*)dst)[1] = w1;
+        ((u32_unaligned*)dst)[2] = w2;
+    }
+    for (; n; n--, dst += 3) {
+        dst[0] = b;
+        dst[1] = g;
+        dst[2] = r;
+    }
+}
+
+static void copy24(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++, dst += 3) {
+        uint32_t c = src[i];
+        dst[0] = c & 0xFF;
+        dst[1] = (c >> 8) & 0xFF;
+        dst[2] = (c >> 16) & 0xFF;
+    }
+}
+
+static void blend24(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++, dst += 3) {
+        uint32_t d = dst[0] | (dst[1] << 8) | ((uint32_t)dst[2] << 16);
+        uint32_t c = blend_pixel(src[i], d);
+        dst[0] = c & 0xFF;
+        dst[1] = (c >> 8) & 0xFF;
+        dst[2] = (c >> 16) & 0xFF;
+    }
+}
+
+/* --- 16 bpp (RGB565) --- */
+
+static void fill16(uint8_t* dst, uint32_t color, uint32_t n) {
+    uint16_t* d = (uint16_t*)dst;
+    uint16_t p = (uint16_t)to_565(color);
+    if (((uintptr_t)d & 2) && n) {
+        *d++ = p;
+        n--;
+    }
+    memset32((uint32_t*)d, p | ((uint32_t)p << 16), n >> 1);
+    if (n & 1) d[n - 1] = p;
+}
+
+static void copy16(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    uint16_t* d = (uint16_t*)dst;
+    for (uint32_t i = 0; i < n; i++) d[i] = (uint16_t)to_565(src[i]);
+}
+
+static void blend16(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    uint16_t* d = (uint16_t*)dst;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t a = src[i] >> 24;
+        if (a == 0) continue;
+        d[i] = (uint16_t)to_565(a == 0xFF ? src[i] : blend_pixel(src[i], from_565(d[i])));
+    }
+}
+
+static const gpu_span_ops_t span32 = { 4, fill32, copy32, blend32 };
+static const gpu_span_ops_t span24 = { 3, fill24, copy24, blend24 };
+static const gpu_span_ops_t span16 = { 2, fill16, copy16, blend16 };
+
+const gpu_span_ops_t* gpu_span_select(uint32_t bpp) {
+    switch (bpp) {
+        case 32: return &span32;
+        case 24: return &span24;
+        case 16: return &span16;
+        default: return 0;
+    }
+}
+
+/* --- Rectangle ops --- */
+
+static inline uint8_t* fb_at(gpu_device_t* dev, uint32_t x, uint32_t y) {
+    return (uint8_t*)dev->virt_addr + y * dev->pitch + x * dev->span->bytes_pp;
+}
+
+void gpu_span_fillrect(gpu_device_t* dev, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color) {
+    if (!dev->virt_addr || !dev->span) return;
+
+    /* Clipping */
+    if (x >= dev->width || y >= dev->height) return;
+    if (w > dev->width - x) w = dev->width - x;
+    if (h > dev->height - y) h = dev->height - y;
+    if (!w || !h) return;
+
+    uint8_t* row = fb_at(dev, x, y);
+    if (x == 0 && w == dev->width && dev->pitch == w * dev->span->bytes_pp && dev->span == &span32) {
+        /* Whole contiguous screen area: one fill */
+        fill32(row, color, w * h);
+    } else {
+        for (uint32_t j = 0; j < h; j++, row += dev->pitch) {
+            dev->span->fill(row, color, w);
+        }
+    }
+    gpu_mark_dirty(dev, x, y, w, h);
+}
+
+/* Clip a source rectangle placed at (x, y); false if nothing is left */
+static bool clip_blit(gpu_device_t* dev, int32_t* x, int32_t* y, const uint32_t** src,
+                      uint32_t src_pitch, uint32_t* w, uint32_t* h) {
+    if (*x < 0) {
+        if ((uint32_t)-*x >= *w) return false;
+        *w -= (uint32_t)-*x;
+        *src += -*x;
+        *x = 0;
+    }
+    if (*y < 0) {
+        if ((uint32_t)-*y >= *h) return false;
+        *h -= (uint32_t)-*y;
+        *src += (uint32_t)-*y * src_pitch;
+        *y = 0;
+    }
+    if ((uint32_t)*x >= dev->width || (uint32_t)*y >= dev->height) return false;
+    if (*w > dev->width - *x) *w = dev->width - *x;
+    if (*h > dev->height - *y) *h = dev->height - *y;
+    return *w && *h;
+}
+
+void gpu_span_blit(gpu_device_t* dev, int32_t x, int32_t y, const uint32_t* src,
+                   uint32_t src_pitch, uint32_t w, uint32_t h) {
+    if (!dev->virt_addr || !dev->span || !src) return;
+    if (!clip_blit(dev, &x, &y, &src, src_pitch, &w, &h)) return;
+
+    uint8_t* row = fb_at(dev, x, y);
+    for (uint32_t j = 0; j < h; j++, row += dev->pitch, src += src_pitch) {
+        dev->span->copy(row, src, w);
+    }
+    gpu_mark_dirty(dev, x, y, w, h);
+}
+
+void gpu_span_blit_alpha(gpu_device_t* dev, int32_t x, int32_t y, const uint32_t* src,
+                         uint32_t src_pitch, uint32_t w, uint32_t h) {
+    if (!dev->virt_addr || !dev->span || !src) return;
+    if (!clip_blit(dev, &x, &y, &src, src_pitch, &w, &h)) return;
+
+    uint8_t* row = fb_at(dev, x, y);
+    for (uint32_t j = 0; j < h; j++, row += dev->pitch, src += src_pitch) {
+        dev->span->blend(row, src, w);
+    }
+    gpu_mark_dirty(dev, x, y, w, h);
+}
+
+void gpu_span_copyrect(gpu_device_t* dev, uint32_t dst_x, uint32_t dst_y,
+                       uint32_t src_x, uint32_t src_y, uint32_t w, uint32_t h) {
+    if (!dev->virt_addr || !dev->span) return;
+
+    /* Clip both rectangles against the screen */
+    if (dst_x >= dev->width || dst_y >= dev->height) return;
+    if (src_x >= dev->width || src_y >= dev->height) return;
+    uint32_t max_x = dst_x > src_x ? dst_x : src_x;
+    uint32_t max_y = dst_y > src_y ? dst_y : src_y;
+    if (w > dev->width - max_x) w = dev->width - max_x;
+    if (h > dev->height - max_y) h = dev->height - max_y;
+    if (!w || !h) return;
+
+    uint32_t len = w * dev->span->bytes_pp;
+    if (dst_y > src_y) {
+        /* Moving down: bottom row first so rows are read before overwritten */
+        for (uint32_t j = h; j-- > 0; ) {
+            memmove(fb_at(dev, dst_x, dst_y + j), fb_at(dev, src_x, src_y + j), len);
+        }
+    } else {
+        for (uint32_t j = 0; j < h; j++) {
+            memmove(fb_at(dev, dst_x, dst_y + j), fb_at(dev, src_x, src_y + j), len);
+        }
+    }
+    gpu_mark_dirty(dev, dst_x, dst_y, w, h);
+}
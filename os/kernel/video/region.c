@@ -0,0 +1,109 @@
+#include "region.h"
+
+bool rect_intersect(const rect_t* a, const rect_t* b, rect_t* out) {
+    int32_t x0 = a->x > b->x ? a->x : b->x;
+    int32_t y0 = a->y > b->y ? a->y : b->y;
+    int32_t x1 = (a->x + a->w < b->x + b->w) ? a->x + a->w : b->x + b->w;
+    int32_t y1 = (a->y + a->h < b->y + b->h) ? a->y + a->h : b->y + b->h;
+    if (x1 <= x0 || y1 <= y0) return false;
+    if (out) {
+        out->x = x0;
+        out->y = y0;
+        out->w = x1 - x0;
+        out->h = y1 - y0;
+    }
+    return true;
+}
+
+void rect_union(rect_t* a, const rect_t* b) {
+    if (rect_empty(b)) return;
+    if (rect_empty(a)) {
+        *a = *b;
+        return;
+    }
+    int32_t x0 = a->x < b->x ? a->x : b->x;
+    int32_t y0 = a->y < b->y ? a->y : b->y;
+    int32_t x1 = (a->x + a->w > b->x + b->w) ? a->x + a->w : b->x + b->w;
+    int32_t y1 = (a->y + a->h > b->y + b->h) ? a->y + a->h : b->y + b->h;
+    a->x = x0;
+    a->y = y0;
+    a->w = x1 - x0;
+    a->h = y1 - y0;
+}
+
+bool rect_contains(const rect_t* outer, const rect_t* inner) {
+    return inner->x >= outer->x && inner->y >= outer->y &&
+           inner->x + inner->w <= outer->x + outer->w &&
+           inner->y + inner->h <= outer->y + outer->h;
+}
+
+static uint32_t rect_area(const rect_t* r) {
+    return rect_empty(r) ? 0 : (uint32_t)r->w * (uint32_t)r->h;
+}
+
+void region_clear(region_t* r) {
+    r->count = 0;
+}
+
+static void region_remove(region_t* r, int i) {
+    r->rects[i] = r->rects[--r->count];
+}
+
+void region_add_rect(region_t* r, const rect_t* rect) {
+    if (rect_empty(rect)) return;
+    rect_t n = *rect;
+
+    for (;;) {
+        /* Absorb anything the new rect overlaps; the union may now touch
+           rects that were disjoint from it, so rescan after each merge. */
+        bool merged = false;
+        for (int i = 0; i < r->count; i++) {
+            if (rect_contains(&r->rects[i], &n)) return;
+            if (rect_intersect(&r->rects[i], &n, 0)) {
+                rect_union(&n, &r->rects[i]);
+                region_remove(r, i);
+                merged = true;
+                break;
+            }
+        }
+        if (merged) continue;
+
+        if (r->count < REGION_MAX_RECTS) {
+            r->rects[r->count++] = n;
+            return;
+        }
+
+        /* Full: merge with the rect whose bounding box wastes least */
+        int best = 0;
+        uint32_t best_cost = 0xFFFFFFFF;
+        for (int i = 0; i < r->count; i++) {
+            rect_t u = n;
+            rect_union(&u, &r->rects[i]);
+            uint32_t cost = rect_area(&u) - rect_area(&r->rects[i]);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best = i;
+            }
+        }
+        rect_union(&n, &r->rects[best]);
+        region_remove(r, best);
+    }
+}
+
+void region_add(region_t* r, int32_t x, int32_t y, int32_t w, int32_t h) {
+    rect_t rect = { x, y, w, h };
+    region_add_rect(r, &rect);
+}
+
+void region_clip(region_t* r, const rect_t* bounds) {
+    for (int i = 0; i < r->count; ) {
+        if (rect_intersect(&r->rects[i], bounds, &r->rects[i])) i++;
+        else region_remove(r, i);
+    }
+}
+
+uint32_t region_area(const region_t* r) {
+    uint32_t a = 0;
+    for (int i = 0; i < r->count; i++) a += rect_area(&r->rects[i]);
+    return a;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int32_t x, y;
+    int32_t w, h;
+} rect_t;
+
+/* Damage region: a small set of disjoint rectangles. Overlapping rects
+   are merged on insert; once the set is full the new rect is merged into
+   whichever existing rect grows the least. */
+#define REGION_MAX_RECTS 16
+
+typedef struct {
+    int count;
+    rect_t rects[REGION_MAX_RECTS];
+} region_t;
+
+static inline bool rect_empty(const rect_t* r) {
+    return r->w <= 0 || r->h <= 0;
+}
+
+static inline bool rect_equal(const rect_t* a, const rect_t* b) {
+    return a->x == b->x && a->y == b->y && a->w == b->w && a->h == b->h;
+}
+
+/* True if the intersection is non-empty; stores it in out when given */
+bool rect_intersect(const rect_t* a, const rect_t* b, rect_t* out);
+/* Grow a to the bounding box of a and b */
+void rect_union(rect_t* a, const rect_t* b);
+bool rect_contains(const rect_t* outer, const rect_t* inner);
+
+void region_clear(region_t* r);
+void region_add(region_t* r, int32_t x, int32_t y, int32_t w, int32_t h);
+void region_add_rect(region_t* r, const rect_t* rect);
+/* Drop everything outside bounds */
+void region_clip(region_t* r, const rect_t* bounds);
+uint32_t region_area(const region_t* r);
+
+#ifdef __cplusplus
+}
+#endif
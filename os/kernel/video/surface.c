@@ -1,5 +1,6 @@
 #include "surface.h"
 #include "../mem/kmalloc.h"
+#include "../string.h"
 
 /* Import serial logging */
 extern void serial(const char *fmt, ...);
@@ -13,6 +14,11 @@ surface_t* surface_create(uint32_t width, uint32_t height) {
     surf->x = 0;
     surf->y = 0;
     surf->visible = true;
+    surf->damage.w = 0;
+    surf->damage.h = 0;
+    surf->flags = 0;
+    surf->opacity = 255;
+    surf->shadow = 0;
     
     /* Allocate pixel buffer (32bpp) */
     surf->pixels = (uint32_t*)kmalloc(width * height * sizeof(uint32_t));
@@ -22,9 +28,8 @@ surface_t* surface_create(uint32_t width, uint32_t height) {
     }
 
     /* Initialize to transparent/black */
-    for (uint32_t i = 0; i < width * height; i++) {
-        surf->pixels[i] = 0xFF000000; // Opaque black default
-    }
+    memset32(surf->pixels, 0xFF000000, width * height); // Opaque black default
+    surface_damage_all(surf);
 
     serial("[SURFACE] Created %dx%d surface at 0x%x\n", width, height, surf);
     return surf;
@@ -39,10 +44,8 @@ void surface_destroy(surface_t* surface) {
 
 void surface_clear(surface_t* surface, uint32_t color) {
     if (!surface || !surface->pixels) return;
-    uint32_t count = surface->width * surface->height;
-    for (uint32_t i = 0; i < count; i++) {
-        surface->pixels[i] = color;
-    }
+    memset32(surface->pixels, color, surface->width * surface->height);
+    surface_damage_all(surface);
 }
 
 void surface_put_pixel(surface_t* surface, uint32_t x, uint32_t y, uint32_t color) {
@@ -51,4 +54,45 @@ void surface_put_pixel(surface_t* surface, uint32_t x, uint32_t y, uint32_t colo
     
     /* Row-major: y * width + x */
     surface->pixels[y * surface->width + x] = color;
-}
\ No newline at end of file
+    surface_damage(surface, x, y, 1, 1);
+}
+
+void surface_damage(surface_t* surface, int x, int y, int w, int h) {
+    if (!surface) return;
+    rect_t r = { x, y, w, h };
+    rect_t bounds = { 0, 0, (int32_t)surface->width, (int32_t)surface->height };
+    if (rect_intersect(&r, &bounds, &r)) rect_union(&surface->damage, &r);
+}
+
+void surface_damage_all(surface_t* surface) {
+    if (!surface) return;
+    surface->damage.x = 0;
+    surface->damage.y = 0;
+    surface->damage.w = (int32_t)surface->width;
+    surface->damage.h = (int32_t)surface->height;
+}
+void surface_set_opacity(surface_t* surface, uint8_t opacity) {
+    if (!surface || surface->opacity == opacity) return;
+    surface->opacity = opacity;
+    surface_damage_all(surface);
+}
+
+void surface_set_alpha(surface_t* surface, bool premultiplied) {
+    if (!surface) return;
+    uint8_t flags = premultiplied ? (surface->flags | SURFACE_ALPHA) : (surface->flags & ~SURFACE_ALPHA);
+    if (flags == surface->flags) return;
+    surface->flags = flags;
+    surface_damage_all(surface);
+}
+
+void surface_set_shadow(surface_t* surface, uint8_t offset) {
+    /* The WM sees the footprint change and damages old and new areas */
+    if (surface) surface->shadow = offset;
+}
+
+void surface_footprint(const surface_t* s, int32_t x, int32_t y, rect_t* out) {
+    out->x = x;
+    out->y = y;
+    out->w = (int32_t)s->width + s->shadow;
+    out->h = (int32_t)s->height + s->shadow;
+}
@@ -1,11 +1,15 @@
 #pragma once
 #include <stdint.h>
 #include <stdbool.h>
+#include "region.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Surface flags */
+#define SURFACE_ALPHA  0x01   /* Pixels carry premultiplied alpha */
+
 typedef struct {
     uint32_t width;
     uint32_t height;
@@ -13,13 +17,38 @@ typedef struct {
     int32_t y;
     bool visible;
     uint32_t* pixels; /* Buffer in RAM (ARGB/RGB) */
+    rect_t damage;    /* Changed since last composite (surface coordinates) */
+    uint8_t flags;    /* SURFACE_* */
+    uint8_t opacity;  /* Whole-surface opacity, 255 = opaque */
+    uint8_t shadow;   /* Drop shadow offset in pixels, 0 = none */
 } surface_t;
 
+#define SURFACE_SHADOW_ALPHA 0x60
+
 surface_t* surface_create(uint32_t width, uint32_t height);
 void surface_destroy(surface_t* surface);
 void surface_clear(surface_t* surface, uint32_t color);
 void surface_put_pixel(surface_t* surface, uint32_t x, uint32_t y, uint32_t color);
 
+/* Report changed pixels. Anything writing surface->pixels directly must
+   call this, or the change stays invisible until something else covers
+   the same area. The WM collects and resets the damage every frame. */
+void surface_damage(surface_t* surface, int x, int y, int w, int h);
+void surface_damage_all(surface_t* surface);
+
+/* Compositing attributes (each change damages what it affects) */
+void surface_set_opacity(surface_t* surface, uint8_t opacity);
+void surface_set_shadow(surface_t* surface, uint8_t offset);
+void surface_set_alpha(surface_t* surface, bool premultiplied);
+
+/* Covers everything below it (no alpha, full opacity) */
+static inline bool surface_is_opaque(const surface_t* s) {
+    return !(s->flags & SURFACE_ALPHA) && s->opacity == 255;
+}
+
+/* Screen area the surface touches, drop shadow included */
+void surface_footprint(const surface_t* s, int32_t x, int32_t y, rect_t* out);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "text_damage.h"
+#include "../string.h"
+
+#define WORDS (TEXT_DAMAGE_MAX_ROWS / 32)
+
+void text_damage_clear(text_damage_t* d) {
+    for (int i = 0; i < WORDS; i++) d->rows[i] = 0;
+    d->scrolled = 0;
+}
+
+void text_damage_add(text_damage_t* d, uint32_t row, uint32_t x0, uint32_t x1) {
+    if (row >= TEXT_DAMAGE_MAX_ROWS || x0 >= x1) return;
+    uint32_t bit = 1u << (row & 31);
+    if (d->rows[row >> 5] & bit) {
+        if (x0 < d->x0[row]) d->x0[row] = (uint16_t)x0;
+        if (x1 > d->x1[row]) d->x1[row] = (uint16_t)x1;
+    } else {
+        d->rows[row >> 5] |= bit;
+        d->x0[row] = (uint16_t)x0;
+        d->x1[row] = (uint16_t)x1;
+    }
+}
+
+void text_damage_all(text_damage_t* d, uint32_t rows, uint32_t cols) {
+    if (rows > TEXT_DAMAGE_MAX_ROWS) rows = TEXT_DAMAGE_MAX_ROWS;
+    for (uint32_t r = 0; r < rows; r++) {
+        d->rows[r >> 5] |= 1u << (r & 31);
+        d->x0[r] = 0;
+        d->x1[r] = (uint16_t)cols;
+    }
+}
+
+void text_damage_scroll(text_damage_t* d, uint32_t rows, uint32_t cols) {
+    if (rows > TEXT_DAMAGE_MAX_ROWS) rows = TEXT_DAMAGE_MAX_ROWS;
+    if (!rows) return;
+
+    /* Row r takes the marks of row r + 1 */
+    for (int i = 0; i < WORDS; i++) {
+        d->rows[i] >>= 1;
+        if (i + 1 < WORDS) d->rows[i] |= d->rows[i + 1] << 31;
+    }
+    memmove(d->x0, d->x0 + 1, (rows - 1) * sizeof(d->x0[0]));
+    memmove(d->x1, d->x1 + 1, (rows - 1) * sizeof(d->x1[0]));
+
+    /* The bit shifted in from below the grid is never set, so only the new row is */
+    d->rows[(rows - 1) >> 5] |= 1u << ((rows - 1) & 31);
+    d->x0[rows - 1] = 0;
+    d->x1[rows - 1] = (uint16_t)cols;
+
+    if (d->scrolled < rows) d->scrolled++;
+}
+
+int text_damage_next(const text_damage_t* d, uint32_t from, uint32_t* x0, uint32_t* x1) {
+    for (uint32_t w = from >> 5; w < WORDS; w++) {
+        uint32_t bits = d->rows[w];
+        if (w == from >> 5) bits &= ~0u << (from & 31);
+        if (!bits) continue;
+        uint32_t r = (w << 5) + __builtin_ctz(bits);
+        if (x0) *x0 = d->x0[r];
+        if (x1) *x1 = d->x1[r];
+        return (int)r;
+    }
+    return -1;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Damage of a text grid: a bit per row plus the dirty column span of
+   that row. Writers only record what changed; the owner redraws the
+   marked cells once per frame. Scrolling shifts the marks with the
+   text and counts the rows, so the pixels can be moved in one copy. */
+#define TEXT_DAMAGE_MAX_ROWS 128
+
+typedef struct {
+    uint32_t rows[TEXT_DAMAGE_MAX_ROWS / 32];
+    uint16_t x0[TEXT_DAMAGE_MAX_ROWS];    /* Dirty columns [x0, x1) */
+    uint16_t x1[TEXT_DAMAGE_MAX_ROWS];
+    uint32_t scrolled;                    /* Rows scrolled since the last flush */
+} text_damage_t;
+
+void text_damage_clear(text_damage_t* d);
+void text_damage_add(text_damage_t* d, uint32_t row, uint32_t x0, uint32_t x1);
+void text_damage_all(text_damage_t* d, uint32_t rows, uint32_t cols);
+/* Text moved up one row; the bottom row is new */
+void text_damage_scroll(text_damage_t* d, uint32_t rows, uint32_t cols);
+/* First dirty row at or after from (and its span), -1 if none */
+int  text_damage_next(const text_damage_t* d, uint32_t from, uint32_t* x0, uint32_t* x1);
+
+static inline int text_damage_any(const text_damage_t* d) {
+    for (int i = 0; i < TEXT_DAMAGE_MAX_ROWS / 32; i++)
+        if (d->rows[i]) return 1;
+    return d->scrolled != 0;
+}
+
+#ifdef __cplusplus
+}
+#endif